@@ -3,13 +3,16 @@
 
 import fcntl
 import io
+import json
 import os
 import select
 import signal
+import statistics
 import struct
 import sys
 import termios
 import time
+from collections.abc import Callable
 from pty import CHILD, fork
 
 from kitty.constants import kitten_exe
@@ -17,6 +20,15 @@
 from kitty.utils import read_screen_size
 
 
+def parse_bytes(screen: Screen, data: bytes|memoryview) -> None:
+    data = memoryview(data)
+    while data:
+        dest = screen.test_create_write_buffer()
+        s = screen.test_commit_write_buffer(data, dest)
+        data = data[s:]
+        screen.test_parse_written_data()
+
+
 def run_parsing_benchmark(cell_width: int = 10, cell_height: int = 20, scrollback: int = 20000) -> None:
     isatty = sys.stdout.isatty()
     if isatty:
@@ -50,14 +62,6 @@ def write(self, x: bytes | str) -> None:
 
     screen = Screen(None, rows, columns, scrollback, cell_width, cell_height, 0, ToChild())
 
-    def parse_bytes(data: bytes|memoryview) -> None:
-        data = memoryview(data)
-        while data:
-            dest = screen.test_create_write_buffer()
-            s = screen.test_commit_write_buffer(data, dest)
-            data = data[s:]
-            screen.test_parse_written_data()
-
 
     while True:
         rd, wd, _ = select.select([master_fd, r_pipe], [master_fd] if write_buf else [], [])
@@ -70,7 +74,7 @@ def parse_bytes(data: bytes|memoryview) -> None:
                 data = b''
             if not data:
                 break
-            parse_bytes(data)
+            parse_bytes(screen, data)
         if master_fd in wd:
             n = os.write(master_fd, write_buf)
             write_buf = write_buf[n:]
@@ -82,8 +86,91 @@ def parse_bytes(data: bytes|memoryview) -> None:
         sys.stdout.write(str(screen.linebuf))
 
 
+def run_ansi_serialization_benchmark(columns: int = 200, rows: int = 50, scrollback: int = 20000, repeat: int = 10) -> None:
+    # Measure serializing lines with formatting as ANSI, as used for
+    # scrollback export and the pager history
+    screen = Screen(None, rows, columns, scrollback, 10, 20)
+    sgr = ('\x1b[m', '\x1b[1;31m', '\x1b[4:3;58:5:12m', '\x1b[38:2:100:200:50;48:5:240m', '\x1b[3;7m')
+    parse_bytes(screen, ''.join(
+        ''.join(f'{sgr[(i + j) % len(sgr)]}word{j} with some plain text' for j in range(5)) + '\r\n'
+        for i in range(scrollback + rows)).encode())
+    lines: list[str] = []
+    start = time.monotonic()
+    for i in range(repeat):
+        lines.clear()
+        screen.historybuf.as_ansi(lines.append)
+    elapsed = time.monotonic() - start
+    print(f'Serialized {len(lines)} lines {repeat} times in {elapsed:.3f} seconds, {sum(map(len, lines)) * repeat / elapsed / 1e6:.1f}M chars/sec')
+
+
+def measure(func: Callable[[], object], warmup: int = 2, repeat: int = 10) -> dict[str, float]:
+    for i in range(warmup):
+        func()
+    samples = []
+    for i in range(repeat):
+        start = time.perf_counter()
+        func()
+        samples.append(time.perf_counter() - start)
+    return {
+        'min': min(samples), 'median': statistics.median(samples), 'mean': statistics.fmean(samples),
+        'stdev': statistics.stdev(samples) if len(samples) > 1 else 0., 'samples': len(samples)}
+
+
+def run_micro_benchmarks(as_json: bool = False, columns: int = 200, rows: int = 50, scrollback: int = 20000) -> None:
+    # Benchmarks of the core data structures in isolation, each sample does
+    # the same fixed amount of work on the same input
+    from kitty.fast_data_types import test_render_line
+    from kitty.fonts.render import setup_for_testing
+
+    def filled_screen(text: str) -> Screen:
+        screen = Screen(None, rows, columns, scrollback, 10, 20)
+        parse_bytes(screen, ''.join(f'\x1b[{31 + i % 7}m{i} {text}\x1b[m\r\n' for i in range(scrollback + rows)).encode())
+        return screen
+
+    plain = filled_screen('some text that wraps ' * 15)
+    combining = Screen(None, rows, columns, 0, 10, 20)
+    combining_text = ('a\u0301e\u0308\U0001f44d\U0001f3fd ' * (columns // 6) + '\r\n') * rows
+    linefeeds = Screen(None, rows, columns, 0, 10, 20)
+    dc = plain.grman.disk_cache
+    dc_data = {str(i).encode(): os.urandom(64 * 1024) for i in range(256)}
+
+    def disk_cache() -> None:
+        for k, v in dc_data.items():
+            dc.add(k, v)
+        for k in dc_data:
+            dc.get(k)
+        dc.clear()
+
+    def text_cache() -> None:
+        parse_bytes(combining, combining_text.encode())
+        combining.compact_text_cache()
+
+    results = {
+        'linebuf_index': measure(lambda: parse_bytes(linefeeds, b'\n' * 100000)),
+        'historybuf_rewrap': measure(lambda: plain.historybuf.rewrap(columns - 37)),
+        'text_cache': measure(text_cache),
+        'line_as_ansi': measure(lambda: plain.historybuf.as_ansi(lambda x: None)),
+        'disk_cache': measure(disk_cache),
+    }
+    with setup_for_testing():
+        line = Screen(None, 1, columns)
+        line.draw(''.join(chr(c) for c in range(33, 33 + columns)))
+        results['sprite_positions'] = measure(lambda: [test_render_line(line.line(0)) for i in range(100)])
+    if as_json:
+        print(json.dumps(results, indent=2))
+        return
+    mlen = max(map(len, results))
+    for name, r in results.items():
+        print(f'{name:{mlen}} : median {r["median"] * 1000:8.2f} ms  min {r["min"] * 1000:8.2f} ms  stdev {r["stdev"] * 1000:6.2f} ms')
+
+
 def main() -> None:
-    run_parsing_benchmark()
+    if sys.argv[1:2] == ['ansi']:
+        run_ansi_serialization_benchmark()
+    elif sys.argv[1:2] == ['micro']:
+        run_micro_benchmarks('--json' in sys.argv[2:])
+    else:
+        run_parsing_benchmark()
 
 
 if __name__ == '__main__':
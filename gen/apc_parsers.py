@@ -114,6 +114,7 @@ def generate(
     payload_is_base64: bool = True,
     start_parsing_at: int = 1,
     field_sep: str = ',',
+    streaming: bool = False,
 ) -> str:
     type_map = resolve_keys(keymap)
     keys_enum = enum(keymap)
@@ -153,12 +154,18 @@ def generate(
     else:
         payload_after_value = payload = payload_case = ''
         callback = f'{callback_name}(self->screen, &g)'
+    extra_args = before_report = ''
+    if streaming:
+        # A partial command is one chunk of an over long escape code, it is
+        # delivered as a chunked transmission
+        extra_args = ', const bool is_partial'
+        before_report = 'if (is_partial) { g.more = 1; self->partial_command_dispatched = true; }'
 
     return f'''
     #include "base64.h"
 
 static inline void
-{function_name}(PS *self, uint8_t *parser_buf, const size_t parser_buf_pos) {{
+{function_name}(PS *self, uint8_t *parser_buf, const size_t parser_buf_pos{extra_args}) {{
     unsigned int pos = {start_parsing_at};
     {extra_init}
     enum PARSER_STATES {{ KEY, EQUAL, UINT, INT, FLAG, AFTER_VALUE {payload} }};
@@ -266,6 +273,8 @@ def generate(
             break;
     }}
 
+    {before_report}
+
     {report_cmd}
 
     {callback};
@@ -281,7 +290,7 @@ def write_header(text: str, path: str) -> None:
     subprocess.check_call(['clang-format', '-i', path])
 
 
-def parsers() -> None:
+def graphics_parser() -> str:
     flag = frozenset
     keymap: KeymapType = {
         'a': ('action', flag('tTqpdfac')),
@@ -313,10 +322,13 @@ def parsers() -> None:
         'Q': ('parent_placement_id', 'uint'),
         'H': ('offset_from_parent_x', 'int'),
         'V': ('offset_from_parent_y', 'int'),
+        'E': ('ephemeral', 'uint'),
     }
-    text = generate('parse_graphics_code', 'screen_handle_graphics_command', 'graphics_command', keymap, 'GraphicsCommand')
-    write_header(text, 'kitty/parse-graphics-command.h')
-    keymap = {
+    return generate('parse_graphics_code', 'screen_handle_graphics_command', 'graphics_command', keymap, 'GraphicsCommand', streaming=True)
+
+
+def multicell_parser() -> str:
+    keymap: KeymapType = {
         'w': ('width', 'uint'),
         's': ('scale', 'uint'),
         'n': ('subscale_n', 'uint'),
@@ -324,10 +336,14 @@ def parsers() -> None:
         'v': ('vertical_align', 'uint'),
         'h': ('horizontal_align', 'uint'),
     }
-    text = generate(
+    return generate(
         'parse_multicell_code', 'screen_handle_multicell_command', 'multicell_command', keymap, 'MultiCellCommand',
         payload_is_base64=False, start_parsing_at=0, field_sep=':')
-    write_header(text, 'kitty/parse-multicell-command.h')
+
+
+def parsers() -> None:
+    write_header(graphics_parser(), 'kitty/parse-graphics-command.h')
+    write_header(multicell_parser(), 'kitty/parse-multicell-command.h')
 
 
 def main(args: list[str]=sys.argv) -> None:
@@ -12,7 +12,7 @@
 import subprocess
 import sys
 import tarfile
-from collections.abc import Iterator, Sequence
+from collections.abc import Iterable, Iterator, Sequence
 from contextlib import contextmanager, suppress
 from functools import lru_cache
 from itertools import chain
@@ -270,7 +270,8 @@ def generate_completions_for_kitty() -> None:
     print('k := root.AddSubCommand(&cli.Command{'
           'Name:"kitty", SubCommandIsOptional: true, ArgCompleter: cli.CompleteExecutableFirstArg, SubCommandMustBeFirst: true })')
     print('kt := root.AddSubCommand(&cli.Command{Name:"kitten", SubCommandMustBeFirst: true })')
-    print('tool.KittyToolEntryPoints(kt)')
+    print('tool.KittyToolEntryPoints(kt, cli.ArgvBeingCompletedFor("kitten")...)')
+    print('if cli.ExeBeingCompleted() == "kitten" { return }')
     for opt in go_options_for_seq(parse_option_spec()[0]):
         print(opt.as_option('k'))
 
@@ -868,20 +869,48 @@ def write_compressed_data(data: bytes, d: BinaryIO) -> None:
 
 
 def generate_unicode_names(src: TextIO, dest: BinaryIO) -> None:
-    num_names, num_of_words = map(int, next(src).split())
-    gob = io.BytesIO()
-    gob.write(struct.pack('<II', num_names, num_of_words))
+    # The data is laid out so that it can be queried in place from the
+    # embedded string in the kitten binary without any parsing at startup.
+    # All integers are little endian and all offsets are in bytes. Layout:
+    #   u32 num_of_names, u32 num_of_words
+    #   u32 codepoints[num_of_names] (sorted)
+    #   u32 name_offsets[num_of_names+1] then the bytes of all names
+    #   u32 word_offsets[num_of_words+1] then the bytes of all words (sorted)
+    #   u32 mark_offsets[num_of_words+1] then u16 marks, the indices into
+    #   codepoints of the names containing each word
+    next(src)
+    records: list[tuple[int, str, list[str]]] = []
     for line in src:
         line = line.strip()
         if line:
             a, aliases = line.partition('\t')[::2]
             cp, name = a.partition(' ')[::2]
-            ename = name.encode()
-            record = struct.pack('<IH', int(cp), len(ename)) + ename
-            if aliases:
-                record += aliases.encode()
-            gob.write(struct.pack('<H', len(record)) + record)
-    write_compressed_data(gob.getvalue(), dest)
+            records.append((int(cp), name, aliases.split()))
+    records.sort()
+    if len(records) > 0xffff:
+        raise SystemExit('Too many unicode names')
+    word_map: dict[str, set[int]] = {}
+    for mark, (cp, name, aliases) in enumerate(records):
+        if cp <= 32 or cp == 127 or 128 <= cp <= 159:
+            continue
+        for word in name.lower().split() + aliases:
+            if len(word) > 1:
+                word_map.setdefault(word, set()).add(mark)
+    words = sorted(word_map, key=lambda w: w.encode())
+
+    def offsets_and_blob(items: Iterable[bytes]) -> bytes:
+        offsets, blob, pos = [0], io.BytesIO(), 0
+        for x in items:
+            blob.write(x)
+            pos += len(x)
+            offsets.append(pos)
+        return struct.pack(f'<{len(offsets)}I', *offsets) + blob.getvalue()
+
+    dest.write(struct.pack('<II', len(records), len(words)))
+    dest.write(struct.pack(f'<{len(records)}I', *(r[0] for r in records)))
+    dest.write(offsets_and_blob(r[1].encode() for r in records))
+    dest.write(offsets_and_blob(w.encode() for w in words))
+    dest.write(offsets_and_blob(struct.pack(f'<{len(word_map[w])}H', *sorted(word_map[w])) for w in words))
 
 
 def generate_ssh_kitten_data() -> None:
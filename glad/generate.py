@@ -11,7 +11,8 @@
 cmdline = (
     'glad --out-path {dest} --api gl:core=3.1 '
     ' --extensions GL_ARB_texture_storage,GL_ARB_copy_image,GL_ARB_multisample,GL_ARB_robustness,'
-    'GL_ARB_instanced_arrays,GL_KHR_debug,GL_ARB_framebuffer_sRGB,GL_EXT_framebuffer_sRGB '
+    'GL_ARB_instanced_arrays,GL_KHR_debug,GL_ARB_framebuffer_sRGB,GL_EXT_framebuffer_sRGB,'
+    'GL_ARB_buffer_storage,GL_ARB_sync,GL_ARB_get_program_binary '
     'c --header-only --debug'
 )
 
@@ -83,23 +83,58 @@ toggleWatch(EventLoopData *eld, id_type watch_id, int enabled) {
 }
 
 static id_type timer_counter = 0;
+// Timers due within this long of each other are dispatched together, to
+// reduce the number of wakeups
+#define TIMER_COALESCE_SLACK ms_to_monotonic_t(1ll)
 
-static int
-compare_timers(const void *a_, const void *b_) {
-    const Timer *a = (const Timer*)a_, *b = (const Timer*)b_;
-    return (a->trigger_at > b->trigger_at) ? 1 : (a->trigger_at < b->trigger_at) ? -1 : 0;
+static void
+sift_up(EventLoopData *eld, nfds_t i) {
+    const Timer t = eld->timers[i];
+    while (i > 0) {
+        const nfds_t parent = (i - 1) / 2;
+        if (eld->timers[parent].trigger_at <= t.trigger_at) break;
+        eld->timers[i] = eld->timers[parent]; i = parent;
+    }
+    eld->timers[i] = t;
 }
 
 static void
-update_timers(EventLoopData *eld) {
-    if (eld->timers_count > 1) qsort(eld->timers, eld->timers_count, sizeof(eld->timers[0]), compare_timers);
+sift_down(EventLoopData *eld, nfds_t i) {
+    const Timer t = eld->timers[i];
+    while (true) {
+        nfds_t child = 2 * i + 1;
+        if (child >= eld->timers_count) break;
+        if (child + 1 < eld->timers_count && eld->timers[child + 1].trigger_at < eld->timers[child].trigger_at) child++;
+        if (t.trigger_at <= eld->timers[child].trigger_at) break;
+        eld->timers[i] = eld->timers[child]; i = child;
+    }
+    eld->timers[i] = t;
+}
+
+static void
+timer_changed(EventLoopData *eld, nfds_t i) {
+    if (i > 0 && eld->timers[(i - 1) / 2].trigger_at > eld->timers[i].trigger_at) sift_up(eld, i);
+    else sift_down(eld, i);
+}
+
+static Timer*
+find_timer(EventLoopData *eld, id_type timer_id, nfds_t *idx) {
+    for (nfds_t i = 0; i < eld->timers_count; i++) {
+        if (eld->timers[i].id == timer_id) { *idx = i; return eld->timers + i; }
+    }
+    return NULL;
 }
 
 id_type
 addTimer(EventLoopData *eld, const char *name, monotonic_t interval, int enabled, bool repeats, timer_callback_func cb, void *cb_data, GLFWuserdatafreefun free) {
-    if (eld->timers_count >= sizeof(eld->timers)/sizeof(eld->timers[0])) {
-        _glfwInputError(GLFW_PLATFORM_ERROR, "Too many timers added");
-        return 0;
+    if (eld->timers_count >= eld->timers_capacity) {
+        const nfds_t capacity = eld->timers_capacity ? 2 * eld->timers_capacity : 64;
+        Timer *timers = realloc(eld->timers, capacity * sizeof(timers[0]));
+        if (!timers) {
+            _glfwInputError(GLFW_OUT_OF_MEMORY, "Out of memory adding timer");
+            return 0;
+        }
+        eld->timers = timers; eld->timers_capacity = capacity;
     }
     Timer *t = eld->timers + eld->timers_count++;
     t->interval = interval;
@@ -110,13 +145,22 @@ addTimer(EventLoopData *eld, const char *name, monotonic_t interval, int enabled
     t->callback_data = cb_data;
     t->free = free;
     t->id = ++timer_counter;
-    update_timers(eld);
+    sift_up(eld, eld->timers_count - 1);
     return timer_counter;
 }
 
 void
 removeTimer(EventLoopData *eld, id_type timer_id) {
-    removeX(timers, timer_id, update_timers);
+    nfds_t i;
+    Timer *t = find_timer(eld, timer_id, &i);
+    if (!t) return;
+    const Timer removed = *t;
+    if (i < --eld->timers_count) {
+        eld->timers[i] = eld->timers[eld->timers_count];
+        timer_changed(eld, i);
+    }
+    // called after removal as the free function can modify timers
+    if (removed.callback_data && removed.free) removed.free(removed.id, removed.callback_data);
 }
 
 void
@@ -129,26 +173,21 @@ removeAllTimers(EventLoopData *eld) {
 
 void
 toggleTimer(EventLoopData *eld, id_type timer_id, int enabled) {
-    for (nfds_t i = 0; i < eld->timers_count; i++) {
-        if (eld->timers[i].id == timer_id) {
-            monotonic_t trigger_at = enabled ? (monotonic() + eld->timers[i].interval) : MONOTONIC_T_MAX;
-            if (trigger_at != eld->timers[i].trigger_at) {
-                eld->timers[i].trigger_at = trigger_at;
-                update_timers(eld);
-            }
-            break;
-        }
+    nfds_t i;
+    Timer *t = find_timer(eld, timer_id, &i);
+    if (!t) return;
+    monotonic_t trigger_at = enabled ? (monotonic() + t->interval) : MONOTONIC_T_MAX;
+    if (trigger_at != t->trigger_at) {
+        t->trigger_at = trigger_at;
+        timer_changed(eld, i);
     }
 }
 
 void
 changeTimerInterval(EventLoopData *eld, id_type timer_id, monotonic_t interval) {
-    for (nfds_t i = 0; i < eld->timers_count; i++) {
-        if (eld->timers[i].id == timer_id) {
-            eld->timers[i].interval = interval;
-            break;
-        }
-    }
+    nfds_t i;
+    Timer *t = find_timer(eld, timer_id, &i);
+    if (t) t->interval = interval;
 }
 
 
@@ -189,20 +228,36 @@ dispatchEvents(EventLoopData *eld) {
     }
 }
 
+typedef struct { timer_callback_func func; id_type id; void* data; bool repeats; } TimerDispatch;
+
+static void
+collect_due_timers(EventLoopData *eld, nfds_t i, monotonic_t limit, TimerDispatch *dispatches, unsigned *num_dispatches) {
+    // the children of a timer that is not due are not due either
+    if (i >= eld->timers_count || eld->timers[i].trigger_at > limit) return;
+    const Timer *t = eld->timers + i;
+    dispatches[(*num_dispatches)++] = (TimerDispatch){.func=t->callback, .id=t->id, .data=t->callback_data, .repeats=t->repeats};
+    collect_due_timers(eld, 2 * i + 1, limit, dispatches, num_dispatches);
+    collect_due_timers(eld, 2 * i + 2, limit, dispatches, num_dispatches);
+}
+
 unsigned
 dispatchTimers(EventLoopData *eld) {
     if (!eld->timers_count || eld->timers[0].trigger_at == MONOTONIC_T_MAX) return 0;
-    static struct { timer_callback_func func; id_type id; void* data; bool repeats; } dispatches[sizeof(eld->timers)/sizeof(eld->timers[0])];
+    static TimerDispatch *dispatches = NULL;
+    static nfds_t dispatches_capacity = 0;
+    if (dispatches_capacity < eld->timers_capacity) {
+        TimerDispatch *d = realloc(dispatches, eld->timers_capacity * sizeof(d[0]));
+        if (!d) return 0;
+        dispatches = d; dispatches_capacity = eld->timers_capacity;
+    }
     unsigned num_dispatches = 0;
     monotonic_t now = monotonic();
-    for (nfds_t i = 0; i < eld->timers_count && eld->timers[i].trigger_at <= now; i++) {
-        eld->timers[i].trigger_at = now + eld->timers[i].interval;
-        dispatches[num_dispatches].func = eld->timers[i].callback;
-        dispatches[num_dispatches].id = eld->timers[i].id;
-        dispatches[num_dispatches].data = eld->timers[i].callback_data;
-        dispatches[num_dispatches].repeats = eld->timers[i].repeats;
-        num_dispatches++;
+    collect_due_timers(eld, 0, now + TIMER_COALESCE_SLACK, dispatches, &num_dispatches);
+    if (!num_dispatches) return 0;
+    for (nfds_t i = 0; i < eld->timers_count; i++) {
+        if (eld->timers[i].trigger_at <= now + TIMER_COALESCE_SLACK) eld->timers[i].trigger_at = now + eld->timers[i].interval;
     }
+    for (nfds_t i = eld->timers_count / 2; i-- > 0;) sift_down(eld, i);
     // we dispatch separately so that the callbacks can modify timers
     for (unsigned i = 0; i < num_dispatches; i++) {
         dispatches[i].func(dispatches[i].id, dispatches[i].data);
@@ -210,7 +265,6 @@ dispatchTimers(EventLoopData *eld) {
             removeTimer(eld, dispatches[i].id);
         }
     }
-    if (num_dispatches) update_timers(eld);
     return num_dispatches;
 }
 
@@ -289,6 +343,7 @@ finalizePollData(EventLoopData *eld) {
 #else
     closeFds(eld->wakeupFds, arraysz(eld->wakeupFds));
 #endif
+    free(eld->timers); eld->timers = NULL; eld->timers_count = 0; eld->timers_capacity = 0;
 }
 
 int
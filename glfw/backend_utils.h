@@ -74,9 +74,10 @@ typedef struct {
     int wakeupFds[2];
 #endif
     bool wakeup_data_read, wakeup_fd_ready;
-    nfds_t watches_count, timers_count;
+    nfds_t watches_count, timers_count, timers_capacity;
     Watch watches[32];
-    Timer timers[128];
+    // a binary min heap ordered by trigger_at, disabled timers trigger at MONOTONIC_T_MAX
+    Timer *timers;
 } EventLoopData;
 
 
@@ -476,12 +476,41 @@ GLFWAPI void glfwSwapBuffers(GLFWwindow* handle)
         return;
     }
 
+#ifdef _GLFW_WAYLAND
+    _glfwWaylandBeforeBufferSwap(window);
+#endif
     window->context.swapBuffers(window);
 #ifdef _GLFW_WAYLAND
     _glfwWaylandAfterBufferSwap(window);
 #endif
 }
 
+GLFWAPI void glfwSwapBuffersWithDamage(GLFWwindow* handle, const int* rects, int count)
+{
+    _GLFWwindow* window = (_GLFWwindow*) handle;
+    assert(window != NULL);
+
+    _GLFW_REQUIRE_INIT();
+
+    if (window->context.client == GLFW_NO_API)
+    {
+        _glfwInputError(GLFW_NO_WINDOW_CONTEXT,
+                        "Cannot swap buffers of a window that has no OpenGL or OpenGL ES context");
+        return;
+    }
+
+#ifdef _GLFW_WAYLAND
+    _glfwWaylandBeforeBufferSwap(window);
+#endif
+    if (count > 0 && rects && window->context.swapBuffersWithDamage)
+        window->context.swapBuffersWithDamage(window, rects, count);
+    else
+        window->context.swapBuffers(window);
+#ifdef _GLFW_WAYLAND
+    _glfwWaylandAfterBufferSwap(window);
+#endif
+}
+
 GLFWAPI void glfwSwapInterval(int interval)
 {
     _GLFWwindow* window;
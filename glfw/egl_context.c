@@ -203,6 +203,36 @@ static void swapBuffersEGL(_GLFWwindow* window)
     eglSwapBuffers(_glfw.egl.display, window->context.egl.surface);
 }
 
+static void swapBuffersWithDamageEGL(_GLFWwindow* window, const int* rects, int count)
+{
+    if (window != _glfwPlatformGetTls(&_glfw.contextSlot))
+    {
+        _glfwInputError(GLFW_PLATFORM_ERROR,
+                        "EGL: The context must be current on the calling thread when swapping buffers");
+        return;
+    }
+
+    EGLint egl_rects[4 * 32];
+    if (count > 32)
+    {
+        eglSwapBuffers(_glfw.egl.display, window->context.egl.surface);
+        return;
+    }
+    // GLFW rectangles have their origin at the top left of the framebuffer,
+    // EGL ones at the bottom left
+    int width, height;
+    _glfwPlatformGetFramebufferSize(window, &width, &height);
+    for (int i = 0; i < count; i++)
+    {
+        const int* r = rects + 4 * i;
+        egl_rects[4 * i] = r[0];
+        egl_rects[4 * i + 1] = height - r[1] - r[3];
+        egl_rects[4 * i + 2] = r[2];
+        egl_rects[4 * i + 3] = r[3];
+    }
+    eglSwapBuffersWithDamageKHR(_glfw.egl.display, window->context.egl.surface, egl_rects, count);
+}
+
 static void swapIntervalEGL(int interval)
 {
     eglSwapInterval(_glfw.egl.display, interval);
@@ -435,6 +465,13 @@ bool _glfwInitEGL(void)
         extensionSupportedEGL("EGL_KHR_context_flush_control");
     _glfw.egl.EXT_present_opaque =
         extensionSupportedEGL("EGL_EXT_present_opaque");
+    if (extensionSupportedEGL("EGL_KHR_swap_buffers_with_damage"))
+        _glfw.egl.SwapBuffersWithDamageKHR = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)
+            eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+    else if (extensionSupportedEGL("EGL_EXT_swap_buffers_with_damage"))
+        _glfw.egl.SwapBuffersWithDamageKHR = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)
+            eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+    _glfw.egl.KHR_swap_buffers_with_damage = _glfw.egl.SwapBuffersWithDamageKHR != NULL;
 
     return true;
 }
@@ -726,6 +763,8 @@ bool _glfwCreateContextEGL(_GLFWwindow* window,
 
     window->context.makeCurrent = makeContextCurrentEGL;
     window->context.swapBuffers = swapBuffersEGL;
+    if (_glfw.egl.KHR_swap_buffers_with_damage)
+        window->context.swapBuffersWithDamage = swapBuffersWithDamageEGL;
     window->context.swapInterval = swapIntervalEGL;
     window->context.extensionSupported = extensionSupportedEGL;
     window->context.getProcAddress = getProcAddressEGL;
@@ -158,6 +158,10 @@ typedef EGLSurface (EGLAPIENTRY * PFNEGLCREATEPLATFORMWINDOWSURFACEEXTPROC)(EGLD
 #define eglGetPlatformDisplayEXT _glfw.egl.GetPlatformDisplayEXT
 #define eglCreatePlatformWindowSurfaceEXT _glfw.egl.CreatePlatformWindowSurfaceEXT
 
+// The KHR and EXT variants of swap buffers with damage have the same signature
+typedef EGLBoolean (EGLAPIENTRY * PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)(EGLDisplay,EGLSurface,const EGLint*,EGLint);
+#define eglSwapBuffersWithDamageKHR _glfw.egl.SwapBuffersWithDamageKHR
+
 // EGL-specific per-context data
 //
 typedef struct _GLFWcontextEGL
@@ -189,6 +193,7 @@ typedef struct _GLFWlibraryEGL
     bool            EXT_platform_x11;
     bool            EXT_platform_wayland;
     bool            EXT_present_opaque;
+    bool            KHR_swap_buffers_with_damage;
     bool            ANGLE_platform_angle;
     bool            ANGLE_platform_angle_opengl;
     bool            ANGLE_platform_angle_d3d;
@@ -218,6 +223,7 @@ typedef struct _GLFWlibraryEGL
 
     PFNEGLGETPLATFORMDISPLAYEXTPROC GetPlatformDisplayEXT;
     PFNEGLCREATEPLATFORMWINDOWSURFACEEXTPROC CreatePlatformWindowSurfaceEXT;
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC SwapBuffersWithDamageKHR;
 
 } _GLFWlibraryEGL;
 
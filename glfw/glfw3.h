@@ -5455,6 +5455,33 @@ GLFWAPI GLFWwindow* glfwGetCurrentContext(void);
  */
 GLFWAPI void glfwSwapBuffers(GLFWwindow* window);
 
+/*! @brief Swaps the front and back buffers, updating only the damaged regions.
+ *
+ *  This function is like @ref glfwSwapBuffers, except that it tells the
+ *  compositor that only the specified rectangles of the back buffer have
+ *  changed since the last swap, so that it need only recompose those. On
+ *  Wayland this ends up as `wl_surface.damage_buffer`. The contents of the
+ *  back buffer outside the rectangles must be the same as those of the
+ *  previous frame. When the context does not support `EGL_KHR_swap_buffers_with_damage`
+ *  or `EGL_EXT_swap_buffers_with_damage`, or count is not positive, this
+ *  swaps the whole buffer.
+ *
+ *  @param[in] window The window whose buffers to swap.
+ *  @param[in] rects An array of count rectangles, each four integers x, y,
+ *  width and height in framebuffer pixels, with the origin at the top left.
+ *  @param[in] count The number of rectangles.
+ *
+ *  @errors Possible errors include @ref GLFW_NOT_INITIALIZED, @ref
+ *  GLFW_NO_WINDOW_CONTEXT and @ref GLFW_PLATFORM_ERROR.
+ *
+ *  @thread_safety This function may be called from any thread.
+ *
+ *  @sa @ref glfwSwapBuffers
+ *
+ *  @ingroup window
+ */
+GLFWAPI void glfwSwapBuffersWithDamage(GLFWwindow* window, const int* rects, int count);
+
 /*! @brief Sets the swap interval for the current context.
  *
  *  This function sets the swap interval for the current OpenGL or OpenGL ES
@@ -414,6 +414,9 @@ setup_connection(_GLFWIBUSData *ibus) {
     ibus->conn = glfw_dbus_connect_to(ibus->address, "Failed to connect to the IBUS daemon, with error", "ibus", true);
     if (!ibus->conn) return false;
     free((void*)ibus->input_ctx_path); ibus->input_ctx_path = NULL;
+    // replies to calls on the old connection are never delivered
+    ibus->keys_in_flight = 0;
+    ibus->cursor.sent = false;
     if (!glfw_dbus_call_method_with_reply(
             ibus->conn, IBUS_SERVICE, IBUS_PATH, IBUS_INTERFACE, "CreateInputContext", DBUS_TIMEOUT_USE_DEFAULT, input_context_created, ibus,
             DBUS_TYPE_STRING, &client_name, DBUS_TYPE_INVALID)) {
@@ -481,7 +484,10 @@ glfw_ibus_set_focused(_GLFWIBUSData *ibus, bool focused) {
 
 void
 glfw_ibus_set_cursor_geometry(_GLFWIBUSData *ibus, int x, int y, int w, int h) {
+    // The cursor position is updated on every render, only tell IBUS when it changes
+    if (ibus->cursor.sent && ibus->cursor.x == x && ibus->cursor.y == y && ibus->cursor.w == w && ibus->cursor.h == h) return;
     if (check_connection(ibus)) {
+        ibus->cursor.x = x; ibus->cursor.y = y; ibus->cursor.w = w; ibus->cursor.h = h; ibus->cursor.sent = true;
         glfw_dbus_call_method_no_reply(ibus->conn, IBUS_SERVICE, ibus->input_ctx_path, IBUS_INPUT_INTERFACE, "SetCursorLocation",
                 DBUS_TYPE_INT32, &x, DBUS_TYPE_INT32, &y, DBUS_TYPE_INT32, &w, DBUS_TYPE_INT32, &h, DBUS_TYPE_INVALID);
     }
@@ -491,6 +497,7 @@ void
 key_event_processed(DBusMessage *msg, const DBusError *err, void *data) {
     uint32_t handled = 0;
     _GLFWIBUSKeyEvent *ev = (_GLFWIBUSKeyEvent*)data;
+    if (ev->ibus->keys_in_flight) ev->ibus->keys_in_flight--;
     // Restore key's text from the text embedded in the structure.
     ev->glfw_ev.text = ev->__embedded_text;
     bool is_release = ev->glfw_ev.action == GLFW_RELEASE;
@@ -506,23 +513,35 @@ key_event_processed(DBusMessage *msg, const DBusError *err, void *data) {
     free(ev);
 }
 
+// Key events are sent to IBUS asynchronously and delivered to the application
+// in order, when IBUS replies. If it is so busy that this many keys are waiting
+// for a reply, or does not reply in time, keys are handled directly instead.
+#define MAX_KEYS_IN_FLIGHT 32
+#define KEY_EVENT_TIMEOUT_MS 1000
+
 bool
 ibus_process_key(const _GLFWIBUSKeyEvent *ev_, _GLFWIBUSData *ibus) {
     if (!check_connection(ibus)) return false;
+    if (ibus->keys_in_flight >= MAX_KEYS_IN_FLIGHT) {
+        debug("IBUS has %u keys waiting for a reply, handling key directly\n", ibus->keys_in_flight);
+        return false;
+    }
     _GLFWIBUSKeyEvent *ev = calloc(1, sizeof(_GLFWIBUSKeyEvent));
     if (!ev) return false;
     memcpy(ev, ev_, sizeof(_GLFWIBUSKeyEvent));
     // Put the key's text in a field IN the structure, for proper serialization.
     if (ev->glfw_ev.text) strncpy(ev->__embedded_text, ev->glfw_ev.text, sizeof(ev->__embedded_text) - 1);
     ev->glfw_ev.text = NULL;
+    ev->ibus = ibus;
     uint32_t state = ibus_key_state_from_glfw(ev->glfw_ev.mods, ev->glfw_ev.action);
     if (!glfw_dbus_call_method_with_reply(
             ibus->conn, IBUS_SERVICE, ibus->input_ctx_path, IBUS_INPUT_INTERFACE, "ProcessKeyEvent",
-            3000, key_event_processed, ev,
+            KEY_EVENT_TIMEOUT_MS, key_event_processed, ev,
             DBUS_TYPE_UINT32, &ev->ibus_keysym, DBUS_TYPE_UINT32, &ev->ibus_keycode, DBUS_TYPE_UINT32,
             &state, DBUS_TYPE_INVALID)) {
         free(ev);
         return false;
     }
+    ibus->keys_in_flight++;
     return true;
 }
@@ -36,6 +36,9 @@ typedef struct {
     time_t address_file_mtime;
     DBusConnection *conn;
     const char *input_ctx_path, *address_file_name, *address;
+    // number of key events sent to IBUS whose reply has not been received
+    unsigned int keys_in_flight;
+    struct { int x, y, w, h; bool sent; } cursor;
 } _GLFWIBUSData;
 
 typedef struct {
@@ -43,6 +46,7 @@ typedef struct {
     xkb_keysym_t ibus_keysym;
     GLFWid window_id;
     GLFWkeyevent glfw_ev;
+    _GLFWIBUSData *ibus;
     char __embedded_text[64];
 } _GLFWIBUSKeyEvent;
 
@@ -511,6 +511,15 @@ static const struct xdg_wm_base_listener wmBaseListener = {
     wmBaseHandlePing
 };
 
+static void
+presentation_handle_clock_id(void *data UNUSED, struct wp_presentation *presentation UNUSED, uint32_t clk_id) {
+    _glfw.wl.presentation_clock_id = clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+    .clock_id = presentation_handle_clock_id,
+};
+
 static void registryHandleGlobal(void* data UNUSED,
                                  struct wl_registry* registry,
                                  uint32_t name,
@@ -634,6 +643,10 @@ static void registryHandleGlobal(void* data UNUSED,
     else if (is(wp_viewporter)) {
         _glfw.wl.wp_viewporter = wl_registry_bind(registry, name, &wp_viewporter_interface, 1);
     }
+    else if (is(wp_presentation)) {
+        _glfw.wl.wp_presentation = wl_registry_bind(registry, name, &wp_presentation_interface, 1);
+        wp_presentation_add_listener(_glfw.wl.wp_presentation, &presentation_listener, NULL);
+    }
     else if (is(org_kde_kwin_blur_manager)) {
         _glfw.wl.org_kde_kwin_blur_manager = wl_registry_bind(registry, name, &org_kde_kwin_blur_manager_interface, 1);
     }
@@ -765,6 +778,7 @@ get_compositor_missing_capabilities(void) {
     char *p = buf;
     *p = 0;
     C(viewporter, wp_viewporter); C(fractional_scale, wp_fractional_scale_manager_v1);
+    C(presentation_time, wp_presentation);
     C(blur, org_kde_kwin_blur_manager); C(server_side_decorations, decorationManager);
     C(cursor_shape, wp_cursor_shape_manager_v1); C(layer_shell, zwlr_layer_shell_v1);
     C(single_pixel_buffer, wp_single_pixel_buffer_manager_v1); C(preferred_scale, has_preferred_buffer_scale);
@@ -1000,6 +1014,8 @@ void _glfwPlatformTerminate(void)
         wp_cursor_shape_manager_v1_destroy(_glfw.wl.wp_cursor_shape_manager_v1);
     if (_glfw.wl.wp_viewporter)
         wp_viewporter_destroy(_glfw.wl.wp_viewporter);
+    if (_glfw.wl.wp_presentation)
+        wp_presentation_destroy(_glfw.wl.wp_presentation);
     if (_glfw.wl.wp_fractional_scale_manager_v1)
         wp_fractional_scale_manager_v1_destroy(_glfw.wl.wp_fractional_scale_manager_v1);
     if (_glfw.wl.org_kde_kwin_blur_manager)
@@ -62,6 +62,7 @@ typedef VkBool32 (APIENTRY *PFN_vkGetPhysicalDeviceWaylandPresentationSupportKHR
 #include "wayland-cursor-shape-v1-client-protocol.h"
 #include "wayland-fractional-scale-v1-client-protocol.h"
 #include "wayland-viewporter-client-protocol.h"
+#include "wayland-presentation-time-client-protocol.h"
 #include "wayland-kwin-blur-v1-client-protocol.h"
 #include "wayland-wlr-layer-shell-unstable-v1-client-protocol.h"
 #include "wayland-single-pixel-buffer-v1-client-protocol.h"
@@ -277,6 +278,12 @@ typedef struct _GLFWwindowWayland
         struct wl_callback *current_wl_callback;
     } frameCallbackData;
 
+    struct {
+        // when the last frame was shown, in monotonic() time, and the refresh
+        // interval of the output it was shown on, zero if not known
+        monotonic_t last_presented_at, refresh_interval;
+    } presentation;
+
     struct {
         int32_t width, height;
     } user_requested_content_size;
@@ -351,6 +358,7 @@ typedef struct _GLFWlibraryWayland
     struct wp_cursor_shape_device_v1* wp_cursor_shape_device_v1;
     struct wp_fractional_scale_manager_v1 *wp_fractional_scale_manager_v1;
     struct wp_viewporter *wp_viewporter;
+    struct wp_presentation *wp_presentation; uint32_t presentation_clock_id;
     struct org_kde_kwin_blur_manager *org_kde_kwin_blur_manager;
     struct zwlr_layer_shell_v1* zwlr_layer_shell_v1; uint32_t zwlr_layer_shell_v1_version;
     struct wp_single_pixel_buffer_manager_v1 *wp_single_pixel_buffer_manager_v1;
@@ -41,6 +41,7 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <assert.h>
+#include <time.h>
 
 #define debug debug_rendering
 
@@ -396,6 +397,45 @@ resizeFramebuffer(_GLFWwindow* window) {
     _glfwInputFramebufferSize(window, scaled_width, scaled_height);
 }
 
+static void
+presentation_feedback_sync_output(void *data UNUSED, struct wp_presentation_feedback *feedback UNUSED, struct wl_output *output UNUSED) {}
+
+static void
+presentation_feedback_presented(
+    void *data, struct wp_presentation_feedback *feedback, uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+    uint32_t refresh, uint32_t seq_hi UNUSED, uint32_t seq_lo UNUSED, uint32_t flags
+) {
+    wp_presentation_feedback_destroy(feedback);
+    _GLFWwindow *window = _glfwWindowForId((uintptr_t)data);
+    struct timespec now;
+    if (!window || clock_gettime(_glfw.wl.presentation_clock_id, &now) != 0) return;
+    // convert from the clock of the compositor to monotonic()
+    const monotonic_t presented_at = s_to_monotonic_t((((monotonic_t)tv_sec_hi) << 32) | tv_sec_lo) + tv_nsec;
+    const monotonic_t age = s_to_monotonic_t(now.tv_sec) + now.tv_nsec - presented_at;
+    window->wl.presentation.last_presented_at = monotonic() - age;
+    // without vsync the presentation time is not on the refresh cycle of the output
+    window->wl.presentation.refresh_interval = flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC ? refresh : 0;
+}
+
+static void
+presentation_feedback_discarded(void *data UNUSED, struct wp_presentation_feedback *feedback) {
+    wp_presentation_feedback_destroy(feedback);
+}
+
+void
+_glfwWaylandBeforeBufferSwap(_GLFWwindow* window) {
+    // The feedback is for the next commit of the surface, which is done by
+    // the buffer swap. If the window is destroyed first, it is discarded.
+    static const struct wp_presentation_feedback_listener feedback_listener = {
+        .sync_output = presentation_feedback_sync_output,
+        .presented = presentation_feedback_presented,
+        .discarded = presentation_feedback_discarded,
+    };
+    if (!_glfw.wl.wp_presentation) return;
+    struct wp_presentation_feedback *feedback = wp_presentation_feedback(_glfw.wl.wp_presentation, window->wl.surface);
+    if (feedback) wp_presentation_feedback_add_listener(feedback, &feedback_listener, (void*)(uintptr_t)window->id);
+}
+
 void
 _glfwWaylandAfterBufferSwap(_GLFWwindow* window) {
     if (window->wl.temp_buffer_used_during_window_creation) {
@@ -2188,34 +2228,133 @@ write_all(int fd, const char *data, size_t sz) {
     return pos >= sz;
 }
 
+// Clipboard data is written to the receiving application from the event loop
+// so that a slow or stalled reader cannot block rendering. The data is
+// gathered up front as it is already in memory.
+typedef struct ClipboardWriter {
+    int fd;
+    char *data;
+    size_t sz, pos;
+    id_type watch_id, timer_id;
+    monotonic_t last_progress_at;
+    bool finished;
+} ClipboardWriter;
+#define MAX_CLIPBOARD_WRITERS 8
+#define CLIPBOARD_WRITE_TIMEOUT s_to_monotonic_t(2ll)
+static ClipboardWriter clipboard_writers[MAX_CLIPBOARD_WRITERS] = {0};
+
+static void
+free_clipboard_writer(ClipboardWriter *w) {
+    if (w->watch_id) removeWatch(&_glfw.wl.eventLoopData, w->watch_id);
+    if (w->timer_id) removeTimer(&_glfw.wl.eventLoopData, w->timer_id);
+    if (w->fd > -1) close(w->fd);
+    free(w->data);
+    memset(w, 0, sizeof(*w));
+}
+
+static void
+finish_clipboard_writer(ClipboardWriter *w) {
+    // watches cannot be removed while events are being dispatched, so cleanup
+    // happens in the timer callback which is triggered as soon as possible
+    w->finished = true;
+    toggleWatch(&_glfw.wl.eventLoopData, w->watch_id, 0);
+    changeTimerInterval(&_glfw.wl.eventLoopData, w->timer_id, 0);
+    toggleTimer(&_glfw.wl.eventLoopData, w->timer_id, 0);
+    toggleTimer(&_glfw.wl.eventLoopData, w->timer_id, 1);
+}
+
+static bool
+pump_clipboard_writer(ClipboardWriter *w) {
+    while (w->pos < w->sz) {
+        ssize_t ret = write(w->fd, w->data + w->pos, w->sz - w->pos);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+            _glfwInputError(GLFW_PLATFORM_ERROR,
+                "Wayland: Could not copy writing to destination fd failed with error: %s", strerror(errno));
+            return true;
+        }
+        w->pos += ret;
+        w->last_progress_at = monotonic();
+    }
+    return true;
+}
+
+static void
+clipboard_writer_ready(int fd UNUSED, int events UNUSED, void *data) {
+    ClipboardWriter *w = data;
+    if (!w->finished && pump_clipboard_writer(w)) finish_clipboard_writer(w);
+}
+
+static void
+clipboard_writer_timer(id_type timer_id UNUSED, void *data) {
+    ClipboardWriter *w = data;
+    if (w->finished) { free_clipboard_writer(w); return; }
+    if (monotonic() - w->last_progress_at >= CLIPBOARD_WRITE_TIMEOUT) {
+        _glfwInputError(GLFW_PLATFORM_ERROR, "Wayland: Timed out writing clipboard data to destination fd");
+        free_clipboard_writer(w);
+    }
+}
+
+static bool
+write_clipboard_data_async(int fd, char *data, size_t sz) {
+    ClipboardWriter *w = NULL;
+    for (size_t i = 0; i < arraysz(clipboard_writers) && !w; i++) {
+        if (!clipboard_writers[i].data) w = clipboard_writers + i;
+    }
+    if (!w) return false;
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) return false;
+    *w = (ClipboardWriter){.fd=fd, .data=data, .sz=sz, .last_progress_at=monotonic()};
+    if (pump_clipboard_writer(w)) { close(fd); free(data); memset(w, 0, sizeof(*w)); return true; }
+    w->watch_id = addWatch(&_glfw.wl.eventLoopData, "clipboard-writer", fd, POLLOUT | POLLERR | POLLHUP, 1, clipboard_writer_ready, w);
+    w->timer_id = addTimer(&_glfw.wl.eventLoopData, "clipboard-writer", CLIPBOARD_WRITE_TIMEOUT / 4, 1, true, clipboard_writer_timer, w, NULL);
+    if (!w->watch_id || !w->timer_id) {
+        // fall back to a blocking write of the remaining data
+        if (fcntl(fd, F_SETFL, flags) != -1) write_all(fd, data + w->pos, sz - w->pos);
+        free_clipboard_writer(w);
+        return true;
+    }
+    return true;
+}
+
 static void
 send_clipboard_data(const _GLFWClipboardData *cd, const char *mime, int fd) {
     if (strcmp(mime, "text/plain;charset=utf-8") == 0 || strcmp(mime, "UTF8_STRING") == 0 || strcmp(mime, "TEXT") == 0 || strcmp(mime, "STRING") == 0) mime = "text/plain";
     GLFWDataChunk chunk = cd->get_data(mime, NULL, cd->ctype);
     void *iter = chunk.iter;
-    if (!iter) return;
-    bool keep_going = true;
-    while (keep_going) {
+    if (!iter) { close(fd); return; }
+    char *buf = NULL; size_t sz = 0, cap = 0;
+    bool ok = true;
+    while (ok) {
         chunk = cd->get_data(mime, iter, cd->ctype);
         if (!chunk.sz) break;
-        if (!write_all(fd, chunk.data, chunk.sz)) keep_going = false;
+        if (sz + chunk.sz > cap) {
+            cap = MAX(2 * cap, sz + chunk.sz);
+            char *nb = realloc(buf, cap);
+            if (nb) buf = nb; else ok = false;
+        }
+        if (ok) { memcpy(buf + sz, chunk.data, chunk.sz); sz += chunk.sz; }
         if (chunk.free) chunk.free((void*)chunk.free_data);
     }
     cd->get_data(NULL, iter, cd->ctype);
+    if (!ok) _glfwInputError(GLFW_OUT_OF_MEMORY, "Wayland: Out of memory gathering clipboard data");
+    if (ok && sz && write_clipboard_data_async(fd, buf, sz)) return;
+    if (ok && sz) write_all(fd, buf, sz);
+    free(buf);
+    close(fd);
 }
 
 static void _glfwSendClipboardText(void *data UNUSED, struct wl_data_source *data_source UNUSED, const char *mime_type, int fd) {
     send_clipboard_data(&_glfw.clipboard, mime_type, fd);
-    close(fd);
 }
 
 static void _glfwSendPrimarySelectionText(void *data UNUSED, struct zwp_primary_selection_source_v1 *primary_selection_source UNUSED,
         const char *mime_type, int fd) {
     send_clipboard_data(&_glfw.primary, mime_type, fd);
-    close(fd);
 }
 
-static void
+static bool
 read_offer(int data_pipe, GLFWclipboardwritedatafun write_data, void *object) {
     wl_display_flush(_glfw.wl.display);
     struct pollfd fds;
@@ -2225,12 +2364,15 @@ read_offer(int data_pipe, GLFWclipboardwritedatafun write_data, void *object) {
 #define bail(...) { \
     _glfwInputError(GLFW_PLATFORM_ERROR, __VA_ARGS__); \
     close(data_pipe); \
-    return; \
+    return false; \
 }
 
-    char buf[8192];
+    char buf[65536];
+    // a source that trickles data can otherwise keep the event loop blocked indefinitely
+    const monotonic_t deadline = start + s_to_monotonic_t(30ll);
 
     while (glfwGetTime() - start < s_to_monotonic_t(2ll)) {
+        if (start > deadline) bail("Wayland: Failed to read clipboard data from pipe (source is too slow)");
         int ret = poll(&fds, 1, 2000);
         if (ret == -1) {
             if (errno == EINTR) continue;
@@ -2244,7 +2386,7 @@ read_offer(int data_pipe, GLFWclipboardwritedatafun write_data, void *object) {
             if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) continue;
             bail("Wayland: Failed to read clipboard data from pipe with error: %s", strerror(errno));
         }
-        if (ret == 0) { close(data_pipe); return; }
+        if (ret == 0) { close(data_pipe); return true; }
         if (!write_data(object, buf, ret)) bail("Wayland: call to write_data() failed with data from data offer");
         start = glfwGetTime();
     }
@@ -2257,12 +2399,17 @@ typedef struct chunked_writer {
     char *buf; size_t sz, cap;
 } chunked_writer;
 
+#define MAX_OFFER_STRING_SIZE (256u * 1024u * 1024u)
+
 static bool
 write_chunk(void *object, const char *data, size_t sz) {
     chunked_writer *cw = object;
+    if (cw->sz + sz > MAX_OFFER_STRING_SIZE) return false;
     if (cw->cap < cw->sz + sz) {
-        cw->cap = MAX(cw->cap * 2, cw->sz + 8*sz);
-        cw->buf = realloc(cw->buf, cw->cap * sizeof(cw->buf[0]));
+        size_t cap = MAX(cw->cap * 2, cw->sz + 8*sz);
+        char *buf = realloc(cw->buf, cap * sizeof(cw->buf[0]));
+        if (!buf) return false;
+        cw->buf = buf; cw->cap = cap;
     }
     memcpy(cw->buf + cw->sz, data, sz);
     cw->sz += sz;
@@ -2273,7 +2420,7 @@ write_chunk(void *object, const char *data, size_t sz) {
 static char*
 read_offer_string(int data_pipe, size_t *sz) {
     chunked_writer cw = {0};
-    read_offer(data_pipe, write_chunk, &cw);
+    if (!read_offer(data_pipe, write_chunk, &cw)) { free(cw.buf); cw.buf = NULL; }
     if (cw.buf) {
         *sz = cw.sz;
         return cw.buf;
@@ -2892,6 +3039,13 @@ GLFWAPI int glfwGetNativeKeyForName(const char* keyName, bool caseSensitive) {
     return glfw_xkb_keysym_from_name(keyName, caseSensitive);
 }
 
+GLFWAPI bool glfwWaylandPresentationTiming(GLFWwindow *handle, monotonic_t *last_presented_at, monotonic_t *refresh_interval) {
+    _GLFWwindow* window = (_GLFWwindow*) handle;
+    *last_presented_at = window->wl.presentation.last_presented_at;
+    *refresh_interval = window->wl.presentation.refresh_interval;
+    return *last_presented_at > 0 && *refresh_interval > 0;
+}
+
 GLFWAPI void glfwRequestWaylandFrameEvent(GLFWwindow *handle, unsigned long long id, void(*callback)(unsigned long long id)) {
     _GLFWwindow* window = (_GLFWwindow*) handle;
     static const struct wl_callback_listener frame_listener = { .done = frame_handle_redraw };
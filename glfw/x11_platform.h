@@ -192,6 +192,9 @@ typedef struct _GLFWwindowX11
 
     bool            iconified;
     bool            maximized;
+    // Whether the window is completely covered by other windows, this is
+    // never the case with compositing window managers
+    bool            fully_obscured;
 
     // Whether the visual supports framebuffer transparency
     bool            transparent;
@@ -118,6 +118,7 @@ static bool waitForVisibilityNotify(_GLFWwindow* window)
             return false;
     }
 
+    window->x11.fully_obscured = dummy.xvisibility.state == VisibilityFullyObscured;
     return true;
 }
 
@@ -889,6 +890,89 @@ get_atom_names(const Atom *atoms, int count, char **atom_names) {
 }
 
 
+// Selections too large for a single request are served incrementally (ICCCM
+// section 2.7.2). Each chunk is written when the requestor deletes the
+// property, from the normal event loop, so a slow requestor never blocks us.
+//
+typedef struct IncrTransfer {
+    Window requestor;
+    Atom property, target;
+    char *data;
+    size_t sz, pos;
+    monotonic_t last_activity_at;
+} IncrTransfer;
+#define MAX_INCR_TRANSFERS 8
+#define INCR_TRANSFER_TIMEOUT s_to_monotonic_t(5ll)
+static IncrTransfer incr_transfers[MAX_INCR_TRANSFERS] = {0};
+
+static size_t
+incr_chunk_size(void) {
+    // request sizes are in units of four bytes, leave room for the request header
+    size_t max = XExtendedMaxRequestSize(_glfw.x11.display);
+    if (!max) max = XMaxRequestSize(_glfw.x11.display);
+    return MIN(max * 4 - 1024, (size_t)256 * 1024);
+}
+
+static void
+free_incr_transfer(IncrTransfer *t) {
+    bool requestor_in_use = false;
+    for (size_t i = 0; i < arraysz(incr_transfers); i++) {
+        if (incr_transfers + i != t && incr_transfers[i].data && incr_transfers[i].requestor == t->requestor) requestor_in_use = true;
+    }
+    if (!requestor_in_use) {
+        _glfwGrabErrorHandlerX11();
+        XSelectInput(_glfw.x11.display, t->requestor, NoEventMask);
+        _glfwReleaseErrorHandlerX11();
+    }
+    free(t->data);
+    memset(t, 0, sizeof(*t));
+}
+
+static bool
+start_incr_transfer(const XSelectionRequestEvent *request, char *data, size_t sz) {
+    // takes ownership of data on success
+    IncrTransfer *t = NULL;
+    const monotonic_t now = monotonic();
+    for (size_t i = 0; i < arraysz(incr_transfers); i++) {
+        IncrTransfer *x = incr_transfers + i;
+        if (x->data && (now - x->last_activity_at > INCR_TRANSFER_TIMEOUT || (
+                x->requestor == request->requestor && x->property == request->property))) free_incr_transfer(x);
+        if (!x->data && !t) t = x;
+    }
+    if (!t) return false;
+    *t = (IncrTransfer){.requestor=request->requestor, .property=request->property, .target=request->target, .data=data, .sz=sz, .last_activity_at=now};
+    unsigned long total = sz;
+    _glfwGrabErrorHandlerX11();
+    XSelectInput(_glfw.x11.display, t->requestor, PropertyChangeMask);
+    XChangeProperty(_glfw.x11.display, t->requestor, t->property, _glfw.x11.INCR, 32, PropModeReplace, (unsigned char*)&total, 1);
+    _glfwReleaseErrorHandlerX11();
+    if (_glfw.x11.errorCode != Success) {
+        t->data = NULL;
+        free_incr_transfer(t);
+        return false;
+    }
+    return true;
+}
+
+static bool
+continue_incr_transfer(const XPropertyEvent *ev) {
+    if (ev->state != PropertyDelete) return false;
+    for (size_t i = 0; i < arraysz(incr_transfers); i++) {
+        IncrTransfer *t = incr_transfers + i;
+        if (!t->data || t->requestor != ev->window || t->property != ev->atom) continue;
+        // the transfer ends with a zero length chunk
+        const size_t n = MIN(incr_chunk_size(), t->sz - t->pos);
+        _glfwGrabErrorHandlerX11();
+        XChangeProperty(_glfw.x11.display, t->requestor, t->property, t->target, 8, PropModeReplace, (unsigned char*)t->data + t->pos, n);
+        _glfwReleaseErrorHandlerX11();
+        t->pos += n;
+        t->last_activity_at = monotonic();
+        if (!n || _glfw.x11.errorCode != Success) free_incr_transfer(t);
+        return true;
+    }
+    return false;
+}
+
 // Set the specified property to the selection converted to the requested target
 //
 static Atom writeTargetToProperty(const XSelectionRequestEvent* request)
@@ -1009,6 +1093,7 @@ static Atom writeTargetToProperty(const XSelectionRequestEvent* request)
             // The requested target is one we support
 
             char *data = NULL; size_t sz = get_clipboard_data(cd, aa->array[i].mime, &data);
+            if (data && sz > incr_chunk_size() && start_incr_transfer(request, data, sz)) return request->property;
             if (data) XChangeProperty(_glfw.x11.display,
                             request->requestor,
                             request->property,
@@ -1267,6 +1352,8 @@ static void processEvent(XEvent *event)
         }
     }
 
+    if (event->type == PropertyNotify && continue_incr_transfer(&event->xproperty)) return;
+
     if (event->type == PropertyNotify &&
         event->xproperty.window == _glfw.x11.root &&
         event->xproperty.atom == _glfw.x11.RESOURCE_MANAGER)
@@ -1852,10 +1939,23 @@ static void processEvent(XEvent *event)
 
         case Expose:
         {
+            // a count > 0 means more Expose events for this window follow
+            if (event->xexpose.count > 0) return;
             _glfwInputWindowDamage(window);
             return;
         }
 
+        case VisibilityNotify:
+        {
+            const bool fully_obscured = event->xvisibility.state == VisibilityFullyObscured;
+            if (window->x11.fully_obscured != fully_obscured)
+            {
+                window->x11.fully_obscured = fully_obscured;
+                _glfwInputWindowOcclusion(window, fully_obscured);
+            }
+            return;
+        }
+
         case PropertyNotify:
         {
             if (event->xproperty.state != PropertyNewValue)
@@ -2571,9 +2671,9 @@ int _glfwPlatformWindowFocused(_GLFWwindow* window)
     return window->x11.handle == focused;
 }
 
-int _glfwPlatformWindowOccluded(_GLFWwindow* window UNUSED)
+int _glfwPlatformWindowOccluded(_GLFWwindow* window)
 {
-    return false;
+    return window->x11.fully_obscured;
 }
 
 int _glfwPlatformWindowIconified(_GLFWwindow* window)
@@ -2808,12 +2908,25 @@ void _glfwPlatformSetWindowOpacity(_GLFWwindow* window, float opacity)
                     PropModeReplace, (unsigned char*) &value, 1);
 }
 
+// Returns whether the next queued event is a motion event for the same window
+// with the same button and modifier state, in which case only the latest
+// position needs to be reported. Not done for windows with a disabled cursor
+// as those track the position relative to warps.
+static bool
+is_superseded_motion_event(const XEvent *event) {
+    if (_glfw.x11.disabledCursorWindow && _glfw.x11.disabledCursorWindow->x11.handle == event->xmotion.window) return false;
+    XEvent next;
+    XPeekEvent(_glfw.x11.display, &next);
+    return next.type == MotionNotify && next.xmotion.window == event->xmotion.window && next.xmotion.state == event->xmotion.state;
+}
+
 static unsigned
 dispatch_x11_queued_events(int num_events) {
     unsigned dispatched = num_events > 0 ? num_events : 0;
     while (num_events-- > 0) {
         XEvent event;
         XNextEvent(_glfw.x11.display, &event);
+        if (event.type == MotionNotify && num_events > 0 && is_superseded_motion_event(&event)) continue;
         processEvent(&event);
     }
     return dispatched;
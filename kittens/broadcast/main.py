@@ -8,7 +8,6 @@
 
 from kitty.cli import parse_args
 from kitty.cli_stub import BroadcastCLIOptions
-from kitty.key_encoding import encode_key_event
 from kitty.rc.base import MATCH_TAB_OPTION, MATCH_WINDOW_OPTION
 from kitty.remote_control import create_basic_command, encode_send
 from kitty.short_uuid import uuid4
@@ -34,6 +33,10 @@ def __init__(self, opts: BroadcastCLIOptions, initial_strings: list[str]) -> Non
         self.hide_input = False
         self.initial_strings = initial_strings
         self.payload = {'exclude_active': True, 'data': '', 'match': opts.match, 'match_tab': opts.match_tab, 'session_id': uuid4()}
+        # Key events typed in this window are forwarded to the session windows
+        # by kitty itself, only pasted and initial text goes via send-text
+        self.session_payload = self.payload.copy()
+        self.session_payload.update({'native_keys': True, 'excluded_keys': [opts.end_session, opts.hide_input_toggle]})
         self.line_edit = LineEdit()
         self.session_started = False
         if not opts.match and not opts.match_tab:
@@ -56,19 +59,16 @@ def on_resize(self, screen_size: ScreenSize) -> None:
         self.commit_line()
 
     def on_text(self, text: str, in_bracketed_paste: bool = False) -> None:
-        self.write_broadcast_text(text)
+        if in_bracketed_paste:
+            self.write_broadcast_text(text)
         if not self.hide_input:
             self.line_edit.on_text(text, in_bracketed_paste)
         self.commit_line()
 
     def on_interrupt(self) -> None:
-        self.write_broadcast_text('\x03')
         self.line_edit.clear()
         self.commit_line()
 
-    def on_eot(self) -> None:
-        self.write_broadcast_text('\x04')
-
     def on_key(self, key_event: KeyEventType) -> None:
         if key_event.matches(self.opts.hide_input_toggle):
             self.hide_input ^= True
@@ -84,13 +84,7 @@ def on_key(self, key_event: KeyEventType) -> None:
         if not self.hide_input and self.line_edit.on_key(key_event):
             self.commit_line()
         if key_event.matches('enter'):
-            self.write_broadcast_text('\r')
             self.end_line()
-            return
-
-        ek = encode_key_event(key_event)
-        ek = standard_b64encode(ek.encode('utf-8')).decode('ascii')
-        self.write_broadcast_data('kitty-key:' + ek)
 
     def end_line(self) -> None:
         self.print('')
@@ -108,7 +102,7 @@ def write_broadcast_data(self, data: str) -> None:
 
     def write_broadcast_session(self, start: bool = True) -> None:
         self.session_started = start
-        self.write(session_command(self.payload, start))
+        self.write(session_command(self.session_payload if start else self.payload, start))
 
 
 OPTIONS = ('''
@@ -9,6 +9,7 @@ import (
 	"math"
 	"os"
 	"path/filepath"
+	"runtime"
 	"slices"
 	"sort"
 	"strings"
@@ -213,6 +214,93 @@ func as_lower(s string, output []byte) int {
 
 func accept_all(filename string) bool { return true }
 
+type dir_listing struct {
+	entries  []fs.DirEntry
+	mtimes   []time.Time // only present when sorting by last modified
+	err      error
+	is_ready chan struct{}
+}
+
+// Reads directories in parallel, ahead of the breadth first traversal in
+// worker(). The traversal has to consume directories in order so that
+// results are stable, but waiting on the kernel for each directory
+// one at a time is what dominates on large trees.
+type dir_prefetcher struct {
+	mutex      sync.Mutex
+	pending    map[string]*dir_listing
+	queue      chan string
+	keep_going atomic.Bool
+	read       func(path string, ans *dir_listing)
+}
+
+func new_dir_prefetcher(num_workers int, read func(path string, ans *dir_listing)) *dir_prefetcher {
+	ans := &dir_prefetcher{pending: make(map[string]*dir_listing, 1024), queue: make(chan string, 4096), read: read}
+	ans.keep_going.Store(true)
+	for range num_workers {
+		go ans.run()
+	}
+	return ans
+}
+
+func (p *dir_prefetcher) run() {
+	for path := range p.queue {
+		p.mutex.Lock()
+		d := p.pending[path]
+		p.mutex.Unlock()
+		if d != nil {
+			if p.keep_going.Load() {
+				p.read(path, d)
+			}
+			close(d.is_ready)
+		}
+	}
+}
+
+// Queue the directory for reading, does nothing if too many directories are
+// already queued, in which case the directory will be read when needed
+func (p *dir_prefetcher) prefetch(path string) {
+	d := &dir_listing{is_ready: make(chan struct{})}
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	select {
+	case p.queue <- path:
+		p.pending[path] = d
+	default:
+	}
+}
+
+func (p *dir_prefetcher) get(path string) (ans *dir_listing) {
+	p.mutex.Lock()
+	ans = p.pending[path]
+	p.mutex.Unlock()
+	if ans == nil {
+		ans = &dir_listing{}
+		p.read(path, ans)
+		return
+	}
+	<-ans.is_ready
+	p.mutex.Lock()
+	delete(p.pending, path)
+	p.mutex.Unlock()
+	return
+}
+
+func (p *dir_prefetcher) shutdown() {
+	p.keep_going.Store(false)
+	close(p.queue)
+}
+
+func (fss *FileSystemScanner) read_dir(path string, ans *dir_listing) {
+	if ans.entries, ans.err = fss.dir_reader(path); ans.err == nil && fss.sort_by_last_modified {
+		ans.mtimes = make([]time.Time, len(ans.entries))
+		for i, e := range ans.entries {
+			if info, err := e.Info(); err == nil {
+				ans.mtimes[i] = info.ModTime()
+			}
+		}
+	}
+}
+
 func (fss *FileSystemScanner) worker() {
 	defer func() {
 		fss.lock()
@@ -242,13 +330,16 @@ func (fss *FileSystemScanner) worker() {
 	if dot_git == "" {
 		dot_git = ".git"
 	}
+	prefetcher := new_dir_prefetcher(max(1, runtime.NumCPU()-1), fss.read_dir)
+	defer prefetcher.shutdown()
 	// do a breadth first traversal of the filesystem
 	is_root := true
 	for dir != "" {
 		if !fss.keep_going.Load() {
 			break
 		}
-		entries, err := fss.dir_reader(dir)
+		listing := prefetcher.get(dir)
+		entries, err := listing.entries, listing.err
 		if err != nil {
 			if is_root {
 				fss.keep_going.Store(false)
@@ -333,8 +424,8 @@ func (fss *FileSystemScanner) worker() {
 			}
 			if fss.sort_by_last_modified {
 				var ts time.Time
-				if info, err := e.Info(); err == nil {
-					ts = info.ModTime()
+				if listing.mtimes != nil {
+					ts = listing.mtimes[i]
 				}
 				binary.BigEndian.PutUint64(arena[i].buf[1:], uint64(ts.UnixNano()))
 				arena[i].sort_key = arena[i].buf[:1+8]
@@ -381,6 +472,9 @@ func (fss *FileSystemScanner) worker() {
 			i.score.Set_index(idx)
 			i.ignore_files = ignore_files
 			idx++
+			if e.ftype&fs.ModeDir != 0 {
+				prefetcher.prefetch(dir + e.name + string(os.PathSeparator))
+			}
 		}
 		listeners := fss.listeners
 		fss.unlock()
@@ -423,6 +517,18 @@ type FileSystemScorer struct {
 	global_gitignore, global_ignore ignorefiles.IgnoreFile
 	respect_ignores, show_hidden    bool
 	sort_by_last_modified           bool
+	// Whether the item at each index matched the query. When the query is
+	// extended, items that did not match the previous query cannot match
+	// the new one, so they need not be scored again.
+	matched, prev_matched []bool
+}
+
+// Whether every item that matches query also matches prev. Fuzzy matching is
+// subsequence matching, so this is true when query extends prev, as long as
+// the extension cannot combine with the end of prev under normalization.
+func is_query_extension(prev, query string) bool {
+	return prev != "" && len(query) > len(prev) && strings.HasPrefix(query, prev) &&
+		!strings.ContainsFunc(query[len(prev):], func(r rune) bool { return r >= utf8.RuneSelf })
 }
 
 func NewFileSystemScorer(root_dir, query string, filter Filter, only_dirs bool, on_results func(error, bool)) (ans *FileSystemScorer) {
@@ -479,6 +585,8 @@ func (fss *FileSystemScorer) Change_query(query string) {
 		fss.current_worker_wait.Wait()
 	}
 	fss.lock()
+	fss.prev_matched = utils.IfElse(is_query_extension(fss.query, query), fss.matched, nil)
+	fss.matched = nil
 	fss.query = query
 	fss.sorted_results.Clear()
 	fss.unlock()
@@ -497,6 +605,7 @@ func (fss *FileSystemScorer) change_scanner_setting(callback func()) {
 	callback()
 	fss.sorted_results.Clear()
 	fss.scanner = nil
+	fss.matched, fss.prev_matched = nil, nil
 	fss.unlock()
 	fss.Start()
 
@@ -568,15 +677,26 @@ func (fss *FileSystemScorer) worker(on_results chan bool, worker_wait *sync.Wait
 				}
 			}
 		}
+		if len(rp) > 0 && fss.query != "" && fss.prev_matched != nil {
+			prev := fss.prev_matched
+			rp = utils.Filter(rp, func(r *ResultItem) bool {
+				idx := int(r.score.Index())
+				return idx >= len(prev) || prev[idx]
+			})
+		}
 		if len(rp) > 0 {
 			if fss.query != "" {
 				scores, err := fss.scorer.Score(utils.Map(func(r *ResultItem) string { return r.text }, rp), fss.query)
 				if err != nil {
 					return err
 				}
+				if idx := int(rp[len(rp)-1].score.Index()); idx >= len(fss.matched) {
+					fss.matched = append(fss.matched, make([]bool, idx+1-len(fss.matched))...)
+				}
 				for i, r := range rp {
 					r.SetScoreResult(scores[i])
 					r.score.Set_length(uint16(len(r.text)))
+					fss.matched[r.score.Index()] = r.IsMatching()
 				}
 				rp = utils.Filter(rp, func(r *ResultItem) bool { return r.IsMatching() })
 			} else {
@@ -205,7 +205,7 @@ func Encode_bytes(metadata map[string]string, payload []byte) string {
 	ans := strings.Builder{}
 	enc_payload := ""
 	if len(payload) > 0 {
-		enc_payload = base64.StdEncoding.EncodeToString(payload)
+		enc_payload = utils.Base64EncodeToString(payload)
 	}
 	ans.Grow(2048 + len(enc_payload))
 	ans.WriteString("\x1b]")
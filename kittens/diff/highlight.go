@@ -3,10 +3,18 @@
 package diff
 
 import (
+	"crypto/md5"
+	"encoding/hex"
 	"fmt"
+	"io/fs"
 	"os"
+	"path/filepath"
+	"slices"
+	"strings"
 	"sync"
+	"time"
 
+	"github.com/kovidgoyal/kitty"
 	"github.com/kovidgoyal/kitty/tools/highlight"
 	"github.com/kovidgoyal/kitty/tools/utils"
 	"github.com/kovidgoyal/kitty/tools/utils/images"
@@ -29,21 +37,155 @@ var highlighter = sync.OnceValue(func() highlight.Highlighter {
 	return highlight.NewHighlighter(sanitize)
 })
 
-func highlight_all(paths []string, light bool) {
+// On disk cache of highlighted files, so that viewing the same diff again
+// does not need to re-highlight everything. Entries are keyed by the
+// contents of the file and everything else that affects the highlighted
+// output, and are pruned by last use.
+
+const max_highlight_cache_size = 256 * 1024 * 1024
+const max_highlight_cache_age = 30 * 24 * time.Hour
+
+var highlight_cache_dir = sync.OnceValue(func() string {
+	return filepath.Join(utils.CacheDir(), "diff-highlight")
+})
+
+func highlight_cache_path(path string, light bool) (string, error) {
+	hash, err := hash_for_path(path)
+	if err != nil {
+		return "", err
+	}
+	srd := prefer_light_colors(light)
+	// the lexer is chosen based on the file name, see HighlightFile()
+	name := filepath.Base(path)
+	if ext := filepath.Ext(name); ext != "" {
+		if r := conf.Syntax_aliases[strings.ToLower(ext[1:])]; r != "" {
+			name = "file." + r
+		}
+	}
+	h := md5.New()
+	for _, x := range []string{kitty.VersionString, srd.StyleName(), utils.IfElse(light, "light", "dark"), conf.Replace_tab_by, name, hash} {
+		h.Write(utils.UnsafeStringToBytes(x))
+		h.Write([]byte{0})
+	}
+	return filepath.Join(highlight_cache_dir(), hex.EncodeToString(h.Sum(nil))), nil
+}
+
+func read_highlight_cache(path string, light bool) (string, bool) {
+	cpath, err := highlight_cache_path(path, light)
+	if err != nil {
+		return "", false
+	}
+	raw, err := os.ReadFile(cpath)
+	if err != nil {
+		return "", false
+	}
+	now := time.Now()
+	_ = os.Chtimes(cpath, now, now)
+	return utils.UnsafeBytesToString(raw), true
+}
+
+func write_highlight_cache(path string, light bool, highlighted string) {
+	cpath, err := highlight_cache_path(path, light)
+	if err != nil {
+		return
+	}
+	if err = os.MkdirAll(filepath.Dir(cpath), 0o700); err == nil {
+		_ = utils.AtomicWriteFile(cpath, strings.NewReader(highlighted), 0o600)
+	}
+}
+
+func prune_highlight_cache() {
+	type entry struct {
+		path  string
+		size  int64
+		mtime time.Time
+	}
+	dir := highlight_cache_dir()
+	dirents, err := os.ReadDir(dir)
+	if err != nil {
+		return
+	}
+	entries := make([]entry, 0, len(dirents))
+	var total int64
+	now := time.Now()
+	for _, x := range dirents {
+		var info fs.FileInfo
+		if info, err = x.Info(); err != nil || !info.Mode().IsRegular() {
+			continue
+		}
+		e := entry{filepath.Join(dir, x.Name()), info.Size(), info.ModTime()}
+		if now.Sub(e.mtime) > max_highlight_cache_age {
+			os.Remove(e.path)
+			continue
+		}
+		entries = append(entries, e)
+		total += e.size
+	}
+	if total > max_highlight_cache_size {
+		slices.SortFunc(entries, func(a, b entry) int { return a.mtime.Compare(b.mtime) })
+		for _, e := range entries {
+			if total <= max_highlight_cache_size {
+				break
+			}
+			if os.Remove(e.path) == nil {
+				total -= e.size
+			}
+		}
+	}
+}
+
+func set_highlighted_lines(path string, light bool, raw string) {
+	if light {
+		light_highlighted_lines_cache.Set(path, text_to_lines(raw))
+	} else {
+		dark_highlighted_lines_cache.Set(path, text_to_lines(raw))
+	}
+}
+
+// Highlight the specified files, which must be in the order they are
+// displayed in. Files in the on disk cache and then the first few files are
+// done first, after which first_batch_done is called if there are more
+// files to highlight, so that the top of the diff can be redrawn quickly.
+func highlight_all(paths []string, light bool, first_batch_done func()) {
 	ctx := images.Context{}
 	srd := prefer_light_colors(light)
+	cached := make([]bool, len(paths))
 	ctx.Parallel(0, len(paths), func(nums <-chan int) {
 		for i := range nums {
-			path := paths[i]
-			raw, err := highlighter().HighlightFile(path, &srd)
-			if err != nil {
-				continue
-			}
-			if light {
-				light_highlighted_lines_cache.Set(path, text_to_lines(raw))
-			} else {
-				dark_highlighted_lines_cache.Set(path, text_to_lines(raw))
+			if raw, found := read_highlight_cache(paths[i], light); found {
+				set_highlighted_lines(paths[i], light, raw)
+				cached[i] = true
 			}
 		}
 	})
+	pending := make([]string, 0, len(paths))
+	for i, path := range paths {
+		if !cached[i] {
+			pending = append(pending, path)
+		}
+	}
+	highlight_paths := func(paths []string) {
+		ctx.Parallel(0, len(paths), func(nums <-chan int) {
+			for i := range nums {
+				path := paths[i]
+				raw, err := highlighter().HighlightFile(path, &srd)
+				if err != nil {
+					continue
+				}
+				set_highlighted_lines(path, light, raw)
+				write_highlight_cache(path, light, raw)
+			}
+		})
+	}
+	first_batch := pending[:min(len(pending), ctx.EffectiveNumberOfThreads())]
+	highlight_paths(first_batch)
+	if rest := pending[len(first_batch):]; len(rest) > 0 {
+		if first_batch_done != nil {
+			first_batch_done()
+		}
+		highlight_paths(rest)
+	}
+	if len(pending) > 0 {
+		prune_highlight_cache()
+	}
 }
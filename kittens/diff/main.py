@@ -42,7 +42,10 @@ def main(args: list[str]) -> None:
 The diff command to use. Must contain the placeholder :code:`_CONTEXT_` which
 will be replaced by the number of lines of context. A few special values are allowed:
 :code:`auto` will automatically pick an available diff implementation. :code:`builtin`
-will use the anchored diff algorithm from the Go standard library. :code:`git` will
+will use the anchored diff algorithm from the Go standard library. :code:`myers`
+will use a built-in implementation of the Myers diff algorithm that gives the
+same results as :program:`git diff`, without needing to run a separate process
+for each pair of files. :code:`git` will
 use the git command to do the diffing. :code:`diff` will use the diff command to
 do the diffing.
 '''
@@ -0,0 +1,738 @@
+// License: GPLv3 Copyright: 2025, Kovid Goyal, <kovid at kovidgoyal.net>
+
+package diff
+
+import (
+	"bytes"
+	"fmt"
+	"strconv"
+	"strings"
+
+	"github.com/kovidgoyal/kitty/tools/utils"
+)
+
+var _ = fmt.Print
+
+// An in-process implementation of the Myers diff algorithm that produces
+// the same hunks as git diff. It follows the libxdiff implementation used by
+// git: lines that have no match in the other file are discarded before
+// diffing, the search for a minimal diff is abandoned past a cost limit and
+// groups of changed lines are slid to their final positions using git's
+// indent heuristic.
+
+const (
+	myers_max_eq_limit       = 1024
+	myers_simscan_window     = 100
+	myers_kpdis_run          = 4
+	myers_max_cost_min       = 256
+	myers_heur_min_cost      = 256
+	myers_snake_cnt          = 20
+	myers_k_heur             = 4
+	myers_line_max           = int(^uint(0) >> 1)
+	myers_max_funcname_bytes = 80
+)
+
+type myers_file struct {
+	lines []string
+	ids   []int
+	// whether a line is changed, offset by one so that index -1 and
+	// len(lines) are always false
+	rchg []bool
+	// the lines that take part in the diff and their indices in lines
+	ha, rindex []int
+}
+
+func (f *myers_file) changed(i int) bool        { return f.rchg[i+1] }
+func (f *myers_file) set_changed(i int, v bool) { f.rchg[i+1] = v }
+func (f *myers_file) nrec() int                 { return len(f.lines) }
+
+type myers struct {
+	a, b       myers_file
+	kvdf, kvdb []int
+	kv_offset  int
+	mxcost     int
+}
+
+type myers_split struct {
+	i1, i2         int
+	min_lo, min_hi bool
+}
+
+func bogosqrt(n int) int {
+	i := 1
+	for ; n > 0; n >>= 2 {
+		i <<= 1
+	}
+	return i
+}
+
+func new_myers(x, y []string) *myers {
+	ans := &myers{a: myers_file{lines: x}, b: myers_file{lines: y}}
+	ids := make(map[string]int, len(x)+len(y))
+	intern := func(f *myers_file) {
+		f.ids = make([]int, len(f.lines))
+		f.rchg = make([]bool, len(f.lines)+2)
+		for i, line := range f.lines {
+			id, found := ids[line]
+			if !found {
+				id = len(ids)
+				ids[line] = id
+			}
+			f.ids[i] = id
+		}
+	}
+	intern(&ans.a)
+	intern(&ans.b)
+	return ans
+}
+
+// Discard lines that cannot be matched so that they do not take part in the
+// search, see xdl_cleanup_records() in libxdiff
+func (self *myers) cleanup_records() {
+	a, b := &self.a, &self.b
+	// trim the common prefix and suffix
+	dstart, lim := 0, min(a.nrec(), b.nrec())
+	for dstart < lim && a.ids[dstart] == b.ids[dstart] {
+		dstart++
+	}
+	suffix := 0
+	for suffix < lim-dstart && a.ids[a.nrec()-1-suffix] == b.ids[b.nrec()-1-suffix] {
+		suffix++
+	}
+	count_a, count_b := make(map[int]int, a.nrec()), make(map[int]int, b.nrec())
+	for _, id := range a.ids {
+		count_a[id]++
+	}
+	for _, id := range b.ids {
+		count_b[id]++
+	}
+	classify := func(f *myers_file, counts_in_other map[int]int) {
+		dend := f.nrec() - suffix - 1
+		mlim := min(bogosqrt(f.nrec()), myers_max_eq_limit)
+		dis := make([]byte, f.nrec())
+		for i := dstart; i <= dend; i++ {
+			switch nm := counts_in_other[f.ids[i]]; {
+			case nm == 0:
+				dis[i] = 0
+			case nm >= mlim:
+				dis[i] = 2
+			default:
+				dis[i] = 1
+			}
+		}
+		f.ha = make([]int, 0, dend-dstart+1)
+		f.rindex = make([]int, 0, dend-dstart+1)
+		for i := dstart; i <= dend; i++ {
+			if dis[i] == 1 || (dis[i] == 2 && !clean_mmatch(dis, i, dstart, dend)) {
+				f.rindex = append(f.rindex, i)
+				f.ha = append(f.ha, f.ids[i])
+			} else {
+				f.set_changed(i, true)
+			}
+		}
+	}
+	classify(a, count_b)
+	classify(b, count_a)
+}
+
+// Whether the line i, which has many matches in the other file, is
+// surrounded by enough lines that are discarded that it should be discarded
+// too
+func clean_mmatch(dis []byte, i, s, e int) bool {
+	if i-s > myers_simscan_window {
+		s = i - myers_simscan_window
+	}
+	if e-i > myers_simscan_window {
+		e = i + myers_simscan_window
+	}
+	rdis0, rpdis0 := 0, 1
+	for r := 1; i-r >= s; r++ {
+		if dis[i-r] == 0 {
+			rdis0++
+		} else if dis[i-r] == 2 {
+			rpdis0++
+		} else {
+			break
+		}
+	}
+	if rdis0 == 0 {
+		return false
+	}
+	rdis1, rpdis1 := 0, 1
+	for r := 1; i+r <= e; r++ {
+		if dis[i+r] == 0 {
+			rdis1++
+		} else if dis[i+r] == 2 {
+			rpdis1++
+		} else {
+			break
+		}
+	}
+	if rdis1 == 0 {
+		return false
+	}
+	rdis1 += rdis0
+	rpdis1 += rpdis0
+	return rpdis1*myers_kpdis_run < rpdis1+rdis1
+}
+
+// Find the point at which to split the comparison of ha1[off1:lim1] and
+// ha2[off2:lim2], using the middle snake of the Myers algorithm. When the
+// cost becomes too high, a split point that is good enough is used instead.
+func (self *myers) split(off1, lim1, off2, lim2 int, need_min bool) (spl myers_split) {
+	ha1, ha2 := self.a.ha, self.b.ha
+	kvdf, kvdb, o := self.kvdf, self.kvdb, self.kv_offset
+	dmin, dmax := off1-lim2, lim1-off2
+	fmid, bmid := off1-off2, lim1-lim2
+	odd := (fmid-bmid)&1 != 0
+	fmin, fmax, bmin, bmax := fmid, fmid, bmid, bmid
+	kvdf[o+fmid] = off1
+	kvdb[o+bmid] = lim1
+	for ec := 1; ; ec++ {
+		got_snake := false
+		// extend the forward path
+		if fmin > dmin {
+			fmin--
+			kvdf[o+fmin-1] = -1
+		} else {
+			fmin++
+		}
+		if fmax < dmax {
+			fmax++
+			kvdf[o+fmax+1] = -1
+		} else {
+			fmax--
+		}
+		for d := fmax; d >= fmin; d -= 2 {
+			var i1 int
+			if kvdf[o+d-1] >= kvdf[o+d+1] {
+				i1 = kvdf[o+d-1] + 1
+			} else {
+				i1 = kvdf[o+d+1]
+			}
+			prev1 := i1
+			i2 := i1 - d
+			for i1 < lim1 && i2 < lim2 && ha1[i1] == ha2[i2] {
+				i1++
+				i2++
+			}
+			if i1-prev1 > myers_snake_cnt {
+				got_snake = true
+			}
+			kvdf[o+d] = i1
+			if odd && bmin <= d && d <= bmax && kvdb[o+d] <= i1 {
+				return myers_split{i1, i2, true, true}
+			}
+		}
+		// extend the backward path
+		if bmin > dmin {
+			bmin--
+			kvdb[o+bmin-1] = myers_line_max
+		} else {
+			bmin++
+		}
+		if bmax < dmax {
+			bmax++
+			kvdb[o+bmax+1] = myers_line_max
+		} else {
+			bmax--
+		}
+		for d := bmax; d >= bmin; d -= 2 {
+			var i1 int
+			if kvdb[o+d-1] < kvdb[o+d+1] {
+				i1 = kvdb[o+d-1]
+			} else {
+				i1 = kvdb[o+d+1] - 1
+			}
+			prev1 := i1
+			i2 := i1 - d
+			for i1 > off1 && i2 > off2 && ha1[i1-1] == ha2[i2-1] {
+				i1--
+				i2--
+			}
+			if prev1-i1 > myers_snake_cnt {
+				got_snake = true
+			}
+			kvdb[o+d] = i1
+			if !odd && fmin <= d && d <= fmax && i1 <= kvdf[o+d] {
+				return myers_split{i1, i2, true, true}
+			}
+		}
+		if need_min {
+			continue
+		}
+		// if there is a long enough snake that is far enough along, split there
+		if got_snake && ec > myers_heur_min_cost {
+			best := 0
+			for d := fmax; d >= fmin; d -= 2 {
+				dd := d - fmid
+				if dd < 0 {
+					dd = -dd
+				}
+				i1 := kvdf[o+d]
+				i2 := i1 - d
+				v := (i1 - off1) + (i2 - off2) - dd
+				if v > myers_k_heur*ec && v > best && off1+myers_snake_cnt <= i1 && i1 < lim1 && off2+myers_snake_cnt <= i2 && i2 < lim2 {
+					for k := 1; ha1[i1-k] == ha2[i2-k]; k++ {
+						if k == myers_snake_cnt {
+							best = v
+							spl.i1, spl.i2 = i1, i2
+							break
+						}
+					}
+				}
+			}
+			if best > 0 {
+				spl.min_lo, spl.min_hi = true, false
+				return
+			}
+			for d := bmax; d >= bmin; d -= 2 {
+				dd := d - bmid
+				if dd < 0 {
+					dd = -dd
+				}
+				i1 := kvdb[o+d]
+				i2 := i1 - d
+				v := (lim1 - i1) + (lim2 - i2) - dd
+				if v > myers_k_heur*ec && v > best && off1 < i1 && i1 <= lim1-myers_snake_cnt && off2 < i2 && i2 <= lim2-myers_snake_cnt {
+					for k := 0; ha1[i1+k] == ha2[i2+k]; k++ {
+						if k == myers_snake_cnt-1 {
+							best = v
+							spl.i1, spl.i2 = i1, i2
+							break
+						}
+					}
+				}
+			}
+			if best > 0 {
+				spl.min_lo, spl.min_hi = false, true
+				return
+			}
+		}
+		// too expensive, split at the furthest reaching point of either path
+		if ec >= self.mxcost {
+			fbest, fbest1 := -1, -1
+			for d := fmax; d >= fmin; d -= 2 {
+				i1 := min(kvdf[o+d], lim1)
+				i2 := i1 - d
+				if lim2 < i2 {
+					i1, i2 = lim2+d, lim2
+				}
+				if fbest < i1+i2 {
+					fbest, fbest1 = i1+i2, i1
+				}
+			}
+			bbest, bbest1 := myers_line_max, myers_line_max
+			for d := bmax; d >= bmin; d -= 2 {
+				i1 := max(off1, kvdb[o+d])
+				i2 := i1 - d
+				if i2 < off2 {
+					i1, i2 = off2+d, off2
+				}
+				if i1+i2 < bbest {
+					bbest, bbest1 = i1+i2, i1
+				}
+			}
+			if (lim1+lim2)-bbest < fbest-(off1+off2) {
+				return myers_split{fbest1, fbest - fbest1, true, false}
+			}
+			return myers_split{bbest1, bbest - bbest1, false, true}
+		}
+	}
+}
+
+func (self *myers) compare(off1, lim1, off2, lim2 int, need_min bool) {
+	ha1, ha2 := self.a.ha, self.b.ha
+	for off1 < lim1 && off2 < lim2 && ha1[off1] == ha2[off2] {
+		off1++
+		off2++
+	}
+	for off1 < lim1 && off2 < lim2 && ha1[lim1-1] == ha2[lim2-1] {
+		lim1--
+		lim2--
+	}
+	switch {
+	case off1 == lim1:
+		for ; off2 < lim2; off2++ {
+			self.b.set_changed(self.b.rindex[off2], true)
+		}
+	case off2 == lim2:
+		for ; off1 < lim1; off1++ {
+			self.a.set_changed(self.a.rindex[off1], true)
+		}
+	default:
+		spl := self.split(off1, lim1, off2, lim2, need_min)
+		self.compare(off1, spl.i1, off2, spl.i2, spl.min_lo)
+		self.compare(spl.i1, lim1, spl.i2, lim2, spl.min_hi)
+	}
+}
+
+func (self *myers) run() {
+	self.cleanup_records()
+	n1, n2 := len(self.a.ha), len(self.b.ha)
+	ndiags := n1 + n2 + 3
+	self.kvdf = make([]int, ndiags)
+	self.kvdb = make([]int, ndiags)
+	self.kv_offset = n2 + 1
+	self.mxcost = max(bogosqrt(ndiags), myers_max_cost_min)
+	self.compare(0, n1, 0, n2, false)
+	compact_changes(&self.a, &self.b)
+	compact_changes(&self.b, &self.a)
+}
+
+// Sliding groups of changed lines, see xdl_change_compact() in libxdiff {{{
+
+type line_group struct{ start, end int }
+
+func (f *myers_file) group_init() (g line_group) {
+	for f.changed(g.end) {
+		g.end++
+	}
+	return
+}
+
+func (f *myers_file) group_next(g *line_group) bool {
+	if g.end == f.nrec() {
+		return false
+	}
+	g.start = g.end + 1
+	for g.end = g.start; f.changed(g.end); g.end++ {
+	}
+	return true
+}
+
+func (f *myers_file) group_previous(g *line_group) bool {
+	if g.start == 0 {
+		return false
+	}
+	g.end = g.start - 1
+	for g.start = g.end; f.changed(g.start - 1); g.start-- {
+	}
+	return true
+}
+
+func (f *myers_file) group_slide_down(g *line_group) bool {
+	if g.end < f.nrec() && f.ids[g.start] == f.ids[g.end] {
+		f.set_changed(g.start, false)
+		f.set_changed(g.end, true)
+		g.start++
+		g.end++
+		for f.changed(g.end) {
+			g.end++
+		}
+		return true
+	}
+	return false
+}
+
+func (f *myers_file) group_slide_up(g *line_group) bool {
+	if g.start > 0 && f.ids[g.start-1] == f.ids[g.end-1] {
+		g.start--
+		g.end--
+		f.set_changed(g.start, true)
+		f.set_changed(g.end, false)
+		for f.changed(g.start - 1) {
+			g.start--
+		}
+		return true
+	}
+	return false
+}
+
+const (
+	max_indent                          = 200
+	max_blanks                          = 20
+	start_of_file_penalty               = 1
+	end_of_file_penalty                 = 21
+	total_blank_weight                  = -30
+	post_blank_weight                   = 6
+	relative_indent_penalty             = -4
+	relative_indent_with_blank_penalty  = 10
+	relative_outdent_penalty            = 24
+	relative_outdent_with_blank_penalty = 17
+	relative_dedent_penalty             = 23
+	relative_dedent_with_blank_penalty  = 17
+	indent_weight                       = 60
+	indent_heuristic_max_sliding        = 100
+)
+
+func is_space(c byte) bool {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r'
+}
+
+// The indent of the line, -1 if it is blank
+func get_indent(line string) int {
+	ans := 0
+	for i := 0; i < len(line); i++ {
+		c := line[i]
+		if !is_space(c) {
+			return ans
+		}
+		if c == ' ' {
+			ans++
+		} else if c == '\t' {
+			ans += 8 - ans%8
+		}
+		if ans >= max_indent {
+			return max_indent
+		}
+	}
+	return -1
+}
+
+type split_measurement struct {
+	end_of_file                                            bool
+	indent, pre_blank, pre_indent, post_blank, post_indent int
+}
+
+type split_score struct{ effective_indent, penalty int }
+
+func (f *myers_file) measure_split(split int) (m split_measurement) {
+	if split >= f.nrec() {
+		m.end_of_file = true
+		m.indent = -1
+	} else {
+		m.indent = get_indent(f.lines[split])
+	}
+	m.pre_indent = -1
+	for i := split - 1; i >= 0; i-- {
+		if m.pre_indent = get_indent(f.lines[i]); m.pre_indent != -1 {
+			break
+		}
+		if m.pre_blank++; m.pre_blank == max_blanks {
+			m.pre_indent = 0
+			break
+		}
+	}
+	m.post_indent = -1
+	for i := split + 1; i < f.nrec(); i++ {
+		if m.post_indent = get_indent(f.lines[i]); m.post_indent != -1 {
+			break
+		}
+		if m.post_blank++; m.post_blank == max_blanks {
+			m.post_indent = 0
+			break
+		}
+	}
+	return
+}
+
+func (s *split_score) add_split(m split_measurement) {
+	if m.pre_indent == -1 && m.pre_blank == 0 {
+		s.penalty += start_of_file_penalty
+	}
+	if m.end_of_file {
+		s.penalty += end_of_file_penalty
+	}
+	post_blank := 0
+	if m.indent == -1 {
+		post_blank = 1 + m.post_blank
+	}
+	total_blank := m.pre_blank + post_blank
+	s.penalty += total_blank_weight * total_blank
+	s.penalty += post_blank_weight * post_blank
+	indent := m.indent
+	if indent == -1 {
+		indent = m.post_indent
+	}
+	any_blanks := total_blank != 0
+	s.effective_indent += indent
+	switch {
+	case indent == -1, m.pre_indent == -1, indent == m.pre_indent:
+	case indent > m.pre_indent:
+		s.penalty += utils.IfElse(any_blanks, relative_indent_with_blank_penalty, relative_indent_penalty)
+	case m.post_indent != -1 && m.post_indent > indent:
+		s.penalty += utils.IfElse(any_blanks, relative_outdent_with_blank_penalty, relative_outdent_penalty)
+	default:
+		s.penalty += utils.IfElse(any_blanks, relative_dedent_with_blank_penalty, relative_dedent_penalty)
+	}
+}
+
+func (s split_score) cmp(o split_score) int {
+	cmp_indents := 0
+	if s.effective_indent > o.effective_indent {
+		cmp_indents = 1
+	} else if s.effective_indent < o.effective_indent {
+		cmp_indents = -1
+	}
+	return indent_weight*cmp_indents + (s.penalty - o.penalty)
+}
+
+func compact_changes(f, other *myers_file) {
+	g, go_ := f.group_init(), other.group_init()
+	for {
+		if g.end != g.start {
+			var earliest_end, end_matching_other, groupsize int
+			for {
+				groupsize = g.end - g.start
+				end_matching_other = -1
+				// shift the group backwards as far as possible
+				for f.group_slide_up(&g) {
+					other.group_previous(&go_)
+				}
+				earliest_end = g.end
+				if go_.end > go_.start {
+					end_matching_other = g.end
+				}
+				// now shift it forwards as far as possible
+				for f.group_slide_down(&g) {
+					other.group_next(&go_)
+					if go_.end > go_.start {
+						end_matching_other = g.end
+					}
+				}
+				// sliding may have merged the group with others
+				if groupsize == g.end-g.start {
+					break
+				}
+			}
+			switch {
+			case g.end == earliest_end:
+			case end_matching_other != -1:
+				// align the group with a group in the other file
+				for go_.end == go_.start {
+					f.group_slide_up(&g)
+					other.group_previous(&go_)
+				}
+			default:
+				shift := max(earliest_end, g.end-groupsize-1, g.end-indent_heuristic_max_sliding)
+				best_shift := -1
+				var best_score split_score
+				for ; shift <= g.end; shift++ {
+					score := split_score{}
+					score.add_split(f.measure_split(shift))
+					score.add_split(f.measure_split(shift - groupsize))
+					if best_shift == -1 || score.cmp(best_score) <= 0 {
+						best_score, best_shift = score, shift
+					}
+				}
+				for g.end > best_shift {
+					f.group_slide_up(&g)
+					other.group_previous(&go_)
+				}
+			}
+		}
+		if !f.group_next(&g) {
+			break
+		}
+		other.group_next(&go_)
+	}
+}
+
+// }}}
+
+type myers_change struct{ i1, i2, chg1, chg2 int }
+
+func (self *myers) changes() (ans []myers_change) {
+	a, b := &self.a, &self.b
+	for i1, i2 := 0, 0; i1 < a.nrec() || i2 < b.nrec(); {
+		if a.changed(i1) || b.changed(i2) {
+			c := myers_change{i1: i1, i2: i2}
+			for ; a.changed(i1); i1++ {
+			}
+			for ; b.changed(i2); i2++ {
+			}
+			c.chg1, c.chg2 = i1-c.i1, i2-c.i2
+			ans = append(ans, c)
+		} else {
+			i1++
+			i2++
+		}
+	}
+	return
+}
+
+// The function name used as the title of hunks, see def_ff() in git
+func funcname_for_line(line string) (string, bool) {
+	if len(line) == 0 {
+		return "", false
+	}
+	if c := line[0]; !(('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_' || c == '$') {
+		return "", false
+	}
+	if idx := strings.IndexByte(line, '\n'); idx > -1 {
+		line = line[:idx]
+	}
+	if len(line) > myers_max_funcname_bytes {
+		line = line[:myers_max_funcname_bytes]
+	}
+	return strings.TrimRightFunc(line, func(r rune) bool { return r < 128 && is_space(byte(r)) }), true
+}
+
+func write_hunk_range(out *bytes.Buffer, start, count int) {
+	if count == 0 {
+		start--
+	}
+	out.WriteString(strconv.Itoa(start))
+	if count != 1 {
+		out.WriteByte(',')
+		out.WriteString(strconv.Itoa(count))
+	}
+}
+
+// MyersDiff returns the diff of old and new in the unified diff format,
+// with the same hunks as git diff. If old and new are identical it returns
+// nil.
+func MyersDiff(oldName, old, newName, new string, num_of_context_lines int) []byte {
+	if old == new {
+		return nil
+	}
+	x, y := lines(old), lines(new)
+	m := new_myers(x, y)
+	m.run()
+	changes := m.changes()
+	var out bytes.Buffer
+	fmt.Fprintf(&out, "diff %s %s\n", oldName, newName)
+	fmt.Fprintf(&out, "--- %s\n", oldName)
+	fmt.Fprintf(&out, "+++ %s\n", newName)
+	C := num_of_context_lines
+	funcname, funcline_prev := "", -1
+	for first := 0; first < len(changes); {
+		// changes separated by no more than twice the context are in the same hunk
+		last := first
+		for last+1 < len(changes) && changes[last+1].i1-(changes[last].i1+changes[last].chg1) <= 2*C {
+			last++
+		}
+		fc, lc := changes[first], changes[last]
+		s1, s2 := max(fc.i1-C, 0), max(fc.i2-C, 0)
+		e1, e2 := min(lc.i1+lc.chg1+C, len(x)), min(lc.i2+lc.chg2+C, len(y))
+		for l := s1 - 1; l > funcline_prev && l >= 0; l-- {
+			if q, found := funcname_for_line(x[l]); found {
+				funcname = q
+				break
+			}
+		}
+		funcline_prev = s1 - 1
+		out.WriteString("@@ -")
+		write_hunk_range(&out, s1+1, e1-s1)
+		out.WriteString(" +")
+		write_hunk_range(&out, s2+1, e2-s2)
+		out.WriteString(" @@")
+		if funcname != "" {
+			out.WriteByte(' ')
+			out.WriteString(funcname)
+		}
+		out.WriteByte('\n')
+		for ; s2 < fc.i2; s2++ {
+			out.WriteString(" " + y[s2])
+		}
+		for i := first; i <= last; i++ {
+			c := changes[i]
+			for ; s2 < c.i2; s2++ {
+				out.WriteString(" " + y[s2])
+			}
+			for _, line := range x[c.i1 : c.i1+c.chg1] {
+				out.WriteString("-" + line)
+			}
+			for _, line := range y[c.i2 : c.i2+c.chg2] {
+				out.WriteString("+" + line)
+			}
+			s2 = c.i2 + c.chg2
+		}
+		for ; s2 < e2; s2++ {
+			out.WriteString(" " + y[s2])
+		}
+		first = last + 1
+	}
+	return out.Bytes()
+}
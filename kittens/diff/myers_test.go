@@ -0,0 +1,76 @@
+// License: GPLv3 Copyright: 2025, Kovid Goyal, <kovid at kovidgoyal.net>
+
+package diff
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+
+	"github.com/google/go-cmp/cmp"
+)
+
+var _ = fmt.Print
+
+func TestMyersDiff(t *testing.T) {
+	hunks := func(patch []byte) string {
+		_, ans, _ := strings.Cut(string(patch), "+++ b\n")
+		return ans
+	}
+	// the expected output is what git diff produces
+	tc := func(old, new string, context int, expected string) {
+		t.Helper()
+		if diff := cmp.Diff(expected, hunks(MyersDiff("a", old, "b", new, context))); diff != "" {
+			t.Fatalf("Diff of %#v and %#v is incorrect:\n%s", old, new, diff)
+		}
+	}
+	if MyersDiff("a", "x\n", "b", "x\n", 3) != nil {
+		t.Fatalf("Diff of identical text is not nil")
+	}
+	tc("", "x\ny\n", 3, "@@ -0,0 +1,2 @@\n+x\n+y\n")
+	tc("x\ny\n", "", 3, "@@ -1,2 +0,0 @@\n-x\n-y\n")
+	tc("a\nb", "a\nc", 3, "@@ -1,2 +1,2 @@\n a\n-b\n\\ No newline at end of file\n+c\n\\ No newline at end of file\n")
+	tc("1\n2\n3\n4\n5\n6\n7\n8\n9\n", "1\nx\n3\n4\n5\n6\n7\n8\ny\n", 1, "@@ -1,3 +1,3 @@\n 1\n-2\n+x\n 3\n@@ -8,2 +8,2 @@\n 8\n-9\n+y\n")
+	tc("1\n2\n3\n4\n5\n6\n7\n8\n9\n", "1\nx\n3\n4\n5\n6\n7\n8\ny\n", 3, "@@ -1,9 +1,9 @@\n 1\n-2\n+x\n 3\n 4\n 5\n 6\n 7\n 8\n-9\n+y\n")
+	// the added function is placed using the indent heuristic and the hunk
+	// title is the preceding function
+	tc(
+		"package main\n\nimport \"fmt\"\n\nfunc a() {\n\tfmt.Println(\"a\")\n}\n\nfunc b() {\n\tx := 1\n\tfmt.Println(x)\n}\n",
+		"package main\n\nimport \"fmt\"\n\nfunc a() {\n\tfmt.Println(\"a\")\n}\n\nfunc c() {\n\tfmt.Println(\"c\")\n}\n\nfunc b() {\n\tx := 2\n\tfmt.Println(x)\n}\n",
+		1,
+		"@@ -8,4 +8,8 @@ func a() {\n \n+func c() {\n+\tfmt.Println(\"c\")\n+}\n+\n func b() {\n-\tx := 1\n+\tx := 2\n \tfmt.Println(x)\n")
+}
+
+func TestMyersDiffMatchesGit(t *testing.T) {
+	// Each directory in testdata has a pair of files, a and b, and the
+	// output of git diff --no-index -U<n> a b for them in U<n>.patch
+	dirs, err := filepath.Glob(filepath.Join("testdata", "*"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(dirs) == 0 {
+		t.Fatalf("No diff fixtures found")
+	}
+	read := func(path string) string {
+		t.Helper()
+		data, err := os.ReadFile(path)
+		if err != nil {
+			t.Fatal(err)
+		}
+		return string(data)
+	}
+	for _, dir := range dirs {
+		old, new := read(filepath.Join(dir, "a")), read(filepath.Join(dir, "b"))
+		for _, context := range []int{0, 1, 3} {
+			git := read(filepath.Join(dir, fmt.Sprintf("U%d.patch", context)))
+			// drop the git specific header lines
+			expected := git[strings.Index(git, "\n@@ ")+1:]
+			_, actual, _ := strings.Cut(string(MyersDiff("a", old, "b", new, context)), "+++ b\n")
+			if diff := cmp.Diff(expected, actual); diff != "" {
+				t.Fatalf("Diff of %s at context %d does not match git:\n%s", dir, context, diff)
+			}
+		}
+	}
+}
@@ -41,12 +41,21 @@ func find_differ() {
 	}
 }
 
+// The in-process implementation to use when diff_cmd is empty
+var builtin_differ = Diff
+
 func set_diff_command(q string) error {
+	builtin_differ = Diff
 	switch q {
 	case "auto":
 		find_differ()
 	case "builtin", "":
 		diff_cmd = []string{}
+	case "myers":
+		// diffing in process avoids spawning a process per pair of files,
+		// and gives the same hunks as git
+		diff_cmd = []string{}
+		builtin_differ = MyersDiff
 	case "diff":
 		diff_cmd, _ = shlex.Split(DIFF_DIFF)
 	case "git":
@@ -300,7 +309,7 @@ func run_diff(file1, file2 string, num_of_context_lines int) (ok, is_different b
 		if err != nil {
 			return false, false, "", err
 		}
-		patchb := Diff(path1, data1, path2, data2, num_of_context_lines)
+		patchb := builtin_differ(path1, data1, path2, data2, num_of_context_lines)
 		if patchb == nil {
 			return true, false, "", nil
 		}
@@ -54,9 +54,52 @@ type ScreenLine struct {
 	left, right HalfScreenLine
 }
 
+type pending_half_line struct {
+	margin_text, text string
+	ltype             string
+	is_filler         bool
+}
+
+// A line of text that fits in a single screen line. Wrapping and formatting
+// it is deferred until it is actually needed, so that diffs with very large
+// numbers of lines only pay for the lines that are displayed.
+type pending_screen_line struct {
+	left, right    pending_half_line
+	center         Center
+	available_cols int
+}
+
+func (self *pending_half_line) render(center Center, available_cols int) (ans HalfScreenLine) {
+	ans.marked_up_margin_text, ans.is_filler = self.margin_text, self.is_filler
+	if self.ltype == "" {
+		ans.marked_up_text = self.text
+		return
+	}
+	line := self.text
+	size := center.left_size
+	if self.ltype != "remove" {
+		size = center.right_size
+	}
+	if size > 0 {
+		line = sgr.InsertFormatting(line, center_span(self.ltype, center.offset, size))
+	}
+	ans.marked_up_text = splitlines(line, available_cols)[0]
+	return
+}
+
+func (self *pending_screen_line) render() *ScreenLine {
+	return &ScreenLine{left: self.left.render(self.center, self.available_cols), right: self.right.render(self.center, self.available_cols)}
+}
+
+// Whether text is guaranteed to wrap into exactly one screen line
+func fits_in_one_screen_line(text string, available_cols int) bool {
+	return available_cols > 2 && wcswidth.Stringwidth(text) < available_cols
+}
+
 type LogicalLine struct {
 	line_type                       LineType
 	screen_lines                    []*ScreenLine
+	pending                         *pending_screen_line
 	is_full_width                   bool
 	is_change_start                 bool
 	left_reference, right_reference Reference
@@ -67,11 +110,26 @@ type LogicalLine struct {
 	image_lines_offset int
 }
 
+func (self *LogicalLine) ScreenLines() []*ScreenLine {
+	if self.pending != nil {
+		self.screen_lines = []*ScreenLine{self.pending.render()}
+		self.pending = nil
+	}
+	return self.screen_lines
+}
+
+func (self *LogicalLine) NumScreenLines() int {
+	if self.pending != nil {
+		return 1
+	}
+	return len(self.screen_lines)
+}
+
 func (self *LogicalLine) render_screen_line(n int, lp *loop.Loop, margin_size, columns int) {
-	if n >= len(self.screen_lines) || n < 0 {
+	if n >= self.NumScreenLines() || n < 0 {
 		return
 	}
-	sl := self.screen_lines[n]
+	sl := self.ScreenLines()[n]
 	available_cols := columns/2 - margin_size
 	if self.is_full_width {
 		available_cols = columns - margin_size
@@ -124,8 +182,8 @@ func (self *LogicalLine) render_screen_line(n int, lp *loop.Loop, margin_size, c
 }
 
 func (self *LogicalLine) IncrementScrollPosBy(pos *ScrollPos, amt int) (delta int) {
-	if len(self.screen_lines) > 0 {
-		npos := utils.Max(0, utils.Min(pos.screen_line+amt, len(self.screen_lines)-1))
+	if n := self.NumScreenLines(); n > 0 {
+		npos := utils.Max(0, utils.Min(pos.screen_line+amt, n-1))
 		delta = npos - pos.screen_line
 		pos.screen_line = npos
 	}
@@ -311,8 +369,8 @@ func (self *LogicalLines) At(i int) *LogicalLine { return self.lines[i] }
 func (self *LogicalLines) ScreenLineAt(pos ScrollPos) *ScreenLine {
 	if pos.logical_line < len(self.lines) && pos.logical_line >= 0 {
 		line := self.lines[pos.logical_line]
-		if pos.screen_line < len(line.screen_lines) && pos.screen_line >= 0 {
-			return self.lines[pos.logical_line].screen_lines[pos.screen_line]
+		if pos.screen_line < line.NumScreenLines() && pos.screen_line >= 0 {
+			return line.ScreenLines()[pos.screen_line]
 		}
 	}
 	return nil
@@ -338,11 +396,11 @@ func (self *LogicalLines) Minus(a, b ScrollPos) (delta int) {
 		line := self.lines[i]
 		switch i {
 		case a.logical_line:
-			delta += utils.Max(0, len(line.screen_lines)-a.screen_line)
+			delta += utils.Max(0, line.NumScreenLines()-a.screen_line)
 		case b.logical_line:
 			delta += b.screen_line
 		default:
-			delta += len(line.screen_lines)
+			delta += line.NumScreenLines()
 		}
 	}
 	return delta * amt
@@ -368,7 +426,7 @@ func (self *LogicalLines) IncrementScrollPosBy(pos *ScrollPos, amt int) (delta i
 			if one > 0 {
 				pos.screen_line = 0
 			} else {
-				pos.screen_line = len(self.lines[nlp].screen_lines) - 1
+				pos.screen_line = self.lines[nlp].NumScreenLines() - 1
 			}
 			delta += one
 			amt -= one
@@ -549,6 +607,14 @@ func lines_for_context_chunk(data *DiffData, _ int, chunk *Chunk, _ int, ans []*
 		}
 		left_line_number_s := strconv.Itoa(left_line_number + 1)
 		right_line_number_s := strconv.Itoa(right_line_number + 1)
+		if text := data.left_lines[left_line_number]; fits_in_one_screen_line(text, data.available_cols) {
+			ll.pending = &pending_screen_line{available_cols: data.available_cols,
+				left:  pending_half_line{margin_text: left_line_number_s, text: text, ltype: "context"},
+				right: pending_half_line{margin_text: right_line_number_s, text: text, ltype: "context"},
+			}
+			ans = append(ans, &ll)
+			continue
+		}
 		for _, text := range splitlines(data.left_lines[left_line_number], data.available_cols) {
 			left_line := HalfScreenLine{marked_up_margin_text: left_line_number_s, marked_up_text: text}
 			right_line := left_line
@@ -584,6 +650,29 @@ func render_half_line(line_number int, line, ltype string, available_cols int, c
 	return ans
 }
 
+func pending_diff_line(data *DiffData, chunk *Chunk, i int, center Center) *pending_screen_line {
+	ans := pending_screen_line{center: center, available_cols: data.available_cols}
+	if i < chunk.left_count {
+		lnum := chunk.left_start + i
+		if !fits_in_one_screen_line(data.left_lines[lnum], data.available_cols) {
+			return nil
+		}
+		ans.left = pending_half_line{margin_text: strconv.Itoa(lnum + 1), text: data.left_lines[lnum], ltype: "remove"}
+	} else {
+		ans.left.is_filler = true
+	}
+	if i < chunk.right_count {
+		lnum := chunk.right_start + i
+		if !fits_in_one_screen_line(data.right_lines[lnum], data.available_cols) {
+			return nil
+		}
+		ans.right = pending_half_line{margin_text: strconv.Itoa(lnum + 1), text: data.right_lines[lnum], ltype: "add"}
+	} else {
+		ans.right.is_filler = true
+	}
+	return &ans
+}
+
 func lines_for_diff_chunk(data *DiffData, _ int, chunk *Chunk, _ int, ans []*LogicalLine) []*LogicalLine {
 	common := utils.Min(chunk.left_count, chunk.right_count)
 	ll, rl := make([]HalfScreenLine, 0, 32), make([]HalfScreenLine, 0, 32)
@@ -594,6 +683,21 @@ func lines_for_diff_chunk(data *DiffData, _ int, chunk *Chunk, _ int, ans []*Log
 		if i < len(chunk.centers) {
 			center = chunk.centers[i]
 		}
+		if p := pending_diff_line(data, chunk, i, center); p != nil {
+			left_lnum, right_lnum = 0, 0
+			if i < chunk.left_count {
+				left_lnum = chunk.left_start + i + 1
+			}
+			if i < chunk.right_count {
+				right_lnum = chunk.right_start + i + 1
+			}
+			ans = append(ans, &LogicalLine{
+				line_type: CHANGE_LINE, is_change_start: i == 0, pending: p,
+				left_reference:  Reference{path: data.left_path, linenum: left_lnum},
+				right_reference: Reference{path: data.left_path, linenum: right_lnum},
+			})
+			continue
+		}
 		if i < chunk.left_count {
 			left_lnum = chunk.left_start + i
 			ll = render_half_line(left_lnum, data.left_lines[left_lnum], "remove", data.available_cols, center, ll)
@@ -714,6 +818,27 @@ func all_lines(path string, columns, margin_size int, is_add bool, ans []*Logica
 		msg_lines = splitlines(`This file was removed`, available_cols)
 	}
 	for line_number, line := range lines {
+		if fits_in_one_screen_line(line, available_cols) {
+			l := ll
+			l.is_change_start = line_number == 0
+			p := pending_screen_line{available_cols: available_cols}
+			half := pending_half_line{margin_text: strconv.Itoa(line_number + 1), text: line, ltype: ltype}
+			filler := pending_half_line{is_filler: true}
+			if len(msg_lines) > 0 {
+				filler.text = msg_lines[0]
+				msg_lines = msg_lines[1:]
+			}
+			if is_add {
+				l.right_reference.linenum = line_number + 1
+				p.left, p.right = filler, half
+			} else {
+				l.left_reference.linenum = line_number + 1
+				p.left, p.right = half, filler
+			}
+			l.pending = &p
+			ans = append(ans, &l)
+			continue
+		}
 		hlines := make([]HalfScreenLine, 0, 8)
 		hlines = render_half_line(line_number, line, ltype, available_cols, Center{}, hlines)
 		l := ll
@@ -723,12 +848,12 @@ func all_lines(path string, columns, margin_size int, is_add bool, ans []*Logica
 			l.left_reference.linenum = line_number + 1
 		}
 		l.is_change_start = line_number == 0
-		for i, hl := range hlines {
+		for _, hl := range hlines {
 			sl := ScreenLine{}
 			if is_add {
 				sl.right = hl
 				if len(msg_lines) > 0 {
-					sl.left.marked_up_text = msg_lines[i]
+					sl.left.marked_up_text = msg_lines[0]
 					sl.left.is_filler = true
 					msg_lines = msg_lines[1:]
 				} else {
@@ -737,7 +862,7 @@ func all_lines(path string, columns, margin_size int, is_add bool, ans []*Logica
 			} else {
 				sl.left = hl
 				if len(msg_lines) > 0 {
-					sl.right.marked_up_text = msg_lines[i]
+					sl.right.marked_up_text = msg_lines[0]
 					sl.right.is_filler = true
 					msg_lines = msg_lines[1:]
 				} else {
@@ -81,6 +81,13 @@ func (self *Search) find_matches_in_lines(clean_lines []string, origin int, send
 func (self *Search) find_matches_in_line(line *LogicalLine, margin_size, cols int, send_result func(screen_line, offset, size int)) {
 	half_width := cols / 2
 	right_offset := half_width + margin_size
+	if p := line.pending; p != nil {
+		// no need to wrap and format lines that fit on a single screen line
+		// just to search them
+		self.find_matches_in_lines([]string{wcswidth.StripEscapeCodes(p.left.text)}, margin_size, send_result)
+		self.find_matches_in_lines([]string{wcswidth.StripEscapeCodes(p.right.text)}, right_offset, send_result)
+		return
+	}
 	left_clean_lines, right_clean_lines := make([]string, len(line.screen_lines)), make([]string, len(line.screen_lines))
 	for i, sl := range line.screen_lines {
 		if line.is_full_width {
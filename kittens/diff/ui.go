@@ -230,13 +230,30 @@ func (self *Handler) highlight_all() {
 	} else {
 		dark_highlight_started = true
 	}
-	text_files := utils.Filter(self.collection.paths_to_highlight.AsSlice(), is_path_text)
+	// highlight files in the order they are displayed in so that the top of
+	// the diff is highlighted first
+	text_files := make([]string, 0, self.collection.paths_to_highlight.Len())
+	seen := utils.NewSet[string](self.collection.paths_to_highlight.Len())
+	add := func(path string) {
+		if path != "" && !seen.Has(path) && self.collection.paths_to_highlight.Has(path) && is_path_text(path) {
+			seen.Add(path)
+			text_files = append(text_files, path)
+		}
+	}
+	_ = self.collection.Apply(func(path, item_type, changed_path string) error {
+		add(path)
+		add(changed_path)
+		return nil
+	})
+	light := use_light_colors
 	go func() {
 		self.lp.RecoverFromPanicInGoRoutine()
-		r := AsyncResult{rtype: HIGHLIGHT}
-		highlight_all(text_files, use_light_colors)
-		self.async_results <- r
-		self.lp.WakeupMainThread()
+		notify := func() {
+			self.async_results <- AsyncResult{rtype: HIGHLIGHT}
+			self.lp.WakeupMainThread()
+		}
+		highlight_all(text_files, light, notify)
+		notify()
 	}()
 }
 
@@ -367,7 +384,7 @@ func (self *Handler) render_diff() (err error) {
 	last := self.logical_lines.Len() - 1
 	self.max_scroll_pos.logical_line = last
 	if last > -1 {
-		self.max_scroll_pos.screen_line = len(self.logical_lines.At(last).screen_lines) - 1
+		self.max_scroll_pos.screen_line = self.logical_lines.At(last).NumScreenLines() - 1
 	} else {
 		self.max_scroll_pos.screen_line = 0
 	}
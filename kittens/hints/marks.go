@@ -51,10 +51,12 @@ type Mark struct {
 }
 
 func process_escape_codes(text string) (ans string, hyperlinks []Mark) {
-	removed_size, idx := 0, 0
+	idx := 0
 	active_hyperlink_url := ""
 	active_hyperlink_id := ""
 	active_hyperlink_start_offset := 0
+	buf := strings.Builder{}
+	buf.Grow(len(text))
 
 	add_hyperlink := func(end int) {
 		hyperlinks = append(hyperlinks, Mark{
@@ -63,14 +65,50 @@ func process_escape_codes(text string) (ans string, hyperlinks []Mark) {
 		active_hyperlink_start_offset = 0
 		idx++
 	}
+	// returns the length of the SGR or OSC escape code at the start of text
+	// or zero if there is none
+	escape_code_length := func(text string) int {
+		if len(text) < 2 {
+			return 0
+		}
+		switch text[1] {
+		case '[':
+			for i := 2; i < len(text); i++ {
+				switch ch := text[i]; {
+				case ch == 'm':
+					return i + 1
+				case ch != ';' && ch != ':' && (ch < '0' || ch > '9'):
+					return 0
+				}
+			}
+		case ']':
+			if end := strings.Index(text[2:], "\x1b\\"); end > -1 && strings.IndexByte(text[2:2+end], '\n') < 0 {
+				return end + 4
+			}
+		}
+		return 0
+	}
 
-	ans = utils.ReplaceAll(utils.MustCompile("\x1b(?:\\[[0-9;:]*?m|\\].*?\x1b\\\\)"), text, func(raw string, groupdict map[string]utils.SubMatch) string {
+	for {
+		i := strings.IndexByte(text, 0x1b)
+		if i < 0 {
+			buf.WriteString(text)
+			break
+		}
+		buf.WriteString(text[:i])
+		text = text[i:]
+		n := escape_code_length(text)
+		if n == 0 {
+			buf.WriteByte(0x1b)
+			text = text[1:]
+			continue
+		}
+		raw := text[:n]
+		text = text[n:]
 		if !strings.HasPrefix(raw, "\x1b]8") {
-			removed_size += len(raw)
-			return ""
+			continue
 		}
-		start := groupdict[""].Start - removed_size
-		removed_size += len(raw)
+		start := buf.Len()
 		if active_hyperlink_url != "" {
 			add_hyperlink(start)
 		}
@@ -86,8 +124,8 @@ func process_escape_codes(text string) (ans string, hyperlinks []Mark) {
 				}
 			}
 		}
-		return ""
-	})
+	}
+	ans = buf.String()
 	if active_hyperlink_url != "" {
 		add_hyperlink(len(ans))
 	}
@@ -413,7 +451,9 @@ type Group struct {
 
 func (self Group) LastCapture() Capture {
 	if len(self.Captures) == 0 {
-		return Capture{}
+		ans := Capture{}
+		ans.Byte_Offsets.Start, ans.Byte_Offsets.End = -1, -1
+		return ans
 	}
 	return self.Captures[len(self.Captures)-1]
 }
@@ -435,6 +475,26 @@ func (self Match) HasNamedGroups() bool {
 	return false
 }
 
+// Matching with the linear time RE2 engine from the standard library, used
+// for all patterns that do not need backtracking features such as lookarounds
+func find_all_matches_re2(re *regexp.Regexp, text string) (ans []Match) {
+	names := re.SubexpNames()
+	for _, m := range re.FindAllStringSubmatchIndex(text, -1) {
+		match := Match{Groups: make([]Group, len(names))}
+		for i, name := range names {
+			g := &match.Groups[i]
+			g.Name, g.IsNamed = utils.IfElse(name == "", strconv.Itoa(i), name), name != ""
+			if start, end := m[2*i], m[2*i+1]; start > -1 {
+				c := Capture{Text: text[start:end]}
+				c.Byte_Offsets.Start, c.Byte_Offsets.End = start, end
+				g.Captures = []Capture{c}
+			}
+		}
+		ans = append(ans, match)
+	}
+	return
+}
+
 func find_all_matches(re *regexp2.Regexp, text string) (ans []Match, err error) {
 	m, err := re.FindStringMatch(text)
 	if err != nil {
@@ -490,9 +550,8 @@ func find_all_matches(re *regexp2.Regexp, text string) (ans []Match, err error)
 	return
 }
 
-func mark(r *regexp2.Regexp, post_processors []PostProcessorFunc, group_processors []GroupProcessorFunc, text string, opts *Options) (ans []Mark) {
+func mark(all_matches []Match, post_processors []PostProcessorFunc, group_processors []GroupProcessorFunc, text string, opts *Options) (ans []Mark) {
 	sanitize_pat := regexp.MustCompile("[\r\n\x00]")
-	all_matches, _ := find_all_matches(r, text)
 	for i, m := range all_matches {
 		full_capture := m.Groups[0].LastCapture()
 		match_start, match_end := full_capture.Byte_Offsets.Start, full_capture.Byte_Offsets.End
@@ -533,10 +592,11 @@ func mark(r *regexp2.Regexp, post_processors []PostProcessorFunc, group_processo
 		}
 		if opts.Type == "regex" && len(m.Groups) > 1 && !m.HasNamedGroups() {
 			cp := m.Groups[1].LastCapture()
-			ms, me := cp.Byte_Offsets.Start, cp.Byte_Offsets.End
-			match_start = max(match_start, ms)
-			match_end = min(match_end, me)
-			full_match = sanitize_pat.ReplaceAllLiteralString(text[match_start:match_end], "")
+			if ms, me := cp.Byte_Offsets.Start, cp.Byte_Offsets.End; ms > -1 && me > -1 {
+				match_start = max(match_start, ms)
+				match_end = min(match_end, me)
+				full_match = sanitize_pat.ReplaceAllLiteralString(text[match_start:match_end], "")
+			}
 		}
 		if full_match != "" {
 			ans = append(ans, Mark{
@@ -654,11 +714,20 @@ func find_marks(text string, opts *Options, cli_args ...string) (sanitized_text
 		if err != nil {
 			return err
 		}
-		r, err := regexp2.Compile(pattern, regexp2.RE2)
-		if err != nil {
-			return fmt.Errorf("Failed to compile the regex pattern: %#v with error: %w", pattern, err)
+		var all_matches []Match
+		// In RE2 mode regexp2 uses the same character classes as the standard
+		// library, so both engines give the same matches for patterns both
+		// support
+		if r, err := regexp.Compile(pattern); err == nil {
+			all_matches = find_all_matches_re2(r, sanitized_text)
+		} else {
+			r, err := regexp2.Compile(pattern, regexp2.RE2)
+			if err != nil {
+				return fmt.Errorf("Failed to compile the regex pattern: %#v with error: %w", pattern, err)
+			}
+			all_matches, _ = find_all_matches(r, sanitized_text)
 		}
-		ans = mark(r, post_processors, group_processors, sanitized_text, opts)
+		ans = mark(all_matches, post_processors, group_processors, sanitized_text, opts)
 		used_pattern = pattern
 		return nil
 	}
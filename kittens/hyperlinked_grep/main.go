@@ -3,6 +3,7 @@
 package hyperlinked_grep
 
 import (
+	"bufio"
 	"bytes"
 	"errors"
 	"fmt"
@@ -10,7 +11,6 @@ import (
 	"os"
 	"os/exec"
 	"path/filepath"
-	"regexp"
 	"strings"
 	"sync"
 	"unicode"
@@ -268,6 +268,7 @@ func parse_args(args ...string) (delegate_to_rg bool, sanitized_args []string, k
 type stdout_filter struct {
 	prefix       []byte
 	process_line func(string)
+	output       *bufio.Writer
 }
 
 func (self *stdout_filter) Write(p []byte) (n int, err error) {
@@ -287,9 +288,104 @@ func (self *stdout_filter) Write(p []byte) (n int, err error) {
 		self.process_line(utils.UnsafeBytesToString(line))
 		self.prefix = self.prefix[:0]
 	}
+	// flush once per chunk of output from rg rather than once per line
+	if self.output != nil {
+		err = self.output.Flush()
+	}
+	return
+}
+
+// remove_escape_codes removes all escape codes that start with ESC
+// introducer and end with terminator from text. It returns text itself when
+// there is nothing to remove, otherwise the result is built in *buf.
+func remove_escape_codes(text string, introducer byte, terminator string, buf *[]byte) string {
+	idx := find_escape_code(text, introducer)
+	if idx < 0 {
+		return text
+	}
+	ans := (*buf)[:0]
+	for idx > -1 {
+		end := strings.Index(text[idx+2:], terminator)
+		if end < 0 {
+			break
+		}
+		ans = append(ans, text[:idx]...)
+		text = text[idx+2+end+len(terminator):]
+		idx = find_escape_code(text, introducer)
+	}
+	ans = append(ans, text...)
+	*buf = ans
+	return utils.UnsafeBytesToString(ans)
+}
+
+func find_escape_code(text string, introducer byte) int {
+	for offset := 0; ; {
+		idx := strings.IndexByte(text[offset:], 0x1b)
+		if idx < 0 {
+			return -1
+		}
+		idx += offset
+		if idx+1 < len(text) && text[idx+1] == introducer {
+			return idx
+		}
+		offset = idx + 1
+	}
+}
+
+func is_stats_line(line string) bool {
+	n := num_leading_digits(line)
+	return n > 0 && line[n:] == " matches"
+}
+
+// split_path_and_count splits lines of the form path:count at the first colon
+// followed by a digit
+func split_path_and_count(line string) (path, count string, found bool) {
+	for offset := 0; ; {
+		idx := strings.IndexByte(line[offset:], ':')
+		if idx < 0 {
+			return
+		}
+		idx += offset
+		if n := num_leading_digits(line[idx+1:]); n > 0 {
+			return line[:idx], line[idx+1 : idx+1+n], true
+		}
+		offset = idx + 1
+	}
+}
+
+func num_leading_digits(text string) (n int) {
+	for n < len(text) && '0' <= text[n] && text[n] <= '9' {
+		n++
+	}
 	return
 }
 
+// split_path_and_line_number splits lines of the form path:line:text or, when
+// with_column is true, path:line:column:text, using the first colon that
+// results in a valid split
+func split_path_and_line_number(line string, with_column bool) (path, line_number string, found bool) {
+	for offset := 0; ; {
+		idx := strings.IndexByte(line[offset:], ':')
+		if idx < 0 {
+			return
+		}
+		idx += offset
+		offset = idx + 1
+		rest := line[idx+1:]
+		n := num_leading_digits(rest)
+		if n == 0 || n >= len(rest) || rest[n] != ':' {
+			continue
+		}
+		if with_column {
+			col := rest[n+1:]
+			if c := num_leading_digits(col); c == 0 || c >= len(col) || col[c] != ':' {
+				continue
+			}
+		}
+		return line[:idx], rest[:n], true
+	}
+}
+
 func main(_ *cli.Command, _ *Options, args []string) (rc int, err error) {
 	delegate_to_rg, sanitized_args, kitten_opts, err := parse_args(args...)
 	if err != nil {
@@ -308,33 +404,36 @@ func main(_ *cli.Command, _ *Options, args []string) (rc int, err error) {
 	cmd := exec.Command(RgExe(), cmdline...)
 	cmd.Stdin = os.Stdin
 	cmd.Stderr = os.Stderr
-	buf := stdout_filter{prefix: make([]byte, 0, 8*1024)}
+	output := bufio.NewWriterSize(os.Stdout, 64*1024)
+	defer output.Flush()
+	buf := stdout_filter{prefix: make([]byte, 0, 8*1024), output: output}
 	cmd.Stdout = &buf
-	sgr_pat := regexp.MustCompile("\x1b\\[.*?m")
-	osc_pat := regexp.MustCompile("\x1b\\].*?\x1b\\\\")
-	num_pat := regexp.MustCompile(`^(\d+)([:-])`)
-	path_with_count_pat := regexp.MustCompile(`^(.*?)(:\d+)`)
-	path_with_linenum_pat := regexp.MustCompile(`^(.*?):(\d+):`)
-	stats_pat := regexp.MustCompile(`^\d+ matches$`)
-	vimgrep_pat := regexp.MustCompile(`^(.*?):(\d+):(\d+):`)
+	var osc_buf, sgr_buf []byte
 
 	in_stats := false
 	in_result := ""
 	hostname := utils.Hostname()
+	// without headings, every line repeats its path, so cache the last URL
+	last_path, last_url := "", ""
 
 	get_quoted_url := func(file_path string) string {
+		if file_path == last_path && last_url != "" {
+			return last_url
+		}
+		last_path = strings.Clone(file_path)
 		q, err := filepath.Abs(file_path)
 		if err == nil {
 			file_path = q
 		}
 		file_path = filepath.ToSlash(file_path)
 		file_path = strings.Join(utils.Map(url.PathEscape, strings.Split(file_path, "/")), "/")
-		return "file://" + hostname + file_path
+		last_url = "file://" + hostname + file_path
+		return last_url
 	}
 
 	write := func(items ...string) {
 		for _, x := range items {
-			os.Stdout.WriteString(x)
+			output.WriteString(x)
 		}
 	}
 
@@ -347,9 +446,9 @@ func main(_ *cli.Command, _ *Options, args []string) (rc int, err error) {
 	}
 
 	buf.process_line = func(line string) {
-		line = osc_pat.ReplaceAllLiteralString(line, "") // remove existing hyperlinks
+		line = remove_escape_codes(line, ']', "\x1b\\", &osc_buf) // remove existing hyperlinks
 		clean_line := strings.TrimRightFunc(line, unicode.IsSpace)
-		clean_line = sgr_pat.ReplaceAllLiteralString(clean_line, "") // remove SGR formatting
+		clean_line = remove_escape_codes(clean_line, '[', "m", &sgr_buf) // remove SGR formatting
 		if clean_line == "" {
 			in_result = ""
 			write("\n")
@@ -357,11 +456,10 @@ func main(_ *cli.Command, _ *Options, args []string) (rc int, err error) {
 			write(line, "\n")
 		} else if in_result != "" {
 			if kitten_opts.line_number {
-				m := num_pat.FindStringSubmatch(clean_line)
-				if len(m) > 0 {
-					is_match_line := len(m) > 1 && m[2] == ":"
+				if n := num_leading_digits(clean_line); n > 0 && n < len(clean_line) && (clean_line[n] == ':' || clean_line[n] == '-') {
+					is_match_line := clean_line[n] == ':'
 					if (is_match_line && kitten_opts.matching_lines) || (!is_match_line && kitten_opts.context_lines) {
-						write_hyperlink(in_result, line, m[1])
+						write_hyperlink(in_result, line, clean_line[:n])
 						return
 					}
 				}
@@ -370,11 +468,11 @@ func main(_ *cli.Command, _ *Options, args []string) (rc int, err error) {
 		} else {
 			if strings.TrimSpace(line) != "" {
 				// The option priority should be consistent with ripgrep here.
-				if kitten_opts.stats && !in_stats && stats_pat.MatchString(clean_line) {
+				if kitten_opts.stats && !in_stats && is_stats_line(clean_line) {
 					in_stats = true
 				} else if kitten_opts.count || kitten_opts.count_matches {
-					if m := path_with_count_pat.FindStringSubmatch(clean_line); len(m) > 0 && kitten_opts.file_headers {
-						write_hyperlink(get_quoted_url(m[1]), line, "")
+					if path, _, found := split_path_and_count(clean_line); found && kitten_opts.file_headers {
+						write_hyperlink(get_quoted_url(path), line, "")
 						return
 					}
 				} else if kitten_opts.files || kitten_opts.files_with_matches || kitten_opts.files_without_match {
@@ -383,15 +481,10 @@ func main(_ *cli.Command, _ *Options, args []string) (rc int, err error) {
 						return
 					}
 				} else if kitten_opts.vimgrep || !kitten_opts.heading {
-					var m []string
 					// When the vimgrep option is present, it will take precedence.
-					if kitten_opts.vimgrep {
-						m = vimgrep_pat.FindStringSubmatch(clean_line)
-					} else {
-						m = path_with_linenum_pat.FindStringSubmatch(clean_line)
-					}
-					if len(m) > 0 && (kitten_opts.file_headers || kitten_opts.matching_lines) {
-						write_hyperlink(get_quoted_url(m[1]), line, m[2])
+					path, line_number, found := split_path_and_line_number(clean_line, kitten_opts.vimgrep)
+					if found && (kitten_opts.file_headers || kitten_opts.matching_lines) {
+						write_hyperlink(get_quoted_url(path), line, line_number)
 						return
 					}
 				} else {
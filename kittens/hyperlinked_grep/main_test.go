@@ -4,6 +4,7 @@ package hyperlinked_grep
 
 import (
 	"fmt"
+	"github.com/kovidgoyal/kitty/tools/utils"
 	"github.com/kovidgoyal/kitty/tools/utils/shlex"
 	"testing"
 
@@ -91,3 +92,40 @@ func TestRgArgParsing(t *testing.T) {
 	check_args("-mn 10 abcd", "-n --max-count 10 abcd")
 
 }
+
+func TestOutputParsing(t *testing.T) {
+	var buf []byte
+	for text, expected := range map[string]string{
+		"plain":                          "plain",
+		"\x1b[31mred\x1b[m text":         "red text",
+		"a\x1b[1;31mb\x1b[0mc\x1b[":      "abc\x1b[",
+		"\x1b]8;;x\x1b\\y\x1b]8;;\x1b\\": "\x1b]8;;x\x1b\\y\x1b]8;;\x1b\\",
+	} {
+		if diff := cmp.Diff(expected, remove_escape_codes(text, '[', "m", &buf)); diff != "" {
+			t.Fatalf("Failed to remove SGR codes from %#v:\n%s", text, diff)
+		}
+	}
+	if diff := cmp.Diff("y", remove_escape_codes("\x1b]8;;x\x1b\\y\x1b]8;;\x1b\\", ']', "\x1b\\", &buf)); diff != "" {
+		t.Fatalf("Failed to remove OSC codes:\n%s", diff)
+	}
+	for line, expected := range map[string][]string{
+		"a/b:12:text":    {"a/b", "12"},
+		"a:b:12:13:text": {"a:b", "12"},
+		"a:x:12":         nil,
+		"nothing":        nil,
+	} {
+		path, num, found := split_path_and_line_number(line, false)
+		if diff := cmp.Diff(expected, utils.IfElse(found, []string{path, num}, nil)); diff != "" {
+			t.Fatalf("Failed to split %#v:\n%s", line, diff)
+		}
+	}
+	if path, num, found := split_path_and_line_number("a:1:b:12:13:text", true); !found || path != "a:1:b" || num != "12" {
+		t.Fatalf("Failed to split vimgrep line: %#v %#v", path, num)
+	}
+	if path, count, found := split_path_and_count("a:b:12"); !found || path != "a:b" || count != "12" {
+		t.Fatalf("Failed to split count line: %#v %#v", path, count)
+	}
+	if !is_stats_line("12 matches") || is_stats_line("12 matches found") || is_stats_line(" matches") {
+		t.Fatalf("Stats lines not detected correctly")
+	}
+}
@@ -0,0 +1,176 @@
+// License: GPLv3 Copyright: 2025, Kovid Goyal, <kovid at kovidgoyal.net>
+
+package icat
+
+import (
+	"bytes"
+	"crypto/md5"
+	"encoding/binary"
+	"encoding/hex"
+	"fmt"
+	"io"
+	"io/fs"
+	"os"
+	"path/filepath"
+	"slices"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/kovidgoyal/kitty"
+	"github.com/kovidgoyal/kitty/tools/tui/graphics"
+	"github.com/kovidgoyal/kitty/tools/utils"
+	"github.com/kovidgoyal/kitty/tools/utils/shm"
+)
+
+var _ = fmt.Print
+
+// On disk cache of scaled down images, so that displaying the same
+// directory of large images again does not need to decode and resize them
+// all. Entries are keyed by the path, size and modification time of the
+// source file as well as all options that affect the rendered pixels and
+// are pruned by last use.
+
+const max_thumbnail_cache_size = 512 * 1024 * 1024
+const max_thumbnail_cache_age = 30 * 24 * time.Hour
+const thumbnail_cache_magic = "kitty-icat-1"
+
+var thumbnail_cache_dir = sync.OnceValue(func() string {
+	return filepath.Join(utils.CacheDir(), "icat-thumbnails")
+})
+var thumbnails_written atomic.Bool
+
+type thumbnail_header struct {
+	Canvas_width, Canvas_height int32
+	Width, Height, Left, Top    int32
+	Transmission_format         int32
+}
+
+// The cache key depends on the available size, so it must be calculated before
+// rendering, which can change it.
+func thumbnail_cache_path(imgd *image_data, path string) string {
+	path, err := filepath.Abs(path)
+	if err != nil {
+		return ""
+	}
+	s, err := os.Stat(path)
+	if err != nil || !s.Mode().IsRegular() {
+		return ""
+	}
+	h := md5.New()
+	add := func(x string) {
+		h.Write(utils.UnsafeStringToBytes(x))
+		h.Write([]byte{0})
+	}
+	for _, x := range []string{kitty.VersionString, path, strconv.FormatInt(s.Size(), 10), strconv.FormatInt(s.ModTime().UnixNano(), 10)} {
+		add(x)
+	}
+	add(fmt.Sprint(imgd.available_width, imgd.available_height, opts.ScaleUp, place != nil, flip, flop))
+	if remove_alpha != nil {
+		add(fmt.Sprint(*remove_alpha))
+	}
+	return filepath.Join(thumbnail_cache_dir(), hex.EncodeToString(h.Sum(nil)))
+}
+
+// Fill in imgd from a previously cached render returning true on success
+func load_cached_thumbnail(imgd *image_data, cpath string) bool {
+	f, err := os.Open(cpath)
+	if err != nil {
+		return false
+	}
+	defer f.Close()
+	magic := make([]byte, len(thumbnail_cache_magic))
+	var hdr thumbnail_header
+	if _, err = io.ReadFull(f, magic); err != nil || string(magic) != thumbnail_cache_magic {
+		return false
+	}
+	if err = binary.Read(f, binary.LittleEndian, &hdr); err != nil || hdr.Width < 1 || hdr.Height < 1 {
+		return false
+	}
+	tf := graphics.GRT_f(hdr.Transmission_format)
+	bytes_per_pixel := utils.IfElse(tf == graphics.GRT_format_rgb, 3, 4)
+	frame := image_frame{
+		width: int(hdr.Width), height: int(hdr.Height), left: int(hdr.Left), top: int(hdr.Top),
+		transmission_format: tf, number: 1,
+	}
+	sz := frame.width * frame.height * bytes_per_pixel
+	if m, err := shm.CreateTemp(shm_template, uint64(sz)); err == nil {
+		frame.shm = m
+		frame.in_memory_bytes = m.Slice()
+	} else {
+		frame.in_memory_bytes = make([]byte, sz)
+	}
+	if _, err = io.ReadFull(f, frame.in_memory_bytes); err != nil {
+		if frame.shm != nil {
+			_ = frame.shm.Unlink()
+			frame.shm.Close()
+		}
+		return false
+	}
+	now := time.Now()
+	_ = os.Chtimes(cpath, now, now)
+	imgd.canvas_width, imgd.canvas_height = int(hdr.Canvas_width), int(hdr.Canvas_height)
+	imgd.frames = append(imgd.frames[:0], &frame)
+	return true
+}
+
+func save_thumbnail(imgd *image_data, cpath string) {
+	if len(imgd.frames) != 1 || imgd.frames[0].in_memory_bytes == nil {
+		return
+	}
+	frame := imgd.frames[0]
+	hdr := thumbnail_header{
+		Canvas_width: int32(imgd.canvas_width), Canvas_height: int32(imgd.canvas_height),
+		Width: int32(frame.width), Height: int32(frame.height), Left: int32(frame.left), Top: int32(frame.top),
+		Transmission_format: int32(frame.transmission_format),
+	}
+	buf := bytes.Buffer{}
+	buf.WriteString(thumbnail_cache_magic)
+	_ = binary.Write(&buf, binary.LittleEndian, &hdr)
+	if err := os.MkdirAll(filepath.Dir(cpath), 0o700); err == nil {
+		if utils.AtomicWriteFile(cpath, io.MultiReader(&buf, bytes.NewReader(frame.in_memory_bytes)), 0o600) == nil {
+			thumbnails_written.Store(true)
+		}
+	}
+}
+
+func prune_thumbnail_cache() {
+	type entry struct {
+		path  string
+		size  int64
+		mtime time.Time
+	}
+	dir := thumbnail_cache_dir()
+	dirents, err := os.ReadDir(dir)
+	if err != nil {
+		return
+	}
+	entries := make([]entry, 0, len(dirents))
+	var total int64
+	now := time.Now()
+	for _, x := range dirents {
+		var info fs.FileInfo
+		if info, err = x.Info(); err != nil || !info.Mode().IsRegular() {
+			continue
+		}
+		e := entry{filepath.Join(dir, x.Name()), info.Size(), info.ModTime()}
+		if now.Sub(e.mtime) > max_thumbnail_cache_age {
+			os.Remove(e.path)
+			continue
+		}
+		entries = append(entries, e)
+		total += e.size
+	}
+	if total > max_thumbnail_cache_size {
+		slices.SortFunc(entries, func(a, b entry) int { return a.mtime.Compare(b.mtime) })
+		for _, e := range entries {
+			if total <= max_thumbnail_cache_size {
+				break
+			}
+			if os.Remove(e.path) == nil {
+				total -= e.size
+			}
+		}
+	}
+}
@@ -299,6 +299,9 @@ func main(cmd *cli.Command, o *Options, args []string) (rc int, err error) {
 		}
 	}
 	keep_going.Store(false)
+	if thumbnails_written.Load() {
+		prune_thumbnail_cache()
+	}
 	if opts.Hold {
 		fmt.Print("\r")
 		if opts.Place != "" {
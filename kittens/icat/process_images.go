@@ -297,11 +297,22 @@ func process_arg(arg input_arg) {
 			send_output(&imgd)
 			return
 		}
+		// only scaling is expensive enough to be worth caching
+		cache_path := ""
+		if imgd.needs_scaling && !arg.is_http_url && arg.value != "" && imgd.format_uppercase != "GIF" {
+			if cache_path = thumbnail_cache_path(&imgd, arg.value); cache_path != "" && load_cached_thumbnail(&imgd, cache_path) {
+				send_output(&imgd)
+				return
+			}
+		}
 		err = render_image_with_go(&imgd, &f)
 		if err != nil {
 			report_error(arg.value, "Could not render image to RGB", err)
 			return
 		}
+		if cache_path != "" {
+			save_thumbnail(&imgd, cache_path)
+		}
 	} else {
 		err = render_image_with_magick(&imgd, &f)
 		if err != nil {
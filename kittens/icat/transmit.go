@@ -85,6 +85,10 @@ func gc_for_image(imgd *image_data, frame_num int, frame *image_frame) *graphics
 	return gc
 }
 
+// Note that shared memory segments cannot be re-used across frames, as the
+// graphics protocol requires the terminal to unlink them after reading. So
+// frames decoded by us are rendered directly into their own segment, see
+// add_frame(), to avoid an extra copy here.
 func transmit_shm(imgd *image_data, frame_num int, frame *image_frame) (err error) {
 	var mmap shm.MMap
 	var data_size int64
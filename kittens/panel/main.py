@@ -135,6 +135,8 @@ def handle_single_instance_command(boss: BossType, sys_args: Sequence[str], envi
         boss.os_window_death_actions[os_window_id] = partial(boss.notify_on_os_window_death, notify_on_os_window_death)
     tm = boss.os_window_map[os_window_id]
     tm.new_tab(SpecialWindow(cmd=items, env=dict(environ)))
+    if args.keep_alive:
+        boss.keep_os_window_alive(os_window_id)
 
 
 def main(sys_args: list[str]) -> None:
@@ -183,6 +185,7 @@ def actual_main(sys_args: list[str]) -> None:
     from kitty.main import run_app
     run_app.cached_values_name = 'panel'
     run_app.layer_shell_config = layer_shell_config(args)
+    run_app.keep_os_window_alive = args.keep_alive
     real_main(called_from_panel=True)
 
 
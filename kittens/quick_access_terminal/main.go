@@ -79,6 +79,9 @@ func main(cmd *cli.Command, opts *Options, args []string) (rc int, err error) {
 	if conf.Start_as_hidden {
 		argv = append(argv, `--start-as-hidden`)
 	}
+	if conf.Keep_alive {
+		argv = append(argv, `--keep-alive`)
+	}
 	if conf.Grab_keyboard {
 		argv = append(argv, `--grab-keyboard`)
 	}
@@ -80,6 +80,12 @@ def help_of(x: str) -> str:
 opt('start_as_hidden', 'no', option_type='to_bool',
     long_text='Whether to start the quick access terminal hidden. Useful if you are starting it as part of system startup.')
 
+opt('keep_alive', 'no', option_type='to_bool', long_text='''
+When the shell (or other program) running in the quick access terminal exits, hide the terminal
+and start a new shell in it, instead of quitting. This keeps a fully initialized terminal with its
+fonts loaded ready, so that toggling it shows it instantly.
+''')
+
 opt('focus_policy', 'exclusive', choices=panel_opts['focus_policy']['choices'], long_text=help_of('focus_policy'))
 
 
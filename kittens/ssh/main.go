@@ -257,7 +257,9 @@ func make_tarfile(cd *connection_data, get_local_env func(string) (string, bool)
 	env_script, ksi := serialize_env(cd, get_local_env)
 	w := bytes.Buffer{}
 	w.Grow(64 * 1024)
-	gw, err := gzip.NewWriterLevel(&w, gzip.BestCompression)
+	// BestCompression takes almost three times as long as the default level
+	// for a size reduction of under one percent
+	gw, err := gzip.NewWriterLevel(&w, gzip.DefaultCompression)
 	if err != nil {
 		return nil, err
 	}
@@ -651,18 +653,30 @@ func run_ssh(ssh_args, server_args, found_extra_args []string) (rc int, err erro
 	if use_kitty_askpass {
 		need_to_request_data = set_askpass()
 	}
+	var pending_master_check chan bool
+	check_master := func() chan bool {
+		ch := make(chan bool, 1)
+		check_cmd := slices.Insert(slices.Clone(cmd), 1, "-O", "check")
+		go func() { ch <- exec.Command(check_cmd[0], check_cmd[1:]...).Run() == nil }()
+		return ch
+	}
 	master_is_functional := func() bool {
 		if master_checked {
 			return master_is_alive
 		}
 		master_checked = true
-		check_cmd := slices.Insert(cmd, 1, "-O", "check")
-		master_is_alive = exec.Command(check_cmd[0], check_cmd[1:]...).Run() == nil
+		if pending_master_check == nil {
+			pending_master_check = check_master()
+		}
+		master_is_alive = <-pending_master_check
+		pending_master_check = nil
 		return master_is_alive
 	}
-
-	if need_to_request_data && host_opts.Share_connections && master_is_functional() {
-		need_to_request_data = false
+	if need_to_request_data && host_opts.Share_connections {
+		// Whether the master is alive is only needed once the bootstrap
+		// script is generated, so check in parallel with setting up the tty
+		// for the common case of cloned or repeated connections to a host
+		pending_master_check = check_master()
 	}
 	run_control_master := func() error {
 		cmcmd := slices.Clone(cmd[:insertion_point])
@@ -722,7 +736,6 @@ func run_ssh(ssh_args, server_args, found_extra_args []string) (rc int, err erro
 	}
 	cd.echo_on = term.WasEchoOnOriginally()
 	cd.host_opts, cd.literal_env = host_opts, literal_env
-	cd.request_data = need_to_request_data
 	cd.hostname_for_match, cd.username = hostname_for_match, uname
 	escape_codes_to_set_colors, err := change_colors(cd.host_opts.Color_scheme)
 	if err == nil {
@@ -747,6 +760,10 @@ func run_ssh(ssh_args, server_args, found_extra_args []string) (rc int, err erro
 		}
 	}
 	defer cleanup()
+	if need_to_request_data && host_opts.Share_connections && master_is_functional() {
+		need_to_request_data = false
+	}
+	cd.request_data = need_to_request_data
 	err = get_remote_command(&cd)
 	if err != nil {
 		return 1, err
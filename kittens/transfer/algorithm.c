@@ -451,6 +451,9 @@ typedef struct Differ {
     bool signature_header_parsed;
     buffer buf;
     SignatureMap signature_map;
+    // A bitset of the weak hashes in the signature, used to skip the map
+    // lookup for most window positions in data that does not match any block
+    struct { uint64_t *bits; unsigned shift; } weak_hashes;
 
     PyObject *read, *write;
     bool written, finished;
@@ -476,6 +479,7 @@ Differ_dealloc(PyObject *self) {
     if (p->buf.data) free(p->buf.data);
     free_rsync(&p->rsync);
     vt_cleanup(&p->signature_map);
+    free(p->weak_hashes.bits);
     Py_TYPE(self)->tp_free(self);
 }
 
@@ -552,9 +556,38 @@ add_signature_data(Differ *self, PyObject *args) {
     Py_RETURN_NONE;
 }
 
+static uint32_t
+weak_hash_filter_index(const Differ *self, uint32_t weak_hash) {
+    // a multiplicative hash, as the low bits of the rolling checksum are not well distributed
+    return (weak_hash * 0x9e3779b1u) >> self->weak_hashes.shift;
+}
+
+static bool
+weak_hash_may_match(const Differ *self, uint32_t weak_hash) {
+    const uint32_t i = weak_hash_filter_index(self, weak_hash);
+    return self->weak_hashes.bits[i / 64] & (1ull << (i % 64));
+}
+
+static bool
+build_weak_hash_filter(Differ *self) {
+    size_t num_bits = 64;
+    unsigned log2_num_bits = 6;
+    const size_t num_weak_hashes = vt_size(&self->signature_map);
+    while (num_bits < 16 * num_weak_hashes && num_bits < (1u << 26)) { num_bits *= 2; log2_num_bits++; }
+    free(self->weak_hashes.bits);
+    if (!(self->weak_hashes.bits = calloc(num_bits / 64, sizeof(uint64_t)))) return false;
+    self->weak_hashes.shift = 32 - log2_num_bits;
+    vt_create_for_loop(SignatureMap_itr, i, &self->signature_map) {
+        const uint32_t idx = weak_hash_filter_index(self, (uint32_t)i.data->key);
+        self->weak_hashes.bits[idx / 64] |= 1ull << (idx % 64);
+    }
+    return true;
+}
+
 static PyObject*
 finish_signature_data(Differ *self, PyObject *args UNUSED) {
     if (self->buf.len > 0) { PyErr_Format(RsyncError, "%zu bytes of unused signature data", self->buf.len); return NULL; }
+    if (!build_weak_hash_filter(self)) return PyErr_NoMemory();
     self->buf.len = 0;
     self->buf.cap = 8 * self->rsync.block_size;
     self->buf.data = realloc(self->buf.data, self->buf.cap);
@@ -708,27 +741,14 @@ finish_up(Differ *self) {
 }
 
 static bool
-read_next(Differ *self) {
-    if (self->window.sz > 0) {
-        if (!ensure_idx_valid(self, self->window.pos + self->window.sz)) {
-            if (PyErr_Occurred()) return false;
-            return finish_up(self);
-        }
-		self->window.pos++;
-		self->data.sz++;
-        rolling_checksum_add_one_byte(&self->rc, self->buf.data[self->window.pos], self->buf.data[self->window.pos + self->window.sz - 1]);
-    } else {
-        if (!ensure_idx_valid(self, self->window.pos + self->rsync.block_size - 1)) {
-            if (PyErr_Occurred()) return false;
-            return finish_up(self);
-        }
-		self->window.sz = self->rsync.block_size;
-        rolling_checksum_full(&self->rc, self->buf.data + self->window.pos, self->window.sz);
-    }
+match_window(Differ *self, bool *found) {
+    *found = false;
+    if (!weak_hash_may_match(self, self->rc.val)) return true;
     int weak_hash = self->rc.val;
     uint64_t block_index = 0;
     SignatureMap_itr i = vt_get(&self->signature_map, weak_hash);
     if (!vt_is_end(i) && find_strong_hash(&i.data->val, self->rsync.hasher.oneshot64(self->buf.data + self->window.pos, self->window.sz), &block_index)) {
+        *found = true;
         if (!send_data(self)) return false;
         if (!enqueue(self, (Operation){.type=OpBlock, .block_index=block_index})) return false;
 		self->window.pos += self->window.sz;
@@ -738,6 +758,33 @@ read_next(Differ *self) {
     return true;
 }
 
+static bool
+read_next(Differ *self) {
+    bool found;
+    if (self->window.sz > 0) {
+        if (!ensure_idx_valid(self, self->window.pos + self->window.sz)) {
+            if (PyErr_Occurred()) return false;
+            return finish_up(self);
+        }
+        // roll the window over all the bytes that have already been read
+        while (self->window.pos + self->window.sz < self->buf.len) {
+            self->window.pos++;
+            self->data.sz++;
+            rolling_checksum_add_one_byte(&self->rc, self->buf.data[self->window.pos], self->buf.data[self->window.pos + self->window.sz - 1]);
+            if (!match_window(self, &found)) return false;
+            if (found) break;
+        }
+        return true;
+    }
+    if (!ensure_idx_valid(self, self->window.pos + self->rsync.block_size - 1)) {
+        if (PyErr_Occurred()) return false;
+        return finish_up(self);
+    }
+    self->window.sz = self->rsync.block_size;
+    rolling_checksum_full(&self->rc, self->buf.data + self->window.pos, self->window.sz);
+    return match_window(self, &found);
+}
+
 static PyObject*
 next_op(Differ *self, PyObject *args) {
     if (!PyArg_ParseTuple(args, "OO", &self->read, &self->write)) return NULL;
@@ -104,6 +104,7 @@ var _ Unserializable = (*TransmissionType)(nil)
 const (
 	TransmissionType_simple TransmissionType = iota
 	TransmissionType_rsync
+	TransmissionType_local
 )
 
 type QuietLevel int // enum
@@ -186,7 +187,7 @@ func (self FileTransmissionCommand) Serialize(prefix_with_osc_code ...bool) stri
 			switch val.Type().Elem().Kind() {
 			case reflect.Uint8:
 				if bval := val.Bytes(); len(bval) > 0 {
-					encoded_val = base64.RawStdEncoding.EncodeToString(bval)
+					encoded_val = utils.Base64EncodeRawToString(bval)
 				}
 			}
 		case reflect.Int64:
@@ -346,22 +346,51 @@ type SendManager struct {
 	state                                                      SendState
 	files                                                      []*File
 	bypass                                                     string
-	use_rsync                                                  bool
+	use_rsync, use_local                                       bool
 	file_progress                                              func(*File, int)
 	file_done                                                  func(*File) error
 	fid_map                                                    map[string]*File
 	all_acknowledged, all_started, has_transmitting, has_rsync bool
+	has_local                                                  bool
+	local_token                                                string
 	active_idx                                                 int
 	prefix, suffix                                             string
 	last_progress_file                                         *File
 	progress_tracker                                           ProgressTracker
-	current_chunk_uncompressed_sz                              int64
-	current_chunk_write_id                                     loop.IdType
-	current_chunk_for_file_id                                  string
+	chunks_in_flight                                           []chunk_in_flight
+}
+
+// A chunk that has been queued for writing to the terminal
+type chunk_in_flight struct {
+	write_id        loop.IdType
+	file_id         string
+	uncompressed_sz int64
 }
 
 func (self *SendManager) start_transfer() string {
-	return FileTransmissionCommand{Action: Action_send, Bypass: self.bypass}.Serialize()
+	// Advertise that we can have the terminal copy files directly from their
+	// paths, if it turns out that we are running on the same machine
+	ans := FileTransmissionCommand{Action: Action_send, Bypass: self.bypass}
+	if self.use_local {
+		ans.Ttype = TransmissionType_local
+	}
+	return ans.Serialize()
+}
+
+// The terminal proves that we are running as the same user on the same
+// machine by sending us the path to a file only that user can read,
+// containing a one time token. Files sent along with the token are copied by
+// the terminal directly, without their data being transmitted.
+func read_local_token(path string) string {
+	s, err := os.Lstat(path)
+	if err != nil || !s.Mode().IsRegular() || s.Mode().Perm()&0o077 != 0 || s.Size() > 4096 {
+		return ""
+	}
+	raw, err := os.ReadFile(path)
+	if err != nil {
+		return ""
+	}
+	return strings.TrimSpace(utils.UnsafeBytesToString(raw))
 }
 
 func (self *SendManager) initialize() {
@@ -379,8 +408,6 @@ func (self *SendManager) initialize() {
 		self.fid_map[f.file_id] = f
 	}
 	self.active_idx = -1
-	self.current_chunk_uncompressed_sz = -1
-	self.current_chunk_for_file_id = ""
 	self.prefix = fmt.Sprintf("\x1b]%d;id=%s;", kitty.FileTransferCode, self.request_id)
 	self.suffix = "\x1b\\"
 	for _, f := range self.files {
@@ -649,7 +676,17 @@ func (self *SendHandler) send_payload(payload string) loop.IdType {
 	return self.lp.QueueWriteString(self.manager.suffix)
 }
 
-func (self *File) metadata_command(use_rsync bool) *FileTransmissionCommand {
+func (self *File) metadata_command(use_rsync bool, local_token string) *FileTransmissionCommand {
+	if local_token != "" && self.file_type == FileType_regular {
+		if path, err := filepath.Abs(self.expanded_local_path); err == nil {
+			self.ttype = TransmissionType_local
+			return &FileTransmissionCommand{
+				Action: Action_file, Ftype: self.file_type, Name: self.remote_path, Permissions: self.permissions,
+				Mtime: time.Duration(self.mtime.UnixNano()), File_id: self.file_id, Ttype: self.ttype,
+				Bypass: local_token, Data: []byte(path),
+			}
+		}
+	}
 	if use_rsync && self.rsync_capable {
 		self.ttype = TransmissionType_rsync
 	}
@@ -668,7 +705,7 @@ func (self *File) metadata_command(use_rsync bool) *FileTransmissionCommand {
 
 func (self *SendManager) send_file_metadata(send func(string) loop.IdType) {
 	for _, f := range self.files {
-		ftc := f.metadata_command(self.use_rsync)
+		ftc := f.metadata_command(self.use_rsync, self.local_token)
 		send(ftc.Serialize())
 	}
 }
@@ -681,7 +718,7 @@ func (self *SendHandler) send_file_metadata() {
 }
 
 func (self *SendManager) update_collective_statuses() {
-	var found_not_started, found_not_done, has_rsync, has_transmitting bool
+	var found_not_started, found_not_done, has_rsync, has_transmitting, has_local bool
 	for _, f := range self.files {
 		if f.state != ACKNOWLEDGED {
 			found_not_done = true
@@ -691,14 +728,18 @@ func (self *SendManager) update_collective_statuses() {
 		} else if f.state == TRANSMITTING {
 			has_transmitting = true
 		}
-		if f.ttype == TransmissionType_rsync {
+		switch f.ttype {
+		case TransmissionType_rsync:
 			has_rsync = true
+		case TransmissionType_local:
+			has_local = true
 		}
 	}
 	self.all_acknowledged = !found_not_done
 	self.all_started = !found_not_started
 	self.has_rsync = has_rsync
 	self.has_transmitting = has_transmitting
+	self.has_local = has_local
 }
 
 func (self *SendManager) on_file_status_update(ftc *FileTransmissionCommand) error {
@@ -710,8 +751,16 @@ func (self *SendManager) on_file_status_update(ftc *FileTransmissionCommand) err
 	case `STARTED`:
 		file.remote_final_path = ftc.Name
 		file.remote_initial_size = int64(ftc.Size)
-		if file.file_type == FileType_directory {
+		if file.ttype == TransmissionType_local && ftc.Ttype != TransmissionType_local {
+			// the terminal could not copy the file, send its data instead
+			// uncompressed, as that is what the metadata specified
+			file.ttype = TransmissionType_simple
+			file.compressor = &IdentityCompressor{}
+		}
+		if file.file_type == FileType_directory || file.ttype == TransmissionType_local {
+			// the terminal copies local files itself and sends us progress updates
 			file.state = FINISHED
+			self.update_collective_statuses()
 		} else {
 			if ftc.Ttype == TransmissionType_rsync {
 				file.state = WAITING_FOR_DATA
@@ -798,6 +847,9 @@ func (self *SendManager) on_file_transfer_response(ftc *FileTransmissionCommand)
 		}
 		if ftc.Status == "OK" {
 			self.state = SEND_PERMISSION_GRANTED
+			if self.use_local && ftc.Ttype == TransmissionType_local && ftc.Name != "" {
+				self.local_token = read_local_token(ftc.Name)
+			}
 		} else {
 			self.state = SEND_PERMISSION_DENIED
 		}
@@ -989,23 +1041,25 @@ func (self *SendManager) next_chunks(callback func(string) loop.IdType) error {
 		return nil
 	}
 	chunk := ""
-	self.current_chunk_uncompressed_sz = 0
+	c := chunk_in_flight{file_id: af.file_id}
 	for af.state != FINISHED && len(chunk) == 0 {
-		c, usz, err := af.next_chunk()
+		data, usz, err := af.next_chunk()
 		if err != nil {
 			return err
 		}
-		self.current_chunk_uncompressed_sz += int64(usz)
-		self.current_chunk_for_file_id = af.file_id
-		chunk = c
+		c.uncompressed_sz += int64(usz)
+		chunk = data
 	}
 	is_last := af.state == FINISHED
 	if len(chunk) > 0 {
 		split_for_transfer(utils.UnsafeStringToBytes(chunk), af.file_id, is_last, func(ftc *FileTransmissionCommand) {
-			self.current_chunk_write_id = callback(ftc.Serialize())
+			c.write_id = callback(ftc.Serialize())
 		})
 	} else if is_last {
-		self.current_chunk_write_id = callback(FileTransmissionCommand{Action: Action_end_data, File_id: af.file_id}.Serialize())
+		c.write_id = callback(FileTransmissionCommand{Action: Action_end_data, File_id: af.file_id}.Serialize())
+	}
+	if c.write_id != 0 {
+		self.chunks_in_flight = append(self.chunks_in_flight, c)
 	}
 	if is_last {
 		self.activate_next_ready_file()
@@ -1016,16 +1070,26 @@ func (self *SendManager) next_chunks(callback func(string) loop.IdType) error {
 	return nil
 }
 
+// Chunks are queued until this much data is waiting to be written, so that
+// many small files are sent in a single write rather than one write, and
+// wakeup, per file.
+const chunk_batch_size = 1024 * 1024
+
 func (self *SendHandler) transmit_next_chunk() (err error) {
-	found_chunk := false
-	for !found_chunk {
+	batched := 0
+	for batched < chunk_batch_size {
+		found_chunk := false
 		if err = self.manager.next_chunks(func(chunk string) loop.IdType {
 			found_chunk = true
+			batched += len(chunk)
 			return self.send_payload(chunk)
 		}); err != nil {
 			return err
 		}
 		if !found_chunk {
+			if batched > 0 {
+				return
+			}
 			if self.manager.all_acknowledged {
 				self.transfer_finished()
 				return
@@ -1043,7 +1107,7 @@ func (self *SendHandler) start_transfer() (err error) {
 	if self.manager.active_file() == nil {
 		self.manager.activate_next_ready_file()
 	}
-	if self.manager.active_file() != nil {
+	if self.manager.active_file() != nil || (self.manager.all_started && self.manager.has_local) {
 		self.transmit_started = true
 		self.manager.progress_tracker.start_transfer()
 		if err = self.transmit_next_chunk(); err != nil {
@@ -1150,12 +1214,13 @@ func (self *SendHandler) on_key_event(ev *loop.KeyEvent) error {
 }
 
 func (self *SendHandler) on_writing_finished(msg_id loop.IdType, has_pending_writes bool) (err error) {
-	chunk_transmitted := self.manager.current_chunk_uncompressed_sz >= 0 && msg_id == self.manager.current_chunk_write_id
-	if chunk_transmitted {
-		self.manager.progress_tracker.on_transmit(self.manager.current_chunk_uncompressed_sz, self.manager.fid_map[self.manager.current_chunk_for_file_id])
-		self.manager.current_chunk_uncompressed_sz = -1
-		self.manager.current_chunk_write_id = 0
-		self.manager.current_chunk_for_file_id = ""
+	chunk_transmitted := false
+	for len(self.manager.chunks_in_flight) > 0 && self.manager.chunks_in_flight[0].write_id <= msg_id {
+		c := self.manager.chunks_in_flight[0]
+		self.manager.chunks_in_flight = self.manager.chunks_in_flight[1:]
+		self.manager.progress_tracker.on_transmit(c.uncompressed_sz, self.manager.fid_map[c.file_id])
+		// send the next batch once the whole of this one has been written
+		chunk_transmitted = len(self.manager.chunks_in_flight) == 0
 	}
 	if self.finish_cmd_write_id > 0 && msg_id == self.finish_cmd_write_id {
 		if len(self.failed_files) > 0 {
@@ -1207,6 +1272,8 @@ func send_loop(opts *Options, files []*File) (err error, rc int) {
 		progress_drawn:  true, done_file_ids: utils.NewSet[string](),
 		manager: &SendManager{
 			request_id: random_id(), files: files, bypass: opts.PermissionsBypass, use_rsync: opts.TransmitDeltas,
+			// local copies start immediately so cannot wait for the paths to be confirmed
+			use_local: !opts.ConfirmPaths,
 		},
 	}
 	handler.manager.file_progress = handler.on_file_progress
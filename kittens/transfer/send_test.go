@@ -100,3 +100,45 @@ func TestPathMappingSend(t *testing.T) {
 		ae(f.file_type, FileType_link)
 	})
 }
+
+func TestShouldBeCompressed(t *testing.T) {
+	for path, expected := range map[string]bool{
+		"a.txt": true, "a.tar": true, "a.svg": true, "a.wav": true,
+		"a.tar.gz": false, "a.tar.zst": false, "a.7z": false, "a.JPG": false, "a.mp3": false, "a.woff2": false,
+	} {
+		if actual := should_be_compressed(path, "auto"); actual != expected {
+			t.Fatalf("should_be_compressed(%#v) returned %v", path, actual)
+		}
+	}
+	if !should_be_compressed("a.zst", "always") || should_be_compressed("a.txt", "never") {
+		t.Fatalf("The compression strategy was not respected")
+	}
+}
+
+func TestLocalToken(t *testing.T) {
+	tdir := t.TempDir()
+	p := filepath.Join(tdir, "token")
+	os.WriteFile(p, []byte("abcd\n"), 0o600)
+	if q := read_local_token(p); q != "abcd" {
+		t.Fatalf("Failed to read local token, got: %#v", q)
+	}
+	os.Chmod(p, 0o644)
+	if q := read_local_token(p); q != "" {
+		t.Fatalf("Read local token from a file readable by others")
+	}
+	if q := read_local_token(filepath.Join(tdir, "missing")); q != "" {
+		t.Fatalf("Read local token from a missing file")
+	}
+	src := filepath.Join(tdir, "src")
+	os.WriteFile(src, []byte("data"), 0o600)
+	s, _ := os.Stat(src)
+	f := NewFile(&Options{Compress: "always"}, src, src, 1, s, tdir, FileType_regular)
+	ftc := f.metadata_command(true, "abcd")
+	if ftc.Ttype != TransmissionType_local || ftc.Bypass != "abcd" || string(ftc.Data) != src || ftc.Compression != Compression_none {
+		t.Fatalf("Incorrect metadata for local file: %#v", ftc)
+	}
+	f = NewFile(&Options{Compress: "always"}, src, src, 2, s, tdir, FileType_regular)
+	if ftc = f.metadata_command(false, ""); ftc.Ttype != TransmissionType_simple || len(ftc.Data) != 0 {
+		t.Fatalf("Incorrect metadata for non-local file: %#v", ftc)
+	}
+}
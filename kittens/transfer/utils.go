@@ -93,19 +93,29 @@ func should_be_compressed(path, strategy string) bool {
 		return false
 	}
 	ext := strings.ToLower(filepath.Ext(path))
-	if ext != "" {
-		switch ext[1:] {
-		case "zip", "odt", "odp", "pptx", "docx", "gz", "bz2", "xz", "svgz":
-			return false
-		}
+	if ext != "" && already_compressed_extensions[ext[1:]] {
+		return false
 	}
 	mt := utils.GuessMimeType(path)
 	if strings.HasSuffix(mt, "+zip") || (strings.HasPrefix(mt, "image/") && mt != "image/svg+xml") || strings.HasPrefix(mt, "video/") {
 		return false
 	}
+	if strings.HasPrefix(mt, "audio/") && !strings.Contains(mt, "wav") && !strings.Contains(mt, "aiff") {
+		return false
+	}
 	return true
 }
 
+// Files that are compressed already, compressing them again wastes CPU on
+// both ends for no reduction in size
+var already_compressed_extensions = map[string]bool{
+	"zip": true, "odt": true, "odp": true, "ods": true, "pptx": true, "docx": true, "xlsx": true, "epub": true,
+	"jar": true, "apk": true, "whl": true, "nupkg": true,
+	"gz": true, "tgz": true, "bz2": true, "tbz2": true, "xz": true, "txz": true, "lz": true, "lzma": true,
+	"lz4": true, "zst": true, "tzst": true, "br": true, "7z": true, "rar": true, "cab": true,
+	"deb": true, "rpm": true, "svgz": true, "woff": true, "woff2": true,
+}
+
 func print_rsync_stats(total_bytes, delta_bytes, signature_bytes int64) {
 	fmt.Println("Rsync stats:")
 	fmt.Printf("  Delta size: %s Signature size: %s\n", humanize.Size(delta_bytes), humanize.Size(signature_bytes))
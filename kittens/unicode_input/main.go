@@ -642,7 +642,7 @@ func run_loop(opts *Options) (lp *loop.Loop, err error) {
 }
 
 func main(cmd *cli.Command, o *Options, args []string) (rc int, err error) {
-	go unicode_names.Initialize() // start parsing name data in the background
+	unicode_names.Initialize()
 	build_sets()
 	lp, err := run_loop(o)
 	if err != nil {
@@ -2,10 +2,23 @@
 
 uniform sampler2D image;
 uniform vec4 background;
+// The background tint of the windows is drawn in the same pass as the image,
+// the size of the arrays is MAX_TINT_RECTS in shaders.c. Rects are [left,
+// bottom, right, top] in pixels with the origin at the bottom left of the
+// framebuffer and colors are pre-multiplied.
+uniform int num_tint_rects;
+uniform vec4 tint_rects[32], tint_colors[32];
 in vec2 texcoord;
 out vec4 premult_color;
 
 void main() {
     vec4 color = texture(image, texcoord);
     premult_color = alpha_blend(color, background);
+    for (int i = 0; i < num_tint_rects; i++) {
+        vec4 r = tint_rects[i];
+        if (gl_FragCoord.x >= r[0] && gl_FragCoord.x < r[2] && gl_FragCoord.y >= r[1] && gl_FragCoord.y < r[3]) {
+            premult_color = alpha_blend_premul(tint_colors[i], premult_color);
+            break;
+        }
+    }
 }
@@ -11,7 +11,7 @@
 import sys
 from collections.abc import Callable, Container, Generator, Iterable, Iterator, Sequence
 from contextlib import contextmanager, suppress
-from functools import partial
+from functools import cached_property, partial
 from gettext import gettext as _
 from gettext import ngettext
 from time import sleep
@@ -89,6 +89,7 @@
     glfw_get_monitor_workarea,
     global_font_size,
     grab_keyboard,
+    input_latency_samples,
     is_layer_shell_supported,
     last_focused_os_window_id,
     mark_os_window_for_close,
@@ -96,6 +97,7 @@
     monotonic,
     os_window_focus_counters,
     os_window_font_size,
+    os_window_memory_usage,
     redirect_mouse_handling,
     ring_bell,
     run_with_activation_token,
@@ -115,10 +117,8 @@
     toggle_secure_input,
     wrapped_kitten_names,
 )
-from .key_encoding import get_name_to_functional_number_map
 from .keys import Mappings
 from .layout.base import set_layout_options
-from .notifications import NotificationManager
 from .options.types import Options, nullable_colors
 from .options.utils import MINIMUM_FONT_SIZE, KeyboardMode, KeyDefinition
 from .os_window_size import initial_window_size_func
@@ -164,6 +164,7 @@
 if TYPE_CHECKING:
 
     from .fast_data_types import OSWindowSize
+    from .notifications import NotificationManager
     from .rc.base import ResponseType
 # }}}
 
@@ -379,6 +380,8 @@ def __init__(
         self.primary_selection = Clipboard(ClipboardType.primary_selection)
         self.update_check_started = False
         self.peer_data_map: dict[int, dict[str, Sequence[str]] | None] = {}
+        # peer id -> names of the events it is subscribed to, all events if empty
+        self.event_subscriptions: dict[int, frozenset[str]] = {}
         self.background_process_death_notify_map: dict[int, Callable[[int, Exception | None], None]] = {}
         self.encryption_key = EllipticCurveKey()
         self.encryption_public_key = f'{RC_ENCRYPTION_PROTOCOL_VERSION}:{base64.b85encode(self.encryption_key.public).decode("ascii")}'
@@ -392,6 +395,8 @@ def __init__(
         self.cached_values = cached_values
         self.os_window_map: dict[int, TabManager] = {}
         self.os_window_death_actions: dict[int, Callable[[], None]] = {}
+        # called instead of closing the OS window when its last tab is closed
+        self.os_window_empty_actions: dict[int, Callable[[TabManager], None]] = {}
         self.cursor_blinking = True
         self.shutting_down = False
         self.misc_config_errors: list[str] = []
@@ -419,9 +424,14 @@ def __init__(
         self.mouse_handler: Callable[[WindowSystemMouseEvent], None] | None = None
         set_boss(self)
         self.mappings: Mappings = Mappings(global_shortcuts, self.refresh_active_tab_bar)
-        self.notification_manager: NotificationManager = NotificationManager(debug=self.args.debug_keyboard or self.args.debug_rendering)
         self.atexit.unlink(store_effective_config())
 
+    @cached_property
+    def notification_manager(self) -> 'NotificationManager':
+        # created on first use to keep the notifications machinery out of startup
+        from .notifications import NotificationManager
+        return NotificationManager(debug=self.args.debug_keyboard or self.args.debug_rendering)
+
     def startup_first_child(self, os_window_id: int | None, startup_sessions: Iterable[Session] = ()) -> None:
         si = startup_sessions or create_sessions(get_options(), self.args, default_session=get_options().startup_session)
         focused_os_window = wid = 0
@@ -871,9 +881,20 @@ def call_remote_control(self, self_window: Window | None, args: tuple[str, ...])
                 return None
             raise
 
+    def report_event_to_subscribers(self, event: str, window_id: int, data: dict[str, Any]) -> None:
+        if not self.event_subscriptions:
+            return
+        from .remote_control import encode_response_for_peer
+        msg = b''
+        for peer_id, events in self.event_subscriptions.items():
+            if not events or event in events:
+                msg = msg or encode_response_for_peer({'ok': True, 'data': {'event': event, 'window_id': window_id, **data}})
+                send_data_to_peer(peer_id, msg)
+
     def peer_message_received(self, msg_bytes: bytes, peer_id: int, is_remote_control: bool) -> bytes | bool | None:
         if peer_id > 0 and msg_bytes == b'peer_death':
             self.peer_data_map.pop(peer_id, None)
+            self.event_subscriptions.pop(peer_id, None)
             return False
         if is_remote_control:
             cmd_prefix = b'\x1bP@kitty-cmd'
@@ -977,7 +998,24 @@ def _cleanup_tab_after_window_removal(self, src_tab: Tab) -> None:
                 src_tab.destroy()
                 if len(tm) == 0:
                     if not self.shutting_down:
-                        self.mark_os_window_for_close(src_tab.os_window_id)
+                        if (empty_action := self.os_window_empty_actions.get(src_tab.os_window_id)) is not None:
+                            empty_action(tm)
+                        else:
+                            self.mark_os_window_for_close(src_tab.os_window_id)
+
+    def keep_os_window_alive(self, os_window_id: int) -> None:
+        ''' When the program in the OS window exits, hide the OS window and start
+        the program again in it, so that it is ready to be shown instantly '''
+        tm = self.os_window_map.get(os_window_id)
+        w = tm.active_window if tm is not None else None
+        cmd = env = None
+        if w is not None and w.creation_spec is not None:
+            cmd, env = w.creation_spec.cmd, w.creation_spec.env
+
+        def respawn(tm: TabManager) -> None:
+            toggle_os_window_visibility(tm.os_window_id, False)
+            tm.new_tab(SpecialWindow(cmd=None if cmd is None else list(cmd), env=None if env is None else dict(env)))
+        self.os_window_empty_actions[os_window_id] = respawn
 
     @contextmanager
     def suppress_focus_change_events(self) -> Generator[None, None, None]:
@@ -1625,6 +1663,7 @@ def visual_window_select_action(
         km = KeyboardMode('__visual_select__')
         km.on_action = 'end'
         km.keymap[SingleKey(key=GLFW_FKEY_ESCAPE)].append(KeyDefinition(definition='visual_window_select_action_trigger 0'))
+        from .key_encoding import get_name_to_functional_number_map
         fmap = get_name_to_functional_number_map()
         alphanumerics = get_options().visual_window_select_characters
         for idx, window in tab.windows.iter_windows_with_number(only_visible=True):
@@ -1967,6 +2006,7 @@ def on_os_window_closed(self, os_window_id: int, x: int, y: int, viewport_width:
             self.window_id_map.pop(window_id, None)
         if not self.os_window_map and is_macos:
             cocoa_set_menubar_title('')
+        self.os_window_empty_actions.pop(os_window_id, None)
         action = self.os_window_death_actions.pop(os_window_id, None)
         if action is not None:
             action()
@@ -2018,7 +2058,8 @@ def notify_on_os_window_death(self, address: str) -> None:
                 s.shutdown(socket.SHUT_RDWR)
             s.close()
 
-    def display_scrollback(self, window: Window, data: bytes | str, input_line_number: int = 0, title: str = '', report_cursor: bool = True) -> None:
+    def display_scrollback(self, window: Window, data: bytes | str | int, input_line_number: int = 0, title: str = '', report_cursor: bool = True) -> None:
+        # data can be a file descriptor to read from, that is then owned by us
 
         def prepare_arg(x: str) -> str:
             x = x.replace('INPUT_LINE_NUMBER', str(input_line_number))
@@ -2046,12 +2087,17 @@ def prepare_arg(x: str) -> str:
                     if less_version(cmd[0]) >= 581:
                         open(sentinel, 'w').close()
                     else:
+                        if isinstance(bdata, int):
+                            with open(bdata, 'rb') as f:
+                                bdata = f.read()
                         bdata = re.sub(br'\x1b\].*?\x1b\\', b'', bdata)
 
             tab.new_special_window(
                 SpecialWindow(cmd, bdata, title or _('History'), overlay_for=window.id, cwd=window.cwd_of_child),
                 copy_colors_from=self.active_window
                 )
+        elif isinstance(data, int):
+            os.close(data)
 
     @ac('misc', 'Edit the kitty.conf config file in your favorite text editor')
     def edit_config_file(self, *a: Any) -> None:
@@ -3224,6 +3270,81 @@ def show_kitty_env_vars(self) -> None:
             output = '\n'.join(f'{k}={v}' for k, v in env.items())
             self.display_scrollback(w, output, title=_('Current kitty env vars'), report_cursor=False)
 
+    @ac('debug', '''
+        Show statistics about the keystroke to photon latency
+
+        For the most recent key presses in each OS window, shows the median
+        and 99th percentile of the time taken from the key press being received
+        to it being sent to the program, to its echo being parsed, rendered and
+        finally presented on screen. Can be run via remote control using
+        :code:`kitten @ action show_input_latency`.
+        ''')
+    def show_input_latency(self) -> None:
+        w = self.window_for_dispatch or self.active_window
+        if w is None:
+            return
+
+        def percentile(vals: list[float], p: float) -> str:
+            return f'{1000 * vals[min(len(vals) - 1, int(p * len(vals)))]:.1f}'
+
+        lines = []
+        for os_window_id in self.os_window_map:
+            samples = input_latency_samples(os_window_id)
+            lines.append(f'OS Window {os_window_id}: {len(samples)} key presses measured')
+            if not samples:
+                continue
+            stages = {
+                'sent to child': [s[0] for s in samples],
+                'echo parsed': [s[1] - s[0] for s in samples],
+                'rendered': [s[2] - s[1] for s in samples],
+                'presented': [s[3] - s[2] for s in samples],
+                'total': [s[3] for s in samples],
+            }
+            for name, vals in stages.items():
+                vals.sort()
+                lines.append(f'  {name:16} p50: {percentile(vals, 0.5):>7} ms  p99: {percentile(vals, 0.99):>7} ms')
+        self.display_scrollback(w, '\n'.join(lines), title=_('Keystroke latency'), report_cursor=False)
+
+    def memory_report(self) -> list[dict[str, Any]]:
+        ans = []
+        for os_window_id, tm in self.os_window_map.items():
+            tabs = []
+            for tab in tm:
+                windows = [{'id': w.id, 'title': w.title, **w.screen.memory_usage()} for w in tab]
+                tabs.append({'id': tab.id, 'title': tab.title, 'windows': windows})
+            ans.append({'id': os_window_id, **os_window_memory_usage(os_window_id), 'tabs': tabs})
+        return ans
+
+    @ac('debug', '''
+        Show how much memory is used by every window
+
+        Shows the memory used by the screen, scrollback, images and parser of
+        every window and by the font caches and sprite textures of every OS
+        window. Can be run via remote control using :code:`kitten @ action
+        show_memory_report`, machine readable output is available with
+        :code:`kitten @ memory-report`.
+        ''')
+    def show_memory_report(self) -> None:
+        w = self.window_for_dispatch or self.active_window
+        if w is None:
+            return
+        from kittens.tui.utils import human_size
+        lines = []
+        seen_font_groups = set()
+        for osw in self.memory_report():
+            shared = ' (shared)' if osw['font_group'] in seen_font_groups else ''
+            seen_font_groups.add(osw['font_group'])
+            lines.append(f'OS Window {osw["id"]}: sprite textures: {human_size(osw["sprite_textures"])}'
+                         f' font caches: {human_size(osw["font_caches"])}{shared}')
+            for tab in osw['tabs']:
+                lines.append(f'  Tab {tab["id"]}: {tab["title"]}')
+                for win in tab['windows']:
+                    usage = {k: v for k, v in win.items() if k not in ('id', 'title') and v}
+                    lines.append(f'    Window {win["id"]}: {win["title"]}: {human_size(sum(usage.values()))}')
+                    for k, v in sorted(usage.items(), key=lambda x: x[1], reverse=True):
+                        lines.append(f'      {k:18} {human_size(v)}')
+        self.display_scrollback(w, '\n'.join(lines), title=_('Memory usage'), report_cursor=False)
+
     @ac('debug', '''
         Close all shared SSH connections
 
@@ -5,13 +5,15 @@
 
 uniform float text_contrast;
 uniform float text_gamma_adjustment;
-uniform sampler2DArray sprites;
+uniform sampler2DArray sprites;  // the alpha of all sprites
+uniform sampler2DArray colored_sprites;
 
 in vec3 background;
 in vec4 effective_background_premul;
 #ifndef ONLY_BACKGROUND
 in float effective_text_alpha;
 in vec3 sprite_pos;
+in vec3 colored_sprite_pos;
 in vec3 underline_pos;
 in vec3 cursor_pos;
 in vec3 strike_pos;
@@ -61,19 +63,19 @@ vec4 foreground_contrast(vec4 over, vec3 under) {
 vec4 load_text_foreground_color() {
     // For colored sprites use the color from the sprite rather than the text foreground
     // Return non-premultiplied foreground color
-    vec4 text_fg = texture(sprites, sprite_pos);
-    return vec4(mix(cell_foreground, text_fg.rgb, colored_sprite), text_fg.a);
+    vec3 sprite_color = texture(colored_sprites, colored_sprite_pos).rgb;
+    return vec4(mix(cell_foreground, sprite_color, colored_sprite), texture(sprites, sprite_pos).r);
 }
 
 vec4 calculate_premul_foreground_from_sprites(vec4 text_fg) {
     // Return premul foreground color from decorations (cursor, underline, strikethrough)
     ivec3 sz = textureSize(sprites, 0);
-    float underline_alpha = texture(sprites, underline_pos).a;
+    float underline_alpha = texture(sprites, underline_pos).r;
     float underline_exclusion = texelFetch(sprites, ivec3(int(
-        sprite_pos.x * float(sz.x)), int(underline_exclusion_pos), int(sprite_pos.z)), 0).a;
+        sprite_pos.x * float(sz.x)), int(underline_exclusion_pos), int(sprite_pos.z)), 0).r;
     underline_alpha *= 1.0f - underline_exclusion;
-    float strike_alpha = texture(sprites, strike_pos).a;
-    float cursor_alpha = texture(sprites, cursor_pos).a;
+    float strike_alpha = texture(sprites, strike_pos).r;
+    float cursor_alpha = texture(sprites, cursor_pos).r;
     // Since strike and text are the same color, we simply add the alpha values
     float combined_alpha = min(text_fg.a + strike_alpha, 1.0f);
     // Underline color might be different, so alpha blend
@@ -9,7 +9,7 @@ layout(std140) uniform CellRenderData {
 
     uint default_fg, highlight_fg, highlight_bg, main_cursor_fg, main_cursor_bg, url_color, url_style, inverted, extra_cursor_fg, extra_cursor_bg;
 
-    uint columns, lines, sprites_xnum, sprites_ynum, cursor_shape, cell_width, cell_height;
+    uint columns, lines, sprites_xnum, sprites_ynum, colored_sprites_ynum, cursor_shape, cell_width, cell_height;
     uint cursor_x1, cursor_x2, cursor_y1, cursor_y2;
     float cursor_opacity, inactive_text_alpha, dim_opacity, blink_opacity;
 
@@ -49,6 +49,7 @@ out vec4 effective_background_premul;
 #ifndef ONLY_BACKGROUND
 out float effective_text_alpha;
 out vec3 sprite_pos;
+out vec3 colored_sprite_pos;
 out vec3 underline_pos;
 out vec3 cursor_pos;
 out vec3 strike_pos;
@@ -142,8 +143,8 @@ ColorPair resolve_extra_cursor_colors(vec3 cell_bg, vec3 cell_fg, ColorPair main
     return if_one_then_pair(zero_or_one(abs(float(extra_cursor_bg & BYTE_MASK) - COLOR_IS_SPECIAL)), ans, special);
 }
 
-uvec3 to_sprite_coords(uint idx) {
-    uint sprites_per_page = sprites_xnum * sprites_ynum;
+uvec3 to_sprite_coords(uint idx, uint ynum) {
+    uint sprites_per_page = sprites_xnum * ynum;
     uint z = idx / sprites_per_page;
     uint num_on_last_page = idx - sprites_per_page * z;
     uint y = num_on_last_page / sprites_xnum;
@@ -151,32 +152,34 @@ uvec3 to_sprite_coords(uint idx) {
     return uvec3(x, y, z);
 }
 
-vec3 to_sprite_pos(uvec2 pos, uint idx) {
-    uvec3 c = to_sprite_coords(idx);
+vec3 to_sprite_pos(uvec2 pos, uint idx, uint ynum) {
+    uvec3 c = to_sprite_coords(idx, ynum);
     vec2 s_xpos = vec2(c.x, float(c.x) + 1.0f) * (1.0f / float(sprites_xnum));
-    vec2 s_ypos = vec2(c.y, float(c.y) + 1.0f) * (1.0f / float(sprites_ynum));
-    uint texture_height_px = (cell_height + 1u) * sprites_ynum;
+    vec2 s_ypos = vec2(c.y, float(c.y) + 1.0f) * (1.0f / float(ynum));
+    uint texture_height_px = (cell_height + 1u) * ynum;
     float row_height = 1.0f / float(texture_height_px);
     s_ypos[1] -= row_height;  // skip the decorations_exclude row
     return vec3(s_xpos[pos.x], s_ypos[pos.y], c.z);
 }
 
+vec3 to_sprite_pos(uvec2 pos, uint idx) { return to_sprite_pos(pos, idx, sprites_ynum); }
+
 uint to_underline_exclusion_pos() {
-    uvec3 c = to_sprite_coords(sprite_idx[0]);
+    uvec3 c = to_sprite_coords(sprite_idx[0] & SPRITE_INDEX_MASK, sprites_ynum);
     uint cell_top_px = c.y * (cell_height + 1u);
     return cell_top_px + cell_height;
 }
 
-uint read_sprite_decorations_idx() {
+uvec2 read_sprite_decorations() {
+    // the index of the first decoration sprite and the position of the sprite in the texture of colored sprites
     int idx = int(sprite_idx[0] & SPRITE_INDEX_MASK);
     ivec2 sz = textureSize(sprite_decorations_map, 0);
     int y = idx / sz[0];
     int x = idx - y * sz[0];
-    return texelFetch(sprite_decorations_map, ivec2(x, y), 0).r;
+    return texelFetch(sprite_decorations_map, ivec2(x, y), 0).rg;
 }
 
-uvec2 get_decorations_indices(uint in_url /* [0, 1] */, uint text_attrs) {
-    uint decorations_idx = read_sprite_decorations_idx();
+uvec2 get_decorations_indices(uint in_url /* [0, 1] */, uint text_attrs, uint decorations_idx) {
     uint strike_style = ((text_attrs >> STRIKE_SHIFT) & BIT_MASK); // 0 or 1
     uint strike_idx = decorations_idx * strike_style;
     uint underline_style = ((text_attrs >> DECORATION_SHIFT) & DECORATION_MASK);
@@ -215,6 +218,7 @@ CellData set_vertex_position(vec3 cell_fg, vec3 cell_bg) {
 #ifndef ONLY_BACKGROUND
     sprite_pos = to_sprite_pos(pos, sprite_idx[0] & SPRITE_INDEX_MASK);
     colored_sprite = float((sprite_idx[0] & SPRITE_COLORED_MASK) >> SPRITE_COLORED_SHIFT);
+    colored_sprite_pos = to_sprite_pos(pos, read_sprite_decorations()[1], colored_sprites_ynum);
 #endif
     // Cursor shape and colors
     float has_main_cursor = is_cursor(column, row);
@@ -325,7 +329,7 @@ void main() {
     foreground = if_one_then(float(is_selected & BIT_MASK), selection_color, foreground);
     decoration_fg = if_one_then(float(is_selected & BIT_MASK), selection_color, decoration_fg);
     // Underline and strike through (rendered via sprites)
-    uvec2 decs = get_decorations_indices(uint(in_url), text_attrs);
+    uvec2 decs = get_decorations_indices(uint(in_url), text_attrs, read_sprite_decorations()[0]);
     strike_pos = to_sprite_pos(cell_data.pos, decs[0]);
     underline_pos = to_sprite_pos(cell_data.pos, decs[1]);
     underline_exclusion_pos = to_underline_exclusion_pos();
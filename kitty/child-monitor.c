@@ -11,6 +11,7 @@
 #include "threading.h"
 #include "screen.h"
 #include "monotonic.h"
+#include "io-batch.h"
 #include <termios.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -233,6 +234,7 @@ static void send_response_to_peer(id_type peer_id, const char *msg, size_t msg_s
 static void wakeup_talk_loop(bool);
 static bool add_peer_to_injection_queue(int peer_fd, int pipe_fd);
 static bool talk_thread_started = false;
+static void stop_parse_pool(void);
 
 static bool
 simple_read_from_pipe(int fd, void *data, size_t sz) {
@@ -338,6 +340,13 @@ add_child(ChildMonitor *self, PyObject *args) {
             Screen *screen = children[i].screen; \
             screen_mutex(lock, write); \
             size_t space_left = screen->write_buf_sz - screen->write_buf_used; \
+            if (space_left < sz && screen->write_buf_start) { \
+                /* move the unwritten data to the front only when space is needed, not after every write */ \
+                screen->write_buf_used -= screen->write_buf_start; \
+                memmove(screen->write_buf, screen->write_buf + screen->write_buf_start, screen->write_buf_used); \
+                screen->write_buf_start = 0; \
+                space_left = screen->write_buf_sz - screen->write_buf_used; \
+            } \
             if (space_left < sz) { \
                 if (screen->write_buf_used + sz > 100 * 1024 * 1024) { \
                     log_error("Too much data being sent to child with id: %lu, ignoring it", id); \
@@ -432,22 +441,214 @@ shutdown_monitor(ChildMonitor *self, PyObject *a UNUSED) {
         if (ret != 0) return PyErr_Format(PyExc_OSError, "Failed to join() talk thread with error: %s", strerror(ret));
     }
     talk_thread_started = false;
+    stop_parse_pool();
     Py_RETURN_NONE;
 }
 
 static bool
-do_parse(ChildMonitor *self, Screen *screen, monotonic_t now, bool flush) {
-    ParseData pd = {.dump_callback = self->dump_callback, .now = now};
-    self->parse_func(screen, &pd, flush);
-    if (pd.input_read) {
-        if (pd.write_space_created) wakeup_io_loop(self, false);
+handle_parse_result(ChildMonitor *self, Screen *screen, const ParseData *pd, monotonic_t now) {
+    set_maximum_wait(screen_expire_predicted_echo(screen, now));
+    const monotonic_t rewrap_wait = screen_rewrap_history_in_background(screen);
+    if (rewrap_wait >= 0) set_maximum_wait(rewrap_wait);
+    const monotonic_t notify_wait = screen_deliver_coalesced_notifications(screen, now, false);
+    if (notify_wait >= 0) set_maximum_wait(notify_wait);
+    if (pd->input_read) {
+        if (screen->input_latency.key_at && !screen->input_latency.parsed_at) {
+            const monotonic_t parsed_at = monotonic();
+            if (parsed_at - screen->input_latency.key_at < INPUT_LATENCY_TIMEOUT) screen->input_latency.parsed_at = parsed_at;
+            else screen->input_latency.key_at = 0;
+        }
+        screen_abort_text_cache_compaction(screen, now);
+        if (pd->write_space_created) wakeup_io_loop(self, false);
+        historybuf_spill_to_disk(screen->historybuf);
         if (screen->paused_rendering.expires_at) {
             set_maximum_wait(MAX(0, screen->paused_rendering.expires_at - now));
-        } else set_maximum_wait(OPT(input_delay) - pd.time_since_new_input);
-    } else if (pd.has_pending_input) set_maximum_wait(OPT(input_delay) - pd.time_since_new_input);
-    return pd.input_read;
+        } else set_maximum_wait(pd->input_delay - pd->time_since_new_input);
+        if (pd->regime == INPUT_REGIME_BULK) {
+            // Dont force an immediate render for bulk output, let it be drawn
+            // at the normal repaint rate instead
+            set_maximum_wait(OPT(repaint_delay));
+            return false;
+        }
+    } else if (pd->has_pending_input) set_maximum_wait(pd->input_delay - pd->time_since_new_input);
+    else {
+        set_maximum_wait(screen_compact_text_cache_when_idle(screen, now));
+        set_maximum_wait(screen_release_memory_when_idle(screen, now));
+        set_maximum_wait(screen_garbage_collect_hyperlinks_when_idle(screen, now));
+    }
+    return pd->input_read;
+}
+
+static bool
+do_parse(ChildMonitor *self, Screen *screen, monotonic_t now, bool flush, monotonic_t time_slice) {
+    ParseData pd = {.dump_callback = self->dump_callback, .now = now, .time_slice = time_slice};
+    self->parse_func(screen, &pd, flush);
+    return handle_parse_result(self, screen, &pd, now);
+}
+
+// Parallel parsing {{{
+// Input for windows can be parsed in parallel as long as parsing does not
+// call into Python or the windowing system, see consume_input_off_main_thread().
+// The main thread takes part in parsing and then finishes off whatever input
+// the workers had to leave for it. Scrolling moves images, which can free
+// them along with their textures, using the GL context and global state, so
+// screens that have images are always parsed on the main thread.
+
+#define MAX_PARSE_THREADS 16u
+// The time all windows together can spend parsing in one loop iteration when
+// more than one has input, see parse_input()
+#define PARSE_TIME_BUDGET ms_to_monotonic_t(16ll)
+#define MIN_PARSE_TIME_SLICE ms_to_monotonic_t(2ll)
+
+typedef struct {
+    Screen *screen;
+    ParseData pd;
+} ParseJob;
+
+static struct {
+    pthread_t threads[MAX_PARSE_THREADS];
+    unsigned num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t work_available, work_done;
+    ParseJob *jobs;
+    size_t num_jobs, next_job, jobs_remaining;
+    bool initialized, shutting_down;
+} parse_pool = {0};
+static ParseJob parse_jobs[MAX_CHILDREN] = {{0}};
+
+#define pool_mutex(op) pthread_mutex_##op(&parse_pool.lock);
+
+static void
+run_parse_jobs(void) {
+    // must be called with the pool lock held
+    while (parse_pool.next_job < parse_pool.num_jobs) {
+        ParseJob *job = parse_pool.jobs + parse_pool.next_job++;
+        pool_mutex(unlock);
+        parse_worker(job->screen, &job->pd, false);
+        pool_mutex(lock);
+        if (--parse_pool.jobs_remaining == 0) pthread_cond_signal(&parse_pool.work_done);
+    }
+}
+
+static void*
+parse_pool_worker(void *data UNUSED) {
+    set_thread_name("KittyParser");
+    pool_mutex(lock);
+    while (true) {
+        while (!parse_pool.shutting_down && parse_pool.next_job >= parse_pool.num_jobs) pthread_cond_wait(&parse_pool.work_available, &parse_pool.lock);
+        if (parse_pool.shutting_down) break;
+        run_parse_jobs();
+    }
+    pool_mutex(unlock);
+    return NULL;
+}
+
+static void
+stop_parse_pool(void) {
+    if (!parse_pool.num_threads) return;
+    pool_mutex(lock);
+    parse_pool.shutting_down = true;
+    pthread_cond_broadcast(&parse_pool.work_available);
+    pool_mutex(unlock);
+    for (unsigned i = 0; i < parse_pool.num_threads; i++) pthread_join(parse_pool.threads[i], NULL);
+    parse_pool.num_threads = 0;
+    parse_pool.shutting_down = false;
+}
+
+static unsigned
+desired_num_of_parse_threads(void) {
+    // The main thread is one of the parse threads
+    if (OPT(parse_threads)) return MIN(OPT(parse_threads), MAX_PARSE_THREADS + 1) - 1;
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus < 4) return 0;
+    return MIN((unsigned)ncpus / 2u, 8u) - 1;
+}
+
+static bool
+ensure_parse_pool(void) {
+    if (!parse_pool.initialized) {
+        if (pthread_mutex_init(&parse_pool.lock, NULL) != 0 || pthread_cond_init(&parse_pool.work_available, NULL) != 0 || pthread_cond_init(&parse_pool.work_done, NULL) != 0) {
+            log_error("Failed to initialize parse thread pool, parsing on the main thread only");
+            OPT(parse_threads) = 1;
+            return false;
+        }
+        parse_pool.initialized = true;
+    }
+    unsigned desired = desired_num_of_parse_threads();
+    if (desired != parse_pool.num_threads) {
+        stop_parse_pool();
+        for (; parse_pool.num_threads < desired; parse_pool.num_threads++) {
+            int ret = pthread_create(&parse_pool.threads[parse_pool.num_threads], NULL, parse_pool_worker, NULL);
+            if (ret != 0) {
+                log_error("Failed to start parse thread with error: %s", strerror(ret));
+                OPT(parse_threads) = parse_pool.num_threads + 1;
+                break;
+            }
+        }
+    }
+    return parse_pool.num_threads > 0;
+}
+
+static void
+parse_in_parallel(ParseJob *jobs, size_t num_jobs) {
+    pool_mutex(lock);
+    parse_pool.jobs = jobs; parse_pool.num_jobs = num_jobs;
+    parse_pool.next_job = 0; parse_pool.jobs_remaining = num_jobs;
+    pthread_cond_broadcast(&parse_pool.work_available);
+    run_parse_jobs();
+    while (parse_pool.jobs_remaining) pthread_cond_wait(&parse_pool.work_done, &parse_pool.lock);
+    parse_pool.jobs = NULL; parse_pool.num_jobs = 0; parse_pool.next_job = 0;
+    pool_mutex(unlock);
+}
+
+static bool
+can_parse_off_main_thread(const Screen *screen) {
+    return grman_is_empty(screen->main_grman) && grman_is_empty(screen->alt_grman);
+}
+
+static size_t
+parse_children_in_parallel(ChildMonitor *self, size_t count, monotonic_t now, monotonic_t time_slice, bool *input_read) {
+    // Returns the number of children parsed, zero if parallel parsing was
+    // not used, in which case none were
+    if (count < 2 || self->parse_func != parse_worker || !ensure_parse_pool()) return 0;
+    size_t num_jobs = 0, num_with_input = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!scratch[i].needs_removal && can_parse_off_main_thread(scratch[i].screen)) {
+            // children without pending input are included so that their parsers get to do housekeeping
+            if (vt_parser_has_pending_input(scratch[i].screen->vt_parser)) num_with_input++;
+            scratch[i].screen->parsing_off_main_thread = true;
+            parse_jobs[num_jobs++] = (ParseJob){.screen=scratch[i].screen, .pd={.now=now, .off_main_thread=true, .time_slice=time_slice}};
+        }
+    }
+    if (num_with_input < 2) {
+        for (size_t i = 0; i < num_jobs; i++) parse_jobs[i].screen->parsing_off_main_thread = false;
+        return 0;
+    }
+    // before the workers start, so that nothing else runs while they are parsed
+    for (size_t i = 0; i < count; i++) {
+        if (!scratch[i].needs_removal && !scratch[i].screen->parsing_off_main_thread) {
+            if (do_parse(self, scratch[i].screen, now, false, time_slice)) *input_read = true;
+        }
+    }
+    parse_in_parallel(parse_jobs, num_jobs);
+    for (size_t i = 0; i < num_jobs; i++) {
+        ParseJob *job = parse_jobs + i;
+        screen_finish_off_main_thread_parse(job->screen);
+        if (job->pd.needs_main_thread) {
+            ParseData pd = {.dump_callback = self->dump_callback, .now = now};
+            self->parse_func(job->screen, &pd, true);
+            pd.input_read = true;
+            pd.write_space_created |= job->pd.write_space_created;
+            job->pd = pd;
+        }
+        if (handle_parse_result(self, job->screen, &job->pd, now)) *input_read = true;
+        job->screen = NULL;
+    }
+    return count;
 }
 
+// }}}
+
 static bool
 parse_input(ChildMonitor *self) {
     // Parse all available input that was read in the I/O thread.
@@ -519,7 +720,7 @@ parse_input(ChildMonitor *self) {
         // must be done while no locks are held, since the locks are non-recursive and
         // the python function could call into other functions in this module
         remove_count--;
-        if (remove_notify[remove_count].screen) do_parse(self, remove_notify[remove_count].screen, now, true);
+        if (remove_notify[remove_count].screen) do_parse(self, remove_notify[remove_count].screen, now, true, 0);
         PyObject *t = PyObject_CallFunction(self->death_notify, "k", remove_notify[remove_count].id);
         if (t == NULL) PyErr_Print();
         else Py_DECREF(t);
@@ -527,8 +728,20 @@ parse_input(ChildMonitor *self) {
     }
 
     for (size_t i = 0; i < count; i++) {
-        if (!scratch[i].needs_removal) {
-            if (do_parse(self, scratch[i].screen, now, false)) input_read = true;
+        // images decoded in worker threads, their responses go before the responses to newer input
+        if (!scratch[i].needs_removal && screen_finish_background_image_decodes(scratch[i].screen, false)) input_read = true;
+    }
+    // Windows with pending input share the time spent parsing, so that one
+    // being flooded with output cannot starve the others and keyboard input
+    size_t num_with_input = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!scratch[i].needs_removal && vt_parser_has_pending_input(scratch[i].screen->vt_parser)) num_with_input++;
+    }
+    const monotonic_t time_slice = num_with_input > 1 ? MAX(PARSE_TIME_BUDGET / (monotonic_t)num_with_input, MIN_PARSE_TIME_SLICE) : 0;
+    const bool parsed_in_parallel = parse_children_in_parallel(self, count, now, time_slice, &input_read) > 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!scratch[i].needs_removal && !parsed_in_parallel) {
+            if (do_parse(self, scratch[i].screen, now, false, time_slice)) input_read = true;
         }
         DECREF_CHILD(scratch[i]);
     }
@@ -710,22 +923,48 @@ change_menubar_title(PyObject *title UNUSED) {
 #endif
 }
 
+bool
+tab_bar_is_shown(const OSWindow *os_window) {
+    return os_window->tab_bar_render_data.screen && os_window->num_tabs >= OPT(tab_bar_min_tabs);
+}
+
+static void
+update_tab_bar_data(OSWindow *os_window) {
+    call_boss(update_tab_bar_data, "K", os_window->id);
+    os_window->tab_bar_data_updated = true;
+}
+
+static void
+add_window_damage(OSWindow *os_window, const Window *w) {
+    if (os_window->damage.full) return;
+    if (os_window->damage.num_rects >= MAX_DAMAGE_RECTS) { os_window->damage.full = true; return; }
+    const WindowGeometry *g = &w->render_data.geometry;
+    const int left = MAX(0, (int)g->left - (int)w->padding.left), top = MAX(0, (int)g->top - (int)w->padding.top);
+    const int right = MIN(os_window->viewport_width, (int)(g->right + w->padding.right));
+    const int bottom = MIN(os_window->viewport_height, (int)(g->bottom + w->padding.bottom));
+    if (right <= left || bottom <= top) return;
+    int *r = os_window->damage.rects + 4 * os_window->damage.num_rects++;
+    r[0] = left; r[1] = top; r[2] = right - left; r[3] = bottom - top;
+}
+
 static bool
 prepare_to_render_os_window(OSWindow *os_window, monotonic_t now, unsigned int *active_window_id, color_type *active_window_bg, unsigned int *num_visible_windows, bool *all_windows_have_same_bg, bool scan_for_animated_images) {
 #define TD os_window->tab_bar_render_data
     bool needs_render = os_window->needs_render;
+    // Changes to a single window damage only the area of that window, anything
+    // else, such as the tab bar, borders or layout, damages the whole OS window
+    if (needs_render) os_window->damage.full = true;
     os_window->needs_render = false;
     bool was_previously_rendered_with_layers = os_window->needs_layers;
     os_window->needs_layers = (
         !global_state.supports_framebuffer_srgb || effective_os_window_alpha(os_window) < 1.f ||
         os_window->live_resize.in_progress || (os_window->bgimage && os_window->bgimage->texture_id > 0)
     );
-    if (TD.screen && os_window->num_tabs >= OPT(tab_bar_min_tabs)) {
-        if (!os_window->tab_bar_data_updated) {
-            call_boss(update_tab_bar_data, "K", os_window->id);
-            os_window->tab_bar_data_updated = true;
-        }
-        if (send_cell_data_to_gpu(TD.vao_idx, TD.screen, os_window)) needs_render = true;
+    if (tab_bar_is_shown(os_window)) {
+        // The tab bar must be current before rendering, otherwise a frame
+        // shows the tab bar of the previously active tab
+        if (!os_window->tab_bar_data_updated || os_window->last_active_tab != os_window->active_tab) update_tab_bar_data(os_window);
+        if (send_cell_data_to_gpu(TD.vao_idx, TD.screen, os_window)) needs_render = os_window->damage.full = true;
         os_window->needs_layers = os_window->needs_layers || screen_needs_rendering_in_layers(os_window, NULL, TD.screen);
     }
     if (OPT(mouse_hide.hide_wait) > 0 && !is_mouse_hidden(os_window)) {
@@ -733,6 +972,7 @@ prepare_to_render_os_window(OSWindow *os_window, monotonic_t now, unsigned int *
         else set_maximum_wait(OPT(mouse_hide.hide_wait) - now + os_window->last_mouse_activity_at);
     }
     Tab *tab = os_window->tabs + os_window->active_tab;
+    if (tab->border_rects.is_dirty) os_window->damage.full = true;
     *active_window_bg = OPT(background);
     *all_windows_have_same_bg = true;
     *num_visible_windows = 0;
@@ -741,6 +981,7 @@ prepare_to_render_os_window(OSWindow *os_window, monotonic_t now, unsigned int *
         Window *w = tab->windows + i;
 #define WD w->render_data
         if (w->visible && WD.screen) {
+            bool window_damaged = false;
             os_window->needs_layers = os_window->needs_layers || screen_needs_rendering_in_layers(os_window, w, WD.screen);
             screen_check_pause_rendering(WD.screen, now);
             *num_visible_windows += 1;
@@ -752,20 +993,21 @@ prepare_to_render_os_window(OSWindow *os_window, monotonic_t now, unsigned int *
                     if (drag_scroll(w, os_window)) {
                         w->last_drag_scroll_at = now;
                         set_maximum_wait(ms_to_monotonic_t(20ll));
-                        needs_render = true;
+                        window_damaged = true;
                     } else w->last_drag_scroll_at = 0;
                 } else set_maximum_wait(now - w->last_drag_scroll_at);
             }
             bool is_active_window = i == tab->active_window;
             if (is_active_window) {
                 *active_window_id = w->id;
-                if (collect_cursor_info(&WD.screen->cursor_render_info, w, now, os_window)) needs_render = true;
+                if (collect_cursor_info(&WD.screen->cursor_render_info, w, now, os_window)) window_damaged = true;
                 WD.screen->cursor_render_info.is_focused = os_window->is_focused;
                 set_os_window_title_from_window(w, os_window);
                 *active_window_bg = window_bg;
                 if (OPT(cursor_trail)) {
                     if (update_cursor_trail(&tab->cursor_trail, w, now, os_window)) {
-                        needs_render = true;
+                        // the trail can cross window boundaries
+                        needs_render = os_window->damage.full = true;
                         // A max wait of zero causes key input processing to be
                         // slow so handle the case of OPT(repaint_delay) == 0, see https://github.com/kovidgoyal/kitty/pull/8066
                         set_maximum_wait(MAX(OPT(repaint_delay), ms_to_monotonic_t(1ll)));
@@ -779,11 +1021,11 @@ prepare_to_render_os_window(OSWindow *os_window, monotonic_t now, unsigned int *
 
             } else {
                 if (WD.screen->cursor_render_info.render_even_when_unfocused) {
-                    if (collect_cursor_info(&WD.screen->cursor_render_info, w, now, os_window)) needs_render = true;
+                    if (collect_cursor_info(&WD.screen->cursor_render_info, w, now, os_window)) window_damaged = true;
                     WD.screen->cursor_render_info.is_focused = false;
                 } else {
                     if (WD.screen->sgr_blink_was_used) {
-                        if (collect_cursor_info(&WD.screen->cursor_render_info, w, now, os_window)) needs_render = true;
+                        if (collect_cursor_info(&WD.screen->cursor_render_info, w, now, os_window)) window_damaged = true;
                         WD.screen->cursor_render_info.is_focused = false;
                     } else {
                         WD.screen->cursor_render_info.text_blink_opacity = 1;
@@ -793,27 +1035,90 @@ prepare_to_render_os_window(OSWindow *os_window, monotonic_t now, unsigned int *
             }
             if (scan_for_animated_images) {
                 monotonic_t min_gap;
-                if (scan_active_animations(WD.screen->grman, now, &min_gap, true)) needs_render = true;
+                if (scan_active_animations(WD.screen->grman, now, &min_gap, true)) window_damaged = true;
                 if (min_gap < MONOTONIC_T_MAX) {
                     global_state.check_for_active_animated_images = true;
                     set_maximum_wait(min_gap);
                 }
             }
-            if (send_cell_data_to_gpu(WD.vao_idx, WD.screen, os_window)) needs_render = true;
-            if (WD.screen->start_visual_bell_at != 0) needs_render = true;
-        }
+            if (send_cell_data_to_gpu(WD.vao_idx, WD.screen, os_window)) window_damaged = true;
+            // the bell can also change the color of the window border
+            if (WD.screen->start_visual_bell_at != 0) needs_render = os_window->damage.full = true;
+            if (window_damaged) { needs_render = true; add_window_damage(os_window, w); }
+            w->layer_cache.needs_render = window_damaged;
+        } else w->layer_cache.is_valid = false;
+    }
+    if (was_previously_rendered_with_layers != os_window->needs_layers) needs_render = os_window->damage.full = true;
+    return needs_render;
+}
+
+// Frame timing profiler {{{
+// Timings of the recent input parsing and rendering stages, kept in a ring
+// buffer, so that the cause of slow frames can be analysed, see the
+// frame-timings remote control command
+#define NUM_FRAME_TIMINGS 8192u
+static struct {
+    struct { monotonic_t start, duration; id_type os_window_id; FrameStage stage; } items[NUM_FRAME_TIMINGS];
+    unsigned count, pos;
+} frame_timings = {0};
+
+void
+record_frame_timing(FrameStage stage, id_type os_window_id, monotonic_t start, monotonic_t end) {
+    frame_timings.items[frame_timings.pos].start = start;
+    frame_timings.items[frame_timings.pos].duration = end - start;
+    frame_timings.items[frame_timings.pos].os_window_id = os_window_id;
+    frame_timings.items[frame_timings.pos].stage = stage;
+    frame_timings.pos = (frame_timings.pos + 1) % NUM_FRAME_TIMINGS;
+    frame_timings.count = MIN(frame_timings.count + 1, NUM_FRAME_TIMINGS);
+}
+
+static PyObject*
+get_frame_timings(PyObject *self UNUSED, PyObject *args UNUSED) {
+    static const char* stage_names[NUM_FRAME_STAGES] = {
+        [FRAME_STAGE_PARSE] = "parse", [FRAME_STAGE_FRAME] = "frame", [FRAME_STAGE_CELL_DATA] = "cell_data",
+        [FRAME_STAGE_GRAPHICS] = "graphics", [FRAME_STAGE_SPRITE_UPLOAD] = "sprite_upload",
+        [FRAME_STAGE_DRAW] = "draw", [FRAME_STAGE_SWAP] = "swap",
+    };
+    RAII_PyObject(ans, PyTuple_New(frame_timings.count));
+    if (!ans) return NULL;
+    const unsigned first = (frame_timings.pos + NUM_FRAME_TIMINGS - frame_timings.count) % NUM_FRAME_TIMINGS;
+    for (unsigned i = 0; i < frame_timings.count; i++) {
+        const unsigned idx = (first + i) % NUM_FRAME_TIMINGS;
+        PyObject *t = Py_BuildValue(
+            "sKLL", stage_names[frame_timings.items[idx].stage], (unsigned long long)frame_timings.items[idx].os_window_id,
+            (long long)frame_timings.items[idx].start, (long long)frame_timings.items[idx].duration);
+        if (!t) return NULL;
+        PyTuple_SET_ITEM(ans, i, t);
+    }
+    return Py_NewRef(ans);
+}
+// }}}
+
+static void
+record_input_latency(OSWindow *os_window, Screen *screen, monotonic_t swapped_at) {
+    if (!os_window->input_latency.samples) {
+        os_window->input_latency.samples = malloc(INPUT_LATENCY_SAMPLES * sizeof(os_window->input_latency.samples[0]));
+        if (!os_window->input_latency.samples) return;
     }
-    return needs_render || was_previously_rendered_with_layers != os_window->needs_layers;
+    const monotonic_t key_at = screen->input_latency.key_at;
+    os_window->input_latency.samples[os_window->input_latency.pos] = (InputLatencySample){
+        .sent=screen->input_latency.sent_at - key_at, .parsed=screen->input_latency.parsed_at - key_at,
+        .rendered=screen->input_latency.rendered_at - key_at, .swapped=swapped_at - key_at,
+    };
+    os_window->input_latency.pos = (os_window->input_latency.pos + 1) % INPUT_LATENCY_SAMPLES;
+    os_window->input_latency.count = MIN(os_window->input_latency.count + 1, INPUT_LATENCY_SAMPLES);
+    zero_at_ptr(&screen->input_latency);
 }
 
 static void
 render_prepared_os_window(OSWindow *os_window, unsigned int active_window_id, color_type active_window_bg, unsigned int num_visible_windows, bool all_windows_have_same_bg) {
+    const monotonic_t started_at = monotonic();
     Tab *tab = os_window->tabs + os_window->active_tab;
     setup_os_window_for_rendering(os_window, tab, NULL, true);
     BorderRects *br = &tab->border_rects;
     draw_borders(br->vao_idx, br->num_border_rects, br->rect_buf, br->is_dirty, active_window_bg, num_visible_windows, all_windows_have_same_bg, os_window);
     br->is_dirty = false;
-    if (TD.screen && os_window->num_tabs >= OPT(tab_bar_min_tabs)) draw_cells(&TD, os_window, true, true, false, NULL);
+    if (tab_bar_is_shown(os_window)) draw_cells(&TD, os_window, true, true, false, NULL);
     unsigned int num_of_visible_windows = 0;
     Window *active_window = NULL;
     for (unsigned int i = 0; i < tab->num_windows; i++) { if (tab->windows[i].visible) num_of_visible_windows++; }
@@ -823,11 +1128,21 @@ render_prepared_os_window(OSWindow *os_window, unsigned int active_window_id, co
             bool is_active_window = i == tab->active_window;
             if (is_active_window) active_window = w;
             draw_cells(&WD, os_window, is_active_window, false, num_of_visible_windows == 1, w);
+            if (WD.screen->input_latency.parsed_at && !WD.screen->input_latency.rendered_at) WD.screen->input_latency.rendered_at = monotonic();
             if (WD.screen->start_visual_bell_at != 0) set_maximum_wait(ANIMATION_SAMPLE_WAIT);
         }
     }
     setup_os_window_for_rendering(os_window, tab, active_window, false);
+    const monotonic_t drawn_at = monotonic(), cost = drawn_at - started_at;
+    os_window->render_cost = os_window->render_cost ? (7 * os_window->render_cost + cost) / 8 : cost;
+    record_frame_timing(FRAME_STAGE_DRAW, os_window->id, started_at, drawn_at);
     swap_window_buffers(os_window);
+    const monotonic_t swapped_at = monotonic();
+    record_frame_timing(FRAME_STAGE_SWAP, os_window->id, drawn_at, swapped_at);
+    for (unsigned int i = 0; i < tab->num_windows; i++) {
+        Window *w = tab->windows + i;
+        if (w->visible && WD.screen && WD.screen->input_latency.rendered_at) record_input_latency(os_window, WD.screen, swapped_at);
+    }
     os_window->last_active_tab = os_window->active_tab; os_window->last_num_tabs = os_window->num_tabs; os_window->last_active_window_id = active_window_id;
     os_window->focused_at_last_render = os_window->is_focused;
     if (os_window->redraw_count) os_window->redraw_count--;
@@ -865,6 +1180,10 @@ render_os_window(OSWindow *w, monotonic_t now, bool scan_for_animated_images) {
             return false;
         }
     }
+    if (!w->keep_rendering_till_swap && USE_RENDER_FRAMES && w->render_state == RENDER_FRAME_READY) {
+        const monotonic_t wait = time_to_start_rendering(w, now);
+        if (wait > 0) { set_maximum_wait(wait); return false; }
+    }
     w->render_calls++;
     make_os_window_context_current(w);
     bool needs_render = w->redraw_count > 0 || w->live_resize.in_progress;
@@ -873,30 +1192,51 @@ render_os_window(OSWindow *w, monotonic_t now, bool scan_for_animated_images) {
         w->viewport_size_dirty = false;
         needs_render = true;
     }
+    w->damage.full = needs_render; w->damage.num_rects = 0;
     unsigned int active_window_id = 0, num_visible_windows = 0;
     bool all_windows_have_same_bg;
     color_type active_window_bg = 0;
     if (!w->fonts_data) { log_error("No fonts data found for window id: %llu", w->id); return false; }
+    const monotonic_t started_at = monotonic();
     if (prepare_to_render_os_window(w, now, &active_window_id, &active_window_bg, &num_visible_windows, &all_windows_have_same_bg, scan_for_animated_images)) needs_render = true;
-    if (w->last_active_window_id != active_window_id || w->last_active_tab != w->active_tab || w->focused_at_last_render != w->is_focused) needs_render = true;
-    if (w->render_calls < 3 && w->bgimage && w->bgimage->texture_id) needs_render = true;
-    if (needs_render) render_prepared_os_window(w, active_window_id, active_window_bg, num_visible_windows, all_windows_have_same_bg);
+    if (w->last_active_window_id != active_window_id || w->last_active_tab != w->active_tab || w->focused_at_last_render != w->is_focused) needs_render = w->damage.full = true;
+    if (w->render_calls < 3 && w->bgimage && w->bgimage->texture_id) needs_render = w->damage.full = true;
+    if (needs_render) {
+        render_prepared_os_window(w, active_window_id, active_window_bg, num_visible_windows, all_windows_have_same_bg);
+        record_frame_timing(FRAME_STAGE_FRAME, w->id, started_at, monotonic());
+    }
     if (w->is_focused) change_menubar_title(w->window_title);
     return needs_render;
 }
 
+static bool
+frames_are_paced_by_compositor(monotonic_t now) {
+    // When the compositor tells us when frames are presented, rendering is
+    // limited to one frame per refresh by render frames and timed by
+    // time_to_start_rendering(), so repaint_delay is not needed
+    if (!USE_RENDER_FRAMES || !global_state.num_os_windows) return false;
+    for (size_t i = 0; i < global_state.num_os_windows; i++) {
+        OSWindow *w = global_state.os_windows + i;
+        if (w->render_state != RENDER_FRAME_READY || time_to_start_rendering(w, now) < 0) return false;
+    }
+    return true;
+}
+
 static void
 render(monotonic_t now, bool input_read) {
     EVDBG("input_read: %d, check_for_active_animated_images: %d", input_read, global_state.check_for_active_animated_images);
     static monotonic_t last_render_at = MONOTONIC_T_MIN;
     monotonic_t time_since_last_render = last_render_at == MONOTONIC_T_MIN ? OPT(repaint_delay) : now - last_render_at;
-    if (!input_read && time_since_last_render < OPT(repaint_delay)) {
+    if (!input_read && time_since_last_render < OPT(repaint_delay) && !frames_are_paced_by_compositor(now)) {
         set_maximum_wait(OPT(repaint_delay) - time_since_last_render);
         return;
     }
 
     const bool scan_for_animated_images = global_state.check_for_active_animated_images;
     global_state.check_for_active_animated_images = false;
+    const monotonic_t recycle_sprites_in = recycle_sprites_if_needed();
+    if (recycle_sprites_in) set_maximum_wait(recycle_sprites_in);
+    grman_apply_texture_budget();
 
     for (size_t i = 0; i < global_state.num_os_windows; i++) {
         OSWindow *w = global_state.os_windows + i;
@@ -1077,10 +1417,13 @@ process_pending_resizes(monotonic_t now) {
                     // prevent a "hang" if the OS never sends a resize complete event
                     // also reflow the screen when the user pauses resizing so the user can see what the resized
                     // screen will look like.
-                    if ((now - w->live_resize.last_resize_event_at) > OPT(resize_debounce_time).on_pause) update_viewport = true;
+                    const monotonic_t paused_for = now - w->live_resize.last_resize_event_at;
+                    if (paused_for > OPT(resize_debounce_time).on_pause) update_viewport = true;
                     else {
+                        // wake up only when the pause would be long enough
+                        // rather than polling, new resize events cause a wakeup anyway
                         global_state.has_pending_resizes = true;
-                        set_maximum_wait(s_double_to_monotonic_t(0.05));
+                        set_maximum_wait(OPT(resize_debounce_time).on_pause - paused_for + 1);
                     }
                 }
             } else {
@@ -1297,7 +1640,13 @@ process_global_state(void *data) {
         process_pending_resizes(now);
         input_read = true;
     }
-    if (parse_input(self)) input_read = true;
+    // background images decoded in a worker thread
+    if (finish_background_image_load(false)) input_read = true;
+    const monotonic_t parse_started_at = monotonic();
+    if (parse_input(self)) {
+        input_read = true;
+        record_frame_timing(FRAME_STAGE_PARSE, 0, parse_started_at, monotonic());
+    }
     render(now, input_read);
 #ifdef __APPLE__
     if (has_cocoa_pending_actions) {
@@ -1306,6 +1655,8 @@ process_global_state(void *data) {
     }
 #endif
     report_reaped_pids();
+    // errors moving children into systemd scopes are reported as the replies arrive
+    if (systemd_process_pending_replies()) set_maximum_wait(ms_to_monotonic_t(100));
     bool should_quit = false;
     if (global_state.has_pending_closes) should_quit = process_pending_closes(self);
     if (should_quit) {
@@ -1497,19 +1848,33 @@ print_text(const unsigned char *text, ssize_t sz) {
 #endif
 
 
+static void
+consume_written_bytes(Screen *screen, size_t written) {
+    // must be called with the screen write lock held. The written data is not
+    // removed from the buffer as moving the rest to the front after every
+    // partial write is quadratic in the amount of data when the child reads
+    // slowly, instead the start of the unwritten data is moved forward.
+    if (written) {
+        screen->write_buf_start += written;
+        if (screen->write_buf_start >= screen->write_buf_used) screen->write_buf_start = screen->write_buf_used = 0;
+    }
+}
+
 static void
 write_to_child(int fd, Screen *screen) {
     size_t written = 0;
     ssize_t ret = 0;
     screen_mutex(lock, write);
-    while (written < screen->write_buf_used) {
-        ret = write(fd, screen->write_buf + written, screen->write_buf_used - written);
+    const uint8_t *pending = screen->write_buf + screen->write_buf_start;
+    const size_t pending_sz = screen->write_buf_used - screen->write_buf_start;
+    while (written < pending_sz) {
+        ret = write(fd, pending + written, pending_sz - written);
 #ifdef KITTY_PRINT_BYTES_SENT_TO_CHILD
         fprintf(stderr, "Wrote: %zd bytes: ", ret);
 #endif
         if (ret > 0) {
 #ifdef KITTY_PRINT_BYTES_SENT_TO_CHILD
-            print_text(screen->write_buf + written, ret);
+            print_text(pending + written, ret);
 #endif
             written += ret;
         }
@@ -1520,21 +1885,121 @@ write_to_child(int fd, Screen *screen) {
             if (errno == EINTR) continue;
             if (errno == EWOULDBLOCK || errno == EAGAIN) break;
             perror("Call to write() to child fd failed, discarding data.");
-            written = screen->write_buf_used;
+            written = pending_sz;
         }
 #ifdef KITTY_PRINT_BYTES_SENT_TO_CHILD
         fprintf(stderr, "\n");
 #endif
     }
-    if (written) {
-        screen->write_buf_used -= written;
-        if (screen->write_buf_used) {
-            memmove(screen->write_buf, screen->write_buf + written, screen->write_buf_used);
-        }
+    consume_written_bytes(screen, written);
+    screen_mutex(unlock, write);
+}
+
+// Batched I/O {{{
+// When io_uring is available the reads and writes for all ready children are
+// submitted and completed with a single system call instead of one per fd.
+// user_data is the index of the child shifted left by one with the low bit
+// set for writes.
+//
+// The data to write is copied out of the screen write buffer, so that the
+// write lock is not held while the kernel reads it and producers such as key
+// input are not blocked until the batch completes. Only the I/O thread
+// removes data from the write buffer, so what was copied is still at the
+// start of the unwritten data when the write completes.
+
+#define BATCHED_WRITE_CHUNK_SIZE (64u * 1024u)
+#define BATCHED_WRITES_SIZE (16u * BATCHED_WRITE_CHUNK_SIZE)
+static struct { uint8_t *buf; size_t used; } batched_writes = {0};
+
+static bool
+queue_read(IOBatch *batch, size_t i) {
+    Screen *screen = children[i].screen;
+    size_t available_buffer_space;
+    uint8_t *buf = vt_parser_create_write_buffer(screen->vt_parser, &available_buffer_space);
+    if (!available_buffer_space) return true;
+    if (!io_batch_add_read(batch, children[i].fd, buf, available_buffer_space, i << 1)) {
+        vt_parser_commit_write(screen->vt_parser, 0);
+        return false;
     }
+    return true;
+}
+
+static bool
+queue_write(IOBatch *batch, size_t i) {
+    Screen *screen = children[i].screen;
+    if (!batched_writes.buf && !(batched_writes.buf = malloc(BATCHED_WRITES_SIZE))) return false;
+    uint8_t *buf = batched_writes.buf + batched_writes.used;
+    screen_mutex(lock, write);
+    const size_t sz = MIN(screen->write_buf_used - screen->write_buf_start, MIN(BATCHED_WRITE_CHUNK_SIZE, BATCHED_WRITES_SIZE - batched_writes.used));
+    if (sz) memcpy(buf, screen->write_buf + screen->write_buf_start, sz);
+    const bool has_pending = screen->write_buf_used > 0;
     screen_mutex(unlock, write);
+    if (!has_pending) return true;
+    if (!sz || !io_batch_add_write(batch, children[i].fd, buf, sz, (i << 1) | 1)) return false;
+    batched_writes.used += sz;
+    return true;
+}
+
+typedef struct {
+    size_t dead_children[MAX_CHILDREN], num_dead_children;
+} BatchedIOResult;
+
+static void
+on_batched_io_complete(void *data, uint64_t user_data, ssize_t result) {
+    const size_t i = user_data >> 1;
+    Screen *screen = children[i].screen;
+    if (user_data & 1) {
+        size_t written = 0;
+        screen_mutex(lock, write);
+        if (result > 0) {
+#ifdef KITTY_PRINT_BYTES_SENT_TO_CHILD
+            fprintf(stderr, "Wrote: %zd bytes: ", result); print_text(screen->write_buf + screen->write_buf_start, result); fprintf(stderr, "\n");
+#endif
+            written = result;
+        } else if (result < 0 && result != -EINTR && result != -EAGAIN && result != -EWOULDBLOCK && result != -ECANCELED) {
+            errno = -result;
+            perror("Call to write() to child fd failed, discarding data.");
+            written = screen->write_buf_used - screen->write_buf_start;
+        }
+        consume_written_bytes(screen, written);
+        screen_mutex(unlock, write);
+    } else {
+        bool child_died = result == 0;
+        if (result < 0) {
+            if (result != -EINTR && result != -EAGAIN && result != -ECANCELED) {
+                child_died = true;
+                if (result != -EIO) { errno = -result; perror("Call to read() from child fd failed"); }
+            }
+            result = 0;
+        }
+        vt_parser_commit_write(screen->vt_parser, result);
+        // the children lock cannot be acquired here as the write lock of
+        // the screen may be held, see schedule_write_to_child()
+        if (child_died) {
+            BatchedIOResult *r = data;
+            r->dead_children[r->num_dead_children++] = i;
+        }
+    }
 }
 
+static bool
+run_batched_io(IOBatch *batch) {
+    // Returns false if io_uring failed and must no longer be used, the
+    // operations it could not submit were cancelled and are retried using
+    // plain read() and write() once poll() reports their fds ready again
+    static BatchedIOResult r;
+    r.num_dead_children = 0;
+    const bool ok = io_batch_run(batch, on_batched_io_complete, &r);
+    batched_writes.used = 0;
+    if (r.num_dead_children) {
+        children_mutex(lock);
+        for (size_t i = 0; i < r.num_dead_children; i++) children[r.dead_children[i]].needs_removal = true;
+        children_mutex(unlock);
+    }
+    return ok;
+}
+// }}}
+
 static void*
 io_loop(void *data) {
     // The I/O thread loop
@@ -1545,6 +2010,8 @@ io_loop(void *data) {
     Screen *screen;
     ChildMonitor *self = (ChildMonitor*)data;
     set_thread_name("KittyChildMon");
+    // Each child can have at most one read and one write outstanding
+    IOBatch *batch = io_batch_create(2 * MAX_CHILDREN);
 
     while (LIKELY(!self->shutting_down)) {
         children_mutex(lock);
@@ -1586,16 +2053,18 @@ io_loop(void *data) {
             for (i = 0; i < self->count; i++) {
                 if (children_fds[EXTRA_FDS + i].revents & (POLLIN | POLLHUP)) {
                     data_received = true;
-                    has_more = read_bytes(children_fds[EXTRA_FDS + i].fd, children[i].screen);
-                    if (!has_more) {
-                        // child is dead
-                        children_mutex(lock);
-                        children[i].needs_removal = true;
-                        children_mutex(unlock);
+                    if (!batch || !queue_read(batch, i)) {
+                        has_more = read_bytes(children_fds[EXTRA_FDS + i].fd, children[i].screen);
+                        if (!has_more) {
+                            // child is dead
+                            children_mutex(lock);
+                            children[i].needs_removal = true;
+                            children_mutex(unlock);
+                        }
                     }
                 }
                 if (children_fds[EXTRA_FDS + i].revents & POLLOUT) {
-                    write_to_child(children[i].fd, children[i].screen);
+                    if (!batch || !queue_write(batch, i)) write_to_child(children[i].fd, children[i].screen);
                 }
                 if (children_fds[EXTRA_FDS + i].revents & POLLNVAL) {
                     // fd was closed
@@ -1605,6 +2074,7 @@ io_loop(void *data) {
                     log_error("The child %lu had its fd unexpectedly closed", children[i].id);
                 }
             }
+            if (batch && !run_batched_io(batch)) { io_batch_free(batch); batch = NULL; }
 #ifdef DEBUG_POLL_EVENTS
             for (i = 0; i < self->count + EXTRA_FDS; i++) {
 #define P(w) if (children_fds[i].revents & w) printf("i:%lu %s\n", i, #w);
@@ -1628,6 +2098,8 @@ io_loop(void *data) {
         }
     }
 #undef WAKEUP
+    io_batch_free(batch);
+    free(batched_writes.buf); batched_writes.buf = NULL;
     children_mutex(lock);
     for (i = 0; i < self->count; i++) children[i].needs_removal = true;
     remove_children(self);
@@ -2066,6 +2538,7 @@ static PyMethodDef module_methods[] = {
     METHODB(send_data_to_peer, METH_VARARGS),
     METHODB(cocoa_set_menubar_title, METH_VARARGS),
     METHODB(mask_kitty_signals_process_wide, METH_NOARGS),
+    METHODB(get_frame_timings, METH_NOARGS),
     {"sigqueue", (PyCFunction)sig_queue, METH_VARARGS, ""},
     {NULL}  /* Sentinel */
 };
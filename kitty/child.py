@@ -7,6 +7,7 @@
 from collections.abc import Generator, Sequence
 from contextlib import contextmanager, suppress
 from itertools import count
+from time import monotonic
 from typing import TYPE_CHECKING, DefaultDict, Iterable, Mapping, Optional, TypedDict
 
 import kitty.fast_data_types as fast_data_types
@@ -95,22 +96,45 @@ def checked_terminfo_dir() -> str | None:
     return terminfo_dir if os.path.isdir(terminfo_dir) else None
 
 
-def processes_in_group(grp: int) -> list[int]:
+# Building the process group map means reading the stat file of every process
+# in the system, which adds up when the titles of hundreds of windows are
+# updated, so a recently built map is reused. Process groups are almost never
+# joined after they are created, so a group not in the map, such as a job just
+# started in the foreground, is the only reason to build it again early.
+PROCESS_GROUP_MAP_MAX_AGE = 0.5
+recent_process_group_map: tuple[float, DefaultDict[int, list[int]]] | None = None
+
+
+def current_process_group_map(needed_group: int = -1) -> DefaultDict[int, list[int]]:
+    global recent_process_group_map
     gmap: DefaultDict[int, list[int]] | None = getattr(process_group_map, 'cached_map', None)
-    if gmap is None:
-        try:
-            gmap = process_group_map()
-        except Exception:
-            gmap = defaultdict(list)
-    return gmap.get(grp, [])
+    if gmap is not None:
+        return gmap
+    now = monotonic()
+    if recent_process_group_map is not None:
+        created_at, gmap = recent_process_group_map
+        if now - created_at < PROCESS_GROUP_MAP_MAX_AGE and (needed_group < 0 or needed_group in gmap):
+            return gmap
+    try:
+        gmap = process_group_map()
+    except Exception:
+        gmap = defaultdict(list)
+    recent_process_group_map = now, gmap
+    return gmap
+
+
+def processes_in_group(grp: int) -> list[int]:
+    return current_process_group_map(grp).get(grp, [])
 
 
 @contextmanager
 def cached_process_data() -> Generator[None, None, None]:
+    global recent_process_group_map
     try:
         cm = process_group_map()
     except Exception:
         cm = defaultdict(list)
+    recent_process_group_map = monotonic(), cm
     setattr(process_group_map, 'cached_map', cm)
     try:
         yield
@@ -221,7 +245,7 @@ def __init__(
         self,
         argv: Sequence[str],
         cwd: str,
-        stdin: bytes | None = None,
+        stdin: bytes | int | None = None,
         env: dict[str, str] | None = None,
         cwd_from: Optional['CwdRequest'] = None,
         is_clone_launch: str = '',
@@ -319,7 +343,11 @@ def fork(self) -> int | None:
         ready_read_fd, ready_write_fd = os.pipe()
         os.set_inheritable(ready_write_fd, False)
         os.set_inheritable(ready_read_fd, True)
-        if stdin is not None:
+        if isinstance(stdin, int):
+            # a file descriptor open for reading that is owned by us
+            stdin_read_fd, stdin_write_fd = stdin, -1
+            os.set_inheritable(stdin_read_fd, True)
+        elif stdin is not None:
             stdin_read_fd, stdin_write_fd = os.pipe()
             os.set_inheritable(stdin_write_fd, False)
             os.set_inheritable(stdin_read_fd, True)
@@ -381,7 +409,8 @@ def fork(self) -> int | None:
         self.child_fd = master
         if stdin is not None:
             os.close(stdin_read_fd)
-            fast_data_types.thread_write(stdin_write_fd, stdin)
+            if not isinstance(stdin, int):
+                fast_data_types.thread_write(stdin_write_fd, stdin)
         os.close(ready_read_fd)
         self.terminal_ready_fd = ready_write_fd
         if self.child_fd is not None:
@@ -442,7 +471,7 @@ def background_processes(self) -> list[ProcessDesc]:
             foreground_process_group_id = os.tcgetpgrp(self.child_fd)
             if foreground_process_group_id < 0:
                 return []
-            gmap = process_group_map()
+            gmap = current_process_group_map(foreground_process_group_id)
 
             sid = session_id(gmap.get(foreground_process_group_id, ()))
             if sid < 0:
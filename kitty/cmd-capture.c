@@ -0,0 +1,93 @@
+/*
+ * cmd-capture.c
+ * Copyright (C) 2026 Kovid Goyal <kovid at kovidgoyal.net>
+ *
+ * Distributed under terms of the GPL3 license.
+ */
+
+#include "cmd-capture.h"
+#include "charsets.h"
+#include <zlib.h>
+
+// Text is collected into pending and fed to a zlib stream whenever it fills up,
+// so the uncompressed output is never held in memory.
+struct CommandCapture {
+    z_stream zs;
+    uint8_t *out;
+    size_t out_capacity, max_compressed_sz, uncompressed_sz;
+    char pending[4096];
+    size_t pending_sz;
+    bool truncated, failed;
+};
+
+CommandCapture*
+alloc_command_capture(size_t max_compressed_sz) {
+    CommandCapture *self = calloc(1, sizeof(CommandCapture));
+    if (!self) return NULL;
+    if (deflateInit(&self->zs, Z_BEST_SPEED) != Z_OK) { free(self); return NULL; }
+    self->max_compressed_sz = MAX(max_compressed_sz, 1024u);
+    return self;
+}
+
+void
+free_command_capture(CommandCapture *self) {
+    if (!self) return;
+    deflateEnd(&self->zs);
+    free(self->out);
+    free(self);
+}
+
+static void
+compress_pending(CommandCapture *self, int flush) {
+    if (self->failed) return;
+    self->zs.next_in = (Bytef*)self->pending;
+    self->zs.avail_in = self->pending_sz;
+    do {
+        if (self->zs.total_out >= self->out_capacity) {
+            size_t cap = MAX(self->out_capacity * 2, 16u * 1024u);
+            // leave room past the limit for flushing the end of the stream
+            cap = MIN(cap, self->max_compressed_sz + 64u * 1024u);
+            uint8_t *n = cap > self->out_capacity ? realloc(self->out, cap) : NULL;
+            if (!n) { self->failed = true; return; }
+            self->out = n; self->out_capacity = cap;
+        }
+        self->zs.next_out = self->out + self->zs.total_out;
+        self->zs.avail_out = self->out_capacity - self->zs.total_out;
+        int ret = deflate(&self->zs, flush);
+        if (ret == Z_STREAM_ERROR) { self->failed = true; return; }
+        if (ret == Z_STREAM_END) break;
+    } while (self->zs.avail_out == 0 || self->zs.avail_in);
+    self->pending_sz = 0;
+    if (self->zs.total_out >= self->max_compressed_sz) self->truncated = true;
+}
+
+void
+command_capture_bytes(CommandCapture *self, const char *data, size_t sz) {
+    while (sz && !self->truncated && !self->failed) {
+        size_t n = MIN(sz, sizeof(self->pending) - self->pending_sz);
+        memcpy(self->pending + self->pending_sz, data, n);
+        self->pending_sz += n; self->uncompressed_sz += n; data += n; sz -= n;
+        if (self->pending_sz >= sizeof(self->pending)) compress_pending(self, Z_NO_FLUSH);
+    }
+}
+
+void
+command_capture_text(CommandCapture *self, const uint32_t *chars, size_t num) {
+    char buf[4];
+    for (size_t i = 0; i < num && !self->truncated && !self->failed; i++) {
+        if (self->pending_sz + sizeof(buf) <= sizeof(self->pending)) {
+            unsigned n = encode_utf8(chars[i], self->pending + self->pending_sz);
+            self->pending_sz += n; self->uncompressed_sz += n;
+        } else command_capture_bytes(self, buf, encode_utf8(chars[i], buf));
+    }
+}
+
+PyObject*
+command_capture_finish(CommandCapture *self) {
+    compress_pending(self, Z_FINISH);
+    PyObject *ans;
+    if (self->failed) { ans = Py_None; Py_INCREF(ans); }
+    else ans = Py_BuildValue("y#kO", (char*)self->out, (Py_ssize_t)self->zs.total_out, (unsigned long)self->uncompressed_sz, self->truncated ? Py_True : Py_False);
+    free_command_capture(self);
+    return ans;
+}
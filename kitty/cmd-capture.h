@@ -0,0 +1,22 @@
+/*
+ * cmd-capture.h
+ * Copyright (C) 2026 Kovid Goyal <kovid at kovidgoyal.net>
+ *
+ * Distributed under terms of the GPL3 license.
+ */
+
+#pragma once
+
+#include "data-types.h"
+
+// A compressed copy of the text output of a single command, built up as the
+// output is received so that it is independent of the scrollback size.
+typedef struct CommandCapture CommandCapture;
+
+CommandCapture* alloc_command_capture(size_t max_compressed_sz);
+void free_command_capture(CommandCapture *self);
+void command_capture_text(CommandCapture *self, const uint32_t *chars, size_t num);
+void command_capture_bytes(CommandCapture *self, const char *data, size_t sz);
+// Returns (zlib compressed bytes, uncompressed size, truncated) or None if
+// compression failed and frees self
+PyObject* command_capture_finish(CommandCapture *self);
@@ -274,4 +274,4 @@ def patch_colors(
         if w:
             if notify_bg and w.screen.color_profile.default_bg != bg_colors_before.get(w.id):
                 boss.default_bg_changed_for(w.id)
-            w.refresh()
+            w.refresh_colors()
@@ -14,12 +14,13 @@
 from typing import IO, TypeVar
 
 from kittens.tui.operations import colored, styled
+from kittens.tui.utils import human_size
 
 from .child import cmdline_of_pid
 from .cli import version
 from .colors import theme_colors
 from .constants import extensions_dir, is_macos, is_wayland, kitty_base_dir, kitty_exe, shell_path
-from .fast_data_types import Color, SingleKey, current_fonts, glfw_get_system_color_theme, gpu_driver_version_string, num_users, wayland_compositor_data
+from .fast_data_types import Color, SingleKey, current_fonts, glfw_get_system_color_theme, get_boss, gpu_driver_version_string, num_users, wayland_compositor_data
 from .options.types import Options as KittyOpts
 from .options.types import defaults, secret_options
 from .options.utils import KeyboardMode, KeyDefinition
@@ -296,6 +297,11 @@ def debug_config(opts: KittyOpts | None = None, global_shortcuts: dict[str, Sing
         p('Running under:', green(compositor_name()))
     p(green('OpenGL:'), gpu_driver_version_string())
     p(green('Frozen:'), 'True' if getattr(sys, 'frozen', False) else 'False')
+    if (boss := get_boss()) is not None:
+        windows = tuple(boss.all_windows)
+        idle = tuple(w for w in windows if w.screen.idle_memory_released)
+        released = sum(w.screen.idle_memory_released for w in idle)
+        p(green('Memory released by idle windows:'), f'{human_size(released)} from {len(idle)} of {len(windows)} windows')
     p(green('Fonts:'))
     for k, font in current_fonts().items():
         if hasattr(font, 'identify_for_debug'):
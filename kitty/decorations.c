@@ -1506,12 +1506,13 @@ sextant(Canvas *self, uint which) {
 #undef add_row
 }
 
-void
+bool
 render_box_char(char_type ch, uint8_t *buf, unsigned width, unsigned height, double dpi_x, double dpi_y, double scale) {
     Canvas canvas = {.mask=buf, .width = width, .height = height, .dpi={.x=dpi_x, .y=dpi_y}, .supersample_factor=1u, .scale=scale}, ss = canvas;
     ss.mask = buf + width*height; ss.supersample_factor = SUPERSAMPLE_FACTOR; ss.width *= SUPERSAMPLE_FACTOR; ss.height *= SUPERSAMPLE_FACTOR;
     fill_canvas(&canvas, 0);
     Canvas *c = &canvas;
+    bool known = true;
 
 #define SB(ch, ...) case ch: fill_canvas(&ss, 0); c = &ss, __VA_ARGS__; downsample(&ss, &canvas);
 #define CC(ch, ...) case ch: __VA_ARGS__; break
@@ -1521,7 +1522,7 @@ render_box_char(char_type ch, uint8_t *buf, unsigned width, unsigned height, dou
 START_ALLOW_CASE_RANGE
 
     switch(ch) {
-        default: log_error("Unknown box drawing character: U+%x rendered as blank", ch); break;
+        default: known = false; break;
         case L'█': fill_canvas(c, 255); break;
 
         C(L'─', hline, 1);
@@ -1876,6 +1877,7 @@ START_ALLOW_CASE_RANGE
     }
     free(canvas.holes); free(canvas.y_limits);
     free(ss.holes); free(ss.y_limits);
+    return known;
 END_ALLOW_CASE_RANGE
 #undef CC
 #undef SS
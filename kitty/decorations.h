@@ -23,5 +23,6 @@ DecorationGeometry add_missing_glyph(uint8_t *buf, FontCellMetrics fcm);
 DecorationGeometry add_beam_cursor(uint8_t *buf, FontCellMetrics fcm, double dpi_x);
 DecorationGeometry add_underline_cursor(uint8_t *buf, FontCellMetrics fcm, double dpi_y);
 DecorationGeometry add_hollow_cursor(uint8_t *buf, FontCellMetrics fcm, double dpi_x, double dpi_y);
-void render_box_char(char_type ch, uint8_t *buf, unsigned width, unsigned height, double dpi_x, double dpi_y, double scale);
+// Returns false, leaving the cell blank, for characters that are not known box drawing characters
+bool render_box_char(char_type ch, uint8_t *buf, unsigned width, unsigned height, double dpi_x, double dpi_y, double scale);
 #define SUPERSAMPLE_FACTOR 4u
@@ -11,11 +11,11 @@
 #include "safe-wrappers.h"
 #include "simd-string.h"
 #include "loop-utils.h"
-#include "fast-file-copy.h"
 #include "threading.h"
 #include "cross-platform-random.h"
 #include <structmember.h>
 #include <stdlib.h>
+#include <zlib.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <time.h>
@@ -25,14 +25,31 @@ typedef struct CacheKey {
     unsigned short hash_keylen;
 } CacheKey;
 
+// Entries are compressed when they are written to the cache file, if that
+// makes them sufficiently smaller. data_sz is always the size of the
+// uncompressed data and stored_sz the size of the data in the cache file.
+//
+// Entries that have been written can also have a copy of their data in RAM,
+// either because they were read with store_in_ram or prefetched. These copies
+// are limited to ram_limit bytes in total, least recently used first out.
+// Prefetching reads entries on the write thread so that a later read does not
+// have to wait for the disk.
+#define MIN_SIZE_FOR_COMPRESSION 4096u
+#define DEFAULT_RAM_LIMIT (64u * 1024u * 1024u)
+#define MAX_PENDING_PREFETCHES 16u
+
 typedef struct {
     uint8_t *data;
-    size_t data_sz;
-    bool written_to_disk;
+    size_t data_sz, stored_sz;
+    bool written_to_disk, is_compressed;
     off_t pos_in_cache_file;
+    uint64_t generation, last_used;
     uint8_t encryption_key[64];
 } CacheValue;
 
+static size_t
+accounted_size(const CacheValue *s) { return s->is_compressed ? s->stored_sz : s->data_sz; }
+
 #define NAME cache_map
 #define KEY_TY CacheKey
 #define VAL_TY CacheValue*
@@ -81,12 +98,16 @@ typedef struct {
     unsigned int defrag_factor;
     pthread_mutex_t lock;
     pthread_t write_thread;
-    bool thread_started, lock_inited, loop_data_inited, shutting_down, fully_initialized;
+    bool thread_started, lock_inited, loop_data_inited, shutting_down, fully_initialized, compress;
     LoopData loop_data;
-    struct { CacheValue val; CacheKey key; } currently_writing;
+    // val.data is the uncompressed, unencrypted data, stored is what is written to the cache file
+    struct { CacheValue val; CacheKey key; uint8_t *stored; } currently_writing;
     cache_map map;
     Holes holes;
-    unsigned long long total_size;
+    unsigned long long total_size, ram_size, ram_limit;
+    uint64_t generation_counter, use_counter;
+    struct { struct { uint8_t key[MAX_KEY_SIZE]; unsigned short keylen; } items[MAX_PENDING_PREFETCHES]; unsigned count; } prefetches;
+    struct { struct DefragEntry *entries; size_t count, idx; off_t cursor; bool active; } defrag;
 } DiskCache;
 
 #define mutex(op) pthread_mutex_##op(&self->lock)
@@ -99,6 +120,8 @@ new_diskcache_object(PyTypeObject *type, PyObject UNUSED *args, PyObject UNUSED
         self->cache_file_fd = -1;
         self->small_hole_threshold = 512;
         self->defrag_factor = 2;
+        self->compress = true;
+        self->ram_limit = DEFAULT_RAM_LIMIT;
     }
     return (PyObject*) self;
 }
@@ -153,12 +176,6 @@ disk_cache_size_on_disk(PyObject *self) {
     return 0;
 }
 
-typedef struct {
-    CacheKey key;
-    off_t old_offset, new_offset;
-    size_t data_sz;
-} DefragEntry;
-
 static CacheKey
 keydup(CacheKey k) {
     CacheKey ans = {.hash_key=malloc(k.hash_keylen), .hash_keylen=k.hash_keylen};
@@ -174,72 +191,6 @@ cleanup_holes(Holes *holes) {
     holes->largest_hole_size = 0;
 }
 
-static void
-defrag(DiskCache *self) {
-    int new_cache_file = -1;
-    RAII_ALLOC(DefragEntry, defrag_entries, NULL);
-    RAII_FreeFastFileCopyBuffer(fcb);
-    bool lock_released = false, ok = false;
-
-    off_t size_on_disk = size_of_cache_file(self);
-    if (size_on_disk <= 0) goto cleanup;
-    size_t num_entries = vt_size(&self->map);
-    if (!num_entries) goto cleanup;
-    new_cache_file = open_cache_file(self->cache_dir);
-    if (new_cache_file < 0) {
-        perror("Failed to open second file for defrag of disk cache");
-        goto cleanup;
-    }
-    defrag_entries = calloc(num_entries, sizeof(DefragEntry));
-    if (!defrag_entries) goto cleanup;
-    size_t total_data_size = 0, num_entries_to_defrag = 0;
-    cache_map_for_loop(i) {
-        CacheValue *s = i.data->val;
-        if (s->pos_in_cache_file > -1 && s->data_sz) {
-            total_data_size += s->data_sz;
-            DefragEntry *e = defrag_entries + num_entries_to_defrag++;
-            e->old_offset = s->pos_in_cache_file;
-            e->data_sz = s->data_sz;
-            e->key = keydup(i.data->key);  // have to dup the key as we release the mutex and another thread might free the underlying key.
-            if (!e->key.hash_key) { fprintf(stderr, "Failed to allocate space for keydup in defrag\n"); goto cleanup; }
-        }
-    }
-    if (ftruncate(new_cache_file, total_data_size) != 0) {
-        perror("Failed to allocate space for new disk cache file during defrag");
-        goto cleanup;
-    }
-    lseek(new_cache_file, 0, SEEK_SET);
-
-    mutex(unlock); lock_released = true;
-
-    off_t current_pos = 0;
-    for (size_t i = 0; i < num_entries_to_defrag; i++) {
-        DefragEntry *e = defrag_entries + i;
-        if (!copy_between_files(self->cache_file_fd, new_cache_file, e->old_offset, e->data_sz, &fcb)) {
-            perror("Failed to copy data to new disk cache file during defrag");
-            goto cleanup;
-        }
-        e->new_offset = current_pos;
-        current_pos += e->data_sz;
-    }
-    ok = true;
-
-cleanup:
-    if (lock_released) mutex(lock);
-    if (ok) {
-        cleanup_holes(&self->holes);
-        safe_close(self->cache_file_fd, __FILE__, __LINE__);
-        self->cache_file_fd = new_cache_file; new_cache_file = -1;
-        for (size_t i = 0; i < num_entries_to_defrag; i++) {
-            DefragEntry *e = defrag_entries + i;
-            cache_map_itr i = vt_get(&self->map, e->key);
-            if (!vt_is_end(i)) i.data->val->pos_in_cache_file = e->new_offset;
-            free(e->key.hash_key);
-        }
-    }
-    if (new_cache_file > -1) safe_close(new_cache_file, __FILE__, __LINE__);
-}
-
 static void
 append_position(PosList *p, off_t pos) {
     ensure_space_for(p, positions, off_t, p->count + 1, capacity, 8, false);
@@ -357,16 +308,238 @@ static void
 remove_from_disk(DiskCache *self, CacheValue *s) {
     if (s->written_to_disk) {
         s->written_to_disk = false;
-        if (s->data_sz && s->pos_in_cache_file > -1) {
-            add_hole(self, s->pos_in_cache_file, s->data_sz);
+        // data is no longer a copy of what is on disk, so it is not part of the RAM tier any more
+        if (s->data) self->ram_size -= MIN(self->ram_size, s->data_sz);
+        if (s->stored_sz && s->pos_in_cache_file > -1) {
+            add_hole(self, s->pos_in_cache_file, s->stored_sz);
             s->pos_in_cache_file = -1;
         }
     }
 }
 
+#define CACHE_FILE_TRUNCATED -1
+#define CACHE_ENTRY_NOT_WRITTEN -2
+#define CACHE_ENTRY_CORRUPT -3
+
+static int
+read_from_cache_file(const DiskCache *self, off_t pos, size_t sz, void *dest) {
+    // Does not use the Python API, returns zero on success, an errno value or one of the error codes above
+    uint8_t *p = dest;
+    while (sz) {
+        ssize_t n = pread(self->cache_file_fd, p, sz, pos);
+        if (n > 0) {
+            sz -= n;
+            p += n;
+            pos += n;
+            continue;
+        }
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return errno;
+        }
+        if (n == 0) return CACHE_FILE_TRUNCATED;
+    }
+    return 0;
+}
+
+static bool
+write_to_cache_file(const DiskCache *self, off_t pos, size_t sz, const void *src) {
+    const uint8_t *p = src;
+    while (sz) {
+        ssize_t n = pwrite(self->cache_file_fd, p, sz, pos);
+        if (n > 0) {
+            sz -= n;
+            p += n;
+            pos += n;
+            continue;
+        }
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            perror("Failed to write to disk-cache file");
+        } else fprintf(stderr, "Failed to write to disk-cache file with zero return\n");
+        return false;
+    }
+    return true;
+}
+
+// Defragmentation is incremental so that readers are never locked out for
+// long. A pass moves the entries that were in the cache file when it started
+// towards the start of the file in order of position, one entry per iteration
+// of the write loop, and then truncates the file after the last entry. While a
+// pass is running new entries are appended to the file rather than written into
+// holes, so that the space being compacted into stays free, and are moved once
+// the entries the pass started with are done.
+
+typedef struct DefragEntry {
+    CacheKey key;
+    off_t pos;
+    size_t stored_sz;
+    uint64_t generation;
+} DefragEntry;
+
+#define MAX_DEFRAG_ENTRIES_SKIPPED_PER_STEP 1024u
+
+static void
+end_defrag(DiskCache *self) {
+    for (size_t i = 0; i < self->defrag.count; i++) free(self->defrag.entries[i].key.hash_key);
+    free(self->defrag.entries);
+    zero_at_ptr(&self->defrag);
+}
+
+static int
+cmp_defrag_entries(const void *a_, const void *b_) {
+    const DefragEntry *a = a_, *b = b_;
+    return a->pos < b->pos ? -1 : (a->pos > b->pos ? 1 : 0);
+}
+
+static bool
+collect_defrag_entries(DiskCache *self) {
+    // Must be called with the lock held. Collects the entries after the
+    // cursor, returns false if there are none.
+    for (size_t i = 0; i < self->defrag.count; i++) free(self->defrag.entries[i].key.hash_key);
+    free(self->defrag.entries); self->defrag.entries = NULL;
+    self->defrag.count = 0; self->defrag.idx = 0;
+    const size_t num_entries = vt_size(&self->map);
+    if (!num_entries || !(self->defrag.entries = calloc(num_entries, sizeof(DefragEntry)))) return false;
+    cache_map_for_loop(i) {
+        CacheValue *s = i.data->val;
+        if (s->written_to_disk && s->pos_in_cache_file >= self->defrag.cursor && s->stored_sz) {
+            DefragEntry *e = self->defrag.entries + self->defrag.count;
+            // have to dup the key as the lock is released between steps and another thread might free the underlying key.
+            e->key = keydup(i.data->key);
+            if (!e->key.hash_key) { fprintf(stderr, "Failed to allocate space for keydup in defrag\n"); return false; }
+            e->pos = s->pos_in_cache_file; e->stored_sz = s->stored_sz; e->generation = s->generation;
+            self->defrag.count++;
+        }
+    }
+    qsort(self->defrag.entries, self->defrag.count, sizeof(DefragEntry), cmp_defrag_entries);
+    return self->defrag.count > 0;
+}
+
+static void
+start_defrag(DiskCache *self) {
+    // Must be called with the lock held
+    end_defrag(self);
+    self->defrag.active = true;
+}
+
+#define hole_overlaps_range(pos, size) ((pos) < end && (pos) + (size) > start)
+
+static void
+remove_holes_in_range(DiskCache *self, off_t start, off_t end) {
+    // Holes that start before the range, which can happen when a hole has been
+    // merged with one in the range, are shortened to end at its start
+    size_t count = 0;
+    hole_pos_map_for_loop(i) { if (hole_overlaps_range(i.data->key, i.data->val)) count++; }
+    if (!count) return;
+    RAII_ALLOC(Hole, holes, malloc(count * sizeof(Hole)));
+    if (!holes) fatal("Out of memory");
+    count = 0;
+    hole_pos_map_for_loop(i) {
+        if (hole_overlaps_range(i.data->key, i.data->val)) holes[count++] = (Hole){.pos=i.data->key, .size=i.data->val};
+    }
+    for (size_t i = 0; i < count; i++) {
+        remove_hole_from_maps(&self->holes, holes[i]);
+        if (holes[i].pos < start) add_hole_to_maps(&self->holes, (Hole){.pos=holes[i].pos, .size=start - holes[i].pos});
+    }
+}
+#undef hole_overlaps_range
+
+static void
+truncate_after_last_entry(DiskCache *self) {
+    // Must be called with the lock held
+    off_t end = 0;
+    cache_map_for_loop(i) {
+        CacheValue *s = i.data->val;
+        if (s->written_to_disk && s->pos_in_cache_file > -1) end = MAX(end, s->pos_in_cache_file + (off_t)s->stored_sz);
+    }
+    const off_t size_on_disk = size_of_cache_file(self);
+    if (size_on_disk < 0 || end >= size_on_disk) return;
+    if (ftruncate(self->cache_file_fd, end) != 0) { perror("Failed to truncate disk cache file after defrag"); return; }
+    remove_holes_in_range(self, end, size_on_disk);
+}
+
+static bool
+defrag_step(DiskCache *self) {
+    // Must be called without the lock held. Returns true if the pass is not finished.
+    mutex(lock);
+    DefragEntry e = {0};
+    bool found = false;
+    for (unsigned skipped = 0; !found; skipped++) {
+        if (skipped >= MAX_DEFRAG_ENTRIES_SKIPPED_PER_STEP) { mutex(unlock); return true; }
+        if (self->defrag.idx >= self->defrag.count && !collect_defrag_entries(self)) break;
+        e = self->defrag.entries[self->defrag.idx++];
+        cache_map_itr i = vt_get(&self->map, e.key);
+        const CacheValue *s = vt_is_end(i) ? NULL : i.data->val;
+        // entries that have been removed or replaced since the pass started are
+        // now holes that the following entries are moved into
+        if (!s || s->generation != e.generation || !s->written_to_disk || s->pos_in_cache_file != e.pos) continue;
+        if (e.pos == self->defrag.cursor) self->defrag.cursor += e.stored_sz;
+        else found = true;
+    }
+    if (!found) {
+        truncate_after_last_entry(self);
+        end_defrag(self);
+        mutex(unlock);
+        return false;
+    }
+    const off_t dest = self->defrag.cursor;
+    // the defrag entries can be freed by clear_disk_cache() while the lock is released
+    uint8_t key[MAX_KEY_SIZE];
+    memcpy(key, e.key.hash_key, e.key.hash_keylen); e.key.hash_key = key;
+    mutex(unlock);
+
+    RAII_ALLOC(uint8_t, buf, malloc(e.stored_sz));
+    bool ok = buf && read_from_cache_file(self, e.pos, e.stored_sz, buf) == 0;
+    // Readers read the entry from its current position with the lock held, so
+    // if the destination overlaps it, it can only be written with the lock held
+    const bool overlaps = dest + (off_t)e.stored_sz > e.pos;
+    if (ok && !overlaps) ok = write_to_cache_file(self, dest, e.stored_sz, buf);
+
+    mutex(lock);
+    if (ok) {
+        cache_map_itr i = vt_get(&self->map, e.key);
+        CacheValue *s = vt_is_end(i) ? NULL : i.data->val;
+        if (s && s->generation == e.generation && s->written_to_disk && s->pos_in_cache_file == e.pos) {
+            if (!overlaps || write_to_cache_file(self, dest, e.stored_sz, buf)) {
+                // the free space between the cursor and the entry is now after the entry
+                remove_holes_in_range(self, dest, e.pos);
+                s->pos_in_cache_file = dest;
+                self->defrag.cursor = dest + e.stored_sz;
+                add_hole(self, self->defrag.cursor, e.pos - dest);
+            } else ok = false;
+        }
+    } else fprintf(stderr, "Failed to move entry in disk cache during defrag\n");
+    if (!ok) end_defrag(self);
+    const bool more = self->defrag.active;
+    mutex(unlock);
+    return more;
+}
+
+static void
+enforce_ram_limit(DiskCache *self) {
+    while (self->ram_size > self->ram_limit) {
+        CacheValue *lru = NULL;
+        cache_map_for_loop(i) {
+            CacheValue *s = i.data->val;
+            if (s->written_to_disk && s->data && (!lru || s->last_used < lru->last_used)) lru = s;
+        }
+        if (!lru) { self->ram_size = 0; break; }
+        free(lru->data); lru->data = NULL;
+        self->ram_size -= MIN(self->ram_size, lru->data_sz);
+    }
+}
+
+static void
+keep_in_ram(DiskCache *self, CacheValue *s, uint8_t *data) {
+    // Takes ownership of data which must be a copy of the data of s, that has been written to disk
+    s->data = data; s->last_used = ++self->use_counter;
+    self->ram_size += s->data_sz;
+    enforce_ram_limit(self);
+}
+
 static bool
 find_cache_entry_to_write(DiskCache *self) {
-    if (needs_defrag(self)) defrag(self);
     cache_map_for_loop(i) {
         CacheValue *s = i.data->val;
         if (!s->written_to_disk) {
@@ -376,24 +549,47 @@ find_cache_entry_to_write(DiskCache *self) {
                 s->data = NULL;
                 self->currently_writing.val.data_sz = s->data_sz;
                 self->currently_writing.val.pos_in_cache_file = -1;
-                xor_data64(s->encryption_key, self->currently_writing.val.data, s->data_sz);
+                self->currently_writing.val.generation = s->generation;
+                memcpy(self->currently_writing.val.encryption_key, s->encryption_key, sizeof(s->encryption_key));
                 self->currently_writing.key.hash_keylen = MIN(i.data->key.hash_keylen, MAX_KEY_SIZE);
                 memcpy(self->currently_writing.key.hash_key, i.data->key.hash_key, self->currently_writing.key.hash_keylen);
-                find_hole_to_use(self, self->currently_writing.val.data_sz);
                 return true;
             }
             s->written_to_disk = true;
             s->pos_in_cache_file = 0;
-            s->data_sz = 0;
+            s->data_sz = 0; s->stored_sz = 0;
         }
     }
     return false;
 }
 
+static bool
+prepare_currently_writing(DiskCache *self, bool compress) {
+    // Called without the lock held, so must not change currently_writing.val.data
+    // as it is used to read the entry while it is being written
+    CacheValue *v = &self->currently_writing.val;
+    free(self->currently_writing.stored);
+    self->currently_writing.stored = NULL;
+    v->is_compressed = false; v->stored_sz = v->data_sz;
+    if (compress && v->data_sz >= MIN_SIZE_FOR_COMPRESSION) {
+        uLongf sz = compressBound(v->data_sz);
+        uint8_t *buf = malloc(sz);
+        // Only worth the cost of decompressing on every read if the data shrinks to at most three quarters of its size
+        if (buf && compress2(buf, &sz, v->data, v->data_sz, Z_BEST_SPEED) == Z_OK && sz <= v->data_sz - v->data_sz / 4) {
+            self->currently_writing.stored = buf;
+            v->is_compressed = true; v->stored_sz = sz;
+        } else free(buf);
+    }
+    if (!self->currently_writing.stored) {
+        if (!(self->currently_writing.stored = malloc(MAX(1u, v->data_sz)))) return false;
+        memcpy(self->currently_writing.stored, v->data, v->data_sz);
+    }
+    xor_data64(v->encryption_key, self->currently_writing.stored, v->stored_sz);
+    return true;
+}
+
 static bool
 write_dirty_entry(DiskCache *self) {
-    size_t left = self->currently_writing.val.data_sz;
-    uint8_t *p = self->currently_writing.val.data;
     if (self->currently_writing.val.pos_in_cache_file < 0) {
         self->currently_writing.val.pos_in_cache_file = size_of_cache_file(self);
         if (self->currently_writing.val.pos_in_cache_file < 0) {
@@ -401,39 +597,39 @@ write_dirty_entry(DiskCache *self) {
             return false;
         }
     }
-    off_t offset = self->currently_writing.val.pos_in_cache_file;
-    while (left > 0) {
-        ssize_t n = pwrite(self->cache_file_fd, p, left, offset);
-        if (n < 0) {
-            if (errno == EINTR || errno == EAGAIN) continue;
-            perror("Failed to write to disk-cache file");
-            self->currently_writing.val.pos_in_cache_file = -1;
-            return false;
-        }
-        if (n == 0) {
-            fprintf(stderr, "Failed to write to disk-cache file with zero return\n");
-            self->currently_writing.val.pos_in_cache_file = -1;
-            return false;
-        }
-        left -= n;
-        p += n;
-        offset += n;
+    if (!write_to_cache_file(self, self->currently_writing.val.pos_in_cache_file, self->currently_writing.val.stored_sz, self->currently_writing.stored)) {
+        self->currently_writing.val.pos_in_cache_file = -1;
+        return false;
     }
     return true;
 }
 
 static void
 retire_currently_writing(DiskCache *self) {
+    const CacheValue *v = &self->currently_writing.val;
     cache_map_itr i = vt_get(&self->map, self->currently_writing.key);
-    if (!vt_is_end(i)) {
-        i.data->val->written_to_disk = true;
-        i.data->val->pos_in_cache_file = self->currently_writing.val.pos_in_cache_file;
+    if (!vt_is_end(i) && i.data->val->generation == v->generation) {
+        CacheValue *s = i.data->val;
+        s->written_to_disk = true;
+        s->pos_in_cache_file = v->pos_in_cache_file;
+        self->total_size -= MIN(self->total_size, accounted_size(s));
+        s->stored_sz = v->stored_sz; s->is_compressed = v->is_compressed;
+        self->total_size += accounted_size(s);
+        // read with store_in_ram while it was being written
+        if (s->data) keep_in_ram(self, s, s->data);
+    } else if (v->pos_in_cache_file > -1 && v->stored_sz) {
+        // the entry was replaced or removed while it was being written
+        add_hole(self, v->pos_in_cache_file, v->stored_sz);
     }
     free(self->currently_writing.val.data);
     self->currently_writing.val.data = NULL;
     self->currently_writing.val.data_sz = 0;
+    free(self->currently_writing.stored);
+    self->currently_writing.stored = NULL;
 }
 
+static bool prefetch_next_entry(DiskCache *self);
+
 static void*
 write_loop(void *data) {
     DiskCache *self = (DiskCache*)data;
@@ -445,20 +641,36 @@ write_loop(void *data) {
 
     while (!self->shutting_down) {
         mutex(lock);
+        // prefetches are done first as something is waiting for them
+        if (prefetch_next_entry(self)) { mutex(unlock); continue; }
         found_dirty_entry = find_cache_entry_to_write(self);
+        if (!found_dirty_entry && !self->defrag.active && needs_defrag(self)) start_defrag(self);
         size_t count = vt_size(&self->map);
+        const bool compress = self->compress, defragging = self->defrag.active;
         mutex(unlock);
         if (found_dirty_entry) {
-            write_dirty_entry(self);
+            // compress and encrypt without the lock as that can take a while for large entries
+            if (prepare_currently_writing(self, compress)) {
+                mutex(lock);
+                // holes are not used while defragmenting as they are being compacted
+                if (!self->defrag.active) find_hole_to_use(self, self->currently_writing.val.stored_sz);
+                mutex(unlock);
+                write_dirty_entry(self);
+            } else self->currently_writing.val.pos_in_cache_file = -1;
             mutex(lock);
             retire_currently_writing(self);
             mutex(unlock);
             continue;
+        } else if (defragging) {
+            if (defrag_step(self)) continue;
         } else if (!count) {
             mutex(lock);
             count = vt_size(&self->map);
             if (!count && self->cache_file_fd > -1) {
-                if (ftruncate(self->cache_file_fd, 0) == 0) lseek(self->cache_file_fd, 0, SEEK_END);
+                if (ftruncate(self->cache_file_fd, 0) == 0) {
+                    lseek(self->cache_file_fd, 0, SEEK_END);
+                    cleanup_holes(&self->holes);
+                }
             }
             mutex(unlock);
         }
@@ -552,12 +764,13 @@ dealloc(DiskCache* self) {
         free_loop_data(&self->loop_data);
         self->loop_data_inited = false;
     }
-    vt_cleanup(&self->map); cleanup_holes(&self->holes);
+    vt_cleanup(&self->map); cleanup_holes(&self->holes); end_defrag(self);
     if (self->cache_file_fd > -1) {
         safe_close(self->cache_file_fd, __FILE__, __LINE__);
         self->cache_file_fd = -1;
     }
     if (self->currently_writing.val.data) free(self->currently_writing.val.data);
+    free(self->currently_writing.stored);
     free(self->cache_dir); self->cache_dir = NULL;
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
@@ -593,10 +806,12 @@ add_to_disk_cache(PyObject *self_, const void *key, size_t key_sz, const void *d
     } else {
         s = i.data->val;
         remove_from_disk(self, s);
-        self->total_size -= MIN(self->total_size, s->data_sz);
+        self->total_size -= MIN(self->total_size, accounted_size(s));
         if (s->data) free(s->data);
     }
     s->data = copied_data; s->data_sz = data_sz; copied_data = NULL;
+    s->stored_sz = 0; s->is_compressed = false;
+    s->generation = ++self->generation_counter;
     self->total_size += s->data_sz;
 end:
     mutex(unlock);
@@ -620,7 +835,7 @@ remove_from_disk_cache(PyObject *self_, const void *key, size_t key_sz) {
         removed = true;
         s = i.data->val;
         remove_from_disk(self, s);
-        self->total_size = (self->total_size > s->data_sz) ? self->total_size - s->data_sz : 0;
+        self->total_size -= MIN(self->total_size, accounted_size(s));
         vt_erase_itr(&self->map, i);
     }
     mutex(unlock);
@@ -635,44 +850,88 @@ clear_disk_cache(PyObject *self_) {
     mutex(lock);
     vt_cleanup(&self->map);
     cleanup_holes(&self->holes);
-    self->total_size = 0;
+    end_defrag(self);
+    self->total_size = 0; self->ram_size = 0; self->prefetches.count = 0;
     if (self->cache_file_fd > -1) add_hole(self, 0, size_of_cache_file(self));
     mutex(unlock);
     wakeup_write_loop(self);
 }
 
 static void
-read_from_cache_file(const DiskCache *self, off_t pos, size_t sz, void *dest) {
-    uint8_t *p = dest;
-    while (sz) {
-        ssize_t n = pread(self->cache_file_fd, p, sz, pos);
-        if (n > 0) {
-            sz -= n;
-            p += n;
-            pos += n;
-            continue;
-        }
-        if (n < 0) {
-            if (errno == EINTR || errno == EAGAIN) continue;
-            PyErr_SetFromErrnoWithFilename(PyExc_OSError, self->cache_dir);
-            break;
-        }
-        if (n == 0) {
-            PyErr_SetString(PyExc_OSError, "Disk cache file truncated");
-            break;
-        }
+set_read_error(const DiskCache *self, int err) {
+    switch (err) {
+        case 0: break;
+        case CACHE_FILE_TRUNCATED: PyErr_SetString(PyExc_OSError, "Disk cache file truncated"); break;
+        case CACHE_ENTRY_NOT_WRITTEN: PyErr_SetString(PyExc_OSError, "Cache entry was not written, could not read from it"); break;
+        case CACHE_ENTRY_CORRUPT: PyErr_SetString(PyExc_OSError, "Cache entry could not be decompressed"); break;
+        default: errno = err; PyErr_SetFromErrnoWithFilename(PyExc_OSError, self->cache_dir); break;
     }
 }
 
-static void
-read_from_cache_entry(const DiskCache *self, const CacheValue *s, void *dest) {
-    size_t sz = s->data_sz;
-    off_t pos = s->pos_in_cache_file;
-    if (pos < 0) {
-        PyErr_SetString(PyExc_OSError, "Cache entry was not written, could not read from it");
-        return;
+static int
+read_stored_data(const DiskCache *self, const CacheValue *s, void *dest) {
+    // Reads the data of an entry that has been written from the cache file,
+    // s need not be in the map, so this can be called without the lock from
+    // the write thread with a copy of the entry
+    if (s->pos_in_cache_file < 0) return CACHE_ENTRY_NOT_WRITTEN;
+    if (!s->is_compressed) {
+        int ret = read_from_cache_file(self, s->pos_in_cache_file, s->data_sz, dest);
+        if (ret == 0) xor_data64(s->encryption_key, dest, s->data_sz);
+        return ret;
+    }
+    RAII_ALLOC(uint8_t, stored, malloc(s->stored_sz));
+    if (!stored) return ENOMEM;
+    int ret = read_from_cache_file(self, s->pos_in_cache_file, s->stored_sz, stored);
+    if (ret == 0) {
+        xor_data64(s->encryption_key, stored, s->stored_sz);
+        uLongf sz = s->data_sz;
+        if (uncompress(dest, &sz, stored, s->stored_sz) != Z_OK || sz != s->data_sz) ret = CACHE_ENTRY_CORRUPT;
     }
-    read_from_cache_file(self, pos, sz, dest);
+    return ret;
+}
+
+static int
+read_entry_data(DiskCache *self, CacheValue *s, CacheKey k, void *dest) {
+    // Must be called with the lock held
+    if (s->data) {
+        memcpy(dest, s->data, s->data_sz);
+        s->last_used = ++self->use_counter;
+        return 0;
+    }
+    if (self->currently_writing.val.data && self->currently_writing.key.hash_key && keys_are_equal(self->currently_writing.key, k)) {
+        memcpy(dest, self->currently_writing.val.data, s->data_sz);
+        return 0;
+    }
+    return read_stored_data(self, s, dest);
+}
+
+static bool
+prefetch_next_entry(DiskCache *self) {
+    // Must be called with the lock held, which is released while reading from
+    // the cache file. Only the write thread changes the cache file, so the
+    // entry cannot move while it is being read. Returns false if there are no
+    // pending prefetches.
+    while (self->prefetches.count) {
+        CacheKey k = {.hash_key=self->prefetches.items[0].key, .hash_keylen=self->prefetches.items[0].keylen};
+        uint8_t key[MAX_KEY_SIZE];
+        memcpy(key, k.hash_key, k.hash_keylen); k.hash_key = key;
+        memmove(self->prefetches.items, self->prefetches.items + 1, --self->prefetches.count * sizeof(self->prefetches.items[0]));
+        cache_map_itr i = vt_get(&self->map, k);
+        if (vt_is_end(i)) continue;
+        CacheValue v = *i.data->val;
+        if (!v.written_to_disk || v.data || !v.data_sz || v.pos_in_cache_file < 0) continue;
+        mutex(unlock);
+        uint8_t *data = malloc(v.data_sz);
+        if (data && read_stored_data(self, &v, data) != 0) { free(data); data = NULL; }
+        mutex(lock);
+        if (!data) return true;
+        i = vt_get(&self->map, k);
+        CacheValue *s = vt_is_end(i) ? NULL : i.data->val;
+        if (s && s->generation == v.generation && s->written_to_disk && !s->data) keep_in_ram(self, s, data);
+        else free(data);
+        return true;
+    }
+    return false;
 }
 
 void*
@@ -690,19 +949,14 @@ read_from_disk_cache(PyObject *self_, const void *key, size_t key_sz, void*(allo
     data = allocator(allocator_data, s->data_sz);
     if (!data) { PyErr_NoMemory(); goto end; }
 
-    if (s->data) { memcpy(data, s->data, s->data_sz); }
-    else if (self->currently_writing.val.data && self->currently_writing.key.hash_key && keys_are_equal(self->currently_writing.key, k)) {
-        memcpy(data, self->currently_writing.val.data, s->data_sz);
-        xor_data64(s->encryption_key, data, s->data_sz);
-    }
-    else {
-        read_from_cache_entry(self, s, data);
-        xor_data64(s->encryption_key, data, s->data_sz);
-    }
-    if (store_in_ram && !s->data && s->data_sz) {
-        void *copy = malloc(s->data_sz);
+    set_read_error(self, read_entry_data(self, s, k, data));
+    if (store_in_ram && !s->data && s->data_sz && !PyErr_Occurred()) {
+        uint8_t *copy = malloc(s->data_sz);
         if (copy) {
-            memcpy(copy, data, s->data_sz); s->data = copy;
+            memcpy(copy, data, s->data_sz);
+            // entries that are not written yet are added to the RAM tier once they are
+            if (s->written_to_disk) keep_in_ram(self, s, copy);
+            else s->data = copy;
         }
     }
 end:
@@ -710,6 +964,42 @@ end:
     return data;
 }
 
+bool
+read_from_disk_cache_into(PyObject *self_, const void *key, size_t key_sz, void *dest, size_t dest_sz) {
+    DiskCache *self = (DiskCache*)self_;
+    if (!self->fully_initialized || key_sz > MAX_KEY_SIZE) return false;
+    CacheKey k = {.hash_key=(void*)key, .hash_keylen=key_sz};
+    bool ok = false;
+    mutex(lock);
+    cache_map_itr i = vt_get(&self->map, k);
+    if (!vt_is_end(i) && i.data->val->data_sz == dest_sz) ok = read_entry_data(self, i.data->val, k, dest) == 0;
+    mutex(unlock);
+    return ok;
+}
+
+void
+disk_cache_prefetch(PyObject *self_, const void *key, size_t key_sz) {
+    DiskCache *self = (DiskCache*)self_;
+    if (!self->fully_initialized || key_sz > MAX_KEY_SIZE) return;
+    CacheKey k = {.hash_key=(void*)key, .hash_keylen=key_sz};
+    bool queued = false;
+    mutex(lock);
+    cache_map_itr i = vt_get(&self->map, k);
+    if (!vt_is_end(i) && i.data->val->written_to_disk && !i.data->val->data && self->prefetches.count < MAX_PENDING_PREFETCHES) {
+        queued = true;
+        for (unsigned n = 0; n < self->prefetches.count && queued; n++) {
+            CacheKey q = {.hash_key=self->prefetches.items[n].key, .hash_keylen=self->prefetches.items[n].keylen};
+            if (keys_are_equal(q, k)) queued = false;
+        }
+        if (queued) {
+            memcpy(self->prefetches.items[self->prefetches.count].key, key, key_sz);
+            self->prefetches.items[self->prefetches.count++].keylen = key_sz;
+        }
+    }
+    mutex(unlock);
+    if (queued) wakeup_write_loop(self);
+}
+
 size_t
 disk_cache_clear_from_ram(PyObject *self_, bool(matches)(void*, void *key, unsigned keysz), void *data) {
     DiskCache *self = (DiskCache*)self_;
@@ -720,6 +1010,7 @@ disk_cache_clear_from_ram(PyObject *self_, bool(matches)(void*, void *key, unsig
         CacheValue *s = i.data->val;
         if (s->written_to_disk && s->data && matches(data, i.data->key.hash_key, i.data->key.hash_keylen)) {
             free(s->data); s->data = NULL;
+            self->ram_size -= MIN(self->ram_size, s->data_sz);
             ans++;
         }
     }
@@ -767,6 +1058,20 @@ disk_cache_num_cached_in_ram(PyObject *self_) {
     return ans;
 }
 
+size_t
+disk_cache_size_in_ram(PyObject *self_) {
+    // Both entries waiting to be written and copies of written entries
+    DiskCache *self = (DiskCache*)self_;
+    size_t ans = 0;
+    // nothing can have been added before the state is initialized
+    if (!self->fully_initialized) return 0;
+    mutex(lock);
+    cache_map_for_loop(i) {
+        if (i.data->val->data) ans += i.data->val->data_sz;
+    }
+    mutex(unlock);
+    return ans;
+}
 
 #define PYWRAP(name) static PyObject* py##name(DiskCache *self, PyObject *args)
 #define PA(fmt, ...) if (!PyArg_ParseTuple(args, fmt, __VA_ARGS__)) return NULL;
@@ -784,7 +1089,8 @@ PYWRAP(read_from_cache_file) {
     mutex(unlock);
     PyObject *ans = PyBytes_FromStringAndSize(NULL, sz);
     if (ans) {
-        read_from_cache_file(self, pos, sz, PyBytes_AS_STRING(ans));
+        int ret = read_from_cache_file(self, pos, sz, PyBytes_AS_STRING(ans));
+        if (ret) { set_read_error(self, ret); Py_CLEAR(ans); }
     }
     return ans;
 }
@@ -894,6 +1200,15 @@ remove_from_ram(PyObject *self, PyObject *callable) {
     return PyLong_FromUnsignedLong(disk_cache_clear_from_ram(self, python_clear_predicate, callable));
 }
 
+static PyObject*
+prefetch(PyObject *self, PyObject *args) {
+    const char *key;
+    Py_ssize_t keylen;
+    PA("y#", &key, &keylen);
+    disk_cache_prefetch(self, key, keylen);
+    Py_RETURN_NONE;
+}
+
 static PyObject*
 num_cached_in_ram(PyObject *self, PyObject *args UNUSED) {
     return PyLong_FromUnsignedLong(disk_cache_num_cached_in_ram(self));
@@ -909,6 +1224,7 @@ static PyMethodDef methods[] = {
     {"remove_from_ram", remove_from_ram, METH_O, NULL},
     {"num_cached_in_ram", num_cached_in_ram, METH_NOARGS, NULL},
     {"get", get, METH_VARARGS, NULL},
+    {"prefetch", prefetch, METH_VARARGS, NULL},
     {"wait_for_write", wait_for_write, METH_VARARGS, NULL},
     {"size_on_disk", size_on_disk, METH_NOARGS, NULL},
     {"clear", clear, METH_NOARGS, NULL},
@@ -921,6 +1237,9 @@ static PyMemberDef members[] = {
     {"total_size", T_ULONGLONG, offsetof(DiskCache, total_size), READONLY, "total_size"},
     {"small_hole_threshold", T_PYSSIZET, offsetof(DiskCache, small_hole_threshold), 0, "small_hole_threshold"},
     {"defrag_factor", T_UINT, offsetof(DiskCache, defrag_factor), 0, "defrag_factor"},
+    {"ram_size", T_ULONGLONG, offsetof(DiskCache, ram_size), READONLY, "ram_size"},
+    {"ram_limit", T_ULONGLONG, offsetof(DiskCache, ram_limit), 0, "ram_limit"},
+    {"compress", T_BOOL, offsetof(DiskCache, compress), 0, "compress"},
     {NULL},
 };
 
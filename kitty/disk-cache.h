@@ -13,12 +13,20 @@ bool add_to_disk_cache(PyObject *self, const void *key, size_t key_sz, const voi
 bool remove_from_disk_cache(PyObject *self_, const void *key, size_t key_sz);
 void* read_from_disk_cache(PyObject *self_, const void *key, size_t key_sz, void*(allocator)(void*, size_t), void*, bool);
 PyObject* read_from_disk_cache_python(PyObject *self_, const void *key, size_t key_sz, bool);
+// Does not use the Python API so can be called without holding the GIL. Returns false if
+// there is no entry with the specified key and size dest_sz or if reading it fails.
+bool read_from_disk_cache_into(PyObject *self_, const void *key, size_t key_sz, void *dest, size_t dest_sz);
 bool disk_cache_wait_for_write(PyObject *self, monotonic_t timeout);
 size_t disk_cache_total_size(PyObject *self);
 size_t disk_cache_size_on_disk(PyObject *self);
 void clear_disk_cache(PyObject *self);
 size_t disk_cache_clear_from_ram(PyObject *self_, bool(matches)(void* data, void *key, unsigned keysz), void*);
 size_t disk_cache_num_cached_in_ram(PyObject *self_);
+size_t disk_cache_size_in_ram(PyObject *self_);
+// Read the entry into RAM on the write thread so that a later read does not
+// have to wait for the disk. Does not use the Python API and does nothing if
+// the entry is not on disk or too many prefetches are pending.
+void disk_cache_prefetch(PyObject *self_, const void *key, size_t key_sz);
 
 static inline void* disk_cache_malloc_allocator(void *x, size_t sz) {
     *((size_t*)x) = sz;
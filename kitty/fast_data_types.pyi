@@ -447,6 +447,9 @@ def fc_match_postscript_name(
 
 def add_font_file(path: str) -> bool: ...
 def set_builtin_nerd_font(path: str) -> Union[CoreTextFont, FontConfigPattern]: ...
+def get_fallback_descriptor_cache() -> dict[str, FontConfigPattern]: ...
+def set_fallback_descriptor_cache(cache: dict[str, FontConfigPattern]) -> None: ...
+def fontconfig_fingerprint() -> str: ...
 
 
 class FeatureData(TypedDict):
@@ -541,8 +544,9 @@ def add_window(os_window_id: int, tab_id: int, title: str) -> int:
 
 
 def compile_program(
-    which: int, vertex_shaders: Tuple[str, ...], fragment_shaders: Tuple[str, ...], allow_recompile: bool = False
-) -> int:
+    which: int, vertex_shaders: Tuple[str, ...], fragment_shaders: Tuple[str, ...], allow_recompile: bool = False,
+    cached_binary: bytes | None = None
+) -> tuple[int, bytes | None]:
     pass
 
 
@@ -560,6 +564,8 @@ def set_borders_rects(os_window_id: int, tab_id: int, rects: list[Border]) -> No
 def init_borders_program() -> None:
     pass
 
+def input_latency_samples(os_window_id: int) -> tuple[tuple[float, float, float, float], ...]: ...
+def os_window_memory_usage(os_window_id: int) -> dict[str, int]: ...
 def os_window_has_background_image(os_window_id: int) -> bool:
     pass
 
@@ -1136,6 +1142,11 @@ class Line:
     def sprite_at(self, cell: int) -> int: ...
 
 
+class TextMarker:
+
+    def __init__(self, patterns: Tuple[Tuple[int, str], ...], ignore_case: bool = False): ...
+
+
 def test_shape(line: Line,
                path: Optional[str] = None,
                index: int = 0) -> List[Tuple[int, int, int, Tuple[int, ...]]]:
@@ -1150,6 +1161,10 @@ def sprite_map_set_limits(w: int, h: int) -> None:
     pass
 
 
+def set_box_drawing_cache(path: str | None, prerender: bool) -> None:
+    pass
+
+
 def set_send_sprite_to_gpu(
     func: Optional[Callable[[int, int, int, bytes], None]]
 ) -> None:
@@ -1204,6 +1219,15 @@ class Cursor:
     shape: int
 
 
+class Parser:
+
+    vte_state: str
+    buffer_size: int
+    buffer_high_water_mark: int
+    ring_size: int
+    input_regime: str
+
+
 class Screen:
 
     color_profile: ColorProfile
@@ -1223,6 +1247,9 @@ class Screen:
     auto_repeat_enabled: bool
     render_unfocused_cursor: bool
     last_reported_cwd: Optional[bytes]
+    vt_parser: Parser
+    idle_memory_released: int
+    predictive_echo: bool
 
     def __init__(
             self,
@@ -1237,6 +1264,7 @@ class Screen:
     def test_create_write_buffer(self) -> memoryview: ...
     def test_commit_write_buffer(self, inp: memoryview, output: memoryview) -> int: ...
     def test_parse_written_data(self, dump_callback: None = None) -> None: ...
+    def test_finish_background_image_decodes(self) -> bool: ...
     def hyperlink_for_id(self, hyperlink_id: int) -> str: ...
     def erase_last_command(self, include_prompt: bool = True) -> bool: ...
 
@@ -1291,6 +1319,18 @@ class Screen:
     def text_for_selection(self, ansi: bool, strip_trailing_spaces: bool) -> Tuple[str, ...]:
         pass
 
+    def utf8_for_selection(self, strip_trailing_spaces: bool = False) -> bytes:
+        pass
+
+    def chars_in_range(self, start_y: int, end_y: int) -> memoryview:
+        pass
+
+    def predict_echo(self, text: str) -> None:
+        pass
+
+    def predicted_echo(self) -> str:
+        pass
+
     def is_rectangle_select(self) -> bool:
         pass
 
@@ -1330,7 +1370,7 @@ class Screen:
     def refresh_sprite_positions(self) -> None:
         pass
 
-    def set_marker(self, marker: Optional[MarkerFunc] = None) -> None:
+    def set_marker(self, marker: Union[MarkerFunc, 'TextMarker', None] = None) -> None:
         pass
 
     def paste_bytes(self, data: bytes) -> None:
@@ -1343,9 +1383,21 @@ class Screen:
     as_text_alternate = as_text
     as_text_for_history_buf = as_text
 
+    def search(self, pattern: str, regex: bool = False) -> list[tuple[int, int, int, int]]:
+        pass
+
+    def export_scrollback(self, fd: int) -> int:
+        pass
+
+    def import_scrollback(self, fd: int) -> int:
+        pass
+
     def cmd_output(self, which: int, callback: Callable[[str], None], as_ansi: bool, insert_wrap_markers: bool) -> bool:
         pass
 
+    def take_captured_command_output(self) -> tuple[bytes, int, bool] | None:
+        pass
+
     def scroll_until_cursor_prompt(self, add_to_scrollback: bool = True) -> None:
         pass
 
@@ -1358,6 +1410,15 @@ class Screen:
     def clear_scrollback(self) -> None:
         pass
 
+    def compact_text_cache(self) -> int:
+        pass
+
+    def release_idle_memory(self) -> int:
+        pass
+
+    def memory_usage(self) -> dict[str, int]:
+        pass
+
     def focus_changed(self, focused: bool) -> bool:
         pass
 
@@ -1392,6 +1453,13 @@ def set_window_render_data(
     pass
 
 
+def set_windows_render_data(
+    os_window_id: int, tab_id: int,
+    entries: list[tuple[int, Screen, int, int, int, int, int, int, int, int]]
+) -> None:
+    pass
+
+
 def truncate_point_for_length(
     text: str, num_cells: int, start_pos: int = 0
 ) -> int:
@@ -1726,7 +1794,10 @@ def wrapped_kitten_names() -> List[str]: ...
 def expand_ansi_c_escapes(test: str) -> str: ...
 def update_tab_bar_edge_colors(os_window_id: int) -> bool: ...
 def mask_kitty_signals_process_wide() -> None: ...
+def get_frame_timings() -> tuple[tuple[str, int, int, int], ...]: ...
 def is_modifier_key(key: int) -> bool: ...
+def set_shortcut_filter(keys: Optional[Tuple[SingleKey, ...]]) -> None: ...
+def set_broadcast_targets(window_id: int, targets: Tuple[int, ...], excluded_keys: Tuple[SingleKey, ...]) -> bool: ...
 def base64_encode(src: Union[str, ReadableBuffer], add_padding: bool = False) -> bytes: ...
 def base64_encode_into(src: Union[str, ReadableBuffer], output: WriteableBuffer, add_padding: bool = False) -> int: ...
 def base64_decode(src: Union[str, ReadableBuffer]) -> bytes: ...
@@ -8,6 +8,7 @@
 import os
 import re
 import stat
+import sys
 import tempfile
 from base64 import b85decode
 from collections import defaultdict, deque
@@ -16,6 +17,7 @@
 from dataclasses import Field, dataclass, field, fields
 from enum import Enum, auto
 from functools import partial
+from hmac import compare_digest
 from gettext import gettext as _
 from itertools import count
 from time import time_ns
@@ -26,6 +28,7 @@
 from kitty.types import run_once
 from kitty.typing_compat import ReadableBuffer, WriteableBuffer
 
+from .constants import runtime_dir
 from .utils import log_error
 
 EXPIRE_TIME = 10  # minutes
@@ -201,6 +204,7 @@ def color(self) -> str:
 class TransmissionType(NameReprEnum):
     simple = auto()
     rsync = auto()
+    local = auto()
 
 
 ErrorCode = Enum('ErrorCode', 'OK STARTED CANCELED PROGRESS EINVAL EPERM EISDIR ENOENT')
@@ -360,8 +364,9 @@ def handle_item(key: memoryview, val: memoryview) -> None:
 
 class IdentityDecompressor:
 
-    def __call__(self, data: bytes | memoryview, is_last: bool = False) -> bytes:
-        return bytes(data)
+    def __call__(self, data: bytes | memoryview, is_last: bool = False) -> bytes | memoryview:
+        # the data is written out before the next command is parsed, so there is no need to copy it
+        return data
 
 
 class ZlibDecompressor:
@@ -441,6 +446,70 @@ def next_signature_block(self, buf: memoryview) -> int:
         return n
 
 
+class LocalCopy:
+    '''
+    Copies a file that a client on the same machine asked us to read directly
+    from its path, instead of transmitting its data. The copy is done with a
+    reflink if the filesystem supports it, otherwise in chunks with
+    copy_file_range() so that the kernel does the copy without the data ever
+    entering userspace.
+    '''
+
+    chunk_size = 64 * 1024 * 1024
+
+    def __init__(self, path: str) -> None:
+        if not os.path.isabs(path):
+            raise OSError(errno.EINVAL, 'Not an absolute path', path)
+        self.src = open(path, 'rb')
+        self.stat = os.fstat(self.src.fileno())
+        if not stat.S_ISREG(self.stat.st_mode):
+            self.src.close()
+            raise OSError(errno.EINVAL, 'Not a regular file', path)
+        self.pos = 0
+        self.done = False
+        self.use_copy_file_range = hasattr(os, 'copy_file_range')
+
+    def close(self) -> None:
+        self.src.close()
+
+    def is_same_file(self, st: os.stat_result | None) -> bool:
+        return st is not None and st.st_dev == self.stat.st_dev and st.st_ino == self.stat.st_ino
+
+    def clone_into(self, dest_fd: int) -> bool:
+        if not sys.platform.startswith('linux'):
+            return False
+        import fcntl
+        try:
+            fcntl.ioctl(dest_fd, getattr(fcntl, 'FICLONE', 0x40049409), self.src.fileno())
+        except OSError:
+            return False
+        self.pos = self.stat.st_size
+        self.done = True
+        return True
+
+    def copy_chunk(self, dest_fd: int) -> int:
+        src_fd = self.src.fileno()
+        n = 0
+        if self.use_copy_file_range:
+            try:
+                n = os.copy_file_range(src_fd, dest_fd, self.chunk_size, self.pos, self.pos)
+            except OSError as err:
+                if err.errno not in (errno.EXDEV, errno.ENOSYS, errno.EINVAL, errno.EOPNOTSUPP):
+                    raise
+                self.use_copy_file_range = False
+        if not self.use_copy_file_range:
+            while n < self.chunk_size:
+                data = os.pread(src_fd, 1024 * 1024, self.pos + n)
+                if not data:
+                    break
+                os.pwrite(dest_fd, data, self.pos + n)
+                n += len(data)
+        if n == 0:
+            self.done = True
+        self.pos += n
+        return n
+
+
 class DestFile:
 
     def __init__(self, ftc: FileTransmissionCommand) -> None:
@@ -466,6 +535,7 @@ def __init__(self, ftc: FileTransmissionCommand) -> None:
         self.decompressor: ZlibDecompressor | IdentityDecompressor = ZlibDecompressor() if ftc.compression is Compression.zlib else IdentityDecompressor()
         self.closed = self.ftype is FileType.directory
         self.actual_file: PatchFile | IO[bytes] | None = None
+        self.local_copy: LocalCopy | None = None
         self.failed = False
         self.bytes_written = 0
 
@@ -482,6 +552,9 @@ def close(self) -> None:
             if self.actual_file is not None:
                 self.actual_file.close()
                 self.actual_file = None
+            if self.local_copy is not None:
+                self.local_copy.close()
+                self.local_copy = None
 
     def make_parent_dirs(self) -> str:
         d = os.path.dirname(self.name)
@@ -510,11 +583,45 @@ def unlink_existing_if_needed(self, force: bool = False) -> None:
             self.existing_stat = None
             self.needs_unlink = False
 
+    def open_for_write(self) -> IO[bytes]:
+        self.make_parent_dirs()
+        self.unlink_existing_if_needed()
+        flags = os.O_RDWR | os.O_CREAT | os.O_TRUNC | getattr(os, 'O_CLOEXEC', 0) | getattr(os, 'O_BINARY', 0)
+        return open(os.open(self.name, flags, self.permissions), mode='r+b', closefd=True)
+
+    def start_local_copy(self, src: LocalCopy) -> None:
+        self.local_copy = src
+        if src.is_same_file(self.existing_stat):
+            # copying a file onto itself, nothing to do
+            self.bytes_written = src.stat.st_size
+            self.close()
+            self.apply_metadata()
+            return
+        self.actual_file = self.open_for_write()
+        if src.clone_into(self.actual_file.fileno()):
+            self.finish_local_copy()
+
+    def copy_local_chunk(self) -> None:
+        assert self.local_copy is not None and self.actual_file is not None
+        self.local_copy.copy_chunk(self.actual_file.fileno())
+        if self.local_copy.done:
+            self.finish_local_copy()
+        else:
+            self.bytes_written = self.local_copy.pos
+
+    def finish_local_copy(self) -> None:
+        assert self.local_copy is not None
+        self.bytes_written = self.local_copy.pos
+        self.close()
+        self.apply_metadata()
+
     def write_data(self, all_files: dict[str, 'DestFile'], data: bytes | memoryview, is_last: bool) -> None:
         if self.ftype is FileType.directory:
             raise TransmissionError(code=ErrorCode.EISDIR, file_id=self.file_id, msg='Cannot write data to a directory entry')
         if self.closed:
             raise TransmissionError(file_id=self.file_id, msg='Cannot write to a closed file')
+        if self.local_copy is not None:
+            raise TransmissionError(file_id=self.file_id, msg='Cannot write data to a file that is being copied locally')
         if self.ftype in (FileType.symlink, FileType.link):
             self.link_target += data
             self.bytes_written += len(data)
@@ -544,10 +651,7 @@ def write_data(self, all_files: dict[str, 'DestFile'], data: bytes | memoryview,
         elif self.ftype is FileType.regular:
             decompressed = self.decompressor(data, is_last=is_last)
             if self.actual_file is None:
-                self.make_parent_dirs()
-                self.unlink_existing_if_needed()
-                flags = os.O_RDWR | os.O_CREAT | os.O_TRUNC | getattr(os, 'O_CLOEXEC', 0) | getattr(os, 'O_BINARY', 0)
-                self.actual_file = open(os.open(self.name, flags, self.permissions), mode='r+b', closefd=True)
+                self.actual_file = self.open_for_write()
             af = self.actual_file
             if decompressed or is_last:
                 af.write(decompressed)
@@ -588,8 +692,10 @@ class ActiveReceive:
     files: dict[str, DestFile]
     accepted: bool = False
 
-    def __init__(self, request_id: str, quiet: int, bypass: str) -> None:
+    def __init__(self, request_id: str, quiet: int, bypass: str, wants_local_copies: bool = False) -> None:
         self.id = request_id
+        self.wants_local_copies = wants_local_copies
+        self.local_token = self.local_token_path = ''
         self.bypass_ok: bool | None = None
         if bypass:
             byp = get_options().file_transfer_confirmation_bypass
@@ -609,10 +715,29 @@ def close(self) -> None:
         for x in self.files.values():
             x.close()
         self.files = {}
+        if self.local_token_path:
+            with suppress(OSError):
+                os.unlink(self.local_token_path)
+            self.local_token_path = ''
 
     def cancel(self) -> None:
         self.close()
 
+    def create_local_token(self) -> str:
+        # The token is written to a file readable only by us in a directory
+        # local to this machine. A client that can read it back is running as
+        # our user on this machine, so it is allowed to have us copy files
+        # directly from paths it names, since it could read them anyway.
+        token = os.urandom(16).hex()
+        fd, path = tempfile.mkstemp(prefix='ftc-local-', dir=runtime_dir())
+        with open(fd, 'w') as f:
+            f.write(token)
+        self.local_token, self.local_token_path = token, path
+        return path
+
+    def is_local_copy_allowed(self, token: str) -> bool:
+        return bool(self.local_token) and compare_digest(token.encode('utf-8'), self.local_token.encode('utf-8'))
+
     def start_file(self, ftc: FileTransmissionCommand) -> DestFile:
         self.last_activity_at = monotonic()
         if ftc.file_id in self.files:
@@ -998,7 +1123,7 @@ def handle_receive_cmd(self, cmd: FileTransmissionCommand) -> None:
             if len(self.active_receives) >= MAX_ACTIVE_RECEIVES:
                 log_error('New File transmission send with too many active receives, ignoring')
                 return
-            ar = self.active_receives[cmd.id] = ActiveReceive(cmd.id, cmd.quiet, cmd.bypass)
+            ar = self.active_receives[cmd.id] = ActiveReceive(cmd.id, cmd.quiet, cmd.bypass, cmd.ttype is TransmissionType.local)
             self.start_receive(ar.id)
             return
 
@@ -1028,11 +1153,30 @@ def handle_receive_cmd(self, cmd: FileTransmissionCommand) -> None:
                 else:
                     if ar.send_acknowledgements:
                         sz = df.existing_stat.st_size if df.existing_stat is not None else -1
-                        ttype = TransmissionType.rsync \
-                            if sz > -1 and df.ttype is TransmissionType.rsync and df.ftype is FileType.regular else TransmissionType.simple
+                        local_copy = None
+                        if df.ttype is TransmissionType.local and df.ftype is FileType.regular and ar.is_local_copy_allowed(cmd.bypass):
+                            try:
+                                local_copy = LocalCopy(bytes(cmd.data).decode('utf-8', 'replace'))
+                            except OSError as err:
+                                # the client will fall back to sending the file data
+                                log_error(f'Failed to open file for local copy with error: {err}')
+                        if local_copy is not None:
+                            ttype = TransmissionType.local
+                        else:
+                            ttype = TransmissionType.rsync \
+                                if sz > -1 and df.ttype is TransmissionType.rsync and df.ftype is FileType.regular else TransmissionType.simple
                         self.send_status_response(code=ErrorCode.STARTED, request_id=ar.id, file_id=df.file_id, name=df.name, size=sz, ttype=ttype)
                         df.ttype = ttype
-                        if ttype is TransmissionType.rsync:
+                        if local_copy is not None:
+                            try:
+                                df.start_local_copy(local_copy)
+                            except OSError as err:
+                                df.failed = True
+                                df.close()
+                                self.send_fail_on_os_error(err, 'Failed to open file for local copy', ar, df.file_id)
+                            else:
+                                self.copy_local_file(ar.id, df.file_id)
+                        elif ttype is TransmissionType.rsync:
                             try:
                                 fs = df.signature_iterator()
                             except OSError as err:
@@ -1082,6 +1226,29 @@ def handle_receive_cmd(self, cmd: FileTransmissionCommand) -> None:
         else:
             log_error(f'Transmission receive command with unknown action: {cmd.action}, ignoring')
 
+    def copy_local_file(self, receive_id: str, file_id: str, timer_id: int | None = None) -> None:
+        ar = self.active_receives.get(receive_id)
+        if ar is None:
+            return
+        df = ar.files.get(file_id)
+        if df is None or df.failed:
+            return
+        ar.last_activity_at = monotonic()
+        if not df.closed:
+            try:
+                df.copy_local_chunk()
+            except OSError as err:
+                df.failed = True
+                df.close()
+                self.send_fail_on_os_error(err, 'Failed to copy file', ar, df.file_id)
+                return
+        if df.closed:
+            self.send_status_response(code=ErrorCode.OK, request_id=ar.id, file_id=df.file_id, name=df.name, size=df.bytes_written)
+        else:
+            # copy in chunks so as not to block the UI for very large files
+            self.send_status_response(code=ErrorCode.PROGRESS, request_id=ar.id, file_id=df.file_id, size=df.bytes_written)
+            self.callback_after(partial(self.copy_local_file, ar.id, df.file_id))
+
     def transmit_rsync_signature(self, receive_id: str, timer_id: int | None = None) -> None:
         q = self.active_receives.get(receive_id)
         if q is None:
@@ -1215,7 +1382,16 @@ def handle_send_confirmation(self, confirmed: bool, cmd_id: str) -> None:
             self.drop_receive(ar.id)
         if ar.accepted:
             if ar.send_acknowledgements:
-                self.send_status_response(code=ErrorCode.OK, request_id=ar.id)
+                token_path = ''
+                if ar.wants_local_copies:
+                    try:
+                        token_path = ar.create_local_token()
+                    except OSError as err:
+                        log_error(f'Failed to create token for local file copies with error: {err}')
+                if token_path:
+                    self.send_status_response(code=ErrorCode.OK, request_id=ar.id, name=token_path, ttype=TransmissionType.local)
+                else:
+                    self.send_status_response(code=ErrorCode.OK, request_id=ar.id)
         else:
             if ar.send_errors:
                 self.send_status_response(code=ErrorCode.EPERM, request_id=ar.id, msg='User refused the transfer')
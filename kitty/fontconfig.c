@@ -10,6 +10,7 @@
 #include "fonts.h"
 #include <fontconfig/fontconfig.h>
 #include <dlfcn.h>
+#include <sys/stat.h>
 #include "freetype_render_ui_text.h"
 #ifndef FC_COLOR
 #define FC_COLOR "color"
@@ -19,6 +20,10 @@
 static bool initialized = false;
 static void* libfontconfig_handle = NULL;
 static struct {PyObject *face, *descriptor;} builtin_nerd_font = {0};
+// Maps the text and style of cells to the descriptor fontconfig matched for
+// them, shared by all font groups and persisted across launches, see
+// kitty/fonts/fontconfig.py
+static PyObject *fallback_descriptor_cache = NULL;
 
 #define FcInit dynamically_loaded_fc_symbol.Init
 #define FcFini dynamically_loaded_fc_symbol.Fini
@@ -43,6 +48,12 @@ static struct {PyObject *face, *descriptor;} builtin_nerd_font = {0};
 #define FcPatternGetBool dynamically_loaded_fc_symbol.PatternGetBool
 #define FcPatternAddCharSet dynamically_loaded_fc_symbol.PatternAddCharSet
 #define FcConfigAppFontAddFile dynamically_loaded_fc_symbol.ConfigAppFontAddFile
+#define FcConfigGetConfigFiles dynamically_loaded_fc_symbol.ConfigGetConfigFiles
+#define FcConfigGetFontDirs dynamically_loaded_fc_symbol.ConfigGetFontDirs
+#define FcConfigGetCacheDirs dynamically_loaded_fc_symbol.ConfigGetCacheDirs
+#define FcStrListNext dynamically_loaded_fc_symbol.StrListNext
+#define FcStrListDone dynamically_loaded_fc_symbol.StrListDone
+#define FcGetVersion dynamically_loaded_fc_symbol.GetVersion
 
 static struct {
     FcBool(*Init)(void);
@@ -68,6 +79,12 @@ static struct {
     FcResult (*PatternGetBool) (const FcPattern *p, const char *object, int n, FcBool *b);
     FcBool (*PatternAddCharSet) (FcPattern *p, const char *object, const FcCharSet *c);
     FcBool (*ConfigAppFontAddFile) (FcConfig *config, const FcChar8 *file);
+    FcStrList* (*ConfigGetConfigFiles) (FcConfig *config);
+    FcStrList* (*ConfigGetFontDirs) (FcConfig *config);
+    FcStrList* (*ConfigGetCacheDirs) (const FcConfig *config);
+    FcChar8* (*StrListNext) (FcStrList *list);
+    void (*StrListDone) (FcStrList *list);
+    int (*GetVersion) (void);
 } dynamically_loaded_fc_symbol = {0};
 #define LOAD_FUNC(name) {\
     *(void **) (&dynamically_loaded_fc_symbol.name) = dlsym(libfontconfig_handle, "Fc" #name); \
@@ -119,6 +136,12 @@ load_fontconfig_lib(void) {
         LOAD_FUNC(PatternGetBool);
         LOAD_FUNC(PatternAddCharSet);
         LOAD_FUNC(ConfigAppFontAddFile);
+        LOAD_FUNC(ConfigGetConfigFiles);
+        LOAD_FUNC(ConfigGetFontDirs);
+        LOAD_FUNC(ConfigGetCacheDirs);
+        LOAD_FUNC(StrListNext);
+        LOAD_FUNC(StrListDone);
+        LOAD_FUNC(GetVersion);
 }
 #undef LOAD_FUNC
 
@@ -136,6 +159,7 @@ finalize(void) {
     if (initialized) {
         Py_CLEAR(builtin_nerd_font.face);
         Py_CLEAR(builtin_nerd_font.descriptor);
+        Py_CLEAR(fallback_descriptor_cache);
         FcFini();
         dlclose(libfontconfig_handle);
         libfontconfig_handle = NULL;
@@ -497,7 +521,7 @@ PyObject*
 create_fallback_face(PyObject UNUSED *base_face, const ListOfChars *lc, bool bold, bool italic, bool emoji_presentation, FONTS_DATA_HANDLE fg) {
     ensure_initialized();
     PyObject *ans = NULL;
-    RAII_PyObject(d, NULL);
+    RAII_PyObject(d, NULL); RAII_PyObject(text, NULL); RAII_PyObject(key, NULL);
     FcPattern *pat = FcPatternCreate();
     if (pat == NULL) return PyErr_NoMemory();
     bool glyph_found = false;
@@ -506,8 +530,14 @@ create_fallback_face(PyObject UNUSED *base_face, const ListOfChars *lc, bool bol
     if (!emoji_presentation && italic) { AP(FcPatternAddInteger, FC_SLANT, FC_SLANT_ITALIC, "slant"); }
     if (emoji_presentation) { AP(FcPatternAddBool, FC_COLOR, true, "color"); }
     size_t num = cell_as_unicode_for_fallback(lc, char_buf, arraysz(char_buf));
-    add_charset(pat, num);
-    d = _fc_match(pat);
+    if (!(text = PyUnicode_FromKindAndData(PyUnicode_4BYTE_KIND, char_buf, num))) goto end;
+    if (!(key = PyUnicode_FromFormat("%c%U", emoji_presentation ? 'e' : (bold ? (italic ? 'I' : 'B') : (italic ? 'i' : 'r')), text))) goto end;
+    if (!fallback_descriptor_cache && !(fallback_descriptor_cache = PyDict_New())) goto end;
+    if ((d = PyDict_GetItemWithError(fallback_descriptor_cache, key))) Py_INCREF(d);
+    else if (!PyErr_Occurred()) {
+        add_charset(pat, num);
+        if ((d = _fc_match(pat)) && PyDict_SetItem(fallback_descriptor_cache, key, d) != 0) Py_CLEAR(d);
+    }
 face_from_descriptor:
     if (d) {
         ssize_t idx = -1;
@@ -586,12 +616,63 @@ add_font_file(PyObject UNUSED *self, PyObject *args) {
 
 #undef AP
 
+static PyObject*
+get_fallback_descriptor_cache(PyObject UNUSED *self, PyObject *args UNUSED) {
+    if (!fallback_descriptor_cache && !(fallback_descriptor_cache = PyDict_New())) return NULL;
+    return PyDict_Copy(fallback_descriptor_cache);
+}
+
+static PyObject*
+set_fallback_descriptor_cache(PyObject UNUSED *self, PyObject *cache) {
+    if (!PyDict_Check(cache)) { PyErr_SetString(PyExc_TypeError, "cache must be a dict"); return NULL; }
+    Py_CLEAR(fallback_descriptor_cache);
+    if (!(fallback_descriptor_cache = PyDict_Copy(cache))) return NULL;
+    Py_RETURN_NONE;
+}
+
+static void
+fnv_hash(uint64_t *h, const void *data, size_t sz) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < sz; i++) *h = (*h ^ p[i]) * 1099511628211ull;
+}
+
+static bool
+add_to_fingerprint(FcStrList *list, uint64_t *h) {
+    // Changes to the fontconfig configuration, installed fonts or the
+    // fontconfig caches change the modification times of these
+    if (!list) return false;
+    FcChar8 *path;
+    struct stat st;
+    while ((path = FcStrListNext(list))) {
+        fnv_hash(h, path, strlen((const char*)path));
+        if (stat((const char*)path, &st) == 0) {
+            const int64_t vals[3] = {st.st_mtim.tv_sec, st.st_mtim.tv_nsec, st.st_size};
+            fnv_hash(h, vals, sizeof(vals));
+        }
+    }
+    FcStrListDone(list);
+    return true;
+}
+
+static PyObject*
+fontconfig_fingerprint(PyObject UNUSED *self, PyObject *args UNUSED) {
+    ensure_initialized();
+    uint64_t h = 14695981039346656037ull;
+    const int version = FcGetVersion();
+    fnv_hash(&h, &version, sizeof(version));
+    if (!add_to_fingerprint(FcConfigGetConfigFiles(NULL), &h) || !add_to_fingerprint(FcConfigGetFontDirs(NULL), &h) || !add_to_fingerprint(FcConfigGetCacheDirs(NULL), &h)) return PyErr_NoMemory();
+    return PyUnicode_FromFormat("%016llx", (unsigned long long)h);
+}
+
 static PyMethodDef module_methods[] = {
     {"fc_list", (PyCFunction)(void (*) (void))(fc_list), METH_VARARGS | METH_KEYWORDS, NULL},
     METHODB(fc_match, METH_VARARGS),
     METHODB(fc_match_postscript_name, METH_VARARGS),
     METHODB(add_font_file, METH_VARARGS),
     METHODB(set_builtin_nerd_font, METH_O),
+    METHODB(get_fallback_descriptor_cache, METH_NOARGS),
+    METHODB(set_fallback_descriptor_cache, METH_O),
+    METHODB(fontconfig_fingerprint, METH_NOARGS),
     {NULL, NULL, 0, NULL}        /* Sentinel */
 };
 
@@ -13,6 +13,9 @@
 #include "char-props.h"
 #include "decorations.h"
 #include "glyph-cache.h"
+#include "safe-wrappers.h"
+#include "threading.h"
+#include <fcntl.h>
 
 #define MISSING_GLYPH 1
 #define MAX_NUM_EXTRA_GLYPHS_PUA 4u
@@ -54,6 +57,7 @@ typedef struct {
 
 static SymbolMap *symbol_maps = NULL, *narrow_symbols = NULL;
 static size_t num_symbol_maps = 0, num_narrow_symbols = 0;
+static PyObject *descriptor_for_idx = NULL;
 
 typedef enum { SPACER_STRATEGY_UNKNOWN, SPACERS_BEFORE, SPACERS_AFTER, SPACERS_IOSEVKA } SpacerStrategy;
 
@@ -66,6 +70,9 @@ typedef struct {
     GLYPH_PROPERTIES_MAP_HANDLE glyph_properties_hash_table;
     bool bold, italic, emoji_presentation;
     SpacerStrategy spacer_strategy;
+    // fonts other than the medium font are loaded on first use, see ensure_font_loaded()
+    bool is_pending, is_symbol_font;
+    unsigned desc_idx;
 } Font;
 
 typedef struct Canvas {
@@ -115,6 +122,331 @@ static bool cmpr_decorations_key(DecorationsKey a, DecorationsKey b) { return a.
 #include "kitty-verstable.h"
 
 
+// Shaping cache {{{
+// Lines are rendered again whenever they change, which very often means
+// shaping runs of text that were shaped before, for prompts, status lines,
+// full screen redraws and so on. The result of render_run() for a shaped
+// run, the sprite of every cell, is cached keyed by everything it depends
+// on. So is the result of render_line() for a whole line, which also avoids
+// finding the font for every cell of the line. The caches are set
+// associative, with two ways per set, and the least recently used way of a
+// set is replaced on a miss.
+
+#define SHAPING_CACHE_SETS 1024u
+#define SHAPING_CACHE_MAX_RUN_CELLS 512u
+
+typedef struct ShapingCacheEntry {
+    uint64_t hash;
+    uint32_t *key;
+    size_t key_len;
+    sprite_index *sprites;
+    index_type num_cells;
+} ShapingCacheEntry;
+
+typedef struct ShapingCacheSet {
+    ShapingCacheEntry ways[2];
+    unsigned least_recently_used;
+} ShapingCacheSet;
+
+typedef struct ShapingCache {
+    ShapingCacheSet *sets;
+    // the key of the current run
+    struct { uint32_t *items; size_t count, capacity; } key;
+    uint64_t hash;
+} ShapingCache;
+
+static void
+clear_shaping_cache(ShapingCache *c) {
+    if (c->sets) {
+        for (size_t i = 0; i < SHAPING_CACHE_SETS; i++) {
+            for (unsigned w = 0; w < arraysz(c->sets[i].ways); w++) {
+                free(c->sets[i].ways[w].key); free(c->sets[i].ways[w].sprites);
+            }
+        }
+        free(c->sets); c->sets = NULL;
+    }
+}
+
+static size_t
+shaping_cache_memory_usage(const ShapingCache *c) {
+    size_t ans = c->key.capacity * sizeof(c->key.items[0]);
+    if (c->sets) {
+        ans += SHAPING_CACHE_SETS * sizeof(c->sets[0]);
+        for (size_t i = 0; i < SHAPING_CACHE_SETS; i++) {
+            for (unsigned w = 0; w < arraysz(c->sets[i].ways); w++) {
+                const ShapingCacheEntry *e = c->sets[i].ways + w;
+                if (e->key) ans += e->key_len * sizeof(e->key[0]) + e->num_cells * sizeof(e->sprites[0]);
+            }
+        }
+    }
+    return ans;
+}
+
+static void
+free_shaping_cache(ShapingCache *c) {
+    clear_shaping_cache(c);
+    free(c->key.items); zero_at_ptr(&c->key);
+}
+
+// set when rendering a sprite fails, so that the result is not cached
+static bool rendering_failed = false;
+// }}}
+
+// Box drawing cache {{{
+// The box drawing characters are rendered by decorations.c, many of them
+// supersampled, which, at large font sizes on high DPI screens, is a
+// noticeable part of the first render after startup. When enabled with the
+// cache_box_drawing option, the rendered alpha masks are stored in a file
+// per cell size, DPI and box_drawing_scale, in a directory specific to the
+// kitty version, and re-used by later kitty instances. The files are append
+// only, every write() is of whole records so concurrent kitty instances can
+// share them, and a truncated last record is ignored.
+//
+// With the prerender_box_drawing option all box drawing characters are
+// rendered in worker threads as soon as a font group is created, decorations.c
+// uses no global state so this is safe. The results are merged into the cache
+// the first time a box drawing character is needed.
+
+#define BOX_CACHE_MAGIC "kittybox"
+#define MAX_BOX_PRERENDER_THREADS 4u
+
+typedef struct BoxCacheHeader {
+    char magic[8];
+    uint32_t width, height;
+    double dpi_x, dpi_y, box_drawing_scale[4];
+} BoxCacheHeader;
+
+#define NAME box_cache_map_t
+#define KEY_TY char_type
+#define VAL_TY uint32_t
+#include "kitty-verstable.h"
+
+// Records, as stored in the cache file, are a char_type followed by the alpha mask
+typedef struct BoxCacheRecords { uint8_t *items; size_t count, capacity; } BoxCacheRecords;
+
+typedef struct BoxPrerender {
+    BoxCacheHeader header;
+    bool *skip;  // candidates that are already cached
+    unsigned next_candidate, num_threads;
+    struct BoxPrerenderWorker {
+        struct BoxPrerender *prerender;
+        pthread_t thread;
+        BoxCacheRecords records;
+    } workers[MAX_BOX_PRERENDER_THREADS];
+} BoxPrerender;
+
+typedef struct BoxCache {
+    bool initialized;
+    int fd;
+    BoxCacheHeader header;
+    box_cache_map_t map;  // char -> index of its mask in masks
+    struct { uint8_t *items; size_t count, capacity; } masks;
+    BoxPrerender *prerender;  // heap allocated as FontGroups move in memory
+} BoxCache;
+
+static char *box_cache_dir = NULL;
+static bool box_cache_prerender = false;
+
+static const struct { char_type first, last; } box_char_ranges[] = {
+    // must match box_glyph_id()
+    {0x2500, 0x25ff}, {0xe0b0, 0xee0b}, {0x2800, 0x28ff}, {0x1fb00, 0x1fbae}, {0x1cd00, 0x1cde5}, {0x1fbe6, 0x1fbe7}, {0xf5d0, 0xf60d},
+};
+
+static unsigned
+num_box_char_candidates(void) {
+    unsigned ans = 0;
+    for (size_t i = 0; i < arraysz(box_char_ranges); i++) ans += box_char_ranges[i].last - box_char_ranges[i].first + 1;
+    return ans;
+}
+
+static char_type
+box_char_candidate(unsigned idx) {
+    for (size_t i = 0; i < arraysz(box_char_ranges); i++) {
+        const unsigned n = box_char_ranges[i].last - box_char_ranges[i].first + 1;
+        if (idx < n) return box_char_ranges[i].first + idx;
+        idx -= n;
+    }
+    return 0;
+}
+
+static void
+append_box_cache_record(BoxCacheRecords *r, char_type ch, const uint8_t *mask, size_t sz) {
+    ensure_space_for(r, items, uint8_t, r->count + sizeof(ch) + sz, capacity, 64 * (sizeof(ch) + sz), false);
+    memcpy(r->items + r->count, &ch, sizeof(ch)); memcpy(r->items + r->count + sizeof(ch), mask, sz);
+    r->count += sizeof(ch) + sz;
+}
+
+static void*
+box_prerender_worker(void *data) {
+    set_thread_name("KittyBoxRender");
+    struct BoxPrerenderWorker *w = data;
+    BoxPrerender *p = w->prerender;
+    const unsigned width = p->header.width, height = p->header.height, num = num_box_char_candidates();
+    const size_t sz = (size_t)width * height;
+    RAII_ALLOC(uint8_t, buf, malloc(SUPERSAMPLE_FACTOR * SUPERSAMPLE_FACTOR * 2 * sz));
+    if (!buf) return NULL;
+    unsigned i;
+    while ((i = __atomic_fetch_add(&p->next_candidate, 1, __ATOMIC_RELAXED)) < num) {
+        if (p->skip[i]) continue;
+        const char_type ch = box_char_candidate(i);
+        if (render_box_char(ch, buf, width, height, p->header.dpi_x, p->header.dpi_y, 1.0)) append_box_cache_record(&w->records, ch, buf, sz);
+    }
+    return NULL;
+}
+
+static void
+free_box_prerender(BoxPrerender *p) {
+    for (unsigned i = 0; i < p->num_threads; i++) free(p->workers[i].records.items);
+    free(p->skip); free(p);
+}
+
+static void
+add_to_box_cache_map(BoxCache *c, char_type ch, const uint8_t *mask) {
+    const size_t sz = (size_t)c->header.width * c->header.height;
+    if (!vt_is_end(vt_get(&c->map, ch))) return;
+    if (vt_is_end(vt_insert(&c->map, ch, c->masks.count))) return;
+    ensure_space_for(&c->masks, items, uint8_t, (c->masks.count + 1) * sz, capacity, 64 * sz, false);
+    memcpy(c->masks.items + c->masks.count++ * sz, mask, sz);
+}
+
+static void
+add_records_to_box_cache_map(BoxCache *c, const uint8_t *data, size_t sz) {
+    const size_t record_sz = sizeof(char_type) + (size_t)c->header.width * c->header.height;
+    for (size_t pos = 0; pos + record_sz <= sz; pos += record_sz) {
+        char_type ch; memcpy(&ch, data + pos, sizeof(ch));
+        add_to_box_cache_map(c, ch, data + pos + sizeof(ch));
+    }
+}
+
+static void
+write_box_cache_records(BoxCache *c, const uint8_t *data, size_t sz) {
+    if (c->fd < 0 || !sz) return;
+    ssize_t n;
+    do { n = write(c->fd, data, sz); } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)sz) { safe_close(c->fd, __FILE__, __LINE__); c->fd = -1; }
+}
+
+static void
+finish_box_prerender(BoxCache *c) {
+    BoxPrerender *p = c->prerender;
+    if (!p) return;
+    c->prerender = NULL;
+    for (unsigned i = 0; i < p->num_threads; i++) {
+        pthread_join(p->workers[i].thread, NULL);
+        add_records_to_box_cache_map(c, p->workers[i].records.items, p->workers[i].records.count);
+        write_box_cache_records(c, p->workers[i].records.items, p->workers[i].records.count);
+    }
+    free_box_prerender(p);
+}
+
+static void
+start_box_prerender(BoxCache *c) {
+    const unsigned num = num_box_char_candidates();
+    BoxPrerender *p = calloc(1, sizeof(BoxPrerender));
+    if (!p || !(p->skip = calloc(num, sizeof(p->skip[0])))) { free(p); return; }
+    p->header = c->header;
+    for (unsigned i = 0; i < num; i++) p->skip[i] = !vt_is_end(vt_get(&c->map, box_char_candidate(i)));
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const unsigned desired = MAX(1u, MIN(MAX_BOX_PRERENDER_THREADS, ncpus > 1 ? (unsigned)ncpus - 1 : 1u));
+    for (; p->num_threads < desired; p->num_threads++) {
+        p->workers[p->num_threads].prerender = p;
+        int ret = pthread_create(&p->workers[p->num_threads].thread, NULL, box_prerender_worker, p->workers + p->num_threads);
+        if (ret != 0) { log_error("Failed to start box drawing render thread with error: %s", strerror(ret)); break; }
+    }
+    if (p->num_threads) c->prerender = p;
+    else free_box_prerender(p);
+}
+
+static void
+free_box_cache(BoxCache *c) {
+    if (c->initialized) {
+        if (c->prerender) {
+            __atomic_store_n(&c->prerender->next_candidate, num_box_char_candidates(), __ATOMIC_RELAXED);
+            for (unsigned i = 0; i < c->prerender->num_threads; i++) pthread_join(c->prerender->workers[i].thread, NULL);
+            free_box_prerender(c->prerender);
+        }
+        if (c->fd > -1) safe_close(c->fd, __FILE__, __LINE__);
+        vt_cleanup(&c->map);
+        free(c->masks.items);
+    }
+    zero_at_ptr(c);
+}
+
+static void
+load_box_cache(BoxCache *c) {
+    struct stat st;
+    if (fstat(c->fd, &st) != 0) goto invalid;
+    RAII_ALLOC(uint8_t, data, malloc(st.st_size));
+    if (!data) goto invalid;
+    size_t pos = 0;
+    while (pos < (size_t)st.st_size) {
+        ssize_t n = pread(c->fd, data + pos, st.st_size - pos, pos);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) goto invalid;
+        pos += n;
+    }
+    if ((size_t)st.st_size < sizeof(c->header) || memcmp(data, &c->header, sizeof(c->header)) != 0) goto invalid;
+    add_records_to_box_cache_map(c, data + sizeof(c->header), st.st_size - sizeof(c->header));
+    return;
+invalid:
+    safe_close(c->fd, __FILE__, __LINE__); c->fd = -1;
+}
+
+static void
+init_box_cache(BoxCache *c, unsigned width, unsigned height, double dpi_x, double dpi_y) {
+    zero_at_ptr(c);
+    c->initialized = true; c->fd = -1;
+    vt_init(&c->map);
+    memcpy(c->header.magic, BOX_CACHE_MAGIC, sizeof(c->header.magic));
+    c->header.width = width; c->header.height = height;
+    c->header.dpi_x = dpi_x; c->header.dpi_y = dpi_y;
+    for (size_t i = 0; i < arraysz(c->header.box_drawing_scale); i++) c->header.box_drawing_scale[i] = OPT(box_drawing_scale)[i];
+    if (box_cache_dir) {
+        char path[4096], tmp[4096 + 16];
+        snprintf(path, sizeof(path), "%s/%ux%u-%016llx", box_cache_dir, width, height, (unsigned long long)vt_hash_bytes(&c->header, sizeof(c->header)));
+        c->fd = safe_open(path, O_RDWR | O_APPEND | O_CLOEXEC, 0);
+        if (c->fd < 0 && errno == ENOENT) {
+            // Create the file with its header atomically so that other instances
+            // never see a file without one
+            snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+            int fd = safe_mkstemp(tmp);
+            if (fd > -1) {
+                const bool ok = write(fd, &c->header, sizeof(c->header)) == (ssize_t)sizeof(c->header);
+                safe_close(fd, __FILE__, __LINE__);
+                if (ok && link(tmp, path) != 0 && errno != EEXIST) log_error("Failed to create box drawing cache file %s with error: %s", path, strerror(errno));
+                unlink(tmp);
+                c->fd = safe_open(path, O_RDWR | O_APPEND | O_CLOEXEC, 0);
+            }
+        }
+        if (c->fd > -1) load_box_cache(c);
+    }
+    if (box_cache_prerender) start_box_prerender(c);
+}
+
+static void
+render_box_char_uncached(char_type ch, uint8_t *buf, unsigned width, unsigned height, double dpi_x, double dpi_y, double scale) {
+    if (!render_box_char(ch, buf, width, height, dpi_x, dpi_y, scale)) log_error("Unknown box drawing character: U+%x rendered as blank", ch);
+}
+
+static void
+render_box_char_cached(BoxCache *c, char_type ch, uint8_t *buf, unsigned width, unsigned height, double dpi_x, double dpi_y, double scale) {
+    // Only the unscaled glyphs are cached, scaled text is much rarer
+    if (scale != 1 || !c->initialized || width != c->header.width || height != c->header.height) {
+        render_box_char_uncached(ch, buf, width, height, dpi_x, dpi_y, scale); return;
+    }
+    finish_box_prerender(c);
+    const size_t sz = (size_t)width * height;
+    box_cache_map_t_itr i = vt_get(&c->map, ch);
+    if (!vt_is_end(i)) { memcpy(buf, c->masks.items + i.data->val * sz, sz); return; }
+    render_box_char_uncached(ch, buf, width, height, dpi_x, dpi_y, scale);
+    add_to_box_cache_map(c, ch, buf);
+    BoxCacheRecords r = {0};
+    append_box_cache_record(&r, ch, buf, sz);
+    write_box_cache_records(c, r.items, r.count);
+    free(r.items);
+}
+// }}}
+
 typedef struct {
     FONTS_DATA_HEAD
     id_type id;
@@ -123,9 +455,19 @@ typedef struct {
     Font *fonts;
     Canvas canvas;
     GPUSpriteTracker sprite_tracker;
+    // colored sprites are also stored in a separate RGBA texture, see send_sprite_to_gpu()
+    GPUSpriteTracker colored_sprite_tracker;
+    // the position of the first sprite after the prerendered sprites
+    GPUSpriteTracker glyph_sprites_start;
+    bool sprites_exhausted, sprites_over_limit;
+    // set once sprite_memory_limit has been doubled for this group, see recycle_sprites_if_needed()
+    bool sprite_memory_limit_raised;
+    monotonic_t sprites_recycled_at;
     fallback_font_map_t fallback_font_map;
     scaled_font_map_t scaled_font_map;
     decorations_index_map_t decorations_index_map;
+    ShapingCache shaping_cache, line_cache;
+    BoxCache box_cache;
 } FontGroup;
 
 static FontGroup* font_groups = NULL;
@@ -240,6 +582,8 @@ del_font_group(FontGroup *fg) {
     vt_cleanup(&fg->fallback_font_map);
     vt_cleanup(&fg->scaled_font_map);
     vt_cleanup(&fg->decorations_index_map);
+    free_shaping_cache(&fg->shaping_cache); free_shaping_cache(&fg->line_cache);
+    free_box_cache(&fg->box_cache);
     for (size_t i = 0; i < fg->fonts_count; i++) del_font(fg->fonts + i);
     free(fg->fonts); fg->fonts = NULL; fg->fonts_count = 0;
 }
@@ -300,14 +644,14 @@ sprite_tracker_set_limits(size_t max_texture_size_, size_t max_array_len_) {
 }
 
 static bool
-do_increment(FontGroup *fg) {
-    fg->sprite_tracker.x++;
-    if (fg->sprite_tracker.x >= fg->sprite_tracker.xnum) {
-        fg->sprite_tracker.x = 0; fg->sprite_tracker.y++;
-        fg->sprite_tracker.ynum = MIN(MAX(fg->sprite_tracker.ynum, fg->sprite_tracker.y + 1), fg->sprite_tracker.max_y);
-        if (fg->sprite_tracker.y >= fg->sprite_tracker.max_y) {
-            fg->sprite_tracker.y = 0; fg->sprite_tracker.z++;
-            if (fg->sprite_tracker.z >= MIN((size_t)UINT16_MAX, max_array_len)) { PyErr_SetString(PyExc_RuntimeError, "Out of texture space for sprites"); return false; }
+do_increment(GPUSpriteTracker *sprite_tracker) {
+    sprite_tracker->x++;
+    if (sprite_tracker->x >= sprite_tracker->xnum) {
+        sprite_tracker->x = 0; sprite_tracker->y++;
+        sprite_tracker->ynum = MIN(MAX(sprite_tracker->ynum, sprite_tracker->y + 1), sprite_tracker->max_y);
+        if (sprite_tracker->y >= sprite_tracker->max_y) {
+            sprite_tracker->y = 0; sprite_tracker->z++;
+            if (sprite_tracker->z >= MIN((size_t)UINT16_MAX, max_array_len)) { PyErr_SetString(PyExc_RuntimeError, "Out of texture space for sprites"); return false; }
         }
     }
     return true;
@@ -330,12 +674,26 @@ sprite_position_for(FontGroup *fg, RunFont rf, glyph_index *glyphs, unsigned gly
     return s;
 }
 
+size_t
+font_group_cache_memory_usage(FONTS_DATA_HANDLE data) {
+    // The memory used by the caches of rendered and shaped text, not the fonts
+    const FontGroup *fg = (FontGroup*)data;
+    return fg->canvas.size_in_bytes + fg->canvas.alpha_mask_sz_in_bytes + fg->box_cache.masks.capacity +
+        shaping_cache_memory_usage(&fg->shaping_cache) + shaping_cache_memory_usage(&fg->line_cache);
+}
+
 void
 sprite_tracker_current_layout(FONTS_DATA_HANDLE data, unsigned int *x, unsigned int *y, unsigned int *z) {
     FontGroup *fg = (FontGroup*)data;
     *x = fg->sprite_tracker.xnum; *y = fg->sprite_tracker.ynum; *z = fg->sprite_tracker.z;
 }
 
+void
+colored_sprite_tracker_current_layout(FONTS_DATA_HANDLE data, unsigned int *x, unsigned int *y, unsigned int *z) {
+    FontGroup *fg = (FontGroup*)data;
+    *x = fg->colored_sprite_tracker.xnum; *y = fg->colored_sprite_tracker.ynum; *z = fg->colored_sprite_tracker.z;
+}
+
 
 static void
 sprite_tracker_set_layout(GPUSpriteTracker *sprite_tracker, unsigned int cell_width, unsigned int cell_height) {
@@ -382,18 +740,111 @@ calculate_underline_exclusion_zones(pixel *buf, const FontGroup *fg, DecorationG
     if (0) dump_sprite(ans, fg->fcm.cell_width, 1);
 }
 
+static size_t
+sprite_memory_used(const FontGroup *fg) {
+    const size_t sprite_area = (size_t)fg->fcm.cell_width * (fg->fcm.cell_height + 1);
+#define num_of_pixels(t) ((size_t)(t).xnum * (t).ynum * ((t).z + 1) * sprite_area)
+    // the alpha masks of all sprites use one byte per pixel
+    return num_of_pixels(fg->sprite_tracker) + num_of_pixels(fg->colored_sprite_tracker) * sizeof(pixel);
+#undef num_of_pixels
+}
+
+static size_t
+sprite_memory_limit(const FontGroup *fg) {
+    return (size_t)OPT(sprite_memory_limit) * 1024u * 1024u * (fg->sprite_memory_limit_raised ? 2u : 1u);
+}
+
 static sprite_index
-current_send_sprite_to_gpu(FontGroup *fg, pixel *buf, DecorationMetadata dec, FontCellMetrics scaled_metrics) {
-    sprite_index ans = current_sprite_index(&fg->sprite_tracker);
-    if (!do_increment(fg)) return 0;
+current_send_sprite_to_gpu(FontGroup *fg, pixel *buf, DecorationMetadata dec, FontCellMetrics scaled_metrics, bool colored) {
+    sprite_index ans = current_sprite_index(&fg->sprite_tracker), colored_idx = current_sprite_index(&fg->colored_sprite_tracker);
+    const GPUSpriteTracker before = fg->sprite_tracker, colored_before = fg->colored_sprite_tracker;
+    if (!do_increment(&fg->sprite_tracker) || (colored && !do_increment(&fg->colored_sprite_tracker))) {
+        // The sprite is drawn blank and all sprites are rendered again before
+        // the next frame, see recycle_sprites()
+        PyErr_Clear();
+        fg->sprite_tracker = before; fg->colored_sprite_tracker = colored_before;
+        fg->sprites_exhausted = true;
+        rendering_failed = true;
+        return 0;
+    }
+    if (OPT(sprite_memory_limit) && sprite_memory_used(fg) > sprite_memory_limit(fg)) fg->sprites_over_limit = true;
     if (python_send_to_gpu_impl) { python_send_to_gpu(fg, ans, buf); return ans; }
     if (dec.underline_region.height && OPT(underline_exclusion).thickness > 0) calculate_underline_exclusion_zones(
             buf, fg, dec.underline_region, scaled_metrics);
-    send_sprite_to_gpu((FONTS_DATA_HANDLE)fg, ans, buf, dec.start_idx);
+    send_sprite_to_gpu((FONTS_DATA_HANDLE)fg, ans, buf, dec.start_idx, colored, colored_idx);
     if (0) { printf("Sprite: %u dec_idx: %u\n", ans, dec.start_idx); display_rgba_data(buf, fg->fcm.cell_width, fg->fcm.cell_height); printf("\n"); }
     return ans;
 }
 
+static void
+dirty_screens_using_font_group(const FontGroup *fg) {
+    for (size_t o = 0; o < global_state.num_os_windows; o++) {
+        OSWindow *osw = global_state.os_windows + o;
+        if ((FontGroup*)osw->fonts_data != fg) continue;
+        if (osw->tab_bar_render_data.screen) screen_dirty_sprite_positions(osw->tab_bar_render_data.screen);
+        for (size_t t = 0; t < osw->num_tabs; t++) {
+            Tab *tab = osw->tabs + t;
+            for (size_t w = 0; w < tab->num_windows; w++) {
+                if (tab->windows[w].render_data.screen) screen_dirty_sprite_positions(tab->windows[w].render_data.screen);
+            }
+        }
+    }
+}
+
+static void
+recycle_sprites(FontGroup *fg) {
+    // The sprite indices are baked into the GPU cell data of every screen so
+    // individual sprites cannot be evicted. Instead all sprites other than the
+    // prerendered ones are discarded together and every screen using this font
+    // group is rendered again, overwriting them from the start. The sprite
+    // positions are only marked as not rendered as pointers to them are held
+    // while rendering.
+    const GPUSpriteTracker *start = &fg->glyph_sprites_start;
+    const sprite_index first = start->y * fg->sprite_tracker.xnum + start->x;
+    for (size_t i = 0; i < fg->fonts_count; i++) {
+        if (fg->fonts[i].sprite_position_hash_table) mark_sprite_positions_as_not_rendered(fg->fonts[i].sprite_position_hash_table);
+    }
+    for (decorations_index_map_t_itr i = vt_first(&fg->decorations_index_map); !vt_is_end(i);) {
+        if (i.data->val.start_idx >= first || !i.data->val.start_idx) i = vt_erase_itr(&fg->decorations_index_map, i);
+        else i = vt_next(i);
+    }
+    clear_shaping_cache(&fg->shaping_cache); clear_shaping_cache(&fg->line_cache);
+    // the layout, and so the size of the textures, is kept
+    fg->sprite_tracker.x = start->x; fg->sprite_tracker.y = start->y; fg->sprite_tracker.z = start->z;
+    fg->colored_sprite_tracker.x = 0; fg->colored_sprite_tracker.y = 0; fg->colored_sprite_tracker.z = 0;
+    fg->sprites_exhausted = false; fg->sprites_over_limit = false;
+    fg->sprites_recycled_at = monotonic();
+    dirty_screens_using_font_group(fg);
+}
+
+monotonic_t
+recycle_sprites_if_needed(void) {
+    // Must be called only between frames, never while screens are being
+    // rendered. Returns how long to wait before calling it again, or zero if
+    // there is nothing left to do.
+    const monotonic_t now = monotonic(), interval = s_to_monotonic_t(1ll);
+    monotonic_t ans = 0;
+    for (size_t i = 0; i < num_font_groups; i++) {
+        FontGroup *fg = font_groups + i;
+        if (!fg->sprites_exhausted && !fg->sprites_over_limit) continue;
+        if (!fg->sprites_exhausted && !fg->sprite_memory_limit_raised) {
+            // The first time sprite_memory_limit is exceeded the limit is
+            // doubled instead, so that a working set slightly larger than
+            // the limit does not cause everything to be rendered again
+            // repeatedly
+            fg->sprite_memory_limit_raised = true;
+            fg->sprites_over_limit = sprite_memory_used(fg) > sprite_memory_limit(fg);
+            if (!fg->sprites_over_limit) continue;
+        }
+        // Recycling is throttled to avoid rendering everything on every
+        // frame when the glyphs on screen do not fit, the glyphs that did
+        // not fit stay blank until then
+        const monotonic_t since = now - fg->sprites_recycled_at;
+        if (since >= interval) recycle_sprites(fg);
+        else if (!ans || interval - since < ans) ans = interval - since;
+    }
+    return ans;
+}
 
 // }}}
 
@@ -495,6 +946,40 @@ init_font(Font *f, PyObject *face, bool bold, bool italic, bool emoji_presentati
     return true;
 }
 
+static PyObject*
+face_for_descriptor_idx(FontGroup *fg, unsigned int desc_idx, bool *bold, bool *italic) {
+    RAII_PyObject(d, PyObject_CallFunction(descriptor_for_idx, "I", desc_idx));
+    if (d == NULL) return NULL;
+    *bold = PyObject_IsTrue(PyTuple_GET_ITEM(d, 1));
+    *italic = PyObject_IsTrue(PyTuple_GET_ITEM(d, 2));
+    PyObject *x = PyTuple_GET_ITEM(d, 0);
+    return PyUnicode_Check(x) ? face_from_path(PyUnicode_AsUTF8(x), 0, (FONTS_DATA_HANDLE)fg) : desc_to_face(x, (FONTS_DATA_HANDLE)fg);
+}
+
+static void
+load_pending_font(FontGroup *fg, Font *f) {
+    // Opening a face and creating its features is slow enough with many
+    // symbol_map fonts to noticeably delay startup, so it is done the first
+    // time a cell needs the font, after the cell metrics have been calculated
+    // from the medium font.
+    f->is_pending = false;
+    bool bold = false, italic = false;
+    RAII_PyObject(face, face_for_descriptor_idx(fg, f->desc_idx, &bold, &italic));
+    if (face && init_font(f, face, bold, italic, false)) {
+        if (f->is_symbol_font) set_size_for_face(f->face, fg->fcm.cell_height, true, (FONTS_DATA_HANDLE)fg);
+        return;
+    }
+    if (PyErr_Occurred()) PyErr_Print();
+    log_error("Failed to load font with descriptor index: %u, using the medium font instead", f->desc_idx);
+    del_font(f);
+    if (!init_font(f, fg->fonts[fg->medium_font_idx].face, bold, italic, false)) fatal("Out of memory");
+}
+
+static void
+ensure_font_loaded(FontGroup *fg, ssize_t idx) {
+    if (idx >= 0 && fg->fonts[idx].is_pending) load_pending_font(fg, fg->fonts + idx);
+}
+
 static void
 free_font_groups(void) {
     if (font_groups) {
@@ -652,6 +1137,7 @@ load_fallback_font(FontGroup *fg, const ListOfChars *lc, bool bold, bool italic,
     if (bold) f = italic ? fg->bi_font_idx : fg->bold_font_idx;
     else f = italic ? fg->italic_font_idx : fg->medium_font_idx;
     if (f < 0) f = fg->medium_font_idx;
+    ensure_font_loaded(fg, f);
 
     PyObject *face = create_fallback_face(fg->fonts[f].face, lc, bold, italic, emoji_presentation, (FONTS_DATA_HANDLE)fg);
     if (face == NULL) { PyErr_Print(); return MISSING_FONT; }
@@ -750,7 +1236,7 @@ START_ALLOW_CASE_RANGE
             if (lc->count == 1 && (lc->chars[0] == ' ' || lc->chars[0] == 0x2002 /* en-space */) && (!cpu_cell->is_multicell || cpu_cell->scale == 1)) return BLANK_FONT;
             *is_emoji_presentation = has_emoji_presentation(cpu_cell, lc);
             ans = in_symbol_maps(fg, lc->chars[0]);
-            if (ans > -1) return ans;
+            if (ans > -1) { ensure_font_loaded(fg, ans); return ans; }
             switch(gpu_cell->attrs.bold | (gpu_cell->attrs.italic << 1)) {
                 case 0:
                     ans = fg->medium_font_idx; break;
@@ -762,6 +1248,7 @@ START_ALLOW_CASE_RANGE
                     ans = fg->bi_font_idx; break;
             }
             if (ans < 0) ans = fg->medium_font_idx;
+            ensure_font_loaded(fg, ans);
             if (!*is_emoji_presentation && has_cell_text((bool(*)(const void*, char_type))face_has_codepoint, (fg->fonts + ans)->face, false, lc)) { *is_main_font = true; return ans; }
             return fallback_font(fg, cpu_cell, gpu_cell, lc);
     }
@@ -792,8 +1279,6 @@ START_ALLOW_CASE_RANGE
 END_ALLOW_CASE_RANGE
 }
 
-static PyObject *descriptor_for_idx = NULL;
-
 void
 render_alpha_mask(const uint8_t *alpha_mask, pixel* dest, const Region *src_rect, const Region *dest_rect, size_t src_stride, size_t dest_stride, pixel color_rgb) {
     pixel col = color_rgb << 8;
@@ -991,7 +1476,7 @@ render_decorations(FontGroup *fg, Region src, Region dest, FontCellMetrics scale
     memset(alpha_mask, 0, sizeof(alpha_mask[0]) * scaled_metrics.cell_width * scaled_metrics.cell_height); \
     DecorationGeometry sdg = call; \
     render_scaled_decoration(unscaled_metrics, scaled_metrics, alpha_mask, buf, src, dest); \
-    sprite_index q = current_send_sprite_to_gpu(fg, buf, (DecorationMetadata){0}, scaled_metrics); \
+    sprite_index q = current_send_sprite_to_gpu(fg, buf, (DecorationMetadata){0}, scaled_metrics, false); \
     if (!ans) ans = q; \
     if (is_underline) { \
         Region r = map_scaled_decoration_geometry(sdg, src, dest); \
@@ -1042,6 +1527,7 @@ render_box_cell(FontGroup *fg, RunFont rf, CPUCell *cpu_cell, GPUCell *gpu_cell,
 #define failed {\
     if (PyErr_Occurred()) PyErr_Print(); \
     for (unsigned i = 0; i < num_cells; i++) gpu_cell[i].sprite_idx = 0; \
+    rendering_failed = true; \
     return; \
 }
     if (!num_glyphs) failed;
@@ -1076,7 +1562,7 @@ render_box_cell(FontGroup *fg, RunFont rf, CPUCell *cpu_cell, GPUCell *gpu_cell,
     for (unsigned i = 0, cnum = 0; i < num_glyphs; i++) {
         unsigned int ch = global_glyph_render_scratch.lc->chars[cnum++];
         while (!ch) ch = global_glyph_render_scratch.lc->chars[cnum++];
-        render_box_char(ch, fg->canvas.alpha_mask, src.right, src.bottom, fg->logical_dpi_x, fg->logical_dpi_y, scale);
+        render_box_char_cached(&fg->box_cache, ch, fg->canvas.alpha_mask, src.right, src.bottom, fg->logical_dpi_x, fg->logical_dpi_y, scale);
         dest.left = i * scaled_metrics.cell_width + right_shift; dest.right = dest.left + scaled_metrics.cell_width;
         render_alpha_mask(fg->canvas.alpha_mask, fg->canvas.buf, &src, &dest, src.right, mask_stride, 0xffffff);
     }
@@ -1089,7 +1575,7 @@ render_box_cell(FontGroup *fg, RunFont rf, CPUCell *cpu_cell, GPUCell *gpu_cell,
         if (!sp[i]->rendered) {
             pixel *b = extract_cell_region(&fg->canvas, i, &src, &dest, mask_stride, unscaled_metrics);
             /*printf("cell %u src -> dest: (%u %u) -> (%u %u)\n", i, src.left, src.right, dest.left, dest.right);*/
-            sp[i]->idx = current_send_sprite_to_gpu(fg, b, dm, scaled_metrics);
+            sp[i]->idx = current_send_sprite_to_gpu(fg, b, dm, scaled_metrics, false);
             if (!sp[i]->idx) failed;
             /*dump_sprite(b, unscaled_metrics.cell_width, unscaled_metrics.cell_height);*/
             sp[i]->rendered = true; sp[i]->colored = false;
@@ -1151,6 +1637,33 @@ apply_horizontal_alignment(pixel *canvas, RunFont rf, bool center_glyph, GlyphRe
 
 
 
+// The canvas holds the whole multicell block, so the sprites for the other
+// lines of the block are stored as well. Otherwise rendering each line of the
+// block would rasterize all of it again, which is slow for large headings.
+static void
+store_sprites_for_other_lines_of_multicell(
+    FontGroup *fg, RunFont rf, glyph_index *glyphs, unsigned glyph_count, unsigned num_cells, unsigned num_scaled_cells,
+    bool was_colored, FontCellMetrics scaled_metrics, FontCellMetrics unscaled_metrics
+) {
+    const unsigned rendered_y = rf.multicell_y;
+    for (unsigned y = 0; y < rf.scale; y++) {
+        if (y == rendered_y) continue;
+        rf.multicell_y = y;
+        Region src={.bottom=scaled_metrics.cell_height, .right=scaled_metrics.cell_width * num_scaled_cells}, dest={.right=unscaled_metrics.cell_width};
+        calculate_regions_for_line(rf, unscaled_metrics.cell_height, &src, &dest);
+        DecorationMetadata dm = index_for_decorations(fg, rf, src, dest, scaled_metrics);
+        for (unsigned i = 0; i < num_cells; i++) {
+            SpritePosition *s = sprite_position_for(fg, rf, glyphs, glyph_count, i, num_cells);
+            if (!s) { PyErr_Clear(); return; }
+            if (s->rendered) continue;
+            pixel *b = extract_cell_region(&fg->canvas, i, &src, &dest, scaled_metrics.cell_width * num_scaled_cells, unscaled_metrics);
+            // the sprite is rendered again when its line is, if this fails
+            if (!(s->idx = current_send_sprite_to_gpu(fg, b, dm, scaled_metrics, was_colored))) { PyErr_Clear(); return; }
+            s->rendered = true; s->colored = was_colored;
+        }
+    }
+}
+
 static void
 render_group(
     FontGroup *fg, unsigned int num_cells, unsigned int num_glyphs, CPUCell *cpu_cells, GPUCell *gpu_cells,
@@ -1166,6 +1679,7 @@ render_group(
 #define failed { \
     if (PyErr_Occurred()) PyErr_Print(); \
     for (unsigned i = 0; i < num_cells; i++) gpu_cells[i].sprite_idx = 0; \
+    rendering_failed = true; \
     return; \
 }
 
@@ -1215,7 +1729,7 @@ render_group(
                 bool is_repeat_sprite = is_infinite_ligature && i > 0 && sp[i]->idx == sp[i-1]->idx;
                 if (!is_repeat_sprite) {
                     pixel *b = num_cells == 1 ? fg->canvas.buf : extract_cell_from_canvas(fg, i, num_cells);
-                    sp[i]->idx = current_send_sprite_to_gpu(fg, b, dm, scaled_metrics);
+                    sp[i]->idx = current_send_sprite_to_gpu(fg, b, dm, scaled_metrics, was_colored);
                     if (!sp[i]->idx) failed;
                 } else sp[i]->idx = sp[i-1]->idx;
                 sp[i]->rendered = true; sp[i]->colored = was_colored;
@@ -1231,13 +1745,15 @@ render_group(
             if (!sp[i]->rendered) {
                 pixel *b = extract_cell_region(&fg->canvas, i, &src, &dest, scaled_metrics.cell_width * num_scaled_cells, unscaled_metrics);
                 /*printf("cell %u src -> dest: (%u %u) -> (%u %u)\n", i, src.left, src.right, dest.left, dest.right);*/
-                sp[i]->idx = current_send_sprite_to_gpu(fg, b, dm, scaled_metrics);
+                sp[i]->idx = current_send_sprite_to_gpu(fg, b, dm, scaled_metrics, was_colored);
                 if (!sp[i]->idx) failed;
                 /*dump_sprite(b, unscaled_metrics.cell_width, unscaled_metrics.cell_height);*/
                 sp[i]->rendered = true; sp[i]->colored = was_colored;
             }
             set_cell_sprite(gpu_cells + i, sp[i]);
         }
+        if (rf.scale > 1 && !is_infinite_ligature) store_sprites_for_other_lines_of_multicell(
+            fg, rf, glyphs, glyph_count, num_cells, num_scaled_cells, was_colored, scaled_metrics, unscaled_metrics);
     }
 
     fg->fcm = scaled_metrics;
@@ -1757,31 +2273,108 @@ test_shape(PyObject UNUSED *self, PyObject *args) {
 }
 #undef G
 
+static void
+render_shaped_run(FontGroup *fg, CPUCell *first_cpu_cell, GPUCell *first_gpu_cell, index_type num_cells, RunFont rf, bool pua_space_ligature, bool center_glyph, int cursor_offset, DisableLigature disable_ligature_strategy, const TextCache *tc, ListOfChars *lc) {
+    float scale = shape_run(first_cpu_cell, first_gpu_cell, num_cells, &fg->fonts[rf.font_idx], rf, fg, disable_ligature_strategy == DISABLE_LIGATURES_ALWAYS, tc, lc);
+    if (pua_space_ligature) collapse_pua_space_ligature(num_cells);
+    else if (cursor_offset > -1) { // false if DISABLE_LIGATURES_NEVER
+        index_type left, right;
+        split_run_at_offset(cursor_offset, &left, &right, scale);
+        if (right > left) {
+            if (left) {
+                shape_run(first_cpu_cell, first_gpu_cell, left, &fg->fonts[rf.font_idx], rf, fg, false, tc, lc);
+                render_groups(fg, rf, center_glyph, tc);
+            }
+                shape_run(first_cpu_cell + left, first_gpu_cell + left, right - left, &fg->fonts[rf.font_idx], rf, fg, true, tc, lc);
+                render_groups(fg, rf, center_glyph, tc);
+            if (right < num_cells) {
+                shape_run(first_cpu_cell + right, first_gpu_cell + right, num_cells - right, &fg->fonts[rf.font_idx], rf, fg, false, tc, lc);
+                render_groups(fg, rf, center_glyph, tc);
+            }
+            return;
+        }
+    }
+    render_groups(fg, rf, center_glyph, tc);
+}
+
+static void
+shaping_key_append_cell(ShapingCache *c, const CPUCell *cpu_cell, uint32_t extra, const TextCache *tc, ListOfChars *lc) {
+    // everything in the cell other than its text and the attributes that
+    // dont affect rendering
+    CPUCell cell = *cpu_cell;
+    cell.ch_and_idx = 0; cell.hyperlink_id = 0; cell.next_char_was_wrapped = 0; cell.temp_flag = 0;
+    text_in_cell(cpu_cell, tc, lc);
+    uint32_t words[sizeof(CPUCell) / sizeof(uint32_t)];
+    memcpy(words, &cell, sizeof(words));
+    ensure_space_for(&c->key, items, uint32_t, c->key.count + arraysz(words) + lc->count + 2, capacity, 256, false);
+    for (unsigned w = 0; w < arraysz(words); w++) c->key.items[c->key.count++] = words[w];
+    c->key.items[c->key.count++] = extra;
+    c->key.items[c->key.count++] = lc->count;
+    for (size_t n = 0; n < lc->count; n++) c->key.items[c->key.count++] = lc->chars[n];
+}
+
+static bool
+apply_cached_sprites(ShapingCache *c, GPUCell *gpu_cells, index_type num_cells) {
+    // Looks up the key that was built in c and if it is found sets the
+    // sprites of the cells and returns true
+    c->hash = vt_hash_bytes(c->key.items, c->key.count * sizeof(c->key.items[0]));
+    if (!c->sets) return false;
+    ShapingCacheSet *set = c->sets + (c->hash % SHAPING_CACHE_SETS);
+    for (unsigned w = 0; w < arraysz(set->ways); w++) {
+        ShapingCacheEntry *e = set->ways + w;
+        if (e->key && e->hash == c->hash && e->key_len == c->key.count && e->num_cells == num_cells && memcmp(e->key, c->key.items, c->key.count * sizeof(c->key.items[0])) == 0) {
+            for (index_type i = 0; i < num_cells; i++) gpu_cells[i].sprite_idx = e->sprites[i];
+            set->least_recently_used = 1 - w;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+cache_sprites(ShapingCache *c, const GPUCell *gpu_cells, index_type num_cells) {
+    // Stores the sprites of the cells for the key that was looked up by apply_cached_sprites()
+    if (!c->sets && !(c->sets = calloc(SHAPING_CACHE_SETS, sizeof(c->sets[0])))) return;
+    ShapingCacheSet *set = c->sets + (c->hash % SHAPING_CACHE_SETS);
+    const unsigned w = set->least_recently_used;
+    ShapingCacheEntry *e = set->ways + w;
+    uint32_t *key = realloc(e->key, c->key.count * sizeof(key[0]));
+    if (key) e->key = key;
+    sprite_index *sprites = realloc(e->sprites, num_cells * sizeof(sprites[0]));
+    if (sprites) e->sprites = sprites;
+    if (!key || !sprites) { free(e->key); free(e->sprites); zero_at_ptr(e); return; }
+    memcpy(e->key, c->key.items, c->key.count * sizeof(key[0]));
+    e->key_len = c->key.count; e->hash = c->hash; e->num_cells = num_cells;
+    for (index_type i = 0; i < num_cells; i++) e->sprites[i] = gpu_cells[i].sprite_idx;
+    set->least_recently_used = 1 - w;
+}
+
+static bool
+apply_cached_shaping(FontGroup *fg, const CPUCell *cpu_cells, GPUCell *gpu_cells, index_type num_cells, RunFont rf, bool pua_space_ligature, bool center_glyph, int cursor_offset, DisableLigature disable_ligature_strategy, const TextCache *tc, ListOfChars *lc) {
+    ShapingCache *c = &fg->shaping_cache;
+    c->key.count = 0;
+    ensure_space_for(&c->key, items, uint32_t, 16, capacity, 256, false);
+#define A(x) c->key.items[c->key.count++] = (uint32_t)(x)
+    A(rf.font_idx); A(rf.scale); A(rf.subscale_n); A(rf.subscale_d); A(rf.multicell_y); A(rf.align.val);
+    A(pua_space_ligature | (center_glyph << 1) | (disable_ligature_strategy << 2)); A(cursor_offset); A(num_cells);
+#undef A
+    for (index_type i = 0; i < num_cells; i++) shaping_key_append_cell(c, cpu_cells + i, 0, tc, lc);
+    return apply_cached_sprites(c, gpu_cells, num_cells);
+}
+
 static void
 render_run(FontGroup *fg, CPUCell *first_cpu_cell, GPUCell *first_gpu_cell, index_type num_cells, RunFont rf, bool pua_space_ligature, bool center_glyph, int cursor_offset, DisableLigature disable_ligature_strategy, const TextCache *tc, ListOfChars *lc) {
-    float scale;
     switch(rf.font_idx) {
         default:
-            scale = shape_run(first_cpu_cell, first_gpu_cell, num_cells, &fg->fonts[rf.font_idx], rf, fg, disable_ligature_strategy == DISABLE_LIGATURES_ALWAYS, tc, lc);
-            if (pua_space_ligature) collapse_pua_space_ligature(num_cells);
-            else if (cursor_offset > -1) { // false if DISABLE_LIGATURES_NEVER
-                index_type left, right;
-                split_run_at_offset(cursor_offset, &left, &right, scale);
-                if (right > left) {
-                    if (left) {
-                        shape_run(first_cpu_cell, first_gpu_cell, left, &fg->fonts[rf.font_idx], rf, fg, false, tc, lc);
-                        render_groups(fg, rf, center_glyph, tc);
-                    }
-                        shape_run(first_cpu_cell + left, first_gpu_cell + left, right - left, &fg->fonts[rf.font_idx], rf, fg, true, tc, lc);
-                        render_groups(fg, rf, center_glyph, tc);
-                    if (right < num_cells) {
-                        shape_run(first_cpu_cell + right, first_gpu_cell + right, num_cells - right, &fg->fonts[rf.font_idx], rf, fg, false, tc, lc);
-                        render_groups(fg, rf, center_glyph, tc);
-                    }
-                    break;
-                }
+            if (num_cells > SHAPING_CACHE_MAX_RUN_CELLS) {
+                render_shaped_run(fg, first_cpu_cell, first_gpu_cell, num_cells, rf, pua_space_ligature, center_glyph, cursor_offset, disable_ligature_strategy, tc, lc);
+            } else if (!apply_cached_shaping(fg, first_cpu_cell, first_gpu_cell, num_cells, rf, pua_space_ligature, center_glyph, cursor_offset, disable_ligature_strategy, tc, lc)) {
+                const bool failed_before = rendering_failed;
+                rendering_failed = false;
+                render_shaped_run(fg, first_cpu_cell, first_gpu_cell, num_cells, rf, pua_space_ligature, center_glyph, cursor_offset, disable_ligature_strategy, tc, lc);
+                if (!rendering_failed) cache_sprites(&fg->shaping_cache, first_gpu_cell, num_cells);
+                rendering_failed |= failed_before;
             }
-            render_groups(fg, rf, center_glyph, tc);
             break;
         case BLANK_FONT:
             while (num_cells--) {
@@ -1851,6 +2444,23 @@ render_line(FONTS_DATA_HANDLE fg_, Line *line, index_type lnum, Cursor *cursor,
     RunFont basic_font = {.scale=1, .font_idx = NO_FONT}, run_font = basic_font, cell_font = basic_font;
     bool center_glyph = false;
     bool disable_ligature_at_cursor = cursor != NULL && disable_ligature_strategy == DISABLE_LIGATURES_CURSOR;
+    // lines with PUA space ligatures change the colors of the spaces, so
+    // they are not cached
+    bool cacheable = line->xnum <= SHAPING_CACHE_MAX_RUN_CELLS;
+    if (cacheable) {
+        ShapingCache *c = &fg->line_cache;
+        c->key.count = 0;
+        ensure_space_for(&c->key, items, uint32_t, 4, capacity, 256, false);
+        const bool cursor_on_line = disable_ligature_at_cursor && cursor->x < line->xnum && multicell_intersects_cursor(line, lnum, cursor);
+        c->key.items[c->key.count++] = disable_ligature_strategy;
+        c->key.items[c->key.count++] = cursor_on_line ? cursor->x : UINT32_MAX;
+        for (index_type x = 0; x < line->xnum; x++) {
+            const GPUCell *g = line->gpu_cells + x;
+            shaping_key_append_cell(c, line->cpu_cells + x, g->attrs.bold | (g->attrs.italic << 1), line->text_cache, lc);
+        }
+        if (apply_cached_sprites(c, line->gpu_cells, line->xnum)) return;
+    }
+    rendering_failed = false;
     index_type first_cell_in_run, i;
     for (i=0, first_cell_in_run=0; i < line->xnum; i++) {
         cell_font = basic_font;
@@ -1902,6 +2512,7 @@ render_line(FONTS_DATA_HANDLE fg_, Line *line, index_type lnum, Cursor *cursor,
                 space_cell->decoration_fg = gpu_cell->decoration_fg;
             }
             if (num_spaces) {
+                cacheable = false;
                 center_glyph = true;
                 RENDER
                 center_glyph = false;
@@ -1920,6 +2531,7 @@ render_line(FONTS_DATA_HANDLE fg_, Line *line, index_type lnum, Cursor *cursor,
     }
     RENDER
 #undef RENDER
+    if (cacheable && !rendering_failed) cache_sprites(&fg->line_cache, line->gpu_cells, line->xnum);
 }
 
 StringCanvas
@@ -1977,7 +2589,7 @@ send_prerendered_sprites(FontGroup *fg) {
     // blank cell
     ensure_canvas_can_fit(fg, 1, 1);
     DecorationMetadata dm = {.start_idx=5};
-    current_send_sprite_to_gpu(fg, fg->canvas.buf, dm, fg->fcm);
+    current_send_sprite_to_gpu(fg, fg->canvas.buf, dm, fg->fcm, false);
     const unsigned cell_area = fg->fcm.cell_height * fg->fcm.cell_width;
     RAII_ALLOC(uint8_t, alpha_mask, malloc(cell_area));
     if (!alpha_mask) fatal("Out of memory");
@@ -1987,7 +2599,7 @@ send_prerendered_sprites(FontGroup *fg) {
     call; \
     ensure_canvas_can_fit(fg, 1, 1);  /* clear canvas */ \
     render_alpha_mask(alpha_mask, fg->canvas.buf, &r, &r, fg->fcm.cell_width, fg->fcm.cell_width, 0xffffff); \
-    current_send_sprite_to_gpu(fg, fg->canvas.buf, dm, fg->fcm);
+    current_send_sprite_to_gpu(fg, fg->canvas.buf, dm, fg->fcm, false);
 
     // If you change the mapping of these cells you will need to change
     // BEAM_IDX in shader.c and STRIKE_SPRITE_INDEX in
@@ -2000,19 +2612,15 @@ send_prerendered_sprites(FontGroup *fg) {
     Region rg = {.bottom = fg->fcm.cell_height, .right = fg->fcm.cell_width};
     sprite_index actual_dec_idx = index_for_decorations(fg, rf, rg, rg, fg->fcm).start_idx;
     if (actual_dec_idx != dm.start_idx) fatal("dec_idx: %u != actual_dec_idx: %u", dm.start_idx, actual_dec_idx);
+    fg->glyph_sprites_start = fg->sprite_tracker;
 
 #undef do_one
 }
 
 static size_t
 initialize_font(FontGroup *fg, unsigned int desc_idx, const char *ftype) {
-    PyObject *d = PyObject_CallFunction(descriptor_for_idx, "I", desc_idx);
-    if (d == NULL) { PyErr_Print(); fatal("Failed for %s font", ftype); }
-    bool bold = PyObject_IsTrue(PyTuple_GET_ITEM(d, 1));
-    bool italic = PyObject_IsTrue(PyTuple_GET_ITEM(d, 2));
-    PyObject *x = PyTuple_GET_ITEM(d, 0);
-    PyObject *face  = PyUnicode_Check(x) ? face_from_path(PyUnicode_AsUTF8(x), 0, (FONTS_DATA_HANDLE)fg) : desc_to_face(x, (FONTS_DATA_HANDLE)fg);
-    Py_CLEAR(d);
+    bool bold, italic;
+    PyObject *face = face_for_descriptor_idx(fg, desc_idx, &bold, &italic);
     if (face == NULL) { PyErr_Print(); fatal("Failed to convert descriptor to face for %s font", ftype); }
     size_t idx = fg->fonts_count++;
     bool ok = init_font(fg->fonts + idx, face, bold, italic, false);
@@ -2024,6 +2632,14 @@ initialize_font(FontGroup *fg, unsigned int desc_idx, const char *ftype) {
     return idx;
 }
 
+static size_t
+add_pending_font(FontGroup *fg, unsigned int desc_idx, bool is_symbol_font) {
+    size_t idx = fg->fonts_count++;
+    Font *f = fg->fonts + idx;
+    f->is_pending = true; f->is_symbol_font = is_symbol_font; f->desc_idx = desc_idx;
+    return idx;
+}
+
 static void
 initialize_font_group(FontGroup *fg) {
     fg->fonts_capacity = 10 + descriptor_indices.num_symbol_fonts;
@@ -2034,25 +2650,23 @@ initialize_font_group(FontGroup *fg) {
     vt_init(&fg->fallback_font_map);
     vt_init(&fg->scaled_font_map);
     vt_init(&fg->decorations_index_map);
-#define I(attr)  if (descriptor_indices.attr) fg->attr##_font_idx = initialize_font(fg, descriptor_indices.attr, #attr); else fg->attr##_font_idx = -1;
+#define I(attr)  if (descriptor_indices.attr) fg->attr##_font_idx = add_pending_font(fg, descriptor_indices.attr, false); else fg->attr##_font_idx = -1;
     fg->medium_font_idx = initialize_font(fg, 0, "medium");
     I(bold); I(italic); I(bi);
 #undef I
     fg->first_symbol_font_idx = fg->fonts_count; fg->first_fallback_font_idx = fg->fonts_count;
     fg->fallback_fonts_count = 0;
     for (size_t i = 0; i < descriptor_indices.num_symbol_fonts; i++) {
-        initialize_font(fg, descriptor_indices.bi + 1 + i, "symbol_map");
+        add_pending_font(fg, descriptor_indices.bi + 1 + i, true);
         fg->first_fallback_font_idx++;
     }
 #undef I
     calc_cell_metrics(fg, fg->fonts[fg->medium_font_idx].face);
     ensure_canvas_can_fit(fg, 8, 1);
+    if (box_cache_dir || box_cache_prerender) init_box_cache(&fg->box_cache, fg->fcm.cell_width, fg->fcm.cell_height, fg->logical_dpi_x, fg->logical_dpi_y);
     sprite_tracker_set_layout(&fg->sprite_tracker, fg->fcm.cell_width, fg->fcm.cell_height);
-    // rescale the symbol_map faces for the desired cell height, this is how fallback fonts are sized as well
-    for (size_t i = 0; i < descriptor_indices.num_symbol_fonts; i++) {
-        Font *font = fg->fonts + i + fg->first_symbol_font_idx;
-        set_size_for_face(font->face, fg->fcm.cell_height, true, (FONTS_DATA_HANDLE)fg);
-    }
+    sprite_tracker_set_layout(&fg->colored_sprite_tracker, fg->fcm.cell_width, fg->fcm.cell_height);
+    // the symbol_map faces are rescaled for the desired cell height when loaded, this is how fallback fonts are sized as well
     ScaledFontData sfd = {.fcm=fg->fcm, .font_sz_in_pts=fg->font_sz_in_pts};
     vt_insert(&fg->scaled_font_map, 1.f, sfd);
 }
@@ -2076,6 +2690,7 @@ load_fonts_data(double font_sz_in_pts, double dpi_x, double dpi_y) {
 static void
 finalize(void) {
     Py_CLEAR(python_send_to_gpu_impl);
+    free(box_cache_dir); box_cache_dir = NULL;
     clear_symbol_maps();
     Py_CLEAR(descriptor_for_idx);
     free_font_groups();
@@ -2095,6 +2710,8 @@ sprite_map_set_layout(PyObject UNUSED *self, PyObject *args) {
     if(!PyArg_ParseTuple(args, "II", &w, &h)) return NULL;
     if (!num_font_groups) { PyErr_SetString(PyExc_RuntimeError, "must create font group first"); return NULL; }
     sprite_tracker_set_layout(&font_groups->sprite_tracker, w, h);
+    sprite_tracker_set_layout(&font_groups->colored_sprite_tracker, w, h);
+    clear_shaping_cache(&font_groups->shaping_cache); clear_shaping_cache(&font_groups->line_cache);
     Py_RETURN_NONE;
 }
 
@@ -2104,10 +2721,30 @@ test_sprite_position_increment(PyObject UNUSED *self, PyObject *args UNUSED) {
     FontGroup *fg = font_groups;
     unsigned int x, y, z;
     sprite_index_to_pos(current_sprite_index(&fg->sprite_tracker), fg->sprite_tracker.xnum, fg->sprite_tracker.ynum, &x, &y, &z);
-    if (!do_increment(fg)) return NULL;
+    if (!do_increment(&fg->sprite_tracker)) return NULL;
     return Py_BuildValue("III", x, y, z);
 }
 
+static PyObject*
+set_box_drawing_cache(PyObject UNUSED *self, PyObject *args) {
+    PyObject *path; int prerender;
+    if (!PyArg_ParseTuple(args, "Op", &path, &prerender)) return NULL;
+    if (path != Py_None && !PyUnicode_Check(path)) { PyErr_SetString(PyExc_TypeError, "path must be a string or None"); return NULL; }
+    free(box_cache_dir); box_cache_dir = NULL;
+    box_cache_prerender = prerender;
+    if (path != Py_None) {
+        const char *p = PyUnicode_AsUTF8(path);
+        if (!p) return NULL;
+        if (!(box_cache_dir = strdup(p))) return PyErr_NoMemory();
+    }
+    for (size_t i = 0; i < num_font_groups; i++) {
+        FontGroup *fg = font_groups + i;
+        free_box_cache(&fg->box_cache);
+        if (box_cache_dir || box_cache_prerender) init_box_cache(&fg->box_cache, fg->fcm.cell_width, fg->fcm.cell_height, fg->logical_dpi_x, fg->logical_dpi_y);
+    }
+    Py_RETURN_NONE;
+}
+
 static PyObject*
 set_send_sprite_to_gpu(PyObject UNUSED *self, PyObject *func) {
     Py_CLEAR(python_send_to_gpu_impl);
@@ -2204,6 +2841,7 @@ current_fonts(PyObject *self UNUSED, PyObject *args) {
         if (!os_window) { PyErr_SetString(PyExc_KeyError, "no oswindow with the specified id exists"); return NULL; }
         fg = (FontGroup*)os_window->fonts_data;
     }
+    for (size_t i = 0; i < fg->fonts_count; i++) ensure_font_loaded(fg, i);
     RAII_PyObject(ans, PyDict_New());
     if (!ans) return NULL;
 #define SET(key, val) {if (PyDict_SetItemString(ans, #key, fg->fonts[val].face) != 0) { return NULL; }}
@@ -2362,6 +3000,8 @@ pyspecialize_font_descriptor(PyObject *self UNUSED, PyObject *args) {
 static PyObject*
 set_allow_use_of_box_fonts(PyObject *self UNUSED, PyObject *val) {
     allow_use_of_box_fonts = PyObject_IsTrue(val);
+    // the font used for a cell changes
+    for (size_t i = 0; i < num_font_groups; i++) clear_shaping_cache(&font_groups[i].line_cache);
     Py_RETURN_NONE;
 }
 
@@ -2380,7 +3020,7 @@ pyrender_box_char(PyObject *self UNUSED, PyObject *args) {
     if (!PyArg_ParseTuple(args, "Ikk|ddd", &ch, &width, &height, &scale, &dpi_x, &dpi_y)) return NULL;
     RAII_PyObject(ans, PyBytes_FromStringAndSize(NULL, width*16 * height*16));
     if (!ans) return NULL;
-    render_box_char(ch, (uint8_t*)PyBytes_AS_STRING(ans), width, height, dpi_x, dpi_y, scale);
+    render_box_char_uncached(ch, (uint8_t*)PyBytes_AS_STRING(ans), width, height, dpi_x, dpi_y, scale);
     if (_PyBytes_Resize(&ans, width * height) != 0) return NULL;
     return Py_NewRef(ans);
 }
@@ -2395,6 +3035,7 @@ static PyMethodDef module_methods[] = {
     METHODB(concat_cells, METH_VARARGS),
     METHODB(render_decoration, METH_VARARGS),
     METHODB(set_send_sprite_to_gpu, METH_O),
+    METHODB(set_box_drawing_cache, METH_VARARGS),
     METHODB(set_allow_use_of_box_fonts, METH_O),
     METHODB(test_shape, METH_VARARGS),
     METHODB(current_fonts, METH_VARARGS),
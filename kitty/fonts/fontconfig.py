@@ -1,8 +1,11 @@
 #!/usr/bin/env python
 # License: GPL v3 Copyright: 2016, Kovid Goyal <kovid at kovidgoyal.net>
 
+import json
+import os
 import sys
 from collections.abc import Generator, Sequence
+from contextlib import suppress
 from functools import lru_cache
 from typing import Literal, NamedTuple, Optional, cast
 
@@ -15,11 +18,15 @@
     FC_WIDTH_NORMAL,
     Face,
     fc_list,
+    fontconfig_fingerprint,
+    get_fallback_descriptor_cache,
+    set_fallback_descriptor_cache,
 )
 from kitty.fast_data_types import (
     FC_WEIGHT_SEMIBOLD as FC_WEIGHT_BOLD,
 )
 from kitty.fast_data_types import fc_match as fc_match_impl
+from kitty.constants import cache_dir
 from kitty.typing_compat import FontConfigPattern
 
 from . import Descriptor, DescriptorVar, ListedFont, Score, Scorer, VariableData, family_name_to_key
@@ -300,3 +307,42 @@ def get_axis_values(font: FontConfigPattern, vd: VariableData) -> dict[str, floa
             if tag not in ans:
                 ans[tag] = ax['default']
     return ans
+
+
+# Fallback font cache {{{
+# The fonts fontconfig matches for the text of cells that no configured font
+# has glyphs for are persisted across launches so that starting kitty with
+# lots of such text on screen does not have to repeat the matching. The cache
+# is discarded when the fontconfig configuration, fonts or caches change.
+
+FALLBACK_CACHE_VERSION = 1
+loaded_fallback_cache_size = 0
+
+
+def fallback_cache_path() -> str:
+    return os.path.join(cache_dir(), 'fontconfig-fallback.json')
+
+
+def load_fallback_cache() -> None:
+    global loaded_fallback_cache_size
+    try:
+        with open(fallback_cache_path(), 'rb') as f:
+            data = json.loads(f.read())
+        if data['version'] != FALLBACK_CACHE_VERSION or data['fingerprint'] != fontconfig_fingerprint():
+            return
+        entries = {k: v for k, v in data['entries'].items() if os.path.exists(v['path'])}
+    except Exception:
+        return
+    set_fallback_descriptor_cache(entries)
+    loaded_fallback_cache_size = len(entries)
+
+
+def save_fallback_cache() -> None:
+    entries = get_fallback_descriptor_cache()
+    if len(entries) <= loaded_fallback_cache_size:
+        return
+    from kitty.config import atomic_save
+    data = {'version': FALLBACK_CACHE_VERSION, 'fingerprint': fontconfig_fingerprint(), 'entries': entries}
+    with suppress(OSError):
+        atomic_save(json.dumps(data, ensure_ascii=False).encode(), fallback_cache_path())
+# }}}
@@ -3,11 +3,13 @@
 
 import ctypes
 import os
+import shutil
 import sys
 from collections.abc import Callable, Generator
+from contextlib import suppress
 from typing import TYPE_CHECKING, Any, Literal, Union
 
-from kitty.constants import fonts_dir, is_macos
+from kitty.constants import cache_dir, fonts_dir, is_macos, str_version
 from kitty.fast_data_types import (
     Screen,
     concat_cells,
@@ -15,6 +17,7 @@
     current_fonts,
     get_fallback_font,
     render_decoration,
+    set_box_drawing_cache,
     set_builtin_nerd_font,
     set_font_data,
     set_options,
@@ -188,6 +191,22 @@ def dump_font_debug() -> None:
             log_error('  ' + s.identify_for_debug())
 
 
+def box_drawing_cache_dir() -> str | None:
+    base = os.path.join(cache_dir(), 'box-drawing')
+    ans = os.path.join(base, str_version)
+    try:
+        os.makedirs(ans, exist_ok=True)
+    except OSError as e:
+        log_error(f'Failed to create the box drawing cache directory with error: {e}')
+        return None
+    # the rendering of box drawing characters can change between versions
+    with suppress(OSError):
+        for x in os.scandir(base):
+            if x.name != str_version and x.is_dir(follow_symlinks=False):
+                shutil.rmtree(x.path, ignore_errors=True)
+    return ans
+
+
 def set_font_family(opts: Options | None = None, override_font_size: float | None = None, add_builtin_nerd_font: bool = False) -> None:
     global current_faces, builtin_nerd_font_descriptor
     opts = opts or defaults
@@ -210,6 +229,7 @@ def set_font_family(opts: Options | None = None, override_font_size: float | Non
     sm = create_symbol_map(opts)
     ns = create_narrow_symbols(opts)
     num_symbol_fonts = len(current_faces) - before
+    set_box_drawing_cache(box_drawing_cache_dir() if opts.cache_box_drawing else None, opts.prerender_box_drawing)
     set_font_data(
         descriptor_for_idx,
         indices['bold'], indices['italic'], indices['bi'], num_symbol_fonts,
@@ -14,6 +14,32 @@
 #include FT_BITMAP_H
 #define ELLIPSIS 0x2026
 
+// Rendered glyph bitmaps, keyed by glyph id and pixel size, mono bitmaps are
+// stored converted to gray. The cache of a face is emptied when its pixel size
+// changes, for example because of a DPI change, or when it gets too large.
+#define MAX_CACHED_GLYPHS 1024u
+typedef struct CachedGlyph {
+    uint8_t *buf;
+    unsigned width, rows, stride;
+    FT_Pixel_Mode pixel_mode;
+    int bitmap_left, bitmap_top;
+} CachedGlyph;
+
+static void free_cached_glyph(CachedGlyph *g) { free(g->buf); free(g); }
+#define NAME glyph_cache_map_t
+#define KEY_TY uint64_t
+#define VAL_TY CachedGlyph*
+#define VAL_DTOR_FN free_cached_glyph
+#include "kitty-verstable.h"
+
+// Codepoints for which fontconfig has no fallback font, so that they are not
+// looked up again every time the text is rendered. Emptied when the font
+// changes or it gets too large.
+#define MAX_MISSING_FALLBACKS 4096u
+#define NAME missing_glyph_set_t
+#define KEY_TY uint64_t
+#include "kitty-verstable.h"
+
 typedef struct FamilyInformation {
     char *name;
     bool bold, italic;
@@ -26,6 +52,7 @@ typedef struct Face {
     int hinting, hintstyle;
     struct Face **fallbacks;
     size_t count, capacity;
+    glyph_cache_map_t glyphs;
 } Face;
 
 typedef struct {
@@ -38,12 +65,30 @@ typedef struct {
     int bitmap_left, bitmap_top;
 } ProcessedBitmap;
 
+// The same lines are rendered over and over, for example the title in client
+// side decorations on every focus change, so the last few are kept
+#define NUM_CACHED_LINES 4
+#define MAX_CACHED_LINE_SIZE (4u * 1024u * 1024u)
+
+typedef struct CachedLine {
+    char *text;
+    unsigned sz_px;
+    pixel fg, bg;
+    size_t width, height, output_width;
+    float y_offset;
+    bool horizontally_center_runs;
+    pixel *pixels;
+} CachedLine;
+
 typedef struct RenderCtx {
     bool created;
     Face main_face;
     FontConfigFace main_face_information;
     FamilyInformation main_face_family;
     hb_buffer_t *hb_buffer;
+    missing_glyph_set_t missing_fallbacks;
+    CachedLine cached_lines[NUM_CACHED_LINES];
+    unsigned next_cached_line;
 } RenderCtx;
 
 #define main_face ctx->main_face
@@ -62,11 +107,22 @@ free_face(Face *face) {
     if (face->hb) hb_font_destroy(face->hb);
     for (size_t i = 0; i < face->count; i++) { free_face(face->fallbacks[i]); free(face->fallbacks[i]); }
     free(face->fallbacks);
+    vt_cleanup(&face->glyphs);
     memset(face, 0, sizeof(Face));
 }
 
+static void
+free_cached_lines(RenderCtx *ctx) {
+    for (unsigned i = 0; i < NUM_CACHED_LINES; i++) {
+        free(ctx->cached_lines[i].text); free(ctx->cached_lines[i].pixels);
+    }
+    zero_at_ptr(&ctx->cached_lines); ctx->next_cached_line = 0;
+}
+
 static void
 cleanup(RenderCtx *ctx) {
+    free_cached_lines(ctx);
+    vt_cleanup(&ctx->missing_fallbacks);
     free_face(&main_face);
     free(main_face_information.path); main_face_information.path = NULL;
     free(main_face_family.name);
@@ -99,6 +155,7 @@ get_load_flags(int hinting, int hintstyle, int base) {
 
 static bool
 load_font(FontConfigFace *info, Face *ans) {
+    vt_init(&ans->glyphs);
     ans->freetype = native_face_from_path(info->path, info->index);
     if (!ans->freetype || PyErr_Occurred()) return false;
     ans->hb = hb_ft_font_create(ans->freetype, NULL);
@@ -138,6 +195,7 @@ set_pixel_size(RenderCtx *ctx, Face *face, FT_UInt sz, bool get_metrics UNUSED)
         hb_ft_font_changed(face->hb);
         hb_ft_font_set_load_flags(face->hb, get_load_flags(face->hinting, face->hintstyle, FT_LOAD_DEFAULT));
         face->pixel_size = sz;
+        vt_clear(&face->glyphs);
     }
 }
 
@@ -219,16 +277,6 @@ render_gray_bitmap(ProcessedBitmap *src, RenderState *rs) {
     }
 }
 
-static void
-populate_processed_bitmap(FT_GlyphSlotRec *slot, FT_Bitmap *bitmap, ProcessedBitmap *ans) {
-    ans->stride = bitmap->pitch < 0 ? -bitmap->pitch : bitmap->pitch;
-    ans->rows = bitmap->rows;
-    ans->start_x = 0; ans->width = bitmap->width;
-    ans->pixel_mode = bitmap->pixel_mode;
-    ans->bitmap_top = slot->bitmap_top; ans->bitmap_left = slot->bitmap_left;
-    ans->buf = bitmap->buffer;
-}
-
 static void
 detect_edges(ProcessedBitmap *ans) {
 #define check const uint8_t *p = ans->buf + x * 4 + y * ans->stride; if (p[3] > 20)
@@ -268,7 +316,15 @@ find_fallback_font_for(RenderCtx *ctx, char_type codep, char_type next_codep) {
     bool prefer_color = false;
     char_type string[3] = {codep, next_codep, 0};
     if (wcswidth_string(string) >= 2 && char_props_for(codep).is_emoji_presentation_base) prefer_color = true;
-    if (!fallback_font(codep, main_face_family.name, main_face_family.bold, main_face_family.italic, prefer_color, &q)) return NULL;
+    const uint64_t key = (uint64_t)codep | ((uint64_t)prefer_color << 32);
+    if (!vt_is_end(vt_get(&ctx->missing_fallbacks, key))) return NULL;
+    if (!fallback_font(codep, main_face_family.name, main_face_family.bold, main_face_family.italic, prefer_color, &q)) {
+        if (!PyErr_Occurred()) {
+            if (vt_size(&ctx->missing_fallbacks) >= MAX_MISSING_FALLBACKS) vt_clear(&ctx->missing_fallbacks);
+            if (vt_is_end(vt_insert(&ctx->missing_fallbacks, key))) fatal("Out of memory");
+        }
+        return NULL;
+    }
     ensure_space_for(&main_face, fallbacks, Face, main_face.count + 1, capacity, 8, true);
     Face *ans = calloc(1, sizeof(Face));
     if (!ans) fatal("Out of memory");
@@ -295,6 +351,50 @@ calculate_ellipsis_width(RenderCtx *ctx) {
 }
 
 
+static const CachedGlyph*
+load_glyph(Face *face, FT_UInt glyph_id, FT_UInt pixel_size, int load_flags) {
+    const uint64_t key = (uint64_t)glyph_id | ((uint64_t)pixel_size << 32);
+    glyph_cache_map_t_itr itr = vt_get(&face->glyphs, key);
+    if (!vt_is_end(itr)) return itr.data->val;
+    int error = FT_Load_Glyph(face->freetype, glyph_id, load_flags);
+    if (error) { set_freetype_error("Failed loading glyph", error); return NULL; }
+    FT_GlyphSlotRec *slot = face->freetype->glyph;
+    FT_Bitmap converted, *bitmap = &slot->bitmap;
+    switch (slot->bitmap.pixel_mode) {
+        case FT_PIXEL_MODE_MONO:
+            if (!freetype_convert_mono_bitmap(&slot->bitmap, &converted)) return NULL;
+            bitmap = &converted;
+            break;
+        case FT_PIXEL_MODE_GRAY: case FT_PIXEL_MODE_BGRA:
+            break;
+        default:
+            PyErr_Format(PyExc_TypeError, "Unknown FreeType bitmap type: 0x%x", slot->bitmap.pixel_mode);
+            return NULL;
+    }
+    CachedGlyph *g = calloc(1, sizeof(CachedGlyph));
+    if (!g) fatal("Out of memory");
+    g->width = bitmap->width; g->rows = bitmap->rows; g->pixel_mode = bitmap->pixel_mode;
+    g->stride = bitmap->pitch < 0 ? -bitmap->pitch : bitmap->pitch;
+    g->bitmap_left = slot->bitmap_left; g->bitmap_top = slot->bitmap_top;
+    if (g->rows && g->stride) {
+        if (!(g->buf = malloc((size_t)g->rows * g->stride))) fatal("Out of memory");
+        memcpy(g->buf, bitmap->buffer, (size_t)g->rows * g->stride);
+    }
+    if (bitmap == &converted) FT_Bitmap_Done(freetype_library(), &converted);
+    if (vt_size(&face->glyphs) >= MAX_CACHED_GLYPHS) vt_clear(&face->glyphs);
+    if (vt_is_end(vt_insert(&face->glyphs, key, g))) fatal("Out of memory");
+    return g;
+}
+
+static void
+populate_processed_bitmap(const CachedGlyph *g, ProcessedBitmap *ans) {
+    ans->stride = g->stride; ans->rows = g->rows;
+    ans->start_x = 0; ans->width = g->width;
+    ans->pixel_mode = g->pixel_mode;
+    ans->bitmap_top = g->bitmap_top; ans->bitmap_left = g->bitmap_left;
+    ans->buf = g->buf;
+}
+
 static bool
 render_run(RenderCtx *ctx, RenderState *rs) {
     hb_buffer_guess_segment_properties(hb_buffer);
@@ -336,18 +436,17 @@ render_run(RenderCtx *ctx, RenderState *rs) {
         rs->x += (float)positions[i].x_offset / 64.0f;
         rs->y += (float)positions[i].y_offset / 64.0f;
         if (rs->x > rs->output_width) break;
-        int error = FT_Load_Glyph(face, info[i].codepoint, load_flags);
-        if (error) {
-            set_freetype_error("Failed loading glyph", error);
+        const CachedGlyph *glyph = load_glyph(rs->current_face, info[i].codepoint, pixel_size, load_flags);
+        if (!glyph) {
             PyErr_Print();
             continue;
         };
         ProcessedBitmap pbm = {0};
-        switch(face->glyph->bitmap.pixel_mode) {
+        populate_processed_bitmap(glyph, &pbm);
+        switch(glyph->pixel_mode) {
             case FT_PIXEL_MODE_BGRA: {
                 uint8_t *buf = NULL;
                 unsigned text_height = font_units_to_pixels_y(main_face.freetype, main_face.freetype->height);
-                populate_processed_bitmap(face->glyph, &face->glyph->bitmap, &pbm);
                 unsigned bm_width = 0, bm_height = text_height;
                 if (pbm.rows > bm_height) {
                     double ratio = pbm.width / (double)pbm.rows;
@@ -382,24 +481,10 @@ render_run(RenderCtx *ctx, RenderState *rs) {
                 free(buf);
             }
                 break;
-            case FT_PIXEL_MODE_MONO: {
-                FT_Bitmap bitmap;
-                freetype_convert_mono_bitmap(&face->glyph->bitmap, &bitmap);
-                populate_processed_bitmap(face->glyph, &bitmap, &pbm);
-                setup_regions(&pbm, rs, baseline);
-                render_gray_bitmap(&pbm, rs);
-                FT_Bitmap_Done(freetype_library(), &bitmap);
-            }
-                break;
-            case FT_PIXEL_MODE_GRAY:
-                populate_processed_bitmap(face->glyph, &face->glyph->bitmap, &pbm);
+            default:
                 setup_regions(&pbm, rs, baseline);
                 render_gray_bitmap(&pbm, rs);
                 break;
-            default:
-                PyErr_Format(PyExc_TypeError, "Unknown FreeType bitmap type: 0x%x", face->glyph->bitmap.pixel_mode);
-                return false;
-                break;
         }
         rs->x += (float)positions[i].x_advance / 64.0f;
     }
@@ -433,10 +518,8 @@ process_codepoint(RenderCtx *ctx, RenderState *rs, char_type codep, char_type ne
     return true;
 }
 
-bool
-render_single_line(FreeTypeRenderCtx ctx_, const char *text, unsigned sz_px, pixel fg, pixel bg, uint8_t *output_buf, size_t width, size_t height, float x_offset, float y_offset, size_t right_margin, bool horizontally_center_runs) {
-    RenderCtx *ctx = (RenderCtx*)ctx_;
-    if (!ctx->created) return false;
+static bool
+render_single_line_impl(RenderCtx *ctx, const char *text, unsigned sz_px, pixel fg, pixel bg, uint8_t *output_buf, size_t width, size_t height, float x_offset, float y_offset, size_t right_margin, bool horizontally_center_runs) {
     size_t output_width = right_margin <= width ? width - right_margin : 0;
     bool has_text = text && text[0];
     pixel pbg = premult_pixel(bg, ((bg >> 24) & 0xff));
@@ -483,6 +566,52 @@ end:
     return ok;
 }
 
+static CachedLine*
+find_cached_line(RenderCtx *ctx, const CachedLine *q) {
+    for (unsigned i = 0; i < NUM_CACHED_LINES; i++) {
+        CachedLine *c = ctx->cached_lines + i;
+        if (c->pixels && c->sz_px == q->sz_px && c->fg == q->fg && c->bg == q->bg && c->width == q->width && c->height == q->height &&
+            c->output_width == q->output_width && c->y_offset == q->y_offset && c->horizontally_center_runs == q->horizontally_center_runs &&
+            strcmp(c->text, q->text) == 0) return c;
+    }
+    return NULL;
+}
+
+#define copy_cached_line_pixels(dest, dest_stride, src, src_stride) \
+    for (size_t y = 0; y < q.height; y++) memcpy((dest) + y * (dest_stride), (src) + y * (src_stride), q.output_width * sizeof(pixel));
+
+bool
+render_single_line(FreeTypeRenderCtx ctx_, const char *text, unsigned sz_px, pixel fg, pixel bg, uint8_t *output_buf, size_t width, size_t height, float x_offset, float y_offset, size_t right_margin, bool horizontally_center_runs) {
+    RenderCtx *ctx = (RenderCtx*)ctx_;
+    if (!ctx->created) return false;
+    // With no x_offset every pixel left of the right margin is overwritten so
+    // the result depends only on the arguments and can be cached
+    const CachedLine q = {
+        .text=(char*)text, .sz_px=sz_px, .fg=fg, .bg=bg, .width=width, .height=height, .y_offset=y_offset,
+        .output_width=right_margin <= width ? width - right_margin : 0, .horizontally_center_runs=horizontally_center_runs};
+    const bool cacheable = text && text[0] && x_offset == 0.f && q.output_width * height * sizeof(pixel) <= MAX_CACHED_LINE_SIZE;
+    if (cacheable) {
+        const CachedLine *c = find_cached_line(ctx, &q);
+        if (c) {
+            copy_cached_line_pixels((pixel*)output_buf, width, c->pixels, q.output_width);
+            return true;
+        }
+    }
+    if (!render_single_line_impl(ctx, text, sz_px, fg, bg, output_buf, width, height, x_offset, y_offset, right_margin, horizontally_center_runs)) return false;
+    if (cacheable) {
+        CachedLine *c = ctx->cached_lines + ctx->next_cached_line;
+        ctx->next_cached_line = (ctx->next_cached_line + 1) % NUM_CACHED_LINES;
+        free(c->text); free(c->pixels);
+        *c = q;
+        c->text = strdup(text);
+        c->pixels = malloc(q.output_width * height * sizeof(pixel));
+        if (!c->text || !c->pixels) { free(c->text); free(c->pixels); zero_at_ptr(c); }
+        else { copy_cached_line_pixels(c->pixels, q.output_width, (pixel*)output_buf, width); }
+    }
+    return true;
+}
+#undef copy_cached_line_pixels
+
 static uint8_t*
 render_single_char_bitmap(const FT_Bitmap *bm, size_t *result_width, size_t *result_height) {
     *result_width = bm->width; *result_height = bm->rows;
@@ -562,6 +691,7 @@ render_single_ascii_char_as_mask(FreeTypeRenderCtx ctx_, const char ch, size_t *
 FreeTypeRenderCtx
 create_freetype_render_context(const char *family, bool bold, bool italic) {
     RenderCtx *ctx = calloc(1, sizeof(RenderCtx));
+    vt_init(&ctx->missing_fallbacks);
     main_face_family.name = family ? strdup(family) : NULL;
     main_face_family.bold = bold; main_face_family.italic = italic;
     if (!information_for_font_family(main_face_family.name, main_face_family.bold, main_face_family.italic, &main_face_information)) return NULL;
@@ -339,10 +339,21 @@ unbind_program(void) {
 
 // Buffers {{{
 
+// Number of regions in a persistently mapped buffer, so that the CPU can write
+// into one while the GPU is still reading from the others
+#define NUM_BUFFER_REGIONS 3
+
 typedef struct {
     GLuint id;
     GLsizeiptr size;
     GLenum usage;
+    struct {
+        uint8_t *data;
+        GLsizeiptr region_size;
+        unsigned current;
+        GLsync fences[NUM_BUFFER_REGIONS];
+        uint64_t tags[NUM_BUFFER_REGIONS];
+    } persistent;
 } Buffer;
 
 
@@ -354,8 +365,8 @@ create_buffer(GLenum usage) {
     glGenBuffers(1, &buffer_id);
     for (size_t i = 0; i < sizeof(buffers)/sizeof(buffers[0]); i++) {
         if (buffers[i].id == 0) {
+            zero_at_i(buffers, i);
             buffers[i].id = buffer_id;
-            buffers[i].size = 0;
             buffers[i].usage = usage;
             return i;
         }
@@ -365,11 +376,19 @@ create_buffer(GLenum usage) {
     return -1;
 }
 
+static void
+free_buffer_fences(Buffer *b) {
+    for (unsigned i = 0; i < NUM_BUFFER_REGIONS; i++) {
+        if (b->persistent.fences[i]) { glDeleteSync(b->persistent.fences[i]); b->persistent.fences[i] = NULL; }
+    }
+}
+
 static void
 delete_buffer(ssize_t buf_idx) {
+    // deleting a buffer implicitly unmaps it
+    free_buffer_fences(buffers + buf_idx);
     glDeleteBuffers(1, &(buffers[buf_idx].id));
-    buffers[buf_idx].id = 0;
-    buffers[buf_idx].size = 0;
+    zero_at_i(buffers, buf_idx);
 }
 
 static GLuint
@@ -402,14 +421,58 @@ unmap_buffer(ssize_t idx) {
     glUnmapBuffer(buffers[idx].usage);
 }
 
+bool
+persistent_buffers_supported(void) {
+    return GLAD_GL_ARB_buffer_storage && GLAD_GL_ARB_sync;
+}
+
+static void
+alloc_persistent_buffer(ssize_t idx, GLsizeiptr region_size) {
+    // Storage allocated with glBufferStorage is immutable, so a new buffer
+    // object is needed whenever the size changes
+    Buffer *b = buffers + idx;
+    free_buffer_fences(b);
+    glDeleteBuffers(1, &b->id);
+    glGenBuffers(1, &b->id);
+    zero_at_ptr(&b->persistent);
+    b->size = region_size * NUM_BUFFER_REGIONS;
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    bind_buffer(idx);
+    glBufferStorage(b->usage, b->size, NULL, flags);
+    b->persistent.data = glMapBufferRange(b->usage, 0, b->size, flags);
+    if (!b->persistent.data) fatal("Failed to map persistent OpenGL buffer of size: %zd", (ssize_t)b->size);
+    b->persistent.region_size = region_size;
+    b->persistent.current = NUM_BUFFER_REGIONS - 1;
+}
+
+static void
+wait_for_fence(GLsync *fence) {
+    if (!*fence) return;
+    GLenum status;
+    do {
+        status = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+    } while (status == GL_TIMEOUT_EXPIRED);
+    glDeleteSync(*fence); *fence = NULL;
+}
+
 // }}}
 
 // Vertex Array Objects (VAO) {{{
 
+typedef struct {
+    GLint location, size;
+    GLenum data_type;
+    GLsizei stride;
+    uintptr_t offset;
+    GLuint divisor;
+    size_t bufnum;
+} VAOAttribute;
+
 typedef struct {
     GLuint id;
-    size_t num_buffers;
+    size_t num_buffers, num_attributes;
     ssize_t buffers[10];
+    VAOAttribute attributes[8];
 } VAO;
 
 static VAO vaos[4*MAX_CHILDREN + 10] = {{0}};
@@ -422,6 +485,7 @@ create_vao(void) {
         if (!vaos[i].id) {
             vaos[i].id = vao_id;
             vaos[i].num_buffers = 0;
+            vaos[i].num_attributes = 0;
             glBindVertexArray(vao_id);
             return i;
         }
@@ -443,25 +507,34 @@ add_buffer_to_vao(ssize_t vao_idx, GLenum usage) {
 }
 
 static void
-add_located_attribute_to_vao(ssize_t vao_idx, GLint aloc, GLint size, GLenum data_type, GLsizei stride, void *offset, GLuint divisor) {
-    VAO *vao = vaos + vao_idx;
-    if (!vao->num_buffers) fatal("You must create a buffer for this attribute first");
-    ssize_t buf = vao->buffers[vao->num_buffers - 1];
-    bind_buffer(buf);
-    glEnableVertexAttribArray(aloc);
-    switch(data_type) {
+specify_attribute_pointer(const VAOAttribute *a, GLintptr base_offset) {
+    void *offset = (void*)(a->offset + base_offset);
+    switch(a->data_type) {
         case GL_BYTE:
         case GL_UNSIGNED_BYTE:
         case GL_SHORT:
         case GL_UNSIGNED_SHORT:
         case GL_INT:
         case GL_UNSIGNED_INT:
-            glVertexAttribIPointer(aloc, size, data_type, stride, offset);
+            glVertexAttribIPointer(a->location, a->size, a->data_type, a->stride, offset);
             break;
         default:
-            glVertexAttribPointer(aloc, size, data_type, GL_FALSE, stride, offset);
+            glVertexAttribPointer(a->location, a->size, a->data_type, GL_FALSE, a->stride, offset);
             break;
     }
+}
+
+static void
+add_located_attribute_to_vao(ssize_t vao_idx, GLint aloc, GLint size, GLenum data_type, GLsizei stride, void *offset, GLuint divisor) {
+    VAO *vao = vaos + vao_idx;
+    if (!vao->num_buffers) fatal("You must create a buffer for this attribute first");
+    if (vao->num_attributes >= arraysz(vao->attributes)) fatal("Too many attributes in a single VAO");
+    VAOAttribute *a = vao->attributes + vao->num_attributes++;
+    *a = (VAOAttribute){.location=aloc, .size=size, .data_type=data_type, .stride=stride, .offset=(uintptr_t)offset, .divisor=divisor, .bufnum=vao->num_buffers - 1};
+    ssize_t buf = vao->buffers[a->bufnum];
+    bind_buffer(buf);
+    glEnableVertexAttribArray(aloc);
+    specify_attribute_pointer(a, 0);
     if (divisor) {
         glVertexAttribDivisorARB(aloc, divisor);
     }
@@ -485,6 +558,7 @@ remove_vao(ssize_t vao_idx) {
     }
     glDeleteVertexArrays(1, &(vao->id));
     vaos[vao_idx].id = 0;
+    vaos[vao_idx].num_attributes = 0;
 }
 
 void
@@ -518,6 +592,68 @@ alloc_and_map_vao_buffer(ssize_t vao_idx, GLsizeiptr size, size_t bufnum, GLenum
     return map_buffer(buf_idx, access);
 }
 
+void
+update_vao_buffer_range(ssize_t vao_idx, size_t bufnum, GLintptr offset, GLsizeiptr size, const void *data) {
+    ssize_t buf_idx = vaos[vao_idx].buffers[bufnum];
+    bind_buffer(buf_idx);
+    glBufferSubData(buffers[buf_idx].usage, offset, size, data);
+    unbind_buffer(buf_idx);
+}
+
+void
+move_vao_buffer_range(ssize_t vao_idx, size_t bufnum, GLintptr src_offset, GLintptr dest_offset, GLsizeiptr size) {
+    // Copies within a single buffer must not overlap, so the data goes via a
+    // scratch buffer. It never leaves the GPU.
+    static ssize_t scratch_idx = -1;
+    if (scratch_idx < 0) scratch_idx = create_buffer(GL_COPY_WRITE_BUFFER);
+    const GLuint buf_id = buffers[vaos[vao_idx].buffers[bufnum]].id;
+    bind_buffer(scratch_idx);
+    if (buffers[scratch_idx].size < size) alloc_buffer(scratch_idx, size, GL_STREAM_COPY);
+    glBindBuffer(GL_COPY_READ_BUFFER, buf_id);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, src_offset, 0, size);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffers[scratch_idx].id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buf_id);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, dest_offset, size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void*
+map_next_vao_buffer_region(ssize_t vao_idx, size_t bufnum, GLsizeiptr region_size, uint64_t **tag) {
+    // Switch the attributes sourced from this buffer to the next region of a
+    // persistently mapped buffer, waiting for the GPU to finish any draws that
+    // used that region previously. The tag is for use by the caller to record
+    // what was last written into the region.
+    VAO *vao = vaos + vao_idx;
+    ssize_t buf_idx = vao->buffers[bufnum];
+    Buffer *b = buffers + buf_idx;
+    if (!b->persistent.data || b->persistent.region_size != region_size) alloc_persistent_buffer(buf_idx, region_size);
+    b->persistent.current = (b->persistent.current + 1) % NUM_BUFFER_REGIONS;
+    wait_for_fence(b->persistent.fences + b->persistent.current);
+    const GLintptr base_offset = (GLintptr)b->persistent.current * region_size;
+    glBindVertexArray(vao->id);
+    bind_buffer(buf_idx);
+    for (size_t i = 0; i < vao->num_attributes; i++) {
+        if (vao->attributes[i].bufnum == bufnum) specify_attribute_pointer(vao->attributes + i, base_offset);
+    }
+    unbind_buffer(buf_idx);
+    *tag = b->persistent.tags + b->persistent.current;
+    return b->persistent.data + base_offset;
+}
+
+void
+fence_vao_buffer_regions(ssize_t vao_idx) {
+    // Must be called after all draw calls that read from the current regions of this VAO's persistent buffers
+    VAO *vao = vaos + vao_idx;
+    for (size_t i = 0; i < vao->num_buffers; i++) {
+        Buffer *b = buffers + vao->buffers[i];
+        if (!b->persistent.data) continue;
+        GLsync *fence = b->persistent.fences + b->persistent.current;
+        if (*fence) glDeleteSync(*fence);
+        *fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
 void
 bind_vao_uniform_buffer(ssize_t vao_idx, size_t bufnum, GLuint block_index) {
     ssize_t buf_idx = vaos[vao_idx].buffers[bufnum];
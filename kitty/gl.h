@@ -54,6 +54,11 @@ void add_attribute_to_vao(int p, ssize_t vao_idx, const char *name, GLint size,
 ssize_t alloc_vao_buffer(ssize_t vao_idx, GLsizeiptr size, size_t bufnum, GLenum usage);
 void* alloc_and_map_vao_buffer(ssize_t vao_idx, GLsizeiptr size, size_t bufnum, GLenum usage, GLenum access);
 void unmap_vao_buffer(ssize_t vao_idx, size_t bufnum);
+void update_vao_buffer_range(ssize_t vao_idx, size_t bufnum, GLintptr offset, GLsizeiptr size, const void *data);
+void move_vao_buffer_range(ssize_t vao_idx, size_t bufnum, GLintptr src_offset, GLintptr dest_offset, GLsizeiptr size);
+bool persistent_buffers_supported(void);
+void* map_next_vao_buffer_region(ssize_t vao_idx, size_t bufnum, GLsizeiptr region_size, uint64_t **tag);
+void fence_vao_buffer_regions(ssize_t vao_idx);
 void* map_vao_buffer(ssize_t vao_idx, size_t bufnum, GLenum access);
 void bind_program(int program);
 void bind_vertex_array(ssize_t vao_idx);
@@ -416,6 +416,9 @@ load_glfw(const char* path) {
     *(void **) (&glfwSwapBuffers_impl) = dlsym(handle, "glfwSwapBuffers");
     if (glfwSwapBuffers_impl == NULL) fail("Failed to load glfw function glfwSwapBuffers with error: %s", dlerror());
 
+    *(void **) (&glfwSwapBuffersWithDamage_impl) = dlsym(handle, "glfwSwapBuffersWithDamage");
+    if (glfwSwapBuffersWithDamage_impl == NULL) fail("Failed to load glfw function glfwSwapBuffersWithDamage with error: %s", dlerror());
+
     *(void **) (&glfwSwapInterval_impl) = dlsym(handle, "glfwSwapInterval");
     if (glfwSwapInterval_impl == NULL) fail("Failed to load glfw function glfwSwapInterval with error: %s", dlerror());
 
@@ -485,6 +488,9 @@ load_glfw(const char* path) {
     *(void **) (&glfwRequestWaylandFrameEvent_impl) = dlsym(handle, "glfwRequestWaylandFrameEvent");
     if (glfwRequestWaylandFrameEvent_impl == NULL) dlerror(); // clear error indicator
 
+    *(void **) (&glfwWaylandPresentationTiming_impl) = dlsym(handle, "glfwWaylandPresentationTiming");
+    if (glfwWaylandPresentationTiming_impl == NULL) dlerror(); // clear error indicator
+
     *(void **) (&glfwWaylandActivateWindow_impl) = dlsym(handle, "glfwWaylandActivateWindow");
     if (glfwWaylandActivateWindow_impl == NULL) dlerror(); // clear error indicator
 
@@ -2254,6 +2254,10 @@ typedef void (*glfwSwapBuffers_func)(GLFWwindow*);
 GFW_EXTERN glfwSwapBuffers_func glfwSwapBuffers_impl;
 #define glfwSwapBuffers glfwSwapBuffers_impl
 
+typedef void (*glfwSwapBuffersWithDamage_func)(GLFWwindow*, const int*, int);
+GFW_EXTERN glfwSwapBuffersWithDamage_func glfwSwapBuffersWithDamage_impl;
+#define glfwSwapBuffersWithDamage glfwSwapBuffersWithDamage_impl
+
 typedef void (*glfwSwapInterval_func)(int);
 GFW_EXTERN glfwSwapInterval_func glfwSwapInterval_impl;
 #define glfwSwapInterval glfwSwapInterval_impl
@@ -2346,6 +2350,10 @@ typedef void (*glfwRequestWaylandFrameEvent_func)(GLFWwindow*, unsigned long lon
 GFW_EXTERN glfwRequestWaylandFrameEvent_func glfwRequestWaylandFrameEvent_impl;
 #define glfwRequestWaylandFrameEvent glfwRequestWaylandFrameEvent_impl
 
+typedef bool (*glfwWaylandPresentationTiming_func)(GLFWwindow*, monotonic_t*, monotonic_t*);
+GFW_EXTERN glfwWaylandPresentationTiming_func glfwWaylandPresentationTiming_impl;
+#define glfwWaylandPresentationTiming glfwWaylandPresentationTiming_impl
+
 typedef void (*glfwWaylandActivateWindow_func)(GLFWwindow*, const char*);
 GFW_EXTERN glfwWaylandActivateWindow_func glfwWaylandActivateWindow_impl;
 #define glfwWaylandActivateWindow glfwWaylandActivateWindow_impl
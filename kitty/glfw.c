@@ -328,7 +328,11 @@ static void
 window_occlusion_callback(GLFWwindow *window, bool occluded) {
     if (!set_callback_window(window)) return;
     debug("OSWindow %llu occlusion state changed, occluded: %d\n", global_state.callback_os_window->id, occluded);
-    if (!occluded) global_state.check_for_active_animated_images = true;
+    if (!occluded) {
+        // nothing was rendered while occluded and the window contents may have been discarded
+        global_state.callback_os_window->needs_render = true;
+        global_state.check_for_active_animated_images = true;
+    }
     request_tick_callback();
     global_state.callback_os_window = NULL;
 }
@@ -336,7 +340,10 @@ window_occlusion_callback(GLFWwindow *window, bool occluded) {
 static void
 window_iconify_callback(GLFWwindow *window, int iconified) {
     if (!set_callback_window(window)) return;
-    if (!iconified) global_state.check_for_active_animated_images = true;
+    if (!iconified) {
+        global_state.callback_os_window->needs_render = true;
+        global_state.check_for_active_animated_images = true;
+    }
     request_tick_callback();
     global_state.callback_os_window = NULL;
 }
@@ -2082,9 +2089,12 @@ is_mouse_hidden(OSWindow *w) {
 void
 swap_window_buffers(OSWindow *os_window) {
     if (glfwAreSwapsAllowed(os_window->handle)) {
-        glfwSwapBuffers(os_window->handle);
+        if (!os_window->damage.full && os_window->damage.num_rects) glfwSwapBuffersWithDamage(os_window->handle, os_window->damage.rects, os_window->damage.num_rects);
+        else glfwSwapBuffers(os_window->handle);
         os_window->keep_rendering_till_swap = 0;
     }
+    // swaps not preceded by damage tracking in render_os_window() are full
+    os_window->damage.full = true; os_window->damage.num_rects = 0;
 }
 
 void
@@ -2339,6 +2349,12 @@ request_frame_render(OSWindow *w) {
     w->render_state = RENDER_FRAME_REQUESTED;
 }
 
+monotonic_t
+time_to_start_rendering(OSWindow *w UNUSED, monotonic_t now UNUSED) {
+    // the display link already calls back at the start of the refresh cycle
+    return -1;
+}
+
 static PyObject*
 py_recreate_global_menu(PyObject *self UNUSED, PyObject *args UNUSED) {
     cocoa_recreate_global_menu();
@@ -2364,6 +2380,24 @@ wayland_frame_request_callback(id_type os_window_id) {
     }
 }
 
+monotonic_t
+time_to_start_rendering(OSWindow *w, monotonic_t now) {
+    // Returns how long to wait so that rendering finishes just before the
+    // compositor needs the frame for the next refresh of the output. Waiting
+    // lets the frame include input that arrives in the meantime. Only done
+    // when frames have been presented recently, i.e. when rendering
+    // continuously, so that an idle kitty does not wake up every refresh.
+    // Returns a negative number when frames are not being paced.
+    monotonic_t last_presented_at, interval;
+    if (!global_state.is_wayland || !glfwWaylandPresentationTiming || !glfwWaylandPresentationTiming(w->handle, &last_presented_at, &interval)) return -1;
+    if (now < last_presented_at || now - last_presented_at > 4 * interval) return -1;
+    const monotonic_t next_refresh_at = last_presented_at + ((now - last_presented_at) / interval + 1) * interval;
+    // leave time for the GPU to finish and the compositor to composite
+    const monotonic_t margin = MAX(ms_to_monotonic_t(2ll), interval / 4);
+    const monotonic_t start_at = next_refresh_at - w->render_cost - margin;
+    return start_at > now ? start_at - now : 0;
+}
+
 void
 request_frame_render(OSWindow *w) {
     // Some Wayland compositors are too fragile to handle multiple
@@ -6,6 +6,11 @@
  */
 
 #include "glyph-cache.h"
+
+// There is no sub-pixel offset in the keys, cells always have an integer
+// size in pixels and the glyphs of a group are rendered aligned to the
+// cells of the group, so where a glyph is placed in its sprites is fully
+// determined by the glyphs, the number of cells and the scale fields.
 typedef struct SpritePosKey {
     glyph_index ligature_index, count, cell_count, keysz_in_bytes;
     uint8_t scale, subscale, multicell_y, vertical_align;
@@ -33,6 +38,20 @@ static_assert(MA_BLOCK_SIZE > sizeof(SpritePosKey) + 2, "increase arena block si
 
 #include "kitty-verstable.h"
 
+// Most sprites are for a single glyph in a single unscaled cell, these are
+// stored in a separate map keyed by an integer made from the glyph and the
+// scale fields, avoiding building, hashing and comparing a key in memory
+typedef union SingleGlyphKey {
+    struct { glyph_index glyph; uint8_t scale, subscale, multicell_y, vertical_align, u1, u2; };
+    uint64_t val;
+} SingleGlyphKey;
+static_assert(sizeof(SingleGlyphKey) == sizeof(uint64_t), "Fix the ordering of SingleGlyphKey");
+
+#define NAME single_glyph_map
+#define KEY_TY uint64_t
+#define VAL_TY SpritePosition*
+#include "kitty-verstable.h"
+
 static uint64_t
 sprite_pos_map_hash(const SpritePosKey *key) {
     return vt_hash_bytes(key, key->keysz_in_bytes + sizeof(SpritePosKey));
@@ -46,6 +65,7 @@ sprite_pos_map_cmpr(const SpritePosKey *a, const SpritePosKey *b) {
 
 typedef struct HashTable {
     sprite_pos_map table;
+    single_glyph_map single_glyphs;
     KeyMonotonicArena keys;
     ValMonotonicArena vals;
     struct { SpritePosKey *key; size_t capacity; } scratch;
@@ -54,7 +74,7 @@ typedef struct HashTable {
 SPRITE_POSITION_MAP_HANDLE
 create_sprite_position_hash_table(void) {
     HashTable *ans = calloc(1, sizeof(HashTable));
-    if (ans) vt_init(&ans->table);
+    if (ans) { vt_init(&ans->table); vt_init(&ans->single_glyphs); }
     return (SPRITE_POSITION_MAP_HANDLE)ans;
 }
 
@@ -64,6 +84,16 @@ find_or_create_sprite_position(
     uint8_t scale, uint8_t subscale, uint8_t multicell_y, uint8_t vertical_align, bool *created
 ) {
     HashTable *ht = (HashTable*)map_;
+    if (count == 1 && cell_count == 1 && ligature_index == 0) {
+        const SingleGlyphKey k = {.glyph=glyphs[0], .scale=scale, .subscale=subscale, .multicell_y=multicell_y, .vertical_align=vertical_align};
+        single_glyph_map_itr n = vt_get(&ht->single_glyphs, k.val);
+        if (!vt_is_end(n)) { *created = false; return n.data->val; }
+        SpritePosition *val = Val_get(&ht->vals, sizeof(SpritePosition));
+        if (!val) return NULL;
+        if (vt_is_end(vt_insert(&ht->single_glyphs, k.val, val))) return NULL;
+        *created = true;
+        return val;
+    }
     sprite_pos_map *map = &ht->table;
     const size_t keysz_in_bytes = count * sizeof(glyph_index);
     if (!ht->scratch.key || keysz_in_bytes > ht->scratch.capacity) {
@@ -92,11 +122,19 @@ find_or_create_sprite_position(
 #undef scratch
 }
 
+void
+mark_sprite_positions_as_not_rendered(SPRITE_POSITION_MAP_HANDLE map) {
+    HashTable *ht = (HashTable*)map;
+    vt_create_for_loop(sprite_pos_map_itr, i, &ht->table) i.data->val->rendered = false;
+    vt_create_for_loop(single_glyph_map_itr, i, &ht->single_glyphs) i.data->val->rendered = false;
+}
+
 void
 free_sprite_position_hash_table(SPRITE_POSITION_MAP_HANDLE *map) {
     HashTable **mapref = (HashTable**)map;
     if (*mapref) {
         vt_cleanup(&mapref[0]->table);
+        vt_cleanup(&mapref[0]->single_glyphs);
         Key_free_all(&mapref[0]->keys);
         Val_free_all(&mapref[0]->vals);
         free(mapref[0]->scratch.key);
@@ -11,6 +11,8 @@
 #include "disk-cache.h"
 #include "iqsort.h"
 #include "safe-wrappers.h"
+#include "threading.h"
+#include "simd-string.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -39,15 +41,54 @@ cache_key(const ImageAndFrame x, char *key) {
 }
 #define CK(x) key, cache_key(x, key)
 
+// Composing an animation frame needs the data of every frame in the chain of
+// frames it is based on to be read from the disk cache, so the most recently
+// composed frames are kept in memory, for looping animations. Since frames
+// can be based on any other frame of their image, any change to the data of
+// a frame drops all composed frames of its image.
+#define COMPOSED_FRAMES_SIZE_LIMIT (64u * 1024u * 1024u)
+
+typedef struct ComposedFrame {
+    ImageAndFrame key;
+    uint8_t *buf;
+    size_t sz;
+    bool is_4byte_aligned, is_opaque;
+    uint64_t last_used;
+} ComposedFrame;
+
+static void
+remove_composed_frame(GraphicsManager *self, size_t idx) {
+    ComposedFrame *cf = self->composed_frames.items + idx;
+    free(cf->buf);
+    self->composed_frames.total_sz -= cf->sz;
+    *cf = self->composed_frames.items[--self->composed_frames.count];
+}
+
+static void
+drop_composed_frames(GraphicsManager *self, id_type image_id) {
+    for (size_t i = self->composed_frames.count; i-- > 0;) {
+        if (self->composed_frames.items[i].key.image_id == image_id) remove_composed_frame(self, i);
+    }
+}
+
+static void
+free_composed_frames(GraphicsManager *self) {
+    while (self->composed_frames.count) remove_composed_frame(self, 0);
+    free(self->composed_frames.items);
+    zero_at_ptr(&self->composed_frames);
+}
+
 static bool
 add_to_cache(GraphicsManager *self, const ImageAndFrame x, const void *data, const size_t sz) {
     char key[CACHE_KEY_BUFFER_SIZE];
+    drop_composed_frames(self, x.image_id);
     return add_to_disk_cache(self->disk_cache, CK(x), data, sz);
 }
 
 static bool
 remove_from_cache(GraphicsManager *self, const ImageAndFrame x) {
     char key[CACHE_KEY_BUFFER_SIZE];
+    drop_composed_frames(self, x.image_id);
     return remove_from_disk_cache(self->disk_cache, CK(x));
 }
 
@@ -57,6 +98,12 @@ read_from_cache(const GraphicsManager *self, const ImageAndFrame x, void **data,
     return read_from_disk_cache_simple(self->disk_cache, CK(x), data, sz, false);
 }
 
+static void
+prefetch_from_cache(const GraphicsManager *self, const ImageAndFrame x) {
+    char key[CACHE_KEY_BUFFER_SIZE];
+    disk_cache_prefetch(self->disk_cache, CK(x));
+}
+
 static size_t
 cache_size(const GraphicsManager *self) { return disk_cache_total_size(self->disk_cache); }
 #undef CK
@@ -97,6 +144,137 @@ free_refs_data(Image *img) {
     vt_cleanup(&img->refs_by_internal_id);
 }
 
+// Placement index {{{
+// The placements of all images sorted by start row, so that scrolling,
+// clearing a range of rows and finding the visible placements only have to
+// look at the placements that intersect the affected rows. Placements
+// relative to a parent are kept separately as their position depends on the
+// parent, virtual placements are not indexed. When many placements change at
+// once the index is invalidated instead and rebuilt when next needed.
+
+static void
+placements_changed(GraphicsManager *self) { self->placements_generation++; }
+
+static void
+invalidate_placement_index(GraphicsManager *self) { self->placement_index.valid = false; placements_changed(self); }
+
+static void
+add_placement_index_entry(GraphicsManager *self, Image *img, ImageRef *ref) {
+    if (ref->parent.img) {
+        ensure_space_for(&self->placement_index.relative, items, PlacementIndexEntry, self->placement_index.relative.count + 1, capacity, 16, false);
+        self->placement_index.relative.items[self->placement_index.relative.count++] = (PlacementIndexEntry){.ref=ref, .img=img};
+    } else {
+        ensure_space_for(&self->placement_index.rows, items, PlacementIndexEntry, self->placement_index.rows.count + 1, capacity, 64, false);
+        self->placement_index.rows.items[self->placement_index.rows.count++] = (PlacementIndexEntry){.ref=ref, .img=img};
+        self->placement_index.max_num_rows = MAX(self->placement_index.max_num_rows, ref->effective_num_rows);
+    }
+}
+
+static void
+sort_placements(PlacementIndexEntry *items, size_t count) {
+#define lt(a, b) ((a)->ref->start_row < (b)->ref->start_row)
+    QSORT(PlacementIndexEntry, items, count, lt);
+#undef lt
+}
+
+static void
+ensure_placement_index(GraphicsManager *self) {
+    if (self->placement_index.valid) return;
+    self->placement_index.rows.count = 0; self->placement_index.relative.count = 0;
+    self->placement_index.max_num_rows = 0;
+    for (image_map_itr ii = vt_first(&self->images_by_internal_id); !vt_is_end(ii); ii = vt_next(ii)) {
+        Image *img = ii.data->val;
+        iter_refs(img) if (!i.data->val->is_virtual_ref) add_placement_index_entry(self, img, i.data->val);
+    }
+    sort_placements(self->placement_index.rows.items, self->placement_index.rows.count);
+    self->placement_index.valid = true;
+}
+
+static size_t
+first_placement_starting_at_or_after(const GraphicsManager *self, int64_t row) {
+    const PlacementIndexEntry *items = self->placement_index.rows.items;
+    size_t lo = 0, hi = self->placement_index.rows.count;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (items[mid].ref->start_row < row) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static size_t
+first_placement_reaching(const GraphicsManager *self, int32_t row) {
+    // The first placement in the rows index that could extend down to row
+    return first_placement_starting_at_or_after(self, (int64_t)row - (int64_t)self->placement_index.max_num_rows + 1);
+}
+
+static void
+placement_index_add(GraphicsManager *self, Image *img, ImageRef *ref) {
+    placements_changed(self);
+    if (!self->placement_index.valid || ref->is_virtual_ref) return;
+    if (ref->parent.img) { add_placement_index_entry(self, img, ref); return; }
+    const size_t pos = first_placement_starting_at_or_after(self, (int64_t)ref->start_row + 1);
+    add_placement_index_entry(self, img, ref);
+    // move the new entry from the end to its sorted position
+    PlacementIndexEntry *items = self->placement_index.rows.items;
+    const size_t last = self->placement_index.rows.count - 1;
+    if (pos < last) {
+        const PlacementIndexEntry e = items[last];
+        memmove(items + pos + 1, items + pos, (last - pos) * sizeof(items[0]));
+        items[pos] = e;
+    }
+}
+
+static void
+placement_index_remove(GraphicsManager *self, const ImageRef *ref) {
+    placements_changed(self);
+    if (!self->placement_index.valid || ref->is_virtual_ref) return;
+    if (ref->parent.img) {
+        PlacementIndexEntry *items = self->placement_index.relative.items;
+        for (size_t k = 0; k < self->placement_index.relative.count; k++) {
+            if (items[k].ref == ref) {
+                items[k] = items[--self->placement_index.relative.count];
+                return;
+            }
+        }
+    } else {
+        PlacementIndexEntry *items = self->placement_index.rows.items;
+        const size_t count = self->placement_index.rows.count;
+        for (size_t k = first_placement_starting_at_or_after(self, ref->start_row); k < count && items[k].ref->start_row == ref->start_row; k++) {
+            if (items[k].ref == ref) {
+                memmove(items + k, items + k + 1, (count - k - 1) * sizeof(items[0]));
+                self->placement_index.rows.count--;
+                return;
+            }
+        }
+    }
+    // the placement was moved without updating the index
+    invalidate_placement_index(self);
+}
+
+static void
+placement_index_remove_image(GraphicsManager *self, const Image *img) {
+    placements_changed(self);
+    if (!self->placement_index.valid || !vt_size(&img->refs_by_internal_id)) return;
+    size_t w = 0;
+    for (size_t k = 0; k < self->placement_index.rows.count; k++) {
+        if (self->placement_index.rows.items[k].img != img) self->placement_index.rows.items[w++] = self->placement_index.rows.items[k];
+    }
+    self->placement_index.rows.count = w;
+    w = 0;
+    for (size_t k = 0; k < self->placement_index.relative.count; k++) {
+        if (self->placement_index.relative.items[k].img != img) self->placement_index.relative.items[w++] = self->placement_index.relative.items[k];
+    }
+    self->placement_index.relative.count = w;
+}
+
+static void
+free_placement_index(GraphicsManager *self) {
+    free(self->placement_index.rows.items); free(self->placement_index.relative.items);
+    zero_at_ptr(&self->placement_index);
+}
+// }}}
+
 static void
 free_load_data(LoadData *ld) {
     free(ld->buf); ld->buf_used = 0; ld->buf_capacity = 0; ld->buf = NULL;
@@ -105,11 +283,42 @@ free_load_data(LoadData *ld) {
     ld->loading_for = (const ImageAndFrame){0};
 }
 
+// Textures of identical images, keyed by a hash of their pixels and size.
+// All OS windows share textures, so the same image transmitted into many
+// windows, such as a logo in every shell prompt, is uploaded only once.
+#define NAME shared_texture_map
+#define KEY_TY uint64_t
+#define VAL_TY TextureRef*
+#include "kitty-verstable.h"
+static shared_texture_map shared_textures;
+static bool shared_textures_initialized = false;
+// total size of all image textures not in atlases, see grman_apply_texture_budget()
+static size_t image_texture_bytes = 0;
+
+static void
+set_texture_size(TextureRef *t, const size_t sz) {
+    image_texture_bytes = image_texture_bytes - t->gpu_sz + sz;
+    t->gpu_sz = sz;
+}
+
+static void
+unshare_texture_ref(TextureRef *t) {
+    if (t->content_hash) {
+        shared_texture_map_itr i = vt_get(&shared_textures, t->content_hash);
+        if (!vt_is_end(i) && i.data->val == t) vt_erase_itr(&shared_textures, i);
+        t->content_hash = 0;
+        Py_CLEAR(t->shared_from.disk_cache);
+    }
+}
+
 static void*
 clear_texture_ref(TextureRef **x) {
     if (*x) {
         if ((*x)->refcnt < 2) {
-            if ((*x)->id) free_texture(&(*x)->id);
+            unshare_texture_ref(*x);
+            set_texture_size(*x, 0);
+            if ((*x)->in_atlas) free_atlas_slot(&(*x)->atlas_slot);
+            else if ((*x)->id) free_texture(&(*x)->id);
             free(*x); *x = NULL;
         } else (*x)->refcnt--;
     }
@@ -138,6 +347,7 @@ texture_id_for_img(Image *img) {
 static void
 free_image_resources(GraphicsManager *self, Image *img) {
     clear_texture_ref(&img->texture);
+    drop_composed_frames(self, img->internal_id);
     if (self->disk_cache) {
         ImageAndFrame key = { .image_id=img->internal_id, .frame_id = img->root_frame.id };
         if (!remove_from_cache(self, key) && PyErr_Occurred()) PyErr_Print();
@@ -150,6 +360,7 @@ free_image_resources(GraphicsManager *self, Image *img) {
         free(img->extra_frames);
         img->extra_frames = NULL;
     }
+    placement_index_remove_image(self, img);
     free_refs_data(img);
     self->used_storage = img->used_storage <= self->used_storage ? self->used_storage - img->used_storage : 0;
 }
@@ -164,13 +375,19 @@ free_image(GraphicsManager *self, Image *img) {
 
 static void
 free_all_images(GraphicsManager *self) {
+    invalidate_placement_index(self);
     iter_images(self) free_image(self, i.data->val);
     vt_cleanup(&self->images_by_internal_id);
 }
 
+static void free_background_decodes(GraphicsManager *self);
+
 static void
 dealloc(GraphicsManager* self) {
+    free_background_decodes(self);
     free_all_images(self);
+    free_composed_frames(self);
+    free_placement_index(self);
     free(self->render_data.item);
     Py_CLEAR(self->disk_cache);
     Py_TYPE(self)->tp_free((PyObject*)self);
@@ -256,6 +473,7 @@ grman_pause_rendering(GraphicsManager *self, GraphicsManager *dest) {
         memset(&clone->refs_by_internal_id, 0, sizeof(clone->refs_by_internal_id));
         vt_init(&clone->refs_by_internal_id);
         clone->extra_frames = NULL;
+        clone->drawn_in_layers_update = 0;
         iter_refs(img) {
             ImageRef *cr = malloc(sizeof(ImageRef));
             if (cr) {
@@ -293,7 +511,8 @@ apply_storage_quota(GraphicsManager *self, size_t storage_limit, id_type current
     if (!num_images || !vt_size(&self->images_by_internal_id)) self->used_storage = 0;  // sanity check
 }
 
-static char command_response[512] = {0};
+// thread local as images are also decoded in worker threads, see start_background_decode()
+static _Thread_local char command_response[512] = {0};
 
 static void
 set_command_failed_response(const char *code, const char *fmt, ...) {
@@ -510,6 +729,7 @@ find_or_create_image(GraphicsManager *self, uint32_t id, bool *existing) {
     ans->texture = new_texture_ref();
     vt_init(&ans->refs_by_internal_id);
     if (vt_is_end(vt_insert(&self->images_by_internal_id, ans->internal_id, ans))) fatal("Out of memory");
+    self->may_have_orphaned_images = true;
     return ans;
 }
 
@@ -702,13 +922,163 @@ upload_to_gpu(GraphicsManager *self, Image *img, const bool is_opaque, const boo
         if (!make_window_context_current(self->window_id)) return;
         self->context_made_current_for_this_command = true;
     }
-    if (img->texture) {
-        send_image_to_gpu(&img->texture->id, data, img->width, img->height, is_opaque, is_4byte_aligned, true, REPEAT_CLAMP);
+    TextureRef *t = img->texture;
+    if (!t) return;
+    if (t->content_hash) {
+        // the texture is about to be changed so it can no longer be shared
+        if (t->refcnt > 1) { clear_texture_ref(&img->texture); t = img->texture = new_texture_ref(); }
+        else unshare_texture_ref(t);
+    }
+    t->evicted = false;
+    // Whether the image goes into an atlas is decided when it is first
+    // uploaded, later uploads of other frames use the same texture
+    if (!t->id || t->in_atlas) {
+        if ((t->in_atlas = send_image_to_atlas(&t->atlas_slot, data, img->width, img->height, is_opaque, is_4byte_aligned))) {
+            t->id = t->atlas_slot.texture_id;
+            set_texture_size(t, 0);
+            return;
+        }
     }
+    send_image_to_gpu(&t->id, data, img->width, img->height, is_opaque, is_4byte_aligned, true, REPEAT_CLAMP);
+    if (t->has_mipmaps) generate_mipmaps(t->id);
+    set_texture_size(t, (size_t)img->width * img->height * 4);
+}
+
+static bool
+is_same_as_shared_texture(const TextureRef *t, const Image *img, const bool is_opaque, const bool is_4byte_aligned, const uint8_t *data, const size_t sz) {
+    // A hash match alone is not proof that the images are identical, so the
+    // data the texture was uploaded from is read back and compared
+    if (t->shared_from.sz != sz || t->shared_from.width != img->width || t->shared_from.height != img->height || t->shared_from.is_opaque != is_opaque || t->shared_from.is_4byte_aligned != is_4byte_aligned) return false;
+    char key[CACHE_KEY_BUFFER_SIZE];
+    void *cached = NULL; size_t cached_sz = 0;
+    if (!read_from_disk_cache_simple(t->shared_from.disk_cache, key, cache_key(t->shared_from.key, key), &cached, &cached_sz, false)) {
+        // the image the texture was uploaded for has been deleted or changed
+        PyErr_Clear();
+        return false;
+    }
+    const bool ans = cached_sz == sz && memcmp(cached, data, sz) == 0;
+    free(cached);
+    return ans;
+}
+
+static void
+upload_root_frame_to_gpu(GraphicsManager *self, Image *img, const bool is_opaque, const bool is_4byte_aligned, const uint8_t *data, const size_t sz) {
+    if (img->root_frame.is_ephemeral || !img->texture) { upload_to_gpu(self, img, is_opaque, is_4byte_aligned, data); return; }
+    if (!shared_textures_initialized) { vt_init(&shared_textures); shared_textures_initialized = true; }
+    uint64_t h = XXH3_64bits_withSeed(data, sz, ((uint64_t)img->width << 32) | img->height);
+    if (!h) h = 1;
+    shared_texture_map_itr i = vt_get(&shared_textures, h);
+    if (!vt_is_end(i) && is_same_as_shared_texture(i.data->val, img, is_opaque, is_4byte_aligned, data, sz)) {
+        clear_texture_ref(&img->texture);
+        img->texture = incref_texture_ref(i.data->val);
+        return;
+    }
+    upload_to_gpu(self, img, is_opaque, is_4byte_aligned, data);
+    TextureRef *t = img->texture;
+    if (t && t->id && !t->content_hash && vt_is_end(i) && !vt_is_end(vt_insert(&shared_textures, h, t))) {
+        t->content_hash = h;
+        t->shared_from.disk_cache = Py_NewRef(self->disk_cache);
+        t->shared_from.key = (ImageAndFrame){.image_id=img->internal_id, .frame_id=img->root_frame.id};
+        t->shared_from.sz = sz; t->shared_from.width = img->width; t->shared_from.height = img->height;
+        t->shared_from.is_opaque = is_opaque; t->shared_from.is_4byte_aligned = is_4byte_aligned;
+    }
+}
+
+// Background decoding {{{
+// Decoding a large PNG can take hundreds of milliseconds, freezing every
+// window, so once all its data has been received it is decoded in a worker
+// thread. The image and its placements are created immediately, so that
+// the cursor moves and later commands can refer to it, but it is not drawn
+// until its data is available. The response to the transmit command is sent
+// when decoding finishes, see grman_finish_background_decodes().
+
+#define BACKGROUND_DECODE_MIN_SIZE (256u * 1024u)
+#define MAX_BACKGROUND_DECODES 4u
+
+typedef struct BackgroundDecode {
+    struct BackgroundDecode *next;
+    pthread_t thread;
+    uint64_t id;
+    id_type image_id;
+    uint32_t width, height;
+    LoadData load_data;
+    GraphicsCommand command;
+    bool ok, done, wakeup_main_loop;
+    char error[sizeof(command_response)];
+} BackgroundDecode;
+
+static unsigned num_background_decodes = 0;
+static uint64_t background_decode_id_counter = 0;
+
+static bool
+png_dimensions(const uint8_t *buf, size_t sz, uint32_t *width, uint32_t *height) {
+    // The IHDR chunk must be the first chunk after the signature
+    static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (sz < 24 || memcmp(buf, signature, sizeof(signature)) != 0 || memcmp(buf + 12, "IHDR", 4) != 0) return false;
+#define be32(p) (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+    *width = be32(buf + 16); *height = be32(buf + 20);
+#undef be32
+    return *width && *height;
+}
+
+static void*
+background_decode_thread(void *x) {
+    BackgroundDecode *d = x;
+    set_thread_name("KittyImgDecode");
+    command_response[0] = 0;
+    LoadData *ld = &d->load_data;
+    uint8_t *buf = ld->buf ? ld->buf : ld->mapped_file;
+    const size_t bufsz = ld->buf ? ld->buf_used : ld->mapped_file_sz;
+    d->ok = inflate_png(ld, buf, bufsz);
+    if (d->ok && (ld->width != d->width || ld->height != d->height || ld->data_sz != (size_t)4 * ld->width * ld->height)) {
+        set_command_failed_response("EINVAL", "Image dimensions: %ux%u do not match data size: %zu", ld->width, ld->height, ld->data_sz);
+        d->ok = false;
+    }
+    if (d->ok) ld->data = ld->buf;
+    memcpy(d->error, command_response, sizeof(d->error));
+    const bool wakeup = d->wakeup_main_loop;
+    __atomic_store_n(&d->done, true, __ATOMIC_RELEASE);
+    if (wakeup) wakeup_main_loop();
+    return NULL;
+}
+
+static bool
+start_background_decode(GraphicsManager *self, Image *img, const GraphicsCommand *g, const uint32_t data_fmt, const uint32_t quiet) {
+    // Windowless graphics managers, as used in the tests, have no main loop to wake up
+    if ((!self->window_id && !self->background_decodes_without_window) || data_fmt != PNG || g->compressed || num_background_decodes >= MAX_BACKGROUND_DECODES) return false;
+    LoadData *ld = &self->currently_loading;
+    const uint8_t *buf = ld->buf ? ld->buf : ld->mapped_file;
+    const size_t bufsz = ld->buf ? ld->buf_used : ld->mapped_file_sz;
+    uint32_t width, height;
+    if (bufsz < BACKGROUND_DECODE_MIN_SIZE || !png_dimensions(buf, bufsz, &width, &height)) return false;
+    BackgroundDecode *d = calloc(1, sizeof(BackgroundDecode));
+    if (!d) return false;
+    d->id = ++background_decode_id_counter; d->image_id = img->internal_id;
+    d->width = width; d->height = height; d->wakeup_main_loop = self->window_id != 0;
+    d->load_data = *ld;
+    d->command = ld->start_command;
+    if (quiet) d->command.quiet = quiet;
+    if (pthread_create(&d->thread, NULL, background_decode_thread, d) != 0) { free(d); return false; }
+    // the buffers are now owned by the worker
+    ld->buf = NULL; ld->buf_used = 0; ld->buf_capacity = 0; ld->mapped_file = NULL; ld->mapped_file_sz = 0;
+    num_background_decodes++;
+    d->next = self->background_decodes; self->background_decodes = d;
+    self->decode_started_for_this_command = true;
+    img->pending_decode = d->id;
+    img->width = width; img->height = height;
+    if (img->root_frame.id) remove_from_cache(self, (const ImageAndFrame){.image_id=img->internal_id, .frame_id=img->root_frame.id});
+    img->root_frame = (const Frame){
+        .id = ++img->frame_id_counter, .is_opaque = false, .is_4byte_aligned = true, .width = width, .height = height,
+        .is_ephemeral = ld->start_command.ephemeral,
+    };
+    img->root_frame_data_loaded = true;
+    return true;
 }
+// }}}
 
 static Image*
 handle_add_command(GraphicsManager *self, const GraphicsCommand *g, const uint8_t *payload, bool *is_dirty, uint32_t iid, bool is_query) {
+    const uint32_t quiet = g->quiet;
     bool existing, init_img = true;
     Image *img = NULL;
     unsigned char tt = g->transmission_type ? g->transmission_type : 'd';
@@ -723,9 +1093,10 @@ handle_add_command(GraphicsManager *self, const GraphicsCommand *g, const uint8_
             free_image_resources(self, img);
             img->texture = new_texture_ref();
             img->root_frame_data_loaded = false;
-            img->is_drawn = false;
+            img->drawn_in_layers_update = 0;
             img->current_frame_shown_at = 0;
             img->extra_framecnt = 0;
+            img->pending_decode = 0;
             *is_dirty = true;
             set_layers_dirty(self);
         } else {
@@ -750,6 +1121,7 @@ handle_add_command(GraphicsManager *self, const GraphicsCommand *g, const uint8_
     img = load_image_data(self, img, g, tt, fmt, payload);
     if (!img || !self->currently_loading.loading_completed_successfully) return NULL;
         self->currently_loading.loading_for = (const ImageAndFrame){0};
+    if (!is_query && start_background_decode(self, img, g, fmt, quiet)) return img;
     img = process_image_data(self, img, g, tt, fmt);
     if (!img) return NULL;
     size_t required_sz = (size_t)(self->currently_loading.is_opaque ? 3 : 4) * self->currently_loading.width * self->currently_loading.height;
@@ -763,13 +1135,16 @@ handle_add_command(GraphicsManager *self, const GraphicsCommand *g, const uint8_
             .is_opaque = self->currently_loading.is_opaque,
             .is_4byte_aligned = self->currently_loading.is_4byte_aligned,
             .width = img->width, .height = img->height,
+            .is_ephemeral = self->currently_loading.start_command.ephemeral,
         };
         if (!is_query) {
-            if (!add_to_cache(self, (const ImageAndFrame){.image_id = img->internal_id, .frame_id=img->root_frame.id}, self->currently_loading.data, self->currently_loading.data_sz)) {
+            // ephemeral images, such as video frames, are uploaded straight
+            // from the transmitted data, without a copy in the disk cache
+            if (!img->root_frame.is_ephemeral && !add_to_cache(self, (const ImageAndFrame){.image_id = img->internal_id, .frame_id=img->root_frame.id}, self->currently_loading.data, self->currently_loading.data_sz)) {
                 if (PyErr_Occurred()) PyErr_Print();
                 ABRT("ENOSPC", "Failed to store image data in disk cache");
             }
-            upload_to_gpu(self, img, img->root_frame.is_opaque, img->root_frame.is_4byte_aligned, self->currently_loading.data);
+            upload_root_frame_to_gpu(self, img, img->root_frame.is_opaque, img->root_frame.is_4byte_aligned, self->currently_loading.data, required_sz);
             self->used_storage += required_sz;
             img->used_storage = required_sz;
         }
@@ -807,6 +1182,111 @@ finish_command_response(const GraphicsCommand *g, bool data_loaded) {
 
 // }}}
 
+// Finishing background decodes {{{
+static void
+finish_background_decode(GraphicsManager *self, BackgroundDecode *d, bool *is_dirty, grman_response_callback callback, void *data) {
+    pthread_join(d->thread, NULL);
+    num_background_decodes--;
+    Image *img = img_by_internal_id(self, d->image_id);
+    // the image may have been deleted or transmitted again in the meantime
+    if (img && img->pending_decode == d->id) {
+        img->pending_decode = 0;
+        memcpy(command_response, d->error, sizeof(command_response));
+        bool ok = d->ok;
+        const size_t required_sz = d->load_data.data_sz;
+        if (ok && !img->root_frame.is_ephemeral && !add_to_cache(self, (const ImageAndFrame){.image_id = img->internal_id, .frame_id=img->root_frame.id}, d->load_data.data, required_sz)) {
+            if (PyErr_Occurred()) PyErr_Print();
+            set_command_failed_response("ENOSPC", "Failed to store image data in disk cache");
+            ok = false;
+        }
+        if (ok) {
+            self->context_made_current_for_this_command = false;
+            upload_root_frame_to_gpu(self, img, false, true, d->load_data.data, required_sz);
+            self->used_storage += required_sz;
+            img->used_storage = required_sz;
+        } else remove_image(self, img);
+        *is_dirty = true;
+        set_layers_dirty(self);
+        const char *response = finish_command_response(&d->command, ok);
+        if (response) callback(data, response, d->id);
+        command_response[0] = 0;
+        if (self->used_storage > self->storage_limit) apply_storage_quota(self, self->storage_limit, ok ? d->image_id : 0);
+    }
+    free_load_data(&d->load_data);
+    free(d);
+}
+
+bool
+grman_finish_background_decodes(GraphicsManager *self, bool wait, bool *is_dirty, grman_response_callback callback, void *data) {
+    // Decodes are finished in the order they were started so that responses are in order
+    bool finished = false;
+    while (self->background_decodes) {
+        BackgroundDecode **oldest = &self->background_decodes;
+        while ((*oldest)->next) oldest = &(*oldest)->next;
+        BackgroundDecode *d = *oldest;
+        if (!wait && !__atomic_load_n(&d->done, __ATOMIC_ACQUIRE)) break;
+        *oldest = NULL;
+        finish_background_decode(self, d, is_dirty, callback, data);
+        finished = true;
+    }
+    return finished;
+}
+
+static void
+free_background_decodes(GraphicsManager *self) {
+    while (self->background_decodes) {
+        BackgroundDecode *d = self->background_decodes;
+        self->background_decodes = d->next;
+        pthread_join(d->thread, NULL);
+        num_background_decodes--;
+        free_load_data(&d->load_data);
+        free(d);
+    }
+}
+
+bool
+grman_has_background_decodes(GraphicsManager *self) { return self->background_decodes != NULL; }
+
+uint64_t
+grman_background_decodes(GraphicsManager *self, uint64_t *oldest) {
+    // Returns the id of the most recently started pending decode, zero if
+    // there are none. Ids increase across all graphics managers.
+    *oldest = 0;
+    if (!self->background_decodes) return 0;
+    const BackgroundDecode *d = self->background_decodes;
+    while (d->next) d = d->next;
+    *oldest = d->id;
+    return self->background_decodes->id;
+}
+
+GraphicsMemoryUsage
+grman_memory_usage(GraphicsManager *self) {
+    GraphicsMemoryUsage ans = {
+        .in_ram=disk_cache_size_in_ram(self->disk_cache), .on_disk=disk_cache_size_on_disk(self->disk_cache),
+        .composed_frames=self->composed_frames.total_sz,
+    };
+    iter_images(self) {
+        const Image *img = i.data->val;
+        if (img->texture && img->texture->id) {
+            size_t sz = (size_t)img->width * img->height * 4;
+            // mipmaps add a third
+            if (img->texture->has_mipmaps) sz += sz / 3;
+            ans.textures += sz;
+        }
+    }
+    return ans;
+}
+
+bool
+grman_command_needs_image_data(const GraphicsCommand *g) {
+    // Commands that read the data of existing images must wait for it to be decoded
+    switch (g->action) {
+        case 'f': case 'a': case 'c': return true;
+        default: return false;
+    }
+}
+// }}}
+
 // Displaying images {{{
 
 static void
@@ -1021,10 +1501,11 @@ void grman_put_cell_image(GraphicsManager *self, uint32_t screen_row,
 
     update_src_rect(real_ref, img);
     update_dest_rect(real_ref, ref.num_cols, ref.num_rows, cell);
+    placement_index_add(self, img, real_ref);
 }
 
-static void remove_ref(Image *img, ImageRef *ref);
-static ref_map_itr remove_ref_itr(Image *img, ref_map_itr x);
+static void remove_ref(GraphicsManager *self, Image *img, ImageRef *ref);
+static ref_map_itr remove_ref_itr(GraphicsManager *self, Image *img, ref_map_itr x);
 
 static bool
 has_good_ancestry(GraphicsManager *self, ImageRef *ref) {
@@ -1108,6 +1589,7 @@ handle_put_command(GraphicsManager *self, const GraphicsCommand *g, Cursor *c, b
         }
     }
     if (ref == NULL) ref = create_ref(img, NULL);
+    else placement_index_remove(self, ref);
 
     *is_dirty = true;
     set_layers_dirty(self);
@@ -1132,9 +1614,11 @@ handle_put_command(GraphicsManager *self, const GraphicsCommand *g, Cursor *c, b
         ref->is_virtual_ref = true;
         ref->start_row = ref->start_column = 0;
     }
+    placement_index_add(self, img, ref);
     if (ref->parent.img) {
         if (!has_good_ancestry(self, ref)) {
-            remove_ref(img, ref);
+            placement_index_remove(self, ref);
+            remove_ref(self, img, ref);
             return g->id;
         }
     } else {
@@ -1171,13 +1655,22 @@ resolve_cell_ref(const Image *img, id_type virt_ref_id, int32_t *start_row, int3
 }
 
 static bool
-resolve_parent_offset(const GraphicsManager *self, const ImageRef *ref, int32_t *start_row, int32_t *start_column, bool *has_virtual_ancestor) {
-    *start_row = 0; *start_column = 0; *has_virtual_ancestor = false;
+walk_ancestors(const GraphicsManager *self, const ImageRef *ref, int32_t *start_row, int32_t *start_column, bool *has_virtual_ancestor, unsigned *depth) {
+    *start_row = 0; *start_column = 0; *has_virtual_ancestor = false; *depth = 0;
+    const ImageRef *first = ref;
     int32_t x = 0, y = 0;
-    unsigned depth = 0;
     ImageRef cell_ref = {0};
     while (ref->parent.img) {
-        if (depth++ >= PARENT_DEPTH_LIMIT) return false;  // either a cycle or too many ancestors
+        if (ref != first && ref->resolved.generation == self->placements_generation) {
+            // an ancestor that has already been resolved since the placements last changed
+            *depth += ref->resolved.depth;
+            *has_virtual_ancestor |= ref->resolved.has_virtual_ancestor;
+            if (!ref->resolved.ok || *depth > PARENT_DEPTH_LIMIT) return false;
+            *start_row = ref->resolved.start_row + y;
+            *start_column = ref->resolved.start_column + x;
+            return true;
+        }
+        if ((*depth)++ >= PARENT_DEPTH_LIMIT) return false;  // either a cycle or too many ancestors
         Image *img = img_by_internal_id(self, ref->parent.img);
         if (!img) return false;
         ImageRef *parent = ref_by_internal_id(img, ref->parent.ref);
@@ -1196,6 +1689,114 @@ resolve_parent_offset(const GraphicsManager *self, const ImageRef *ref, int32_t
     return true;
 }
 
+static bool
+resolve_parent_offset(const GraphicsManager *self, ImageRef *ref, int32_t *start_row, int32_t *start_column, bool *has_virtual_ancestor) {
+    // Layouts built from nested relative placements would otherwise walk the
+    // chain of ancestors of every placement whenever the layers are updated,
+    // which includes every scroll of the view, so the result is cached until
+    // some placement changes.
+    if (ref->resolved.generation != self->placements_generation) {
+        ref->resolved.ok = walk_ancestors(self, ref, &ref->resolved.start_row, &ref->resolved.start_column, &ref->resolved.has_virtual_ancestor, &ref->resolved.depth);
+        ref->resolved.generation = self->placements_generation;
+    }
+    *start_row = ref->resolved.start_row; *start_column = ref->resolved.start_column;
+    *has_virtual_ancestor = ref->resolved.has_virtual_ancestor;
+    return ref->resolved.ok;
+}
+
+
+typedef struct LayersGeometry {
+    float screen_left, screen_top, screen_bottom, screen_width, screen_height, screen_width_px, screen_height_px;
+    float y0, dx, dy;
+    CellPixelSize cell;
+} LayersGeometry;
+
+static void
+add_render_data_for_ref(GraphicsManager *self, Image *img, const ImageRef *ref, int32_t start_row, int32_t start_column, const LayersGeometry *g) {
+    const float y0 = g->y0, dx = g->dx, dy = g->dy, screen_left = g->screen_left;
+    const float screen_width = g->screen_width, screen_height = g->screen_height, screen_width_px = g->screen_width_px, screen_height_px = g->screen_height_px;
+    ImageRect r;
+    r.top = y0 - start_row * dy - dy * (float)ref->cell_y_offset / (float)g->cell.height;
+    r.left = screen_left + start_column * dx + dx * (float)ref->cell_x_offset / (float)g->cell.width;
+
+    int32_t nr = ref->num_rows, nc = ref->num_cols;
+    if (nr) {
+        r.bottom = y0 - (start_row + nr) * dy;
+        if (nc) r.right = screen_left + (start_column + nc) * dx;
+        else {
+            double height_px = (((double)r.top - r.bottom) / screen_height) * screen_height_px;
+            double width_px = height_px * ref->src_width / (double) ref->src_height;
+            r.right = r.left + (float)((width_px / screen_width_px) * screen_width);
+        }
+    } else {
+        if (nc) r.right = screen_left + (start_column + nc) * dx;
+        else r.right = r.left + screen_width * (float)ref->src_width / screen_width_px;
+        double width_px = (((double)r.right - r.left) / screen_width) * screen_width_px;
+        double height_px = width_px * ref->src_height / (double)ref->src_width;
+        r.bottom = r.top - (float)((height_px / screen_height_px) * screen_height);
+    }
+
+    if (r.top <= g->screen_bottom || r.bottom >= g->screen_top) return;  // not visible
+    if (img->texture && !img->texture->in_atlas && !img->texture->has_mipmaps) {
+        // Sampling an image drawn at less than half its size reads many texels
+        // per pixel and aliases, use mipmaps for it instead
+        const float width_px = (r.right - r.left) / screen_width * screen_width_px, height_px = (r.top - r.bottom) / screen_height * screen_height_px;
+        if (2.f * width_px < ref->src_width && 2.f * height_px < ref->src_height) self->textures_want_mipmaps = img->texture->wants_mipmaps = true;
+    }
+
+    if (ref->z_index < ((int32_t)INT32_MIN/2))
+        self->num_of_below_refs++;
+    else if (ref->z_index < 0)
+        self->num_of_negative_refs++;
+    else
+        self->num_of_positive_refs++;
+    ensure_space_for(&(self->render_data), item, ImageRenderData, self->render_data.count + 1, capacity, 64, true);
+    ImageRenderData *rd = self->render_data.item + self->render_data.count;
+    zero_at_ptr(rd);
+    rd->dest_rect = r; rd->src_rect = ref->src_rect;
+    if (img->texture && img->texture->in_atlas) {
+        const ImageAtlasSlot *a = &img->texture->atlas_slot;
+        const float w = a->right - a->left, h = a->bottom - a->top;
+        rd->src_rect.left = a->left + w * ref->src_rect.left; rd->src_rect.right = a->left + w * ref->src_rect.right;
+        rd->src_rect.top = a->top + h * ref->src_rect.top; rd->src_rect.bottom = a->top + h * ref->src_rect.bottom;
+    }
+    self->render_data.count++;
+    rd->z_index = ref->z_index; rd->image_id = img->internal_id; rd->ref_id = ref->internal_id;
+    rd->texture_id = texture_id_for_img(img);
+    if (img->texture && img->texture->evicted) self->textures_need_reload = true;
+    if (img->drawn_in_layers_update != self->layers_update_count) {
+        const bool was_drawn = img->drawn_in_layers_update && img->drawn_in_layers_update == self->layers_update_count - 1;
+        img->drawn_in_layers_update = self->layers_update_count;
+        if (!was_drawn && img->animation_state != ANIMATION_STOPPED && img->extra_framecnt && img->animation_duration) {
+            self->has_images_needing_animation = true;
+            self->next_animation_frame_at = 0;
+            global_state.check_for_active_animated_images = true;
+        }
+    }
+}
+
+static void reload_evicted_textures(GraphicsManager *self);
+
+void
+grman_generate_mipmaps(GraphicsManager *self) {
+    // Called with the OpenGL context current after the layers are updated
+    if (self->textures_need_reload) {
+        self->textures_need_reload = false;
+        reload_evicted_textures(self);
+    }
+    if (!self->textures_want_mipmaps) return;
+    self->textures_want_mipmaps = false;
+    for (size_t i = 0; i < self->render_data.count; i++) {
+        Image *img = img_by_internal_id(self, self->render_data.item[i].image_id);
+        if (img && img->texture && img->texture->wants_mipmaps) {
+            img->texture->wants_mipmaps = false;
+            if (img->texture->id) {
+                generate_mipmaps(img->texture->id);
+                img->texture->has_mipmaps = true;
+            }
+        }
+    }
+}
 
 bool
 grman_update_layers(GraphicsManager *self, unsigned int scrolled_by, float screen_left, float screen_top, float dx, float dy, unsigned int num_cols, unsigned int num_rows, CellPixelSize cell) {
@@ -1207,82 +1808,40 @@ grman_update_layers(GraphicsManager *self, unsigned int scrolled_by, float scree
     self->num_of_below_refs = 0;
     self->num_of_negative_refs = 0;
     self->num_of_positive_refs = 0;
-    ImageRect r;
-    float screen_width = dx * num_cols, screen_height = dy * num_rows;
-    float screen_bottom = screen_top - screen_height;
-    float screen_width_px = num_cols * cell.width;
-    float screen_height_px = num_rows * cell.height;
-    float y0 = screen_top - dy * scrolled_by;
+    LayersGeometry g = {
+        .screen_left=screen_left, .screen_top=screen_top, .screen_width=dx * num_cols, .screen_height=dy * num_rows,
+        .screen_width_px=num_cols * cell.width, .screen_height_px=num_rows * cell.height,
+        .y0=screen_top - dy * scrolled_by, .dx=dx, .dy=dy, .cell=cell,
+    };
+    g.screen_bottom = screen_top - g.screen_height;
 
-    // Iterate over all visible refs and create render data
     self->render_data.count = 0;
-
-    for (image_map_itr imgitr = vt_first(&self->images_by_internal_id); !vt_is_end(imgitr); ) {
-        Image *img = imgitr.data->val;
-        bool was_drawn = img->is_drawn, ref_removed = false;
-        img->is_drawn = false;
-
-        for (ref_map_itr refitr = vt_first(&img->refs_by_internal_id); !vt_is_end(refitr); ) {
-            ImageRef *ref = refitr.data->val;
-            if (ref->is_virtual_ref) { refitr = vt_next(refitr); continue; }
-            int32_t start_row = ref->start_row, start_column = ref->start_column;
-            if (ref->parent.img) {
-                bool has_virtual_ancestor;
-                if (!resolve_parent_offset(self, ref, &start_row, &start_column, &has_virtual_ancestor)) {
-                    if (!has_virtual_ancestor) {
-                        refitr = remove_ref_itr(img, refitr);
-                        ref_removed = true;
-                    } else refitr = vt_next(refitr);
-                    continue;
-                }
-            }
-            r.top = y0 - start_row * dy - dy * (float)ref->cell_y_offset / (float)cell.height;
-            r.left = screen_left + start_column * dx + dx * (float)ref->cell_x_offset / (float) cell.width;
-
-            int32_t nr = ref->num_rows, nc = ref->num_cols;
-            if (nr) {
-                r.bottom = y0 - (start_row + nr) * dy;
-                if (nc) r.right = screen_left + (start_column + nc) * dx;
-                else {
-                    double height_px = (((double)r.top - r.bottom) / screen_height) * screen_height_px;
-                    double width_px = height_px * ref->src_width / (double) ref->src_height;
-                    r.right = r.left + (float)((width_px / screen_width_px) * screen_width);
-                }
-            } else {
-                if (nc) r.right = screen_left + (start_column + nc) * dx;
-                else r.right = r.left + screen_width * (float)ref->src_width / screen_width_px;
-                double width_px = (((double)r.right - r.left) / screen_width) * screen_width_px;
-                double height_px = width_px * ref->src_height / (double)ref->src_width;
-                r.bottom = r.top - (float)((height_px / screen_height_px) * screen_height);
+    self->layers_update_count++;
+    ensure_placement_index(self);
+
+    // Relative placements are positioned by their parents, remove the ones
+    // whose parents no longer exist
+    for (i = 0; i < self->placement_index.relative.count;) {
+        const PlacementIndexEntry e = self->placement_index.relative.items[i];
+        int32_t start_row, start_column;
+        bool has_virtual_ancestor;
+        if (!resolve_parent_offset(self, e.ref, &start_row, &start_column, &has_virtual_ancestor)) {
+            if (!has_virtual_ancestor) {
+                placement_index_remove(self, e.ref);
+                remove_ref(self, e.img, e.ref);
+                if (!vt_size(&e.img->refs_by_internal_id)) remove_image(self, e.img);
+                // the entry was replaced by the last one
+                if (self->placement_index.valid) continue;
             }
-
-            if (r.top <= screen_bottom || r.bottom >= screen_top) { refitr = vt_next(refitr); continue; }  // not visible
-
-            if (ref->z_index < ((int32_t)INT32_MIN/2))
-                self->num_of_below_refs++;
-            else if (ref->z_index < 0)
-                self->num_of_negative_refs++;
-            else
-                self->num_of_positive_refs++;
-            ensure_space_for(&(self->render_data), item, ImageRenderData, self->render_data.count + 1, capacity, 64, true);
-            ImageRenderData *rd = self->render_data.item + self->render_data.count;
-            zero_at_ptr(rd);
-            rd->dest_rect = r; rd->src_rect = ref->src_rect;
-            self->render_data.count++;
-            rd->z_index = ref->z_index; rd->image_id = img->internal_id; rd->ref_id = ref->internal_id;
-            rd->texture_id = texture_id_for_img(img);
-            img->is_drawn = true;
-            refitr = vt_next(refitr);
-        }
-        if (ref_removed && !vt_size(&img->refs_by_internal_id)) {
-            imgitr = remove_image_itr(self, imgitr);
-            continue;
-        }
-        if (img->is_drawn && !was_drawn && img->animation_state != ANIMATION_STOPPED && img->extra_framecnt && img->animation_duration) {
-            self->has_images_needing_animation = true;
-            global_state.check_for_active_animated_images = true;
-        }
-        imgitr = vt_next(imgitr);
+        } else if (!e.img->pending_decode) add_render_data_for_ref(self, e.img, e.ref, start_row, start_column, &g);
+        i++;
+    }
+    // The on screen rows, with a margin for rounding in the computation of the number of rows of placements
+    const int32_t top_row = -(int32_t)scrolled_by - 1, bottom_row = (int32_t)num_rows - (int32_t)scrolled_by;
+    const PlacementIndexEntry *items = self->placement_index.rows.items;
+    for (i = first_placement_reaching(self, top_row); i < self->placement_index.rows.count && items[i].ref->start_row <= bottom_row; i++) {
+        const PlacementIndexEntry e = items[i];
+        if (!e.img->pending_decode) add_render_data_for_ref(self, e.img, e.ref, e.ref->start_row, e.ref->start_column, &g);
     }
     if (!self->render_data.count) return false;
     // Sort visible refs in draw order (z-index, img, ref)
@@ -1351,24 +1910,6 @@ typedef struct {
     bool is_4byte_aligned, is_opaque;
 } CoalescedFrameData;
 
-static void
-blend_on_opaque(uint8_t *under_px, const uint8_t *over_px) {
-    const float alpha = (float)over_px[3] / 255.f;
-    const float alpha_op = 1.f - alpha;
-    for (unsigned i = 0; i < 3; i++) under_px[i] = (uint8_t)(over_px[i] * alpha + under_px[i] * alpha_op);
-}
-
-static void
-alpha_blend(uint8_t *dest_px, const uint8_t *src_px) {
-    if (src_px[3]) {
-        const float dest_a = (float)dest_px[3] / 255.f, src_a = (float)src_px[3] / 255.f;
-        const float alpha = src_a + dest_a * (1.f - src_a);
-        dest_px[3] = (uint8_t)(255 * alpha);
-        if (!dest_px[3]) { dest_px[0] = 0; dest_px[1] = 0; dest_px[2] = 0; return; }
-        for (unsigned i = 0; i < 3; i++) dest_px[i] = (uint8_t)((src_px[i] * src_a + dest_px[i] * dest_a * (1.f - src_a))/alpha);
-    }
-}
-
 typedef struct {
     bool needs_blending;
     uint32_t over_px_sz, under_px_sz;
@@ -1380,9 +1921,9 @@ typedef struct {
 #define COPY_PIXELS \
     if (d.needs_blending) { \
         if (d.under_px_sz == 3) { \
-            ROW_ITER PIX_ITER blend_on_opaque(under_px, over_px); }} \
+            ROW_ITER blend_rgba_on_rgb(under_row, over_row, ROW_PIXELS); } \
         } else { \
-            ROW_ITER PIX_ITER alpha_blend(under_px, over_px); }} \
+            ROW_ITER alpha_blend_rgba(under_row, over_row, ROW_PIXELS); } \
         } \
     } else { \
         if (d.under_px_sz == 4) { \
@@ -1410,10 +1951,12 @@ compose_rectangles(const ComposeData d, uint8_t *under_data, const uint8_t *over
         ROW_ITER memcpy(under_row, over_row, (size_t)d.over_px_sz * min_width);}
         return;
     }
+#define ROW_PIXELS min_width
 #define PIX_ITER for (unsigned x = 0; x < min_width; x++) { \
         uint8_t *under_px = under_row + (d.under_px_sz * x); \
         const uint8_t *over_px = over_row + (d.over_px_sz * x);
     COPY_PIXELS
+#undef ROW_PIXELS
 #undef PIX_ITER
 #undef ROW_ITER
 }
@@ -1431,11 +1974,13 @@ compose(const ComposeData d, uint8_t *under_data, const uint8_t *over_data) {
         ROW_ITER memcpy(under_row, over_row, (size_t)d.over_px_sz * min_row_sz); END_ITER
         return;
     }
+#define ROW_PIXELS min_row_sz
 #define PIX_ITER for (unsigned x = 0; x < min_row_sz; x++) { \
         uint8_t *under_px = under_row + (d.under_px_sz * x); \
         const uint8_t *over_px = over_row + (d.over_px_sz * x);
     COPY_PIXELS
 #undef COPY_RGB
+#undef ROW_PIXELS
 #undef PIX_ITER
 #undef ROW_ITER
 #undef END_ITER
@@ -1486,12 +2031,50 @@ get_coalesced_frame_data_standalone(const Image *img, const Frame *f, uint8_t *f
 }
 
 
+static bool
+read_composed_frame(GraphicsManager *self, const ImageAndFrame key, CoalescedFrameData *ans) {
+    for (size_t i = 0; i < self->composed_frames.count; i++) {
+        ComposedFrame *cf = self->composed_frames.items + i;
+        if (cf->key.image_id == key.image_id && cf->key.frame_id == key.frame_id) {
+            if (!(ans->buf = malloc(cf->sz))) return false;
+            memcpy(ans->buf, cf->buf, cf->sz);
+            ans->is_opaque = cf->is_opaque; ans->is_4byte_aligned = cf->is_4byte_aligned;
+            cf->last_used = ++self->composed_frames.counter;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+add_composed_frame(GraphicsManager *self, const ImageAndFrame key, const Image *img, const CoalescedFrameData *cfd) {
+    const size_t sz = (size_t)img->width * img->height * (cfd->is_opaque ? 3 : 4);
+    if (sz > COMPOSED_FRAMES_SIZE_LIMIT / 4) return;
+    while (self->composed_frames.count && self->composed_frames.total_sz + sz > COMPOSED_FRAMES_SIZE_LIMIT) {
+        size_t lru = 0;
+        for (size_t i = 1; i < self->composed_frames.count; i++) {
+            if (self->composed_frames.items[i].last_used < self->composed_frames.items[lru].last_used) lru = i;
+        }
+        remove_composed_frame(self, lru);
+    }
+    uint8_t *buf = malloc(sz);
+    if (!buf) return;
+    ensure_space_for(&self->composed_frames, items, ComposedFrame, self->composed_frames.count + 1, capacity, 16, false);
+    memcpy(buf, cfd->buf, sz);
+    self->composed_frames.items[self->composed_frames.count++] = (ComposedFrame){
+        .key = key, .buf = buf, .sz = sz, .is_opaque = cfd->is_opaque, .is_4byte_aligned = cfd->is_4byte_aligned,
+        .last_used = ++self->composed_frames.counter};
+    self->composed_frames.total_sz += sz;
+}
+
 static CoalescedFrameData
 get_coalesced_frame_data_impl(GraphicsManager *self, Image *img, const Frame *f, unsigned count) {
     CoalescedFrameData ans = {0};
     if (count > 32) return ans;  // prevent stack overflows, infinite recursion
     size_t frame_data_sz; void *frame_data;
     ImageAndFrame key = {.image_id = img->internal_id, .frame_id = f->id};
+    if (f->base_frame_id && read_composed_frame(self, key, &ans)) return ans;
+    if (f->is_ephemeral) return ans;
     if (!read_from_cache(self, key, &frame_data, &frame_data_sz)) return ans;
     if (!f->base_frame_id) return get_coalesced_frame_data_standalone(img, f, frame_data);
     Frame *base = frame_for_id(img, f->base_frame_id);
@@ -1507,6 +2090,7 @@ get_coalesced_frame_data_impl(GraphicsManager *self, Image *img, const Frame *f,
     };
     compose(d, base_data.buf, frame_data);
     free(frame_data);
+    add_composed_frame(self, key, img, &base_data);
     return base_data;
 }
 
@@ -1550,6 +2134,7 @@ reference_chain_too_large(Image *img, const Frame *frame) {
 static Image*
 handle_animation_frame_load_command(GraphicsManager *self, GraphicsCommand *g, Image *img, const uint8_t *payload, bool *is_dirty) {
     uint32_t frame_number = g->frame_number, fmt = g->format ? g->format : RGBA;
+    if (img->root_frame.is_ephemeral) ABRT("ENODATA", "Cannot add frames to the ephemeral image: %u", img->client_id);
     if (!frame_number || frame_number > img->extra_framecnt + 2) frame_number = img->extra_framecnt + 2;
     bool is_new_frame = frame_number == img->extra_framecnt + 2;
     g->frame_number = frame_number;
@@ -1751,7 +2336,7 @@ handle_animation_control_command(GraphicsManager *self, bool *is_dirty, const Gr
         if (img->animation_state == ANIMATION_STOPPED) {
             img->current_loop = 0;
         } else {
-            if (old_state == ANIMATION_STOPPED) { img->current_frame_shown_at = monotonic(); img->is_drawn = true; }
+            if (old_state == ANIMATION_STOPPED) { img->current_frame_shown_at = monotonic(); img->drawn_in_layers_update = self->layers_update_count; }
             self->has_images_needing_animation = true;
             global_state.check_for_active_animated_images = true;
         }
@@ -1764,8 +2349,13 @@ handle_animation_control_command(GraphicsManager *self, bool *is_dirty, const Gr
 }
 
 static bool
-image_is_animatable(const Image *img) {
-    return img->animation_state != ANIMATION_STOPPED && img->extra_framecnt && img->is_drawn && img->animation_duration && (
+image_is_drawn(const GraphicsManager *self, const Image *img) {
+    return img->drawn_in_layers_update && img->drawn_in_layers_update == self->layers_update_count;
+}
+
+static bool
+image_is_animatable(const GraphicsManager *self, const Image *img) {
+    return img->animation_state != ANIMATION_STOPPED && img->extra_framecnt && image_is_drawn(self, img) && img->animation_duration && (
             !img->max_loops || img->current_loop < img->max_loops);
 }
 
@@ -1774,10 +2364,13 @@ scan_active_animations(GraphicsManager *self, const monotonic_t now, monotonic_t
     bool dirtied = false;
     *minimum_gap = MONOTONIC_T_MAX;
     if (!self->has_images_needing_animation) return dirtied;
+    // No frame can be due before the deadline computed by the last scan
+    // unless a command changed animation state, which resets it.
+    if (now < self->next_animation_frame_at) { *minimum_gap = self->next_animation_frame_at - now; return dirtied; }
     self->has_images_needing_animation = false;
     self->context_made_current_for_this_command = os_window_context_set;
     iter_images(self) { Image *img = i.data->val;
-        if (image_is_animatable(img)) {
+        if (image_is_animatable(self, img)) {
             Frame *f = current_frame(img);
             if (f) {
                 self->has_images_needing_animation = true;
@@ -1793,6 +2386,9 @@ scan_active_animations(GraphicsManager *self, const monotonic_t now, monotonic_t
                     } while (!current_frame(img)->gap);
                     dirtied = true;
                     update_current_frame(self, img, NULL);
+                    // get the data for the frame after this one into RAM before it is needed
+                    const uint32_t after = (img->current_frame_index + 1) % (img->extra_framecnt + 1);
+                    prefetch_from_cache(self, (ImageAndFrame){.image_id=img->internal_id, .frame_id=after ? img->extra_frames[after - 1].id : img->root_frame.id});
                     f = current_frame(img);
                     next_frame_at = img->current_frame_shown_at + ms_to_monotonic_t(f->gap);
                 }
@@ -1801,10 +2397,100 @@ scan_active_animations(GraphicsManager *self, const monotonic_t now, monotonic_t
         }
         skip_image:;
     }
+    self->next_animation_frame_at = *minimum_gap < MONOTONIC_T_MAX ? now + *minimum_gap : 0;
     return dirtied;
 }
 // }}}
 
+// Image texture budget {{{
+// When image_texture_memory_limit is exceeded the textures of the least
+// recently used images that are not visible are freed. Their data is still in
+// the disk cache, so they are uploaded again when next drawn. Textures shared
+// with other images or in atlases are left alone.
+
+typedef struct { GraphicsManager *grman; Image *img; } EvictionCandidate;
+static struct { EvictionCandidate *items; size_t count, capacity; } eviction_candidates = {0};
+
+static bool
+texture_is_evictable(const GraphicsManager *self, const Image *img) {
+    const TextureRef *t = img->texture;
+    if (!t || !t->id || t->in_atlas || t->refcnt > 1 || image_is_drawn(self, img)) return false;
+    // ephemeral frames are only on the GPU
+    if (img->pending_decode || !img->root_frame_data_loaded || img->root_frame.is_ephemeral) return false;
+    for (size_t i = 0; i < img->extra_framecnt; i++) if (img->extra_frames[i].is_ephemeral) return false;
+    return true;
+}
+
+static void
+add_eviction_candidates(GraphicsManager *self) {
+    if (!self) return;
+    iter_images(self) { Image *img = i.data->val;
+        if (texture_is_evictable(self, img)) {
+            ensure_space_for(&eviction_candidates, items, EvictionCandidate, eviction_candidates.count + 1, capacity, 64, false);
+            eviction_candidates.items[eviction_candidates.count++] = (EvictionCandidate){.grman=self, .img=img};
+        }
+    }
+}
+
+void
+grman_apply_texture_budget(void) {
+    // Must be called only between frames, never while screens are being rendered
+    const size_t limit = (size_t)OPT(image_texture_memory_limit) * 1024u * 1024u;
+    if (!limit || image_texture_bytes <= limit || !global_state.num_os_windows) return;
+    // When everything over the limit is visible, do not rescan all images on every frame
+    static monotonic_t nothing_to_evict_at = 0;
+    const monotonic_t now = monotonic();
+    if (nothing_to_evict_at && now - nothing_to_evict_at < s_to_monotonic_t(1ll)) return;
+    eviction_candidates.count = 0;
+    for (size_t o = 0; o < global_state.num_os_windows; o++) {
+        OSWindow *osw = global_state.os_windows + o;
+        for (size_t t = 0; t < osw->num_tabs; t++) {
+            Tab *tab = osw->tabs + t;
+            for (size_t w = 0; w < tab->num_windows; w++) {
+                Screen *screen = tab->windows[w].render_data.screen;
+                if (screen) { add_eviction_candidates(screen->main_grman); add_eviction_candidates(screen->alt_grman); }
+            }
+        }
+    }
+    nothing_to_evict_at = eviction_candidates.count ? 0 : now;
+    if (!eviction_candidates.count) return;
+#define least_recently_used_first(a, b) ((a)->img->atime < (b)->img->atime)
+    QSORT(EvictionCandidate, eviction_candidates.items, eviction_candidates.count, least_recently_used_first);
+#undef least_recently_used_first
+    make_os_window_context_current(global_state.os_windows);
+    for (size_t i = 0; i < eviction_candidates.count && image_texture_bytes > limit; i++) {
+        TextureRef *t = eviction_candidates.items[i].img->texture;
+        unshare_texture_ref(t);
+        free_texture(&t->id);
+        set_texture_size(t, 0);
+        t->evicted = true;
+    }
+    eviction_candidates.count = 0;
+}
+
+static void
+reload_evicted_textures(GraphicsManager *self) {
+    for (size_t i = 0; i < self->render_data.count; i++) {
+        ImageRenderData *rd = self->render_data.item + i;
+        Image *img = img_by_internal_id(self, rd->image_id);
+        if (!img || !img->texture) continue;
+        TextureRef *t = img->texture;
+        if (t->evicted) {
+            const Frame *f = current_frame(img);
+            if (!f) continue;
+            CoalescedFrameData cfd = get_coalesced_frame_data(self, img, f);
+            if (!cfd.buf) { if (PyErr_Occurred()) PyErr_Print(); continue; }
+            send_image_to_gpu(&t->id, cfd.buf, img->width, img->height, cfd.is_opaque, cfd.is_4byte_aligned, true, REPEAT_CLAMP);
+            if (t->has_mipmaps) generate_mipmaps(t->id);
+            free(cfd.buf);
+            set_texture_size(t, (size_t)img->width * img->height * 4);
+            t->evicted = false;
+        }
+        rd->texture_id = texture_id_for_img(img);
+    }
+}
+// }}}
+
 // {{{ composition a=c
 static void
 cfd_free(CoalescedFrameData *p) { free((p)->buf); p->buf = NULL; }
@@ -1876,26 +2562,29 @@ handle_compose_command(GraphicsManager *self, bool *is_dirty, const GraphicsComm
 // Image lifetime/scrolling {{{
 
 static ref_map_itr
-remove_ref_itr(Image *img, ref_map_itr x) {
+remove_ref_itr(GraphicsManager *self, Image *img, ref_map_itr x) {
     free(x.data->val);
-    return vt_erase_itr(&img->refs_by_internal_id, x);
+    ref_map_itr ans = vt_erase_itr(&img->refs_by_internal_id, x);
+    if (!vt_size(&img->refs_by_internal_id)) self->may_have_orphaned_images = true;
+    return ans;
 }
 
 
 static void
-remove_ref(Image *img, ImageRef *ref) {
+remove_ref(GraphicsManager *self, Image *img, ImageRef *ref) {
     ref_map_itr i = vt_get(&img->refs_by_internal_id, ref->internal_id);
     if (vt_is_end(i)) return;
-    remove_ref_itr(img, i);
+    remove_ref_itr(self, img, i);
 }
 
 static void
 filter_refs(GraphicsManager *self, const void* data, bool free_images, bool (*filter_func)(const ImageRef*, Image*, const void*, CellPixelSize), CellPixelSize cell, bool only_first_image, bool free_only_matched) {
+    invalidate_placement_index(self);
     for (image_map_itr ii = vt_first(&self->images_by_internal_id); !vt_is_end(ii); ) { Image *img = ii.data->val;
         bool matched = false;
         for (ref_map_itr ri = vt_first(&img->refs_by_internal_id); !vt_is_end(ri); ) { ImageRef *ref = ri.data->val;
             if (filter_func(ref, img, data, cell)) {
-                ri = remove_ref_itr(img, ri);
+                ri = remove_ref_itr(self, img, ri);
                 set_layers_dirty(self);
                 matched = true;
             } else ri = vt_next(ri);
@@ -1907,22 +2596,6 @@ filter_refs(GraphicsManager *self, const void* data, bool free_images, bool (*fi
 }
 
 
-static void
-modify_refs(GraphicsManager *self, const void* data, bool (*filter_func)(ImageRef*, Image*, const void*, CellPixelSize), CellPixelSize cell) {
-    for (image_map_itr ii = vt_first(&self->images_by_internal_id); !vt_is_end(ii); ) { Image *img = ii.data->val;
-        for (ref_map_itr ri = vt_first(&img->refs_by_internal_id); !vt_is_end(ri); ) { ImageRef *ref = ri.data->val;
-            if (filter_func(ref, img, data, cell)) ri = remove_ref_itr(img, ri);
-            else ri = vt_next(ri);
-        }
-        if (!vt_size(&img->refs_by_internal_id) && img->client_id == 0 && img->client_number == 0) {
-            // references have all scrolled off the history buffer and the image has no way to reference it
-            // to create new references so remove it.
-            ii = remove_image_itr(self, ii);
-        } else ii = vt_next(ii);
-    }
-}
-
-
 static bool
 scroll_filter_func(ImageRef *ref, Image UNUSED *img, const void *data, CellPixelSize cell UNUSED) {
     if (ref->is_virtual_ref) return false;
@@ -1973,23 +2646,101 @@ scroll_filter_margins_func(ImageRef* ref, Image* img, const void* data, CellPixe
     return false;
 }
 
+static bool
+is_orphaned_image(const Image *img) {
+    // the image has no references and no way to reference it to create new references
+    return !vt_size(&img->refs_by_internal_id) && img->client_id == 0 && img->client_number == 0;
+}
+
+static void
+remove_scrolled_off_ref(GraphicsManager *self, Image *img, ImageRef *ref) {
+    remove_ref(self, img, ref);
+    // references have all scrolled off the history buffer so remove the image
+    if (is_orphaned_image(img)) remove_image(self, img);
+}
+
+static void
+remove_orphaned_images(GraphicsManager *self) {
+    // Images can also be left without references by other operations or be
+    // transmitted without ever being placed, so look for them whenever the
+    // screen scrolls, but only after something could have created one
+    if (!self->may_have_orphaned_images) return;
+    self->may_have_orphaned_images = false;
+    for (image_map_itr ii = vt_first(&self->images_by_internal_id); !vt_is_end(ii); ) {
+        if (is_orphaned_image(ii.data->val)) ii = remove_image_itr(self, ii);
+        else ii = vt_next(ii);
+    }
+}
+
+static void
+scroll_relative_placements(GraphicsManager *self, const ScrollData *data, CellPixelSize cell) {
+    PlacementIndexEntry *items = self->placement_index.relative.items;
+    size_t w = 0;
+    for (size_t k = 0; k < self->placement_index.relative.count; k++) {
+        const PlacementIndexEntry e = items[k];
+        if ((data->has_margins ? scroll_filter_margins_func : scroll_filter_func)(e.ref, e.img, data, cell)) remove_scrolled_off_ref(self, e.img, e.ref);
+        else items[w++] = e;
+    }
+    self->placement_index.relative.count = w;
+}
+
+static void
+scroll_all_placements(GraphicsManager *self, const ScrollData *data) {
+    // All placements move by the same amount so the index stays sorted and
+    // only the placements at the top can scroll off
+    PlacementIndexEntry *items = self->placement_index.rows.items;
+    const size_t count = self->placement_index.rows.count;
+    for (size_t k = 0; k < count; k++) items[k].ref->start_row += data->amt;
+    size_t w = 0, k = 0;
+    for (; k < count && items[k].ref->start_row <= data->limit; k++) {
+        const PlacementIndexEntry e = items[k];
+        if (e.ref->start_row + (int32_t)e.ref->effective_num_rows <= data->limit) remove_scrolled_off_ref(self, e.img, e.ref);
+        else items[w++] = e;
+    }
+    if (w < k) {
+        memmove(items + w, items + k, (count - k) * sizeof(items[0]));
+        self->placement_index.rows.count -= k - w;
+    }
+}
+
+static void
+scroll_placements_within_margins(GraphicsManager *self, const ScrollData *data, CellPixelSize cell) {
+    // Only the placements entirely within the margins move and they stay
+    // within the margins, so only the part of the index for the rows in the
+    // margins has to be sorted again
+    PlacementIndexEntry *items = self->placement_index.rows.items;
+    const size_t count = self->placement_index.rows.count, first = first_placement_starting_at_or_after(self, data->margin_top);
+    size_t w = first, k = first;
+    bool moved = false;
+    for (; k < count && items[k].ref->start_row <= (int32_t)data->margin_bottom; k++) {
+        const PlacementIndexEntry e = items[k];
+        if (ref_within_region(e.ref, data->margin_top, data->margin_bottom)) {
+            moved = true;
+            if (scroll_filter_margins_func(e.ref, e.img, data, cell)) { remove_scrolled_off_ref(self, e.img, e.ref); continue; }
+        }
+        items[w++] = e;
+    }
+    if (w < k) {
+        memmove(items + w, items + k, (count - k) * sizeof(items[0]));
+        self->placement_index.rows.count -= k - w;
+    }
+    if (moved) sort_placements(items + first, w - first);
+}
+
 void
 grman_scroll_images(GraphicsManager *self, const ScrollData *data, CellPixelSize cell) {
     if (vt_size(&self->images_by_internal_id)) {
-        set_layers_dirty(self);
-        modify_refs(self, data, data->has_margins ? scroll_filter_margins_func : scroll_filter_func, cell);
+        // not set_layers_dirty() as the placement index is updated here
+        self->layers_dirty = true;
+        ensure_placement_index(self);
+        placements_changed(self);
+        scroll_relative_placements(self, data, cell);
+        if (data->has_margins) scroll_placements_within_margins(self, data, cell);
+        else scroll_all_placements(self, data);
+        remove_orphaned_images(self);
     }
 }
 
-static bool
-cell_image_row_filter_func(const ImageRef *ref, Image UNUSED *img, const void *data, CellPixelSize cell UNUSED) {
-    if (ref->is_virtual_ref || !is_cell_image(ref))
-        return false;
-    int32_t top = *(int32_t *)data;
-    int32_t bottom = *((int32_t *)data + 1);
-    return ref_within_region(ref, top, bottom);
-}
-
 static bool
 cell_image_filter_func(const ImageRef *ref, Image UNUSED *img, const void *data UNUSED, CellPixelSize cell UNUSED) {
     return !ref->is_virtual_ref && is_cell_image(ref);
@@ -1998,9 +2749,23 @@ cell_image_filter_func(const ImageRef *ref, Image UNUSED *img, const void *data
 // Remove cell images within the given region.
 void
 grman_remove_cell_images(GraphicsManager *self, int32_t top, int32_t bottom) {
-    CellPixelSize dummy = {0};
-    int32_t data[] = {top, bottom};
-    filter_refs(self, data, false, cell_image_row_filter_func, dummy, false, true);
+    ensure_placement_index(self);
+    PlacementIndexEntry *items = self->placement_index.rows.items;
+    const size_t count = self->placement_index.rows.count, first = first_placement_starting_at_or_after(self, top);
+    size_t w = first, k = first;
+    for (; k < count && items[k].ref->start_row <= bottom; k++) {
+        const PlacementIndexEntry e = items[k];
+        if (is_cell_image(e.ref) && ref_within_region(e.ref, top, bottom)) {
+            remove_ref(self, e.img, e.ref);
+            set_layers_dirty(self);
+            placements_changed(self);
+            if (!vt_size(&e.img->refs_by_internal_id) && e.img->client_id == 0) remove_image(self, e.img);
+        } else items[w++] = e;
+    }
+    if (w < k) {
+        memmove(items + w, items + k, (count - k) * sizeof(items[0]));
+        self->placement_index.rows.count -= k - w;
+    }
 }
 
 void
@@ -2126,7 +2891,8 @@ handle_delete_command(GraphicsManager *self, const GraphicsCommand *g, Cursor *c
             if (img) {
                 for (ref_map_itr ri = vt_first(&img->refs_by_internal_id); !vt_is_end(ri); ) { ImageRef *ref = ri.data->val;
                     if (!g->placement_id || g->placement_id == ref->client_id) {
-                        ri = remove_ref_itr(img, ri);
+                        placement_index_remove(self, ref);
+                        ri = remove_ref_itr(self, img, ri);
                         set_layers_dirty(self);
                     } else ri = vt_next(ri);
                 }
@@ -2159,6 +2925,7 @@ void
 grman_resize(GraphicsManager *self, index_type old_lines UNUSED, index_type lines UNUSED, index_type old_columns, index_type columns, index_type num_content_lines_before, index_type num_content_lines_after) {
     ImageRef *ref; Image *img;
     set_layers_dirty(self);
+    invalidate_placement_index(self);
     if (columns == old_columns && num_content_lines_before > num_content_lines_after) {
         const unsigned int vertical_shrink_size = num_content_lines_before - num_content_lines_after;
         iter_images(self) { img = i.data->val;
@@ -2174,6 +2941,7 @@ void
 grman_rescale(GraphicsManager *self, CellPixelSize cell) {
     ImageRef *ref; Image *img;
     set_layers_dirty(self);
+    invalidate_placement_index(self);
     iter_images(self) { img = i.data->val;
         iter_refs(img) { ref = i.data->val;
             if (ref->is_virtual_ref || is_cell_image(ref)) continue;
@@ -2189,6 +2957,8 @@ grman_handle_command(GraphicsManager *self, const GraphicsCommand *g, const uint
     const char *ret = NULL;
     command_response[0] = 0;
     self->context_made_current_for_this_command = false;
+    self->decode_started_for_this_command = false;
+    self->next_animation_frame_at = 0;
 
     if (g->id && g->image_number) {
         set_command_failed_response("EINVAL", "Must not specify both image id and image number");
@@ -2208,7 +2978,7 @@ grman_handle_command(GraphicsManager *self, const GraphicsCommand *g, const uint
             GraphicsCommand *lg = &self->currently_loading.start_command;
             if (g->quiet) lg->quiet = g->quiet;
             if (is_query) ret = finish_command_response(&(const GraphicsCommand){.id=q_iid, .quiet=g->quiet}, image != NULL);
-            else ret = finish_command_response(lg, image != NULL);
+            else if (!self->decode_started_for_this_command) ret = finish_command_response(lg, image != NULL);
             if (lg->action == 'T' && image && image->root_frame_data_loaded) handle_put_command(self, lg, c, is_dirty, image, cell);
             id_type added_image_id = image ? image->internal_id : 0;
             if (g->action == 'q') remove_images(self, add_trim_predicate, 0);
@@ -2303,7 +3073,7 @@ image_as_dict(GraphicsManager *self, Image *img) {
         if (PyErr_Occurred()) { Py_CLEAR(frames); return NULL; }
     }
     CoalescedFrameData cfd = get_coalesced_frame_data(self, img, &img->root_frame);
-    if (!cfd.buf) { PyErr_SetString(PyExc_RuntimeError, "Failed to get data for root frame"); return NULL; }
+    if (!cfd.buf && !img->root_frame.is_ephemeral) { PyErr_SetString(PyExc_RuntimeError, "Failed to get data for root frame"); return NULL; }
     PyObject *ans = Py_BuildValue("{sI sI sI sI sI sI sI " "sO sI sO " "sI sI sI " "sI sy# sN}",
         "texture_id", texture_id_for_img(img), U(client_id), U(width), U(height), U(internal_id),
         "refs.count", (unsigned int)vt_size(&img->refs_by_internal_id), U(client_number),
@@ -2401,6 +3171,7 @@ static PyGetSetDef getsets[] = {
 static PyMemberDef members[] = {
     {"storage_limit", T_PYSSIZET, offsetof(GraphicsManager, storage_limit), 0, "storage_limit"},
     {"disk_cache", T_OBJECT_EX, offsetof(GraphicsManager, disk_cache), READONLY, "disk_cache"},
+    {"background_decodes_without_window", T_BOOL, offsetof(GraphicsManager, background_decodes_without_window), 0, "background_decodes_without_window"},
     {NULL},
 };
 
@@ -2461,7 +3232,9 @@ init_graphics(PyObject *module) {
 }
 
 void grman_mark_layers_dirty(GraphicsManager *self) { set_layers_dirty(self); }
+uint64_t grman_placements_generation(const GraphicsManager *self) { return self->placements_generation; }
 void grman_set_window_id(GraphicsManager *self, id_type id) { self->window_id = id; }
+bool grman_is_empty(const GraphicsManager *self) { return !vt_size(&self->images_by_internal_id); }
 bool grman_has_images(GraphicsManager *self) { return self->num_of_below_refs + self->num_of_negative_refs + self->num_of_positive_refs > 0; }
 GraphicsRenderData grman_render_data(GraphicsManager *self) {
     GraphicsRenderData ans = {
@@ -21,7 +21,7 @@ typedef struct {
     union { uint32_t num_cells, other_frame_number; };
     union { int32_t z_index, gap; };
     size_t payload_sz;
-    bool unicode_placement;
+    bool unicode_placement, ephemeral;
     int32_t offset_from_parent_x, offset_from_parent_y;
 } GraphicsCommand;
 
@@ -44,6 +44,12 @@ typedef struct {
     size_t mmap_size;
 } BackgroundImage;
 
+typedef struct ImageAtlasSlot {
+    uint32_t texture_id, atlas, slot;
+    // the area of the image in the atlas texture, in texture co-ordinates
+    float left, top, right, bottom;
+} ImageAtlasSlot;
+
 
 #ifdef GRAPHICS_INTERNAL_APIS
 typedef struct {
@@ -65,19 +71,53 @@ typedef struct {
         id_type img, ref;
         struct { int32_t x, y; } offset;
     } parent;
+    // The position of a relative placement resolved from its ancestors, valid
+    // while the placements_generation of the GraphicsManager is unchanged
+    struct {
+        int32_t start_row, start_column;
+        uint64_t generation;
+        unsigned depth;
+        bool ok, has_virtual_ancestor;
+    } resolved;
 
     id_type internal_id;
 } ImageRef;
 
 typedef struct {
     uint32_t gap, id, width, height, x, y, base_frame_id, bgcolor;
-    bool is_opaque, is_4byte_aligned, alpha_blend;
+    // the data of ephemeral frames is only on the GPU, not in the disk cache
+    bool is_opaque, is_4byte_aligned, alpha_blend, is_ephemeral;
 } Frame;
 
 typedef enum { ANIMATION_STOPPED = 0, ANIMATION_LOADING = 1, ANIMATION_RUNNING = 2} AnimationState;
 
+typedef struct {
+    id_type image_id;
+    uint32_t frame_id;
+} ImageAndFrame;
+
 typedef struct TextureRef {
     uint32_t id, refcnt;
+    // small images are packed into shared atlas textures, see shaders.c
+    bool in_atlas;
+    // mipmaps are generated for images that are drawn much smaller than their size
+    bool has_mipmaps, wants_mipmaps;
+    ImageAtlasSlot atlas_slot;
+    // non-zero if this texture can be shared by identical images in all windows, see upload_root_frame_to_gpu()
+    uint64_t content_hash;
+    // where the data the shared texture was uploaded from is cached, to
+    // check that images with the same hash really are identical
+    struct {
+        PyObject *disk_cache;
+        ImageAndFrame key;
+        size_t sz;
+        uint32_t width, height;
+        bool is_opaque, is_4byte_aligned;
+    } shared_from;
+    // the size of the texture counted against image_texture_memory_limit, textures in atlases are not counted
+    size_t gpu_sz;
+    // the texture was freed to stay within image_texture_memory_limit and must be uploaded again before drawing
+    bool evicted;
 } TextureRef;
 
 #define NAME ref_map
@@ -98,17 +138,21 @@ typedef struct {
     size_t extra_framecnt;
     monotonic_t atime;
     size_t used_storage;
-    bool is_drawn;
+    // the number of the last update of the layers in which the image was
+    // drawn, the image is drawn if it is the latest one
+    uint64_t drawn_in_layers_update;
     AnimationState animation_state;
     uint32_t max_loops, current_loop;
     monotonic_t current_frame_shown_at;
+    // non-zero while the data of the root frame is being decoded in a worker thread
+    uint64_t pending_decode;
     ref_map refs_by_internal_id;
 } Image;
 
-typedef struct {
-    id_type image_id;
-    uint32_t frame_id;
-} ImageAndFrame;
+typedef struct PlacementIndexEntry {
+    ImageRef *ref;
+    Image *img;
+} PlacementIndexEntry;
 
 typedef struct {
     uint8_t *buf;
@@ -147,9 +191,26 @@ typedef struct {
     unsigned int last_scrolled_by;
     size_t used_storage;
     PyObject *disk_cache;
-    bool has_images_needing_animation, context_made_current_for_this_command;
+    bool has_images_needing_animation, context_made_current_for_this_command, decode_started_for_this_command;
+    // When the next animation frame is due, zero if unknown. Reset by anything that could change animation timing.
+    monotonic_t next_animation_frame_at;
     id_type window_id;
     image_map images_by_internal_id;
+    bool textures_want_mipmaps, textures_need_reload;
+    struct BackgroundDecode *background_decodes;
+    struct { struct ComposedFrame *items; size_t count, capacity, total_sz; uint64_t counter; } composed_frames;
+    uint64_t layers_update_count;
+    struct {
+        struct { PlacementIndexEntry *items; size_t count, capacity; } rows, relative;
+        uint32_t max_num_rows;
+        bool valid;
+    } placement_index;
+    // Incremented whenever a placement is added, moved or removed
+    uint64_t placements_generation;
+    // Set when an image is created or loses its last placement
+    bool may_have_orphaned_images;
+    // Decode in worker threads even without a window, for the tests
+    bool background_decodes_without_window;
 } GraphicsManager;
 #else
 typedef struct {int x;} *GraphicsManager;
@@ -198,11 +259,16 @@ typedef struct GraphicsRenderData {
     ImageRenderData *images;
 } GraphicsRenderData;
 
+// decode_id identifies the background decode the response is for, see grman_background_decodes()
+typedef void (*grman_response_callback)(void *data, const char *response, uint64_t decode_id);
+
 GraphicsManager* grman_alloc(bool for_paused_rendering);
 void grman_clear(GraphicsManager*, bool, CellPixelSize fg);
 const char* grman_handle_command(GraphicsManager *self, const GraphicsCommand *g, const uint8_t *payload, Cursor *c, bool *is_dirty, CellPixelSize fg);
 void grman_put_cell_image(GraphicsManager *self, uint32_t row, uint32_t col, uint32_t image_id, uint32_t placement_id, uint32_t x, uint32_t y, uint32_t w, uint32_t h, CellPixelSize cell);
 bool grman_update_layers(GraphicsManager *self, unsigned int scrolled_by, float screen_left, float screen_top, float dx, float dy, unsigned int num_cols, unsigned int num_rows, CellPixelSize);
+void grman_generate_mipmaps(GraphicsManager *self);
+void grman_apply_texture_budget(void);
 void grman_scroll_images(GraphicsManager *self, const ScrollData*, CellPixelSize fg);
 void grman_resize(GraphicsManager*, index_type, index_type, index_type, index_type, index_type, index_type);
 void grman_rescale(GraphicsManager *self, CellPixelSize fg);
@@ -216,6 +282,18 @@ bool image_path_to_bitmap(const char *path, uint8_t** data, unsigned int* width,
 bool scan_active_animations(GraphicsManager *self, const monotonic_t now, monotonic_t *minimum_gap, bool os_window_context_set);
 void grman_pause_rendering(GraphicsManager *self, GraphicsManager *dest);
 void grman_mark_layers_dirty(GraphicsManager *self);
+uint64_t grman_placements_generation(const GraphicsManager *self);
 void grman_set_window_id(GraphicsManager *self, id_type id);
 bool grman_has_images(GraphicsManager *self);
+bool grman_is_empty(const GraphicsManager *self);
 GraphicsRenderData grman_render_data(GraphicsManager *self);
+bool grman_has_background_decodes(GraphicsManager *self);
+uint64_t grman_background_decodes(GraphicsManager *self, uint64_t *oldest);
+typedef struct GraphicsMemoryUsage {
+    // image data in RAM and on disk, textures on the GPU and composed
+    // animation frames kept for reuse
+    size_t in_ram, on_disk, textures, composed_frames;
+} GraphicsMemoryUsage;
+GraphicsMemoryUsage grman_memory_usage(GraphicsManager *self);
+bool grman_command_needs_image_data(const GraphicsCommand *g);
+bool grman_finish_background_decodes(GraphicsManager *self, bool wait, bool *is_dirty, grman_response_callback callback, void *data);
@@ -1,2 +1,6 @@
-uniform vec4 src_rect, dest_rect;
+// Consecutive images that use the same texture are drawn with a single
+// instanced draw call, the size of the arrays is MAX_GRAPHICS_BATCH in shaders.c
+uniform vec4 src_rects[64], dest_rects[64];
+#define src_rect src_rects[gl_InstanceID]
+#define dest_rect dest_rects[gl_InstanceID]
 #pragma kitty_include_shader <blit_common.glsl>
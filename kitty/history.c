@@ -9,35 +9,344 @@
 #include "lineops.h"
 #include "charsets.h"
 #include "resize.h"
+#include "disk-cache.h"
+#include "search.h"
+#include "threading.h"
 #include <structmember.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <zlib.h>
 #include "../3rdparty/ringbuf/ringbuf.h"
 
 extern PyTypeObject Line_Type;
 #define SEGMENT_SIZE 2048
 
+// Segments that are not among the few most recently used ones are stored run
+// length encoded, which is very effective since most cells in a typical
+// scrollback are blank or share the default attributes, see rle_encode(). New segments
+// start out blank, which is represented by having neither cells nor
+// compressed data. Segments that do not compress well are left as is. Note
+// that pointers into a segment returned by init_line() remain valid only until
+// arraysz(hot_segments) other segments have been accessed.
+//
+// Optionally, compressed segments are further written to a disk cache. This
+// is done in historybuf_spill_to_disk() which must be called on the main
+// thread, reading them back does not need the GIL.
+
+static size_t
+cells_size(const HistoryBuf *self) { return self->xnum * SEGMENT_SIZE * (sizeof(CPUCell) + sizeof(GPUCell)); }
+
+// Arena {{{
+// The cells of uncompressed segments live in blocks allocated with mmap() so
+// that huge pages can be used. Blocks are recycled via a small per HistoryBuf
+// pool. Blocks in the pool are zeroed, which also pre-faults them, on a
+// background thread, so that rapid output crossing into a new segment does not
+// stall on page faults. Shortly before the write position reaches the end of
+// a segment a block is added to the pool if it is empty. The pool itself is
+// not locked, like the rest of the HistoryBuf, only the queue of blocks to
+// prefault is shared between threads.
+
+#define HUGE_PAGE_SIZE (2u * 1024u * 1024u)
+#define PREFAULT_AHEAD_LINES 256u
+typedef enum { BLOCK_PENDING, BLOCK_READY, BLOCK_ABANDONED } BlockState;
+
+struct ArenaBlock {
+    void *mem;
+    size_t sz;
+    _Atomic(int) state;
+    ArenaBlock *next;
+};
+
+static void
+free_block(ArenaBlock *b) {
+    if (b) { munmap(b->mem, b->sz); free(b); }
+}
+
+static ArenaBlock*
+alloc_block(size_t sz) {
+    // fresh mappings are always zeroed
+    ArenaBlock *b = calloc(1, sizeof(ArenaBlock));
+    if (!b) return NULL;
+#ifdef MAP_HUGETLB
+    // Needs huge pages to have been reserved by the administrator, so don't
+    // keep trying once it fails
+    static atomic_bool hugetlb_unavailable = false;
+    if (!atomic_load_explicit(&hugetlb_unavailable, memory_order_relaxed)) {
+        b->sz = (sz + HUGE_PAGE_SIZE - 1) & ~((size_t)HUGE_PAGE_SIZE - 1);
+        b->mem = mmap(NULL, b->sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (b->mem != MAP_FAILED) return b;
+        atomic_store_explicit(&hugetlb_unavailable, true, memory_order_relaxed);
+    }
+#endif
+    b->sz = sz;
+    b->mem = mmap(NULL, b->sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b->mem == MAP_FAILED) { free(b); return NULL; }
+#ifdef MADV_HUGEPAGE
+    madvise(b->mem, b->sz, MADV_HUGEPAGE);
+#endif
+    return b;
+}
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work_available;
+    ArenaBlock *queue;
+    bool started, failed;
+} prefaulter = {.lock = PTHREAD_MUTEX_INITIALIZER, .work_available = PTHREAD_COND_INITIALIZER};
+
+static void
+prefault_block(ArenaBlock *b) {
+    memset(b->mem, 0, b->sz);
+    int expected = BLOCK_PENDING;
+    // the pool was freed while we were working
+    if (!atomic_compare_exchange_strong(&b->state, &expected, BLOCK_READY)) free_block(b);
+}
+
+static void*
+prefault_loop(void *data UNUSED) {
+    set_thread_name("HistoryPrefault");
+    while (true) {
+        pthread_mutex_lock(&prefaulter.lock);
+        while (!prefaulter.queue) pthread_cond_wait(&prefaulter.work_available, &prefaulter.lock);
+        ArenaBlock *b = prefaulter.queue;
+        prefaulter.queue = b->next; b->next = NULL;
+        pthread_mutex_unlock(&prefaulter.lock);
+        prefault_block(b);
+    }
+    return NULL;
+}
+
+static void
+queue_prefault(ArenaBlock *b) {
+    atomic_store(&b->state, BLOCK_PENDING);
+    pthread_mutex_lock(&prefaulter.lock);
+    if (!prefaulter.started && !prefaulter.failed) {
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attr, prefault_loop, NULL) == 0) prefaulter.started = true;
+        else prefaulter.failed = true;
+        pthread_attr_destroy(&attr);
+    }
+    const bool queued = prefaulter.started;
+    if (queued) {
+        b->next = prefaulter.queue; prefaulter.queue = b;
+        pthread_cond_signal(&prefaulter.work_available);
+    }
+    pthread_mutex_unlock(&prefaulter.lock);
+    if (!queued) prefault_block(b);
+}
+
+static ArenaBlock*
+take_block(HistoryBuf *self) {
+    // Returns a zeroed block
+    for (unsigned i = 0; i < self->pool.count; i++) {
+        ArenaBlock *b = self->pool.blocks[i];
+        if (atomic_load(&b->state) == BLOCK_READY) {
+            self->pool.blocks[i] = self->pool.blocks[--self->pool.count];
+            return b;
+        }
+    }
+    ArenaBlock *b = alloc_block(cells_size(self));
+    if (!b) fatal("Out of memory allocating history buffer segment");
+    return b;
+}
+
+static void
+release_block(HistoryBuf *self, ArenaBlock *b) {
+    if (self->pool.count < arraysz(self->pool.blocks)) {
+        self->pool.blocks[self->pool.count++] = b;
+        queue_prefault(b);
+    } else free_block(b);
+}
+
+static void
+ensure_block_available(HistoryBuf *self) {
+    if (self->pool.count) return;
+    ArenaBlock *b = alloc_block(cells_size(self));
+    if (b) release_block(self, b);
+}
+
+static void
+free_pool(HistoryBuf *self) {
+    for (unsigned i = 0; i < self->pool.count; i++) {
+        ArenaBlock *b = self->pool.blocks[i];
+        int expected = BLOCK_PENDING;
+        // if still pending, the prefault thread frees it
+        if (!atomic_compare_exchange_strong(&b->state, &expected, BLOCK_ABANDONED)) free_block(b);
+    }
+    self->pool.count = 0;
+}
+// }}}
+
 static void
 add_segment(HistoryBuf *self, index_type num) {
     self->segments = realloc(self->segments, sizeof(HistoryBufSegment) * (self->num_segments + num));
     if (self->segments == NULL) fatal("Out of memory allocating new history buffer segment");
-    const size_t cpu_cells_size = self->xnum * SEGMENT_SIZE * sizeof(CPUCell);
-    const size_t gpu_cells_size = self->xnum * SEGMENT_SIZE * sizeof(GPUCell);
-    const size_t segment_size = cpu_cells_size + gpu_cells_size + SEGMENT_SIZE * sizeof(LineAttrs);
-    char *mem = calloc(num, segment_size);
-    if (!mem) fatal("Out of memory allocating new history buffer segment");
-    char *needs_free = mem;
-    for (HistoryBufSegment *s = self->segments + self->num_segments; s < self->segments + self->num_segments + num; s++, mem += segment_size) {
-        s->cpu_cells = (CPUCell*)mem;
-        s->gpu_cells = (GPUCell*)(((uint8_t*)s->cpu_cells) + cpu_cells_size);
-        s->line_attrs = (LineAttrs*)(((uint8_t*)s->gpu_cells) + gpu_cells_size);
-        s->mem = NULL;
-    }
-    self->segments[self->num_segments].mem = needs_free;
+    for (HistoryBufSegment *s = self->segments + self->num_segments; s < self->segments + self->num_segments + num; s++) {
+        zero_at_ptr(s);
+        s->line_attrs = calloc(SEGMENT_SIZE, sizeof(LineAttrs));
+        if (!s->line_attrs) fatal("Out of memory allocating new history buffer segment");
+    }
     self->num_segments += num;
 }
 
 static void
 free_segment(HistoryBufSegment *s) {
-    free(s->mem); zero_at_ptr(s);
+    free_block(s->block); free(s->compressed); free(s->line_attrs); free(s->search_index); zero_at_ptr(s);
+}
+
+static void
+drop_search_index(HistoryBufSegment *s) {
+    if (s->search_index) { free(s->search_index); s->search_index = NULL; }
+}
+
+// Runs of identical cells are stored as a count followed by the cell. Cells
+// that differ from their neighbours, such as the text of a line, are stored
+// verbatim as a literal run, a count with LITERAL_RUN set followed by all its
+// cells, so that they cost no more than in the uncompressed segment. Short
+// lines thus cost little more than their text, the blank cells after it being
+// a single run.
+#define LITERAL_RUN (1u << 31)
+
+static size_t
+rle_encode(const uint8_t *src, size_t num, size_t cell_sz, uint8_t *dest) {
+    // Returns the encoded size, only computing it if dest is NULL
+    size_t ans = 0;
+#define same(a, b) (memcmp(src + (a) * cell_sz, src + (b) * cell_sz, cell_sz) == 0)
+    for (size_t i = 0; i < num;) {
+        uint32_t run = 1;
+        while (i + run < num && same(i, i + run)) run++;
+        if (run == 1) {
+            while (i + run < num && !(i + run + 1 < num && same(i + run, i + run + 1))) run++;
+            if (dest) {
+                const uint32_t header = run | LITERAL_RUN;
+                memcpy(dest + ans, &header, sizeof(header));
+                memcpy(dest + ans + sizeof(header), src + i * cell_sz, run * cell_sz);
+            }
+            ans += sizeof(run) + run * cell_sz;
+        } else {
+            if (dest) {
+                memcpy(dest + ans, &run, sizeof(run));
+                memcpy(dest + ans + sizeof(run), src + i * cell_sz, cell_sz);
+            }
+            ans += sizeof(run) + cell_sz;
+        }
+        i += run;
+    }
+#undef same
+    return ans;
+}
+
+static const uint8_t*
+rle_decode(const uint8_t *src, size_t num, size_t cell_sz, uint8_t *dest) {
+    for (size_t i = 0; i < num;) {
+        uint32_t run;
+        memcpy(&run, src, sizeof(run)); src += sizeof(run);
+        if (run & LITERAL_RUN) {
+            run = MIN(num - i, run & ~LITERAL_RUN);
+            memcpy(dest + i * cell_sz, src, run * cell_sz);
+            src += run * cell_sz; i += run;
+            continue;
+        }
+        for (const size_t limit = MIN(num, i + run); i < limit; i++) memcpy(dest + i * cell_sz, src, cell_sz);
+        src += cell_sz;
+    }
+    return src;
+}
+
+static void
+set_cell_pointers(HistoryBuf *self, HistoryBufSegment *s) {
+    s->cpu_cells = s->block->mem;
+    s->gpu_cells = (GPUCell*)(((uint8_t*)s->block->mem) + self->xnum * SEGMENT_SIZE * sizeof(CPUCell));
+}
+
+static void
+compress_segment(HistoryBuf *self, HistoryBufSegment *s) {
+    if (!s->block) return;
+    const size_t num = self->xnum * SEGMENT_SIZE;
+    // Sprite positions are recalculated when a dirty line is rendered, so
+    // drop them. This makes the GPU cells of lines that use the default
+    // colors and attributes all identical, so they cost almost nothing.
+    for (size_t i = 0; i < num; i++) clear_sprite_position(s->gpu_cells[i]);
+    for (index_type y = 0; y < SEGMENT_SIZE; y++) s->line_attrs[y].has_dirty_text = true;
+    const size_t cpu_sz = rle_encode((uint8_t*)s->cpu_cells, num, sizeof(CPUCell), NULL);
+    const size_t sz = cpu_sz + rle_encode((uint8_t*)s->gpu_cells, num, sizeof(GPUCell), NULL);
+    // not worth it, leave the segment uncompressed
+    if (sz > cells_size(self) / 2) return;
+    if (!(s->compressed = malloc(sz))) return;
+    rle_encode((uint8_t*)s->cpu_cells, num, sizeof(CPUCell), s->compressed);
+    rle_encode((uint8_t*)s->gpu_cells, num, sizeof(GPUCell), s->compressed + cpu_sz);
+    s->compressed_sz = sz;
+    release_block(self, s->block); s->block = NULL; s->cpu_cells = NULL; s->gpu_cells = NULL;
+}
+
+static void
+queue_spill(HistoryBuf *self, index_type seg_num) {
+    if (!self->spill.limit) return;
+    ensure_space_for(&self->spill.pending, items, index_type, self->spill.pending.count + 1, capacity, 16, false);
+    self->spill.pending.items[self->spill.pending.count++] = seg_num;
+}
+
+static void
+read_back_from_disk(HistoryBuf *self, index_type seg_num) {
+    HistoryBufSegment *s = self->segments + seg_num;
+    s->on_disk = false;
+    if (!(s->compressed = malloc(s->compressed_sz))) fatal("Out of memory reading history buffer segment from disk");
+    if (!read_from_disk_cache_into(self->spill.disk_cache, &seg_num, sizeof(seg_num), s->compressed, s->compressed_sz)) {
+        log_error("Failed to read scrollback from disk cache, it will be blank");
+        free(s->compressed); s->compressed = NULL; s->compressed_sz = 0;
+        return;
+    }
+    remove_from_disk_cache(self->spill.disk_cache, &seg_num, sizeof(seg_num));
+}
+
+static void
+prefetch_from_disk(HistoryBuf *self, index_type seg_num) {
+    if (self->segments[seg_num].on_disk) disk_cache_prefetch(self->spill.disk_cache, &seg_num, sizeof(seg_num));
+}
+
+static void
+decompress_segment(HistoryBuf *self, index_type seg_num) {
+    HistoryBufSegment *s = self->segments + seg_num;
+    if (s->block) return;
+    if (s->on_disk) {
+        read_back_from_disk(self, seg_num);
+        // scrolling through spilled scrollback is likely to need the neighbouring segments next
+        if (self->num_segments > 1) {
+            prefetch_from_disk(self, (seg_num + 1) % self->num_segments);
+            prefetch_from_disk(self, (seg_num + self->num_segments - 1) % self->num_segments);
+        }
+    }
+    s->block = take_block(self);
+    set_cell_pointers(self, s);
+    if (s->compressed) {
+        const size_t num = self->xnum * SEGMENT_SIZE;
+        const uint8_t *p = rle_decode(s->compressed, num, sizeof(CPUCell), (uint8_t*)s->cpu_cells);
+        rle_decode(p, num, sizeof(GPUCell), (uint8_t*)s->gpu_cells);
+        free(s->compressed); s->compressed = NULL; s->compressed_sz = 0;
+    }
+}
+
+static void
+mark_segment_used(HistoryBuf *self, index_type seg_num) {
+    // Move seg_num to the front of the LRU list of hot segments, compressing
+    // the least recently used segment if it is full
+    if (LIKELY(self->num_hot_segments && self->hot_segments[0] == seg_num)) return;
+    unsigned i = 1;
+    while (i < self->num_hot_segments && self->hot_segments[i] != seg_num) i++;
+    if (i >= self->num_hot_segments) {
+        if (self->num_hot_segments >= arraysz(self->hot_segments)) {
+            const index_type cold = self->hot_segments[--self->num_hot_segments];
+            compress_segment(self, self->segments + cold);
+            if (self->segments[cold].compressed) queue_spill(self, cold);
+        }
+        decompress_segment(self, seg_num);
+        i = self->num_hot_segments++;
+    }
+    memmove(self->hot_segments + 1, self->hot_segments, i * sizeof(self->hot_segments[0]));
+    self->hot_segments[0] = seg_num;
 }
 
 static index_type
@@ -50,6 +359,7 @@ segment_for(HistoryBuf *self, index_type y) {
 
 #define seg_ptr(which, stride) { \
     index_type seg_num = segment_for(self, y); \
+    mark_segment_used(self, seg_num); \
     y -= seg_num * SEGMENT_SIZE; \
     return self->segments[seg_num].which + y * stride; \
 }
@@ -65,13 +375,175 @@ gpu_lineptr(HistoryBuf *self, index_type y) {
 }
 
 
+static bool
+discard_oldest_on_disk(HistoryBuf *self) {
+    // Make the oldest segment that is on disk blank, returns false if there is no such segment
+    const index_type first = (self->start_of_data / SEGMENT_SIZE) % self->num_segments;
+    for (index_type n = 0; n < self->num_segments; n++) {
+        index_type seg_num = (first + n) % self->num_segments;
+        HistoryBufSegment *s = self->segments + seg_num;
+        if (s->on_disk) {
+            remove_from_disk_cache(self->spill.disk_cache, &seg_num, sizeof(seg_num));
+            s->on_disk = false; s->compressed_sz = 0;
+            zero_at_ptr_count(s->line_attrs, SEGMENT_SIZE);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool
+spill_segment(HistoryBuf *self, index_type seg_num) {
+    HistoryBufSegment *s = self->segments + seg_num;
+    if (!s->compressed) return true;  // was used again since being queued
+    while (disk_cache_total_size(self->spill.disk_cache) + s->compressed_sz > self->spill.limit) {
+        if (!self->spill.discard_oldest || !discard_oldest_on_disk(self)) return false;
+    }
+    if (!add_to_disk_cache(self->spill.disk_cache, &seg_num, sizeof(seg_num), s->compressed, s->compressed_sz)) return false;
+    free(s->compressed); s->compressed = NULL; s->on_disk = true;
+    return true;
+}
+
+void
+historybuf_spill_to_disk(HistoryBuf *self) {
+    if (!self->spill.pending.count) return;
+    if (!self->spill.disk_cache && !(self->spill.disk_cache = create_disk_cache())) goto error;
+    for (size_t i = 0; i < self->spill.pending.count; i++) {
+        if (!spill_segment(self, self->spill.pending.items[i])) {
+            if (PyErr_Occurred()) goto error;
+            // the limit has been reached, leave the rest in RAM
+            break;
+        }
+    }
+    self->spill.pending.count = 0;
+    return;
+error:
+    PyErr_Print();
+    log_error("Failed to write scrollback to disk, keeping it in RAM");
+    self->spill.limit = 0; self->spill.pending.count = 0;
+}
+
+void
+historybuf_set_spill_limit(HistoryBuf *self, size_t limit, bool discard_oldest) {
+    self->spill.limit = limit; self->spill.discard_oldest = discard_oldest;
+}
+
+bool
+historybuf_visit_segment_cells(HistoryBuf *self, index_type seg_num, historybuf_cells_visitor visitor, void *data, bool modify) {
+    // Calls visitor with all the CPU cells of the segment, wherever they are
+    // stored, without changing the storage. In the compressed data every cell
+    // is stored verbatim, once per run, so it can be visited and modified in
+    // place. The cells are copied out as the compressed data is not aligned.
+    HistoryBufSegment *s = self->segments + seg_num;
+    const size_t num = self->xnum * SEGMENT_SIZE;
+    if (s->block) { visitor(s->cpu_cells, num, data); return true; }
+    uint8_t *compressed = s->compressed;
+    if (s->on_disk) {
+        if (!(compressed = malloc(s->compressed_sz))) return false;
+        if (!read_from_disk_cache_into(self->spill.disk_cache, &seg_num, sizeof(seg_num), compressed, s->compressed_sz)) { free(compressed); return false; }
+    }
+    if (!compressed) return true;  // blank segment
+    uint8_t *p = compressed;
+    CPUCell cells[256];
+    for (size_t i = 0; i < num;) {
+        uint32_t run;
+        memcpy(&run, p, sizeof(run)); p += sizeof(run);
+        if (run & LITERAL_RUN) {
+            run &= ~LITERAL_RUN;
+            i += run;
+            while (run) {
+                const size_t n = MIN((size_t)run, arraysz(cells)), sz = n * sizeof(cells[0]);
+                memcpy(cells, p, sz);
+                visitor(cells, n, data);
+                if (modify) memcpy(p, cells, sz);
+                p += sz; run -= n;
+            }
+        } else {
+            memcpy(cells, p, sizeof(cells[0]));
+            visitor(cells, 1, data);
+            if (modify) memcpy(p, cells, sizeof(cells[0]));
+            p += sizeof(cells[0]); i += run;
+        }
+    }
+    bool ok = true;
+    if (s->on_disk) {
+        if (modify && !add_to_disk_cache(self->spill.disk_cache, &seg_num, sizeof(seg_num), compressed, s->compressed_sz)) {
+            PyErr_Print();
+            ok = false;
+        }
+        free(compressed);
+    }
+    return ok;
+}
+
+HistoryBufMemoryUsage
+historybuf_memory_usage(const HistoryBuf *self) {
+    HistoryBufMemoryUsage ans = {.other=self->num_segments * sizeof(self->segments[0])};
+    for (index_type i = 0; i < self->num_segments; i++) {
+        const HistoryBufSegment *s = self->segments + i;
+        if (s->block) ans.cells += s->block->sz;
+        if (s->on_disk) ans.on_disk += s->compressed_sz;
+        else ans.compressed += s->compressed_sz;
+        if (s->line_attrs) ans.other += SEGMENT_SIZE * sizeof(s->line_attrs[0]);
+        if (s->search_index) ans.other += SEARCH_INDEX_WORDS * sizeof(s->search_index[0]);
+    }
+    for (unsigned i = 0; i < self->pool.count; i++) ans.cells += self->pool.blocks[i]->sz;
+    if (self->pagerhist && self->pagerhist->ringbuf) ans.pagerhist = ringbuf_capacity(self->pagerhist->ringbuf) + self->pagerhist->compressed_sz;
+    return ans;
+}
+
+size_t
+historybuf_release_memory(HistoryBuf *self) {
+    // Compresses the hot segments and frees the pool of blocks, returning
+    // roughly how many bytes were released. Segments are decompressed again
+    // as they are used.
+    if (self->pending_rewrap) return 0;
+    size_t freed = 0;
+    for (unsigned i = 0; i < self->num_hot_segments; i++) {
+        const index_type seg_num = self->hot_segments[i];
+        HistoryBufSegment *s = self->segments + seg_num;
+        compress_segment(self, s);
+        if (s->compressed) {
+            freed += cells_size(self) - s->compressed_sz;
+            queue_spill(self, seg_num);
+        }
+    }
+    // segments that did not compress well stay hot
+    unsigned num_hot = 0;
+    for (unsigned i = 0; i < self->num_hot_segments; i++) {
+        if (self->segments[self->hot_segments[i]].block) self->hot_segments[num_hot++] = self->hot_segments[i];
+    }
+    self->num_hot_segments = num_hot;
+    freed += self->pool.count * cells_size(self);
+    free_pool(self);
+    return freed;
+}
+
+void
+historybuf_blank_segment(HistoryBuf *self, index_type seg_num) {
+    HistoryBufSegment *s = self->segments + seg_num;
+    if (s->on_disk) remove_from_disk_cache(self->spill.disk_cache, &seg_num, sizeof(seg_num));
+    if (s->block) memset(s->block->mem, 0, cells_size(self));
+    free(s->compressed); s->compressed = NULL; s->compressed_sz = 0; s->on_disk = false;
+    zero_at_ptr_count(s->line_attrs, SEGMENT_SIZE);
+}
+
 static LineAttrs*
 attrptr(HistoryBuf *self, index_type y) {
-    seg_ptr(line_attrs, 1);
+    // line attributes are never compressed
+    index_type seg_num = segment_for(self, y);
+    return self->segments[seg_num].line_attrs + y - seg_num * SEGMENT_SIZE;
 }
 
+// The ringbuf holds the most recent data. When the pager history is allowed to
+// be larger than it, the ringbuf is compressed into a block whenever it fills
+// up, dropping the oldest blocks to stay within maximum_size, which is thus a
+// limit on memory used rather than on the amount of text. Small histories are
+// never compressed and work as a plain ring buffer.
+#define PAGERHIST_BLOCK_SIZE (1024u * 1024u)
+
 static size_t
-initial_pagerhist_ringbuf_sz(size_t pagerhist_sz) { return MIN(1024u * 1024u, pagerhist_sz); }
+initial_pagerhist_ringbuf_sz(size_t pagerhist_sz) { return MIN(PAGERHIST_BLOCK_SIZE, pagerhist_sz); }
 
 static PagerHistoryBuf*
 alloc_pagerhist(size_t pagerhist_sz) {
@@ -86,30 +558,94 @@ alloc_pagerhist(size_t pagerhist_sz) {
     return ph;
 }
 
+static void
+free_pagerhist_blocks(PagerHistoryBuf *ph) {
+    for (size_t i = 0; i < ph->num_blocks; i++) free(ph->blocks[i].data);
+    free(ph->blocks); ph->blocks = NULL;
+    ph->num_blocks = 0; ph->blocks_capacity = 0; ph->compressed_sz = 0; ph->uncompressed_sz = 0;
+}
+
 static void
 free_pagerhist(HistoryBuf *self) {
-    if (self->pagerhist && self->pagerhist->ringbuf) ringbuf_free((ringbuf_t*)&self->pagerhist->ringbuf);
+    if (self->pagerhist) {
+        free_pagerhist_blocks(self->pagerhist);
+        if (self->pagerhist->ringbuf) ringbuf_free((ringbuf_t*)&self->pagerhist->ringbuf);
+    }
     free(self->pagerhist);
     self->pagerhist = NULL;
 }
 
+static size_t
+pagerhist_bytes_used(const PagerHistoryBuf *ph) { return ph->uncompressed_sz + ringbuf_bytes_used(ph->ringbuf); }
+
+static size_t
+incomplete_utf8_suffix_length(const uint8_t *buf, size_t sz) {
+    for (size_t i = 1; i <= MIN(sz, 4u); i++) {
+        const uint8_t ch = buf[sz - i];
+        if ((ch & 0xc0) == 0x80) continue;
+        const size_t needed = ch >= 0xf0 ? 4 : (ch >= 0xe0 ? 3 : (ch >= 0xc0 ? 2 : 1));
+        return needed > i ? i : 0;
+    }
+    return 0;
+}
+
 static bool
-pagerhist_extend(PagerHistoryBuf *ph, size_t minsz) {
-    size_t buffer_size = ringbuf_capacity(ph->ringbuf);
-    if (buffer_size >= ph->maximum_size) return false;
-    size_t newsz = MIN(ph->maximum_size, buffer_size + MAX(1024u * 1024u, minsz));
-    ringbuf_t newbuf = ringbuf_new(newsz);
-    if (!newbuf) return false;
-    size_t count = ringbuf_bytes_used(ph->ringbuf);
-    if (count) ringbuf_copy(newbuf, ph->ringbuf, count);
-    ringbuf_free((ringbuf_t*)&ph->ringbuf);
-    ph->ringbuf = newbuf;
+pagerhist_compress_ringbuf(PagerHistoryBuf *ph) {
+    const size_t capacity = ringbuf_capacity(ph->ringbuf), used = ringbuf_bytes_used(ph->ringbuf);
+    if (capacity >= ph->maximum_size || !used) return false;
+    if (ph->num_blocks >= ph->blocks_capacity) {
+        size_t cap = MAX(16u, 2 * ph->blocks_capacity);
+        PagerHistoryBlock *blocks = realloc(ph->blocks, cap * sizeof(blocks[0]));
+        if (!blocks) return false;
+        ph->blocks = blocks; ph->blocks_capacity = cap;
+    }
+    uint8_t *src = malloc(used);
+    uLongf csz = compressBound(used);
+    uint8_t *dest = malloc(csz);
+    if (!src || !dest) { free(src); free(dest); return false; }
+    ringbuf_memcpy_from(src, ph->ringbuf, used);
+    // blocks must start on a character boundary so that dropping the oldest
+    // ones never leaves invalid UTF-8 at the start
+    const size_t incomplete = incomplete_utf8_suffix_length(src, used), sz = used - incomplete;
+    if (!sz || compress2(dest, &csz, src, sz, Z_BEST_SPEED) != Z_OK) { free(src); free(dest); return false; }
+    uint8_t *d = realloc(dest, csz);
+    if (d) dest = d;
+    ph->blocks[ph->num_blocks++] = (PagerHistoryBlock){.data=dest, .sz=csz, .uncompressed_sz=sz};
+    ph->compressed_sz += csz; ph->uncompressed_sz += sz;
+    ringbuf_reset(ph->ringbuf);
+    if (incomplete) ringbuf_memcpy_into(ph->ringbuf, src + sz, incomplete);
+    free(src);
+    size_t num_to_drop = 0;
+    while (num_to_drop < ph->num_blocks && ph->compressed_sz + capacity > ph->maximum_size) {
+        PagerHistoryBlock *b = ph->blocks + num_to_drop++;
+        ph->compressed_sz -= b->sz; ph->uncompressed_sz -= b->uncompressed_sz;
+        free(b->data);
+    }
+    if (num_to_drop) {
+        ph->num_blocks -= num_to_drop;
+        memmove(ph->blocks, ph->blocks + num_to_drop, ph->num_blocks * sizeof(ph->blocks[0]));
+    }
+    return true;
+}
+
+// Fills buf, which must be pagerhist_bytes_used() long, decompressing every
+// block directly into it
+static bool
+pagerhist_copy_to(PagerHistoryBuf *ph, uint8_t *buf) {
+    for (size_t i = 0; i < ph->num_blocks; i++) {
+        const PagerHistoryBlock *b = ph->blocks + i;
+        uLongf sz = b->uncompressed_sz;
+        if (uncompress(buf, &sz, b->data, b->sz) != Z_OK || sz != b->uncompressed_sz) return false;
+        buf += sz;
+    }
+    ringbuf_memcpy_from(buf, ph->ringbuf, ringbuf_bytes_used(ph->ringbuf));
     return true;
 }
 
 static void
 pagerhist_clear(HistoryBuf *self) {
     if (self->pagerhist && self->pagerhist->ringbuf) {
+        free_pagerhist_blocks(self->pagerhist);
         ringbuf_reset(self->pagerhist->ringbuf);
         size_t rsz = initial_pagerhist_ringbuf_sz(self->pagerhist->maximum_size);
         void *rbuf = ringbuf_new(rsz);
@@ -136,6 +672,7 @@ create_historybuf(PyTypeObject *type, unsigned int xnum, unsigned int ynum, unsi
         self->line = alloc_line(self->text_cache);
         self->line->xnum = xnum;
         self->pagerhist = alloc_pagerhist(pagerhist_sz);
+        if (self->pagerhist) self->pagerhist->wrapped_at = xnum;
     }
     return self;
 }
@@ -143,19 +680,25 @@ create_historybuf(PyTypeObject *type, unsigned int xnum, unsigned int ynum, unsi
 static PyObject *
 new_history_object(PyTypeObject *type, PyObject *args, PyObject UNUSED *kwds) {
     unsigned int xnum = 1, ynum = 1, pagerhist_sz = 0;
-    if (!PyArg_ParseTuple(args, "II|I", &ynum, &xnum, &pagerhist_sz)) return NULL;
+    unsigned long long spill_limit = 0; int discard_oldest = 0;
+    if (!PyArg_ParseTuple(args, "II|IKp", &ynum, &xnum, &pagerhist_sz, &spill_limit, &discard_oldest)) return NULL;
     TextCache *tc = tc_alloc();
     if (!tc) return PyErr_NoMemory();
     HistoryBuf *ans = create_historybuf(type, xnum, ynum, pagerhist_sz, tc);
     tc_decref(tc);
+    if (ans) historybuf_set_spill_limit(ans, spill_limit, discard_oldest);
     return (PyObject*)ans;
 }
 
 static void
 dealloc(HistoryBuf* self) {
+    free_pending_rewrap(self->pending_rewrap); self->pending_rewrap = NULL;
     Py_CLEAR(self->line);
     for (size_t i = 0; i < self->num_segments; i++) free_segment(self->segments + i);
     free(self->segments);
+    free_pool(self);
+    free(self->spill.pending.items);
+    Py_CLEAR(self->spill.disk_cache);
     free_pagerhist(self);
     tc_decref(self->text_cache);
     Py_TYPE(self)->tp_free((PyObject*)self);
@@ -201,6 +744,12 @@ historybuf_is_line_continued(HistoryBuf *self, index_type lnum) {
     return hb_line_is_continued(self, index_of(self, lnum));
 }
 
+LineAttrs
+historybuf_line_attrs(HistoryBuf *self, index_type lnum) {
+    // line attributes are never compressed so this is cheap
+    return *attrptr(self, index_of(self, lnum));
+}
+
 bool
 history_buf_endswith_wrap(HistoryBuf *self) {
     return cpu_lineptr(self, index_of(self, 0))[self->xnum-1].next_char_was_wrapped;
@@ -228,22 +777,36 @@ historybuf_set_line_has_image_placeholders(HistoryBuf *self, index_type y, bool
 
 void
 historybuf_clear(HistoryBuf *self) {
+    free_pending_rewrap(self->pending_rewrap); self->pending_rewrap = NULL;
     pagerhist_clear(self);
     self->count = 0;
     self->start_of_data = 0;
-    for (size_t i = 0; i < self->num_segments; i++) free_segment(self->segments + i);
+    for (size_t i = 0; i < self->num_segments; i++) {
+        HistoryBufSegment *s = self->segments + i;
+        if (s->block) { release_block(self, s->block); s->block = NULL; }
+        free_segment(s);
+    }
     free(self->segments); self->segments = NULL;
-    self->num_segments = 0;
+    self->num_segments = 0; self->num_hot_segments = 0;
+    self->spill.pending.count = 0;
+    if (self->spill.disk_cache) clear_disk_cache(self->spill.disk_cache);
     add_segment(self, 1);
 }
 
 static bool
 pagerhist_write_bytes(PagerHistoryBuf *ph, const uint8_t *buf, size_t sz) {
     if (sz > ph->maximum_size) return false;
-    if (!sz) return true;
-    size_t space_in_ringbuf = ringbuf_bytes_free(ph->ringbuf);
-    if (sz > space_in_ringbuf) pagerhist_extend(ph, sz);
-    ringbuf_memcpy_into(ph->ringbuf, buf, sz);
+    while (sz) {
+        size_t n = MIN(sz, ringbuf_bytes_free(ph->ringbuf));
+        if (!n) {
+            if (pagerhist_compress_ringbuf(ph)) continue;
+            // overwrite the oldest data, blocks, if any, are no longer contiguous with it
+            if (ph->num_blocks) free_pagerhist_blocks(ph);
+            n = sz;
+        }
+        ringbuf_memcpy_into(ph->ringbuf, buf, n);
+        buf += n; sz -= n;
+    }
     return true;
 }
 
@@ -281,6 +844,7 @@ static void
 pagerhist_push(HistoryBuf *self, ANSIBuf *as_ansi_buf) {
     PagerHistoryBuf *ph = self->pagerhist;
     if (!ph) return;
+    if (ph->wrapped_at != self->xnum) ph->wrapped_at = pagerhist_bytes_used(ph) ? 0 : self->xnum;
     Line l = {.xnum=self->xnum, .text_cache=self->text_cache};
     init_line(self, self->start_of_data, &l);
     ANSILineState s = {.output_buf=as_ansi_buf};
@@ -297,11 +861,17 @@ pagerhist_push(HistoryBuf *self, ANSIBuf *as_ansi_buf) {
 
 static index_type
 historybuf_push(HistoryBuf *self, ANSIBuf *as_ansi_buf, bool *needs_clear) {
+    // The lines still being rewrapped are older than the line about to
+    // scroll off, so they must go to the pager history first
+    if (self->count == self->ynum && self->pending_rewrap) historybuf_finish_pending_rewrap(self);
     index_type idx = (self->start_of_data + self->count) % self->ynum;
+    if (idx % SEGMENT_SIZE == SEGMENT_SIZE - PREFAULT_AHEAD_LINES) ensure_block_available(self);
     if (self->count == self->ynum) {
         pagerhist_push(self, as_ansi_buf);
         self->start_of_data = (self->start_of_data + 1) % self->ynum;
         *needs_clear = true;
+        // the segment is about to be overwritten, its index will be rebuilt when next needed
+        if (idx % SEGMENT_SIZE == 0) drop_search_index(self->segments + idx / SEGMENT_SIZE);
     } else {
         self->count++;
         *needs_clear = false;
@@ -316,10 +886,17 @@ historybuf_add_line(HistoryBuf *self, const Line *line, ANSIBuf *as_ansi_buf) {
     init_line(self, idx, self->line);
     copy_line(line, self->line);
     *attrptr(self, idx) = line->attrs;
+    uint64_t *search_index = self->segments[idx / SEGMENT_SIZE].search_index;
+    if (search_index) {
+        Line prev = {.xnum=self->xnum, .text_cache=self->text_cache};
+        if (self->count > 1) prev.cpu_cells = cpu_lineptr(self, (idx + self->ynum - 1) % self->ynum);
+        search_index_add_line(search_index, self->line, prev.cpu_cells && prev.cpu_cells[self->xnum - 1].next_char_was_wrapped ? &prev : NULL);
+    }
 }
 
 bool
 historybuf_pop_line(HistoryBuf *self, Line *line) {
+    if (self->count <= 0) historybuf_finish_pending_rewrap(self);
     if (self->count <= 0) return false;
     index_type idx = (self->start_of_data + self->count - 1) % self->ynum;
     init_line(self, idx, line);
@@ -354,6 +931,7 @@ historybuf_delete_newest_lines(HistoryBuf *self, index_type count) {
 static PyObject*
 line(HistoryBuf *self, PyObject *val) {
 #define line_doc "Return the line with line number val. This buffer grows upwards, i.e. 0 is the most recently added line"
+    historybuf_finish_pending_rewrap(self);
     if (self->count == 0) { PyErr_SetString(PyExc_IndexError, "This buffer is empty"); return NULL; }
     index_type lnum = PyLong_AsUnsignedLong(val);
     if (lnum >= self->count) { PyErr_SetString(PyExc_IndexError, "Out of bounds"); return NULL; }
@@ -364,6 +942,7 @@ line(HistoryBuf *self, PyObject *val) {
 
 static PyObject*
 __str__(HistoryBuf *self) {
+    historybuf_finish_pending_rewrap(self);
     PyObject *lines = PyTuple_New(self->count);
     if (lines == NULL) return PyErr_NoMemory();
     RAII_ANSIBuf(buf);
@@ -387,12 +966,14 @@ push(HistoryBuf *self, PyObject *args) {
     ANSIBuf as_ansi_buf = {0};
     historybuf_add_line(self, line, &as_ansi_buf);
     free(as_ansi_buf.buf);
+    historybuf_spill_to_disk(self);
     Py_RETURN_NONE;
 }
 
 static PyObject*
 as_ansi(HistoryBuf *self, PyObject *callback) {
 #define as_ansi_doc "as_ansi(callback) -> The contents of this buffer as ANSI escaped text. callback is called with each successive line."
+    historybuf_finish_pending_rewrap(self);
     Line l = {.xnum=self->xnum, .text_cache=self->text_cache};
     ANSIBuf output = {0}; ANSILineState s = {.output_buf=&output};
     for(unsigned int i = 0; i < self->count; i++) {
@@ -416,62 +997,76 @@ end:
     Py_RETURN_NONE;
 }
 
-static char_type
-pagerhist_remove_char(PagerHistoryBuf *ph, unsigned *count, uint8_t record[8]) {
-    uint32_t codep; UTF8State state = UTF8_ACCEPT;
-    *count = 0;
-    size_t num = ringbuf_bytes_used(ph->ringbuf);
-    while (num--) {
-        record[*count] = ringbuf_move_char(ph->ringbuf);
-        decode_utf8(&state, &codep, record[*count]);
-        *count += 1;
-        if (state == UTF8_REJECT) { codep = 0; break; }
-        if (state == UTF8_ACCEPT) break;
+typedef struct PagerhistRewrap {
+    PagerHistoryBuf *nph;
+    index_type cells_in_line, num_in_current_line;
+    WCSState wcs_state;
+    UTF8State state;
+    uint32_t codep;
+    uint8_t record[8];
+    unsigned count;
+} PagerhistRewrap;
+
+static void
+pagerhist_rewrap_char(PagerhistRewrap *r, char_type ch) {
+    ssize_t ch_width;
+#define WRITE_CHAR() { \
+    if (r->num_in_current_line + ch_width > r->cells_in_line) { \
+        pagerhist_write_bytes(r->nph, (const uint8_t*)"\r", 1); \
+        r->num_in_current_line = 0; \
+    }\
+    if (ch_width >= 0 || (int)r->num_in_current_line >= -ch_width) r->num_in_current_line += ch_width; \
+    pagerhist_write_bytes(r->nph, r->record, r->count); \
+}
+    if (ch == '\n') {
+        initialize_wcs_state(&r->wcs_state);
+        ch_width = 1;
+        WRITE_CHAR();
+        r->num_in_current_line = 0;
+    } else if (ch != '\r') {
+        ch_width = wcswidth_step(&r->wcs_state, ch);
+        WRITE_CHAR();
+    }
+#undef WRITE_CHAR
+}
+
+static void
+pagerhist_rewrap_bytes(PagerhistRewrap *r, const uint8_t *buf, size_t sz) {
+    for (size_t i = 0; i < sz; i++) {
+        r->record[r->count++] = buf[i];
+        decode_utf8(&r->state, &r->codep, buf[i]);
+        if (r->state == UTF8_REJECT) { r->state = UTF8_ACCEPT; r->codep = 0; }
+        else if (r->state != UTF8_ACCEPT) continue;
+        pagerhist_rewrap_char(r, r->codep);
+        r->count = 0;
     }
-    return codep;
 }
 
 static void
 pagerhist_rewrap_to(HistoryBuf *self, index_type cells_in_line) {
     PagerHistoryBuf *ph = self->pagerhist;
-    if (!ph->ringbuf || !ringbuf_bytes_used(ph->ringbuf)) return;
-    PagerHistoryBuf *nph = calloc(1, sizeof(PagerHistoryBuf));
-    if (!nph) return;
-    nph->maximum_size = ph->maximum_size;
-    nph->ringbuf = ringbuf_new(MIN(ph->maximum_size, ringbuf_capacity(ph->ringbuf) + 4096));
-    if (!nph->ringbuf) { free(nph); return ; }
-    ssize_t ch_width = 0;
-    unsigned count;
-    uint8_t record[8];
-    index_type num_in_current_line = 0;
-    char_type ch;
-    WCSState wcs_state;
-    initialize_wcs_state(&wcs_state);
-
-#define WRITE_CHAR() { \
-    if (num_in_current_line + ch_width > cells_in_line) { \
-        pagerhist_write_bytes(nph, (const uint8_t*)"\r", 1); \
-        num_in_current_line = 0; \
-    }\
-    if (ch_width >= 0 || (int)num_in_current_line >= -ch_width) num_in_current_line += ch_width; \
-    pagerhist_write_bytes(nph, record, count); \
-}
-
-    while (ringbuf_bytes_used(ph->ringbuf)) {
-        ch = pagerhist_remove_char(ph, &count, record);
-        if (ch == '\n') {
-            initialize_wcs_state(&wcs_state);
-            ch_width = 1;
-            WRITE_CHAR();
-            num_in_current_line = 0;
-        } else if (ch != '\r') {
-            ch_width = wcswidth_step(&wcs_state, ch);
-            WRITE_CHAR();
-        }
+    if (!ph->ringbuf || !pagerhist_bytes_used(ph)) return;
+    PagerhistRewrap r = {.cells_in_line=cells_in_line, .nph=alloc_pagerhist(ph->maximum_size)};
+    if (!r.nph) return;
+    r.nph->wrapped_at = cells_in_line;
+    initialize_wcs_state(&r.wcs_state);
+    // decompress one block at a time to keep peak memory usage low
+    for (size_t i = 0; i < ph->num_blocks; i++) {
+        const PagerHistoryBlock *b = ph->blocks + i;
+        uint8_t *buf = malloc(b->uncompressed_sz);
+        uLongf sz = b->uncompressed_sz;
+        if (!buf || uncompress(buf, &sz, b->data, b->sz) != Z_OK) { free(buf); continue; }
+        pagerhist_rewrap_bytes(&r, buf, sz);
+        free(buf);
+    }
+    uint8_t chunk[4096];
+    size_t sz;
+    while ((sz = MIN(sizeof(chunk), ringbuf_bytes_used(ph->ringbuf)))) {
+        ringbuf_memmove_from(chunk, ph->ringbuf, sz);
+        pagerhist_rewrap_bytes(&r, chunk, sz);
     }
     free_pagerhist(self);
-    self->pagerhist = nph;
-#undef WRITE_CHAR
+    self->pagerhist = r.nph;
 }
 
 static PyObject*
@@ -500,20 +1095,40 @@ reverse_find(const uint8_t *haystack, size_t haystack_sz, const uint8_t *needle)
     return NULL;
 }
 
+static size_t
+pagerhist_prepare_for_reading(HistoryBuf *self) {
+#define ph self->pagerhist
+    if (!ph || !pagerhist_bytes_used(ph)) return 0;
+    // blocks always start on a character boundary
+    if (!ph->num_blocks) pagerhist_ensure_start_is_valid_utf8(ph);
+    if (ph->rewrap_needed) pagerhist_rewrap_to(self, self->xnum);
+    return pagerhist_bytes_used(ph);
+#undef ph
+}
+
+uint8_t*
+historybuf_pagerhist_as_utf8(HistoryBuf *self, size_t *sz) {
+    if (!(*sz = pagerhist_prepare_for_reading(self))) return NULL;
+    uint8_t *ans = malloc(*sz);
+    if (ans && !pagerhist_copy_to(self->pagerhist, ans)) { free(ans); ans = NULL; *sz = 0; }
+    return ans;
+}
+
 static PyObject*
 pagerhist_as_bytes(HistoryBuf *self, PyObject *args) {
     int upto_output_start = 0;
     if (!PyArg_ParseTuple(args, "|p", &upto_output_start)) return NULL;
 #define ph self->pagerhist
-    if (!ph || !ringbuf_bytes_used(ph->ringbuf)) return PyBytes_FromStringAndSize("", 0);
-    pagerhist_ensure_start_is_valid_utf8(ph);
-    if (ph->rewrap_needed) pagerhist_rewrap_to(self, self->xnum);
-
-    size_t sz = ringbuf_bytes_used(ph->ringbuf);
+    const size_t sz = pagerhist_prepare_for_reading(self);
+    if (!sz) return PyBytes_FromStringAndSize("", 0);
     PyObject *ans = PyBytes_FromStringAndSize(NULL, sz);
     if (!ans) return NULL;
     uint8_t *buf = (uint8_t*)PyBytes_AS_STRING(ans);
-    ringbuf_memcpy_from(buf, ph->ringbuf, sz);
+    if (!pagerhist_copy_to(ph, buf)) {
+        Py_DECREF(ans);
+        PyErr_SetString(PyExc_RuntimeError, "Failed to decompress the pager history");
+        return NULL;
+    }
     if (upto_output_start) {
         const uint8_t *p = reverse_find(buf, sz, (const uint8_t*)"\x1b]133;C\x1b\\");
         if (p) {
@@ -556,6 +1171,7 @@ get_line_wrapper(void *x, int y) {
 
 PyObject*
 as_text_history_buf(HistoryBuf *self, PyObject *args, ANSIBuf *output) {
+    historybuf_finish_pending_rewrap(self);
     GetLineWrapper glw = {.self=self};
     glw.line.xnum = self->xnum;
     glw.line.text_cache = self->text_cache;
@@ -622,6 +1238,26 @@ static PyMethodDef methods[] = {
     {NULL, NULL, 0, NULL}  /* Sentinel */
 };
 
+static PyObject*
+compressed_segments(HistoryBuf *self, void *closure UNUSED) {
+    unsigned long ans = 0;
+    for (index_type i = 0; i < self->num_segments; i++) if (self->segments[i].compressed) ans++;
+    return PyLong_FromUnsignedLong(ans);
+}
+
+static PyObject*
+spilled_segments(HistoryBuf *self, void *closure UNUSED) {
+    unsigned long ans = 0;
+    for (index_type i = 0; i < self->num_segments; i++) if (self->segments[i].on_disk) ans++;
+    return PyLong_FromUnsignedLong(ans);
+}
+
+static PyGetSetDef getsetters[] = {
+    {"compressed_segments", (getter)compressed_segments, NULL, "The number of segments currently stored compressed", NULL},
+    {"spilled_segments", (getter)spilled_segments, NULL, "The number of segments currently stored compressed on disk", NULL},
+    {NULL}  /* Sentinel */
+};
+
 static PyMemberDef members[] = {
     {"xnum", T_UINT, offsetof(HistoryBuf, xnum), READONLY, "xnum"},
     {"ynum", T_UINT, offsetof(HistoryBuf, ynum), READONLY, "ynum"},
@@ -638,6 +1274,7 @@ PyTypeObject HistoryBuf_Type = {
     .tp_doc = "History buffers",
     .tp_methods = methods,
     .tp_members = members,
+    .tp_getset = getsetters,
     .tp_str = (reprfunc)__str__,
     .tp_new = new_history_object
 };
@@ -662,6 +1299,7 @@ historybuf_next_dest_line(HistoryBuf *self, ANSIBuf *as_ansi_buf, Line *src_line
     history_buf_set_last_char_as_continuation(self, 0, continued);
     bool needs_clear;
     index_type idx = historybuf_push(self, as_ansi_buf, &needs_clear);
+    drop_search_index(self->segments + idx / SEGMENT_SIZE);
     *attrptr(self, idx) = src_line->attrs;
     init_line(self, idx, dest_line);
     if (needs_clear) {
@@ -678,6 +1316,7 @@ historybuf_alloc_for_rewrap(unsigned int columns, HistoryBuf *self) {
     if (ans) {
         if (ans->num_segments < self->num_segments) add_segment(ans, self->num_segments - ans->num_segments);
         ans->count = 0; ans->start_of_data = 0;
+        historybuf_set_spill_limit(ans, self->spill.limit, self->spill.discard_oldest);
     }
     return ans;
 }
@@ -686,30 +1325,211 @@ void
 historybuf_finish_rewrap(HistoryBuf *dest, HistoryBuf *src) {
     for (index_type i = 0; i < dest->count; i++) attrptr(dest, (dest->start_of_data + i) % dest->ynum)->has_dirty_text = true;
     dest->pagerhist = src->pagerhist; src->pagerhist = NULL;
-    if (dest->pagerhist && dest->xnum != src->xnum && ringbuf_bytes_used(dest->pagerhist->ringbuf)) dest->pagerhist->rewrap_needed = true;
+    // the rewrap is deferred until the pager history is next read and is not
+    // needed at all when resizing back to the width it is wrapped at
+    if (dest->pagerhist) dest->pagerhist->rewrap_needed = dest->xnum != dest->pagerhist->wrapped_at && pagerhist_bytes_used(dest->pagerhist);
+}
+
+static bool
+is_hot_segment(const HistoryBuf *self, index_type seg_num) {
+    for (unsigned i = 0; i < self->num_hot_segments; i++) if (self->hot_segments[i] == seg_num) return true;
+    return false;
+}
+
+static void
+copy_uncompressed_segment(HistoryBuf *dest, const HistoryBuf *src, index_type seg_num) {
+    // goes through the LRU so that, as for newly added lines, only the few
+    // most recently used segments of dest stay uncompressed
+    mark_segment_used(dest, seg_num);
+    memcpy(dest->segments[seg_num].block->mem, src->segments[seg_num].block->mem, cells_size(src));
 }
 
 void
 historybuf_fast_rewrap(HistoryBuf *dest, HistoryBuf *src) {
+    // dest is freshly allocated so all its segments are blank and not hot
     for (index_type i = 0; i < src->num_segments; i++) {
-        memcpy(dest->segments[i].cpu_cells, src->segments[i].cpu_cells, SEGMENT_SIZE * src->xnum * sizeof(CPUCell));
-        memcpy(dest->segments[i].gpu_cells, src->segments[i].gpu_cells, SEGMENT_SIZE * src->xnum * sizeof(GPUCell));
-        memcpy(dest->segments[i].line_attrs, src->segments[i].line_attrs, SEGMENT_SIZE * sizeof(LineAttrs));
+        HistoryBufSegment *s = src->segments + i, *d = dest->segments + i;
+        memcpy(d->line_attrs, s->line_attrs, SEGMENT_SIZE * sizeof(LineAttrs));
+        if (s->block) {
+            // the hot segments of src are copied last, below, so that they
+            // end up hot in dest as well
+            if (!is_hot_segment(src, i)) copy_uncompressed_segment(dest, src, i);
+        } else if (s->compressed || s->on_disk) {
+            if (!(d->compressed = malloc(s->compressed_sz))) fatal("Out of memory copying history buffer segment");
+            d->compressed_sz = s->compressed_sz;
+            if (s->compressed) memcpy(d->compressed, s->compressed, s->compressed_sz);
+            else if (!read_from_disk_cache_into(src->spill.disk_cache, &i, sizeof(i), d->compressed, d->compressed_sz)) {
+                log_error("Failed to read scrollback from disk cache, it will be blank");
+                free(d->compressed); d->compressed = NULL; d->compressed_sz = 0;
+            }
+            if (d->compressed) queue_spill(dest, i);
+        }
     }
+    for (unsigned i = src->num_hot_segments; i-- > 0;) copy_uncompressed_segment(dest, src, src->hot_segments[i]);
     dest->count = src->count; dest->start_of_data = src->start_of_data;
 }
 
+index_type
+historybuf_add_older_lines(HistoryBuf *self, HistoryBuf *older, ANSIBuf *as_ansi_buf) {
+    // Put the lines of older, which must have the same number of columns,
+    // before the lines of self. Returns the number of lines of older that
+    // were kept, the oldest lines that do not fit go to the pager history of
+    // self, as when lines scroll off. older is left with the storage of self
+    // and must be discarded.
+    const index_type kept = MIN(older->count, self->ynum - self->count);
+    Line l = {.xnum=self->xnum, .text_cache=self->text_cache};
+    SWAP(self->pagerhist, older->pagerhist);
+    for (index_type lnum = self->count; lnum-- > 0;) {
+        init_line(self, index_of(self, lnum), &l);
+        historybuf_add_line(older, &l, as_ansi_buf);
+    }
+    SWAP(self->pagerhist, older->pagerhist);
+    SWAP(self->segments, older->segments); SWAP(self->num_segments, older->num_segments);
+    SWAP(self->start_of_data, older->start_of_data); SWAP(self->count, older->count);
+    for (unsigned i = 0; i < arraysz(self->hot_segments); i++) SWAP(self->hot_segments[i], older->hot_segments[i]);
+    SWAP(self->num_hot_segments, older->num_hot_segments);
+    SWAP(self->pool, older->pool); SWAP(self->spill, older->spill);
+    return kept;
+}
+
+index_type
+historybuf_segment_run(HistoryBuf *self, index_type lnum, index_type *seg_num) {
+    const index_type idx = index_of(self, lnum);
+    *seg_num = idx / SEGMENT_SIZE;
+    return MIN(MIN(SEGMENT_SIZE - idx % SEGMENT_SIZE, self->ynum - idx), lnum + 1);
+}
+
+// Reader {{{
+// Gives read only access to the lines of a HistoryBuf without changing which
+// segments are hot, so that several threads can read from it at the same
+// time, without the GIL, as long as the HistoryBuf is not modified. Each
+// reader decodes lines into its own small buffers, a line remains valid until
+// lines far from it have been read twice.
+
+#define READER_LINES 256u
+static_assert(SEGMENT_SIZE % READER_LINES == 0, "READER_LINES must divide SEGMENT_SIZE");
+
+static size_t
+reader_slot_size(const HistoryBuf *self) { return (size_t)self->xnum * READER_LINES * (sizeof(CPUCell) + sizeof(GPUCell)); }
+
+bool
+historybuf_reader_init(HistoryBufReader *r, HistoryBuf *hb) {
+    zero_at_ptr(r);
+    r->hb = hb;
+    for (unsigned i = 0; i < arraysz(r->slots); i++) {
+        r->slots[i].first_line = UINT32_MAX;
+        if (!(r->slots[i].buf = malloc(reader_slot_size(hb)))) { historybuf_reader_free(r); return false; }
+    }
+    return true;
+}
+
+void
+historybuf_reader_free(HistoryBufReader *r) {
+    for (unsigned i = 0; i < arraysz(r->slots); i++) { free(r->slots[i].buf); r->slots[i].buf = NULL; }
+    free(r->from_disk.data); r->from_disk.data = NULL;
+}
+
+static const uint8_t*
+rle_decode_range(const uint8_t *src, size_t num, size_t cell_sz, size_t first, size_t count, uint8_t *dest) {
+    // Like rle_decode() but only the cells [first, first + count) are written to dest
+    for (size_t i = 0; i < num;) {
+        uint32_t run;
+        memcpy(&run, src, sizeof(run)); src += sizeof(run);
+        if (run & LITERAL_RUN) {
+            run &= ~LITERAL_RUN;
+            const size_t lo = MAX(i, first), hi = MIN(MIN(num, i + run), first + count);
+            if (lo < hi) memcpy(dest + (lo - first) * cell_sz, src + (lo - i) * cell_sz, (hi - lo) * cell_sz);
+            src += run * cell_sz; i += run;
+            continue;
+        }
+        const size_t lo = MAX(i, first), hi = MIN(MIN(num, i + run), first + count);
+        for (size_t x = lo; x < hi; x++) memcpy(dest + (x - first) * cell_sz, src, cell_sz);
+        src += cell_sz; i += run;
+    }
+    return src;
+}
+
+static void
+reader_decode(HistoryBufReader *r, index_type seg_num, index_type first_line, uint8_t *dest) {
+    HistoryBuf *self = r->hb;
+    const HistoryBufSegment *s = self->segments + seg_num;
+    const size_t num = self->xnum * SEGMENT_SIZE, first = (size_t)first_line * self->xnum, count = (size_t)READER_LINES * self->xnum;
+    uint8_t *gpu_dest = dest + count * sizeof(CPUCell);
+    if (s->block) {
+        memcpy(dest, s->cpu_cells + first, count * sizeof(CPUCell));
+        memcpy(gpu_dest, s->gpu_cells + first, count * sizeof(GPUCell));
+        return;
+    }
+    const uint8_t *compressed = s->compressed;
+    if (s->on_disk) {
+        if (r->from_disk.seg_num != seg_num || !r->from_disk.data) {
+            free(r->from_disk.data);
+            r->from_disk.seg_num = seg_num;
+            if (!(r->from_disk.data = malloc(s->compressed_sz))) fatal("Out of memory reading history buffer segment from disk");
+            if (!read_from_disk_cache_into(self->spill.disk_cache, &seg_num, sizeof(seg_num), r->from_disk.data, s->compressed_sz)) {
+                log_error("Failed to read scrollback from disk cache, it will be blank");
+                free(r->from_disk.data); r->from_disk.data = NULL;
+            }
+        }
+        compressed = r->from_disk.data;
+    }
+    if (compressed) {
+        const uint8_t *p = rle_decode_range(compressed, num, sizeof(CPUCell), first, count, dest);
+        rle_decode_range(p, num, sizeof(GPUCell), first, count, gpu_dest);
+    } else memset(dest, 0, reader_slot_size(self));
+}
+
+void
+historybuf_reader_init_line(HistoryBufReader *r, index_type lnum, Line *l) {
+    HistoryBuf *self = r->hb;
+    const index_type y = index_of(self, lnum), first_line = y - y % READER_LINES;
+    unsigned slot = r->slots[0].first_line == first_line ? 0 : (r->slots[1].first_line == first_line ? 1 : 2);
+    if (slot > 1) {
+        slot = r->least_recently_used;
+        r->slots[slot].first_line = first_line;
+        const index_type seg_num = y / SEGMENT_SIZE;
+        reader_decode(r, seg_num, first_line - seg_num * SEGMENT_SIZE, r->slots[slot].buf);
+    }
+    r->least_recently_used = 1 - slot;
+    const size_t offset = (size_t)(y - first_line) * self->xnum;
+    l->cpu_cells = (CPUCell*)r->slots[slot].buf + offset;
+    l->gpu_cells = (GPUCell*)(r->slots[slot].buf + (size_t)self->xnum * READER_LINES * sizeof(CPUCell)) + offset;
+    l->attrs = self->segments[y / SEGMENT_SIZE].line_attrs[y % SEGMENT_SIZE];
+}
+// }}}
+
+const uint64_t*
+historybuf_search_index(HistoryBuf *self, index_type seg_num, HistoryBufReader *r) {
+    HistoryBufSegment *s = self->segments + seg_num;
+    if (s->search_index) return s->search_index;
+    if (!(s->search_index = calloc(SEARCH_INDEX_WORDS, sizeof(s->search_index[0])))) return NULL;
+    Line l = {.xnum=self->xnum, .text_cache=self->text_cache}, prev = l;
+    const index_type limit = MIN((seg_num + 1) * SEGMENT_SIZE, self->ynum);
+    for (index_type idx = seg_num * SEGMENT_SIZE; idx < limit; idx++) {
+        // y counts from the oldest line
+        const index_type y = (idx + self->ynum - self->start_of_data) % self->ynum;
+        if (y >= self->count) continue;
+        bool continued = false;
+        if (y) {
+            historybuf_reader_init_line(r, self->count - y, &prev);
+            continued = prev.cpu_cells[self->xnum - 1].next_char_was_wrapped;
+        }
+        historybuf_reader_init_line(r, self->count - y - 1, &l);
+        search_index_add_line(s->search_index, &l, continued ? &prev : NULL);
+    }
+    return s->search_index;
+}
 
 static PyObject*
 rewrap(HistoryBuf *self, PyObject *args) {
-    unsigned xnum;
-    if (!PyArg_ParseTuple(args, "I", &xnum)) return NULL;
+    unsigned xnum; int serial = 0;
+    if (!PyArg_ParseTuple(args, "I|p", &xnum, &serial)) return NULL;
     ANSIBuf as_ansi_buf = {0};
     LineBuf *dummy = alloc_linebuf(4, self->xnum, self->text_cache);
     if (!dummy) return PyErr_NoMemory();
     RAII_PyObject(cleanup, (PyObject*)dummy); (void)cleanup;
     TrackCursor cursors[1] = {{.is_sentinel=true}};
-    ResizeResult r = resize_screen_buffers(dummy, self, 8, xnum, &as_ansi_buf, cursors);
+    ResizeResult r = resize_screen_buffers(dummy, self, 8, xnum, &as_ansi_buf, cursors, false, serial);
     free(as_ansi_buf.buf);
     if (!r.ok) return PyErr_NoMemory();
     Py_CLEAR(r.lb);
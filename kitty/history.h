@@ -9,20 +9,49 @@
 
 #include "line.h"
 
+typedef struct ArenaBlock ArenaBlock;
+typedef struct PendingRewrap PendingRewrap;
+
 typedef struct {
     GPUCell *gpu_cells;
     CPUCell *cpu_cells;
     LineAttrs *line_attrs;
-    void *mem;
+    // the cells when uncompressed, cpu_cells and gpu_cells point into it
+    ArenaBlock *block;
+    uint8_t *compressed;
+    // when on_disk the compressed data is stored in the disk cache
+    size_t compressed_sz;
+    bool on_disk;
+    // see search.h, NULL until the segment is first searched
+    uint64_t *search_index;
 } HistoryBufSegment;
 
 typedef struct {
+    uint8_t *data;
+    size_t sz, uncompressed_sz;
+} PagerHistoryBlock;
+
+typedef struct {
+    // the most recent data, uncompressed
     void *ringbuf;
+    // older data with the ringbuf contents compressed into a block every
+    // time it fills up, oldest first
+    PagerHistoryBlock *blocks;
+    size_t num_blocks, blocks_capacity, compressed_sz, uncompressed_sz;
     size_t maximum_size;
+    // the width the stored lines are wrapped at, zero if lines of different
+    // widths are present
+    index_type wrapped_at;
     bool rewrap_needed;
 } PagerHistoryBuf;
 
 
+// A HistoryBuf is not synchronized, it must only be used by one thread at a
+// time. The history of a screen is used by a parse thread while its input is
+// parsed off the main thread, see parse_children_in_parallel(), the main
+// thread does not touch it during that time. The only exception is
+// HistoryBufReader, which several threads can use at the same time to read a
+// HistoryBuf that is not otherwise used until they are done.
 typedef struct {
     PyObject_HEAD
 
@@ -32,13 +61,59 @@ typedef struct {
     Line *line;
     TextCache *text_cache;
     index_type start_of_data, count;
+    // LRU list of the segments that are kept uncompressed, most recent first
+    index_type hot_segments[4];
+    unsigned num_hot_segments;
+    // recycled blocks for the cells of uncompressed segments
+    struct { ArenaBlock *blocks[2]; unsigned count; } pool;
+    // Compressed segments are written to disk, up to a total of limit bytes
+    struct {
+        PyObject *disk_cache;
+        size_t limit;
+        bool discard_oldest;
+        struct { index_type *items; size_t count, capacity; } pending;
+    } spill;
+    // older lines that have not been rewrapped yet after a resize
+    PendingRewrap *pending_rewrap;
 } HistoryBuf;
 
 
+typedef struct HistoryBufReader {
+    HistoryBuf *hb;
+    struct { index_type first_line; uint8_t *buf; } slots[2];
+    unsigned least_recently_used;
+    struct { index_type seg_num; uint8_t *data; } from_disk;
+} HistoryBufReader;
+
+
 HistoryBuf* alloc_historybuf(unsigned int, unsigned int, unsigned int, TextCache *tc);
+void historybuf_set_spill_limit(HistoryBuf *self, size_t limit, bool discard_oldest);
+void historybuf_spill_to_disk(HistoryBuf *self);
+typedef void (*historybuf_cells_visitor)(CPUCell *cells, size_t num, void *data);
+// Returns false if the cells of a segment on disk could not be read or written
+bool historybuf_visit_segment_cells(HistoryBuf *self, index_type seg_num, historybuf_cells_visitor visitor, void *data, bool modify);
+size_t historybuf_release_memory(HistoryBuf *self);
+typedef struct HistoryBufMemoryUsage {
+    // uncompressed cells, including the pool of blocks, compressed cells in
+    // RAM and on disk, line attributes and search indices, pager history
+    size_t cells, compressed, on_disk, other, pagerhist;
+} HistoryBufMemoryUsage;
+HistoryBufMemoryUsage historybuf_memory_usage(const HistoryBuf *self);
+void historybuf_blank_segment(HistoryBuf *self, index_type seg_num);
 HistoryBuf *historybuf_alloc_for_rewrap(unsigned int columns, HistoryBuf *self);
 void historybuf_finish_rewrap(HistoryBuf *dest, HistoryBuf *src);
 void historybuf_fast_rewrap(HistoryBuf *dest, HistoryBuf *src);
+index_type historybuf_add_older_lines(HistoryBuf *self, HistoryBuf *older, ANSIBuf *as_ansi_buf);
+// Returns a malloced copy of the pager history, NULL with *sz == 0 if it is empty
+uint8_t* historybuf_pagerhist_as_utf8(HistoryBuf *self, size_t *sz);
 index_type historybuf_next_dest_line(HistoryBuf *self, ANSIBuf *as_ansi_buf, Line *src_line, index_type dest_y, Line *dest_line, bool continued);
 bool historybuf_is_line_continued(HistoryBuf *self, index_type lnum);
+LineAttrs historybuf_line_attrs(HistoryBuf *self, index_type lnum);
+bool historybuf_reader_init(HistoryBufReader *r, HistoryBuf *hb);
+void historybuf_reader_free(HistoryBufReader *r);
+void historybuf_reader_init_line(HistoryBufReader *r, index_type lnum, Line *l);
 void historybuf_delete_newest_lines(HistoryBuf *self, index_type count);
+// The number of lines starting at lnum and going towards newer lines that are in the same segment as lnum
+index_type historybuf_segment_run(HistoryBuf *self, index_type lnum, index_type *seg_num);
+// Returns NULL if the index could not be built
+const uint64_t* historybuf_search_index(HistoryBuf *self, index_type seg_num, HistoryBufReader *r);
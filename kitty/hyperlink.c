@@ -7,10 +7,12 @@
 
 #include "hyperlink.h"
 #include "lineops.h"
+#include "resize.h"
 #include <string.h>
 
 #define MAX_KEY_LEN 2048
 #define MAX_ID_LEN 256
+#define HYPERLINK_IDLE_GC_THRESHOLD 8192
 
 #define NAME hyperlink_map
 #define KEY_TY const char*
@@ -75,32 +77,59 @@ dupstr(const char *src, size_t len) {
     return ans;
 }
 
+typedef struct {
+    HyperLinkPool *pool;
+    hyperlink_id_type *map;
+    HyperLinks clone;
+} Remapper;
+
 static void
-process_cell(HyperLinkPool *pool, hyperlink_id_type *map, HyperLinks clone, CPUCell *c) {
-    if (!c->hyperlink_id) return;
-    if (c->hyperlink_id >= clone.count) { c->hyperlink_id = 0; return; }
-    hyperlink_id_type new_id = map[c->hyperlink_id];
-    if (!new_id) {
-        new_id = pool->array.count++;
-        map[c->hyperlink_id] = new_id;
-        pool->array.items[new_id] = clone.items[c->hyperlink_id]; clone.items[c->hyperlink_id] = NULL;
-        if (vt_is_end(vt_insert(&pool->map, pool->array.items[new_id], new_id))) fatal("Out of memory");
+process_cells(CPUCell *cells, size_t num, void *data) {
+    Remapper *r = data;
+    HyperLinkPool *pool = r->pool;
+    for (size_t i = 0; i < num; i++) {
+        CPUCell *c = cells + i;
+        if (!c->hyperlink_id) continue;
+        if (c->hyperlink_id >= r->clone.count) { c->hyperlink_id = 0; continue; }
+        hyperlink_id_type new_id = r->map[c->hyperlink_id];
+        if (!new_id) {
+            new_id = pool->array.count++;
+            r->map[c->hyperlink_id] = new_id;
+            pool->array.items[new_id] = r->clone.items[c->hyperlink_id]; r->clone.items[c->hyperlink_id] = NULL;
+            if (vt_is_end(vt_insert(&pool->map, pool->array.items[new_id], new_id))) fatal("Out of memory");
+        }
+        c->hyperlink_id = new_id;
     }
-    c->hyperlink_id = new_id;
+}
+
+static void
+clear_hyperlink_ids(CPUCell *cells, size_t num, void *data UNUSED) {
+    for (size_t i = 0; i < num; i++) cells[i].hyperlink_id = 0;
 }
 
 static void
 remap_hyperlink_ids(Screen *self, bool preserve_hyperlinks_in_history, hyperlink_id_type *map, HyperLinks clone) {
-    HyperLinkPool *pool = (HyperLinkPool*)self->hyperlink_pool;
-    if (self->historybuf->count && preserve_hyperlinks_in_history) {
-        for (index_type y = self->historybuf->count; y-- > 0;) {
-            CPUCell *cells = historybuf_cpu_cells(self->historybuf, y);
-            for (index_type x = 0; x < self->historybuf->xnum; x++) process_cell(pool, map, clone, cells + x);
+    Remapper r = {.pool=(HyperLinkPool*)self->hyperlink_pool, .map=map, .clone=clone};
+    // lines waiting to be rewrapped have hyperlink ids as well
+    HistoryBuf *hb = self->historybuf;
+    historybuf_finish_pending_rewrap(hb);
+    // The segments are visited wherever they are stored, so that compressed
+    // and spilled scrollback does not need to be decompressed. History that is
+    // not preserved must not keep the old ids as they are about to be reused.
+    historybuf_cells_visitor visitor = preserve_hyperlinks_in_history ? process_cells : clear_hyperlink_ids;
+    for (index_type i = 0; i < hb->num_segments; i++) {
+        if (!historybuf_visit_segment_cells(hb, i, visitor, &r, true)) {
+            log_error("Failed to update scrollback in the disk cache, some of it will be blank");
+            historybuf_blank_segment(hb, i);
         }
     }
     LineBuf *second = self->linebuf, *first = second == self->main_linebuf ? self->alt_linebuf : self->main_linebuf;
-    for (index_type i = 0; i < self->lines * self->columns; i++) process_cell(pool, map, clone, first->cpu_cell_buf + i);
-    for (index_type i = 0; i < self->lines * self->columns; i++) process_cell(pool, map, clone, second->cpu_cell_buf + i);
+    LineBuf *bufs[] = {first, second, self->paused_rendering.linebuf};
+    for (unsigned i = 0; i < arraysz(bufs); i++) {
+        if (bufs[i]) process_cells(bufs[i]->cpu_cell_buf, (size_t)bufs[i]->xnum * bufs[i]->ynum, &r);
+    }
+    process_cells(self->overlay_line.cpu_cells, self->columns, &r);
+    process_cells(self->overlay_line.original_line.cpu_cells, self->columns, &r);
 }
 
 static void
@@ -122,6 +151,13 @@ _screen_garbage_collect_hyperlink_pool(Screen *screen, bool preserve_hyperlinks_
 void
 screen_garbage_collect_hyperlink_pool(Screen *screen) { _screen_garbage_collect_hyperlink_pool(screen, true); }
 
+bool
+hyperlink_pool_needs_garbage_collection(const HYPERLINK_POOL_HANDLE h) {
+    // After a lot of adds the pool is collected when the screen is idle, so
+    // as not to leak too much memory over unused hyperlinks
+    return h && ((HyperLinkPool*)h)->adds_since_last_gc > HYPERLINK_IDLE_GC_THRESHOLD;
+}
+
 
 hyperlink_id_type
 get_id_for_hyperlink(Screen *screen, const char *id, const char *url) {
@@ -150,9 +186,7 @@ get_id_for_hyperlink(Screen *screen, const char *id, const char *url) {
     hyperlink_id_type new_id = pool->array.count++;
     pool->array.items[new_id] = dupstr(key, keylen);
     if (vt_is_end(vt_insert(&pool->map, pool->array.items[new_id], new_id))) fatal("Out of memory");
-    // If there have been a lot of hyperlink adds do a garbage collect so as
-    // not to leak too much memory over unused hyperlinks
-    if (++pool->adds_since_last_gc > 8192) screen_garbage_collect_hyperlink_pool(screen);
+    pool->adds_since_last_gc++;
     return new_id;
 }
 
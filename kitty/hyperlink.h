@@ -14,3 +14,4 @@ void clear_hyperlink_pool(HYPERLINK_POOL_HANDLE);
 hyperlink_id_type get_id_for_hyperlink(Screen*, const char*, const char*);
 PyObject* screen_hyperlinks_as_set(Screen *screen);
 void screen_garbage_collect_hyperlink_pool(Screen *screen);
+bool hyperlink_pool_needs_garbage_collection(const HYPERLINK_POOL_HANDLE);
@@ -0,0 +1,195 @@
+/*
+ * io-batch.c
+ * Copyright (C) 2025 Kovid Goyal <kovid at kovidgoyal.net>
+ *
+ * Distributed under terms of the GPL3 license.
+ */
+
+#include "io-batch.h"
+#include "safe-wrappers.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAS_IO_URING
+#endif
+#endif
+
+#ifdef HAS_IO_URING
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// We talk to the kernel directly rather than depending on liburing, we only
+// need a tiny subset of its functionality.
+
+struct IOBatch {
+    int ring_fd;
+    unsigned max_operations, queued;
+    struct iovec *iovecs;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_sz, cq_ring_sz, sqes_sz;
+    struct {
+        unsigned *head, *tail, *mask, *array;
+        struct io_uring_sqe *sqes;
+    } sq;
+    struct {
+        unsigned *head, *tail, *mask;
+        struct io_uring_cqe *cqes;
+    } cq;
+};
+
+static int
+io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+void
+io_batch_free(IOBatch *b) {
+    if (!b) return;
+    if (b->sq.sqes && b->sq.sqes != MAP_FAILED) munmap(b->sq.sqes, b->sqes_sz);
+    if (b->cq_ring && b->cq_ring != MAP_FAILED && b->cq_ring != b->sq_ring) munmap(b->cq_ring, b->cq_ring_sz);
+    if (b->sq_ring && b->sq_ring != MAP_FAILED) munmap(b->sq_ring, b->sq_ring_sz);
+    if (b->ring_fd > -1) safe_close(b->ring_fd, __FILE__, __LINE__);
+    free(b->iovecs);
+    free(b);
+}
+
+IOBatch*
+io_batch_create(unsigned max_operations) {
+    if (getenv("KITTY_NO_IO_URING")) return NULL;
+    IOBatch *b = calloc(1, sizeof(IOBatch));
+    if (!b) return NULL;
+    b->ring_fd = -1;
+    struct io_uring_params p = {0};
+    // io_uring is commonly disabled by seccomp filters in containers and by
+    // sysctls on hardened kernels, in which case this fails and we fall back
+    if ((b->ring_fd = io_uring_setup(max_operations, &p)) < 0) goto fail;
+    b->max_operations = MIN(max_operations, p.sq_entries);
+    if (!(b->iovecs = calloc(b->max_operations, sizeof(struct iovec)))) goto fail;
+    b->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    b->cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) b->sq_ring_sz = b->cq_ring_sz = MAX(b->sq_ring_sz, b->cq_ring_sz);
+    b->sq_ring = mmap(NULL, b->sq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, b->ring_fd, IORING_OFF_SQ_RING);
+    if (b->sq_ring == MAP_FAILED) goto fail;
+    if (single_mmap) b->cq_ring = b->sq_ring;
+    else {
+        b->cq_ring = mmap(NULL, b->cq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, b->ring_fd, IORING_OFF_CQ_RING);
+        if (b->cq_ring == MAP_FAILED) goto fail;
+    }
+    b->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    b->sq.sqes = mmap(NULL, b->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, b->ring_fd, IORING_OFF_SQES);
+    if (b->sq.sqes == MAP_FAILED) goto fail;
+    uint8_t *sq = b->sq_ring, *cq = b->cq_ring;
+    b->sq.head = (unsigned*)(sq + p.sq_off.head); b->sq.tail = (unsigned*)(sq + p.sq_off.tail);
+    b->sq.mask = (unsigned*)(sq + p.sq_off.ring_mask); b->sq.array = (unsigned*)(sq + p.sq_off.array);
+    b->cq.head = (unsigned*)(cq + p.cq_off.head); b->cq.tail = (unsigned*)(cq + p.cq_off.tail);
+    b->cq.mask = (unsigned*)(cq + p.cq_off.ring_mask); b->cq.cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return b;
+fail:
+    io_batch_free(b);
+    return NULL;
+}
+
+static bool
+add_operation(IOBatch *b, uint8_t opcode, int fd, void *buf, size_t sz, uint64_t user_data) {
+    if (b->queued >= b->max_operations) return false;
+    // We are the only writer of the submission queue tail
+    const unsigned tail = *b->sq.tail, idx = tail & *b->sq.mask;
+    struct iovec *iov = b->iovecs + b->queued;
+    iov->iov_base = buf; iov->iov_len = sz;
+    struct io_uring_sqe *sqe = b->sq.sqes + idx;
+    zero_at_ptr(sqe);
+    // READV/WRITEV rather than READ/WRITE as they are available since the
+    // very first kernels to support io_uring. The offset is ignored for ptys.
+    sqe->opcode = opcode; sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)iov; sqe->len = 1;
+    sqe->user_data = user_data;
+    b->sq.array[idx] = idx;
+    __atomic_store_n(b->sq.tail, tail + 1, __ATOMIC_RELEASE);
+    b->queued++;
+    return true;
+}
+
+bool
+io_batch_add_read(IOBatch *b, int fd, void *buf, size_t sz, uint64_t user_data) {
+    return add_operation(b, IORING_OP_READV, fd, buf, sz, user_data);
+}
+
+bool
+io_batch_add_write(IOBatch *b, int fd, const void *buf, size_t sz, uint64_t user_data) {
+    return add_operation(b, IORING_OP_WRITEV, fd, (void*)buf, sz, user_data);
+}
+
+static unsigned
+reap_completions(IOBatch *b, io_batch_callback callback, void *data) {
+    unsigned head = *b->cq.head, count = 0;
+    const unsigned tail = __atomic_load_n(b->cq.tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++, count++) {
+        const struct io_uring_cqe *cqe = b->cq.cqes + (head & *b->cq.mask);
+        callback(data, cqe->user_data, cqe->res);
+    }
+    __atomic_store_n(b->cq.head, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+static unsigned
+cancel_unsubmitted(IOBatch *b, io_batch_callback callback, void *data) {
+    // The kernel has not consumed the entries past the submission queue head
+    // so they can be taken back by moving the tail to it
+    const unsigned head = __atomic_load_n(b->sq.head, __ATOMIC_ACQUIRE), tail = *b->sq.tail;
+    for (unsigned i = head; i != tail; i++) {
+        const struct io_uring_sqe *sqe = b->sq.sqes + b->sq.array[i & *b->sq.mask];
+        callback(data, sqe->user_data, -ECANCELED);
+    }
+    __atomic_store_n(b->sq.tail, head, __ATOMIC_RELEASE);
+    return tail - head;
+}
+
+bool
+io_batch_run(IOBatch *b, io_batch_callback callback, void *data) {
+    unsigned to_submit = b->queued, remaining = b->queued;
+    bool ok = true;
+    while (remaining) {
+        if (ok) {
+            int ret = io_uring_enter(b->ring_fd, to_submit, remaining, IORING_ENTER_GETEVENTS);
+            if (ret < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+                log_error("Call to io_uring_enter() failed with error: %s, no longer using io_uring", strerror(errno));
+                ok = false;
+                const unsigned cancelled = cancel_unsubmitted(b, callback, data);
+                remaining -= MIN(remaining, cancelled);
+                to_submit = 0;
+                continue;
+            }
+            to_submit -= MIN(to_submit, (unsigned)ret);
+        } else {
+            // The kernel owns the buffers of the operations in flight until
+            // they complete, which is soon as their fds were ready. Sleeping
+            // in a system call also runs any pending completion work.
+            poll(NULL, 0, 1);
+        }
+        remaining -= MIN(remaining, reap_completions(b, callback, data));
+    }
+    b->queued = 0;
+    return ok;
+}
+
+#else
+
+struct IOBatch { unsigned unused; };
+IOBatch* io_batch_create(unsigned max_operations UNUSED) { return NULL; }
+void io_batch_free(IOBatch *b UNUSED) {}
+bool io_batch_add_read(IOBatch *b UNUSED, int fd UNUSED, void *buf UNUSED, size_t sz UNUSED, uint64_t user_data UNUSED) { return false; }
+bool io_batch_add_write(IOBatch *b UNUSED, int fd UNUSED, const void *buf UNUSED, size_t sz UNUSED, uint64_t user_data UNUSED) { return false; }
+bool io_batch_run(IOBatch *b UNUSED, io_batch_callback callback UNUSED, void *data UNUSED) { return false; }
+
+#endif
@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2025 Kovid Goyal <kovid at kovidgoyal.net>
+ *
+ * Distributed under terms of the GPL3 license.
+ */
+
+#pragma once
+
+#include "data-types.h"
+
+// Submit many reads and writes to the kernel and wait for all of them to
+// complete with a single system call. Uses io_uring on Linux, on other
+// platforms or if io_uring is not available io_batch_create() returns NULL
+// and callers should fall back to doing the I/O themselves.
+//
+// Note that io_uring waits for readiness even on non-blocking fds (ttys do
+// not support RWF_NOWAIT) so operations must only be queued for fds that
+// poll() has reported as ready.
+
+typedef struct IOBatch IOBatch;
+typedef void (*io_batch_callback)(void *data, uint64_t user_data, ssize_t result);
+
+IOBatch* io_batch_create(unsigned max_operations);
+void io_batch_free(IOBatch *b);
+// Returns false if max_operations are already queued
+bool io_batch_add_read(IOBatch *b, int fd, void *buf, size_t sz, uint64_t user_data);
+bool io_batch_add_write(IOBatch *b, int fd, const void *buf, size_t sz, uint64_t user_data);
+// Submit all queued operations, wait for them to complete and call the
+// callback once for each of them with the result of the corresponding
+// read()/write(), negative values are -errno. Returns false if io_uring
+// failed, in which case operations that could not be submitted complete with
+// -ECANCELED and the batch should be freed and the I/O done without it.
+bool io_batch_run(IOBatch *b, io_batch_callback callback, void *data);
@@ -24,6 +24,8 @@ typedef struct {
 } PyKeyEvent;
 
 static PyObject* convert_glfw_key_event_to_python(const GLFWkeyevent *ev);
+static bool is_possible_shortcut(const GLFWkeyevent *ev);
+static bool is_excluded_from_broadcast(const Window *w, const GLFWkeyevent *ev);
 
 static PyObject*
 new_keyevent_object(PyTypeObject *type UNUSED, PyObject *args, PyObject *kw) {
@@ -168,6 +170,15 @@ format_mods(unsigned mods) {
 }
 
 static void
+start_input_latency_measurement(Screen *screen, monotonic_t key_at) {
+    // Only the first key press after the previous echo was presented is
+    // measured, unless it got no echo at all
+    if (screen->input_latency.key_at && key_at - screen->input_latency.key_at < INPUT_LATENCY_TIMEOUT) return;
+    screen->input_latency.key_at = key_at; screen->input_latency.sent_at = monotonic();
+    screen->input_latency.parsed_at = 0; screen->input_latency.rendered_at = 0;
+}
+
+static bool
 send_key_to_child(id_type window_id, Screen *screen, const GLFWkeyevent *ev) {
     const int action = ev->action;
     const uint32_t key = ev->key, native_key = ev->native_key;
@@ -175,19 +186,22 @@ send_key_to_child(id_type window_id, Screen *screen, const GLFWkeyevent *ev) {
 
     if (action == GLFW_REPEAT && !screen->modes.mDECARM) {
         debug("discarding repeat key event as DECARM is off\n");
-        return;
+        return false;
     }
     if (screen->scrolled_by && action == GLFW_PRESS && !is_no_action_key(key, native_key)) {
         screen_history_scroll(screen, SCROLL_FULL, false);  // scroll back to bottom
     }
     char encoded_key[KEY_BUFFER_SIZE] = {0};
     int size = encode_glfw_key_event(ev, screen->modes.mDECCKM, screen_current_key_encoding_flags(screen), encoded_key);
+    if (size > 0 || size == SEND_TEXT_TO_CHILD) vt_parser_note_key_sent(screen->vt_parser);
     if (size == SEND_TEXT_TO_CHILD) {
+        screen_predict_echo(screen, text);
         schedule_write_to_child(window_id, 1, text, strlen(text));
         debug("sent key as text to child (window_id: %llu): %s\n", window_id, text);
     } else if (size > 0) {
+        screen_clear_predicted_echo(screen);
         if (size == 1 && screen->modes.mHANDLE_TERMIOS_SIGNALS) {
-            if (screen_send_signal_for_key(screen, *encoded_key)) return;
+            if (screen_send_signal_for_key(screen, *encoded_key)) return true;
         }
         schedule_write_to_child(window_id, 1, encoded_key, size);
         if (OPT(debug_keyboard)) {
@@ -202,7 +216,9 @@ send_key_to_child(id_type window_id, Screen *screen, const GLFWkeyevent *ev) {
         }
     } else {
         debug("ignoring as keyboard mode does not support encoding this event\n");
+        return false;
     }
+    return true;
 }
 
 void
@@ -216,8 +232,27 @@ dispatch_buffered_keys(Window *w) {
     free(w->buffered_keys.key_data); zero_at_ptr(&w->buffered_keys);
 }
 
+static void
+broadcast_key_event(const Window *src, const GLFWkeyevent *ev) {
+    if (!src->broadcast.num_targets || is_excluded_from_broadcast(src, ev)) return;
+    // window_for_window_id() is a linear scan but broadcasting is only used
+    // with a few tens of windows and never when the lookup would be hot
+    for (size_t i = 0; i < src->broadcast.num_targets; i++) {
+        Window *t = window_for_window_id(src->broadcast.targets[i]);
+        if (!t || !t->render_data.screen) continue;
+        if (ev->ime_state == GLFW_IME_COMMIT_TEXT) {
+            const char *text = ev->text ? ev->text : "";
+            if (*text) {
+                vt_parser_note_key_sent(t->render_data.screen->vt_parser);
+                schedule_write_to_child(t->id, 1, text, strlen(text));
+            }
+        } else send_key_to_child(t->id, t->render_data.screen, ev);
+    }
+}
+
 void
 on_key_input(const GLFWkeyevent *ev) {
+    const monotonic_t received_at = monotonic();
     Window *w = active_window();
     const int action = ev->action, mods = ev->mods;
     const uint32_t key = ev->key, native_key = ev->native_key;
@@ -254,7 +289,10 @@ on_key_input(const GLFWkeyevent *ev) {
             return;
         case GLFW_IME_COMMIT_TEXT:
             if (*text) {
+                vt_parser_note_key_sent(screen->vt_parser);
                 schedule_write_to_child(w->id, 1, text, strlen(text));
+                start_input_latency_measurement(screen, received_at);
+                broadcast_key_event(w, ev);
                 debug("committed pre-edit text: %s sent to child as text.\n", text);
             } else debug("committed pre-edit text: (null)\n");
             screen_update_overlay_text(screen, NULL);
@@ -280,16 +318,18 @@ on_key_input(const GLFWkeyevent *ev) {
 }
     if (action == GLFW_PRESS || action == GLFW_REPEAT) {
         w->last_special_key_pressed = 0;
-        dispatch_key_event(dispatch_possible_special_key);
-        if (dispatch_ok) {
-            if (consumed) {
-                debug("handled as shortcut\n");
-                if (w) w->last_special_key_pressed = key;
-                return;
+        if (is_possible_shortcut(ev)) {
+            dispatch_key_event(dispatch_possible_special_key);
+            if (dispatch_ok) {
+                if (consumed) {
+                    debug("handled as shortcut\n");
+                    if (w) w->last_special_key_pressed = key;
+                    return;
+                }
             }
-        }
-        if (!w) return;
-        screen = w->render_data.screen;
+            if (!w) return;
+            screen = w->render_data.screen;
+        } else debug("not a shortcut, ");
     } else if (w->last_special_key_pressed == key) {
         w->last_special_key_pressed = 0;
         debug("ignoring release event for previous press that was handled as shortcut\n");
@@ -306,7 +346,10 @@ on_key_input(const GLFWkeyevent *ev) {
         GLFWkeyevent *k = w->buffered_keys.key_data;
         k[w->buffered_keys.count++] = *ev;
         debug("buffering key until child is ready\n");
-    } else send_key_to_child(w->id, screen, ev);
+    } else {
+        if (send_key_to_child(w->id, screen, ev) && action != GLFW_RELEASE) start_input_latency_measurement(screen, received_at);
+        broadcast_key_event(w, ev);
+    }
 #undef dispatch_key_event
 }
 
@@ -411,8 +454,13 @@ pyis_modifier_key(PyObject *self UNUSED, PyObject *a) {
     Py_RETURN_FALSE;
 }
 
+static PyObject* pyset_shortcut_filter(PyObject *self UNUSED, PyObject *keys);
+static PyObject* pyset_broadcast_targets(PyObject *self UNUSED, PyObject *args);
+
 static PyMethodDef module_methods[] = {
     M(key_for_native_key_name, METH_VARARGS),
+    M(set_shortcut_filter, METH_O),
+    M(set_broadcast_targets, METH_VARARGS),
     M(encode_key_for_tty, METH_VARARGS | METH_KEYWORDS),
     M(inject_key, METH_VARARGS | METH_KEYWORDS),
     M(is_modifier_key, METH_O),
@@ -614,6 +662,107 @@ static PyTypeObject SingleKey_Type = {
     .tp_getset = SingleKey_getsetters,
 }; // }}}
 
+// Shortcut filter {{{
+// The set of keys that can start a shortcut in the root keyboard mode, sorted
+// so that key presses that cannot possibly be shortcuts are sent to the child
+// without calling into python. When not active, for instance while a keyboard
+// mode or multi-key sequence is in progress, every key press is dispatched to
+// python.
+static struct {
+    keybitfield *keys;
+    size_t count, capacity;
+    bool active;
+} shortcut_filter = {0};
+
+static int
+cmp_keybitfield(const void *a_, const void *b_) {
+    const keybitfield a = *(const keybitfield*)a_, b = *(const keybitfield*)b_;
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+static bool
+shortcut_filter_has(unsigned mods, bool is_native, uint32_t key) {
+    Key q = {.val=0};
+    q.mods = mods; q.is_native = is_native; q.key = key;
+    return bsearch(&q.val, shortcut_filter.keys, shortcut_filter.count, sizeof(shortcut_filter.keys[0]), cmp_keybitfield) != NULL;
+}
+
+static bool
+is_possible_shortcut(const GLFWkeyevent *ev) {
+    // must consider the same keys as get_shortcut() in keys.py
+    if (!shortcut_filter.active) return true;
+    const unsigned mods = ev->mods & (GLFW_MOD_ALT | GLFW_MOD_CONTROL | GLFW_MOD_SHIFT | GLFW_MOD_SUPER | GLFW_MOD_META | GLFW_MOD_HYPER);
+    if (shortcut_filter_has(mods, false, ev->key)) return true;
+    if (ev->shifted_key && (mods & GLFW_MOD_SHIFT) && shortcut_filter_has(mods & ~GLFW_MOD_SHIFT, false, ev->shifted_key)) return true;
+    return shortcut_filter_has(mods, true, ev->native_key);
+}
+
+static PyObject*
+pyset_shortcut_filter(PyObject *self UNUSED, PyObject *keys) {
+    if (keys == Py_None) { shortcut_filter.active = false; Py_RETURN_NONE; }
+    RAII_PyObject(seq, PySequence_Fast(keys, "keys must be a sequence of SingleKey objects"));
+    if (!seq) return NULL;
+    const size_t count = PySequence_Fast_GET_SIZE(seq);
+    if (count > shortcut_filter.capacity) {
+        keybitfield *k = realloc(shortcut_filter.keys, count * sizeof(k[0]));
+        if (!k) return PyErr_NoMemory();
+        shortcut_filter.keys = k; shortcut_filter.capacity = count;
+    }
+    shortcut_filter.active = false;
+    for (size_t i = 0; i < count; i++) {
+        PyObject *x = PySequence_Fast_GET_ITEM(seq, i);
+        if (!PyObject_TypeCheck(x, &SingleKey_Type)) { PyErr_SetString(PyExc_TypeError, "keys must be a sequence of SingleKey objects"); return NULL; }
+        shortcut_filter.keys[i] = ((SingleKey*)x)->key.val;
+    }
+    shortcut_filter.count = count;
+    qsort(shortcut_filter.keys, count, sizeof(shortcut_filter.keys[0]), cmp_keybitfield);
+    shortcut_filter.active = true;
+    Py_RETURN_NONE;
+}
+// }}}
+
+// Broadcast {{{
+static bool
+is_excluded_from_broadcast(const Window *w, const GLFWkeyevent *ev) {
+    const unsigned mods = ev->mods & (GLFW_MOD_ALT | GLFW_MOD_CONTROL | GLFW_MOD_SHIFT | GLFW_MOD_SUPER | GLFW_MOD_META | GLFW_MOD_HYPER);
+    for (size_t i = 0; i < w->broadcast.num_excluded_keys; i++) {
+        Key k = {.val=w->broadcast.excluded_keys[i]};
+        if (k.is_native) { if (k.key == (uint32_t)ev->native_key && k.mods == mods) return true; }
+        else if (k.key == ev->key && k.mods == mods) return true;
+        else if (ev->shifted_key && (mods & GLFW_MOD_SHIFT) && k.key == ev->shifted_key && k.mods == (mods & ~GLFW_MOD_SHIFT)) return true;
+    }
+    return false;
+}
+
+static PyObject*
+pyset_broadcast_targets(PyObject *self UNUSED, PyObject *args) {
+    unsigned long long window_id;
+    PyObject *targets, *excluded_keys;
+    if (!PyArg_ParseTuple(args, "KOO", &window_id, &targets, &excluded_keys)) return NULL;
+    Window *w = window_for_window_id(window_id);
+    if (!w) Py_RETURN_FALSE;
+    RAII_PyObject(ts, PySequence_Fast(targets, "targets must be a sequence of window ids"));
+    RAII_PyObject(ks, PySequence_Fast(excluded_keys, "excluded_keys must be a sequence of SingleKey objects"));
+    if (!ts || !ks) return NULL;
+    const size_t nt = PySequence_Fast_GET_SIZE(ts), nk = PySequence_Fast_GET_SIZE(ks);
+    id_type *t = nt ? malloc(nt * sizeof(t[0])) : NULL;
+    uint64_t *k = nk ? malloc(nk * sizeof(k[0])) : NULL;
+    if ((nt && !t) || (nk && !k)) { free(t); free(k); return PyErr_NoMemory(); }
+    for (size_t i = 0; i < nt; i++) {
+        t[i] = PyLong_AsUnsignedLongLong(PySequence_Fast_GET_ITEM(ts, i));
+        if (PyErr_Occurred()) { free(t); free(k); return NULL; }
+    }
+    for (size_t i = 0; i < nk; i++) {
+        PyObject *x = PySequence_Fast_GET_ITEM(ks, i);
+        if (!PyObject_TypeCheck(x, &SingleKey_Type)) { free(t); free(k); PyErr_SetString(PyExc_TypeError, "excluded_keys must be a sequence of SingleKey objects"); return NULL; }
+        k[i] = ((SingleKey*)x)->key.val;
+    }
+    free(w->broadcast.targets); free(w->broadcast.excluded_keys);
+    w->broadcast.targets = t; w->broadcast.num_targets = nt;
+    w->broadcast.excluded_keys = k; w->broadcast.num_excluded_keys = nk;
+    Py_RETURN_TRUE;
+}
+// }}}
 
 bool
 init_keys(PyObject *module) {
@@ -21,6 +21,7 @@
     is_modifier_key,
     ring_bell,
     set_ignore_os_keyboard_processing,
+    set_shortcut_filter,
 )
 from .options.types import Options
 from .options.utils import KeyboardMode, KeyDefinition, KeyMap
@@ -84,11 +85,22 @@ def update_keymap(self, global_shortcuts: dict[str, SingleKey] | None = None) ->
         self.keyboard_modes[''].keymap = km = km.copy()
         for sc in self.global_shortcuts.values():
             km.pop(sc, None)
+        self.update_shortcut_filter()
+
+    def update_shortcut_filter(self) -> None:
+        # In the root mode, let the C key handling code send key presses that
+        # cannot match any shortcut directly to the child, without calling
+        # dispatch_possible_special_key()
+        if self.keyboard_mode_stack:
+            self.set_shortcut_filter(None)
+        else:
+            self.set_shortcut_filter(tuple(self.keyboard_modes[''].keymap) + tuple(self.global_shortcuts_map))
 
     def clear_keyboard_modes(self) -> None:
         had_mode = bool(self.keyboard_mode_stack)
         self.keyboard_mode_stack = []
         self.set_ignore_os_keyboard_processing(False)
+        self.update_shortcut_filter()
         if had_mode:
             self.callback_on_mode_change()
 
@@ -98,6 +110,7 @@ def pop_keyboard_mode(self) -> bool:
             self.keyboard_mode_stack.pop()
             if not self.keyboard_mode_stack:
                 self.set_ignore_os_keyboard_processing(False)
+                self.update_shortcut_filter()
             passthrough = False
             self.callback_on_mode_change()
         return passthrough
@@ -110,6 +123,7 @@ def pop_keyboard_mode_if_is(self, name: str) -> bool:
     def _push_keyboard_mode(self, mode: KeyboardMode) -> None:
         self.keyboard_mode_stack.append(mode)
         self.set_ignore_os_keyboard_processing(True)
+        self.set_shortcut_filter(None)
         self.callback_on_mode_change()
 
     def push_keyboard_mode(self, new_mode: str) -> None:
@@ -219,6 +233,7 @@ def dispatch_possible_special_key(self, ev: KeyEvent) -> bool:
                         self.callback_on_mode_change()
                         if not self.keyboard_mode_stack:
                             self.set_ignore_os_keyboard_processing(False)
+                            self.update_shortcut_filter()
                 return consumed
         return False
 
@@ -242,6 +257,9 @@ def combine(self, action_definition: str) -> bool:
     def set_ignore_os_keyboard_processing(self, on: bool) -> None:
         set_ignore_os_keyboard_processing(on)
 
+    def set_shortcut_filter(self, keys: tuple[SingleKey, ...] | None) -> None:
+        set_shortcut_filter(keys)
+
     def get_options(self) -> Options:
         return get_options()
 
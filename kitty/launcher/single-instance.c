@@ -333,12 +333,14 @@ talk_to_instance(int s, struct sockaddr_un *server_addr, int argc, char *argv[],
     if (notify_socket > -1) {
         int fd = safe_accept(notify_socket, NULL, NULL);
         if (fd < 0) fail_on_errno("Failed to accept connection on notify socket");
+        // the instance writes a single byte when the OS window is closed
         char rbuf;
         while (true) {
-            ssize_t n = recv(notify_socket, &rbuf, 1, 0);
+            ssize_t n = recv(fd, &rbuf, 1, 0);
             if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) continue;
             break;
         }
+        safe_close(fd, __FILE__, __LINE__);
         shutdown(notify_socket, SHUT_RDWR);
         safe_close(notify_socket, __FILE__, __LINE__);
     }
@@ -356,10 +356,9 @@ linebuf_reverse_index(LineBuf *self, index_type top, index_type bottom) {
     if (top >= self->ynum - 1 || bottom >= self->ynum || bottom <= top) return;
     index_type old_bottom = self->line_map[bottom];
     LineAttrs old_attrs = self->line_attrs[bottom];
-    for (index_type i = bottom; i > top; i--) {
-        self->line_map[i] = self->line_map[i - 1];
-        self->line_attrs[i] = self->line_attrs[i - 1];
-    }
+    const index_type num = bottom - top;
+    memmove(self->line_map + top + 1, self->line_map + top, sizeof(self->line_map[0]) * num);
+    memmove(self->line_attrs + top + 1, self->line_attrs + top, sizeof(self->line_attrs[0]) * num);
     self->line_map[top] = old_bottom;
     self->line_attrs[top] = old_attrs;
 }
@@ -595,7 +594,7 @@ rewrap(LineBuf *self, PyObject *args) {
     if (!PyArg_ParseTuple(args, "II", &lines, &columns)) return NULL;
     TrackCursor cursors[1] = {{.is_sentinel=true}};
     ANSIBuf as_ansi_buf = {0};
-    ResizeResult r = resize_screen_buffers(self, NULL, lines, columns, &as_ansi_buf, cursors);
+    ResizeResult r = resize_screen_buffers(self, NULL, lines, columns, &as_ansi_buf, cursors, false, false);
     free(as_ansi_buf.buf);
     if (!r.ok) return PyErr_NoMemory();
     return Py_BuildValue("NII", r.lb, r.num_content_lines_before, r.num_content_lines_after);
@@ -443,7 +443,7 @@ unicode_in_range(const Line *self, const index_type start, const index_type limi
         lc.chars = buf->buf + buf->len; lc.capacity = buf->capacity - buf->len;
         while (!text_in_cell_without_alloc(self->cpu_cells + i, self->text_cache, &lc)) {
             size_t ns = MAX(initial_cap, 2 * buf->capacity);
-            char_type *np = realloc(buf->buf, ns);
+            char_type *np = realloc(buf->buf, ns * sizeof(buf->buf[0]));
             if (!np) return false;
             buf->capacity = ns; buf->buf = np;
             lc.chars = buf->buf + buf->len; lc.capacity = buf->capacity - buf->len;
@@ -601,6 +601,23 @@ line_as_ansi(Line *self, ANSILineState *s, index_type start_at, index_type stop_
         while (num_cells_to_skip_for_tab && s->pos + 1 < s->limit && cell_is_char(next, ' ')) {
             num_cells_to_skip_for_tab--; s->pos++; next++;
         }
+        // Copy the run of following simple cells that need no escape codes in bulk
+        index_type run_end = s->pos + 1;
+        const hyperlink_id_type active_hid = s->output_buf->active_hyperlink_id;
+        for (; run_end < s->limit; run_end++, next++) {
+            if (next->ch_is_idx || next->is_multicell || next->ch_or_idx == '\t') break;
+            if (s->output_buf->hyperlink_pool && next->hyperlink_id != active_hid) break;
+            cell = &self->gpu_cells[run_end];
+            if (CMP_ATTRS || CMP(fg) || CMP(bg) || CMP(decoration_fg)) break;
+        }
+        if (run_end > s->pos + 1) {
+            close_multicell(s);
+            ensure_space_in_ansi_output_buf(s, run_end - s->pos - 1);
+            Py_UCS4 *dest = s->output_buf->buf + s->output_buf->len;
+            for (const CPUCell *c = self->cpu_cells + s->pos + 1, *limit = self->cpu_cells + run_end; c < limit; c++) *(dest++) = c->ch_or_idx ? c->ch_or_idx : ' ';
+            s->output_buf->len += run_end - s->pos - 1;
+            s->pos = run_end - 1;
+        }
     }
     close_multicell(s);
     return s->escape_code_written;
@@ -741,7 +758,8 @@ void
 line_clear_text(Line *self, unsigned int at, unsigned int num, char_type ch) {
     const CPUCell cc = {.ch_or_idx=ch};
     if (at + num > self->xnum) num = self->xnum > at ? self->xnum - at : 0;
-    memset_array(self->cpu_cells + at, cc, num);
+    if (ch) { memset_array(self->cpu_cells + at, cc, num); }
+    else zero_at_ptr_count(self->cpu_cells + at, num);
 }
 
 static PyObject*
@@ -990,6 +1008,13 @@ apply_mark(Line *line, const uint16_t mark, index_type *cell_pos, unsigned int *
 #undef MARK
 }
 
+static void
+apply_match(Line *line, index_type *x, unsigned int *match_pos, unsigned int l, unsigned int r, unsigned int col) {
+    while (*match_pos < l && *x < line->xnum) apply_mark(line, 0, x, match_pos);
+    const uint16_t am = (col & MARK_MASK);
+    while (*x < line->xnum && *match_pos <= r) apply_mark(line, am, x, match_pos);
+}
+
 static void
 apply_marker(PyObject *marker, Line *line, const PyObject *text) {
     unsigned int l=0, r=0, col=0, match_pos=0;
@@ -1003,26 +1028,141 @@ apply_marker(PyObject *marker, Line *line, const PyObject *text) {
     index_type x = 0;
     while ((match = PyIter_Next(iter)) && x < line->xnum) {
         Py_DECREF(match);
-        while (match_pos < l && x < line->xnum) {
-            apply_mark(line, 0, &x, &match_pos);
-        }
-        uint16_t am = (col & MARK_MASK);
-        while(x < line->xnum && match_pos <= r) {
-            apply_mark(line, am, &x, &match_pos);
-        }
-
+        apply_match(line, &x, &match_pos, l, r, col);
     }
     Py_DECREF(iter);
     while(x < line->xnum) line->gpu_cells[x++].attrs.mark = 0;
     if (PyErr_Occurred()) report_marker_error(marker);
 }
 
+// TextMarker {{{
+// A marker that marks occurrences of plain text without calling into Python
+// for every line. marks.py uses it for regex markers whose patterns contain
+// no special characters, which includes all text markers. At every position
+// the first pattern that matches is used and matches do not overlap, the
+// same as for finditer() on the alternation of the patterns.
+
+typedef struct TextMarkerPattern {
+    size_t offset, len;
+    uint16_t mark;
+} TextMarkerPattern;
+
+typedef struct TextMarker {
+    PyObject_HEAD
+    char_type *text;
+    TextMarkerPattern *patterns;
+    size_t num_patterns;
+    bool ignore_case;
+} TextMarker;
+
+static PyTypeObject TextMarker_Type;
+
+static int
+TextMarker_init(PyObject *s, PyObject *args, PyObject *kwds UNUSED) {
+    TextMarker *self = (TextMarker*)s;
+    PyObject *patterns; int ignore_case = 0;
+    if (!PyArg_ParseTuple(args, "O!|p", &PyTuple_Type, &patterns, &ignore_case)) return -1;
+    const size_t num = PyTuple_GET_SIZE(patterns);
+    size_t total = 0;
+    for (size_t i = 0; i < num; i++) {
+        PyObject *p = PyTuple_GET_ITEM(patterns, i);
+        if (!PyTuple_Check(p) || PyTuple_GET_SIZE(p) != 2 || !PyLong_Check(PyTuple_GET_ITEM(p, 0)) || !PyUnicode_Check(PyTuple_GET_ITEM(p, 1)) || !PyUnicode_GET_LENGTH(PyTuple_GET_ITEM(p, 1))) {
+            PyErr_SetString(PyExc_TypeError, "patterns must be a tuple of (mark, non-empty text) pairs"); return -1;
+        }
+        total += PyUnicode_GET_LENGTH(PyTuple_GET_ITEM(p, 1));
+    }
+    free(self->text); free(self->patterns); self->num_patterns = 0;
+    self->text = malloc(MAX(1u, total) * sizeof(self->text[0])); self->patterns = malloc(MAX(1u, num) * sizeof(self->patterns[0]));
+    if (!self->text || !self->patterns) { PyErr_NoMemory(); return -1; }
+    self->ignore_case = ignore_case;
+    size_t offset = 0;
+    for (size_t i = 0; i < num; i++) {
+        PyObject *p = PyTuple_GET_ITEM(patterns, i), *text = PyTuple_GET_ITEM(p, 1);
+        const unsigned long mark = PyLong_AsUnsignedLong(PyTuple_GET_ITEM(p, 0));
+        if (PyErr_Occurred()) return -1;
+        TextMarkerPattern *tp = self->patterns + self->num_patterns++;
+        tp->offset = offset; tp->len = PyUnicode_GET_LENGTH(text); tp->mark = mark & MARK_MASK;
+        if (!PyUnicode_AsUCS4(text, self->text + offset, tp->len, 0)) return -1;
+        offset += tp->len;
+    }
+    return 0;
+}
+
+static void
+TextMarker_dealloc(TextMarker *self) {
+    free(self->text); free(self->patterns);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyTypeObject TextMarker_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "fast_data_types.TextMarker",
+    .tp_basicsize = sizeof(TextMarker),
+    .tp_dealloc = (destructor)TextMarker_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "TextMarker(patterns, ignore_case=False) -> Mark the specified ((mark, text), ...) patterns, case insensitive matching is only supported for ASCII text",
+    .tp_new = PyType_GenericNew,
+    .tp_init = TextMarker_init,
+};
+
+bool
+is_native_marker(PyObject *marker) { return Py_IS_TYPE(marker, &TextMarker_Type); }
+
+static char_type
+fold_case(char_type ch) {
+    if ('A' <= ch && ch <= 'Z') return ch + 32;
+    // The non-ASCII characters that Python's re module matches case
+    // insensitively against ASCII letters
+    switch (ch) {
+        case 0x130: case 0x131: return 'i';
+        case 0x17f: return 's';
+        case 0x212a: return 'k';
+    }
+    return ch;
+}
+
+static bool
+text_marker_matches_at(const TextMarker *self, const TextMarkerPattern *p, const char_type *text, size_t len) {
+    if (p->len > len) return false;
+    const char_type *q = self->text + p->offset;
+    if (self->ignore_case) {
+        for (size_t i = 0; i < p->len; i++) if (fold_case(text[i]) != q[i]) return false;
+        return true;
+    }
+    return memcmp(text, q, p->len * sizeof(q[0])) == 0;
+}
+
+static void
+apply_text_marker(const TextMarker *self, Line *line, const char_type *text, size_t len) {
+    unsigned int match_pos = 0;
+    index_type x = 0;
+    for (size_t i = 0; i < len && x < line->xnum;) {
+        const TextMarkerPattern *p = NULL;
+        for (size_t n = 0; n < self->num_patterns && !p; n++) {
+            if (text_marker_matches_at(self, self->patterns + n, text + i, len - i)) p = self->patterns + n;
+        }
+        if (p) {
+            apply_match(line, &x, &match_pos, i, i + p->len - 1, p->mark);
+            i += p->len;
+        } else i++;
+    }
+    while(x < line->xnum) line->gpu_cells[x++].attrs.mark = 0;
+}
+// }}}
+
 void
 mark_text_in_line(PyObject *marker, Line *line, ANSIBuf *buf) {
     if (!marker) {
         for (index_type i = 0; i < line->xnum; i++)  line->gpu_cells[i].attrs.mark = 0;
         return;
     }
+    if (is_native_marker(marker)) {
+        const size_t before = buf->len;
+        if (!unicode_in_range(line, 0, xlimit_for_line(line), true, false, false, true, buf)) fatal("Out of memory");
+        apply_text_marker((TextMarker*)marker, line, buf->buf + before, buf->len - before);
+        buf->len = before;
+        return;
+    }
     PyObject *text = line_as_unicode(line, false, buf);
     if (PyUnicode_GET_LENGTH(text) > 0) {
         apply_marker(marker, line, text);
@@ -1032,26 +1172,41 @@ mark_text_in_line(PyObject *marker, Line *line, ANSIBuf *buf) {
     Py_DECREF(text);
 }
 
+static bool
+flush_text(PyObject *callback, ANSIBuf *buf) {
+    if (!buf->len) return true;
+    RAII_PyObject(t, PyUnicode_FromKindAndData(PyUnicode_4BYTE_KIND, buf->buf, buf->len));
+    buf->len = 0;
+    if (!t) return false;
+    RAII_PyObject(ret, PyObject_CallFunctionObjArgs(callback, t, NULL));
+    return ret != NULL;
+}
+
+static void
+append_text(ANSIBuf *buf, const char *text) {
+    const size_t sz = strlen(text);
+    ensure_space_for(buf, buf, buf->buf[0], buf->len + sz, capacity, 2048, false);
+    for (size_t i = 0; i < sz; i++) buf->buf[buf->len++] = text[i];
+}
+
 PyObject*
 as_text_generic(PyObject *args, void *container, get_line_func get_line, index_type lines, ANSIBuf *ansibuf, bool add_trailing_newline) {
-#define APPEND(x) { PyObject* retval = PyObject_CallFunctionObjArgs(callback, x, NULL); if (!retval) return NULL; Py_DECREF(retval); }
-#define APPEND_AND_DECREF(x) { if (x == NULL) { if (PyErr_Occurred()) return NULL; Py_RETURN_NONE; } PyObject* retval = PyObject_CallFunctionObjArgs(callback, x, NULL); Py_CLEAR(x); if (!retval) return NULL; Py_DECREF(retval); }
+    // The text of the lines is accumulated in ansibuf and passed to callback
+    // in large chunks rather than a few small strings per line, as creating
+    // and joining them dominates for large scrollbacks
+    static const size_t chunk_size = 64 * 1024;
+#define FLUSH if (!flush_text(callback, ansibuf)) return NULL;
     PyObject *callback;
     int as_ansi = 0, insert_wrap_markers = 0;
     if (!PyArg_ParseTuple(args, "O|pp", &callback, &as_ansi, &insert_wrap_markers)) return NULL;
-    PyObject *t = NULL;
-    RAII_PyObject(nl, PyUnicode_FromString("\n"));
-    RAII_PyObject(cr, PyUnicode_FromString("\r"));
-    RAII_PyObject(sgr_reset, PyUnicode_FromString("\x1b[m"));
-    if (nl == NULL || cr == NULL || sgr_reset == NULL) return NULL;
     ANSILineState s = {.output_buf=ansibuf};
     ansibuf->active_hyperlink_id = 0;
+    ansibuf->len = 0;
     bool need_newline = false;
     for (index_type y = 0; y < lines; y++) {
         Line *line = get_line(container, y);
         if (!line) { if (PyErr_Occurred()) return NULL; break; }
-        if (need_newline) APPEND(nl);
-        ansibuf->len = 0;
+        if (need_newline) append_text(ansibuf, "\n");
         if (as_ansi) {
             // less has a bug where it resets colors when it sees a \r, so work
             // around it by resetting SGR at the start of every line. This is
@@ -1059,25 +1214,24 @@ as_text_generic(PyObject *args, void *container, get_line_func get_line, index_t
             // makes writing pagers easier.
             // see https://github.com/kovidgoyal/kitty/issues/2381
             s.prev_gpu_cell = NULL;
+            // the SGR reset is only needed before lines that are not empty
+            const size_t before = ansibuf->len;
+            append_text(ansibuf, "\x1b[m");
             line_as_ansi(line, &s, 0, line->xnum, 0, true);
-            t = PyUnicode_FromKindAndData(PyUnicode_4BYTE_KIND, ansibuf->buf, ansibuf->len);
-            if (t && ansibuf->len > 0) APPEND(sgr_reset);
-        } else {
-            t = line_as_unicode(line, false, ansibuf);
-        }
-        APPEND_AND_DECREF(t);
-        if (insert_wrap_markers) APPEND(cr);
+            if (ansibuf->len == before + 3) ansibuf->len = before;
+        } else if (!unicode_in_range(line, 0, xlimit_for_line(line), true, false, false, true, ansibuf)) return PyErr_NoMemory();
+        if (insert_wrap_markers) append_text(ansibuf, "\r");
         need_newline = !line->cpu_cells[line->xnum-1].next_char_was_wrapped;
+        if (ansibuf->len >= chunk_size) { FLUSH; }
     }
-    if (need_newline && add_trailing_newline) APPEND(nl);
+    if (need_newline && add_trailing_newline) append_text(ansibuf, "\n");
     if (ansibuf->active_hyperlink_id) {
         ansibuf->active_hyperlink_id = 0;
-        t = PyUnicode_FromString("\x1b]8;;\x1b\\");
-        APPEND_AND_DECREF(t);
+        append_text(ansibuf, "\x1b]8;;\x1b\\");
     }
+    FLUSH;
     Py_RETURN_NONE;
-#undef APPEND
-#undef APPEND_AND_DECREF
+#undef FLUSH
 }
 
 // Boilerplate {{{
@@ -1146,6 +1300,11 @@ Line *alloc_line(TextCache *tc) {
 }
 
 RICHCMP(Line)
+#undef EXTRA_INIT
+#define EXTRA_INIT \
+    if (PyType_Ready(&TextMarker_Type) < 0) return 0; \
+    if (PyModule_AddObject(module, "TextMarker", (PyObject *)&TextMarker_Type) != 0) return 0; \
+    Py_INCREF(&TextMarker_Type);
 INIT_TYPE(Line)
 // }}}
 
@@ -38,6 +38,14 @@ clear_chars_in_line(CPUCell *cpu_cells, GPUCell *gpu_cells, index_type xnum, cha
     }
 }
 
+static inline bool
+cells_have_multicell(const CPUCell *cells, index_type count) {
+    // branchless so that the compiler can vectorize it
+    unsigned ans = 0;
+    for (index_type i = 0; i < count; i++) ans |= cells[i].is_multicell;
+    return ans != 0;
+}
+
 static inline index_type
 xlimit_for_line(const Line *line) {
     index_type xlimit = line->xnum;
@@ -115,6 +123,7 @@ void historybuf_set_line_has_image_placeholders(HistoryBuf *self, index_type y,
 void historybuf_refresh_sprite_positions(HistoryBuf *self);
 void historybuf_clear(HistoryBuf *self);
 void mark_text_in_line(PyObject *marker, Line *line, ANSIBuf *buf);
+bool is_native_marker(PyObject *marker);
 bool line_has_mark(Line *, uint16_t mark);
 PyObject* as_text_generic(PyObject *args, void *container, get_line_func get_line, index_type lines, ANSIBuf *ansibuf, bool add_trailing_newline);
 bool colors_for_cell(Line *self, const ColorProfile *cp, index_type *x, color_type *fg, color_type *bg, bool *reversed);
@@ -305,6 +305,8 @@ def _run_app(opts: Options, args: CLIOptions, bad_lines: Sequence[BadLine] = (),
                     wincls, wstate, load_all_shaders, disallow_override_title=bool(args.title), layer_shell_config=run_app.layer_shell_config, x=pos_x, y=pos_y)
         boss = Boss(opts, args, cached_values, global_shortcuts, talk_fd)
         boss.start(window_id, startup_sessions)
+        if run_app.keep_os_window_alive:
+            boss.keep_os_window_alive(window_id)
         if args.debug_font_fallback:
             dump_font_debug()
         if bad_lines or boss.misc_config_errors:
@@ -325,16 +327,22 @@ def __init__(self) -> None:
         self.cached_values_name = 'main'
         self.first_window_callback = lambda window_handle: None
         self.layer_shell_config: LayerShellConfig | None = None
+        self.keep_os_window_alive = False
         self.initial_window_size_func = initial_window_size_func
 
     def __call__(self, opts: Options, args: CLIOptions, bad_lines: Sequence[BadLine] = (), talk_fd: int = -1) -> None:
         if theme_colors.refresh():
             theme_colors.patch_opts(opts, args.debug_rendering)
         set_options(opts, is_wayland(), args.debug_rendering, args.debug_font_fallback)
+        if not is_macos:
+            from .fonts.fontconfig import load_fallback_cache, save_fallback_cache
+            load_fallback_cache()
         try:
             set_font_family(opts, add_builtin_nerd_font=True)
             _run_app(opts, args, bad_lines, talk_fd)
         finally:
+            if not is_macos:
+                save_fallback_cache()
             set_options(None)
             free_font_data()  # must free font data before glfw/freetype/fontconfig/opengl etc are finalized
             if is_macos:
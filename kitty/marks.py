@@ -7,12 +7,14 @@
 from re import Pattern
 from typing import Union
 
+from .fast_data_types import TextMarker
 from .utils import resolve_custom_file
 
 pointer_to_uint = POINTER(c_uint)
 
 
 MarkerFunc = Callable[[str, int, int, int], Generator[None, None, None]]
+Marker = Union[MarkerFunc, TextMarker]
 
 
 def get_output_variables(left_address: int, right_address: int, color_address: int) -> tuple[c_uint, c_uint, c_uint]:
@@ -23,8 +25,50 @@ def get_output_variables(left_address: int, right_address: int, color_address: i
     )
 
 
-def marker_from_regex(expression: Union[str, 'Pattern[str]'], color: int, flags: int = re.UNICODE) -> MarkerFunc:
+def plain_text_of_regex(expression: Union[str, 'Pattern[str]'], flags: int) -> tuple[str, bool] | None:
+    # Return the text matched by expression and whether it is matched case
+    # insensitively, if the expression contains no special characters and can
+    # be matched by TextMarker
+    if not isinstance(expression, str):
+        expression, flags = expression.pattern, expression.flags
+    try:
+        from re import _parser as parser  # type: ignore
+    except ImportError:
+        import sre_parse as parser  # type: ignore
+    try:
+        p = parser.parse(expression, flags)
+    except Exception:
+        return None
+    flags = p.state.flags
+    if len(p) == 0 or flags & (re.ASCII | re.LOCALE) or any(op is not parser.LITERAL for op, _ in p):
+        return None
+    text = ''.join(chr(c) for _, c in p)
+    ignore_case = bool(flags & re.IGNORECASE)
+    if ignore_case:
+        if not text.isascii():
+            return None
+        text = text.lower()
+    return text, ignore_case
+
+
+def text_marker_for(regexes: Iterable[tuple[int, Union[str, 'Pattern[str]']]], flags: int) -> TextMarker | None:
+    patterns = []
+    ignore_cases = set()
+    for color, expression in regexes:
+        q = plain_text_of_regex(expression, flags)
+        if q is None:
+            return None
+        patterns.append((color, q[0]))
+        ignore_cases.add(q[1])
+    if len(ignore_cases) != 1:
+        return None
+    return TextMarker(tuple(patterns), ignore_cases.pop())
+
+
+def marker_from_regex(expression: Union[str, 'Pattern[str]'], color: int, flags: int = re.UNICODE) -> Marker:
     color = max(1, min(color, 3))
+    if (tm := text_marker_for(((color, expression),), flags)) is not None:
+        return tm
     if isinstance(expression, str):
         pat = re.compile(expression, flags=flags)
     else:
@@ -41,7 +85,10 @@ def marker(text: str, left_address: int, right_address: int, color_address: int)
     return marker
 
 
-def marker_from_multiple_regex(regexes: Iterable[tuple[int, str]], flags: int = re.UNICODE) -> MarkerFunc:
+def marker_from_multiple_regex(regexes: Iterable[tuple[int, str]], flags: int = re.UNICODE) -> Marker:
+    regexes = tuple(regexes)
+    if (tm := text_marker_for(regexes, flags)) is not None:
+        return tm
     expr = ''
     color_map = {}
     for i, (color, spec) in enumerate(regexes):
@@ -63,7 +110,7 @@ def marker(text: str, left_address: int, right_address: int, color_address: int)
     return marker
 
 
-def marker_from_text(expression: str, color: int) -> MarkerFunc:
+def marker_from_text(expression: str, color: int) -> Marker:
     return marker_from_regex(re.escape(expression), color)
 
 
@@ -79,7 +126,7 @@ def marker(text: str, left_address: int, right_address: int, color_address: int)
     return marker
 
 
-def marker_from_spec(ftype: str, spec: str | Sequence[tuple[int, str]], flags: int) -> MarkerFunc:
+def marker_from_spec(ftype: str, spec: str | Sequence[tuple[int, str]], flags: int) -> Marker:
     if ftype == 'regex':
         assert not isinstance(spec, str)
         if len(spec) == 1:
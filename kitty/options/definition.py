@@ -209,6 +209,26 @@
 '''
     )
 
+opt('cache_box_drawing', 'no', option_type='to_bool',
+    long_text='''
+Store the rendered box drawing characters (see :opt:`box_drawing_scale`) in
+the kitty cache directory and re-use them in later kitty instances. This speeds
+up the first render after startup at large font sizes on high DPI screens. The
+cache is specific to the cell size, DPI and :opt:`box_drawing_scale` and is
+discarded when kitty is updated.
+'''
+    )
+
+opt('prerender_box_drawing', 'no', option_type='to_bool',
+    long_text='''
+Render all the box drawing characters (see :opt:`box_drawing_scale`) in
+background threads when the fonts for a font size are loaded, so that they do
+not have to be rendered when they are first displayed. This is useful for
+sessions that use many of them, such as tmux or other full screen programs
+with borders. Works well together with :opt:`cache_box_drawing`.
+'''
+    )
+
 opt('undercurl_style', 'thin-sparse', ctype='undercurl_style',
     choices=('thin-sparse', 'thin-dense', 'thick-sparse', 'thick-dense'),
     long_text='''
@@ -471,12 +491,37 @@
 scrolling but will be piped to the pager program when viewing scrollback buffer
 in a separate window. The current implementation stores the data in UTF-8, so
 approximately 10000 lines per megabyte at 100 chars per line, for pure ASCII,
-unformatted text. A value of zero or less disables this feature. The maximum
+unformatted text. Sizes larger than one megabyte are stored compressed, with
+the limit applying to the memory used, so typically several times as much
+text fits. A value of zero or less disables this feature. The maximum
 allowed size is 4GB. Note that on config reload if this is changed it will only
 affect newly created windows, not existing ones.
 '''
     )
 
+opt('scrollback_disk_cache_size', '0',
+    option_type='positive_int', ctype='uint',
+    long_text='''
+The maximum amount of disk space (in MB) used to store scrollback. Parts of the
+scrollback that are not in use are stored compressed and, when this is non-zero,
+written to a temporary file on disk, keeping RAM usage low even with a very large
+:opt:`scrollback_lines`. They are read back in when scrolled to. A value of zero
+disables writing scrollback to disk. What happens when the limit is reached is
+controlled by :opt:`scrollback_disk_cache_policy`. Note that on config reload if
+this is changed it will only affect newly created windows, not existing ones.
+'''
+    )
+
+opt('scrollback_disk_cache_policy', 'keep_in_ram',
+    choices=('keep_in_ram', 'discard_oldest'), ctype='scrollback_disk_cache_policy',
+    long_text='''
+What to do when the scrollback stored on disk reaches
+:opt:`scrollback_disk_cache_size`. With :code:`keep_in_ram` further scrollback
+is kept compressed in RAM. With :code:`discard_oldest` the oldest lines stored
+on disk are discarded to make room, they become blank lines.
+'''
+    )
+
 opt('scrollback_fill_enlarged_window', 'no',
     option_type='to_bool', ctype='bool',
     long_text='Fill new space with lines from the scrollback buffer after enlarging a window.'
@@ -957,6 +1002,19 @@
 '''
     )
 
+opt('adaptive_input_delay', 'no',
+    option_type='to_bool', ctype='bool',
+    long_text='''
+Adapt :opt:`input_delay` and :opt:`repaint_delay` to the program running in the
+terminal, based on how much output it produces. When a program produces a
+large amount of output, such as when running :code:`cat` on a huge file, input
+is coalesced for longer and the screen is redrawn less often. When the output
+is the echo of recently typed keys, it is processed and drawn immediately.
+The regime each window is currently in is reported as :code:`input_regime`
+by :code:`kitten @ ls`.
+'''
+    )
+
 opt('sync_to_monitor', 'yes',
     option_type='to_bool', ctype='bool',
     long_text='''
@@ -965,6 +1023,45 @@
 scrolling. However, it limits the rendering speed to the refresh rate of your
 monitor. With a very high speed mouse/high keyboard repeat rate, you may notice
 some slight input latency. If so, set this to :code:`no`.
+'''
+    )
+
+opt('parse_threads', '0',
+    option_type='positive_int', ctype='uint',
+    long_text='''
+The number of threads used to process input from programs running in the
+terminal when several windows are receiving output at the same time. Plain
+text and simple formatting escape codes are processed in parallel, everything
+else is processed on the main thread. The default value of zero means use a
+number of threads based on the number of available CPUs. Set to :code:`1` to
+process all input on the main thread.
+'''
+    )
+
+opt('sprite_memory_limit', '0',
+    option_type='positive_int', ctype='uint',
+    long_text='''
+The maximum amount of GPU memory (in MB) used to store the rendered glyphs of
+each font size. When it is exceeded, all rendered glyphs are discarded and the
+glyphs currently on screen are rendered again, keeping memory usage bounded
+when displaying very large numbers of distinct characters, such as CJK text or
+many different fonts and sizes. So that glyphs are not rendered again
+repeatedly when the glyphs on screen do not quite fit, the limit is doubled the
+first time it is exceeded, and glyphs are discarded at most once a second. The
+default value of zero means no limit, in
+which case glyphs are only discarded when the maximum texture size supported by
+the GPU is reached.
+'''
+    )
+
+opt('image_texture_memory_limit', '0',
+    option_type='positive_int', ctype='uint',
+    long_text='''
+The maximum amount of GPU memory (in MB) used to store images, across all
+windows. When it is exceeded, the textures of the images that have not been
+displayed for the longest time and are not currently visible are discarded.
+They are uploaded to the GPU again from the image cache when they are next
+displayed. The default value of zero means no limit.
 '''
     )
 egr()  # }}}
@@ -3335,6 +3432,20 @@
 '''
     )
 
+opt('predictive_echo', 'no',
+    choices=('no', 'remote', 'always'),
+    long_text='''
+Draw printable characters typed at a shell prompt immediately, underlined,
+instead of waiting for the shell to echo them. This makes typing over slow
+connections feel responsive. Predictions are removed as soon as the echo
+arrives and discarded if something else is drawn instead. With
+:code:`remote` this is done only while the foreground program is
+:program:`ssh`, including via the :doc:`ssh kitten </kittens/ssh>`. Requires
+:ref:`shell integration <shell_integration>` on the shell that draws
+the prompt.
+'''
+    )
+
 opt('allow_cloning', 'ask',
     choices=('yes', 'y', 'true', 'no', 'n', 'false', 'ask'),
     long_text='''
@@ -3433,6 +3544,22 @@
 '''
     )
 
+opt('command_output_capture_size', '0',
+    option_type='positive_int', ctype='uint',
+    long_text='''
+The maximum amount of memory (in MB) used to keep a separate, compressed copy of
+the output of every command run in a window (needs :opt:`shell_integration`).
+The text printed by a command is captured as it is received, independently of
+the scrollback, so the output of commands that printed more than fits in the
+scrollback is still available. The output of the most recent commands can be
+retrieved using :ref:`at-get-captured-output`. A single command uses at most
+this much memory, after which its output is truncated, and the oldest commands
+are discarded to stay under the limit. Output printed while the alternate screen
+is active, for example by full screen programs, is not captured. A value of
+zero disables capturing.
+'''
+    )
+
 opt('term', 'xterm-kitty',
     long_text='''
 The value of the :envvar:`TERM` environment variable to set. Changing this can
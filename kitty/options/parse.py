@@ -47,6 +47,9 @@ def active_tab_foreground(self, val: str, ans: dict[str, typing.Any]) -> None:
     def active_tab_title_template(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['active_tab_title_template'] = active_tab_title_template(val)
 
+    def adaptive_input_delay(self, val: str, ans: dict[str, typing.Any]) -> None:
+        ans['adaptive_input_delay'] = to_bool(val)
+
     def allow_cloning(self, val: str, ans: dict[str, typing.Any]) -> None:
         val = val.lower()
         if val not in self.choices_for_allow_cloning:
@@ -113,6 +116,9 @@ def bold_italic_font(self, val: str, ans: dict[str, typing.Any]) -> None:
     def box_drawing_scale(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['box_drawing_scale'] = box_drawing_scale(val)
 
+    def cache_box_drawing(self, val: str, ans: dict[str, typing.Any]) -> None:
+        ans['cache_box_drawing'] = to_bool(val)
+
     def clear_all_mouse_actions(self, val: str, ans: dict[str, typing.Any]) -> None:
         clear_all_mouse_actions(val, ans)
 
@@ -908,6 +914,9 @@ def color255(self, val: str, ans: dict[str, typing.Any]) -> None:
     def command_on_bell(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['command_on_bell'] = to_cmdline(val)
 
+    def command_output_capture_size(self, val: str, ans: dict[str, typing.Any]) -> None:
+        ans['command_output_capture_size'] = positive_int(val)
+
     def confirm_os_window_close(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['confirm_os_window_close'] = confirm_close(val)
 
@@ -1022,6 +1031,9 @@ def forward_stdio(self, val: str, ans: dict[str, typing.Any]) -> None:
     def hide_window_decorations(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['hide_window_decorations'] = hide_window_decorations(val)
 
+    def image_texture_memory_limit(self, val: str, ans: dict[str, typing.Any]) -> None:
+        ans['image_texture_memory_limit'] = positive_int(val)
+
     def inactive_border_color(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['inactive_border_color'] = to_color(val)
 
@@ -1152,6 +1164,9 @@ def notify_on_cmd_finish(self, val: str, ans: dict[str, typing.Any]) -> None:
     def open_url_with(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['open_url_with'] = to_cmdline(val)
 
+    def parse_threads(self, val: str, ans: dict[str, typing.Any]) -> None:
+        ans['parse_threads'] = positive_int(val)
+
     def paste_actions(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['paste_actions'] = paste_actions(val)
 
@@ -1174,6 +1189,17 @@ def pointer_shape_when_grabbed(self, val: str, ans: dict[str, typing.Any]) -> No
 
     choices_for_pointer_shape_when_grabbed = choices_for_default_pointer_shape
 
+    def predictive_echo(self, val: str, ans: dict[str, typing.Any]) -> None:
+        val = val.lower()
+        if val not in self.choices_for_predictive_echo:
+            raise ValueError(f"The value {val} is not a valid choice for predictive_echo")
+        ans["predictive_echo"] = val
+
+    choices_for_predictive_echo = frozenset(('no', 'remote', 'always'))
+
+    def prerender_box_drawing(self, val: str, ans: dict[str, typing.Any]) -> None:
+        ans['prerender_box_drawing'] = to_bool(val)
+
     def remember_window_position(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['remember_window_position'] = to_bool(val)
 
@@ -1193,6 +1219,17 @@ def resize_debounce_time(self, val: str, ans: dict[str, typing.Any]) -> None:
     def resize_in_steps(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['resize_in_steps'] = to_bool(val)
 
+    def scrollback_disk_cache_policy(self, val: str, ans: dict[str, typing.Any]) -> None:
+        val = val.lower()
+        if val not in self.choices_for_scrollback_disk_cache_policy:
+            raise ValueError(f"The value {val} is not a valid choice for scrollback_disk_cache_policy")
+        ans["scrollback_disk_cache_policy"] = val
+
+    choices_for_scrollback_disk_cache_policy = frozenset(('keep_in_ram', 'discard_oldest'))
+
+    def scrollback_disk_cache_size(self, val: str, ans: dict[str, typing.Any]) -> None:
+        ans['scrollback_disk_cache_size'] = positive_int(val)
+
     def scrollback_fill_enlarged_window(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['scrollback_fill_enlarged_window'] = to_bool(val)
 
@@ -1235,6 +1272,9 @@ def single_window_margin_width(self, val: str, ans: dict[str, typing.Any]) -> No
     def single_window_padding_width(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['single_window_padding_width'] = optional_edge_width(val)
 
+    def sprite_memory_limit(self, val: str, ans: dict[str, typing.Any]) -> None:
+        ans['sprite_memory_limit'] = positive_int(val)
+
     def startup_session(self, val: str, ans: dict[str, typing.Any]) -> None:
         ans['startup_session'] = config_or_absolute_path(val)
 
@@ -278,6 +278,32 @@ convert_from_opts_scrollback_pager_history_size(PyObject *py_opts, Options *opts
     Py_DECREF(ret);
 }
 
+static void
+convert_from_python_scrollback_disk_cache_size(PyObject *val, Options *opts) {
+    opts->scrollback_disk_cache_size = PyLong_AsUnsignedLong(val);
+}
+
+static void
+convert_from_opts_scrollback_disk_cache_size(PyObject *py_opts, Options *opts) {
+    PyObject *ret = PyObject_GetAttrString(py_opts, "scrollback_disk_cache_size");
+    if (ret == NULL) return;
+    convert_from_python_scrollback_disk_cache_size(ret, opts);
+    Py_DECREF(ret);
+}
+
+static void
+convert_from_python_scrollback_disk_cache_policy(PyObject *val, Options *opts) {
+    opts->scrollback_disk_cache_policy = scrollback_disk_cache_policy(val);
+}
+
+static void
+convert_from_opts_scrollback_disk_cache_policy(PyObject *py_opts, Options *opts) {
+    PyObject *ret = PyObject_GetAttrString(py_opts, "scrollback_disk_cache_policy");
+    if (ret == NULL) return;
+    convert_from_python_scrollback_disk_cache_policy(ret, opts);
+    Py_DECREF(ret);
+}
+
 static void
 convert_from_python_scrollback_fill_enlarged_window(PyObject *val, Options *opts) {
     opts->scrollback_fill_enlarged_window = PyObject_IsTrue(val);
@@ -551,6 +577,19 @@ convert_from_opts_input_delay(PyObject *py_opts, Options *opts) {
     Py_DECREF(ret);
 }
 
+static void
+convert_from_python_adaptive_input_delay(PyObject *val, Options *opts) {
+    opts->adaptive_input_delay = PyObject_IsTrue(val);
+}
+
+static void
+convert_from_opts_adaptive_input_delay(PyObject *py_opts, Options *opts) {
+    PyObject *ret = PyObject_GetAttrString(py_opts, "adaptive_input_delay");
+    if (ret == NULL) return;
+    convert_from_python_adaptive_input_delay(ret, opts);
+    Py_DECREF(ret);
+}
+
 static void
 convert_from_python_sync_to_monitor(PyObject *val, Options *opts) {
     opts->sync_to_monitor = PyObject_IsTrue(val);
@@ -564,6 +603,45 @@ convert_from_opts_sync_to_monitor(PyObject *py_opts, Options *opts) {
     Py_DECREF(ret);
 }
 
+static void
+convert_from_python_parse_threads(PyObject *val, Options *opts) {
+    opts->parse_threads = PyLong_AsUnsignedLong(val);
+}
+
+static void
+convert_from_opts_parse_threads(PyObject *py_opts, Options *opts) {
+    PyObject *ret = PyObject_GetAttrString(py_opts, "parse_threads");
+    if (ret == NULL) return;
+    convert_from_python_parse_threads(ret, opts);
+    Py_DECREF(ret);
+}
+
+static void
+convert_from_python_sprite_memory_limit(PyObject *val, Options *opts) {
+    opts->sprite_memory_limit = PyLong_AsUnsignedLong(val);
+}
+
+static void
+convert_from_opts_sprite_memory_limit(PyObject *py_opts, Options *opts) {
+    PyObject *ret = PyObject_GetAttrString(py_opts, "sprite_memory_limit");
+    if (ret == NULL) return;
+    convert_from_python_sprite_memory_limit(ret, opts);
+    Py_DECREF(ret);
+}
+
+static void
+convert_from_python_image_texture_memory_limit(PyObject *val, Options *opts) {
+    opts->image_texture_memory_limit = PyLong_AsUnsignedLong(val);
+}
+
+static void
+convert_from_opts_image_texture_memory_limit(PyObject *py_opts, Options *opts) {
+    PyObject *ret = PyObject_GetAttrString(py_opts, "image_texture_memory_limit");
+    if (ret == NULL) return;
+    convert_from_python_image_texture_memory_limit(ret, opts);
+    Py_DECREF(ret);
+}
+
 static void
 convert_from_python_enable_audio_bell(PyObject *val, Options *opts) {
     opts->enable_audio_bell = PyObject_IsTrue(val);
@@ -1019,6 +1097,19 @@ convert_from_opts_allow_hyperlinks(PyObject *py_opts, Options *opts) {
     Py_DECREF(ret);
 }
 
+static void
+convert_from_python_command_output_capture_size(PyObject *val, Options *opts) {
+    opts->command_output_capture_size = PyLong_AsUnsignedLong(val);
+}
+
+static void
+convert_from_opts_command_output_capture_size(PyObject *py_opts, Options *opts) {
+    PyObject *ret = PyObject_GetAttrString(py_opts, "command_output_capture_size");
+    if (ret == NULL) return;
+    convert_from_python_command_output_capture_size(ret, opts);
+    Py_DECREF(ret);
+}
+
 static void
 convert_from_python_menu_map(PyObject *val, Options *opts) {
     menu_map(val, opts);
@@ -1232,6 +1323,10 @@ convert_opts_from_python_opts(PyObject *py_opts, Options *opts) {
     if (PyErr_Occurred()) return false;
     convert_from_opts_scrollback_pager_history_size(py_opts, opts);
     if (PyErr_Occurred()) return false;
+    convert_from_opts_scrollback_disk_cache_size(py_opts, opts);
+    if (PyErr_Occurred()) return false;
+    convert_from_opts_scrollback_disk_cache_policy(py_opts, opts);
+    if (PyErr_Occurred()) return false;
     convert_from_opts_scrollback_fill_enlarged_window(py_opts, opts);
     if (PyErr_Occurred()) return false;
     convert_from_opts_wheel_scroll_multiplier(py_opts, opts);
@@ -1274,8 +1369,16 @@ convert_opts_from_python_opts(PyObject *py_opts, Options *opts) {
     if (PyErr_Occurred()) return false;
     convert_from_opts_input_delay(py_opts, opts);
     if (PyErr_Occurred()) return false;
+    convert_from_opts_adaptive_input_delay(py_opts, opts);
+    if (PyErr_Occurred()) return false;
     convert_from_opts_sync_to_monitor(py_opts, opts);
     if (PyErr_Occurred()) return false;
+    convert_from_opts_parse_threads(py_opts, opts);
+    if (PyErr_Occurred()) return false;
+    convert_from_opts_sprite_memory_limit(py_opts, opts);
+    if (PyErr_Occurred()) return false;
+    convert_from_opts_image_texture_memory_limit(py_opts, opts);
+    if (PyErr_Occurred()) return false;
     convert_from_opts_enable_audio_bell(py_opts, opts);
     if (PyErr_Occurred()) return false;
     convert_from_opts_visual_bell_duration(py_opts, opts);
@@ -1346,6 +1449,8 @@ convert_opts_from_python_opts(PyObject *py_opts, Options *opts) {
     if (PyErr_Occurred()) return false;
     convert_from_opts_allow_hyperlinks(py_opts, opts);
     if (PyErr_Occurred()) return false;
+    convert_from_opts_command_output_capture_size(py_opts, opts);
+    if (PyErr_Occurred()) return false;
     convert_from_opts_menu_map(py_opts, opts);
     if (PyErr_Occurred()) return false;
     convert_from_opts_wayland_titlebar_color(py_opts, opts);
@@ -75,6 +75,13 @@ undercurl_style(PyObject *x) {
     return ans;
 }
 
+static inline bool
+scrollback_disk_cache_policy(PyObject *x) {
+    // true if the oldest lines should be discarded when the disk cache is full
+    const char *in = PyUnicode_AsUTF8(x);
+    return in && strcmp(in, "discard_oldest") == 0;
+}
+
 static inline UnderlineHyperlinks
 underline_hyperlinks(PyObject *x) {
     const char *in = PyUnicode_AsUTF8(x);
@@ -27,6 +27,8 @@
 choices_for_macos_show_window_title_in = typing.Literal['all', 'menubar', 'none', 'window']
 choices_for_placement_strategy = typing.Literal['top-left', 'top', 'top-right', 'left', 'center', 'right', 'bottom-left', 'bottom', 'bottom-right']
 choices_for_pointer_shape_when_grabbed = choices_for_default_pointer_shape
+choices_for_predictive_echo = typing.Literal['no', 'remote', 'always']
+choices_for_scrollback_disk_cache_policy = typing.Literal['keep_in_ram', 'discard_oldest']
 choices_for_strip_trailing_spaces = typing.Literal['always', 'never', 'smart']
 choices_for_tab_bar_align = typing.Literal['left', 'center', 'right']
 choices_for_tab_bar_style = typing.Literal['fade', 'hidden', 'powerline', 'separator', 'slant', 'custom']
@@ -44,6 +46,7 @@
     'active_tab_font_style',
     'active_tab_foreground',
     'active_tab_title_template',
+    'adaptive_input_delay',
     'allow_cloning',
     'allow_hyperlinks',
     'allow_remote_control',
@@ -61,6 +64,7 @@
     'bold_font',
     'bold_italic_font',
     'box_drawing_scale',
+    'cache_box_drawing',
     'clear_all_mouse_actions',
     'clear_all_shortcuts',
     'clear_selection_on_clipboard_loss',
@@ -326,6 +330,7 @@
     'color254',
     'color255',
     'command_on_bell',
+    'command_output_capture_size',
     'confirm_os_window_close',
     'copy_on_select',
     'cursor',
@@ -361,6 +366,7 @@
     'foreground',
     'forward_stdio',
     'hide_window_decorations',
+    'image_texture_memory_limit',
     'inactive_border_color',
     'inactive_tab_background',
     'inactive_tab_font_style',
@@ -400,16 +406,21 @@
     'narrow_symbols',
     'notify_on_cmd_finish',
     'open_url_with',
+    'parse_threads',
     'paste_actions',
     'placement_strategy',
     'pointer_shape_when_dragging',
     'pointer_shape_when_grabbed',
+    'predictive_echo',
+    'prerender_box_drawing',
     'remember_window_position',
     'remember_window_size',
     'remote_control_password',
     'repaint_delay',
     'resize_debounce_time',
     'resize_in_steps',
+    'scrollback_disk_cache_policy',
+    'scrollback_disk_cache_size',
     'scrollback_fill_enlarged_window',
     'scrollback_indicator_opacity',
     'scrollback_lines',
@@ -424,6 +435,7 @@
     'show_hyperlink_targets',
     'single_window_margin_width',
     'single_window_padding_width',
+    'sprite_memory_limit',
     'startup_session',
     'strip_trailing_spaces',
     'symbol_map',
@@ -485,6 +497,7 @@ class Options:
     active_tab_font_style: tuple[bool, bool] = (True, True)
     active_tab_foreground: Color = Color(0, 0, 0)
     active_tab_title_template: str | None = None
+    adaptive_input_delay: bool = False
     allow_cloning: choices_for_allow_cloning = 'ask'
     allow_hyperlinks: int = 1
     allow_remote_control: choices_for_allow_remote_control = 'no'
@@ -502,6 +515,7 @@ class Options:
     bold_font: FontSpec = FontSpec(family=None, style=None, postscript_name=None, full_name=None, system='auto', axes=(), variable_name=None, features=(), created_from_string='auto')
     bold_italic_font: FontSpec = FontSpec(family=None, style=None, postscript_name=None, full_name=None, system='auto', axes=(), variable_name=None, features=(), created_from_string='auto')
     box_drawing_scale: tuple[float, float, float, float] = (0.001, 1.0, 1.5, 2.0)
+    cache_box_drawing: bool = False
     clear_all_mouse_actions: bool = False
     clear_all_shortcuts: bool = False
     clear_selection_on_clipboard_loss: bool = False
@@ -511,6 +525,7 @@ class Options:
     clone_source_strategies: frozenset[str] = frozenset({'conda', 'env_var', 'path', 'venv'})
     close_on_child_death: bool = False
     command_on_bell: list[str] = ['none']
+    command_output_capture_size: int = 0
     confirm_os_window_close: tuple[int, bool] = (-1, False)
     copy_on_select: str = ''
     cursor: kitty.fast_data_types.Color | None = Color(204, 204, 204)
@@ -542,6 +557,7 @@ class Options:
     foreground: Color = Color(221, 221, 221)
     forward_stdio: bool = False
     hide_window_decorations: int = 0
+    image_texture_memory_limit: int = 0
     inactive_border_color: Color = Color(204, 204, 204)
     inactive_tab_background: Color = Color(153, 153, 153)
     inactive_tab_font_style: tuple[bool, bool] = (False, False)
@@ -575,15 +591,20 @@ class Options:
     mouse_hide_wait: MouseHideWait = MouseHideWait(hide_wait=0.0, show_wait=0.0, show_threshold=40, scroll_show=True) if is_macos else MouseHideWait(hide_wait=3.0, show_wait=0.0, show_threshold=40, scroll_show=True)
     notify_on_cmd_finish: NotifyOnCmdFinish = NotifyOnCmdFinish(when='never', duration=5.0, action='notify', cmdline=(), clear_on=('focus', 'next'))
     open_url_with: list[str] = ['default']
+    parse_threads: int = 0
     paste_actions: frozenset[str] = frozenset({'confirm', 'quote-urls-at-prompt'})
     placement_strategy: choices_for_placement_strategy = 'center'
     pointer_shape_when_dragging: tuple[str, str] = ('beam', 'crosshair')
     pointer_shape_when_grabbed: choices_for_pointer_shape_when_grabbed = 'arrow'
+    predictive_echo: choices_for_predictive_echo = 'no'
+    prerender_box_drawing: bool = False
     remember_window_position: bool = False
     remember_window_size: bool = True
     repaint_delay: int = 10
     resize_debounce_time: tuple[float, float] = (0.1, 0.5)
     resize_in_steps: bool = False
+    scrollback_disk_cache_policy: choices_for_scrollback_disk_cache_policy = 'keep_in_ram'
+    scrollback_disk_cache_size: int = 0
     scrollback_fill_enlarged_window: bool = False
     scrollback_indicator_opacity: float = 1.0
     scrollback_lines: int = 2000
@@ -598,6 +619,7 @@ class Options:
     show_hyperlink_targets: bool = False
     single_window_margin_width: FloatEdges = FloatEdges(left=-1.0, top=-1.0, right=-1.0, bottom=-1.0)
     single_window_padding_width: FloatEdges = FloatEdges(left=-1.0, top=-1.0, right=-1.0, bottom=-1.0)
+    sprite_memory_limit: int = 0
     startup_session: str | None = None
     strip_trailing_spaces: choices_for_strip_trailing_spaces = 'never'
     sync_to_monitor: bool = True
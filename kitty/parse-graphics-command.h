@@ -5,7 +5,8 @@
 #include "base64.h"
 
 static inline void parse_graphics_code(PS *self, uint8_t *parser_buf,
-                                       const size_t parser_buf_pos) {
+                                       const size_t parser_buf_pos,
+                                       const bool is_partial) {
   unsigned int pos = 1;
 
   enum PARSER_STATES { KEY, EQUAL, UINT, INT, FLAG, AFTER_VALUE, PAYLOAD };
@@ -47,7 +48,8 @@ static inline void parse_graphics_code(PS *self, uint8_t *parser_buf,
     parent_id = 'P',
     parent_placement_id = 'Q',
     offset_from_parent_x = 'H',
-    offset_from_parent_y = 'V'
+    offset_from_parent_y = 'V',
+    ephemeral = 'E'
   };
 
   enum KEYS key = 'a';
@@ -147,6 +149,9 @@ static inline void parse_graphics_code(PS *self, uint8_t *parser_buf,
       case offset_from_parent_y:
         value_state = INT;
         break;
+      case ephemeral:
+        value_state = UINT;
+        break;
       default:
         REPORT_ERROR("Malformed GraphicsCommand control block, invalid key "
                      "character: 0x%x",
@@ -299,6 +304,7 @@ static inline void parse_graphics_code(PS *self, uint8_t *parser_buf,
         U(unicode_placement);
         U(parent_id);
         U(parent_placement_id);
+        U(ephemeral);
       default:
         break;
       }
@@ -357,9 +363,14 @@ static inline void parse_graphics_code(PS *self, uint8_t *parser_buf,
     break;
   }
 
+  if (is_partial) {
+    g.more = 1;
+    self->partial_command_dispatched = true;
+  }
+
   REPORT_VA_COMMAND(
       "K s {sc sc sc sc sI sI sI sI sI sI sI sI sI sI sI sI sI sI sI sI sI sI "
-      "sI sI sI sI si si si ss#}",
+      "sI sI sI sI sI si si si ss#}",
       self->window_id, "graphics_command",
 
       "action", g.action, "delete_action", g.delete_action, "transmission_type",
@@ -378,7 +389,8 @@ static inline void parse_graphics_code(PS *self, uint8_t *parser_buf,
       "cell_y_offset", (unsigned int)g.cell_y_offset, "cursor_movement",
       (unsigned int)g.cursor_movement, "unicode_placement",
       (unsigned int)g.unicode_placement, "parent_id", (unsigned int)g.parent_id,
-      "parent_placement_id", (unsigned int)g.parent_placement_id,
+      "parent_placement_id", (unsigned int)g.parent_placement_id, "ephemeral",
+      (unsigned int)g.ephemeral,
 
       "z_index", (int)g.z_index, "offset_from_parent_x",
       (int)g.offset_from_parent_x, "offset_from_parent_y",
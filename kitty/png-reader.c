@@ -10,9 +10,13 @@
 #include "cleanup.h"
 #include "state.h"
 #include <lcms2.h>
+#include <pthread.h>
 
 
 static cmsHPROFILE srgb_profile = NULL;
+// PNGs are also decoded in worker threads
+static pthread_once_t srgb_profile_once = PTHREAD_ONCE_INIT;
+static void create_srgb_profile(void) { srgb_profile = cmsCreate_sRGBProfile(); }
 struct fake_file { const uint8_t *buf; size_t sz, cur; };
 
 static void
@@ -83,10 +87,8 @@ inflate_png_inner(png_read_data *d, const uint8_t *buf, size_t bufsz) {
         if (png_get_iCCP(png, info, &name, &compression_type, &profdata, &proflen) & PNG_INFO_iCCP) {
             input_profile = cmsOpenProfileFromMem(profdata, proflen);
             if (input_profile) {
-                if (!srgb_profile) {
-                    srgb_profile = cmsCreate_sRGBProfile();
-                    if (!srgb_profile) ABRT(ENOMEM, "Out of memory allocating sRGB colorspace profile");
-                }
+                pthread_once(&srgb_profile_once, create_srgb_profile);
+                if (!srgb_profile) ABRT(ENOMEM, "Out of memory allocating sRGB colorspace profile");
                 colorspace_transform = cmsCreateTransform(
                     input_profile, TYPE_RGBA_8, srgb_profile, TYPE_RGBA_8, INTENT_PERCEPTUAL, 0);
 
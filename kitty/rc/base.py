@@ -4,6 +4,7 @@
 from collections.abc import Callable, Iterable, Iterator
 from contextlib import suppress
 from dataclasses import dataclass, field
+from functools import lru_cache
 from io import BytesIO
 from typing import TYPE_CHECKING, Any, NoReturn, Optional, Union, cast
 
@@ -458,6 +459,7 @@ def display_subcommand_help(func: RemoteCommand) -> None:
         parse_args(['--help'], (func.options_spec or '\n').format, func.args.spec, func.desc, func.name)
 
 
+@lru_cache(maxsize=256)
 def command_for_name(cmd_name: str) -> RemoteCommand:
     from importlib import import_module
     cmd_name = cmd_name.replace('-', '_')
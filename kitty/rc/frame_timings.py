@@ -0,0 +1,40 @@
+#!/usr/bin/env python
+# License: GPLv3 Copyright: 2025, Kovid Goyal <kovid at kovidgoyal.net>
+
+import json
+import os
+from typing import Any
+
+from .base import ArgsType, Boss, PayloadGetType, PayloadType, RCOptions, RemoteCommand, ResponseType, Window
+
+
+class FrameTimings(RemoteCommand):
+
+    protocol_spec = __doc__ = '''
+    '''
+
+    short_desc = 'Get the timings of recently rendered frames'
+    desc = (
+        'Get the timings of the various stages of parsing input and rendering the most recent frames in all OS windows.'
+        ' The timings are output in the Chrome trace event format, which can be loaded into a trace viewer such as'
+        ' :file:`chrome://tracing` or https://ui.perfetto.dev for analysis. Each OS window is shown as a separate thread'
+        ' with the time taken by every frame broken down into updating the cell data (which includes shaping and'
+        ' rendering text), updating the graphics layers, uploading sprites, drawing and swapping buffers.'
+    )
+
+    def message_to_kitty(self, global_opts: RCOptions, opts: Any, args: ArgsType) -> PayloadType:
+        return {}
+
+    def response_from_kitty(self, boss: Boss, window: Window | None, payload_get: PayloadGetType) -> ResponseType:
+        from kitty.fast_data_types import get_frame_timings
+        pid = os.getpid()
+        events: list[dict[str, Any]] = [{'name': 'thread_name', 'ph': 'M', 'pid': pid, 'tid': 0, 'args': {'name': 'Input'}}]
+        events.extend(
+            {'name': 'thread_name', 'ph': 'M', 'pid': pid, 'tid': os_window_id, 'args': {'name': f'OS Window {os_window_id}'}}
+            for os_window_id in boss.os_window_map)
+        for stage, os_window_id, start, duration in get_frame_timings():
+            events.append({'name': stage, 'ph': 'X', 'pid': pid, 'tid': os_window_id, 'ts': start / 1000, 'dur': duration / 1000})
+        return json.dumps({'traceEvents': events, 'displayTimeUnit': 'ms'})
+
+
+frame_timings = FrameTimings()
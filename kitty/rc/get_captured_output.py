@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+# License: GPLv3 Copyright: 2026, Kovid Goyal <kovid at kovidgoyal.net>
+
+import json
+from typing import TYPE_CHECKING
+
+from .base import MATCH_WINDOW_OPTION, ArgsType, Boss, PayloadGetType, PayloadType, RCOptions, RemoteCommand, ResponseType, Window
+
+if TYPE_CHECKING:
+    from kitty.cli_stub import GetCapturedOutputRCOptions as CLIOptions
+
+
+class GetCapturedOutput(RemoteCommand):
+
+    protocol_spec = __doc__ = '''
+    match/str: The window to get captured output from
+    index/int: The index of the command, negative numbers count from the most recent command
+    list/bool: Boolean, if True return a JSON list of the captured commands instead of output
+    self/bool: Boolean, if True use window the command was run in
+    '''
+
+    short_desc = 'Get the captured output of recently run commands'
+    desc = (
+        'Get the output of recently run commands in the specified window, as captured'
+        ' when :opt:`command_output_capture_size` is set. Unlike :ref:`at-get-text` this'
+        ' works even for commands whose output no longer fits in the scrollback.'
+        ' Requires :ref:`shell_integration` to be enabled.'
+    )
+    options_spec = MATCH_WINDOW_OPTION + '''\n
+--index
+type=int
+default=-1
+The command to get the output of. Zero is the oldest captured command and
+negative numbers count backwards from the most recent command, so the default
+of :code:`-1` is the last command run.
+
+
+--list
+type=bool-set
+Instead of the output, print a JSON list of the captured commands with their
+command lines, exit statuses and sizes.
+
+
+--self
+type=bool-set
+Get output from the window this command is run in, rather than the active window.
+'''
+
+    def message_to_kitty(self, global_opts: RCOptions, opts: 'CLIOptions', args: ArgsType) -> PayloadType:
+        return {'match': opts.match, 'index': opts.index, 'list': opts.list, 'self': opts.self}
+
+    def response_from_kitty(self, boss: Boss, window: Window | None, payload_get: PayloadGetType) -> ResponseType:
+        windows = self.windows_for_match_payload(boss, window, payload_get)
+        if windows and windows[0]:
+            window = windows[0]
+        else:
+            return None
+        q = window.captured_command_outputs
+        if payload_get('list'):
+            return json.dumps([{
+                'cmdline': c.cmdline, 'exit_status': c.exit_status, 'finished_at': c.finished_at,
+                'size': c.size, 'truncated': c.truncated} for c in q], indent=2)
+        idx = payload_get('index')
+        idx = -1 if idx is None else int(idx)
+        try:
+            c = q[idx]
+        except IndexError:
+            return None
+        return c.as_text()
+
+
+get_captured_output = GetCapturedOutput()
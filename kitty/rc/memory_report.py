@@ -0,0 +1,33 @@
+#!/usr/bin/env python
+# License: GPLv3 Copyright: 2025, Kovid Goyal <kovid at kovidgoyal.net>
+
+import json
+from typing import Any
+
+from .base import ArgsType, Boss, PayloadGetType, PayloadType, RCOptions, RemoteCommand, ResponseType, Window
+
+
+class MemoryReport(RemoteCommand):
+
+    protocol_spec = __doc__ = '''
+    '''
+
+    short_desc = 'Get the memory used by all windows'
+    desc = (
+        'Get the number of bytes of memory used by every OS window, tab and window as JSON. For every window'
+        ' the memory is broken down into the screen line buffers, the scrollback (uncompressed, compressed and'
+        ' spilled to disk), the pager history, the text cache, the parser buffer, ANSI formatting buffer and'
+        ' images (data in RAM and on disk, GPU textures and composed animation frames). For every OS window the'
+        ' memory used by the sprite textures and the font caches is reported. These belong to the font group'
+        ' of the OS window, which is shared by all OS windows that have the same font size and DPI, as'
+        ' indicated by the font_group key.'
+    )
+
+    def message_to_kitty(self, global_opts: RCOptions, opts: Any, args: ArgsType) -> PayloadType:
+        return {}
+
+    def response_from_kitty(self, boss: Boss, window: Window | None, payload_get: PayloadGetType) -> ResponseType:
+        return json.dumps(boss.memory_report(), indent=2, sort_keys=True)
+
+
+memory_report = MemoryReport()
@@ -6,9 +6,9 @@
 from typing import TYPE_CHECKING, Any
 
 from kitty.fast_data_types import KeyEvent as WindowSystemKeyEvent
-from kitty.fast_data_types import get_boss
+from kitty.fast_data_types import get_boss, set_broadcast_targets
 from kitty.key_encoding import decode_key_event_as_window_system_key
-from kitty.options.utils import parse_send_text_bytes
+from kitty.options.utils import parse_send_text_bytes, parse_shortcut
 from kitty.utils import sanitize_for_bracketed_paste
 
 from .base import (
@@ -32,10 +32,13 @@
 class Session:
     id: str
     window_ids: set[int]
+    # the window whose key events are fanned out natively, see set_broadcast_targets()
+    source_window_id: int
 
     def __init__(self, id: str):
         self.id = id
         self.window_ids = set()
+        self.source_window_id = 0
 
 
 sessions_map: dict[str, Session] = {}
@@ -52,6 +55,8 @@ class ClearSession(SessionAction):
     def __call__(self, *a: Any) -> None:
         s = sessions_map.pop(self.sid, None)
         if s is not None:
+            if s.source_window_id:
+                set_broadcast_targets(s.source_window_id, (), ())
             boss = get_boss()
             for wid in s.window_ids:
                 qw = boss.window_id_map.get(wid)
@@ -81,6 +86,8 @@ class SendText(RemoteCommand):
     exclude_active/bool: A boolean that prevents sending text to the active window
     session_id/str: A string that identifies a "broadcast session"
     bracketed_paste/choices.disable.auto.enable: Whether to wrap the text in bracketed paste escape codes
+    native_keys/bool: When starting a session, forward key events from the window the command is run in directly to the session windows
+    excluded_keys/list.str: Shortcuts that are not forwarded when native_keys is set
     '''
     short_desc = 'Send arbitrary text to specified windows'
     desc = (
@@ -238,6 +245,10 @@ def is_ok(x: Any) -> bool:
             for w in actual_windows:
                 w.screen.render_unfocused_cursor = True
                 s.window_ids.add(w.id)
+            if window is not None and payload_get('native_keys'):
+                excluded = tuple(parse_shortcut(k) for k in payload_get('excluded_keys') or ())
+                if set_broadcast_targets(window.id, tuple(s.window_ids), excluded):
+                    s.source_window_id = window.id
         else:
             bp = payload_get('bracketed_paste')
             if sid:
@@ -250,9 +261,12 @@ def is_ok(x: Any) -> bool:
                     kdata = w.encoded_key(data)
                     if kdata:
                         w.write_to_child(kdata)
+                elif bp == 'auto' and w.screen.in_bracketed_paste_mode:
+                    # sanitizes and wraps the data in C without copying it
+                    w.screen.paste(data)
+                elif bp == 'enable':
+                    w.write_to_child(b'\x1b[200~' + sanitize_for_bracketed_paste(data) + b'\x1b[201~')
                 else:
-                    if bp == 'enable' or (bp == 'auto' and w.screen.in_bracketed_paste_mode):
-                        data = b'\x1b[200~' + sanitize_for_bracketed_paste(data) + b'\x1b[201~'
                     w.write_to_child(data)
         return None
 
@@ -0,0 +1,65 @@
+#!/usr/bin/env python
+# License: GPLv3 Copyright: 2025, Kovid Goyal <kovid at kovidgoyal.net>
+
+from typing import TYPE_CHECKING
+
+from .base import (
+    ArgsType,
+    Boss,
+    PayloadGetType,
+    PayloadType,
+    RCOptions,
+    RemoteCommand,
+    RemoteControlErrorWithoutTraceback,
+    ResponseType,
+    Window,
+)
+
+if TYPE_CHECKING:
+    from kitty.cli_stub import SubscribeRCOptions as CLIOptions
+
+
+EVENTS = (
+    'window_created', 'window_closed', 'title_changed', 'user_var_changed', 'focus_changed', 'command_started', 'command_finished',
+)
+
+
+def event_names() -> tuple[str, ...]:
+    return EVENTS
+
+
+class Subscribe(RemoteCommand):
+
+    protocol_spec = __doc__ = '''
+    events/list.str: The names of the events to report, all events if empty
+    '''
+
+    short_desc = 'Get a stream of events as they happen in kitty'
+    desc = (
+        'Subscribe to events in kitty, such as windows being created and closed, changes to their titles and user variables,'
+        ' focus changes and commands starting and finishing in the shell. Every event is printed as a line of JSON with'
+        ' the :code:`event` name, the :code:`window_id` and data specific to the event. This is much cheaper than'
+        ' polling :ref:`at-ls` for changes. Events are reported until this command is interrupted. It only works'
+        ' when connecting to kitty over a socket, see :option:`kitten @ --to`. The available events are: '
+    ) + ', '.join(f':code:`{x}`' for x in EVENTS) + '. If no events are specified, all of them are reported.'
+    args = RemoteCommand.Args(
+        spec='[EVENT ...]', json_field='events', special_parse='+events:subscribe_setup(io_data, args, &payload)',
+        completion=RemoteCommand.CompletionSpec.from_string('type:keyword group:"Event" kwds:' + ','.join(EVENTS)),
+        args_choices=event_names)
+
+    def message_to_kitty(self, global_opts: RCOptions, opts: 'CLIOptions', args: ArgsType) -> PayloadType:
+        return {'events': args}
+
+    def response_from_kitty(self, boss: Boss, window: Window | None, payload_get: PayloadGetType) -> ResponseType:
+        peer_id: int = payload_get('peer_id', missing=0)
+        if peer_id < 1:
+            raise RemoteControlErrorWithoutTraceback('Subscribing to events is only supported over a socket connection to kitty')
+        events = frozenset(payload_get('events') or ())
+        if unknown := events - frozenset(EVENTS):
+            raise RemoteControlErrorWithoutTraceback(f'Unknown events: {", ".join(sorted(unknown))}')
+        # the subscription ends when the peer disconnects, see Boss.peer_message_received()
+        boss.event_subscriptions[peer_id] = events
+        return {'event': 'subscribed'}
+
+
+subscribe = Subscribe()
@@ -39,6 +39,7 @@
 active_async_requests: dict[str, float] = {}
 active_streams: dict[str, str] = {}
 if TYPE_CHECKING:
+    from .fast_data_types import Secret
     from .window import Window
 
 
@@ -46,6 +47,41 @@ def encode_response_for_peer(response: Any) -> bytes:
     return b'\x1bP@kitty-cmd' + json.dumps(response).encode('utf-8') + b'\x1b\\'
 
 
+class SessionSecrets:
+    '''
+    Clients that send many encrypted commands, such as kitten @ shell or
+    commands that stream data, reuse their ephemeral key for a bounded
+    lifetime, so cache the secrets derived from them to avoid an ECDH
+    derivation per command. Commands encrypted with a cached secret must have
+    strictly increasing timestamps, preventing replay within a session.
+    '''
+
+    max_size = 64
+    lifetime = 5 * 60 * 10**9
+
+    def __init__(self) -> None:
+        self.entries: dict[bytes, tuple['Secret', int, int]] = {}  # key -> (secret, created_at, last timestamp)
+
+    def secret_for(self, encryption_key: EllipticCurveKey, pubkey: bytes) -> tuple['Secret', int]:
+        key = encryption_key.public + pubkey
+        e = self.entries.get(key)
+        if e is not None:
+            if time_ns() - e[1] < self.lifetime:
+                return e[0], e[2]
+            del self.entries[key]
+        return encryption_key.derive_secret(pubkey), 0
+
+    def record(self, encryption_key: EllipticCurveKey, pubkey: bytes, secret: 'Secret', timestamp: int) -> None:
+        key = encryption_key.public + pubkey
+        e = self.entries.pop(key, None)
+        self.entries[key] = (secret, time_ns() if e is None else e[1], timestamp)
+        while len(self.entries) > self.max_size:
+            del self.entries[next(iter(self.entries))]
+
+
+session_secrets = SessionSecrets()
+
+
 def parse_cmd(serialized_cmd: memoryview, encryption_key: EllipticCurveKey) -> dict[str, Any]:
     # See https://github.com/python/cpython/issues/74379 for why we cant use
     # memoryview directly :((
@@ -65,17 +101,24 @@ def parse_cmd(serialized_cmd: memoryview, encryption_key: EllipticCurveKey) -> d
         pubkey = pcmd.get('pubkey', '')
         if not pubkey:
             log_error('Ignoring encrypted rc command without a public key')
-        d = AES256GCMDecrypt(encryption_key.derive_secret(base64.b85decode(pubkey)), base64.b85decode(pcmd['iv']), base64.b85decode(pcmd['tag']))
+        raw_pubkey = base64.b85decode(pubkey)
+        secret, last_timestamp = session_secrets.secret_for(encryption_key, raw_pubkey)
+        d = AES256GCMDecrypt(secret, base64.b85decode(pcmd['iv']), base64.b85decode(pcmd['tag']))
         data = d.add_data_to_be_decrypted(base64.b85decode(pcmd['encrypted']), True)
         pcmd = json.loads(data)
         if not isinstance(pcmd, dict) or 'version' not in pcmd:
             return {}
-        delta = time_ns() - pcmd.pop('timestamp')
+        timestamp = pcmd.pop('timestamp')
+        delta = time_ns() - timestamp
         if abs(delta) > 5 * 60 * 1e9:
             log_error(
                 f'Ignoring encrypted rc command with timestamp {delta / 1e9:.1f} seconds from now.'
                 ' Could be an attempt at a replay attack or an incorrect clock on a remote machine.')
             return {}
+        if timestamp <= last_timestamp:
+            log_error('Ignoring encrypted rc command with a timestamp older than a previous command using the same key. Could be an attempt at a replay attack.')
+            return {}
+        session_secrets.record(encryption_key, raw_pubkey, secret, timestamp)
     return pcmd
 
 
@@ -87,14 +87,28 @@ def read_metadata(self, output_path: str) -> tuple[int, int, int]:
             f.seek(0)
             return width, height, os.dup(f.fileno())
 
-    def render(self, src_path: str) -> str:
+    def output_path_for(self, src_path: str) -> str:
         import struct
         from hashlib import sha256
         src_info = os.stat(src_path)
         output_name = sha256(struct.pack('@qqqq', src_info.st_dev, src_info.st_ino, src_info.st_size, src_info.st_mtime_ns)).hexdigest()
+        self.ensure_subdir()
+        return os.path.join(self.cache_dir, output_name)
 
+    def lookup(self, src_path: str) -> str:
+        # Used by kitty to decode PNG images in a worker thread directly into
+        # the cache. Returns the path to write the rendered image to if it is
+        # not already in the cache, otherwise an empty string.
+        output_path = self.output_path_for(src_path)
+        return '' if os.path.exists(output_path) else output_path
+
+    def prune(self) -> None:
+        with self:
+            self.prune_entries()
+
+    def render(self, src_path: str) -> str:
+        output_path = self.output_path_for(src_path)
         with self:
-            output_path = os.path.join(self.cache_dir, output_name)
             with suppress(OSError):
                 self.touch(output_path)
                 return output_path
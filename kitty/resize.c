@@ -7,6 +7,16 @@
 
 #include "resize.h"
 #include "lineops.h"
+#include "threading.h"
+#include <unistd.h>
+
+// Lines rewrapped by a worker thread, to be added to the history afterwards
+typedef struct DestLines {
+    CPUCell *cpu_cells;
+    GPUCell *gpu_cells;
+    LineAttrs *line_attrs;
+    index_type count, capacity;
+} DestLines;
 
 typedef struct Rewrap {
     struct {
@@ -18,6 +28,16 @@ typedef struct Rewrap {
     ANSIBuf *as_ansi_buf;
     TrackCursor *cursors;
     LineBuf *sb;
+    // when set, history lines are read using the reader and the output goes
+    // to dest_lines instead of dest.hb
+    HistoryBufReader *src_reader;
+    DestLines *dest_lines;
+    // when set, rewrapping of most of the history may be left for later, see
+    // defer_rewrap_of_old_history()
+    bool defer_history;
+    // when set, the history is never rewrapped on multiple threads
+    bool serial;
+    PendingRewrap *pending;
 
     index_type num_content_lines_before, src_x_limit;
     bool prev_src_line_ended_with_wrap, current_src_line_has_multline_cells, current_dest_line_has_multiline_cells;
@@ -61,7 +81,8 @@ init_src_line_basic(Rewrap *r, index_type y, Line *dest, bool update_state) {
         linebuf_init_line_at(r->src.lb, y - r->src.hb_count, dest);
     } else {
         // historybuf_init_line uses reverse indexing
-        historybuf_init_line(r->src.hb, r->src.hb->count - y - 1, dest);
+        if (r->src_reader) historybuf_reader_init_line(r->src_reader, r->src.hb->count - y - 1, dest);
+        else historybuf_init_line(r->src.hb, r->src.hb->count - y - 1, dest);
     }
 }
 
@@ -85,9 +106,28 @@ init_src_line(Rewrap *r) {
 
 #define set_dest_line_attrs(dest_y) r->dest.lb->line_attrs[dest_y] = r->src.line.attrs; r->src.line.attrs.prompt_kind = UNKNOWN_PROMPT_KIND;
 
+static void
+dest_lines_next_line(Rewrap *r, bool continued) {
+    DestLines *d = r->dest_lines;
+    if (d->count) d->cpu_cells[(size_t)d->count * dest_xnum - 1].next_char_was_wrapped = continued;
+    if (d->count >= d->capacity) {
+        d->capacity = MAX(1024u, 2 * d->capacity);
+        d->cpu_cells = realloc(d->cpu_cells, (size_t)d->capacity * dest_xnum * sizeof(CPUCell));
+        d->gpu_cells = realloc(d->gpu_cells, (size_t)d->capacity * dest_xnum * sizeof(GPUCell));
+        d->line_attrs = realloc(d->line_attrs, d->capacity * sizeof(LineAttrs));
+        if (!d->cpu_cells || !d->gpu_cells || !d->line_attrs) fatal("Out of memory rewrapping scrollback");
+    }
+    const size_t offset = (size_t)d->count * dest_xnum;
+    r->dest.line.cpu_cells = d->cpu_cells + offset; r->dest.line.gpu_cells = d->gpu_cells + offset;
+    zero_at_ptr_count(r->dest.line.cpu_cells, dest_xnum); zero_at_ptr_count(r->dest.line.gpu_cells, dest_xnum);
+    d->line_attrs[d->count++] = r->src.line.attrs;
+    r->src.line.attrs.prompt_kind = UNKNOWN_PROMPT_KIND;
+}
+
 static void
 first_dest_line(Rewrap *r) {
-    if (r->src.hb_count) {
+    if (r->dest_lines) dest_lines_next_line(r, false);
+    else if (r->src.hb_count) {
         historybuf_next_dest_line(r->dest.hb, r->as_ansi_buf, &r->src.line, 0, &r->dest.line, false);
         r->src.line.attrs.prompt_kind = UNKNOWN_PROMPT_KIND;
     } else {
@@ -133,6 +173,9 @@ next_dest_line(Rewrap *r, bool continued) {
             historybuf_init_line(r->dest.hb, 0, r->dest.hb->line);
             r->dest.hb->line->cpu_cells[dest_xnum-1].next_char_was_wrapped = true;
         }
+    } else if (r->dest_lines) {
+        dest_lines_next_line(r, continued);
+        r->dest.y++;
     } else {
         r->dest.y = historybuf_next_dest_line(r->dest.hb, r->as_ansi_buf, &r->src.line, r->dest.y, &r->dest.line, continued);
         r->src.line.attrs.prompt_kind = UNKNOWN_PROMPT_KIND;
@@ -250,6 +293,264 @@ fast_copy_src_to_dest(Rewrap *r) {
 }
 
 
+static void
+rewrap_lines(Rewrap *r, index_type limit) {
+    for (; r->src.y < limit; r->src.y++) {
+        if (init_src_line(r)) {
+            if (r->src.y) next_dest_line(r, false);
+            else first_dest_line(r);
+        }
+        if (r->current_src_line_has_multline_cells || r->current_dest_line_has_multiline_cells) multiline_copy_src_to_dest(r);
+        else fast_copy_src_to_dest(r);
+    }
+}
+
+// Parallel rewrap {{{
+// Logical lines are rewrapped independently of each other, so the history
+// is split into chunks at hard line breaks that are rewrapped by separate
+// threads and then added to the destination history in order. This is done
+// in rounds of a few thousand lines so that the rewrapped lines do not all
+// have to be held in memory at the same time. The lines after the last hard line break in the
+// history and the lines on the screen, which are the only ones that can
+// contain tracked cursors, are rewrapped afterwards as usual. Multiline cells
+// can extend across a hard line break, if that happens at the end of a chunk
+// the rest is rewrapped serially.
+
+#define PARALLEL_REWRAP_MIN_LINES 8192u
+#define REWRAP_CHUNK_LINES 1024u
+#define MAX_REWRAP_THREADS 8u
+
+typedef struct RewrapChunk {
+    Rewrap r;
+    HistoryBufReader reader;
+    DestLines lines;
+    TrackCursor no_cursors[1];
+    pthread_t thread;
+    index_type end;
+    bool ok, thread_started;
+} RewrapChunk;
+
+static unsigned
+num_of_rewrap_threads(void) {
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus < 4) return 1;
+    return MIN((unsigned)ncpus / 2u, MAX_REWRAP_THREADS);
+}
+
+static bool
+is_hard_line_break(HistoryBufReader *reader, index_type y) {
+    // whether history line y (counting from the oldest line) does not continue onto the next line
+    Line l;
+    historybuf_reader_init_line(reader, reader->hb->count - y - 1, &l);
+    return !l.cpu_cells[reader->hb->xnum - 1].next_char_was_wrapped;
+}
+
+static void
+rewrap_chunk(RewrapChunk *c) {
+    Rewrap *r = &c->r;
+    rewrap_lines(r, c->end);
+    c->ok = true;
+    // the extra lines of multiline cells that still need to be placed belong
+    // to lines in the next chunk
+    for (index_type y = 0; y < r->sb->ynum; y++) if (r->sb->line_attrs[y].has_dirty_text) c->ok = false;
+    if (c->lines.count) c->lines.cpu_cells[(size_t)c->lines.count * dest_xnum - 1].next_char_was_wrapped = false;
+}
+
+static void*
+rewrap_chunk_thread(void *data) {
+    set_thread_name("RewrapHistory");
+    rewrap_chunk(data);
+    return NULL;
+}
+
+static unsigned
+setup_rewrap_round(Rewrap *r, RewrapChunk *chunks, unsigned num_threads, index_type start, index_type end) {
+    unsigned num_chunks = 0;
+    for (; start < end && num_chunks < num_threads; num_chunks++) {
+        RewrapChunk *c = chunks + num_chunks;
+        index_type chunk_end = MIN(end, start + REWRAP_CHUNK_LINES);
+        while (chunk_end < end && !is_hard_line_break(&c->reader, chunk_end - 1)) chunk_end++;
+        LineBuf *sb = c->r.sb;
+        c->r = *r;
+        c->r.sb = sb; c->r.src.y = start; c->r.as_ansi_buf = NULL; c->r.cursors = c->no_cursors;
+        c->r.src_reader = &c->reader; c->r.dest_lines = &c->lines;
+        c->lines.count = 0; c->end = chunk_end; c->ok = false;
+        start = chunk_end;
+    }
+    return num_chunks;
+}
+
+static void
+rewrap_history_in_parallel(Rewrap *r) {
+    const unsigned num_threads = num_of_rewrap_threads();
+    if (!r->dest.hb || r->serial || r->src.hb_count < PARALLEL_REWRAP_MIN_LINES || num_threads < 2) return;
+    RewrapChunk chunks[MAX_REWRAP_THREADS] = {0};
+    bool ok = true;
+    for (unsigned i = 0; i < num_threads && ok; i++) {
+        chunks[i].no_cursors[0].is_sentinel = true;
+        ok = historybuf_reader_init(&chunks[i].reader, r->src.hb) && (chunks[i].r.sb = alloc_linebuf(r->sb->ynum, dest_xnum, r->src.lb->text_cache));
+    }
+    index_type end = r->src.hb_count, start = 0, num_lines = 0;
+    if (ok) while (end && !is_hard_line_break(&chunks[0].reader, end - 1)) end--;
+    Line l = {.xnum=dest_xnum, .text_cache=r->src.lb->text_cache};
+    while (ok && start < end) {
+        const unsigned num_chunks = setup_rewrap_round(r, chunks, num_threads, start, end);
+        for (unsigned i = 1; i < num_chunks; i++) {
+            chunks[i].thread_started = pthread_create(&chunks[i].thread, NULL, rewrap_chunk_thread, chunks + i) == 0;
+        }
+        rewrap_chunk(chunks);
+        for (unsigned i = 1; i < num_chunks; i++) {
+            if (chunks[i].thread_started) pthread_join(chunks[i].thread, NULL);
+            else rewrap_chunk(chunks + i);
+            chunks[i].thread_started = false;
+        }
+        for (unsigned i = 0; i < num_chunks && ok; i++) {
+            if (!(ok = chunks[i].ok)) break;
+            const DestLines *d = &chunks[i].lines;
+            for (index_type y = 0; y < d->count; y++, num_lines++) {
+                l.cpu_cells = d->cpu_cells + (size_t)y * dest_xnum; l.gpu_cells = d->gpu_cells + (size_t)y * dest_xnum;
+                l.attrs = d->line_attrs[y];
+                historybuf_add_line(r->dest.hb, &l, r->as_ansi_buf);
+            }
+            start = chunks[i].end;
+        }
+    }
+    if (start) { r->src.y = start; r->dest.y = num_lines - 1; }
+    for (unsigned i = 0; i < num_threads; i++) {
+        RewrapChunk *c = chunks + i;
+        historybuf_reader_free(&c->reader);
+        free(c->lines.cpu_cells); free(c->lines.gpu_cells); free(c->lines.line_attrs);
+        Py_CLEAR(c->r.sb);
+    }
+}
+// }}}
+
+// Deferred rewrap {{{
+// Rewrapping a large scrollback takes a while, so when the screen is resized
+// only the newest lines of the history are rewrapped immediately. The older
+// lines, up to a hard line break, stay in the old history buffer and are
+// rewrapped a batch at a time from the main loop, or all at once when the
+// full history is actually needed, and then put before the lines already in
+// the new history buffer. Until then the history simply appears to be
+// shorter. Line numbers in the history count from the newest line, so they
+// are not changed by this.
+
+#define DEFER_REWRAP_MIN_LINES 8192u
+#define DEFER_REWRAP_IMMEDIATE_LINES 1024u
+#define DEFER_REWRAP_BATCH_LINES 256u
+
+struct PendingRewrap {
+    // src.hb is the old history buffer and src.hb_count the number of its
+    // lines still to be rewrapped, dest.hb gets the rewrapped lines. The
+    // linebufs are only used for the number of columns.
+    Rewrap r;
+    HistoryBufReader reader;
+    TrackCursor no_cursors[1];
+    // for the lines that no longer fit once rewrapped, see historybuf_add_older_lines()
+    ANSIBuf as_ansi_buf;
+};
+
+void
+free_pending_rewrap(PendingRewrap *p) {
+    if (!p) return;
+    historybuf_reader_free(&p->reader);
+    free(p->as_ansi_buf.buf);
+    Py_CLEAR(p->r.src.hb); Py_CLEAR(p->r.src.lb);
+    Py_CLEAR(p->r.dest.hb); Py_CLEAR(p->r.dest.lb);
+    Py_CLEAR(p->r.sb);
+    free(p);
+}
+
+static PendingRewrap*
+alloc_pending_rewrap(HistoryBuf *src, LineBuf *src_lb, index_type num_lines, index_type columns, HYPERLINK_POOL_HANDLE hyperlink_pool) {
+    PendingRewrap *p = calloc(1, sizeof(PendingRewrap));
+    if (!p) return NULL;
+    p->as_ansi_buf.hyperlink_pool = hyperlink_pool;
+    Rewrap *r = &p->r;
+    TextCache *tc = src_lb->text_cache;
+    r->src.hb = src; Py_INCREF(src);
+    r->src.lb = src_lb; Py_INCREF(src_lb);
+    r->src.hb_count = num_lines;
+    p->no_cursors[0].is_sentinel = true; r->cursors = p->no_cursors;
+    // read through a reader so that the old history buffer is never modified
+    r->src_reader = &p->reader;
+    if (
+        !historybuf_reader_init(&p->reader, src) || !(r->dest.hb = historybuf_alloc_for_rewrap(columns, src)) ||
+        !(r->dest.lb = alloc_linebuf(1, columns, tc)) || !(r->sb = alloc_linebuf(SCALE_BITS << 1, columns, tc))
+    ) { free_pending_rewrap(p); return NULL; }
+    setup_line(tc, src_lb->xnum, &r->src.line);
+    setup_line(tc, columns, &r->dest.line);
+    setup_line(tc, src_lb->xnum, &r->src.scratch_line);
+    setup_line(tc, columns, &r->dest.scratch_line);
+    return p;
+}
+
+static bool
+is_safe_split(HistoryBuf *hb, index_type y) {
+    // whether the history can be rewrapped separately before and after line y (counting from the oldest line)
+    Line l;
+    historybuf_init_line(hb, hb->count - y, &l);
+    if (l.cpu_cells[hb->xnum - 1].next_char_was_wrapped) return false;
+    historybuf_init_line(hb, hb->count - y - 1, &l);
+    for (index_type x = 0; x < hb->xnum; x++) if (l.cpu_cells[x].is_multicell && l.cpu_cells[x].y) return false;
+    return true;
+}
+
+static void
+defer_rewrap_of_old_history(Rewrap *r) {
+    if (!r->dest.hb || r->src.hb->pending_rewrap || r->src.hb_count < DEFER_REWRAP_MIN_LINES) return;
+    index_type y = r->src.hb_count - DEFER_REWRAP_IMMEDIATE_LINES;
+    while (y && !is_safe_split(r->src.hb, y)) y--;
+    if (!y) return;
+    LineBuf *src_lb = alloc_linebuf(1, src_xnum, r->src.lb->text_cache);
+    if (src_lb) {
+        r->pending = alloc_pending_rewrap(r->src.hb, src_lb, y, dest_xnum, r->as_ansi_buf ? r->as_ansi_buf->hyperlink_pool : NULL);
+        Py_DECREF(src_lb);
+    }
+    // rewrap everything now instead
+    if (!r->pending) { PyErr_Clear(); return; }
+    r->src.y = y;
+    // so that the first line added to dest.hb is line zero
+    r->dest.y = -1;
+}
+
+static PendingRewrap*
+pending_rewrap_for_columns(PendingRewrap *p, index_type columns) {
+    // Rewrapping is started afresh when the number of columns changes again
+    if (p->r.dest.lb->xnum == columns) return p;
+    return alloc_pending_rewrap(p->r.src.hb, p->r.src.lb, p->r.src.hb_count, columns, p->as_ansi_buf.hyperlink_pool);
+}
+
+bool
+historybuf_continue_pending_rewrap(HistoryBuf *hb, monotonic_t deadline) {
+    PendingRewrap *p = hb->pending_rewrap;
+    if (!p) return false;
+    Rewrap *r = &p->r;
+    do {
+        rewrap_lines(r, MIN(r->src.hb_count, r->src.y + DEFER_REWRAP_BATCH_LINES));
+    } while (r->src.y < r->src.hb_count && monotonic() < deadline);
+    historybuf_spill_to_disk(r->dest.hb);
+    if (r->src.y < r->src.hb_count) return true;
+    historybuf_finish_rewrap(r->dest.hb, r->src.hb);
+    // clear pending_rewrap first, so that adding lines does not try to finish it again
+    hb->pending_rewrap = NULL;
+    const index_type num_rewrapped = r->dest.hb->count;
+    if (historybuf_add_older_lines(hb, r->dest.hb, &p->as_ansi_buf) < num_rewrapped) {
+        // The rewrapped lines and the lines added since the resize do not all
+        // fit, the oldest rewrapped lines are now in the pager history and
+        // have to be rewrapped again when it is read
+        if (hb->pagerhist) hb->pagerhist->rewrap_needed = hb->pagerhist->wrapped_at != hb->xnum;
+    }
+    free_pending_rewrap(p);
+    return false;
+}
+
+void
+historybuf_finish_pending_rewrap(HistoryBuf *hb) {
+    if (hb) while (historybuf_continue_pending_rewrap(hb, 0));
+}
+// }}}
+
 static void
 rewrap(Rewrap *r) {
     r->src.hb_count = r->src.hb ? r->src.hb->count : 0;
@@ -271,20 +572,15 @@ rewrap(Rewrap *r) {
     setup_line(r->src.lb->text_cache, dest_xnum, &r->dest.scratch_line);
 
     exclude_empty_lines_at_bottom(r);
-
-    for (; r->src.y < r->num_content_lines_before + r->src.hb_count; r->src.y++) {
-        if (init_src_line(r)) {
-            if (r->src.y) next_dest_line(r, false);
-            else first_dest_line(r);
-        }
-        if (r->current_src_line_has_multline_cells || r->current_dest_line_has_multiline_cells) multiline_copy_src_to_dest(r);
-        else fast_copy_src_to_dest(r);
-    }
+    if (r->defer_history) defer_rewrap_of_old_history(r);
+    if (!r->pending) rewrap_history_in_parallel(r);
+    rewrap_lines(r, r->num_content_lines_before + r->src.hb_count);
 }
 
 ResizeResult
-resize_screen_buffers(LineBuf *lb, HistoryBuf *hb, index_type lines, index_type columns, ANSIBuf *as_ansi_buf, TrackCursor *cursors) {
+resize_screen_buffers(LineBuf *lb, HistoryBuf *hb, index_type lines, index_type columns, ANSIBuf *as_ansi_buf, TrackCursor *cursors, bool defer_history, bool serial) {
     ResizeResult ans = {0};
+    if (!defer_history) historybuf_finish_pending_rewrap(hb);
     ans.lb = alloc_linebuf(lines, columns, lb->text_cache);
     if (!ans.lb) return ans;
     RAII_PyObject(raii_nlb, (PyObject*)ans.lb); (void) raii_nlb;
@@ -295,16 +591,24 @@ resize_screen_buffers(LineBuf *lb, HistoryBuf *hb, index_type lines, index_type
     RAII_PyObject(raii_nhb, (PyObject*)ans.hb); (void) raii_nhb;
     Rewrap r = {
         .src = {.lb=lb, .hb=hb}, .dest = {.lb=ans.lb, .hb=ans.hb},
-        .as_ansi_buf = as_ansi_buf, .cursors = cursors,
+        .as_ansi_buf = as_ansi_buf, .cursors = cursors, .defer_history = defer_history,
+        .serial = serial,
     };
     r.sb = alloc_linebuf(SCALE_BITS << 1, columns, lb->text_cache);
     if (!r.sb) return ans;
     RAII_PyObject(scratch, (PyObject*)r.sb); (void)scratch;
+    PendingRewrap *pending = NULL;
+    if (hb && hb->pending_rewrap && !(pending = pending_rewrap_for_columns(hb->pending_rewrap, columns))) return ans;
     for (TrackCursor *t = cursors; !t->is_sentinel; t++) { t->dest_x = t->x; t->dest_y = t->y; }
     rewrap(&r);
     ans.num_content_lines_before = r.num_content_lines_before;
     ans.num_content_lines_after = MIN(r.dest.y + 1, ans.lb->ynum);
-    if (hb) historybuf_finish_rewrap(ans.hb, hb);
+    if (hb) {
+        historybuf_finish_rewrap(ans.hb, hb);
+        if (pending != hb->pending_rewrap) free_pending_rewrap(hb->pending_rewrap);
+        hb->pending_rewrap = NULL;
+        ans.hb->pending_rewrap = pending ? pending : r.pending;
+    }
     for (unsigned i = 0; i < ans.num_content_lines_after; i++) linebuf_mark_line_dirty(ans.lb, i);
     for (TrackCursor *t = cursors; !t->is_sentinel; t++) { t->dest_x = MIN(t->dest_x, columns); t->dest_y = MIN(t->dest_y, lines); }
     Py_INCREF(raii_nlb); Py_XINCREF(raii_nhb);
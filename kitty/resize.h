@@ -21,5 +21,13 @@ typedef struct ResizeResult {
     index_type num_content_lines_before, num_content_lines_after;
 } ResizeResult;
 
+// When defer_history is true, rewrapping of the older lines in hb can be left
+// for later, until then they are absent from the returned history buffer.
+// When serial is true, the history is rewrapped on the calling thread only.
 ResizeResult
-resize_screen_buffers(LineBuf *lb, HistoryBuf *hb, index_type lines, index_type columns, ANSIBuf *as_ansi_buf, TrackCursor *cursors);
+resize_screen_buffers(LineBuf *lb, HistoryBuf *hb, index_type lines, index_type columns, ANSIBuf *as_ansi_buf, TrackCursor *cursors, bool defer_history, bool serial);
+void free_pending_rewrap(PendingRewrap *p);
+// Rewrap deferred lines until deadline, returns true if there are still some left
+bool historybuf_continue_pending_rewrap(HistoryBuf *hb, monotonic_t deadline);
+// Rewrap all deferred lines, must be called before using the full history
+void historybuf_finish_pending_rewrap(HistoryBuf *hb);
@@ -1,14 +1,12 @@
 #pragma kitty_include_shader <alpha_blend.glsl>
 #pragma kitty_include_shader <utils.glsl>
 
-in vec2 dimensions;
+flat in vec4 rect;
+flat in vec2 params;
+flat in vec4 color;
+flat in vec4 background_color;
 out vec4 output_color;
 
-uniform vec4 rect;
-uniform vec2 params;
-uniform vec4 color;
-uniform vec4 background_color;
-
 // Signed distance function for a rounded rectangle
 float rounded_rectangle_sdf(vec2 p, vec2 b, float r) {
     // signed distance field
@@ -20,6 +18,11 @@ float rounded_rectangle_sdf(vec2 p, vec2 b, float r) {
 void main() {
     vec2 size = rect.ba, origin = rect.xy;
     float thickness = params[0], corner_radius = params[1];
+    // A negative thickness is used for filled rects with sharp edges
+    if (thickness < 0.0) {
+        output_color = alpha_blend(color, background_color);
+        return;
+    }
     // Position must be relative to the center of the rectangle of (size) located at (origin)
     vec2 position = gl_FragCoord.xy - size / 2.0 - origin;
     // Calculate distance to rounded rectangle
@@ -9,9 +9,22 @@ const ivec2 vertex_pos_map[4] = ivec2[4](
     ivec2(left, bottom),
     ivec2(left, top)
 );
-const vec4 dest_rect = vec4(-1, 1, 1, -1);
+
+// All the rects of a frame are drawn with instanced draw calls, the size of
+// the arrays is MAX_UI_RECT_BATCH in shaders.c. Rects are in pixels with the
+// origin at the bottom left of the framebuffer.
+uniform vec2 viewport_size;
+uniform vec4 rects[32], rect_params[32], colors[32], background_colors[32];
+
+flat out vec4 rect;
+flat out vec2 params;
+flat out vec4 color;
+flat out vec4 background_color;
 
 void main() {
+    rect = rects[gl_InstanceID]; params = rect_params[gl_InstanceID].xy;
+    color = colors[gl_InstanceID]; background_color = background_colors[gl_InstanceID];
+    vec4 edges = vec4(rect.x, rect.y + rect.w, rect.x + rect.z, rect.y) / viewport_size.xyxy * 2.0 - 1.0;
     ivec2 pos = vertex_pos_map[gl_VertexID];
-    gl_Position = vec4(dest_rect[pos.x], dest_rect[pos.y], 0, 1);
+    gl_Position = vec4(edges[pos.x], edges[pos.y], 0, 1);
 }
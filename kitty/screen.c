@@ -35,6 +35,7 @@
 #include "keys.h"
 #include "vt-parser.h"
 #include "resize.h"
+#include "simd-string.h"
 
 static const ScreenModes empty_modes = {0, .mDECAWM=true, .mDECTCEM=true, .mDECARM=true};
 
@@ -92,7 +93,7 @@ init_overlay_line(Screen *self, index_type columns, bool keep_active) {
 static void deactivate_overlay_line(Screen *self);
 static void update_overlay_position(Screen *self);
 static void render_overlay_line(Screen *self, Line *line, FONTS_DATA_HANDLE fonts_data);
-static void update_overlay_line_data(Screen *self, uint8_t *data);
+static void update_overlay_line_data(Screen *self);
 
 #define CALLBACK(...) \
     if (self->callbacks != Py_None) { \
@@ -139,6 +140,7 @@ new_screen_object(PyTypeObject *type, PyObject *args, PyObject UNUSED *kwds) {
         self->main_linebuf = alloc_linebuf(lines, columns, self->text_cache); self->alt_linebuf = alloc_linebuf(lines, columns, self->text_cache);
         self->linebuf = self->main_linebuf;
         self->historybuf = alloc_historybuf(MAX(scrollback, lines), columns, OPT(scrollback_pager_history_size), self->text_cache);
+        if (self->historybuf) historybuf_set_spill_limit(self->historybuf, OPT(scrollback_disk_cache_size) * 1024ull * 1024ull, OPT(scrollback_disk_cache_policy));
         self->main_grman = grman_alloc(false);
         self->alt_grman = grman_alloc(false);
         self->active_hyperlink_id = 0;
@@ -240,7 +242,9 @@ rewrap(Screen *screen, unsigned int lines, unsigned int columns, index_type *ncl
     cursors[0] = (TrackCursor){.x=main_saved_cursor->before.x, .y=main_saved_cursor->before.y};
     if (main_is_active) cursors[1] = (TrackCursor){.x=cursor->before.x, .y=cursor->before.y};
     else cursors[1].is_sentinel = true;
-    ResizeResult mr = resize_screen_buffers(screen->main_linebuf, screen->historybuf, lines, columns, &screen->as_ansi_buf, cursors);
+    // the older history is rewrapped later unless it is being viewed
+    const bool defer_history = screen->scrolled_by == 0;
+    ResizeResult mr = resize_screen_buffers(screen->main_linebuf, screen->historybuf, lines, columns, &screen->as_ansi_buf, cursors, defer_history, false);
     if (!mr.ok) { PyErr_NoMemory(); return false; }
     main_saved_cursor->temp.x = cursors[0].dest_x; main_saved_cursor->temp.y = cursors[0].dest_y;
     if (main_is_active) { cursor->temp.x = cursors[1].dest_x; cursor->temp.y = cursors[1].dest_y; }
@@ -248,7 +252,7 @@ rewrap(Screen *screen, unsigned int lines, unsigned int columns, index_type *ncl
     cursors[0] = (TrackCursor){.x=alt_saved_cursor->before.x, .y=alt_saved_cursor->before.y};
     if (!main_is_active) cursors[1] = (TrackCursor){.x=cursor->before.x, .y=cursor->before.y};
     else cursors[1].is_sentinel = true;
-    ResizeResult ar = resize_screen_buffers(screen->alt_linebuf, NULL, lines, columns, &screen->as_ansi_buf, cursors);
+    ResizeResult ar = resize_screen_buffers(screen->alt_linebuf, NULL, lines, columns, &screen->as_ansi_buf, cursors, false, false);
     if (!ar.ok) {
         Py_DecRef((PyObject*)mr.lb); Py_DecRef((PyObject*)mr.hb);
         PyErr_NoMemory(); return false;
@@ -335,7 +339,7 @@ index_selection(const Screen *self, Selections *selections, bool up, index_type
 
 #define INDEX_GRAPHICS(amtv) { \
     bool is_main = self->linebuf == self->main_linebuf; \
-    static ScrollData s; \
+    ScrollData s = {0}; \
     s.amt = amtv; s.limit = is_main ? -self->historybuf->ynum : 0; \
     s.has_margins = self->margin_top != 0 || self->margin_bottom != self->lines - 1; \
     s.margin_top = top; s.margin_bottom = bottom; \
@@ -405,6 +409,8 @@ nuke_multicell_char_intersecting_with(Screen *self, index_type x_start, index_ty
     for (index_type y = y_start; y < y_limit; y++) {
         CPUCell *cp; GPUCell *gp;
         linebuf_init_cells(self->linebuf, y, &cp, &gp);
+        // multicell chars are rare, so first check for them in bulk
+        if (x_limit <= x_start || !cells_have_multicell(cp + x_start, x_limit - x_start)) continue;
         for (index_type x = x_start; x < x_limit; x++) {
             if (cp[x].is_multicell) nuke_multicell_char_at(self, x, y, replace_with_spaces);
         }
@@ -528,6 +534,8 @@ remove_blank_output_line_reservation_marker(Cursor *cursor, LineBuf *linebuf) {
 static bool
 screen_resize(Screen *self, unsigned int lines, unsigned int columns) {
     screen_pause_rendering(self, false, 0);
+    screen_clear_predicted_echo(self);
+    screen_abort_text_cache_compaction(self, monotonic());
     lines = MAX(1u, lines); columns = MAX(1u, columns);
 
     bool is_main = self->linebuf == self->main_linebuf;
@@ -650,7 +658,13 @@ dealloc(Screen* self) {
     self->text_cache = tc_decref(self->text_cache);
     Py_CLEAR(self->main_grman);
     Py_CLEAR(self->alt_grman);
+    for (size_t i = 0; i < self->queued_graphics_responses.count; i++) free(self->queued_graphics_responses.items[i].response);
+    free(self->queued_graphics_responses.items);
     Py_CLEAR(self->last_reported_cwd);
+    free_command_capture(self->cmd_capture); self->cmd_capture = NULL;
+    Py_CLEAR(self->captured_cmd_output);
+    Py_CLEAR(self->coalesced_title.pending); Py_CLEAR(self->coalesced_progress.pending);
+    Py_CLEAR(self->queued_notifications.queue);
     PyMem_RawFree(self->write_buf);
     Py_CLEAR(self->callbacks);
     Py_CLEAR(self->test_child);
@@ -669,12 +683,13 @@ dealloc(Screen* self) {
     Py_CLEAR(self->paused_rendering.linebuf);
     Py_CLEAR(self->paused_rendering.grman);
     free(self->selections.items);
-    free(self->url_ranges.items);
+    free(self->url_ranges.items); free(self->url_detection.index.lines);
     free(self->paused_rendering.url_ranges.items);
     free(self->paused_rendering.selections.items);
     free_hyperlink_pool(self->hyperlink_pool);
     free(self->as_ansi_buf.buf);
     free(self->last_rendered_window_char.canvas);
+    free(self->gpu_cell_data.cells); free(self->gpu_cell_data.row_generations); free(self->gpu_selection_data.data);
     free(self->extra_cursors.locations); free(self->paused_rendering.extra_cursors.locations);
     if (self->lc) { cleanup_list_of_chars(self->lc); free(self->lc); self->lc = NULL; }
     Py_TYPE(self)->tp_free((PyObject*)self);
@@ -827,6 +842,16 @@ checked_range_line(Screen *self, int y) {
     return NULL;
 }
 
+// The prompt kind of the line at y, without initializing its cells, which for
+// history lines can mean decompressing its segment. Lines that are out of range
+// have UNKNOWN_PROMPT_KIND.
+static PromptKind
+range_line_prompt_kind(Screen *self, int y) {
+    if (!(-(int)self->historybuf->count <= y && y < (int)self->lines)) return UNKNOWN_PROMPT_KIND;
+    if (y < 0) return historybuf_line_attrs(self->historybuf, -(y + 1)).prompt_kind;
+    return self->linebuf->line_attrs[y].prompt_kind;
+}
+
 static bool
 range_line_is_continued(Screen *self, int y) {
     if (!(-(int)self->historybuf->count <= y && y < (int)self->lines)) return false;
@@ -1014,9 +1039,12 @@ draw_combining_char(Screen *self, text_loop_state *s, char_type ch) {
     }
 }
 
+static void show_predicted_echo(Screen *self);
+
 static void
 screen_on_input(Screen *self) {
     if (!self->has_activity_since_last_focus && !self->has_focus && self->callbacks != Py_None) {
+        if (self->parsing_off_main_thread) { self->deferred_to_main_thread.activity = true; return; }
         PyObject *ret = PyObject_CallMethod(self->callbacks, "on_activity_since_last_focus", NULL);
         if (ret == NULL) PyErr_Print();
         else {
@@ -1026,6 +1054,20 @@ screen_on_input(Screen *self) {
     }
 }
 
+void
+screen_finish_off_main_thread_parse(Screen *self) {
+    // Called on the main thread after input was parsed on another thread
+    self->parsing_off_main_thread = false;
+    if (self->deferred_to_main_thread.activity) {
+        self->deferred_to_main_thread.activity = false;
+        screen_on_input(self);
+    }
+    if (self->deferred_to_main_thread.predicted_echo) {
+        self->deferred_to_main_thread.predicted_echo = false;
+        show_predicted_echo(self);
+    }
+}
+
 static void
 replace_multicell_char_under_cursor_with_spaces(Screen *self) {
     nuke_multicell_char_at(self, self->cursor->x, self->cursor->y, true);
@@ -1108,11 +1150,44 @@ draw_control_char(Screen *self, text_loop_state *s, uint32_t ch) {
     }
 }
 
+static size_t
+draw_ascii_run(Screen *self, const uint32_t *chars, size_t num_chars, text_loop_state *s) {
+    // Draw a run of printable ASCII characters that fits on the current line
+    // with no multicell characters in the way, in bulk. Returns the number of
+    // characters drawn, zero means the run must go through the general path.
+    const index_type x = self->cursor->x;
+    if (x >= self->columns) return 0;
+    const size_t limit = MIN(num_chars, (size_t)(self->columns - x));
+    size_t n = 0;
+    while (n < limit && ' ' <= chars[n] && chars[n] < DEL && !s->cp[x + n].is_multicell) n++;
+    if (n < 2) return 0;
+    if (self->modes.mIRM) {
+        // a single insert is equivalent to one per character only when there
+        // are no multicell characters to be split or pushed off the line
+        for (index_type i = x + n; i < self->columns; i++) if (s->cp[i].is_multicell) return 0;
+        insert_characters(self, x, n, self->cursor->y, true);
+    }
+    CPUCell *cp = s->cp + x; GPUCell *gp = s->gp + x;
+    for (size_t i = 0; i < n; i++) {
+        cp[i] = s->cc; cell_set_char(cp + i, chars[i]);
+        gp[i] = s->g;
+    }
+    self->last_graphic_char = chars[n - 1];
+    s->seg = (GraphemeSegmentationResult){.grapheme_break=GBP_None};
+    s->prev.y = self->cursor->y; s->prev.x = x + n - 1; s->prev.cc = cp + n - 1;
+    self->cursor->x += n;
+    return n;
+}
+
 static void
 draw_text_loop(Screen *self, const uint32_t *chars, size_t num_chars, text_loop_state *s) {
     init_text_loop_line(self, s);
     int char_width;
     for (size_t i = 0; i < num_chars; i++) {
+        if (' ' <= chars[i] && chars[i] < DEL && s->seg.grapheme_break <= GBP_None && !self->charset.current) {
+            const size_t n = draw_ascii_run(self, chars + i, num_chars - i, s);
+            if (n) { i += n - 1; continue; }
+        }
         uint32_t ch = map_char(self, chars[i]);
         if (ch < DEL && s->seg.grapheme_break <= GBP_None) {  // fast path for printable ASCII
             if (ch < ' ') {
@@ -1216,9 +1291,17 @@ draw_text(Screen *self, const uint32_t *chars, size_t num_chars) {
     draw_text_loop(self, chars, num_chars, &s);
 }
 
+// Output is only captured on the main screen as full screen programs are
+// not meaningful as text
+#define capturing_cmd_output(self) ((self)->cmd_capture && (self)->linebuf == (self)->main_linebuf)
+
+static void confirm_predicted_echo(Screen *self, const uint32_t *chars, size_t num_chars);
+
 void
 screen_draw_text(Screen *self, const uint32_t *chars, size_t num_chars) {
     screen_on_input(self);
+    if (self->predicted_echo.count) confirm_predicted_echo(self, chars, num_chars);
+    if (capturing_cmd_output(self)) command_capture_text(self->cmd_capture, chars, num_chars);
     draw_text(self, chars, num_chars);
 }
 
@@ -1504,11 +1587,76 @@ screen_dirty_line_graphics(Screen *self, const unsigned int top, const unsigned
         grman_remove_cell_images(main_buf ? self->main_grman : self->alt_grman, top, bottom);
 }
 
+static uint64_t
+pending_background_decodes(Screen *self, uint64_t *oldest) {
+    // The main and alternate screens share the child, so their decodes are considered together
+    uint64_t main_oldest, alt_oldest;
+    const uint64_t main_newest = grman_background_decodes(self->main_grman, &main_oldest);
+    const uint64_t alt_newest = grman_background_decodes(self->alt_grman, &alt_oldest);
+    *oldest = main_oldest && alt_oldest ? MIN(main_oldest, alt_oldest) : MAX(main_oldest, alt_oldest);
+    return MAX(main_newest, alt_newest);
+}
+
+static void
+write_queued_graphics_responses(Screen *self, uint64_t before_decode) {
+    // Write the queued responses that were waiting only for decodes started
+    // before before_decode, all of them if it is zero
+    size_t i = 0;
+    for (; i < self->queued_graphics_responses.count; i++) {
+        if (before_decode && self->queued_graphics_responses.items[i].after_decode >= before_decode) break;
+        write_escape_code_to_child(self, ESC_APC, self->queued_graphics_responses.items[i].response);
+        free(self->queued_graphics_responses.items[i].response);
+    }
+    if (!i) return;
+    self->queued_graphics_responses.count -= i;
+    memmove(self->queued_graphics_responses.items, self->queued_graphics_responses.items + i, self->queued_graphics_responses.count * sizeof(self->queued_graphics_responses.items[0]));
+}
+
+static void
+write_ready_graphics_responses(Screen *self) {
+    if (!self->queued_graphics_responses.count) return;
+    uint64_t oldest;
+    pending_background_decodes(self, &oldest);
+    write_queued_graphics_responses(self, oldest);
+}
+
+static void
+write_graphics_response(void *data, const char *response, uint64_t decode_id) {
+    Screen *self = data;
+    write_queued_graphics_responses(self, decode_id);
+    write_escape_code_to_child(self, ESC_APC, response);
+}
+
+static void
+queue_graphics_response(Screen *self, const char *response, uint64_t after_decode) {
+    char *copy = strdup(response);
+    if (!copy) fatal("Out of memory");
+    ensure_space_for(&self->queued_graphics_responses, items, struct QueuedGraphicsResponse, self->queued_graphics_responses.count + 1, capacity, 8, false);
+    self->queued_graphics_responses.items[self->queued_graphics_responses.count].after_decode = after_decode;
+    self->queued_graphics_responses.items[self->queued_graphics_responses.count++].response = copy;
+}
+
+bool
+screen_finish_background_image_decodes(Screen *self, bool wait) {
+    bool finished = false;
+    if (grman_has_background_decodes(self->main_grman)) finished |= grman_finish_background_decodes(self->main_grman, wait, &self->is_dirty, write_graphics_response, self);
+    if (grman_has_background_decodes(self->alt_grman)) finished |= grman_finish_background_decodes(self->alt_grman, wait, &self->is_dirty, write_graphics_response, self);
+    write_ready_graphics_responses(self);
+    return finished;
+}
+
 void
 screen_handle_graphics_command(Screen *self, const GraphicsCommand *cmd, const uint8_t *payload) {
     unsigned int x = self->cursor->x, y = self->cursor->y;
+    if (grman_command_needs_image_data(cmd) && grman_has_background_decodes(self->grman)) grman_finish_background_decodes(self->grman, true, &self->is_dirty, write_graphics_response, self);
+    write_ready_graphics_responses(self);
+    uint64_t oldest;
+    const uint64_t after_decode = pending_background_decodes(self, &oldest);
     const char *response = grman_handle_command(self->grman, cmd, payload, self->cursor, &self->is_dirty, self->cell_size);
-    if (response != NULL) write_escape_code_to_child(self, ESC_APC, response);
+    if (response != NULL) {
+        if (after_decode) queue_graphics_response(self, response, after_decode);
+        else write_escape_code_to_child(self, ESC_APC, response);
+    }
     if (x != self->cursor->x || y != self->cursor->y) {
         bool in_margins = cursor_within_margins(self);
         if (self->cursor->x >= self->columns) { self->cursor->x = 0; self->cursor->y++; }
@@ -1908,6 +2056,7 @@ screen_backspace(Screen *self) {
 void
 screen_tab(Screen *self) {
     // Move to the next tab space, or the end of the screen if there aren't anymore left.
+    if (capturing_cmd_output(self)) command_capture_bytes(self->cmd_capture, "\t", 1);
     unsigned int found = 0;
     for (unsigned int i = self->cursor->x + 1; i < self->columns; i++) {
         if (self->tabstops[i]) { found = i; break; }
@@ -2078,14 +2227,56 @@ screen_index_without_adding_to_history(Screen *self) {
 }
 
 
+static void
+scroll_region_up(Screen *self, index_type count, index_type top, index_type bottom, bool add_to_history) {
+    // Same as count INDEX_UPs, but the line map is rotated and the images are
+    // scrolled only once, so the cost does not depend on the height of the
+    // region. count must be at most the height of the region.
+    if (add_to_history) {
+        for (index_type y = top; y < top + count; y++) {
+            linebuf_init_line(self->linebuf, y);
+            historybuf_add_line(self->historybuf, self->linebuf->line, &self->as_ansi_buf);
+        }
+        self->history_line_added_count += count;
+        if (self->last_visited_prompt.is_set) {
+            self->last_visited_prompt.scrolled_by += count;
+            if (self->last_visited_prompt.scrolled_by > self->historybuf->count) self->last_visited_prompt.is_set = false;
+        }
+    }
+    linebuf_delete_lines(self->linebuf, count, top, bottom);
+    INDEX_GRAPHICS(-(int)count)
+    self->is_dirty = true;
+    for (index_type i = 0; i < count; i++) index_selection(self, &self->selections, true, top, bottom);
+    clear_selection(&self->url_ranges);
+}
+
+static void
+scroll_region_down(Screen *self, index_type count, index_type top, index_type bottom) {
+    // Same as count INDEX_DOWNs, count must be at most the height of the region
+    linebuf_insert_lines(self->linebuf, count, top, bottom);
+    if (self->linebuf == self->main_linebuf && self->last_visited_prompt.is_set) {
+        for (index_type i = 0; i < count && self->last_visited_prompt.is_set; i++) {
+            if (self->last_visited_prompt.scrolled_by > 0) self->last_visited_prompt.scrolled_by--;
+            else if(self->last_visited_prompt.y < self->lines - 1) self->last_visited_prompt.y++;
+            else self->last_visited_prompt.is_set = false;
+        }
+    }
+    INDEX_GRAPHICS((int)count)
+    self->is_dirty = true;
+    for (index_type i = 0; i < count; i++) index_selection(self, &self->selections, false, top, bottom);
+    clear_selection(&self->url_ranges);
+}
+
 void
 screen_scroll(Screen *self, unsigned int count) {
     // Scroll the screen up by count lines, not moving the cursor
     unsigned int top = self->margin_top, bottom = self->margin_bottom;
     const bool add_to_history = self->linebuf == self->main_linebuf && self->margin_top == 0;
+    const index_type height = bottom - top + 1;
     while (count > 0) {
-        count--;
-        INDEX_UP(add_to_history);
+        const index_type n = MIN(count, height);
+        scroll_region_up(self, n, top, bottom, add_to_history);
+        count -= n;
     }
 }
 
@@ -2106,7 +2297,16 @@ _reverse_scroll(Screen *self, unsigned int count, bool fill_from_scrollback) {
     if (fill_from_scrollback) {
         unsigned limit = MAX(self->lines, self->historybuf->count);
         count = MIN(limit, count);
-    } else count = MIN(self->lines, count);
+    } else {
+        count = MIN(self->lines, count);
+        const index_type height = bottom - top + 1;
+        while (count > 0) {
+            const index_type n = MIN(count, height);
+            scroll_region_down(self, n, top, bottom);
+            count -= n;
+        }
+        return;
+    }
     while (count-- > 0) {
         bool copied = false;
         if (fill_from_scrollback) copied = historybuf_pop_line(self->historybuf, self->alt_linebuf->line);
@@ -2133,6 +2333,7 @@ screen_carriage_return(Screen *self) {
 
 void
 screen_linefeed(Screen *self) {
+    if (capturing_cmd_output(self)) command_capture_bytes(self->cmd_capture, "\n", 1);
     bool in_margins = cursor_within_margins(self);
     screen_index(self);
     if (self->modes.mLNM) screen_carriage_return(self);
@@ -2670,6 +2871,12 @@ screen_invert_colors(Screen *self) {
     return self->paused_rendering.expires_at ? self->paused_rendering.inverted : (self->modes.mDECSCNM ? true : false);
 }
 
+static void
+deliver_bell(Screen *self) {
+    request_window_attention(self->window_id, OPT(enable_audio_bell));
+    CALLBACK("on_bell", NULL);
+}
+
 void
 screen_bell(Screen *self) {
     if (self->ignore_bells.start) {
@@ -2680,9 +2887,12 @@ screen_bell(Screen *self) {
         }
         self->ignore_bells.start = 0;
     }
-    request_window_attention(self->window_id, OPT(enable_audio_bell));
-    if (OPT(visual_bell_duration) > 0.0f) self->start_visual_bell_at = monotonic();
-    CALLBACK("on_bell", NULL);
+    const monotonic_t now = monotonic();
+    if (OPT(visual_bell_duration) > 0.0f) self->start_visual_bell_at = now;
+    if (!self->coalesced_bell.pending && now - self->coalesced_bell.delivered_at >= OPT(repaint_delay)) {
+        self->coalesced_bell.delivered_at = now;
+        deliver_bell(self);
+    } else self->coalesced_bell.pending = true;
 }
 
 void
@@ -2736,6 +2946,8 @@ screen_report_size(Screen *self, unsigned int which) {
 
 void
 screen_manipulate_title_stack(Screen *self, unsigned int op, unsigned int which) {
+    // the stack must see the current title
+    screen_deliver_coalesced_notifications(self, monotonic(), true);
     CALLBACK("manipulate_title_stack", "OOO",
         op == 23 ? Py_True : Py_False,
         which == 0 || which == 2 ? Py_True : Py_False,
@@ -2998,15 +3210,103 @@ screen_multi_cursor(Screen *self, int queried_shape, int *params, unsigned num_p
     }
 }
 
+// Title, progress, bell and notification updates {{{
+#define deliver_coalesced_title(data) CALLBACK("title_changed", "O", data)
+#define deliver_coalesced_progress(data) CALLBACK("desktop_notify", "IO", 9u, data)
+
+// data is a memoryview into the parser buffer so it has to be copied if the
+// notification is deferred
+#define coalesce(which, data) { \
+    const monotonic_t now = monotonic(); \
+    if (!self->which.pending && now - self->which.delivered_at >= OPT(repaint_delay)) { \
+        self->which.delivered_at = now; deliver_##which(data); \
+    } else { \
+        PyObject *copy = PyBytes_FromObject(data); \
+        if (copy) { Py_XSETREF(self->which.pending, copy); } else PyErr_Print(); \
+    } \
+}
+
 void
 set_title(Screen *self, PyObject *title) {
-    CALLBACK("title_changed", "O", title);
+    coalesce(coalesced_title, title);
+}
+
+static bool
+is_progress_report(PyObject *data) {
+    // OSC 9;4 is the ConEmu progress report, see Window.desktop_notify()
+    if (!PyMemoryView_Check(data)) return false;
+    const Py_buffer *b = PyMemoryView_GET_BUFFER(data);
+    return b->len > 1 && ((const char*)b->buf)[0] == '4' && ((const char*)b->buf)[1] == ';';
+}
+
+#define MAX_QUEUED_NOTIFICATIONS 64
+
+static void
+queue_notification(Screen *self, unsigned int osc_code, PyObject *data) {
+    const monotonic_t now = monotonic();
+    PyObject *q = self->queued_notifications.queue;
+    if ((!q || !PyList_GET_SIZE(q)) && now - self->queued_notifications.delivered_at >= OPT(repaint_delay)) {
+        self->queued_notifications.delivered_at = now;
+        CALLBACK("desktop_notify", "IO", osc_code, data);
+        return;
+    }
+    if (!q && !(q = self->queued_notifications.queue = PyList_New(0))) { PyErr_Print(); return; }
+    const Py_ssize_t n = PyList_GET_SIZE(q);
+    if (n >= MAX_QUEUED_NOTIFICATIONS) return;
+    RAII_PyObject(item, Py_BuildValue("IN", osc_code, PyBytes_FromObject(data)));
+    if (!item) { PyErr_Print(); return; }
+    if (n) {
+        int same = PyObject_RichCompareBool(PyList_GET_ITEM(q, n - 1), item, Py_EQ);
+        if (same < 0) PyErr_Clear();
+        if (same > 0) return;
+    }
+    if (PyList_Append(q, item) != 0) PyErr_Print();
+}
+
+static void
+deliver_queued_notifications(Screen *self) {
+    RAII_PyObject(q, self->queued_notifications.queue); self->queued_notifications.queue = NULL;
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(q); i++) {
+        PyObject *item = PyList_GET_ITEM(q, i);
+        CALLBACK("desktop_notify", "IO", (unsigned int)PyLong_AsUnsignedLong(PyTuple_GET_ITEM(item, 0)), PyTuple_GET_ITEM(item, 1));
+    }
 }
 
 void
 desktop_notify(Screen *self, unsigned int osc_code, PyObject *data) {
-    CALLBACK("desktop_notify", "IO", osc_code, data);
-}
+    if (osc_code == 9 && is_progress_report(data)) coalesce(coalesced_progress, data)
+    // OSC 1337 is not a notification and must not be dropped
+    else if (osc_code == 9 || osc_code == 99 || osc_code == 777) queue_notification(self, osc_code, data);
+    else CALLBACK("desktop_notify", "IO", osc_code, data);
+}
+#undef coalesce
+
+monotonic_t
+screen_deliver_coalesced_notifications(Screen *self, monotonic_t now, bool force) {
+    // Returns how long till the next pending notification is due or -1
+    monotonic_t wait = -1;
+#define deliver(which) if (self->which.pending) { \
+    const monotonic_t due = self->which.delivered_at + OPT(repaint_delay); \
+    if (force || now >= due) { \
+        RAII_PyObject(data, self->which.pending); self->which.pending = NULL; \
+        self->which.delivered_at = now; deliver_##which(data); \
+    } else wait = wait < 0 ? due - now : MIN(wait, due - now); \
+}
+    deliver(coalesced_title); deliver(coalesced_progress);
+#undef deliver
+#define due_in(which, has_pending, deliver_pending) if (has_pending) { \
+    const monotonic_t due = self->which.delivered_at + OPT(repaint_delay); \
+    if (force || now >= due) { self->which.delivered_at = now; deliver_pending; } \
+    else wait = wait < 0 ? due - now : MIN(wait, due - now); \
+}
+    due_in(coalesced_bell, self->coalesced_bell.pending, self->coalesced_bell.pending = false; deliver_bell(self));
+    due_in(queued_notifications, self->queued_notifications.queue && PyList_GET_SIZE(self->queued_notifications.queue), deliver_queued_notifications(self));
+#undef due_in
+    return wait;
+}
+#undef deliver_coalesced_title
+#undef deliver_coalesced_progress
+// }}}
 
 void
 set_icon(Screen *self, PyObject *icon) {
@@ -3048,6 +3348,15 @@ parse_prompt_mark(Screen *self, char *buf, PromptKind *pk) {
     }
 }
 
+static void
+finish_cmd_capture(Screen *self) {
+    if (!self->cmd_capture) return;
+    Py_CLEAR(self->captured_cmd_output);
+    self->captured_cmd_output = command_capture_finish(self->cmd_capture);
+    self->cmd_capture = NULL;
+    if (!self->captured_cmd_output) PyErr_Print();
+}
+
 void
 shell_prompt_marking(Screen *self, char *buf) {
     if (self->cursor->y < self->lines) {
@@ -3059,10 +3368,15 @@ shell_prompt_marking(Screen *self, char *buf) {
                 self->prompt_settings.uses_special_keys_for_cursor_movement = 0;
                 parse_prompt_mark(self, buf+1, &pk);
                 self->linebuf->line_attrs[self->cursor->y].prompt_kind = pk;
-                if (pk == PROMPT_START) CALLBACK("cmd_output_marking", "O", Py_False);
+                if (pk == PROMPT_START) {
+                    finish_cmd_capture(self);
+                    CALLBACK("cmd_output_marking", "O", Py_False);
+                }
             } break;
             case 'C': {
                 self->linebuf->line_attrs[self->cursor->y].prompt_kind = OUTPUT_START;
+                free_command_capture(self->cmd_capture); Py_CLEAR(self->captured_cmd_output);
+                self->cmd_capture = OPT(command_output_capture_size) ? alloc_command_capture(OPT(command_output_capture_size) * 1024u * 1024u) : NULL;
                 const char *cmdline = "";
                 if (strstr(buf + 1, ";cmdline") == buf + 1) {
                     cmdline = buf + 2;
@@ -3073,6 +3387,7 @@ shell_prompt_marking(Screen *self, char *buf) {
             } break;
             case 'D': {
                 const char *exit_status = buf[1] == ';' ? buf + 2 : "";
+                finish_cmd_capture(self);
                 CALLBACK("cmd_output_marking", "Os", Py_None, exit_status);
             } break;
         }
@@ -3082,6 +3397,7 @@ shell_prompt_marking(Screen *self, char *buf) {
 static bool
 screen_history_scroll_to_prompt(Screen *self, int num_of_prompts_to_jump, int scroll_offset) {
     if (self->linebuf != self->main_linebuf) return false;
+    historybuf_finish_pending_rewrap(self->historybuf);
     unsigned int old = self->scrolled_by;
     if (num_of_prompts_to_jump == 0) {
         if (!self->last_visited_prompt.is_set || self->last_visited_prompt.scrolled_by > self->historybuf->count || self->last_visited_prompt.y >= self->lines) return false;
@@ -3096,7 +3412,7 @@ screen_history_scroll_to_prompt(Screen *self, int num_of_prompts_to_jump, int sc
         while (num_of_prompts_to_jump) {
             y += delta;
             ensure_y_ok;
-            if (range_line_(self, y)->attrs.prompt_kind == PROMPT_START) {
+            if (range_line_prompt_kind(self, y) == PROMPT_START) {
                 num_of_prompts_to_jump--;
             }
         }
@@ -3250,6 +3566,15 @@ screen_pause_rendering(Screen *self, bool pause, int for_in_ms) {
     if (!self->paused_rendering.grman) self->paused_rendering.grman = grman_alloc(true);
     if (!self->paused_rendering.grman) return false;
     if (for_in_ms <= 0) for_in_ms = 2000;
+    // When nothing has changed since the last render, the cell and selection
+    // data on the GPU already are the paused state, so the lines need not be
+    // copied, which matters for applications that use a synchronized update
+    // for every frame. Only the cursor line is needed, to render the cursor.
+    self->paused_rendering.cells_on_gpu = !self->is_dirty && !self->scroll_changed && !self->reload_all_gpu_data &&
+        self->gpu_cell_data.cells && self->gpu_cell_data.uploaded_generation == self->gpu_cell_data.generation &&
+        self->last_rendered.lines == self->lines && self->last_rendered.columns == self->columns &&
+        self->last_rendered.cursor.x == self->cursor->x && self->last_rendered.cursor.y == self->cursor->y &&
+        !screen_is_selection_dirty(self);
     self->paused_rendering.expires_at = monotonic() + ms_to_monotonic_t(for_in_ms);
     self->paused_rendering.inverted = self->modes.mDECSCNM;
     self->paused_rendering.scrolled_by = self->scrolled_by;
@@ -3263,6 +3588,7 @@ screen_pause_rendering(Screen *self, bool pause, int for_in_ms) {
         if (!self->paused_rendering.linebuf) { PyErr_Clear(); self->paused_rendering.expires_at = 0; return false; }
     }
     for (index_type y = 0; y < self->lines; y++) {
+        if (self->paused_rendering.cells_on_gpu && y != self->cursor->y) continue;
         Line *src = visual_line_(self, y);
         linebuf_init_line(self->paused_rendering.linebuf, y);
         copy_line(src, self->paused_rendering.linebuf->line);
@@ -3327,11 +3653,39 @@ get_line_edge_colors(Screen *self, color_type *left, color_type *right) {
 
 
 static void
-update_line_data(Line *line, unsigned int dest_y, uint8_t *data) {
-    size_t base = sizeof(GPUCell) * dest_y * line->xnum;
-    memcpy(data + base, line->gpu_cells, line->xnum * sizeof(GPUCell));
+update_gpu_row_data(Screen *self, const GPUCell *src, index_type dest_y) {
+    // Rows are sent to the GPU in the format they are stored in. Only rows
+    // that differ are uploaded again, and rows are moved in place on the GPU
+    // when scrolling, so the GPU data must not depend on anything that can
+    // change between frames without the row changing, such as indices into a
+    // per frame palette of colors.
+    GPUCell *dest = self->gpu_cell_data.cells + (size_t)dest_y * self->columns;
+    const size_t sz = self->columns * sizeof(GPUCell);
+    if (memcmp(dest, src, sz) != 0) {
+        memcpy(dest, src, sz);
+        self->gpu_cell_data.row_generations[dest_y] = self->gpu_cell_data.generation;
+    }
+}
+
+static void
+update_line_data(Screen *self, Line *line, index_type dest_y) {
+    update_gpu_row_data(self, line->gpu_cells, dest_y);
 }
 
+static void
+ensure_gpu_cell_data_storage(Screen *self) {
+#define G self->gpu_cell_data
+    G.generation++;
+    if (G.cells && G.lines == self->lines && G.columns == self->columns) return;
+    free(G.cells); free(G.row_generations);
+    G.cells = calloc((size_t)self->lines * self->columns, sizeof(GPUCell));
+    G.row_generations = malloc(self->lines * sizeof(G.row_generations[0]));
+    if (!G.cells || !G.row_generations) fatal("Out of memory allocating GPU cell data");
+    G.lines = self->lines; G.columns = self->columns;
+    // the generation is never reset so that every row is newer than anything already on the GPU
+    for (index_type y = 0; y < G.lines; y++) G.row_generations[y] = G.generation;
+#undef G
+}
 
 static void
 screen_reset_dirty(Screen *self) {
@@ -3445,6 +3799,35 @@ screen_render_line_graphics(Screen *self, Line *line, int32_t row) {
     }
 }
 
+// Graphics commands received after the placeholders in a history line were
+// scanned can alter its cell images, so history lines are scanned again
+// whenever the screen is rendered, unless no placement has changed since the
+// line was last scanned.
+static bool
+history_placeholders_unchanged(Screen *self, unsigned int history_line_added_count) {
+#define PS self->placeholders_scanned
+    if (history_line_added_count || PS.grman != self->grman || PS.generation != grman_placements_generation(self->grman)) PS.first = PS.last = 0;
+    return PS.last > PS.first;
+}
+
+static void
+render_history_line_graphics(Screen *self, index_type lnum, int32_t row, bool placeholders_unchanged) {
+    if (!placeholders_unchanged || lnum < PS.first || lnum >= PS.last || self->historybuf->line->attrs.has_dirty_text) screen_render_line_graphics(self, self->historybuf->line, row);
+}
+
+static void
+finish_history_placeholder_scan(Screen *self) {
+    // Called after all the visible lines have been rendered, as the cell
+    // images created for them change the placements generation
+    const index_type first = self->scrolled_by - MIN(self->lines, self->scrolled_by), last = self->scrolled_by;
+    if (first < last) {
+        if (PS.first < PS.last && first <= PS.last && PS.first <= last) { PS.first = MIN(PS.first, first); PS.last = MAX(PS.last, last); }
+        else { PS.first = first; PS.last = last; }
+    }
+    PS.grman = self->grman; PS.generation = grman_placements_generation(self->grman);
+#undef PS
+}
+
 // This functions is similar to screen_update_cell_data, but it only updates
 // line graphics (cell images) and then marks lines as clean. It's used
 // exclusively for testing unicode placeholders.
@@ -3455,10 +3838,11 @@ screen_update_only_line_graphics_data(Screen *self) {
     if (self->scrolled_by) self->scrolled_by = MIN(self->scrolled_by + history_line_added_count, self->historybuf->count);
     screen_reset_dirty(self);
     self->scroll_changed = false;
+    const bool placeholders_unchanged = history_placeholders_unchanged(self, history_line_added_count);
     for (index_type y = 0; y < MIN(self->lines, self->scrolled_by); y++) {
         lnum = self->scrolled_by - 1 - y;
         historybuf_init_line(self->historybuf, lnum, self->historybuf->line);
-        screen_render_line_graphics(self, self->historybuf->line, y - self->scrolled_by);
+        render_history_line_graphics(self, lnum, y - self->scrolled_by, placeholders_unchanged);
         if (self->historybuf->line->attrs.has_dirty_text) {
             historybuf_mark_line_clean(self->historybuf, lnum);
         }
@@ -3471,12 +3855,32 @@ screen_update_only_line_graphics_data(Screen *self) {
             linebuf_mark_line_clean(self->linebuf, lnum);
         }
     }
+    finish_history_placeholder_scan(self);
+}
+
+static void
+move_gpu_rows_for_scroll(Screen *self, unsigned int previous_scrolled_by) {
+    // When only the scroll position has changed, the rows still visible are
+    // moved in place on the GPU rather than being uploaded again. The copy
+    // of the GPU data is moved the same way so that only the newly exposed
+    // rows compare as changed.
+#define G self->gpu_cell_data
+    const int delta = (int)self->scrolled_by - (int)previous_scrolled_by;
+    if (!delta || abs(delta) >= (int)self->lines) return;
+    const size_t num = self->lines - abs(delta), row_sz = (size_t)self->columns * sizeof(GPUCell);
+    const size_t src = delta > 0 ? 0 : -delta, dest = delta > 0 ? delta : 0;
+    memmove(G.cells + dest * self->columns, G.cells + src * self->columns, num * row_sz);
+    memmove(G.row_generations + dest, G.row_generations + src, num * sizeof(G.row_generations[0]));
+    G.rows_moved_by = delta;
+#undef G
 }
 
 void
-screen_update_cell_data(Screen *self, void *address, FONTS_DATA_HANDLE fonts_data, bool cursor_has_moved) {
+screen_update_cell_data(Screen *self, FONTS_DATA_HANDLE fonts_data, bool cursor_has_moved, bool can_move_gpu_rows) {
+    ensure_gpu_cell_data_storage(self);
+    self->gpu_cell_data.rows_moved_by = 0;
     if (self->paused_rendering.expires_at) {
-        if (!self->paused_rendering.cell_data_updated) {
+        if (!self->paused_rendering.cell_data_updated && !self->paused_rendering.cells_on_gpu) {
             LineBuf *linebuf = self->paused_rendering.linebuf;
             for (index_type y = 0; y < self->lines; y++) {
                 linebuf_init_line(linebuf, y);
@@ -3487,7 +3891,7 @@ screen_update_cell_data(Screen *self, void *address, FONTS_DATA_HANDLE fonts_dat
                             self->marker, linebuf->line, &self->as_ansi_buf);
                     linebuf_mark_line_clean(linebuf, y);
                 }
-                update_line_data(linebuf->line, y, address);
+                update_line_data(self, linebuf->line, y);
             }
         }
         return;
@@ -3498,19 +3902,22 @@ screen_update_cell_data(Screen *self, void *address, FONTS_DATA_HANDLE fonts_dat
     screen_reset_dirty(self);
     update_overlay_position(self);
     if (self->scrolled_by) self->scrolled_by = MIN(self->scrolled_by + history_line_added_count, self->historybuf->count);
+    if (can_move_gpu_rows && self->scroll_changed && !history_line_added_count && !is_overlay_active &&
+        self->gpu_cell_data.uploaded_generation + 1 == self->gpu_cell_data.generation &&
+        self->last_rendered.lines == self->lines && self->last_rendered.columns == self->columns
+    ) move_gpu_rows_for_scroll(self, self->last_rendered.scrolled_by);
     self->scroll_changed = false;
+    const bool placeholders_unchanged = history_placeholders_unchanged(self, history_line_added_count);
     for (index_type y = 0; y < MIN(self->lines, self->scrolled_by); y++) {
         lnum = self->scrolled_by - 1 - y;
         historybuf_init_line(self->historybuf, lnum, self->historybuf->line);
-        // we render line graphics even if the line is not dirty as graphics commands received after
-        // the unicode placeholder was first scanned can alter it.
-        screen_render_line_graphics(self, self->historybuf->line, y - self->scrolled_by);
+        render_history_line_graphics(self, lnum, y - self->scrolled_by, placeholders_unchanged);
         if (self->historybuf->line->attrs.has_dirty_text) {
             render_line(fonts_data, self->historybuf->line, lnum, self->cursor, self->disable_ligatures, self->lc);
             if (screen_has_marker(self)) mark_text_in_line(self->marker, self->historybuf->line, &self->as_ansi_buf);
             historybuf_mark_line_clean(self->historybuf, lnum);
         }
-        update_line_data(self->historybuf->line, y, address);
+        update_line_data(self, self->historybuf->line, y);
     }
     for (index_type y = self->scrolled_by; y < self->lines; y++) {
         lnum = y - self->scrolled_by;
@@ -3524,15 +3931,16 @@ screen_update_cell_data(Screen *self, void *address, FONTS_DATA_HANDLE fonts_dat
             if (is_overlay_active && lnum == self->overlay_line.ynum) render_overlay_line(self, self->linebuf->line, fonts_data);
             linebuf_mark_line_clean(self->linebuf, lnum);
         }
-        update_line_data(self->linebuf->line, y, address);
+        update_line_data(self, self->linebuf->line, y);
     }
     if (is_overlay_active && self->overlay_line.ynum + self->scrolled_by < self->lines) {
         if (self->overlay_line.is_dirty) {
             linebuf_init_line(self->linebuf, self->overlay_line.ynum);
             render_overlay_line(self, self->linebuf->line, fonts_data);
         }
-        update_overlay_line_data(self, address);
+        update_overlay_line_data(self);
     }
+    finish_history_placeholder_scan(self);
 }
 
 static bool
@@ -3681,29 +4089,38 @@ iteration_data_is_empty(const Screen *self, const IterationData *idata) {
 }
 
 static void
-apply_selection(Screen *self, uint8_t *data, Selection *s, uint8_t set_mask) {
+apply_selection_to_rows(Screen *self, uint8_t *data, Selection *s, uint8_t set_mask, int row_min, int row_limit) {
+    // Only the rows from row_min to row_limit are written to, including the
+    // parts of multiline characters from other rows that are in them
+    static const int max_scale = ( (1u << SCALE_BITS) - 1u);
     iteration_data(s, &s->last_rendered, self->columns, -self->historybuf->count, self->scrolled_by);
     Line *line;
-    const int y_min = MAX(0, s->last_rendered.y), y_limit = MIN(s->last_rendered.y_limit, (int)self->lines);
+    const int y_min = MAX(MAX(0, s->last_rendered.y), row_min - max_scale), y_limit = MIN(MIN(s->last_rendered.y_limit, (int)self->lines), row_limit + max_scale);
     for (int y = y_min; y < y_limit; y++) {
         if (self->paused_rendering.expires_at) {
             linebuf_init_line(self->paused_rendering.linebuf, y);
             line = self->paused_rendering.linebuf->line;
         } else line = visual_line_(self, y);
         uint8_t *line_start = data + self->columns * y;
+        const bool in_rows = row_min <= y && y < row_limit;
         XRange xr = xrange_for_iteration_with_multicells(&s->last_rendered, y, line);
         for (index_type x = xr.x; x < xr.x_limit; x++) {
-            line_start[x] |= set_mask;
+            if (in_rows) line_start[x] |= set_mask;
             CPUCell *c = &line->cpu_cells[x];
             if (c->is_multicell && c->scale > 1) {
-                for (int ym = MAX(0, y - c->y); ym < y; ym++) data[self->columns * ym + x] |= set_mask;
-                for (int ym = y + 1; ym < MIN((int)self->lines, y + c->scale - c->y); ym++) data[self->columns * ym + x] |= set_mask;
+                for (int ym = MAX(row_min, y - c->y); ym < y; ym++) data[self->columns * ym + x] |= set_mask;
+                for (int ym = MAX(row_min, y + 1); ym < MIN(row_limit, y + c->scale - c->y); ym++) data[self->columns * ym + x] |= set_mask;
             }
         }
     }
     s->last_rendered.y = MAX(0, s->last_rendered.y);
 }
 
+static void
+apply_selection(Screen *self, uint8_t *data, Selection *s, uint8_t set_mask) {
+    apply_selection_to_rows(self, data, s, set_mask, 0, self->lines);
+}
+
 bool
 screen_has_selection(Screen *self) {
     IterationData idata;
@@ -3738,6 +4155,76 @@ screen_apply_selection(Screen *self, void *address, size_t size) {
     ec->dirty = false;
 }
 
+static XRange
+selected_range_of_row(const IterationData *idata, int y) {
+    if (y < idata->y || y >= idata->y_limit) return (XRange){0};
+    if (y == idata->y) return idata->first;
+    if (y == idata->y_limit - 1) return idata->last;
+    return idata->body;
+}
+
+static bool
+only_primary_selection_changed(Screen *self) {
+#define G self->gpu_selection_data
+    if (!G.is_valid || G.lines != self->lines || G.columns != self->columns || G.scrolled_by != self->scrolled_by) return false;
+    if (G.cell_generation != self->gpu_cell_data.generation || self->paused_rendering.expires_at || self->extra_cursors.dirty) return false;
+    if (self->selections.count != 1 || self->selections.last_rendered_count != 1 || self->url_ranges.count != self->url_ranges.last_rendered_count) return false;
+    IterationData q;
+    for (size_t i = 0; i < self->url_ranges.count; i++) {
+        iteration_data(self->url_ranges.items + i, &q, self->columns, -self->historybuf->count, self->scrolled_by);
+        q.y = MAX(0, q.y);
+        if (memcmp(&q, &self->url_ranges.items[i].last_rendered, sizeof(IterationData)) != 0) return false;
+    }
+    return true;
+#undef G
+}
+
+void
+screen_update_selection_render_data(Screen *self, void *address, size_t size, bool reload_all) {
+#define G self->gpu_selection_data
+    IterationData primary = {0};
+    if (self->selections.count) iteration_data(self->selections.items, &primary, self->columns, -self->historybuf->count, self->scrolled_by);
+    if (!reload_all && only_primary_selection_changed(self)) {
+        // Find the rows whose selected range changed, extended by the height
+        // of the tallest multiline character as those can select cells on
+        // the rows above and below them
+        static const int max_scale = ( (1u << SCALE_BITS) - 1u);
+        int row_min = self->lines, row_limit = 0;
+        for (int y = 0; y < (int)self->lines; y++) {
+            XRange a = selected_range_of_row(&G.primary, y), b = selected_range_of_row(&primary, y);
+            if (a.x != b.x || a.x_limit != b.x_limit) { row_min = MIN(row_min, y); row_limit = y + 1; }
+        }
+        if (row_min < row_limit) {
+            row_min = MAX(0, row_min - max_scale); row_limit = MIN((int)self->lines, row_limit + max_scale);
+            memset(G.data + (size_t)self->columns * row_min, 0, (size_t)self->columns * (row_limit - row_min));
+            apply_selection_to_rows(self, G.data, self->selections.items, 1, row_min, row_limit);
+            for (size_t i = 0; i < self->url_ranges.count; i++) {
+                Selection *s = self->url_ranges.items + i;
+                if (OPT(underline_hyperlinks) == UNDERLINE_NEVER && s->is_hyperlink) continue;
+                apply_selection_to_rows(self, G.data, s, 2, row_min, row_limit);
+            }
+            const size_t start = (size_t)self->columns * row_min, limit = (size_t)self->columns * row_limit;
+            for (unsigned i = 0; i < self->extra_cursors.count; i++) {
+                const ExtraCursor *ec = self->extra_cursors.locations + i;
+                if (start <= ec->cell && ec->cell < limit) G.data[ec->cell] |= (ec->shape & 7) << 2;
+            }
+        }
+    } else {
+        if (!G.data || G.lines != self->lines || G.columns != self->columns) {
+            free(G.data);
+            if (!(G.data = malloc(size))) fatal("Out of memory allocating GPU selection data");
+            G.lines = self->lines; G.columns = self->columns;
+        }
+        screen_apply_selection(self, G.data, size);
+        G.scrolled_by = self->scrolled_by;
+        G.cell_generation = self->gpu_cell_data.generation;
+        G.is_valid = !self->paused_rendering.expires_at;
+    }
+    G.primary = primary;
+    memcpy(address, G.data, size);
+#undef G
+}
+
 static index_type
 limit_without_trailing_whitespace(const Line *line, index_type limit) {
     if (!limit) return limit;
@@ -3798,17 +4285,15 @@ flag_selection_to_extract_text(Screen *self, const Selection *s, int *miny, int
     }
 }
 
-static PyObject*
-text_for_range(Screen *self, const Selection *sel, bool insert_newlines, bool strip_trailing_whitespace) {
-    int min_y, y_limit;
-    flag_selection_to_extract_text(self, sel, &min_y, &y_limit);
-    if (min_y >= y_limit) return PyTuple_New(0);
-    size_t before = self->as_ansi_buf.len;
-    RAII_PyObject(ans, PyTuple_New(y_limit - min_y));
-    RAII_PyObject(nl, PyUnicode_FromString("\n"));
-    RAII_PyObject(empty, PyUnicode_FromString(""));
-    if (!ans || !nl || !empty) return NULL;
-    for (int i = 0, y = min_y; y < y_limit; y++, i++) {
+// Calls output() with the text of every line flagged by
+// flag_selection_to_extract_text(), which is only valid for the duration of the call. Lines that are empty or only whitespace
+// are passed as NULL with just the newline (if any) in len.
+typedef bool (*range_text_output)(void *data, const Py_UCS4 *text, size_t len);
+
+static bool
+iter_text_for_range(Screen *self, int min_y, int y_limit, bool insert_newlines, bool strip_trailing_whitespace, range_text_output output, void *data) {
+    const size_t before = self->as_ansi_buf.len;
+    for (int y = min_y; y < y_limit; y++) {
         Line *line = range_line_(self, y);
         index_type x_limit = line->xnum, x_start = 0;
         while (x_limit && !line->cpu_cells[x_limit - 1].temp_flag) x_limit--;
@@ -3823,27 +4308,93 @@ text_for_range(Screen *self, const Selection *sel, bool insert_newlines, bool st
         }
         const bool is_first_line = y == min_y, is_last_line = y + 1 >= y_limit;
         const bool add_trailing_newline = insert_newlines && !is_last_line;
-        PyObject *text = NULL;
+        bool ok;
         if (x_limit <= x_start && (is_only_whitespace_line || line_is_empty(line))) {
             // we want a newline on only whitespace lines even if they are continued
-            text = add_trailing_newline ? nl : empty;
-            text = Py_NewRef(text);
+            ok = output(data, NULL, add_trailing_newline ? 1 : 0);
         } else {
             while (x_start < x_limit) {
                 index_type end = x_start;
                 while (end < x_limit && line->cpu_cells[end].temp_flag) end++;
-                if (!unicode_in_range(line, x_start, end, true, add_trailing_newline, false, !is_first_line, &self->as_ansi_buf)) return PyErr_NoMemory();
+                if (!unicode_in_range(line, x_start, end, true, add_trailing_newline, false, !is_first_line, &self->as_ansi_buf)) {
+                    self->as_ansi_buf.len = before; PyErr_NoMemory(); return false;
+                }
                 x_start = MAX(x_start + 1, end);
             }
-            text = PyUnicode_FromKindAndData(PyUnicode_4BYTE_KIND, self->as_ansi_buf.buf + before, self->as_ansi_buf.len - before);
+            ok = output(data, self->as_ansi_buf.buf + before, self->as_ansi_buf.len - before);
         }
         self->as_ansi_buf.len = before;
-        if (!text) return NULL;
-        PyTuple_SET_ITEM(ans, i, text);
+        if (!ok) return false;
     }
+    return true;
+}
+
+typedef struct {
+    PyObject *lines, *nl, *empty;
+    Py_ssize_t count;
+} LinesOutput;
+
+static bool
+output_line_as_str(void *data, const Py_UCS4 *text, size_t len) {
+    LinesOutput *o = data;
+    PyObject *x;
+    if (text) x = PyUnicode_FromKindAndData(PyUnicode_4BYTE_KIND, text, len);
+    else x = Py_NewRef(len ? o->nl : o->empty);
+    if (!x) return false;
+    PyTuple_SET_ITEM(o->lines, o->count++, x);
+    return true;
+}
+
+static PyObject*
+text_for_range(Screen *self, const Selection *sel, bool insert_newlines, bool strip_trailing_whitespace) {
+    int min_y, y_limit;
+    flag_selection_to_extract_text(self, sel, &min_y, &y_limit);
+    if (min_y >= y_limit) return PyTuple_New(0);
+    RAII_PyObject(ans, PyTuple_New(y_limit - min_y));
+    RAII_PyObject(nl, PyUnicode_FromString("\n"));
+    RAII_PyObject(empty, PyUnicode_FromString(""));
+    if (!ans || !nl || !empty) return NULL;
+    LinesOutput o = {.lines=ans, .nl=nl, .empty=empty};
+    if (!iter_text_for_range(self, min_y, y_limit, insert_newlines, strip_trailing_whitespace, output_line_as_str, &o)) return NULL;
     return Py_NewRef(ans);
 }
 
+typedef struct {
+    PyObject *bytes;
+    size_t len;
+} UTF8Output;
+
+static bool
+output_line_as_utf8(void *data, const Py_UCS4 *text, size_t len) {
+    UTF8Output *o = data;
+    // at most four bytes per codepoint
+    const size_t needed = o->len + 4 * (text ? len : 1);
+    if ((size_t)PyBytes_GET_SIZE(o->bytes) < needed) {
+        if (_PyBytes_Resize(&o->bytes, MAX(needed, 2 * (size_t)PyBytes_GET_SIZE(o->bytes))) != 0) return false;
+    }
+    char *dest = PyBytes_AS_STRING(o->bytes);
+    if (!text) { if (len) dest[o->len++] = '\n'; }
+    else for (size_t i = 0; i < len; i++) o->len += encode_utf8(text[i], dest + o->len);
+    return true;
+}
+
+// Avoids materializing a str per line and joining and encoding them, which
+// matters when copying very large selections to the clipboard
+static PyObject*
+utf8_for_selections(Screen *self, Selections *selections, bool strip_trailing_whitespace) {
+    UTF8Output o = {.bytes=PyBytes_FromStringAndSize(NULL, 4096)};
+    if (!o.bytes) return NULL;
+    for (size_t i = 0; i < selections->count; i++) {
+        int min_y, y_limit;
+        flag_selection_to_extract_text(self, selections->items + i, &min_y, &y_limit);
+        if (!iter_text_for_range(self, min_y, y_limit, true, strip_trailing_whitespace, output_line_as_utf8, &o)) {
+            Py_XDECREF(o.bytes); return NULL;
+        }
+    }
+    if (_PyBytes_Resize(&o.bytes, o.len) != 0) return NULL;
+    return o.bytes;
+}
+
 static PyObject*
 ansi_for_range(Screen *self, const Selection *sel, bool insert_newlines, bool strip_trailing_whitespace) {
     int min_y, y_limit;
@@ -4030,8 +4581,42 @@ extend_url(Screen *screen, Line *line, index_type *x, index_type *y, char_type s
     }
 }
 
-int
-screen_detect_url(Screen *screen, unsigned int x, unsigned int y) {
+enum { URL_INDEX_UNKNOWN, URL_INDEX_NO_URL, URL_INDEX_MAYBE_URL };
+
+static bool
+line_can_have_url(Screen *screen, Line *line, index_type y) {
+    // URLs must have :// after the prefix, see find_colon_slash(), so lines
+    // without it, which are the vast majority, need not be scanned. Whether a
+    // line has it is remembered till the screen contents change.
+#define I screen->url_detection.index
+    if (screen->is_dirty) return true;
+    if (I.generation != screen->gpu_cell_data.generation || I.scrolled_by != screen->scrolled_by || I.num_lines != screen->lines) {
+        if (I.num_lines != screen->lines) {
+            free(I.lines);
+            I.lines = malloc(screen->lines * sizeof(I.lines[0]));
+            if (!I.lines) { I.num_lines = 0; return true; }
+            I.num_lines = screen->lines;
+        }
+        memset(I.lines, URL_INDEX_UNKNOWN, I.num_lines * sizeof(I.lines[0]));
+        I.generation = screen->gpu_cell_data.generation; I.scrolled_by = screen->scrolled_by;
+    }
+    if (y >= I.num_lines) return true;
+    if (I.lines[y] == URL_INDEX_UNKNOWN) {
+        I.lines[y] = URL_INDEX_NO_URL;
+        const CPUCell *c = line->cpu_cells;
+        for (index_type x = 0; x + 2 < line->xnum; x++) {
+            // the :// of multicell characters is spread out over more cells
+            if (cell_is_char(c + x, ':') && (c[x].is_multicell || (cell_is_char(c + x + 1, '/') && cell_is_char(c + x + 2, '/')))) {
+                I.lines[y] = URL_INDEX_MAYBE_URL; break;
+            }
+        }
+    }
+    return I.lines[y] == URL_INDEX_MAYBE_URL;
+#undef I
+}
+
+static int
+scan_for_url(Screen *screen, unsigned int x, unsigned int y) {
     bool has_url = false;
     index_type url_start, url_end = 0;
     Line *line = screen_visual_line(screen, y);
@@ -4047,6 +4632,10 @@ screen_detect_url(Screen *screen, unsigned int x, unsigned int y) {
         screen_mark_hyperlink(screen, x, y);
         return hid;
     }
+    if (!line_can_have_url(screen, line, y)) {
+        screen_mark_url(screen, 0, 0, 0, 0);
+        return 0;
+    }
     char_type sentinel = 0;
     const bool newlines_allowed = !is_excluded_from_url('\n');
     index_type last_hostname_char_pos = screen->columns;
@@ -4076,6 +4665,22 @@ screen_detect_url(Screen *screen, unsigned int x, unsigned int y) {
     return has_url ? -1 : 0;
 }
 
+int
+screen_detect_url(Screen *screen, unsigned int x, unsigned int y) {
+    // With high polling rate mice, there are many motion events per cell, so
+    // only scan for a URL when the cell or the screen contents have changed.
+    // If the contents have changed, either the screen is dirty or it has
+    // been rendered since, which changes the generation.
+#define D screen->url_detection
+    if (D.is_valid && D.x == x && D.y == y && D.scrolled_by == screen->scrolled_by && !screen->is_dirty &&
+            D.generation == screen->gpu_cell_data.generation && (!D.result || screen->url_ranges.count)) return D.result;
+    const int ans = scan_for_url(screen, x, y);
+    D.x = x; D.y = y; D.scrolled_by = screen->scrolled_by; D.generation = screen->gpu_cell_data.generation;
+    D.result = ans; D.is_valid = true;
+#undef D
+    return ans;
+}
+
 // }}}
 
 // IME Overlay {{{
@@ -4092,23 +4697,22 @@ deactivate_overlay_line(Screen *self) {
     }
     self->overlay_line.is_active = false;
     self->overlay_line.is_dirty = true;
+    self->overlay_line.is_predicted_echo = false;
     self->overlay_line.ynum = 0;
     self->overlay_line.xstart = 0;
     self->overlay_line.cursor_x = 0;
 }
 
-void
-screen_update_overlay_text(Screen *self, const char *utf8_text) {
-    if (screen_is_overlay_active(self)) deactivate_overlay_line(self);
-    if (!utf8_text || !utf8_text[0]) return;
-    PyObject *text = PyUnicode_FromString(utf8_text);
-    if (!text) return;
+static void
+set_overlay_text(Screen *self, PyObject *text, bool is_predicted_echo) {
+    // steals the reference to text
     Py_XDECREF(self->overlay_line.overlay_text);
     // Calculate the total number of cells for initial overlay cursor position
     RAII_PyObject(text_len, wcswidth_std(NULL, text));
     self->overlay_line.overlay_text = text;
     self->overlay_line.is_active = true;
     self->overlay_line.is_dirty = true;
+    self->overlay_line.is_predicted_echo = is_predicted_echo;
     self->overlay_line.xstart = self->cursor->x;
     self->overlay_line.xnum = !text_len ? 0 : PyLong_AsLong(text_len);
     self->overlay_line.text_len = self->overlay_line.xnum;
@@ -4124,6 +4728,16 @@ screen_update_overlay_text(Screen *self, const char *utf8_text) {
     }
 }
 
+void
+screen_update_overlay_text(Screen *self, const char *utf8_text) {
+    self->predicted_echo.count = 0;
+    if (screen_is_overlay_active(self)) deactivate_overlay_line(self);
+    if (!utf8_text || !utf8_text[0]) return;
+    PyObject *text = PyUnicode_FromString(utf8_text);
+    if (!text) return;
+    set_overlay_text(self, text, false);
+}
+
 static void
 screen_draw_overlay_line(Screen *self) {
     if (!self->overlay_line.overlay_text) return;
@@ -4139,7 +4753,11 @@ screen_draw_overlay_line(Screen *self) {
     self->modes.mIRM = false;
     Cursor *orig_cursor = self->cursor;
     self->cursor = &(self->overlay_line.original_line.cursor);
-    self->cursor->sgr.reverse ^= true;
+    // pre-edit text is drawn in reverse video, predicted echo underlined
+    const bool is_predicted_echo = self->overlay_line.is_predicted_echo;
+    const uint8_t orig_decoration = self->cursor->sgr.decoration;
+    if (is_predicted_echo) self->cursor->sgr.decoration = 1;
+    else self->cursor->sgr.reverse ^= true;
     self->cursor->x = xstart;
     self->cursor->y = self->overlay_line.ynum;
     self->overlay_line.xnum = 0;
@@ -4187,7 +4805,8 @@ screen_draw_overlay_line(Screen *self) {
         self->overlay_line.xnum += len;
     }
     self->overlay_line.cursor_x = self->cursor->x;
-    self->cursor->sgr.reverse ^= true;
+    if (is_predicted_echo) self->cursor->sgr.decoration = orig_decoration;
+    else self->cursor->sgr.reverse ^= true;
     self->cursor = orig_cursor;
     self->modes.mDECAWM = orig_line_wrap_mode;
     self->modes.mDECTCEM = orig_cursor_enable_mode;
@@ -4234,11 +4853,279 @@ render_overlay_line(Screen *self, Line *line, FONTS_DATA_HANDLE fonts_data) {
 }
 
 static void
-update_overlay_line_data(Screen *self, uint8_t *data) {
-    const size_t base = sizeof(GPUCell) * (self->overlay_line.ynum + self->scrolled_by) * self->columns;
-    memcpy(data + base, self->overlay_line.gpu_cells, self->columns * sizeof(GPUCell));
+update_overlay_line_data(Screen *self) {
+    update_gpu_row_data(self, self->overlay_line.gpu_cells, self->overlay_line.ynum + self->scrolled_by);
+}
+
+// }}}
+
+// Predictive echo {{{
+// Over a slow connection every typed character appears only after a round
+// trip. When enabled, printable ASCII typed at a shell prompt is drawn
+// speculatively, underlined, in the overlay line at the cursor. Predictions
+// are dropped as the child echoes them and all of them are discarded when
+// anything else is drawn there, another key is sent or no echo arrives in time.
+
+#define PREDICTED_ECHO_TIMEOUT s_to_monotonic_t(2ll)
+#define pe self->predicted_echo
+
+static void
+show_predicted_echo(Screen *self) {
+    // the overlay text is a Python object, so it is updated from the main thread
+    if (self->parsing_off_main_thread) { self->deferred_to_main_thread.predicted_echo = true; return; }
+    if (!pe.count) {
+        if (self->overlay_line.is_predicted_echo) deactivate_overlay_line(self);
+        return;
+    }
+    PyObject *text = PyUnicode_FromKindAndData(PyUnicode_4BYTE_KIND, pe.chars, pe.count);
+    if (!text) { PyErr_Clear(); return; }
+    if (screen_is_overlay_active(self)) deactivate_overlay_line(self);
+    set_overlay_text(self, text, true);
+}
+
+void
+screen_clear_predicted_echo(Screen *self) {
+    if (pe.count) { pe.count = 0; show_predicted_echo(self); }
+}
+
+void
+screen_predict_echo(Screen *self, const char *text) {
+    if (!pe.enabled) return;
+    if (!text || !text[0] || (screen_is_overlay_active(self) && !self->overlay_line.is_predicted_echo) || screen_cursor_at_a_shell_prompt(self) < 0) {
+        screen_clear_predicted_echo(self); return;
+    }
+    for (const char *p = text; *p; p++) {
+        if (*p < ' ' || *p > '~') { screen_clear_predicted_echo(self); return; }
+    }
+    if (pe.count && pe.y != self->cursor->y) screen_clear_predicted_echo(self);
+    if (!pe.count) { pe.x = self->cursor->x; pe.y = self->cursor->y; pe.confirmed_at = monotonic(); }
+    // predictions never wrap, the shell may handle the end of the line in any way
+    for (const char *p = text; *p && pe.count < arraysz(pe.chars) && pe.x + pe.count + 1 < self->columns; p++) pe.chars[pe.count++] = *p;
+    show_predicted_echo(self);
+}
+
+static void
+confirm_predicted_echo(Screen *self, const uint32_t *chars, size_t num_chars) {
+    if (self->cursor->x != pe.x || self->cursor->y != pe.y) { screen_clear_predicted_echo(self); return; }
+    unsigned n = 0;
+    while (n < num_chars && n < pe.count && chars[n] == pe.chars[n]) n++;
+    if (n < num_chars && n < pe.count) { screen_clear_predicted_echo(self); return; }
+    pe.count -= n; pe.x += n;
+    if (pe.count) memmove(pe.chars, pe.chars + n, pe.count * sizeof(pe.chars[0]));
+    pe.confirmed_at = monotonic();
+    show_predicted_echo(self);
+}
+
+monotonic_t
+screen_expire_predicted_echo(Screen *self, monotonic_t now) {
+    // Returns how long to wait before calling this again, negative if there is nothing to do
+    if (!pe.count) return -1;
+    if (now - pe.confirmed_at < PREDICTED_ECHO_TIMEOUT) return PREDICTED_ECHO_TIMEOUT - (now - pe.confirmed_at);
+    screen_clear_predicted_echo(self);
+    return -1;
+}
+
+static PyObject*
+predict_echo(Screen *self, PyObject *text) {
+    if (!PyUnicode_Check(text)) { PyErr_SetString(PyExc_TypeError, "text must be a string"); return NULL; }
+    screen_predict_echo(self, PyUnicode_AsUTF8(text));
+    Py_RETURN_NONE;
+}
+
+static PyObject*
+predicted_echo(Screen *self, PyObject *args UNUSED) {
+    return PyUnicode_FromKindAndData(PyUnicode_4BYTE_KIND, pe.chars, pe.count);
+}
+
+#undef pe
+// }}}
+
+// Text cache compaction {{{
+// The scrollback is marked a few segments at a time when the screen is idle.
+// Input aborts a compaction in progress, as it can move cells from parts that
+// have not been marked yet into parts that have. Renumbering the cells is
+// done in one go, once marking is complete.
+
+#define TEXT_CACHE_COMPACTION_IDLE_TIME s_double_to_monotonic_t(1)
+#define TEXT_CACHE_COMPACTION_STEP_TIME ms_to_monotonic_t(2ll)
+#define TEXT_CACHE_COMPACTION_STEP_INTERVAL ms_to_monotonic_t(10ll)
+
+static void
+mark_text_cache_indices(CPUCell *cells, size_t num, void *data) {
+    TextCache *tc = data;
+    for (size_t i = 0; i < num; i++) if (cells[i].ch_is_idx) tc_mark_index(tc, cells[i].ch_or_idx);
+}
+
+static void
+remap_text_cache_indices(CPUCell *cells, size_t num, void *data) {
+    const char_type *remap = data;
+    for (size_t i = 0; i < num; i++) if (cells[i].ch_is_idx) cells[i].ch_or_idx = remap[cells[i].ch_or_idx];
+}
+
+static void
+visit_cells_outside_history(Screen *self, historybuf_cells_visitor visitor, void *data) {
+    LineBuf *bufs[] = {self->main_linebuf, self->alt_linebuf, self->paused_rendering.linebuf};
+    for (unsigned i = 0; i < arraysz(bufs); i++) {
+        if (bufs[i]) visitor(bufs[i]->cpu_cell_buf, (size_t)bufs[i]->xnum * bufs[i]->ynum, data);
+    }
+    visitor(self->overlay_line.cpu_cells, self->columns, data);
+    visitor(self->overlay_line.original_line.cpu_cells, self->columns, data);
+}
+
+static char_type
+finish_text_cache_compaction(Screen *self) {
+    char_type num_removed;
+    RAII_ALLOC(char_type, remap, tc_compact(self->text_cache, &num_removed));
+    if (!remap) return 0;
+    visit_cells_outside_history(self, remap_text_cache_indices, remap);
+    HistoryBuf *hb = self->historybuf;
+    for (index_type i = 0; i < hb->num_segments; i++) {
+        if (!historybuf_visit_segment_cells(hb, i, remap_text_cache_indices, remap, true)) {
+            log_error("Failed to update scrollback in the disk cache, some of it will be blank");
+            historybuf_blank_segment(hb, i);
+        }
+    }
+    return num_removed;
+}
+
+monotonic_t
+screen_compact_text_cache_when_idle(Screen *self, monotonic_t now) {
+    // Returns how long to wait before calling this again, negative if there is nothing to do
+    TextCache *tc = self->text_cache;
+    HistoryBuf *hb = self->historybuf;
+    // the lines waiting to be rewrapped use the text cache as well
+    if (hb->pending_rewrap) return -1;
+    if (!tc_compaction_in_progress(tc)) {
+        if (!tc_needs_compaction(tc)) return -1;
+        const monotonic_t idle_for = now - self->text_cache_compaction.activity_at;
+        if (idle_for < TEXT_CACHE_COMPACTION_IDLE_TIME) return TEXT_CACHE_COMPACTION_IDLE_TIME - idle_for;
+        if (!tc_begin_compaction(tc)) return -1;
+        self->text_cache_compaction.next_segment = 0;
+        visit_cells_outside_history(self, mark_text_cache_indices, tc);
+    }
+    const monotonic_t deadline = monotonic() + TEXT_CACHE_COMPACTION_STEP_TIME;
+    while (self->text_cache_compaction.next_segment < hb->num_segments) {
+        if (!historybuf_visit_segment_cells(hb, self->text_cache_compaction.next_segment++, mark_text_cache_indices, tc, false)) {
+            // cannot tell which entries the segment uses, try again later
+            screen_abort_text_cache_compaction(self, now);
+            return TEXT_CACHE_COMPACTION_IDLE_TIME;
+        }
+        if (monotonic() >= deadline) return TEXT_CACHE_COMPACTION_STEP_INTERVAL;
+    }
+    finish_text_cache_compaction(self);
+    return -1;
+}
+
+void
+screen_abort_text_cache_compaction(Screen *self, monotonic_t now) {
+    self->text_cache_compaction.activity_at = now;
+    if (tc_compaction_in_progress(self->text_cache)) tc_abort_compaction(self->text_cache);
+}
+
+monotonic_t
+screen_garbage_collect_hyperlinks_when_idle(Screen *self, monotonic_t now) {
+    // Returns how long to wait before calling this again, negative if there is
+    // nothing to do. Output with lots of unique hyperlinks, such as from ls
+    // --hyperlink, is collected here rather than while it is being parsed.
+    if (!hyperlink_pool_needs_garbage_collection(self->hyperlink_pool)) return -1;
+    const monotonic_t idle_for = now - self->text_cache_compaction.activity_at;
+    if (idle_for < TEXT_CACHE_COMPACTION_IDLE_TIME) return TEXT_CACHE_COMPACTION_IDLE_TIME - idle_for;
+    // the lines waiting to be rewrapped have hyperlink ids as well
+    if (self->historybuf->pending_rewrap) return TEXT_CACHE_COMPACTION_IDLE_TIME;
+    screen_garbage_collect_hyperlink_pool(self);
+    return -1;
+}
+
+static PyObject*
+compact_text_cache(Screen *self, PyObject *a UNUSED) {
+    historybuf_finish_pending_rewrap(self->historybuf);
+    if (!tc_begin_compaction(self->text_cache)) return PyErr_NoMemory();
+    visit_cells_outside_history(self, mark_text_cache_indices, self->text_cache);
+    for (index_type i = 0; i < self->historybuf->num_segments; i++) {
+        if (!historybuf_visit_segment_cells(self->historybuf, i, mark_text_cache_indices, self->text_cache, false)) {
+            tc_abort_compaction(self->text_cache);
+            PyErr_SetString(PyExc_OSError, "Failed to read scrollback from the disk cache");
+            return NULL;
+        }
+    }
+    return PyLong_FromUnsignedLong(finish_text_cache_compaction(self));
+}
+// }}}
+
+// Idle memory release {{{
+// Windows that have had no input for a long time give back the memory that
+// is only needed while output is arriving: the parser buffer, the
+// uncompressed scrollback segments and the buffer used to format lines as
+// text. Everything is allocated again on demand. The activity time is the
+// one used for text cache compaction, which is updated on input and resize.
+
+#define IDLE_MEMORY_RELEASE_TIME s_double_to_monotonic_t(5 * 60)
+
+static unsigned long long
+release_memory_of_idle_screen(Screen *self) {
+    unsigned long long ans = vt_parser_release_buffer(self->vt_parser);
+    ans += historybuf_release_memory(self->historybuf);
+    ans += self->as_ansi_buf.capacity * sizeof(self->as_ansi_buf.buf[0]);
+    free(self->as_ansi_buf.buf); self->as_ansi_buf.buf = NULL; self->as_ansi_buf.capacity = 0; self->as_ansi_buf.len = 0;
+    return ans;
+}
+
+monotonic_t
+screen_release_memory_when_idle(Screen *self, monotonic_t now) {
+    // Returns how long to wait before calling this again, negative if there is nothing to do
+    const monotonic_t activity_at = self->text_cache_compaction.activity_at;
+    if (self->idle_memory.released_at > activity_at) return -1;
+    self->idle_memory.released = 0;
+    const monotonic_t idle_for = now - activity_at;
+    if (idle_for < IDLE_MEMORY_RELEASE_TIME) return IDLE_MEMORY_RELEASE_TIME - idle_for;
+    // let text cache compaction and history rewrapping finish first
+    if (tc_compaction_in_progress(self->text_cache) || self->historybuf->pending_rewrap) return TEXT_CACHE_COMPACTION_IDLE_TIME;
+    self->idle_memory.released = release_memory_of_idle_screen(self);
+    self->idle_memory.released_at = now;
+    return -1;
+}
+
+static size_t
+linebuf_memory_usage(const LineBuf *lb) {
+    if (!lb) return 0;
+    return (size_t)lb->xnum * lb->ynum * (sizeof(CPUCell) + sizeof(GPUCell)) + lb->ynum * (2 * sizeof(index_type) + sizeof(LineAttrs));
+}
+
+static PyObject*
+memory_usage(Screen *self, PyObject *a UNUSED) {
+    HistoryBufMemoryUsage h = historybuf_memory_usage(self->historybuf);
+    GraphicsMemoryUsage g = grman_memory_usage(self->grman);
+    return Py_BuildValue("{sn sn sn sn sn sn sn sn sn sn sn sn sn}",
+        "linebufs", (Py_ssize_t)(linebuf_memory_usage(self->main_linebuf) + linebuf_memory_usage(self->alt_linebuf) + linebuf_memory_usage(self->paused_rendering.linebuf)),
+        "history_cells", (Py_ssize_t)h.cells, "history_compressed", (Py_ssize_t)h.compressed,
+        "history_on_disk", (Py_ssize_t)h.on_disk, "history_other", (Py_ssize_t)h.other,
+        "pagerhist", (Py_ssize_t)h.pagerhist, "text_cache", (Py_ssize_t)tc_memory_usage(self->text_cache),
+        "parser", (Py_ssize_t)vt_parser_memory_usage(self->vt_parser),
+        "as_ansi_buf", (Py_ssize_t)(self->as_ansi_buf.capacity * sizeof(self->as_ansi_buf.buf[0])),
+        "images_in_ram", (Py_ssize_t)g.in_ram, "images_on_disk", (Py_ssize_t)g.on_disk,
+        "image_textures", (Py_ssize_t)g.textures, "composed_frames", (Py_ssize_t)g.composed_frames
+    );
 }
 
+static PyObject*
+release_idle_memory(Screen *self, PyObject *a UNUSED) {
+    return PyLong_FromUnsignedLongLong(release_memory_of_idle_screen(self));
+}
+// }}}
+
+// Deferred history rewrap {{{
+// See the comments in resize.c, the rewrapping is done in short steps so that
+// it does not hold up input and rendering.
+
+#define HISTORY_REWRAP_STEP_TIME ms_to_monotonic_t(2ll)
+#define HISTORY_REWRAP_STEP_INTERVAL ms_to_monotonic_t(10ll)
+
+monotonic_t
+screen_rewrap_history_in_background(Screen *self) {
+    // Returns how long to wait before calling this again, negative if there is nothing to do
+    if (!self->historybuf->pending_rewrap) return -1;
+    return historybuf_continue_pending_rewrap(self->historybuf, monotonic() + HISTORY_REWRAP_STEP_TIME) ? HISTORY_REWRAP_STEP_INTERVAL : -1;
+}
 // }}}
 
 // Python interface {{{
@@ -4288,6 +5175,13 @@ as_text_for_history_buf(Screen *self, PyObject *args) {
     return as_text_history_buf(self->historybuf, args, &self->as_ansi_buf);
 }
 
+static PyObject*
+search(Screen *self, PyObject *args) {
+    PyObject *pattern; int regex = 0;
+    if (!PyArg_ParseTuple(args, "U|p", &pattern, &regex)) return NULL;
+    return screen_search(self, pattern, regex);
+}
+
 static PyObject*
 as_text_generic_wrapper(Screen *self, PyObject *args, get_line_func get_line) {
     return as_text_generic(args, self, get_line, self->lines, &self->as_ansi_buf, false);
@@ -4302,6 +5196,132 @@ as_text_alternate(Screen *self, PyObject *args) {
     return ans;
 }
 
+// Scrollback export {{{
+// Writes the same text as as_text(as_ansi=True, add_history=True,
+// add_wrap_markers=True) with the wrap markers turned into newlines, as
+// needed by the scrollback pager, encoding it to UTF-8 straight into a file
+// without creating Python objects for every line.
+
+typedef struct ExportOutput {
+    int fd;
+    char buf[64 * 1024];
+    size_t len;
+    unsigned num_newlines;
+    bool failed;
+} ExportOutput;
+
+static void
+export_flush(ExportOutput *o) {
+    for (size_t pos = 0; pos < o->len && !o->failed;) {
+        const ssize_t n = write(o->fd, o->buf + pos, o->len - pos);
+        if (n < 0) { if (errno != EINTR) o->failed = true; }
+        else pos += n;
+    }
+    o->len = 0;
+}
+
+static void
+export_bytes(ExportOutput *o, const char *data, size_t sz) {
+    while (sz) {
+        if (o->len >= sizeof(o->buf)) export_flush(o);
+        const size_t n = MIN(sz, sizeof(o->buf) - o->len);
+        memcpy(o->buf + o->len, data, n);
+        o->len += n; data += n; sz -= n;
+    }
+}
+
+static void
+export_newline(ExportOutput *o) { export_bytes(o, "\n", 1); o->num_newlines++; }
+
+static void
+export_pagerhist(ExportOutput *o, const uint8_t *data, size_t sz) {
+    // The pager history has \r at the end of every line and \n after that
+    // if the line is not wrapped
+    for (size_t i = 0; i < sz; i++) {
+        const size_t start = i;
+        while (i < sz && data[i] != '\r' && data[i] != '\n') i++;
+        export_bytes(o, (const char*)data + start, i - start);
+        if (i < sz) {
+            export_newline(o);
+            if (data[i] == '\r' && i + 1 < sz && data[i + 1] == '\n') i++;
+        }
+    }
+}
+
+static void
+export_lines(Screen *self, ExportOutput *o, int y, int limit) {
+    ANSIBuf *ansibuf = &self->as_ansi_buf;
+    ANSILineState s = {.output_buf=ansibuf};
+    ansibuf->active_hyperlink_id = 0;
+    char utf8[4];
+    for (; y < limit && !o->failed; y++) {
+        Line *line = range_line_(self, y);
+        ansibuf->len = 0;
+        // reset SGR at the start of every line for less, see as_text_generic()
+        s.prev_gpu_cell = NULL;
+        line_as_ansi(line, &s, 0, line->xnum, 0, true);
+        if (ansibuf->len) export_bytes(o, "\x1b[m", 3);
+        for (size_t i = 0; i < ansibuf->len; i++) export_bytes(o, utf8, encode_utf8(ansibuf->buf[i], utf8));
+        export_newline(o);
+    }
+    if (ansibuf->active_hyperlink_id) {
+        ansibuf->active_hyperlink_id = 0;
+        export_bytes(o, "\x1b]8;;\x1b\\", 7);
+    }
+}
+
+static PyObject*
+export_scrollback(Screen *self, PyObject *fd) {
+    if (!PyLong_Check(fd)) { PyErr_SetString(PyExc_TypeError, "fd must be an integer"); return NULL; }
+    ExportOutput *o = calloc(1, sizeof(ExportOutput));
+    if (!o) return PyErr_NoMemory();
+    o->fd = PyLong_AsLong(fd);
+    if (self->linebuf == self->main_linebuf) {
+        size_t sz;
+        uint8_t *pagerhist = historybuf_pagerhist_as_utf8(self->historybuf, &sz);
+        if (sz && !pagerhist) { free(o); return PyErr_NoMemory(); }
+        export_pagerhist(o, pagerhist, sz);
+        free(pagerhist);
+        historybuf_finish_pending_rewrap(self->historybuf);
+        export_lines(self, o, -(int)self->historybuf->count, 0);
+        if (sz || self->historybuf->count) export_bytes(o, "\x1b[m", 3);
+    }
+    export_lines(self, o, 0, self->lines);
+    export_flush(o);
+    const bool failed = o->failed; const unsigned num_newlines = o->num_newlines;
+    free(o);
+    if (failed) return PyErr_SetFromErrno(PyExc_OSError);
+    return PyLong_FromUnsignedLong(num_newlines);
+}
+
+static PyObject*
+import_scrollback(Screen *self, PyObject *fd_) {
+    // Reads text previously written by export_scrollback() straight into the
+    // input ring and parses it. The ring has a single producer so this must
+    // only be called before the screen is added to the child monitor.
+    if (!PyLong_Check(fd_)) { PyErr_SetString(PyExc_TypeError, "fd must be an integer"); return NULL; }
+    const int fd = PyLong_AsLong(fd_);
+    ParseData pd = {.now=monotonic()};
+    size_t total = 0;
+    while (true) {
+        size_t sz;
+        uint8_t *buf = vt_parser_create_write_buffer(self->vt_parser, &sz);
+        const ssize_t n = read(fd, buf, sz);
+        if (n < 0) {
+            vt_parser_commit_write(self->vt_parser, 0);
+            if (errno == EINTR) continue;
+            return PyErr_SetFromErrno(PyExc_OSError);
+        }
+        vt_parser_commit_write(self->vt_parser, n);
+        if (!n) break;
+        total += n;
+        parse_worker(self, &pd, true);
+    }
+    screen_deliver_coalesced_notifications(self, pd.now, true);
+    return PyLong_FromSize_t(total);
+}
+// }}}
+
 typedef struct OutputOffset {
     Screen *screen;
     int start;
@@ -4317,22 +5337,23 @@ get_line_from_offset(void *x, int y) {
 
 static bool
 find_cmd_output(Screen *self, OutputOffset *oo, index_type start_screen_y, unsigned int scrolled_by, int direction, bool on_screen_only) {
+    if (!on_screen_only) historybuf_finish_pending_rewrap(self->historybuf);
     bool found_prompt = false, found_output = false, found_next_prompt = false;
     int start = 0, end = 0;
     int init_y = start_screen_y - scrolled_by, y1 = init_y, y2 = init_y;
     const int upward_limit = -self->historybuf->count;
     const int downward_limit = self->lines - 1;
     const int screen_limit = -scrolled_by + downward_limit;
-    Line *line = NULL;
+    PromptKind kind;
 
     // find around
     if (direction == 0) {
-        line = checked_range_line(self, y1);
-        if (line && line->attrs.prompt_kind == PROMPT_START) {
+        kind = range_line_prompt_kind(self, y1);
+        if (kind == PROMPT_START) {
             found_prompt = true;
             // change direction to downwards to find command output
             direction = 1;
-        } else if (line && line->attrs.prompt_kind == OUTPUT_START && !range_line_is_continued(self, y1)) {
+        } else if (kind == OUTPUT_START && !range_line_is_continued(self, y1)) {
             found_output = true; start = y1;
             found_prompt = true;
             direction = 1;
@@ -4345,14 +5366,14 @@ find_cmd_output(Screen *self, OutputOffset *oo, index_type start_screen_y, unsig
         // find around: only needs to find the first output start
         // find upwards: find prompt after the output, and the first output
         while (y1 >= upward_limit) {
-            line = checked_range_line(self, y1);
-            if (line && line->attrs.prompt_kind == PROMPT_START && !range_line_is_continued(self, y1)) {
+            kind = range_line_prompt_kind(self, y1);
+            if (kind == PROMPT_START && !range_line_is_continued(self, y1)) {
                 if (direction == 0) {
                     found_prompt = true;
                     break;
                 }
                 found_next_prompt = true; end = y1;
-            } else if (line && line->attrs.prompt_kind == OUTPUT_START && !range_line_is_continued(self, y1)) {
+            } else if (kind == OUTPUT_START && !range_line_is_continued(self, y1)) {
                 found_output = true; start = y1;
                 found_prompt = true;
                 break;
@@ -4370,8 +5391,8 @@ find_cmd_output(Screen *self, OutputOffset *oo, index_type start_screen_y, unsig
     if (direction >= 0) {
         while (y2 <= downward_limit) {
             if (on_screen_only && !found_output && y2 > screen_limit) break;
-            line = checked_range_line(self, y2);
-            if (line && line->attrs.prompt_kind == PROMPT_START) {
+            kind = range_line_prompt_kind(self, y2);
+            if (kind == PROMPT_START) {
                 if (!found_prompt) {
                     if (direction == 0) {
                         found_next_prompt = true; end = y2;
@@ -4387,7 +5408,7 @@ find_cmd_output(Screen *self, OutputOffset *oo, index_type start_screen_y, unsig
                     found_next_prompt = true; end = y2;
                     break;
                 }
-            } else if (line && line->attrs.prompt_kind == OUTPUT_START && !found_output) {
+            } else if (kind == OUTPUT_START && !found_output) {
                 found_output = true; start = y2;
                 if (!found_prompt) found_prompt = true;
             }
@@ -4412,10 +5433,10 @@ erase_last_command(Screen *self, PyObject *args) {
     OutputOffset oo = {.screen=self};
     if (self->linebuf != self->main_linebuf || !find_cmd_output(self, &oo, self->cursor->y + self->scrolled_by, self->scrolled_by, -1, false)) Py_RETURN_FALSE;
     if (include_prompt) {
-        int y = oo.start - 1; Line *line;
-        while ((line = checked_range_line(self, y))) {
-            oo.start--; oo.num_lines++; y--;
-            if (line->attrs.prompt_kind == PROMPT_START) break;
+        int y = oo.start - 1;
+        while (-(int)self->historybuf->count <= y && y < (int)self->lines) {
+            oo.start--; oo.num_lines++;
+            if (range_line_prompt_kind(self, y--) == PROMPT_START) break;
         }
     }
     index_type num_lines_to_erase_in_screen = oo.start >= 0 ? oo.num_lines : oo.num_lines + oo.start;
@@ -4431,6 +5452,14 @@ erase_last_command(Screen *self, PyObject *args) {
     Py_RETURN_TRUE;
 }
 
+static PyObject*
+take_captured_command_output(Screen *self, PyObject *args UNUSED) {
+    PyObject *ans = self->captured_cmd_output ? self->captured_cmd_output : Py_None;
+    if (!self->captured_cmd_output) Py_INCREF(ans);
+    self->captured_cmd_output = NULL;
+    return ans;
+}
+
 static PyObject*
 cmd_output(Screen *self, PyObject *args) {
     unsigned int which = 0;
@@ -4457,16 +5486,15 @@ cmd_output(Screen *self, PyObject *args) {
             } break;
         case 3: { // last non-empty output
             int y = self->cursor->y;
-            Line *line;
             bool reached_upper_limit = false;
             while (!found && !reached_upper_limit) {
-                line = checked_range_line(self, y);
-                if (!line || (line->attrs.prompt_kind == OUTPUT_START && !range_line_is_continued(self, y))) {
-                    int start = line ? y : y + 1; reached_upper_limit = !line;
+                const bool in_range = -(int)self->historybuf->count <= y;
+                if (!in_range || (range_line_prompt_kind(self, y) == OUTPUT_START && !range_line_is_continued(self, y))) {
+                    int start = in_range ? y : y + 1; reached_upper_limit = !in_range;
                     int y2 = start; unsigned int num_lines = 0;
                     bool found_content = false;
-                    while ((line = checked_range_line(self, y2)) && line->attrs.prompt_kind != PROMPT_START) {
-                        if (!found_content) found_content = !line_is_empty(line);
+                    while (y2 < (int)self->lines && range_line_prompt_kind(self, y2) != PROMPT_START) {
+                        if (!found_content) found_content = !line_is_empty(range_line_(self, y2));
                         num_lines++; y2++;
                     }
                     if (found_content) {
@@ -4838,6 +5866,38 @@ text_for_selection(Screen *self, PyObject *args) {
     return text_for_selections(self, &self->selections, ansi, strip_trailing_whitespace);
 }
 
+static PyObject*
+utf8_for_selection(Screen *self, PyObject *args) {
+    int strip_trailing_whitespace = 0;
+    if (!PyArg_ParseTuple(args, "|p", &strip_trailing_whitespace)) return NULL;
+    return utf8_for_selections(self, &self->selections, strip_trailing_whitespace);
+}
+
+static PyObject*
+chars_in_range(Screen *self, PyObject *args) {
+    // The first codepoint of every cell in the lines [start_y, end_y) as a
+    // single two dimensional array, negative y refer to the scrollback. Lets
+    // Python code process many lines without creating objects per line.
+    int start_y, end_y;
+    if (!PyArg_ParseTuple(args, "ii", &start_y, &end_y)) return NULL;
+    start_y = MAX(start_y, -(int)self->historybuf->count); end_y = MIN(end_y, (int)self->lines);
+    const Py_ssize_t num = MAX(0, end_y - start_y);
+    RAII_PyObject(ans, PyBytes_FromStringAndSize(NULL, num * self->columns * sizeof(uint32_t)));
+    if (!ans) return NULL;
+    uint32_t *p = (uint32_t*)PyBytes_AS_STRING(ans);
+    for (int y = start_y; y < end_y; y++, p += self->columns) {
+        Line *line = range_line_(self, y);
+        const index_type xlimit = MIN(line->xnum, self->columns);
+        for (index_type x = 0; x < xlimit; x++) p[x] = cell_first_char(line->cpu_cells + x, self->text_cache);
+        if (xlimit < self->columns) memset(p + xlimit, 0, (self->columns - xlimit) * sizeof(uint32_t));
+    }
+    RAII_PyObject(mv, PyMemoryView_FromObject(ans));
+    if (!mv) return NULL;
+    // shapes cannot have zero sized dimensions
+    if (!num) return PyObject_CallMethod(mv, "cast", "s", "I");
+    return PyObject_CallMethod(mv, "cast", "s(nI)", "I", num, self->columns);
+}
+
 static PyObject*
 text_for_marked_url(Screen *self, PyObject *args) {
     int ansi = 0, strip_trailing_whitespace = 0;
@@ -4923,6 +5983,7 @@ screen_selection_range_for_word(Screen *self, const index_type x, const index_ty
 
 bool
 screen_history_scroll(Screen *self, int amt, bool upwards) {
+    if (upwards) historybuf_finish_pending_rewrap(self->historybuf);
     switch(amt) {
         case SCROLL_LINE:
             amt = 1;
@@ -5026,6 +6087,7 @@ add_url_range(Screen *self, index_type start_x, index_type start_y, index_type e
 
 void
 screen_mark_url(Screen *self, index_type start_x, index_type start_y, index_type end_x, index_type end_y) {
+    self->url_detection.is_valid = false;
     self->url_ranges.count = 0;
     if (start_x || start_y || end_x || end_y) add_url_range(self, start_x, start_y, end_x, end_y, false);
 }
@@ -5075,6 +6137,7 @@ sort_ranges(const Screen *self, Selections *s) {
 
 hyperlink_id_type
 screen_mark_hyperlink(Screen *self, index_type x, index_type y) {
+    self->url_detection.is_valid = false;
     self->url_ranges.count = 0;
     Line *line = screen_visual_line(self, y);
     hyperlink_id_type id = line->cpu_cells[x].hyperlink_id;
@@ -5371,6 +6434,7 @@ send_escape_code_to_child(Screen *self, PyObject *args) {
 
 static void
 screen_mark_all(Screen *self) {
+    historybuf_finish_pending_rewrap(self->historybuf);
     for (index_type y = 0; y < self->main_linebuf->ynum; y++) {
         linebuf_init_line(self->main_linebuf, y);
         mark_text_in_line(self->marker, self->main_linebuf->line, &self->as_ansi_buf);
@@ -5397,8 +6461,8 @@ set_marker(Screen *self, PyObject *args) {
         }
         Py_RETURN_NONE;
     }
-    if (!PyCallable_Check(marker)) {
-        PyErr_SetString(PyExc_TypeError, "marker must be a callable");
+    if (!PyCallable_Check(marker) && !is_native_marker(marker)) {
+        PyErr_SetString(PyExc_TypeError, "marker must be a callable or a TextMarker");
         return NULL;
     }
     self->marker = marker;
@@ -5414,6 +6478,7 @@ scroll_to_next_mark(Screen *self, PyObject *args) {
     unsigned int mark = 0;
     if (!PyArg_ParseTuple(args, "|Ip", &mark, &backwards)) return NULL;
     if (!screen_has_marker(self) || self->linebuf == self->alt_linebuf) Py_RETURN_FALSE;
+    historybuf_finish_pending_rewrap(self->historybuf);
     if (backwards) {
         for (unsigned int y = self->scrolled_by; y < self->historybuf->count; y++) {
             historybuf_init_line(self->historybuf, y, self->historybuf->line);
@@ -5460,6 +6525,67 @@ marked_cells(Screen *self, PyObject *o UNUSED) {
     return Py_NewRef(ans);
 }
 
+typedef struct PasteBuffer {
+    Screen *screen;
+    size_t used;
+    char data[64 * 1024];
+} PasteBuffer;
+
+static void
+paste_buffer_append(PasteBuffer *pb, const char *data, size_t sz) {
+    while (sz) {
+        const size_t n = MIN(sz, sizeof(pb->data) - pb->used);
+        memcpy(pb->data + pb->used, data, n);
+        pb->used += n; data += n; sz -= n;
+        if (pb->used == sizeof(pb->data)) { write_to_child(pb->screen, pb->data, pb->used); pb->used = 0; }
+    }
+}
+
+static void
+paste_with_carriage_returns(Screen *self, const char *data, size_t sz) {
+    // Sends \r\n and \n as \r, as programs that do not support bracketed
+    // paste, such as nano, dont handle newlines in pasted text, see
+    // https://github.com/kovidgoyal/kitty/issues/994
+    const char *p = data, *end = data + sz, *nl = memchr(p, '\n', end - p);
+    if (!nl) { write_to_child(self, data, sz); return; }
+    RAII_ALLOC(PasteBuffer, pb, malloc(sizeof(PasteBuffer)));
+    if (!pb) fatal("Out of memory");
+    pb->screen = self; pb->used = 0;
+    while (nl) {
+        paste_buffer_append(pb, p, nl - p);
+        if (nl == data || nl[-1] != '\r') paste_buffer_append(pb, "\r", 1);
+        p = nl + 1;
+        nl = p < end ? memchr(p, '\n', end - p) : NULL;
+    }
+    paste_buffer_append(pb, p, end - p);
+    if (pb->used) write_to_child(self, pb->data, pb->used);
+}
+
+static size_t
+remove_bracketed_paste_end(char *output, const char *data, size_t sz) {
+    // Removes all occurrences of the end of bracketed paste escape code in a
+    // single pass, including the ones that are formed by removing others.
+    // output must have space for sz bytes. Returns the size of the output.
+    static const char esc_end[] = "\x1b[201~", c1_end[] = "\x9b" "201~";
+    size_t n = 0;
+    for (size_t i = 0; i < sz; i++) {
+        output[n++] = data[i];
+        if (data[i] != '~') continue;
+        if (n >= sizeof(c1_end) - 1 && memcmp(output + n - (sizeof(c1_end) - 1), c1_end, sizeof(c1_end) - 1) == 0) n -= sizeof(c1_end) - 1;
+        else if (n >= sizeof(esc_end) - 1 && memcmp(output + n - (sizeof(esc_end) - 1), esc_end, sizeof(esc_end) - 1) == 0) n -= sizeof(esc_end) - 1;
+    }
+    return n;
+}
+
+static void
+paste_sanitized_for_bracketed_paste(Screen *self, const char *data, size_t sz) {
+    // Ensure the pasted text cannot end bracketed paste mode early
+    if (!find_either_of_two_bytes((const uint8_t*)data, sz, 0x1b, 0x9b)) { write_to_child(self, data, sz); return; }
+    RAII_ALLOC(char, output, malloc(sz));
+    if (!output) fatal("Out of memory");
+    write_to_child(self, output, remove_bracketed_paste_end(output, data, sz));
+}
+
 static PyObject*
 paste_(Screen *self, PyObject *bytes, bool allow_bracketed_paste) {
     const char *data; Py_ssize_t sz;
@@ -5474,9 +6600,12 @@ paste_(Screen *self, PyObject *bytes, bool allow_bracketed_paste) {
     } else {
         PyErr_SetString(PyExc_TypeError, "Must paste() bytes"); return NULL;
     }
-    if (allow_bracketed_paste && self->modes.mBRACKETED_PASTE) write_escape_code_to_child(self, ESC_CSI, BRACKETED_PASTE_START);
-    write_to_child(self, data, sz);
-    if (allow_bracketed_paste && self->modes.mBRACKETED_PASTE) write_escape_code_to_child(self, ESC_CSI, BRACKETED_PASTE_END);
+    if (!allow_bracketed_paste) write_to_child(self, data, sz);
+    else if (self->modes.mBRACKETED_PASTE) {
+        write_escape_code_to_child(self, ESC_CSI, BRACKETED_PASTE_START);
+        paste_sanitized_for_bracketed_paste(self, data, sz);
+        write_escape_code_to_child(self, ESC_CSI, BRACKETED_PASTE_END);
+    } else paste_with_carriage_returns(self, data, sz);
     Py_RETURN_NONE;
 }
 
@@ -5619,6 +6748,7 @@ static PyObject*
 dump_lines_with_attrs(Screen *self, PyObject *args) {
     PyObject *accum; int which_screen = -1;
     if (!PyArg_ParseTuple(args, "O|i", &accum, &which_screen)) return NULL;
+    historybuf_finish_pending_rewrap(self->historybuf);
     LineBuf *orig = self->linebuf;
     switch(which_screen) {
         case 0: self->linebuf = self->main_linebuf; break;
@@ -5682,9 +6812,16 @@ test_parse_written_data(Screen *screen, PyObject *args) {
     if (!PyArg_ParseTuple(args, "|O", &pd.dump_callback)) return NULL;
     if (pd.dump_callback && pd.dump_callback != Py_None) parse_worker_dump(screen, &pd, true);
     else parse_worker(screen, &pd, true);
+    screen_deliver_coalesced_notifications(screen, pd.now, true);
     Py_RETURN_NONE;
 }
 
+static PyObject*
+test_finish_background_image_decodes(Screen *screen, PyObject *args UNUSED) {
+    if (screen_finish_background_image_decodes(screen, true)) Py_RETURN_TRUE;
+    Py_RETURN_FALSE;
+}
+
 static PyObject*
 multicell_data_as_dict(CPUCell mcd) {
     return Py_BuildValue("{sI sI sI sI sO sI sI}",
@@ -5753,6 +6890,7 @@ static PyMethodDef methods[] = {
     METHODB(test_create_write_buffer, METH_NOARGS),
     METHODB(test_commit_write_buffer, METH_VARARGS),
     METHODB(test_parse_written_data, METH_VARARGS),
+    METHODB(test_finish_background_image_decodes, METH_NOARGS),
     MND(line_edge_colors, METH_NOARGS)
     MND(line, METH_O)
     MND(dump_lines_with_attrs, METH_VARARGS)
@@ -5764,6 +6902,7 @@ static PyMethodDef methods[] = {
     MND(apply_sgr, METH_O)
     MND(cursor_position, METH_VARARGS)
     MND(erase_last_command, METH_VARARGS)
+    MND(take_captured_command_output, METH_NOARGS)
     MND(set_window_char, METH_VARARGS)
     MND(set_mode, METH_VARARGS)
     MND(reset_mode, METH_VARARGS)
@@ -5778,6 +6917,9 @@ static PyMethodDef methods[] = {
     MND(scroll_until_cursor_prompt, METH_VARARGS)
     MND(hyperlinks_as_set, METH_NOARGS)
     MND(garbage_collect_hyperlink_pool, METH_NOARGS)
+    MND(compact_text_cache, METH_NOARGS)
+    MND(release_idle_memory, METH_NOARGS)
+    MND(memory_usage, METH_NOARGS)
     MND(hyperlink_for_id, METH_O)
     MND(reverse_scroll, METH_VARARGS)
     MND(scroll_prompt_to_bottom, METH_NOARGS)
@@ -5800,6 +6942,9 @@ static PyMethodDef methods[] = {
     MND(as_text_non_visual, METH_VARARGS)
     MND(as_text_for_history_buf, METH_VARARGS)
     MND(as_text_alternate, METH_VARARGS)
+    MND(export_scrollback, METH_O)
+    MND(import_scrollback, METH_O)
+    MND(search, METH_VARARGS)
     MND(cmd_output, METH_VARARGS)
     MND(tab, METH_NOARGS)
     MND(backspace, METH_NOARGS)
@@ -5820,6 +6965,10 @@ static PyMethodDef methods[] = {
     MND(rescale_images, METH_NOARGS)
     MND(current_key_encoding_flags, METH_NOARGS)
     MND(text_for_selection, METH_VARARGS)
+    MND(utf8_for_selection, METH_VARARGS)
+    MND(chars_in_range, METH_VARARGS)
+    MND(predict_echo, METH_O)
+    MND(predicted_echo, METH_NOARGS)
     MND(text_for_marked_url, METH_VARARGS)
     MND(is_rectangle_select, METH_NOARGS)
     MND(scroll, METH_VARARGS)
@@ -5884,6 +7033,8 @@ static PyMemberDef members[] = {
     {"margin_top", T_UINT, offsetof(Screen, margin_top), READONLY, "margin_top"},
     {"margin_bottom", T_UINT, offsetof(Screen, margin_bottom), READONLY, "margin_bottom"},
     {"history_line_added_count", T_UINT, offsetof(Screen, history_line_added_count), 0, "history_line_added_count"},
+    {"predictive_echo", T_BOOL, offsetof(Screen, predicted_echo.enabled), 0, "Draw printable characters typed at a shell prompt before they are echoed by the child"},
+    {"idle_memory_released", T_ULONGLONG, offsetof(Screen, idle_memory.released), READONLY, "The number of bytes released since the screen became idle"},
     {NULL}
 };
 
@@ -11,6 +11,7 @@
 #include "monotonic.h"
 #include "line-buf.h"
 #include "history.h"
+#include "cmd-capture.h"
 
 typedef enum ScrollTypes { SCROLL_LINE = -999999, SCROLL_PAGE, SCROLL_FULL } ScrollType;
 
@@ -77,6 +78,8 @@ typedef struct {
     index_type xstart, ynum, xnum, cursor_x, text_len;
     bool is_active;
     bool is_dirty;
+    // the overlay shows predicted echo rather than IME pre-edit text
+    bool is_predicted_echo;
     struct {
         CPUCell *cpu_cells;
         GPUCell *gpu_cells;
@@ -107,6 +110,15 @@ typedef struct {
     double pending_scroll_pixels_x, pending_scroll_pixels_y;
     CellPixelSize cell_size;
     OverlayLine overlay_line;
+    struct {
+        // Printable characters typed at a shell prompt that the child has not
+        // echoed yet, drawn speculatively in the overlay line, see screen_predict_echo()
+        bool enabled;
+        char_type chars[64];
+        unsigned count;
+        index_type x, y;
+        monotonic_t confirmed_at;
+    } predicted_echo;
     id_type window_id;
     Selections selections, url_ranges;
     struct {
@@ -115,13 +127,57 @@ typedef struct {
         color_type cursor_bg;
         CursorRenderInfo cursor;
     } last_rendered;
+    struct {
+        // A copy of the cell data most recently sent to the GPU, used to
+        // upload only the rows that have actually changed. Every row records
+        // the generation at which it last changed.
+        GPUCell *cells;
+        uint64_t *row_generations, generation, uploaded_generation;
+        index_type lines, columns;
+        // The number of rows by which the rows already on the GPU must be
+        // moved down (up if negative) before uploading, set when the view is
+        // scrolled
+        int rows_moved_by;
+    } gpu_cell_data;
+    struct {
+        // The uniform data most recently sent to the GPU when rendering the
+        // cells of this screen, see cell_update_uniform_block()
+        uint32_t data[48];
+        bool is_valid;
+    } gpu_render_data;
+    struct {
+        // A copy of the selection data most recently sent to the GPU, used to
+        // recompute only the rows whose selected range changed when only the
+        // primary selection has changed, as happens while drag selecting.
+        uint8_t *data;
+        index_type lines, columns;
+        unsigned int scrolled_by;
+        uint64_t cell_generation;
+        IterationData primary;
+        bool is_valid;
+    } gpu_selection_data;
     bool is_dirty, scroll_changed, reload_all_gpu_data, sgr_blink_was_used;
     Cursor *cursor;
     Savepoint main_savepoint, alt_savepoint;
     PyObject *callbacks, *test_child;
     TextCache *text_cache;
+    struct {
+        monotonic_t activity_at;
+        index_type next_segment;
+    } text_cache_compaction;
+    struct {
+        monotonic_t released_at;
+        unsigned long long released;
+    } idle_memory;
     LineBuf *linebuf, *main_linebuf, *alt_linebuf;
     GraphicsManager *grman, *main_grman, *alt_grman;
+    struct {
+        // The history lines in [first, last) whose unicode placeholders were
+        // converted to cell images when grman had this placements generation
+        const GraphicsManager *grman;
+        uint64_t generation;
+        index_type first, last;
+    } placeholders_scanned;
     HistoryBuf *historybuf;
     unsigned int history_line_added_count;
     bool *tabstops, *main_tabstops, *alt_tabstops;
@@ -129,8 +185,10 @@ typedef struct {
     ColorProfile *color_profile;
     monotonic_t start_visual_bell_at;
 
+    // The data waiting to be written to the child is from write_buf_start to
+    // write_buf_used, both are zero when there is nothing to write
     uint8_t *write_buf;
-    size_t write_buf_sz, write_buf_used;
+    size_t write_buf_sz, write_buf_used, write_buf_start;
     pthread_mutex_t write_buf_lock;
 
     CursorRenderInfo cursor_render_info;
@@ -139,6 +197,11 @@ typedef struct {
     PyObject *marker;
     bool has_focus;
     bool has_activity_since_last_focus;
+    // Set while input for this screen is parsed on a thread other than the
+    // main thread, which does not hold the GIL, work that needs Python is
+    // deferred until screen_finish_off_main_thread_parse() is called
+    bool parsing_off_main_thread;
+    struct { bool activity, predicted_echo; } deferred_to_main_thread;
     hyperlink_id_type active_hyperlink_id;
     HYPERLINK_POOL_HANDLE hyperlink_pool;
     ANSIBuf as_ansi_buf;
@@ -167,10 +230,50 @@ typedef struct {
         bool is_set;
     } last_visited_prompt;
     PyObject *last_reported_cwd;
+    // the output of the currently running command, see cmd-capture.h
+    CommandCapture *cmd_capture;
+    // the output of the most recently finished command, until taken by python
+    PyObject *captured_cmd_output;
+    // Title changes and progress reports are delivered to python at most once
+    // per repaint_delay, with only the latest value of a burst being delivered
+    struct {
+        PyObject *pending;
+        monotonic_t delivered_at;
+    } coalesced_title, coalesced_progress;
+    // Bells and desktop notifications are rate limited the same way so that a
+    // program spamming them cannot slow down parsing of its own output. Bells
+    // in a burst collapse into one, notifications are queued, dropping
+    // repeats and anything beyond MAX_QUEUED_NOTIFICATIONS.
+    struct {
+        bool pending;
+        monotonic_t delivered_at;
+    } coalesced_bell;
+    struct {
+        PyObject *queue;
+        monotonic_t delivered_at;
+    } queued_notifications;
     struct {
         hyperlink_id_type id;
         index_type x, y;
     } current_hyperlink_under_mouse;
+    struct {
+        // The result of the most recent URL detection, re-used while the
+        // mouse moves within a cell, until the screen contents change
+        index_type x, y;
+        unsigned int scrolled_by;
+        uint64_t generation;
+        int result;
+        bool is_valid;
+        // For every visual line, whether it contains :// and so can have a
+        // URL starting in it, 0 if not yet known. Valid while the screen
+        // contents at index_generation are unchanged.
+        struct {
+            uint8_t *lines;
+            index_type num_lines;
+            unsigned int scrolled_by;
+            uint64_t generation;
+        } index;
+    } url_detection;
     struct {
         uint8_t stack[16], count;
     } main_pointer_shape_stack, alternate_pointer_shape_stack;
@@ -179,7 +282,7 @@ typedef struct {
         monotonic_t expires_at;
         Cursor cursor;
         ColorProfile color_profile;
-        bool inverted, cell_data_updated, cursor_visible;
+        bool inverted, cell_data_updated, cursor_visible, cells_on_gpu;
         unsigned int scrolled_by;
         LineBuf *linebuf;
         GraphicsManager *grman;
@@ -190,6 +293,17 @@ typedef struct {
     ListOfChars *lc;
     monotonic_t parsing_at;
     ExtraCursors extra_cursors;
+    // timestamps for the key press whose echo is waiting to be presented, used
+    // to measure keystroke to photon latency
+    struct { monotonic_t key_at, sent_at, parsed_at, rendered_at; } input_latency;
+    // Responses to graphics commands that arrived while an earlier image was
+    // being decoded in the background. They are held until the decodes started
+    // before them have finished, so that the client receives responses in the
+    // order it sent the commands.
+    struct {
+        struct QueuedGraphicsResponse { uint64_t after_decode; char *response; } *items;
+        size_t count, capacity;
+    } queued_graphics_responses;
 } Screen;
 
 
@@ -262,10 +376,11 @@ void select_graphic_rendition(Screen *self, int *params, unsigned int count, boo
 void report_device_status(Screen *self, unsigned int which, bool UNUSED);
 void report_mode_status(Screen *self, unsigned int which, bool);
 void screen_apply_selection(Screen *self, void *address, size_t size);
+void screen_update_selection_render_data(Screen *self, void *address, size_t size, bool reload_all);
 bool screen_is_selection_dirty(Screen *self);
 bool screen_has_selection(Screen*);
 bool screen_invert_colors(Screen *self);
-void screen_update_cell_data(Screen *self, void *address, FONTS_DATA_HANDLE, bool cursor_has_moved);
+void screen_update_cell_data(Screen *self, FONTS_DATA_HANDLE, bool cursor_has_moved, bool can_move_gpu_rows);
 bool screen_is_cursor_visible(const Screen *self);
 unsigned screen_multi_cursor_count(const Screen *self);
 bool screen_selection_range_for_line(Screen *self, index_type y, index_type *start, index_type *end);
@@ -282,6 +397,7 @@ void screen_mark_url(Screen *self, index_type start_x, index_type start_y, index
 void set_active_hyperlink(Screen*, char*, char*);
 hyperlink_id_type screen_mark_hyperlink(Screen*, index_type, index_type);
 void screen_handle_graphics_command(Screen *self, const GraphicsCommand *cmd, const uint8_t *payload);
+bool screen_finish_background_image_decodes(Screen *self, bool wait);
 void screen_handle_multicell_command(Screen *self, const MultiCellCommand *cmd, const uint8_t *payload);
 bool screen_open_url(Screen*);
 bool screen_set_last_visited_prompt(Screen*, index_type);
@@ -292,6 +408,10 @@ void screen_report_size(Screen *, unsigned int which);
 void screen_manipulate_title_stack(Screen *, unsigned int op, unsigned int which);
 bool screen_is_overlay_active(Screen *self);
 void screen_update_overlay_text(Screen *self, const char *utf8_text);
+void screen_predict_echo(Screen *self, const char *text);
+void screen_clear_predicted_echo(Screen *self);
+void screen_finish_off_main_thread_parse(Screen *self);
+monotonic_t screen_expire_predicted_echo(Screen *self, monotonic_t now);
 void screen_set_key_encoding_flags(Screen *self, uint32_t val, uint32_t how);
 void screen_push_key_encoding_flags(Screen *self, uint32_t val);
 void screen_pop_key_encoding_flags(Screen *self, uint32_t num);
@@ -306,6 +426,13 @@ bool screen_send_signal_for_key(Screen *, char key);
 bool get_line_edge_colors(Screen *self, color_type *left, color_type *right);
 bool parse_sgr(Screen *screen, const uint8_t *buf, unsigned int num, const char *report_name, bool is_deccara);
 bool screen_pause_rendering(Screen *self, bool pause, int for_in_ms);
+monotonic_t screen_compact_text_cache_when_idle(Screen *self, monotonic_t now);
+void screen_abort_text_cache_compaction(Screen *self, monotonic_t now);
+monotonic_t screen_release_memory_when_idle(Screen *self, monotonic_t now);
+monotonic_t screen_garbage_collect_hyperlinks_when_idle(Screen *self, monotonic_t now);
+monotonic_t screen_rewrap_history_in_background(Screen *self);
+monotonic_t screen_deliver_coalesced_notifications(Screen *self, monotonic_t now, bool force);
+PyObject* screen_search(Screen *self, PyObject *pattern, bool regex);
 void screen_check_pause_rendering(Screen *self, monotonic_t now);
 void screen_designate_charset(Screen *self, uint32_t which, uint32_t as);
 void screen_multi_cursor(Screen *self, int queried_shape, int *params, unsigned num_params);
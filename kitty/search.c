@@ -0,0 +1,283 @@
+/*
+ * search.c
+ * Copyright (C) 2025 Kovid Goyal <kovid at kovidgoyal.net>
+ *
+ * Distributed under terms of the GPL3 license.
+ */
+
+#include "search.h"
+#include "screen.h"
+#include "resize.h"
+#include "lineops.h"
+#include "charsets.h"
+#include <regex.h>
+
+// Searching is done in the logical lines of the scrollback and screen, i.e.
+// runs of lines joined by wrapping, so that matches can span wrapped lines.
+// Every cell is one character, see search_char_for_cell(). Plain text
+// searches use the search index of the history buffer segments to skip the
+// ones that cannot contain a match, regular expressions are POSIX extended
+// regular expressions matched against the UTF-8 encoded text of every line.
+
+void
+search_index_add_line(uint64_t *index, const Line *line, const Line *prev_line) {
+    // the last two characters seen, the most recent one last
+    char_type seen[2] = {0};
+    unsigned have = 0;
+    if (prev_line) {
+        for (index_type x = prev_line->xnum; x-- > 0 && have < 2;) {
+            const char_type ch = search_char_for_cell(prev_line->cpu_cells + x, prev_line->text_cache);
+            if (ch) seen[1 - have++] = ch;
+        }
+    }
+    for (index_type x = 0; x < line->xnum; x++) {
+        const char_type ch = search_char_for_cell(line->cpu_cells + x, line->text_cache);
+        if (!ch) continue;
+        if (have >= 2) {
+            const uint32_t h = search_trigram_hash(seen[0], seen[1], ch);
+            index[h / 64] |= 1ull << (h % 64);
+        } else have++;
+        seen[0] = seen[1]; seen[1] = ch;
+    }
+}
+
+typedef struct SearchChar {
+    char_type ch;
+    int y;
+    index_type x, x_limit;
+} SearchChar;
+
+typedef struct Search {
+    HistoryBuf *hb;
+    LineBuf *lb;
+    HistoryBufReader reader;
+    int first_y;
+    struct { SearchChar *items; size_t count, capacity; } text;
+    struct { index_type items[8]; unsigned count; bool overflow; } segments_of_line;
+    // plain text
+    const char_type *pattern;
+    size_t pattern_len;
+    uint32_t *trigrams;
+    size_t num_trigrams;
+    // 0 not checked yet, 1 may match, 2 does not match
+    uint8_t *segment_state;
+    // regex
+    regex_t re;
+    bool has_re;
+    struct { char *items; size_t count, capacity; } utf8;
+    struct { size_t *items; size_t count, capacity; } utf8_to_text;
+    PyObject *ans;
+} Search;
+
+static void
+free_search(Search *s) {
+    historybuf_reader_free(&s->reader);
+    free(s->text.items); free(s->trigrams); free(s->segment_state);
+    free(s->utf8.items); free(s->utf8_to_text.items);
+    if (s->has_re) regfree(&s->re);
+}
+
+static void
+init_line_for_search(Search *s, int y, Line *l) {
+    // y is negative for lines in the history, as for range_line_() in screen.c
+    if (y < 0) {
+        l->xnum = s->hb->xnum; l->text_cache = s->hb->text_cache;
+        historybuf_reader_init_line(&s->reader, -(y + 1), l);
+    } else {
+        l->text_cache = s->lb->text_cache;
+        linebuf_init_line_at(s->lb, y, l);
+    }
+}
+
+static bool
+line_is_continued(const Line *l) { return l->cpu_cells[l->xnum - 1].next_char_was_wrapped; }
+
+static bool
+index_has_trigrams(const Search *s, const uint64_t **indices, unsigned num) {
+    for (size_t i = 0; i < s->num_trigrams; i++) {
+        const uint32_t h = s->trigrams[i];
+        bool found = false;
+        for (unsigned n = 0; n < num && !found; n++) found = indices[n][h / 64] & (1ull << (h % 64));
+        if (!found) return false;
+    }
+    return true;
+}
+
+static bool
+segment_may_match(Search *s, index_type seg_num) {
+    if (!s->segment_state[seg_num]) {
+        const uint64_t *index = historybuf_search_index(s->hb, seg_num, &s->reader);
+        s->segment_state[seg_num] = !index || index_has_trigrams(s, &index, 1) ? 1 : 2;
+    }
+    return s->segment_state[seg_num] == 1;
+}
+
+static bool
+logical_line_may_match(Search *s, bool has_screen_lines) {
+    if (!s->num_trigrams || has_screen_lines || s->segments_of_line.overflow) return true;
+    if (s->segments_of_line.count == 1) return segment_may_match(s, s->segments_of_line.items[0]);
+    // the trigrams of a line that crosses a segment boundary are split between the segments
+    const uint64_t *indices[arraysz(s->segments_of_line.items)];
+    for (unsigned i = 0; i < s->segments_of_line.count; i++) {
+        if (!(indices[i] = historybuf_search_index(s->hb, s->segments_of_line.items[i], &s->reader))) return true;
+    }
+    return index_has_trigrams(s, indices, s->segments_of_line.count);
+}
+
+static bool
+add_match(Search *s, size_t first, size_t last) {
+    const SearchChar *a = s->text.items + first, *b = s->text.items + last;
+    PyObject *m = Py_BuildValue("iIiI", a->y, a->x, b->y, b->x_limit - 1);
+    if (!m) return false;
+    const int ret = PyList_Append(s->ans, m);
+    Py_DECREF(m);
+    return ret == 0;
+}
+
+static bool
+find_text(Search *s) {
+    const size_t n = s->text.count, m = s->pattern_len;
+    const SearchChar *t = s->text.items;
+    for (size_t i = 0; i + m <= n;) {
+        if (t[i].ch == s->pattern[0]) {
+            size_t j = 1;
+            while (j < m && t[i + j].ch == s->pattern[j]) j++;
+            if (j == m) {
+                if (!add_match(s, i, i + m - 1)) return false;
+                i += m;
+                continue;
+            }
+        }
+        i++;
+    }
+    return true;
+}
+
+static bool
+find_regex(Search *s) {
+    s->utf8.count = 0; s->utf8_to_text.count = 0;
+    ensure_space_for(&s->utf8, items, char, 4 * s->text.count + 1, capacity, 4096, false);
+    ensure_space_for(&s->utf8_to_text, items, size_t, 4 * s->text.count + 1, capacity, 4096, false);
+    for (size_t i = 0; i < s->text.count; i++) {
+        const unsigned num = encode_utf8(s->text.items[i].ch, s->utf8.items + s->utf8.count);
+        for (unsigned k = 0; k < num; k++) s->utf8_to_text.items[s->utf8.count++] = i;
+    }
+    s->utf8.items[s->utf8.count] = 0;
+    regmatch_t match;
+    for (size_t pos = 0; pos <= s->utf8.count;) {
+        if (regexec(&s->re, s->utf8.items + pos, 1, &match, pos ? REG_NOTBOL : 0) != 0) break;
+        const size_t start = pos + match.rm_so, end = pos + match.rm_eo;
+        if (end > start) {
+            if (!add_match(s, s->utf8_to_text.items[start], s->utf8_to_text.items[end - 1])) return false;
+            pos = end;
+        } else {
+            // empty match, move on to the next character
+            if (start >= s->utf8.count) break;
+            pos = start + 1;
+            while (pos < s->utf8.count && (s->utf8.items[pos] & 0xc0) == 0x80) pos++;
+        }
+    }
+    return true;
+}
+
+static void
+add_text_of_line(Search *s, const Line *l, int y) {
+    ensure_space_for(&s->text, items, SearchChar, s->text.count + l->xnum, capacity, 1024, false);
+    for (index_type x = 0; x < l->xnum; x++) {
+        const CPUCell *c = l->cpu_cells + x;
+        const char_type ch = search_char_for_cell(c, l->text_cache);
+        if (!ch) continue;
+        s->text.items[s->text.count++] = (SearchChar){.ch=ch, .y=y, .x=x, .x_limit=x + (c->is_multicell ? mcd_x_limit(c) : 1)};
+    }
+}
+
+static int
+search_logical_line(Search *s, int y, bool *ok) {
+    // Returns the first line after the logical line starting at y
+    const int limit = s->lb->ynum;
+    s->text.count = 0; s->segments_of_line.count = 0; s->segments_of_line.overflow = false;
+    bool has_screen_lines = false, continued;
+    Line l = {0};
+    do {
+        init_line_for_search(s, y, &l);
+        if (y < 0) {
+            index_type seg_num;
+            historybuf_segment_run(s->hb, -(y + 1), &seg_num);
+            unsigned *count = &s->segments_of_line.count;
+            if (!*count || s->segments_of_line.items[*count - 1] != seg_num) {
+                if (*count < arraysz(s->segments_of_line.items)) s->segments_of_line.items[(*count)++] = seg_num;
+                else s->segments_of_line.overflow = true;
+            }
+        } else has_screen_lines = true;
+        add_text_of_line(s, &l, y);
+        continued = line_is_continued(&l);
+        y++;
+    } while (continued && y < limit);
+    // trailing blanks are not part of the text of a line
+    while (s->text.count && s->text.items[s->text.count - 1].ch == ' ') s->text.count--;
+    if (logical_line_may_match(s, has_screen_lines)) *ok = s->has_re ? find_regex(s) : find_text(s);
+    return y;
+}
+
+static int
+skip_segments_without_match(Search *s, int y) {
+    // y is the start of a logical line in the history. Returns the start of
+    // the next logical line that might have a match.
+    Line l = {0};
+    while (y < 0) {
+        index_type seg_num;
+        const int next = y + (int)historybuf_segment_run(s->hb, -(y + 1), &seg_num);
+        if (segment_may_match(s, seg_num)) return y;
+        // go back to the start of a logical line that continues into the next segment
+        int start = next;
+        while (start > y) {
+            init_line_for_search(s, start - 1, &l);
+            if (!line_is_continued(&l)) break;
+            start--;
+        }
+        if (start < next) return start;
+        y = next;
+    }
+    return y;
+}
+
+PyObject*
+screen_search(Screen *self, PyObject *pattern, bool regex) {
+    const bool has_history = self->linebuf == self->main_linebuf;
+    if (has_history) historybuf_finish_pending_rewrap(self->historybuf);
+    Search s = {.hb=self->historybuf, .lb=self->linebuf, .first_y=has_history ? -(int)self->historybuf->count : 0};
+    RAII_PyObject(ans, PyList_New(0)); s.ans = ans;
+    if (!ans) return NULL;
+    if (regex) {
+        const char *utf8 = PyUnicode_AsUTF8(pattern);
+        if (!utf8) return NULL;
+        int ret = regcomp(&s.re, utf8, REG_EXTENDED);
+        if (ret != 0) {
+            char err[256];
+            regerror(ret, &s.re, err, sizeof(err));
+            PyErr_Format(PyExc_ValueError, "Invalid regular expression: %s", err);
+            return NULL;
+        }
+        s.has_re = true;
+    } else {
+        s.pattern_len = PyUnicode_GET_LENGTH(pattern);
+        if (!s.pattern_len) { Py_INCREF(ans); return ans; }
+        s.pattern = (const char_type*)PyUnicode_AsUCS4Copy(pattern);
+        if (!s.pattern) return NULL;
+        if (s.pattern_len > 2 && !(s.trigrams = malloc((s.pattern_len - 2) * sizeof(s.trigrams[0])))) { PyMem_Free((void*)s.pattern); return PyErr_NoMemory(); }
+        for (size_t i = 0; i + 2 < s.pattern_len; i++) s.trigrams[s.num_trigrams++] = search_trigram_hash(s.pattern[i], s.pattern[i+1], s.pattern[i+2]);
+    }
+    bool ok = true;
+    if (!(s.segment_state = calloc(s.hb->num_segments, sizeof(s.segment_state[0]))) || !historybuf_reader_init(&s.reader, s.hb)) {
+        PyErr_NoMemory(); ok = false;
+    }
+    for (int y = s.first_y; ok && y < (int)s.lb->ynum;) {
+        if (y < 0 && s.num_trigrams) y = skip_segments_without_match(&s, y);
+        y = search_logical_line(&s, y, &ok);
+    }
+    PyMem_Free((void*)s.pattern);
+    free_search(&s);
+    if (!ok) return NULL;
+    Py_INCREF(ans);
+    return ans;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2025 Kovid Goyal <kovid at kovidgoyal.net>
+ *
+ * Distributed under terms of the GPL3 license.
+ */
+
+#pragma once
+
+#include "line.h"
+
+// The search index of a history buffer segment is a bloom filter of the
+// trigrams in the text of its lines, including the trigrams that span the
+// end of a line that is continued onto the next one. It is used to skip
+// segments that cannot contain a match. Lines can be added to it but not
+// removed, when the lines of a segment are overwritten it is rebuilt.
+
+#define SEARCH_INDEX_BITS (1u << 16)
+#define SEARCH_INDEX_WORDS (SEARCH_INDEX_BITS / 64u)
+
+static inline uint32_t
+search_trigram_hash(char_type a, char_type b, char_type c) {
+    uint32_t h = a * 0x9E3779B1u ^ b * 0x85EBCA77u ^ c * 0xC2B2AE3Du;
+    h ^= h >> 15;
+    return h & (SEARCH_INDEX_BITS - 1);
+}
+
+static inline char_type
+search_char_for_cell(const CPUCell *c, const TextCache *tc) {
+    // Every cell is searched as its first character, the cells covered by a
+    // multicell character other than its first one are skipped and have 0
+    if (c->is_multicell && (c->x || c->y)) return 0;
+    char_type ch = cell_first_char(c, tc);
+    return ch ? ch : ' ';
+}
+
+// prev_line must be the line before line if it is continued onto line, else NULL
+void search_index_add_line(uint64_t *index, const Line *line, const Line *prev_line);
@@ -43,7 +43,7 @@ class WindowSpec:
 
     def __init__(
         self, launch_spec: Union['LaunchSpec', 'SpecialWindowInstance'], serialized_id: int = 0,
-        run_command_at_shell_startup: Sequence[str] | str = ()
+        run_command_at_shell_startup: Sequence[str] | str = (), restore_scrollback_from: str = '',
 ):
         self.launch_spec = launch_spec
         self.resize_spec: ResizeSpec | None = None
@@ -51,6 +51,7 @@ def __init__(
         self.is_background_process = False
         self.serialized_id = serialized_id
         self.run_command_at_shell_startup = run_command_at_shell_startup
+        self.restore_scrollback_from = restore_scrollback_from
         if hasattr(launch_spec, 'opts'):  # LaunchSpec
             from .launch import LaunchSpec
             assert isinstance(launch_spec, LaunchSpec)
@@ -144,7 +145,8 @@ def add_window(self, cmd: None | str | list[str], expand: Callable[[str], str] =
         spec.opts.cwd = spec.opts.cwd or t.cwd
         t.windows.append(WindowSpec(
             spec, serialized_id=serialize_data['id'],
-            run_command_at_shell_startup=serialize_data.get('cmd_at_shell_startup', ())))
+            run_command_at_shell_startup=serialize_data.get('cmd_at_shell_startup', ()),
+            restore_scrollback_from=serialize_data.get('scrollback', '')))
         t.next_title = None
         if t.pending_resize_spec is not None:
             t.windows[-1].resize_spec = t.pending_resize_spec
@@ -584,6 +586,14 @@ def save_as_session_options() -> str:
 directory is moved elsewhere.
 
 
+--save-scrollback
+type=bool-set
+Also save the contents of the screen and scrollback of every window, so that they are shown again
+when the session is used. The contents are saved as formatted text in a directory named after the
+session file with the :file:`.scrollback` extension added. Note that they are only a record of the
+previous output, the programs that produced them are not restored.
+
+
 --match
 If specified, only save all windows (and their parent tabs/OS Windows) that match the specified
 search expression. See :ref:`search_syntax` for details on the search language. In particular if
@@ -592,11 +602,25 @@ def save_as_session_options() -> str:
 '''
 
 
+def scrollback_dir_for_session(session_path: str) -> str:
+    return session_path + '.scrollback'
+
+
+def clear_saved_scrollback(session_path: str) -> None:
+    d = scrollback_dir_for_session(session_path)
+    with suppress(FileNotFoundError):
+        for x in os.listdir(d):
+            if x.endswith('.ansi'):
+                os.remove(os.path.join(d, x))
+
+
 def save_as_session_part2(boss: BossType, opts: SaveAsSessionOptions, path: str) -> None:
     if not path:
         return
     from .config import atomic_save
     path = os.path.abspath(os.path.expanduser(path))
+    if opts.save_scrollback:
+        clear_saved_scrollback(path)
     session = '\n'.join(boss.serialize_state_as_session(path, opts))
     os.makedirs(os.path.dirname(path), exist_ok=True)
     atomic_save(session.encode(), path)
@@ -25,7 +25,7 @@ enum {
     ROUNDED_RECT_PROGRAM,
     NUM_PROGRAMS
 };
-enum { SPRITE_MAP_UNIT, GRAPHICS_UNIT, SPRITE_DECORATIONS_MAP_UNIT };
+enum { SPRITE_MAP_UNIT, GRAPHICS_UNIT, SPRITE_DECORATIONS_MAP_UNIT, COLORED_SPRITE_MAP_UNIT };
 
 typedef struct UIRenderData {
     unsigned screen_width, screen_height, cell_width, cell_height, screen_left, screen_top, full_framebuffer_width, full_framebuffer_height;
@@ -38,18 +38,44 @@ typedef struct UIRenderData {
 } UIRenderData;
 
 // Sprites {{{
+// The entry in the decorations map for every sprite
+typedef struct {
+    sprite_index decorations_idx;
+    sprite_index colored_idx;  // the position in the texture of colored sprites, only set for colored sprites
+} SpriteMapEntry;
+
 typedef struct {
     int xnum, ynum, x, y, z, last_num_of_layers, last_ynum;
+    // Almost all sprites are alpha masks so this texture has a single
+    // channel. It has the alpha of every sprite including colored ones,
+    // whose colors are in the colored texture.
     GLuint texture_id;
     GLint max_texture_size, max_array_texture_layers;
+    struct {
+        GLuint texture_id;
+        int last_num_of_layers, last_ynum;
+    } colored;
     struct decorations_map {
         GLuint texture_id;
         unsigned width, height;
         size_t count;
     } decorations_map;
+    // Sprites are uploaded to the GPU in batches, see flush_pending_sprites()
+    struct {
+        sprite_index first; unsigned count, capacity, rows_capacity;
+        unsigned stride;  // in pixels, the width of a full row of sprites
+        uint8_t *buf;  // rows of sprite alpha masks laid out as in the texture, starting with the row of first
+        SpriteMapEntry *decorations;
+        GLuint pbo;  // the pixel unpack buffer the sprites are uploaded from
+        struct {
+            pixel *buf;  // the colored sprites one after the other
+            sprite_index *indices;
+            unsigned count, capacity;
+        } colored;
+    } pending;
 } SpriteMap;
 
-static const SpriteMap NEW_SPRITE_MAP = { .xnum = 1, .ynum = 1, .last_num_of_layers = 1, .last_ynum = -1 };
+static const SpriteMap NEW_SPRITE_MAP = { .xnum = 1, .ynum = 1, .last_num_of_layers = 1, .last_ynum = -1, .colored = {.last_num_of_layers = 1, .last_ynum = -1} };
 static GLint max_texture_size = 0, max_array_texture_layers = 0;
 
 static GLfloat
@@ -103,7 +129,11 @@ free_sprite_data(FONTS_DATA_HANDLE fg) {
     SpriteMap *sprite_map = (SpriteMap*)fg->sprite_map;
     if (sprite_map) {
         if (sprite_map->texture_id) free_texture(&sprite_map->texture_id);
-        if (sprite_map->decorations_map.texture_id) free_texture(&sprite_map->texture_id);
+        if (sprite_map->colored.texture_id) free_texture(&sprite_map->colored.texture_id);
+        if (sprite_map->decorations_map.texture_id) free_texture(&sprite_map->decorations_map.texture_id);
+        if (sprite_map->pending.pbo) glDeleteBuffers(1, &sprite_map->pending.pbo);
+        free(sprite_map->pending.buf); free(sprite_map->pending.decorations);
+        free(sprite_map->pending.colored.buf); free(sprite_map->pending.colored.indices);
         free(sprite_map);
         fg->sprite_map = NULL;
     }
@@ -111,8 +141,8 @@ free_sprite_data(FONTS_DATA_HANDLE fg) {
 
 
 static void
-copy_32bit_texture(GLuint old_texture, GLuint new_texture, GLenum texture_type) {
-    // requires new texture to be at least as big as old texture. Assumes textures are 32bits per pixel
+copy_texture(GLuint old_texture, GLuint new_texture, GLenum texture_type) {
+    // requires new texture to be at least as big as old texture and to have the same format
     GLint width, height, layers;
     glBindTexture(texture_type, old_texture);
     glGetTexLevelParameteriv(texture_type, 0, GL_TEXTURE_WIDTH, &width);
@@ -130,9 +160,20 @@ copy_32bit_texture(GLuint old_texture, GLuint new_texture, GLenum texture_type)
     GLint internal_format;
     glGetTexLevelParameteriv(texture_type, 0, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
     GLenum format, type;
+    size_t bytes_per_pixel = 4;
     switch(internal_format) {
+        case GL_R8:
+            format = GL_RED;
+            type = GL_UNSIGNED_BYTE;
+            bytes_per_pixel = 1;
+            break;
+        case GL_RG32UI:
+            format = GL_RG_INTEGER;
+            type = GL_UNSIGNED_INT;
+            bytes_per_pixel = 8;
+            break;
         case GL_R8UI: case GL_R8I: case GL_R16UI: case GL_R16I: case GL_R32UI: case GL_R32I: case GL_RG8UI: case GL_RG8I:
-        case GL_RG16UI: case GL_RG16I: case GL_RG32UI: case GL_RG32I: case GL_RGB8UI: case GL_RGB8I: case GL_RGB16UI:
+        case GL_RG16UI: case GL_RG16I: case GL_RG32I: case GL_RGB8UI: case GL_RGB8I: case GL_RGB16UI:
         case GL_RGB16I: case GL_RGB32UI: case GL_RGB32I: case GL_RGBA8UI: case GL_RGBA8I: case GL_RGBA16UI: case GL_RGBA16I:
         case GL_RGBA32UI: case GL_RGBA32I:
             format = GL_RED_INTEGER;
@@ -143,12 +184,13 @@ copy_32bit_texture(GLuint old_texture, GLuint new_texture, GLenum texture_type)
             type = GL_UNSIGNED_INT_8_8_8_8;
             break;
     }
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-    RAII_ALLOC(uint8_t, pixels, malloc((size_t)width * height * layers * 4u));
+    const GLint alignment = bytes_per_pixel < 4 ? 1 : 4;
+    glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+    RAII_ALLOC(uint8_t, pixels, malloc((size_t)width * height * layers * bytes_per_pixel));
     if (!pixels) fatal("Out of memory");
     glGetTexImage(texture_type, 0, format, type, pixels);
     glBindTexture(texture_type, new_texture);
-    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
     if (texture_type == GL_TEXTURE_2D_ARRAY) glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, width, height, layers, format, type, pixels);
     else glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, pixels);
 }
@@ -182,9 +224,9 @@ realloc_sprite_decorations_texture_if_needed(FONTS_DATA_HANDLE fg) {
     if (height > sm->max_texture_size) fatal("Max texture size too small for sprite decorations map, maybe switch to using a GL_TEXTURE_2D_ARRAY");
     const GLenum texture_type = GL_TEXTURE_2D;
     GLuint tex = setup_new_sprites_texture(texture_type);
-    glTexImage2D(texture_type, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glTexImage2D(texture_type, 0, GL_RG32UI, width, height, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, NULL);
     if (dm.texture_id) {  // copy data from old texture
-        copy_32bit_texture(dm.texture_id, tex, texture_type);
+        copy_texture(dm.texture_id, tex, texture_type);
         free_texture(&dm.texture_id);
     }
     glBindTexture(texture_type, 0);
@@ -192,64 +234,217 @@ realloc_sprite_decorations_texture_if_needed(FONTS_DATA_HANDLE fg) {
 #undef dm
 }
 
-static void
-realloc_sprite_texture(FONTS_DATA_HANDLE fg) {
-    unsigned int xnum, ynum, z, znum, width, height;
-    sprite_tracker_current_layout(fg, &xnum, &ynum, &z);
-    znum = z + 1;
-    SpriteMap *sprite_map = (SpriteMap*)fg->sprite_map;
-    width = xnum * fg->fcm.cell_width; height = ynum * (fg->fcm.cell_height + 1);
+static GLuint
+new_sprites_array_texture(FONTS_DATA_HANDLE fg, GLenum internal_format, unsigned xnum, unsigned ynum, unsigned znum, GLuint old_texture) {
     const GLenum texture_type = GL_TEXTURE_2D_ARRAY;
     GLuint tex = setup_new_sprites_texture(texture_type);
-    glTexStorage3D(texture_type, 1, GL_SRGB8_ALPHA8, width, height, znum);
-    if (sprite_map->texture_id) { // copy old texture data into new texture
-        copy_32bit_texture(sprite_map->texture_id, tex, texture_type);
-        free_texture(&sprite_map->texture_id);
+    glTexStorage3D(texture_type, 1, internal_format, xnum * fg->fcm.cell_width, ynum * (fg->fcm.cell_height + 1), znum);
+    if (old_texture) { // copy old texture data into new texture
+        copy_texture(old_texture, tex, texture_type);
+        free_texture(&old_texture);
     }
     glBindTexture(texture_type, 0);
-    sprite_map->last_num_of_layers = znum;
+    return tex;
+}
+
+static void
+realloc_sprite_texture(FONTS_DATA_HANDLE fg) {
+    unsigned int xnum, ynum, z;
+    sprite_tracker_current_layout(fg, &xnum, &ynum, &z);
+    SpriteMap *sprite_map = (SpriteMap*)fg->sprite_map;
+    sprite_map->texture_id = new_sprites_array_texture(fg, GL_R8, xnum, ynum, z + 1, sprite_map->texture_id);
+    sprite_map->last_num_of_layers = z + 1;
     sprite_map->last_ynum = ynum;
-    sprite_map->texture_id = tex;
+}
+
+static void
+realloc_colored_sprite_texture(FONTS_DATA_HANDLE fg) {
+    unsigned int xnum, ynum, z;
+    colored_sprite_tracker_current_layout(fg, &xnum, &ynum, &z);
+    SpriteMap *sprite_map = (SpriteMap*)fg->sprite_map;
+    sprite_map->colored.texture_id = new_sprites_array_texture(fg, GL_SRGB8_ALPHA8, xnum, ynum, z + 1, sprite_map->colored.texture_id);
+    sprite_map->colored.last_num_of_layers = z + 1;
+    sprite_map->colored.last_ynum = ynum;
+}
+
+size_t
+sprite_textures_size(FONTS_DATA_HANDLE fg) {
+    const SpriteMap *sm = (SpriteMap*)fg->sprite_map;
+    if (!sm) return 0;
+    size_t ans = (size_t)sm->decorations_map.width * sm->decorations_map.height * sizeof(SpriteMapEntry);
+    const size_t sprite_area = (size_t)fg->fcm.cell_width * (fg->fcm.cell_height + 1);
+    unsigned int xnum, ynum, z;
+    if (sm->texture_id) {
+        sprite_tracker_current_layout(fg, &xnum, &ynum, &z);
+        ans += (size_t)xnum * MAX(0, sm->last_ynum) * sm->last_num_of_layers * sprite_area;
+    }
+    if (sm->colored.texture_id) {
+        colored_sprite_tracker_current_layout(fg, &xnum, &ynum, &z);
+        ans += (size_t)xnum * MAX(0, sm->colored.last_ynum) * sm->colored.last_num_of_layers * sprite_area * sizeof(pixel);
+    }
+    return ans;
 }
 
 static void
 ensure_sprite_map(FONTS_DATA_HANDLE fg) {
     SpriteMap *sprite_map = (SpriteMap*)fg->sprite_map;
     if (!sprite_map->texture_id) realloc_sprite_texture(fg);
+    if (!sprite_map->colored.texture_id) realloc_colored_sprite_texture(fg);
     if (!sprite_map->decorations_map.texture_id) realloc_sprite_decorations_texture_if_needed(fg);
     // We have to rebind since we don't know if the texture was ever bound
     // in the context of the current OSWindow
     glActiveTexture(GL_TEXTURE0 + SPRITE_DECORATIONS_MAP_UNIT);
     glBindTexture(GL_TEXTURE_2D, sprite_map->decorations_map.texture_id);
+    glActiveTexture(GL_TEXTURE0 + COLORED_SPRITE_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, sprite_map->colored.texture_id);
     glActiveTexture(GL_TEXTURE0 + SPRITE_MAP_UNIT);
     glBindTexture(GL_TEXTURE_2D_ARRAY, sprite_map->texture_id);
 }
 
-void
-send_sprite_to_gpu(FONTS_DATA_HANDLE fg, sprite_index idx, pixel *buf, sprite_index decoration_idx) {
-    SpriteMap *sprite_map = (SpriteMap*)fg->sprite_map;
+// The maximum size of the rows of sprites that are accumulated before they are uploaded
+#define MAX_PENDING_SPRITE_BYTES (8u * 1024u * 1024u)
+
+static unsigned
+max_pending_sprite_rows(unsigned sprite_height, unsigned stride) {
+    return MAX(1u, MAX_PENDING_SPRITE_BYTES / (sprite_height * stride));
+}
+
+static void
+upload_sprite_rows(FONTS_DATA_HANDLE fg, unsigned first_row, unsigned row, unsigned x, unsigned num_rows, unsigned width, unsigned z, unsigned y) {
+    // Upload width sprites starting at column x from num_rows rows of the
+    // pending buffer, starting at the row row (relative to first_row) to the
+    // row y of layer z. The data is read from the bound pixel unpack buffer.
+    SpriteMap *sm = (SpriteMap*)fg->sprite_map;
+    const unsigned sprite_height = fg->fcm.cell_height + 1;
+    const size_t offset = ((size_t)(row - first_row) * sprite_height * sm->pending.stride) + (size_t)x * fg->fcm.cell_width;
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x * fg->fcm.cell_width, y * sprite_height, z, width * fg->fcm.cell_width, num_rows * sprite_height, 1, GL_RED, GL_UNSIGNED_BYTE, (const void*)(uintptr_t)offset);
+}
+
+static void
+flush_pending_colored_sprites(FONTS_DATA_HANDLE fg) {
+    // Colored sprites are rare, mostly emoji, so they are uploaded one at a time
+    SpriteMap *sm = (SpriteMap*)fg->sprite_map;
     unsigned int xnum, ynum, znum, x, y, z;
-#define dm (sprite_map->decorations_map)
-    if (idx >= dm.count) dm.count = idx + 1;
+    colored_sprite_tracker_current_layout(fg, &xnum, &ynum, &znum);
+    if ((int)znum >= sm->colored.last_num_of_layers || (znum == 0 && (int)ynum > sm->colored.last_ynum)) {
+        realloc_colored_sprite_texture(fg);
+    }
+    glActiveTexture(GL_TEXTURE0 + COLORED_SPRITE_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, sm->colored.texture_id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    const unsigned sprite_width = fg->fcm.cell_width, sprite_height = fg->fcm.cell_height + 1;
+    for (unsigned i = 0; i < sm->pending.colored.count; i++) {
+        sprite_index_to_pos(sm->pending.colored.indices[i], xnum, ynum, &x, &y, &z);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x * sprite_width, y * sprite_height, z, sprite_width, sprite_height, 1, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, sm->pending.colored.buf + (size_t)i * sprite_width * sprite_height);
+    }
+    sm->pending.colored.count = 0;
+}
+
+static void
+flush_pending_sprites(FONTS_DATA_HANDLE fg) {
+    // Rendering a screen full of new glyphs, for example CJK text or emoji,
+    // creates hundreds of sprites. Rather than one upload per sprite they are
+    // accumulated and uploaded with at most two glTexSubImage*() calls per
+    // layer. Sprite indices are allocated sequentially and never re-used, so
+    // the slots after the last pending sprite in its row are unused and
+    // can be overwritten.
+    SpriteMap *sm = (SpriteMap*)fg->sprite_map;
+    if (!sm || !sm->pending.count) return;
+    const sprite_index first = sm->pending.first, last = first + sm->pending.count - 1;
+#define dm (sm->decorations_map)
+    if (last >= dm.count) dm.count = last + 1;
     realloc_sprite_decorations_texture_if_needed(fg);
-    div_t d = div(idx, dm.width);
-    x = d.rem; y = d.quot;
     glActiveTexture(GL_TEXTURE0 + SPRITE_DECORATIONS_MAP_UNIT);
     glBindTexture(GL_TEXTURE_2D, dm.texture_id);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, &decoration_idx);
+    for (sprite_index idx = first; idx <= last;) {
+        const unsigned x = idx % dm.width, y = idx / dm.width, n = MIN(dm.width - x, last + 1 - idx);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, n, 1, GL_RG_INTEGER, GL_UNSIGNED_INT, sm->pending.decorations + (idx - first));
+        idx += n;
+    }
 #undef dm
+    if (sm->pending.colored.count) flush_pending_colored_sprites(fg);
+    unsigned int xnum, ynum, znum;
     sprite_tracker_current_layout(fg, &xnum, &ynum, &znum);
-    if ((int)znum >= sprite_map->last_num_of_layers || (znum == 0 && (int)ynum > sprite_map->last_ynum)) {
+    if ((int)znum >= sm->last_num_of_layers || (znum == 0 && (int)ynum > sm->last_ynum)) {
         realloc_sprite_texture(fg);
         sprite_tracker_current_layout(fg, &xnum, &ynum, &znum);
     }
     glActiveTexture(GL_TEXTURE0 + SPRITE_MAP_UNIT);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, sprite_map->texture_id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, sm->texture_id);
+    // rows are counted across layers, every layer other than the last one is full
+    const unsigned first_row = first / xnum, last_row = last / xnum;
+    // Uploading from a pixel unpack buffer lets the driver copy the data
+    // to the texture asynchronously instead of stalling on every call.
+    // Respecifying the data store each time orphans the previous one, so
+    // there is no wait for the upload of the previous batch either.
+    if (!sm->pending.pbo) glGenBuffers(1, &sm->pending.pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, sm->pending.pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)(last_row + 1 - first_row) * (fg->fcm.cell_height + 1) * sm->pending.stride, sm->pending.buf, GL_STREAM_DRAW);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, sm->pending.stride);
+    for (unsigned row = first_row; row <= last_row;) {
+        const unsigned z = row / ynum, y = row % ynum, layer_last_row = MIN(last_row, (z + 1) * ynum - 1);
+        unsigned x = row == first_row ? first % xnum : 0;
+        if (x) {
+            const unsigned width = row == last_row ? last % xnum + 1 - x : xnum - x;
+            upload_sprite_rows(fg, first_row, row, x, 1, width, z, y);
+            row++; continue;
+        }
+        const unsigned num_rows = layer_last_row + 1 - row;
+        upload_sprite_rows(fg, first_row, row, 0, num_rows, num_rows == 1 && row == last_row ? last % xnum + 1 : xnum, z, y);
+        row = layer_last_row + 1;
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-    sprite_index_to_pos(idx, xnum, ynum, &x, &y, &z);
-    x *= fg->fcm.cell_width; y *= (fg->fcm.cell_height + 1);
-    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, z, fg->fcm.cell_width, fg->fcm.cell_height + 1, 1, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, buf);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    sm->pending.count = 0;
+}
+
+void
+send_sprite_to_gpu(FONTS_DATA_HANDLE fg, sprite_index idx, pixel *buf, sprite_index decoration_idx, bool colored, sprite_index colored_idx) {
+    SpriteMap *sm = (SpriteMap*)fg->sprite_map;
+    unsigned int xnum, ynum, znum;
+    sprite_tracker_current_layout(fg, &xnum, &ynum, &znum);
+    const unsigned sprite_width = fg->fcm.cell_width, sprite_height = fg->fcm.cell_height + 1, stride = xnum * sprite_width;
+    if (sm->pending.count && (
+        idx != sm->pending.first + sm->pending.count || stride != sm->pending.stride ||
+        idx / xnum - sm->pending.first / xnum >= max_pending_sprite_rows(sprite_height, stride))) flush_pending_sprites(fg);
+    if (!sm->pending.count) {
+        if (stride != sm->pending.stride) { free(sm->pending.buf); sm->pending.buf = NULL; sm->pending.rows_capacity = 0; }
+        sm->pending.first = idx; sm->pending.stride = stride;
+    }
+    const unsigned row = idx / xnum - sm->pending.first / xnum;
+    if (sm->pending.count >= sm->pending.capacity) {
+        sm->pending.capacity = MAX(64u, 2 * sm->pending.capacity);
+        sm->pending.decorations = realloc(sm->pending.decorations, sm->pending.capacity * sizeof(sm->pending.decorations[0]));
+        if (!sm->pending.decorations) fatal("Out of memory allocating pending sprite decorations");
+    }
+    if (row >= sm->pending.rows_capacity) {
+        // grows with the largest batch instead of allocating for the maximum up front
+        sm->pending.rows_capacity = MIN(MAX(4u, 2 * sm->pending.rows_capacity), max_pending_sprite_rows(sprite_height, stride));
+        sm->pending.buf = realloc(sm->pending.buf, (size_t)sm->pending.rows_capacity * sprite_height * stride);
+        if (!sm->pending.buf) fatal("Out of memory allocating pending sprites");
+    }
+    uint8_t *dest = sm->pending.buf + (size_t)row * sprite_height * stride + (size_t)(idx % xnum) * sprite_width;
+    for (unsigned y = 0; y < sprite_height; y++) {
+        const pixel *src = buf + (size_t)y * sprite_width;
+        uint8_t *d = dest + (size_t)y * stride;
+        for (unsigned x = 0; x < sprite_width; x++) d[x] = src[x] & 0xff;
+    }
+    if (colored) {
+#define pc sm->pending.colored
+        if (pc.count >= pc.capacity) {
+            pc.capacity = MAX(16u, 2 * pc.capacity);
+            pc.buf = realloc(pc.buf, (size_t)pc.capacity * sprite_width * sprite_height * sizeof(pixel));
+            pc.indices = realloc(pc.indices, pc.capacity * sizeof(pc.indices[0]));
+            if (!pc.buf || !pc.indices) fatal("Out of memory allocating pending colored sprites");
+        }
+        memcpy(pc.buf + (size_t)pc.count * sprite_width * sprite_height, buf, (size_t)sprite_width * sprite_height * sizeof(pixel));
+        pc.indices[pc.count++] = colored_idx;
+#undef pc
+    }
+    sm->pending.decorations[sm->pending.count++] = (SpriteMapEntry){.decorations_idx=decoration_idx, .colored_idx=colored ? colored_idx : 0};
 }
 
 void
@@ -277,6 +472,112 @@ send_image_to_gpu(GLuint *tex_id, const void* data, GLsizei width, GLsizei heigh
     glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB_ALPHA, width, height, 0, is_opaque ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, data);
 }
 
+void
+generate_mipmaps(GLuint tex_id) {
+    glBindTexture(GL_TEXTURE_2D, tex_id);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+}
+
+// Small images are packed into shared atlas textures so that the many
+// placements of icons and thumbnails on screen can be drawn with a few
+// instanced draw calls. An atlas is divided into square slots all of the same
+// size. The image in a slot is surrounded by a one pixel transparent border,
+// which gives the same result as the GL_CLAMP_TO_BORDER used for images that
+// have their own texture.
+
+#define ATLAS_SIZE 1024u
+#define MIN_ATLAS_SLOT_SIZE 64u
+#define MAX_ATLAS_SLOT_SIZE 256u
+
+typedef struct ImageAtlas {
+    GLuint texture_id;
+    unsigned slot_size, num_used;
+    uint64_t used[(ATLAS_SIZE / MIN_ATLAS_SLOT_SIZE) * (ATLAS_SIZE / MIN_ATLAS_SLOT_SIZE) / 64u];
+} ImageAtlas;
+
+static struct { ImageAtlas *items; size_t count, capacity; } image_atlases = {0};
+
+static unsigned
+atlas_slot_size(int32_t width, int32_t height) {
+    const unsigned needed = MAX(width, height) + 2;
+    for (unsigned sz = MIN_ATLAS_SLOT_SIZE; sz <= MAX_ATLAS_SLOT_SIZE; sz *= 2) if (needed <= sz) return sz;
+    return 0;
+}
+
+static void
+atlas_slot_origin(const ImageAtlas *a, unsigned slot, unsigned *x, unsigned *y) {
+    const unsigned per_row = ATLAS_SIZE / a->slot_size;
+    *x = (slot % per_row) * a->slot_size; *y = (slot / per_row) * a->slot_size;
+}
+
+static ImageAtlas*
+atlas_with_free_slot(unsigned slot_size) {
+    const unsigned num_slots = (ATLAS_SIZE / slot_size) * (ATLAS_SIZE / slot_size);
+    for (size_t i = 0; i < image_atlases.count; i++) {
+        ImageAtlas *a = image_atlases.items + i;
+        if (a->texture_id && a->slot_size == slot_size && a->num_used < num_slots) return a;
+    }
+    // re-use the entry of an atlas that was freed
+    size_t i = 0;
+    while (i < image_atlases.count && image_atlases.items[i].texture_id) i++;
+    if (i >= image_atlases.count) {
+        ensure_space_for(&image_atlases, items, ImageAtlas, image_atlases.count + 1, capacity, 4, true);
+        i = image_atlases.count++;
+    }
+    ImageAtlas *a = image_atlases.items + i;
+    zero_at_ptr(a);
+    a->slot_size = slot_size;
+    glGenTextures(1, &a->texture_id);
+    glBindTexture(GL_TEXTURE_2D, a->texture_id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB_ALPHA, ATLAS_SIZE, ATLAS_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    return a;
+}
+
+bool
+send_image_to_atlas(ImageAtlasSlot *s, const void *data, int32_t width, int32_t height, bool is_opaque, bool is_4byte_aligned) {
+    unsigned x, y;
+    if (!s->texture_id) {
+        const unsigned slot_size = atlas_slot_size(width, height);
+        if (!slot_size) return false;
+        ImageAtlas *a = atlas_with_free_slot(slot_size);
+        unsigned slot = 0;
+        while (a->used[slot / 64] & (1ull << (slot % 64))) slot++;
+        a->used[slot / 64] |= 1ull << (slot % 64); a->num_used++;
+        *s = (ImageAtlasSlot){.texture_id=a->texture_id, .atlas=a - image_atlases.items, .slot=slot};
+        atlas_slot_origin(a, slot, &x, &y);
+        s->left = (x + 1) / (float)ATLAS_SIZE; s->right = (x + 1 + width) / (float)ATLAS_SIZE;
+        s->top = (y + 1) / (float)ATLAS_SIZE; s->bottom = (y + 1 + height) / (float)ATLAS_SIZE;
+        // clear the slot so that the border around the image is transparent
+        static const uint8_t transparent[MAX_ATLAS_SLOT_SIZE * MAX_ATLAS_SLOT_SIZE * 4] = {0};
+        glBindTexture(GL_TEXTURE_2D, a->texture_id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, slot_size, slot_size, GL_RGBA, GL_UNSIGNED_BYTE, transparent);
+    } else {
+        atlas_slot_origin(image_atlases.items + s->atlas, s->slot, &x, &y);
+        glBindTexture(GL_TEXTURE_2D, s->texture_id);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, is_4byte_aligned ? 4 : 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x + 1, y + 1, width, height, is_opaque ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, data);
+    return true;
+}
+
+void
+free_atlas_slot(ImageAtlasSlot *s) {
+    if (s->texture_id && s->atlas < image_atlases.count) {
+        ImageAtlas *a = image_atlases.items + s->atlas;
+        if (a->texture_id == s->texture_id) {
+            a->used[s->slot / 64] &= ~(1ull << (s->slot % 64));
+            if (!--a->num_used) free_texture(&a->texture_id);
+        }
+    }
+    zero_at_ptr(s);
+}
+
 // }}}
 
 // Rounded rect {{{
@@ -294,6 +595,44 @@ thickness_as_float(const OSWindow *os_window, unsigned level) {
 }
 
 
+// The rects drawn over windows, such as the borders of window bars and
+// scroll indicators, are queued while rendering the windows of an OS window
+// and all drawn at the end with as few instanced draw calls as possible.
+#define MAX_UI_RECT_BATCH 32
+
+typedef struct UIRect {
+    // in pixels with the origin at the bottom left of the framebuffer
+    GLfloat rect[4];
+    // thickness and corner radius in pixels, negative thickness for a filled rect
+    GLfloat params[4];
+    GLfloat color[4], background_color[4];
+} UIRect;
+
+static struct {
+    UIRect *items;
+    size_t count, capacity;
+} ui_rects = {0};
+
+static void
+linear_color(GLfloat *out, color_type srgb_color, GLfloat alpha) {
+    out[0] = srgb_lut[(srgb_color >> 16) & 0xFF]; out[1] = srgb_lut[(srgb_color >> 8) & 0xFF]; out[2] = srgb_lut[srgb_color & 0xFF];
+    out[3] = alpha;
+}
+
+static void
+queue_ui_rect(
+    float left, float top, float width, float height, unsigned framebuffer_height, float thickness, float corner_radius,
+    color_type srgb_color, float alpha, color_type srgb_background, float bg_alpha
+) {
+    ensure_space_for(&ui_rects, items, UIRect, ui_rects.count + 1, capacity, 16, false);
+    UIRect *r = ui_rects.items + ui_rects.count++;
+    // y co-ord has to be changed to co-ord system with origin at bottom left
+    r->rect[0] = left; r->rect[1] = (float)framebuffer_height - (top + height); r->rect[2] = width; r->rect[3] = height;
+    r->params[0] = thickness; r->params[1] = corner_radius; r->params[2] = 0; r->params[3] = 0;
+    linear_color(r->color, srgb_color, alpha);
+    linear_color(r->background_color, srgb_background, bg_alpha);
+}
+
 static void
 draw_rounded_rect(
     const OSWindow *os_window, Viewport rect, unsigned framebuffer_height,
@@ -301,16 +640,28 @@ draw_rounded_rect(
     color_type srgb_color, color_type srgb_background, float bg_alpha
 ) {
     float thickness = (float)thickness_as_float(os_window, thickness_level);
+    queue_ui_rect(rect.left, rect.top, rect.width, rect.height, framebuffer_height, thickness, corner_radius_px, srgb_color, 1.f, srgb_background, bg_alpha);
+}
+
+static void
+draw_queued_ui_rects(const OSWindow *os_window) {
+    if (!ui_rects.count) return;
     bind_program(ROUNDED_RECT_PROGRAM);
-    color_vec4(rounded_rect_program_layout.uniforms.color, srgb_color, 1.f);
-    color_vec4(rounded_rect_program_layout.uniforms.background_color, srgb_background, bg_alpha);
-    // y co-ord has to be changed to co-ord system with origin at bottom left
-    float y = (float)framebuffer_height - (float)(rect.top + rect.height);
-    glUniform4f(rounded_rect_program_layout.uniforms.rect, rect.left, y, rect.width, rect.height);
-    glUniform2f(rounded_rect_program_layout.uniforms.params, thickness, corner_radius_px);
-    save_viewport_using_top_left_origin(rect.left, rect.top, rect.width, rect.height, framebuffer_height);
-    draw_quad(true, 0);
-    restore_viewport();
+    const Rounded_rectUniforms *u = &rounded_rect_program_layout.uniforms;
+    glUniform2f(u->viewport_size, os_window->viewport_width, os_window->viewport_height);
+    GLfloat rects[MAX_UI_RECT_BATCH * 4], params[MAX_UI_RECT_BATCH * 4], colors[MAX_UI_RECT_BATCH * 4], background_colors[MAX_UI_RECT_BATCH * 4];
+    for (size_t i = 0; i < ui_rects.count;) {
+        GLsizei n = 0;
+        for (; n < MAX_UI_RECT_BATCH && i < ui_rects.count; n++, i++) {
+            const UIRect *r = ui_rects.items + i;
+            memcpy(rects + 4 * n, r->rect, sizeof(r->rect)); memcpy(params + 4 * n, r->params, sizeof(r->params));
+            memcpy(colors + 4 * n, r->color, sizeof(r->color)); memcpy(background_colors + 4 * n, r->background_color, sizeof(r->background_color));
+        }
+        glUniform4fv(u->rects, n, rects); glUniform4fv(u->rect_params, n, params);
+        glUniform4fv(u->colors, n, colors); glUniform4fv(u->background_colors, n, background_colors);
+        draw_quad(true, n);
+    }
+    ui_rects.count = 0;
 }
 // }}}
 
@@ -439,19 +790,19 @@ cell_update_uniform_block(ssize_t vao_idx, Screen *screen, int uniform_buffer, C
 
         GLuint default_fg, highlight_fg, highlight_bg, main_cursor_fg, main_cursor_bg, url_color, url_style, inverted, extra_cursor_fg, extra_cursor_bg;
 
-        GLuint columns, lines, sprites_xnum, sprites_ynum, cursor_shape, cell_width, cell_height;
+        GLuint columns, lines, sprites_xnum, sprites_ynum, colored_sprites_ynum, cursor_shape, cell_width, cell_height;
         GLuint cursor_x1, cursor_x2, cursor_y1, cursor_y2;
         GLfloat cursor_opacity, inactive_text_alpha, dim_opacity, blink_opacity;
 
         GLuint bg_colors0, bg_colors1, bg_colors2, bg_colors3, bg_colors4, bg_colors5, bg_colors6, bg_colors7;
         GLfloat bg_opacities0, bg_opacities1, bg_opacities2, bg_opacities3, bg_opacities4, bg_opacities5, bg_opacities6, bg_opacities7;
     };
-    // Send the uniform data
-    struct GPUCellRenderData *rd = (struct GPUCellRenderData*)map_vao_buffer(vao_idx, uniform_buffer, GL_WRITE_ONLY);
+    static_assert(sizeof(struct GPUCellRenderData) <= sizeof(screen->gpu_render_data.data), "Increase the size of gpu_render_data");
+    // The uniform data is built here and only sent to the GPU if it differs
+    // from what was sent for this screen last time
+    struct GPUCellRenderData render_data = {0}, *rd = &render_data;
     ColorProfile *cp = screen->paused_rendering.expires_at ? &screen->paused_rendering.color_profile : screen->color_profile;
-    if (UNLIKELY(cp->dirty || screen->reload_all_gpu_data)) {
-        copy_color_table_to_buffer(cp, (GLuint*)rd, cell_program_layouts[CELL_PROGRAM].color_table.offset / sizeof(GLuint), cell_program_layouts[CELL_PROGRAM].color_table.stride / sizeof(GLuint));
-    }
+    const bool color_table_changed = cp->dirty || screen->reload_all_gpu_data;
 #define COLOR(name) colorprofile_to_color(cp, cp->overridden.name, cp->configured.name).rgb
     rd->default_fg = COLOR(default_fg);
     rd->highlight_fg = COLOR(highlight_fg); rd->highlight_bg = COLOR(highlight_bg);
@@ -539,6 +890,9 @@ cell_update_uniform_block(ssize_t vao_idx, Screen *screen, int uniform_buffer, C
     unsigned int x, y, z;
     sprite_tracker_current_layout(os_window->fonts_data, &x, &y, &z);
     rd->sprites_xnum = x; rd->sprites_ynum = y;
+    // the colored sprites have the same number of sprites per row
+    colored_sprite_tracker_current_layout(os_window->fonts_data, &x, &y, &z);
+    rd->colored_sprites_ynum = y;
     rd->inverted = screen_invert_colors(screen) ? 1 : 0;
     rd->cell_width = os_window->fonts_data->fcm.cell_width;
     rd->cell_height = os_window->fonts_data->fcm.cell_height;
@@ -547,13 +901,74 @@ cell_update_uniform_block(ssize_t vao_idx, Screen *screen, int uniform_buffer, C
 
 #undef COLOR
     rd->url_color = OPT(url_color); rd->url_style = OPT(url_style);
-    color_type default_bg = rd->bg_colors0;
-    unmap_vao_buffer(vao_idx, uniform_buffer); rd = NULL;
-    return default_bg;
+    if (UNLIKELY(color_table_changed) || !screen->gpu_render_data.is_valid || memcmp(screen->gpu_render_data.data, rd, sizeof(render_data)) != 0) {
+        GLuint *buf = map_vao_buffer(vao_idx, uniform_buffer, GL_WRITE_ONLY);
+        if (UNLIKELY(color_table_changed)) {
+            copy_color_table_to_buffer(cp, buf, cell_program_layouts[CELL_PROGRAM].color_table.offset / sizeof(GLuint), cell_program_layouts[CELL_PROGRAM].color_table.stride / sizeof(GLuint));
+        }
+        memcpy(buf, rd, sizeof(render_data));
+        unmap_vao_buffer(vao_idx, uniform_buffer);
+        memcpy(screen->gpu_render_data.data, rd, sizeof(render_data));
+        screen->gpu_render_data.is_valid = true;
+    }
+    return rd->bg_colors0;
+}
+
+static bool
+use_persistent_buffers(void) {
+    static int ans = -1;
+    if (ans < 0) ans = persistent_buffers_supported() ? 1 : 0;
+    return ans == 1;
+}
+
+static void
+send_changed_cell_rows_to_gpu(ssize_t vao_idx, Screen *screen) {
+    // Only rows whose contents differ from what was last sent are uploaded,
+    // the full buffer is rewritten only when the screen is resized, all GPU
+    // data is reloaded or every row has changed. When the view is scrolled
+    // the rows that remain visible are moved on the GPU instead.
+    CELL_BUFFERS;
+    const index_type lines = screen->gpu_cell_data.lines, columns = screen->gpu_cell_data.columns;
+    const size_t row_sz = sizeof(GPUCell) * columns;
+    const GPUCell *cells = screen->gpu_cell_data.cells;
+    const uint64_t *row_generations = screen->gpu_cell_data.row_generations;
+    if (use_persistent_buffers()) {
+        // Each region of the buffer is brought up to date from the generation it was last written at
+        uint64_t *region_generation;
+        uint8_t *region = map_next_vao_buffer_region(vao_idx, cell_data_buffer, row_sz * lines, &region_generation);
+        for (index_type y = 0; y < lines; y++) {
+            if (row_generations[y] > *region_generation) memcpy(region + y * row_sz, cells + (size_t)y * columns, row_sz);
+        }
+        *region_generation = screen->gpu_cell_data.generation;
+        return;
+    }
+    const uint64_t since = screen->gpu_cell_data.uploaded_generation;
+    index_type num_changed_rows = 0;
+    for (index_type y = 0; y < lines; y++) if (row_generations[y] > since) num_changed_rows++;
+    const int moved_by = screen->gpu_cell_data.rows_moved_by;
+    screen->gpu_cell_data.rows_moved_by = 0;
+    if (moved_by && num_changed_rows < lines) {
+        const index_type num = lines - abs(moved_by);
+        move_vao_buffer_range(vao_idx, cell_data_buffer, (moved_by > 0 ? 0 : -moved_by) * row_sz, (moved_by > 0 ? moved_by : 0) * row_sz, num * row_sz);
+    }
+    if (num_changed_rows >= lines) {
+        const size_t sz = row_sz * lines;
+        void *address = alloc_and_map_vao_buffer(vao_idx, sz, cell_data_buffer, GL_STREAM_DRAW, GL_WRITE_ONLY);
+        memcpy(address, cells, sz);
+        unmap_vao_buffer(vao_idx, cell_data_buffer);
+    } else if (num_changed_rows) {
+        for (index_type y = 0; y < lines;) {
+            if (row_generations[y] <= since) { y++; continue; }
+            const index_type start = y;
+            while (y < lines && row_generations[y] > since) y++;
+            update_vao_buffer_range(vao_idx, cell_data_buffer, start * row_sz, (y - start) * row_sz, cells + (size_t)start * columns);
+        }
+    }
+    screen->gpu_cell_data.uploaded_generation = screen->gpu_cell_data.generation;
 }
 
 static bool
-cell_prepare_to_render(ssize_t vao_idx, Screen *screen, FONTS_DATA_HANDLE fonts_data) {
+cell_prepare_to_render(ssize_t vao_idx, Screen *screen, FONTS_DATA_HANDLE fonts_data, id_type os_window_id) {
     size_t sz;
     CELL_BUFFERS;
     void *address;
@@ -568,23 +983,34 @@ cell_prepare_to_render(ssize_t vao_idx, Screen *screen, FONTS_DATA_HANDLE fonts_
     bool screen_resized = screen->last_rendered.columns != screen->columns || screen->last_rendered.lines != screen->lines;
 
 #define update_cell_data { \
-        sz = sizeof(GPUCell) * screen->lines * screen->columns; \
-        address = alloc_and_map_vao_buffer(vao_idx, sz, cell_data_buffer, GL_STREAM_DRAW, GL_WRITE_ONLY); \
-        screen_update_cell_data(screen, address, fonts_data, disable_ligatures && cursor_pos_changed); \
-        unmap_vao_buffer(vao_idx, cell_data_buffer); address = NULL; \
+        const monotonic_t started_at = monotonic(); \
+        if (screen->reload_all_gpu_data) screen->gpu_cell_data.uploaded_generation = 0; \
+        screen_update_cell_data(screen, fonts_data, disable_ligatures && cursor_pos_changed, !use_persistent_buffers()); \
+        send_changed_cell_rows_to_gpu(vao_idx, screen); \
+        record_frame_timing(FRAME_STAGE_CELL_DATA, os_window_id, started_at, monotonic()); \
         changed = true; \
 }
 
     if (screen->paused_rendering.expires_at) {
-        if (!screen->paused_rendering.cell_data_updated) update_cell_data;
+        if (!screen->paused_rendering.cell_data_updated && !screen->paused_rendering.cells_on_gpu) update_cell_data;
     } else if (screen->reload_all_gpu_data || screen->scroll_changed || screen->is_dirty || screen_resized || (disable_ligatures && cursor_pos_changed)) update_cell_data;
+    // Cells store unresolved colors that the shader looks up in the color
+    // table, which is uploaded with the uniforms, so a color change only
+    // needs a redraw, not new cell data
+    if (!screen->paused_rendering.expires_at && screen->color_profile->dirty) changed = true;
 
 #define update_selection_data { \
     sz = (size_t)screen->lines * screen->columns; \
-    address = alloc_and_map_vao_buffer(vao_idx, sz, selection_buffer, GL_STREAM_DRAW, GL_WRITE_ONLY); \
-    screen_apply_selection(screen, address, sz); \
-    unmap_vao_buffer(vao_idx, selection_buffer); address = NULL; \
-    changed = true; \
+    if (use_persistent_buffers()) { \
+        uint64_t *unused_tag; \
+        address = map_next_vao_buffer_region(vao_idx, selection_buffer, sz, &unused_tag); \
+        screen_update_selection_render_data(screen, address, sz, screen->reload_all_gpu_data || screen_resized); \
+    } else { \
+        address = alloc_and_map_vao_buffer(vao_idx, sz, selection_buffer, GL_STREAM_DRAW, GL_WRITE_ONLY); \
+        screen_update_selection_render_data(screen, address, sz, screen->reload_all_gpu_data || screen_resized); \
+        unmap_vao_buffer(vao_idx, selection_buffer); \
+    } \
+    address = NULL; changed = true; \
 }
 
 #define update_graphics_data(grman) \
@@ -592,13 +1018,20 @@ cell_prepare_to_render(ssize_t vao_idx, Screen *screen, FONTS_DATA_HANDLE fonts_
 
     if (screen->paused_rendering.expires_at) {
         if (!screen->paused_rendering.cell_data_updated) {
-            update_selection_data; update_graphics_data(screen->paused_rendering.grman);
+            if (!screen->paused_rendering.cells_on_gpu) { update_selection_data; }
+            update_graphics_data(screen->paused_rendering.grman);
         }
         screen->paused_rendering.cell_data_updated = true;
         screen->last_rendered.scrolled_by = screen->paused_rendering.scrolled_by;
     } else {
         if (screen->reload_all_gpu_data || screen_resized || screen_is_selection_dirty(screen)) update_selection_data;
-        if (update_graphics_data(screen->grman)) changed = true;
+        const monotonic_t started_at = monotonic();
+        const bool graphics_changed = update_graphics_data(screen->grman);
+        grman_generate_mipmaps(screen->grman);
+        if (graphics_changed) {
+            changed = true;
+            record_frame_timing(FRAME_STAGE_GRAPHICS, os_window_id, started_at, monotonic());
+        }
         screen->last_rendered.scrolled_by = screen->scrolled_by;
     }
 #undef update_selection_data
@@ -610,22 +1043,31 @@ cell_prepare_to_render(ssize_t vao_idx, Screen *screen, FONTS_DATA_HANDLE fonts_
     return changed;
 }
 
+#define MAX_GRAPHICS_BATCH 64
+
 static void
 draw_graphics(int program, ImageRenderData *data, GLuint start, GLuint count, float extra_alpha) {
     bind_program(program);
     if (program != GRAPHICS_ALPHA_MASK_PROGRAM) glUniform1f(graphics_program_layouts[program].uniforms.extra_alpha, extra_alpha);
     glActiveTexture(GL_TEXTURE0 + GRAPHICS_UNIT);
     GraphicsUniforms *u = &graphics_program_layouts[program].uniforms;
-    for (GLuint i=0; i < count;) {
-        ImageRenderData *group = data + start + i;
-        glBindTexture(GL_TEXTURE_2D, group->texture_id);
-        if (group->group_count == 0) { i++; continue; }
-        for (GLuint k=0; k < group->group_count; k++, i++) {
-            ImageRenderData *rd = data + start + i;
-            glUniform4f(u->src_rect, rd->src_rect.left, rd->src_rect.top, rd->src_rect.right, rd->src_rect.bottom);
-            glUniform4f(u->dest_rect, rd->dest_rect.left, rd->dest_rect.top, rd->dest_rect.right, rd->dest_rect.bottom);
-            draw_quad(true, 0);
+    GLfloat src_rects[MAX_GRAPHICS_BATCH * 4], dest_rects[MAX_GRAPHICS_BATCH * 4];
+    // Consecutive images that use the same texture, either because they are
+    // placements of the same image or because they are in the same atlas,
+    // are drawn with a single instanced draw call.
+    for (GLuint i = 0; i < count;) {
+        const GLuint texture_id = data[start + i].texture_id;
+        GLuint n = 0;
+        for (; n < MAX_GRAPHICS_BATCH && i < count && data[start + i].texture_id == texture_id; n++, i++) {
+            const ImageRenderData *rd = data + start + i;
+            GLfloat *s = src_rects + 4 * n, *d = dest_rects + 4 * n;
+            s[0] = rd->src_rect.left; s[1] = rd->src_rect.top; s[2] = rd->src_rect.right; s[3] = rd->src_rect.bottom;
+            d[0] = rd->dest_rect.left; d[1] = rd->dest_rect.top; d[2] = rd->dest_rect.right; d[3] = rd->dest_rect.bottom;
         }
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        glUniform4fv(u->src_rects, n, src_rects);
+        glUniform4fv(u->dest_rects, n, dest_rects);
+        draw_quad(true, n);
     }
 }
 
@@ -670,6 +1112,7 @@ set_cell_uniforms(bool force) {
         for (int i = CELL_PROGRAM; i < CELL_PROGRAM_SENTINEL; i++) {
             bind_program(i); const CellUniforms *cu = &cell_program_layouts[i].uniforms;
             glUniform1i(cu->sprites, SPRITE_MAP_UNIT);
+            glUniform1i(cu->colored_sprites, COLORED_SPRITE_MAP_UNIT);
             glUniform1i(cu->sprite_decorations_map, SPRITE_DECORATIONS_MAP_UNIT);
             glUniform1f(cu->text_contrast, text_contrast);
             glUniform1f(cu->text_gamma_adjustment, text_gamma_adjustment);
@@ -743,16 +1186,12 @@ has_scrollbar(Screen *screen) {
 }
 
 static bool
-draw_scroll_indicator(color_type bar_color, GLfloat alpha, float frac, const UIRenderData *ui) {
-    bind_program(TINT_PROGRAM);
-#define C(shift) srgb_color((bar_color >> shift) & 0xFF) * alpha
-    glUniform4f(tint_program_layout.uniforms.tint_color, C(16), C(8), C(0), alpha);
-#undef C
-    float bar_width = 0.5f * gl_size(ui->cell_width, ui->screen_width);
-    float bar_height = gl_size(ui->cell_height, ui->screen_height);
-    float bottom = -1.f + MAX(0, 2.f - bar_height) * frac;
-    glUniform4f(tint_program_layout.uniforms.edges, 1.f - bar_width, bottom + bar_height, 1.f, bottom);
-    draw_quad(true, 0);
+draw_scroll_indicator(color_type bar_color, GLfloat alpha, float frac, const WindowRenderData *srd, const OSWindow *os_window) {
+    const float cell_width = os_window->fonts_data->fcm.cell_width, cell_height = os_window->fonts_data->fcm.cell_height;
+    const float screen_height = srd->geometry.bottom - srd->geometry.top;
+    const float bar_width = 0.5f * cell_width, bar_height = cell_height;
+    const float top = srd->geometry.top + MAX(0, screen_height - bar_height) * (1.f - frac);
+    queue_ui_rect(srd->geometry.right - bar_width, top, bar_width, bar_height, os_window->viewport_height, -1.f, 0, bar_color, alpha, 0, 0);
     return true;
 }
 
@@ -772,24 +1211,34 @@ render_a_bar(const UIRenderData *ui, WindowBarData *bar, PyObject *title, bool a
 #define RGBCOL(which, fallback) ( 0xff000000 | colorprofile_to_color_with_fallback(ui->screen->color_profile, ui->screen->color_profile->overridden.which, ui->screen->color_profile->configured.which, ui->screen->color_profile->overridden.fallback, ui->screen->color_profile->configured.fallback))
     color_type fg = RGBCOL(default_fg, default_fg), bg = RGBCOL(default_bg, default_bg);
 #undef RGBCOL
-    if (bar->last_drawn_title_object_id != title || bar->needs_render) {
+    // the rendered title is kept in a texture until it changes
+    bool needs_upload = !bar->texture_id;
+    if (bar->last_drawn_title_object_id != title || bar->needs_render || bar->fg != fg || bar->bg != bg) {
         static char titlebuf[2048] = {0};
         if (!title) return 0;
         snprintf(titlebuf, arraysz(titlebuf), " %s", PyUnicode_AsUTF8(title));
         if (!draw_window_title(ui->os_window->fonts_data->font_sz_in_pts, ui->os_window->fonts_data->logical_dpi_y, titlebuf, fg, bg, bar->buf, bar_width, bar_height)) return 0;
         Py_CLEAR(bar->last_drawn_title_object_id);
         bar->last_drawn_title_object_id = Py_NewRef(title);
+        bar->needs_render = false; bar->fg = fg; bar->bg = bg;
+        needs_upload = true;
     }
-    static ImageRenderData data = {.group_count=1};
+    ImageRenderData data = {.group_count=1};
     gpu_data_for_image(&data, -1, 1, 1, -1);
-    glGenTextures(1, &data.texture_id);
-    glBindTexture(GL_TEXTURE_2D, data.texture_id);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB_ALPHA, bar_width, bar_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, bar->buf);
+    if (!bar->texture_id) {
+        glGenTextures(1, &bar->texture_id);
+        glBindTexture(GL_TEXTURE_2D, bar->texture_id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    data.texture_id = bar->texture_id;
+    if (needs_upload) {
+        glBindTexture(GL_TEXTURE_2D, bar->texture_id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB_ALPHA, bar_width, bar_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, bar->buf);
+    }
     bind_program(GRAPHICS_PROGRAM);
     Viewport border_rect = {
         .height=bar_height + 2 * border_width, .left=ui->screen_left, .width=ui->screen_width, .top=ui->screen_top};
@@ -804,7 +1253,6 @@ render_a_bar(const UIRenderData *ui, WindowBarData *bar, PyObject *title, bool a
         border_rect.left + border_width, border_rect.top + border_width, bar_width, bar_height, sh);
     draw_graphics(GRAPHICS_PROGRAM, &data, 0, 1, 1.f);
     restore_viewport();
-    free_texture(&data.texture_id);
     // finally draw border with transparent bg
     draw_rounded_rect(ui->os_window, border_rect, sh, 1, ui->cell_width, fg, bg, 0.f);
     return border_rect.height;
@@ -879,12 +1327,12 @@ draw_window_number(const UIRenderData *ui) {
 }
 
 static void
-draw_scrollbar(const UIRenderData *ui) {
-    if (!has_scrollbar(ui->screen)) return;
-    Screen *screen = ui->screen;
+draw_scrollbar(const WindowRenderData *srd, const OSWindow *os_window) {
+    Screen *screen = srd->screen;
+    if (!has_scrollbar(screen)) return;
     color_type bar_color = colorprofile_to_color(screen->color_profile, screen->color_profile->overridden.highlight_bg, screen->color_profile->configured.highlight_bg).rgb;
     float bar_frac = (float)screen->scrolled_by / (float)screen->historybuf->count;
-    draw_scroll_indicator(bar_color, OPT(scrollback_indicator_opacity), bar_frac, ui);
+    draw_scroll_indicator(bar_color, OPT(scrollback_indicator_opacity), bar_frac, srd, os_window);
 }
 
 static void
@@ -965,9 +1413,13 @@ draw_tint(const UIRenderData *ui) {
     draw_quad(true, 0);
 }
 
+// Whether the background tint of all windows in the OS window currently being
+// rendered was drawn together with the background image, see draw_bg_image()
+static bool tint_drawn_with_bg_image = false;
+
 static void
 draw_cells_with_layers(const UIRenderData *ui, ssize_t vao_idx) {
-    if (ui->has_background_image && OPT(background_tint) > 0) draw_tint(ui);
+    if (ui->has_background_image && OPT(background_tint) > 0 && !tint_drawn_with_bg_image) draw_tint(ui);
     const bool has_content_between_background_and_foreground = ui->window_logo != NULL || ui->grd.num_of_below_refs > 0 || ui->grd.num_of_negative_refs > 0;
     if (has_content_between_background_and_foreground) {
         if (!ui->has_background_image) call_cell_program(CELL_BG_PROGRAM, ui, vao_idx, false, DRAW_DEFAULT_BG);
@@ -986,7 +1438,6 @@ draw_cells_with_layers(const UIRenderData *ui, ssize_t vao_idx) {
             ui->grd.num_of_positive_refs, ui->inactive_text_alpha);
 
     draw_visual_bell(ui);
-    draw_scrollbar(ui);
     draw_hyperlink_target(ui);
     draw_window_number(ui);
 }
@@ -1011,13 +1462,19 @@ bool
 send_cell_data_to_gpu(ssize_t vao_idx, Screen *screen, OSWindow *os_window) {
     bool changed = false;
     if (os_window->fonts_data) {
-        if (cell_prepare_to_render(vao_idx, screen, os_window->fonts_data)) changed = true;
+        if (cell_prepare_to_render(vao_idx, screen, os_window->fonts_data, os_window->id)) changed = true;
+        SpriteMap *sm = (SpriteMap*)os_window->fonts_data->sprite_map;
+        if (sm && sm->pending.count) {
+            const monotonic_t started_at = monotonic();
+            flush_pending_sprites(os_window->fonts_data);
+            record_frame_timing(FRAME_STAGE_SPRITE_UPLOAD, os_window->id, started_at, monotonic());
+        }
     }
     return changed;
 }
 
-void
-draw_cells(const WindowRenderData *srd, OSWindow *os_window, bool is_active_window, bool is_tab_bar, bool is_single_window, Window *window) {
+static void
+render_cells(const WindowRenderData *srd, OSWindow *os_window, bool is_active_window, bool is_tab_bar, bool is_single_window, Window *window, bool into_layer_cache) {
     Screen *screen = srd->screen;
     CELL_BUFFERS;
     bind_vertex_array(srd->vao_idx);
@@ -1049,13 +1506,68 @@ draw_cells(const WindowRenderData *srd, OSWindow *os_window, bool is_active_wind
         .inactive_text_alpha = current_inactive_text_alpha, .has_background_image = has_bgimage(os_window),
         .background_color = default_bg, .bg_alpha=effective_os_window_alpha(os_window),
     };
+    if (into_layer_cache) {
+        // the layer cache framebuffer covers only the window
+        ui.screen_left = 0; ui.screen_top = 0;
+        ui.full_framebuffer_width = ui.screen_width; ui.full_framebuffer_height = ui.screen_height;
+    }
     screen->reload_all_gpu_data = false;
     save_viewport_using_top_left_origin(
         ui.screen_left, ui.screen_top, ui.screen_width, ui.screen_height, ui.full_framebuffer_height);
     if (ui.os_window->needs_layers) draw_cells_with_layers(&ui, srd->vao_idx);
     else draw_cells_without_layers(&ui, srd->vao_idx);
+    if (use_persistent_buffers()) fence_vao_buffer_regions(srd->vao_idx);
     restore_viewport();
 }
+
+static bool
+can_use_layer_cache(const WindowRenderData *srd, OSWindow *os_window, Window *window) {
+    // Since rendering in layers composites pre-multiplied colors, rendering a
+    // window into a transparent texture and then compositing that texture is
+    // the same as rendering it directly. The exceptions are the window bars,
+    // which replace what is under them rather than compositing over it.
+    return window && os_window->needs_layers && !has_hyperlink_target(os_window, window, srd->screen) && !has_window_number(window, srd->screen) && !has_visual_bell(srd->screen);
+}
+
+void
+draw_cells(const WindowRenderData *srd, OSWindow *os_window, bool is_active_window, bool is_tab_bar, bool is_single_window, Window *window) {
+    // the scroll indicator is drawn with the other queued UI rects, after the cells
+    if (!is_tab_bar && os_window->needs_layers) draw_scrollbar(srd, os_window);
+    if (is_tab_bar || !can_use_layer_cache(srd, os_window, window)) {
+        if (window) window->layer_cache.is_valid = false;
+        render_cells(srd, os_window, is_active_window, is_tab_bar, is_single_window, window, false);
+        return;
+    }
+    const unsigned width = srd->geometry.right - srd->geometry.left, height = srd->geometry.bottom - srd->geometry.top;
+    if (!width || !height) return;
+#define lc window->layer_cache
+    if (lc.width != width || lc.height != height) {
+        if (lc.texture_id) free_texture(&lc.texture_id);
+        if (lc.framebuffer_id) free_framebuffer(&lc.framebuffer_id);
+        lc.is_valid = false;
+    }
+    if (!lc.texture_id) {
+        lc.width = width; lc.height = height;
+        setup_texture_as_render_target(width, height, &lc.texture_id, &lc.framebuffer_id);
+    }
+    // Anything that damages the whole OS window, such as a change in focus, can
+    // change how the window is rendered
+    if (!lc.is_valid || lc.needs_render || os_window->damage.full) {
+        bind_framebuffer_for_output(lc.framebuffer_id);
+        save_viewport_using_bottom_left_origin(0, 0, width, height);
+        clear_current_framebuffer();
+        render_cells(srd, os_window, is_active_window, is_tab_bar, is_single_window, window, true);
+        restore_viewport();
+        bind_framebuffer_for_output(0);
+        lc.is_valid = true; lc.needs_render = false;
+    }
+    // The texture has its origin at the bottom left
+    ImageRenderData data = {.src_rect={.left=0, .top=1, .right=1, .bottom=0}, .dest_rect={.left=-1, .top=1, .right=1, .bottom=-1}, .texture_id=lc.texture_id, .group_count=1};
+    save_viewport_using_top_left_origin(srd->geometry.left, srd->geometry.top, width, height, os_window->viewport_height);
+    draw_graphics(GRAPHICS_PREMULT_PROGRAM, &data, 0, 1, 1.f);
+    restore_viewport();
+#undef lc
+}
 // }}}
 
 // Borders {{{
@@ -1140,8 +1652,39 @@ draw_cursor_trail(CursorTrail *trail, Window *active_window) {
 // }}}
 
 // OSWindow {{{
+#define MAX_TINT_RECTS 32
+
+static unsigned
+collect_tint_rects(OSWindow *os_window, GLfloat *rects, GLfloat *colors) {
+    // Since windows do not overlap, tinting all of them before drawing any
+    // cells is the same as tinting each just before drawing its cells.
+    // Returns MAX_TINT_RECTS + 1 if there are too many windows.
+    unsigned n = 0;
+    const GLfloat alpha = OPT(background_tint), vh = os_window->viewport_height;
+#define add(rd) { \
+    const WindowRenderData *r = &(rd); \
+    if (r->geometry.right > r->geometry.left && r->geometry.bottom > r->geometry.top) { \
+        if (n >= MAX_TINT_RECTS) return MAX_TINT_RECTS + 1; \
+        GLfloat *rect = rects + 4 * n, *color = colors + 4 * n++; \
+        rect[0] = r->geometry.left; rect[1] = vh - r->geometry.bottom; rect[2] = r->geometry.right; rect[3] = vh - r->geometry.top; \
+        ColorProfile *cp = r->screen->paused_rendering.expires_at ? &r->screen->paused_rendering.color_profile : r->screen->color_profile; \
+        linear_color(color, colorprofile_to_color(cp, cp->overridden.default_bg, cp->configured.default_bg).rgb, alpha); \
+        color[0] *= alpha; color[1] *= alpha; color[2] *= alpha; \
+    } \
+}
+    if (tab_bar_is_shown(os_window)) add(os_window->tab_bar_render_data);
+    Tab *tab = os_window->tabs + os_window->active_tab;
+    for (unsigned i = 0; i < tab->num_windows; i++) {
+        Window *w = tab->windows + i;
+        if (w->visible && w->render_data.screen) add(w->render_data);
+    }
+#undef add
+    return n;
+}
+
 static void
 draw_bg_image(OSWindow *os_window) {
+    tint_drawn_with_bg_image = false;
     if (!has_bgimage(os_window)) return;
     BackgroundImageRenderSettings s = {
         .os_window.width = os_window->viewport_width, .os_window.height = os_window->viewport_height,
@@ -1183,6 +1726,20 @@ draw_bg_image(OSWindow *os_window) {
     glUniform4f(bgimage_program_layout.uniforms.positions, left, top, right, bottom);
     glUniform1i(bgimage_program_layout.uniforms.image, GRAPHICS_UNIT);
     color_vec4(bgimage_program_layout.uniforms.background, s.bgcolor, s.opacity);
+    // Draw the tint of the windows in this pass rather than with a separate
+    // blended full window pass per window
+    GLfloat tint_rects[4 * MAX_TINT_RECTS], tint_colors[4 * MAX_TINT_RECTS];
+    unsigned num_tint_rects = 0;
+    if (OPT(background_tint) > 0 && os_window->num_tabs) {
+        num_tint_rects = collect_tint_rects(os_window, tint_rects, tint_colors);
+        if (num_tint_rects > MAX_TINT_RECTS) num_tint_rects = 0;
+        else tint_drawn_with_bg_image = true;
+    }
+    glUniform1i(bgimage_program_layout.uniforms.num_tint_rects, num_tint_rects);
+    if (num_tint_rects) {
+        glUniform4fv(bgimage_program_layout.uniforms.tint_rects, num_tint_rects, tint_rects);
+        glUniform4fv(bgimage_program_layout.uniforms.tint_colors, num_tint_rects, tint_colors);
+    }
     glActiveTexture(GL_TEXTURE0 + GRAPHICS_UNIT);
     glBindTexture(GL_TEXTURE_2D, os_window->bgimage->texture_id);
     draw_quad(false, 0);
@@ -1210,15 +1767,24 @@ draw_centered_alpha_mask(size_t screen_width, size_t screen_height, size_t width
 
 static void
 draw_resizing_text(OSWindow *w) {
+    // drawn every frame during a live resize but the text only changes when
+    // the number of cells does
+    static struct {
+        char text[32];
+        double font_sz_in_pts, logical_dpi_y;
+        StringCanvas rendered;
+    } cache = {0};
     if (monotonic() - w->created_at > ms_to_monotonic_t(1000) && w->live_resize.num_of_resize_events > 1) {
         char text[32] = {0};
         unsigned int width = w->live_resize.width, height = w->live_resize.height;
         snprintf(text, sizeof(text), "%u x %u cells", width / w->fonts_data->fcm.cell_width, height / w->fonts_data->fcm.cell_height);
-        StringCanvas rendered = render_simple_text(w->fonts_data, text);
-        if (rendered.canvas) {
-            draw_centered_alpha_mask(width, height, rendered.width, rendered.height, rendered.canvas, OPT(background_opacity));
-            free(rendered.canvas);
+        if (!cache.rendered.canvas || strcmp(text, cache.text) != 0 || cache.font_sz_in_pts != w->fonts_data->font_sz_in_pts || cache.logical_dpi_y != w->fonts_data->logical_dpi_y) {
+            free(cache.rendered.canvas);
+            cache.rendered = render_simple_text(w->fonts_data, text);
+            memcpy(cache.text, text, sizeof(text));
+            cache.font_sz_in_pts = w->fonts_data->font_sz_in_pts; cache.logical_dpi_y = w->fonts_data->logical_dpi_y;
         }
+        if (cache.rendered.canvas) draw_centered_alpha_mask(width, height, cache.rendered.width, cache.rendered.height, cache.rendered.canvas, OPT(background_opacity));
     }
 }
 
@@ -1263,6 +1829,7 @@ start_os_window_rendering(OSWindow *os_window) {
 
 static void
 stop_os_window_rendering(OSWindow *os_window, Tab *tab, Window *active_window) {
+    draw_queued_ui_rects(os_window);
     if (OPT(cursor_trail) && tab->cursor_trail.needs_render) draw_cursor_trail(&tab->cursor_trail, active_window);
     if (os_window->needs_layers) {
         set_framebuffer_to_use_for_output(0);
@@ -1309,19 +1876,61 @@ attach_shaders(PyObject *sources, GLuint program_id, GLenum shader_type) {
     return true;
 }
 
+static bool
+load_program_binary(GLuint program_id, PyObject *cached_binary) {
+    // cached_binary is the binary format followed by the binary as returned by program_binary()
+    const char *data = PyBytes_AS_STRING(cached_binary);
+    const Py_ssize_t sz = PyBytes_GET_SIZE(cached_binary);
+    if (!GLAD_GL_ARB_get_program_binary || sz <= (Py_ssize_t)sizeof(GLenum)) return false;
+    GLenum format; memcpy(&format, data, sizeof(format));
+    glProgramBinary(program_id, format, data + sizeof(format), sz - sizeof(format));
+    GLint ret = GL_FALSE;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &ret);
+    // drivers reject binaries from other driver versions or hardware, the program is then linked from source
+    return ret == GL_TRUE;
+}
+
+static PyObject*
+program_binary(GLuint program_id) {
+    GLint sz = 0;
+    if (!GLAD_GL_ARB_get_program_binary) Py_RETURN_NONE;
+    glGetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &sz);
+    if (sz <= 0) Py_RETURN_NONE;
+    RAII_PyObject(ans, PyBytes_FromStringAndSize(NULL, sizeof(GLenum) + sz));
+    if (!ans) return NULL;
+    char *data = PyBytes_AS_STRING(ans);
+    GLenum format = 0; GLsizei len = 0;
+    glGetProgramBinary(program_id, sz, &len, &format, data + sizeof(format));
+    if (len <= 0) Py_RETURN_NONE;
+    memcpy(data, &format, sizeof(format));
+    if (len < sz && _PyBytes_Resize(&ans, sizeof(format) + len) != 0) return NULL;
+    Py_INCREF(ans);
+    return ans;
+}
+
 static PyObject*
 compile_program(PyObject UNUSED *self, PyObject *args) {
-    PyObject *vertex_shaders, *fragment_shaders;
+    PyObject *vertex_shaders, *fragment_shaders, *cached_binary = Py_None;
     int which, allow_recompile = 0;
-    if (!PyArg_ParseTuple(args, "iO!O!|p", &which, &PyTuple_Type, &vertex_shaders, &PyTuple_Type, &fragment_shaders, &allow_recompile)) return NULL;
+    if (!PyArg_ParseTuple(args, "iO!O!|pO", &which, &PyTuple_Type, &vertex_shaders, &PyTuple_Type, &fragment_shaders, &allow_recompile, &cached_binary)) return NULL;
     if (which < 0 || which >= NUM_PROGRAMS) { PyErr_Format(PyExc_ValueError, "Unknown program: %d", which); return NULL; }
+    if (cached_binary != Py_None && !PyBytes_Check(cached_binary)) { PyErr_SetString(PyExc_TypeError, "cached_binary must be bytes"); return NULL; }
     Program *program = program_ptr(which);
     if (program->id != 0) {
         if (allow_recompile) { glDeleteProgram(program->id); program->id = 0; }
         else { PyErr_SetString(PyExc_ValueError, "program already compiled"); return NULL; }
     }
-#define fail_compile() { glDeleteProgram(program->id); return NULL; }
+    if (cached_binary != Py_None) {
+        program->id = glCreateProgram();
+        if (load_program_binary(program->id, cached_binary)) {
+            init_uniforms(which);
+            return Py_BuildValue("IO", program->id, Py_None);
+        }
+        glDeleteProgram(program->id);
+    }
+#define fail_compile() { glDeleteProgram(program->id); program->id = 0; return NULL; }
     program->id = glCreateProgram();
+    if (GLAD_GL_ARB_get_program_binary) glProgramParameteri(program->id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     if (!attach_shaders(vertex_shaders, program->id, GL_VERTEX_SHADER)) fail_compile();
     if (!attach_shaders(fragment_shaders, program->id, GL_FRAGMENT_SHADER)) fail_compile();
     glLinkProgram(program->id);
@@ -1336,7 +1945,9 @@ compile_program(PyObject UNUSED *self, PyObject *args) {
     }
 #undef fail_compile
     init_uniforms(which);
-    return Py_BuildValue("I", program->id);
+    RAII_PyObject(binary, program_binary(program->id));
+    if (!binary) return NULL;
+    return Py_BuildValue("IO", program->id, binary);
 }
 
 #define PYWRAP0(name) static PyObject* py##name(PYNOARG)
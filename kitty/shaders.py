@@ -1,13 +1,16 @@
 #!/usr/bin/env python
 # License: GPLv3 Copyright: 2023, Kovid Goyal <kovid at kovidgoyal.net>
 
+import hashlib
+import os
 import re
 from collections.abc import Callable, Iterator
 from functools import lru_cache, partial
 from itertools import count
 from typing import Any, Literal, NamedTuple, Optional
 
-from .constants import read_kitty_resource
+from .config import atomic_save
+from .constants import cache_dir, read_kitty_resource
 from .fast_data_types import (
     BGIMAGE_PROGRAM,
     BLINK,
@@ -35,8 +38,40 @@
     TRAIL_PROGRAM,
     compile_program,
     get_options,
+    gpu_driver_version_string,
     init_cell_program,
 )
+from .utils import log_error
+
+
+@lru_cache(maxsize=2)
+def program_binary_cache_dir(driver_version: str) -> str:
+    # binaries are only valid for the driver that produced them
+    key = hashlib.sha1(driver_version.encode('utf-8')).hexdigest()
+    return os.path.join(cache_dir(), 'shaders', key)
+
+
+def cached_program_binary_path(vertex_sources: tuple[str, ...], fragment_sources: tuple[str, ...]) -> str:
+    h = hashlib.sha1()
+    for x in vertex_sources + ('\0',) + fragment_sources:
+        h.update(x.encode('utf-8'))
+    return os.path.join(program_binary_cache_dir(gpu_driver_version_string()), h.hexdigest())
+
+
+def read_cached_program_binary(path: str) -> bytes | None:
+    try:
+        with open(path, 'rb') as f:
+            return f.read()
+    except OSError:
+        return None
+
+
+def save_program_binary(path: str, data: bytes) -> None:
+    try:
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        atomic_save(data, path)
+    except OSError as err:
+        log_error(f'Failed to cache compiled shaders to {path} with error: {err}')
 
 
 def identity(x: str) -> str:
@@ -93,8 +128,12 @@ def apply_to_sources(self, vertex: Callable[[str], str] = identity, frag: Callab
 
     def compile(self, program_id: int, allow_recompile: bool = False) -> None:
         cerr: CompileError = CompileError()
+        cache_path = cached_program_binary_path(self.vertex_sources, self.fragment_sources)
         try:
-            compile_program(program_id, self.vertex_sources, self.fragment_sources, allow_recompile)
+            _, binary = compile_program(
+                program_id, self.vertex_sources, self.fragment_sources, allow_recompile, read_cached_program_binary(cache_path))
+            if binary is not None:
+                save_program_binary(cache_path, binary)
             return
         except ValueError as err:
             lines = str(err).splitlines()
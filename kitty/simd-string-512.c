@@ -0,0 +1,14 @@
+/*
+ * simd-string-512.c
+ * Copyright (C) 2024 Kovid Goyal <kovid at kovidgoyal.net>
+ *
+ * Distributed under terms of the GPL3 license.
+ */
+
+#if !defined(__x86_64__) && !defined(__i386__) && !defined(KITTY_NO_SIMD)
+// 512 bit registers are only available natively on x86, elsewhere they
+// would be emulated with no benefit over the 256 bit code
+#define KITTY_NO_SIMD
+#endif
+#define KITTY_SIMD_LEVEL 512
+#include "simd-string-impl.h"
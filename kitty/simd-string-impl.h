@@ -20,7 +20,12 @@
 #define NOSIMD { fatal("No SIMD implementations for this CPU"); }
 bool FUNC(utf8_decode_to_esc)(UTF8Decoder *d UNUSED, const uint8_t *src UNUSED, size_t src_sz UNUSED) NOSIMD
 const uint8_t* FUNC(find_either_of_two_bytes)(const uint8_t *haystack UNUSED, const size_t sz UNUSED, const uint8_t a UNUSED, const uint8_t b UNUSED) NOSIMD
+const uint8_t* FUNC(find_end_of_csi_params)(const uint8_t *haystack UNUSED, const size_t sz UNUSED) NOSIMD
 void FUNC(xor_data64)(const uint8_t key[64] UNUSED, uint8_t* data UNUSED, const size_t data_sz UNUSED) NOSIMD
+#if KITTY_SIMD_LEVEL <= 256
+void FUNC(alpha_blend_rgba)(uint8_t *dest UNUSED, const uint8_t *src UNUSED, const size_t num_pixels UNUSED) NOSIMD
+void FUNC(blend_rgba_on_rgb)(uint8_t *dest UNUSED, const uint8_t *src UNUSED, const size_t num_pixels UNUSED) NOSIMD
+#endif
 #undef NOSIMD
 #else
 
@@ -33,7 +38,11 @@ START_IGNORE_DIAGNOSTIC("-Wpedantic")
 _Pragma("clang diagnostic push")
 _Pragma("clang diagnostic ignored \"-Wbitwise-instead-of-logical\"")
 #endif
+#if KITTY_SIMD_LEVEL == 512
+#include <simde/x86/avx512.h>
+#else
 #include <simde/x86/avx2.h>
+#endif
 #include <simde/arm/neon.h>
 #if  defined(__clang__) && __clang_major__ > 13
 _Pragma("clang diagnostic pop")
@@ -41,6 +50,10 @@ _Pragma("clang diagnostic pop")
 END_IGNORE_DIAGNOSTIC
 END_IGNORE_DIAGNOSTIC
 
+#if (defined(__arm64__) || defined(__aarch64__)) && !defined(SIMDE_ARM_NEON_A64V8_NATIVE)
+#error "simde is not using native NEON instructions, check the compiler flags"
+#endif
+
 
 #ifndef _MM_SHUFFLE
 #define _MM_SHUFFLE(z, y, x, w) (((z) << 6) | ((y) << 4) | ((x) << 2) | (w))
@@ -110,8 +123,9 @@ w(left, sixteen_bytes, 16)
 #undef R
 #undef shift_right_by_bytes_macro
 #undef shift_left_by_bytes_macro
+#define movemask_t int32_t
 
-#else
+#elif KITTY_SIMD_LEVEL == 256
 
 #if defined(SIMDE_ARCH_AMD64) || defined(SIMDE_ARCH_X86)
 #define zero_upper _mm256_zeroupper
@@ -217,6 +231,114 @@ static inline integer_t shuffle_impl256(const integer_t value, const integer_t s
 
 #define shuffle_epi8 shuffle_impl256
 #define sum_bytes(x) (sum_bytes_128(simde_mm256_extracti128_si256(x, 0)) + sum_bytes_128(simde_mm256_extracti128_si256(x, 1)))
+#define movemask_t int32_t
+
+#else
+
+// Needs AVX-512 F, BW and VBMI, the latter for the full width byte shuffle
+#if defined(SIMDE_ARCH_AMD64) || defined(SIMDE_ARCH_X86)
+#define zero_upper _mm256_zeroupper
+#else
+#define zero_upper()
+#endif
+#define set1_epi8(x) simde_mm512_set1_epi8((char)(x))
+#define set_epi8 simde_mm512_set_epi8
+#define add_epi8 simde_mm512_add_epi8
+#define load_unaligned simde_mm512_loadu_si512
+#define load_aligned(x) simde_mm512_load_si512((const void*)(x))
+#define store_unaligned simde_mm512_storeu_si512
+#define store_aligned(dest, vec) simde_mm512_store_si512((void*)dest, vec)
+// AVX-512 comparisons produce bitmasks, expand them back into vectors so
+// that the algorithms are the same as for the other register widths
+#define cmpeq_epi8(a, b) simde_mm512_movm_epi8(simde_mm512_cmpeq_epi8_mask(a, b))
+#define cmpgt_epi8(a, b) simde_mm512_movm_epi8(simde_mm512_cmpgt_epi8_mask(a, b))
+#define cmplt_epi8(a, b) cmpgt_epi8(b, a)
+#define or_si simde_mm512_or_si512
+#define and_si simde_mm512_and_si512
+#define xor_si simde_mm512_xor_si512
+#define andnot_si simde_mm512_andnot_si512
+#define movemask_epi8 simde_mm512_movepi8_mask
+#define blendv_epi8(a, b, mask) simde_mm512_mask_blend_epi8(simde_mm512_movepi8_mask(mask), a, b)
+#define subtract_saturate_epu8 simde_mm512_subs_epu8
+#define subtract_epi8 simde_mm512_sub_epi8
+#define shift_left_by_bits16 simde_mm512_slli_epi16
+#define shift_right_by_bits32 simde_mm512_srli_epi32
+#define create_zero_integer simde_mm512_setzero_si512
+#define create_all_ones_integer() simde_mm512_set1_epi64(-1)
+#define numbered_bytes() set_epi8( \
+        63,62,61,60,59,58,57,56,55,54,53,52,51,50,49,48,47,46,45,44,43,42,41,40,39,38,37,36,35,34,33,32, \
+        31,30,29,28,27,26,25,24,23,22,21,20,19,18,17,16,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0)
+#define shuffle_epi8(value, shuffle) simde_mm512_permutexvar_epi8(shuffle, value)
+#define sum_bytes(x) ((unsigned)simde_mm512_reduce_add_epi64(simde_mm512_sad_epu8(x, simde_mm512_setzero_si512())))
+#define movemask_t uint64_t
+
+static inline int
+FUNC(is_zero)(const integer_t a) { return simde_mm512_test_epi64_mask(a, a) == 0; }
+
+// Byte shifts across the full register are done by shifting whole 128 bit
+// lanes and then combining adjacent lanes with alignr
+static inline integer_t
+shift_up_by_lanes(const integer_t A, unsigned n) {
+    const integer_t zero = simde_mm512_setzero_si512();
+    switch (n) {
+        case 0: return A;
+        case 1: return simde_mm512_alignr_epi64(A, zero, 6);
+        case 2: return simde_mm512_alignr_epi64(A, zero, 4);
+        case 3: return simde_mm512_alignr_epi64(A, zero, 2);
+        default: return zero;
+    }
+}
+
+static inline integer_t
+shift_down_by_lanes(const integer_t A, unsigned n) {
+    const integer_t zero = simde_mm512_setzero_si512();
+    switch (n) {
+        case 0: return A;
+        case 1: return simde_mm512_alignr_epi64(zero, A, 2);
+        case 2: return simde_mm512_alignr_epi64(zero, A, 4);
+        case 3: return simde_mm512_alignr_epi64(zero, A, 6);
+        default: return zero;
+    }
+}
+
+#define GA(LA) LA(1) LA(2) LA(3) LA(4) LA(5) LA(6) LA(7) LA(8) LA(9) LA(10) LA(11) LA(12) LA(13) LA(14) LA(15)
+#define RA(n) case n: return simde_mm512_alignr_epi8(hi, lo, 16 - n);
+#define LA(n) case n: return simde_mm512_alignr_epi8(hi, lo, n);
+
+static inline integer_t
+shift_right_by_bytes(const integer_t A, unsigned n) {
+    const integer_t hi = shift_up_by_lanes(A, n / 16);
+    if (!(n % 16)) return hi;
+    const integer_t lo = shift_up_by_lanes(A, n / 16 + 1);
+    switch (n % 16) { default: return hi; GA(RA) }
+}
+
+static inline integer_t
+shift_left_by_bytes(const integer_t A, unsigned n) {
+    const integer_t lo = shift_down_by_lanes(A, n / 16);
+    if (!(n % 16)) return lo;
+    const integer_t hi = shift_down_by_lanes(A, n / 16 + 1);
+    switch (n % 16) { default: return lo; GA(LA) }
+}
+#undef GA
+#undef RA
+#undef LA
+
+#define w(dir, word, num) static inline integer_t shift_##dir##_by_##word(const integer_t A) { return shift_##dir##_by_bytes(A, num); }
+
+w(right, one_byte, 1)
+w(right, two_bytes, 2)
+w(right, four_bytes, 4)
+w(right, eight_bytes, 8)
+w(right, sixteen_bytes, 16)
+w(right, thirty_two_bytes, 32)
+w(left, one_byte, 1)
+w(left, two_bytes, 2)
+w(left, four_bytes, 4)
+w(left, eight_bytes, 8)
+w(left, sixteen_bytes, 16)
+w(left, thirty_two_bytes, 32)
+#undef w
 #endif
 
 #define print_register_as_bytes(r) { \
@@ -238,7 +360,22 @@ static inline integer_t shuffle_impl256(const integer_t value, const integer_t s
 #define debug(...)
 #endif
 
-#if (defined(__arm64__) && defined(__APPLE__)) || defined(__aarch64__)
+#if KITTY_SIMD_LEVEL == 512
+
+static inline int
+bytes_to_first_match(const integer_t vec) {
+    const uint64_t mask = movemask_epi8(vec);
+    return mask ? __builtin_ctzll(mask) : -1;
+}
+
+static inline int
+bytes_to_first_match_ignoring_leading_n(const integer_t vec, const uintptr_t num_ignored) {
+    uint64_t mask = movemask_epi8(vec);
+    mask >>= num_ignored;
+    return mask ? __builtin_ctzll(mask) : -1;
+}
+
+#elif (defined(__arm64__) && defined(__APPLE__)) || defined(__aarch64__)
 // See https://community.arm.com/arm-community-blogs/b/infrastructure-solutions-blog/posts/porting-x86-vector-bitmask-optimizations-to-arm-neon
 
 static inline uint64_t
@@ -328,7 +465,10 @@ FUNC(xor_data64)(const uint8_t key[KEY_SIZE], uint8_t* data, const size_t data_s
     memcpy(aligned_key, key + unaligned_bytes, KEY_SIZE - unaligned_bytes);
     memcpy(aligned_key + KEY_SIZE - unaligned_bytes, key, unaligned_bytes);
 
-    const integer_t v1 = load_aligned(aligned_key), v2 = load_aligned(aligned_key + sizeof(integer_t));
+    const integer_t v1 = load_aligned(aligned_key);
+#if KITTY_SIMD_LEVEL <= 256
+    const integer_t v2 = load_aligned(aligned_key + sizeof(integer_t));
+#endif
 #if KITTY_SIMD_LEVEL == 128
     const integer_t v3 = load_aligned(aligned_key + 2*sizeof(integer_t)), v4 = load_aligned(aligned_key + 3 * sizeof(integer_t));
 #endif
@@ -340,7 +480,10 @@ FUNC(xor_data64)(const uint8_t key[KEY_SIZE], uint8_t* data, const size_t data_s
     // p is aligned to first KEY_SIZE boundary >= data and limit is aligned to first KEY_SIZE boundary <= (data + data_sz)
 #define do_one(which) d = load_aligned(p); store_aligned(p, xor_si(which, d)); p += sizeof(integer_t);
     while (p < limit) {
-        do_one(v1); do_one(v2);
+        do_one(v1);
+#if KITTY_SIMD_LEVEL <= 256
+        do_one(v2);
+#endif
 #if KITTY_SIMD_LEVEL == 128
         do_one(v3); do_one(v4);
 #endif
@@ -352,6 +495,133 @@ FUNC(xor_data64)(const uint8_t key[KEY_SIZE], uint8_t* data, const size_t data_s
 }
 #undef KEY_SIZE
 
+// Alpha blending {{{
+#if KITTY_SIMD_LEVEL <= 256
+// Every 128 bit lane holds four pixels, which are split into one float vector
+// per color channel so that exactly the same operations as in the scalar code
+// are performed on them. The 512 bit level uses the 256 bit code as these are
+// bound by the float divisions, not by the memory bandwidth.
+#define pixels_per_vec (sizeof(integer_t) / 4)
+#if KITTY_SIMD_LEVEL == 128
+#define float_t simde__m128
+#define set1_ps simde_mm_set1_ps
+#define add_ps simde_mm_add_ps
+#define sub_ps simde_mm_sub_ps
+#define mul_ps simde_mm_mul_ps
+#define div_ps simde_mm_div_ps
+#define cvtepi32_ps simde_mm_cvtepi32_ps
+#define cvttps_epi32 simde_mm_cvttps_epi32
+#define cmpeq_epi32 simde_mm_cmpeq_epi32
+#define shift_left_by_bits32 simde_mm_slli_epi32
+#define shuffle_lanes_epi8 simde_mm_shuffle_epi8
+#define lane_bytes(...) simde_mm_setr_epi8(__VA_ARGS__)
+// RGB pixels are loaded 16 bytes at a time but only 12 are used
+#define load_rgb(p) simde_mm_loadu_si128((const integer_t*)(p))
+#define store_rgb(p, v) simde_mm_storeu_si128((integer_t*)(p), v)
+#else
+#define float_t simde__m256
+#define set1_ps simde_mm256_set1_ps
+#define add_ps simde_mm256_add_ps
+#define sub_ps simde_mm256_sub_ps
+#define mul_ps simde_mm256_mul_ps
+#define div_ps simde_mm256_div_ps
+#define cvtepi32_ps simde_mm256_cvtepi32_ps
+#define cvttps_epi32 simde_mm256_cvttps_epi32
+#define cmpeq_epi32 simde_mm256_cmpeq_epi32
+#define shift_left_by_bits32 simde_mm256_slli_epi32
+#define shuffle_lanes_epi8 simde_mm256_shuffle_epi8
+#define lane_bytes(...) simde_mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+// The lanes are loaded separately so that each holds four RGB pixels, the
+// second store overwrites the four unused bytes of the first one
+#define load_rgb(p) simde_mm256_set_m128i(simde_mm_loadu_si128((const simde__m128i*)((p) + 12)), simde_mm_loadu_si128((const simde__m128i*)(p)))
+#define store_rgb(p, v) { \
+    simde_mm_storeu_si128((simde__m128i*)(p), simde_mm256_castsi256_si128(v)); \
+    simde_mm_storeu_si128((simde__m128i*)((p) + 12), simde_mm256_extracti128_si256(v, 1)); \
+}
+#endif
+#define rgba_channel(c) lane_bytes(c, -1, -1, -1, 4 + c, -1, -1, -1, 8 + c, -1, -1, -1, 12 + c, -1, -1, -1)
+#define rgb_channel(c) lane_bytes(c, -1, -1, -1, 3 + c, -1, -1, -1, 6 + c, -1, -1, -1, 9 + c, -1, -1, -1)
+
+static inline float_t
+FUNC(channel_as_floats)(const integer_t px, const integer_t channel_mask) {
+    return cvtepi32_ps(shuffle_lanes_epi8(px, channel_mask));
+}
+#define channel(px, mask) FUNC(channel_as_floats)(px, mask)
+
+static inline integer_t
+FUNC(pack_channels)(const integer_t r, const integer_t g, const integer_t b) {
+    return or_si(or_si(r, shift_left_by_bits32(g, 8)), shift_left_by_bits32(b, 16));
+}
+
+void
+FUNC(alpha_blend_rgba)(uint8_t *dest, const uint8_t *src, const size_t num_pixels) {
+    const integer_t red = rgba_channel(0), green = rgba_channel(1), blue = rgba_channel(2), alpha_channel = rgba_channel(3);
+    const integer_t zero = create_zero_integer();
+    const float_t one = set1_ps(1.f), max = set1_ps(255.f);
+    size_t p = 0;
+    for (; p + pixels_per_vec <= num_pixels; p += pixels_per_vec, dest += sizeof(integer_t), src += sizeof(integer_t)) {
+        const integer_t s = load_unaligned((const integer_t*)src), d = load_unaligned((const integer_t*)dest);
+        const integer_t src_alpha = shuffle_lanes_epi8(s, alpha_channel);
+        const float_t src_a = div_ps(cvtepi32_ps(src_alpha), max), dest_a = div_ps(channel(d, alpha_channel), max);
+        const float_t src_a_op = sub_ps(one, src_a);
+        const float_t alpha = add_ps(src_a, mul_ps(dest_a, src_a_op));
+        const integer_t out_a = cvttps_epi32(mul_ps(max, alpha));
+#define blend(mask) cvttps_epi32(div_ps(add_ps(mul_ps(channel(s, mask), src_a), mul_ps(mul_ps(channel(d, mask), dest_a), src_a_op)), alpha))
+        integer_t ans = or_si(FUNC(pack_channels)(blend(red), blend(green), blend(blue)), shift_left_by_bits32(out_a, 24));
+#undef blend
+        // pixels that end up fully transparent become zero
+        ans = andnot_si(cmpeq_epi32(out_a, zero), ans);
+        // pixels under fully transparent source pixels are unchanged
+        ans = blendv_epi8(ans, d, cmpeq_epi32(src_alpha, zero));
+        store_unaligned((integer_t*)dest, ans);
+    }
+    zero_upper();
+    alpha_blend_rgba_scalar(dest, src, num_pixels - p);
+}
+
+void
+FUNC(blend_rgba_on_rgb)(uint8_t *dest, const uint8_t *src, const size_t num_pixels) {
+    const integer_t red = rgba_channel(0), green = rgba_channel(1), blue = rgba_channel(2), alpha_channel = rgba_channel(3);
+    const integer_t dest_red = rgb_channel(0), dest_green = rgb_channel(1), dest_blue = rgb_channel(2);
+    const integer_t compact = lane_bytes(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const integer_t unused_bytes = lane_bytes(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1, -1, -1, -1);
+    const float_t one = set1_ps(1.f), max = set1_ps(255.f);
+    size_t p = 0;
+    // load_rgb() reads four bytes past the last pixel in a vector
+    for (; p + pixels_per_vec + 2 <= num_pixels; p += pixels_per_vec, dest += 3 * pixels_per_vec, src += sizeof(integer_t)) {
+        const integer_t s = load_unaligned((const integer_t*)src), d = load_rgb(dest);
+        const float_t alpha = div_ps(channel(s, alpha_channel), max);
+        const float_t alpha_op = sub_ps(one, alpha);
+#define blend(mask, dest_mask) cvttps_epi32(add_ps(mul_ps(channel(s, mask), alpha), mul_ps(channel(d, dest_mask), alpha_op)))
+        const integer_t ans = shuffle_lanes_epi8(FUNC(pack_channels)(blend(red, dest_red), blend(green, dest_green), blend(blue, dest_blue)), compact);
+#undef blend
+        store_rgb(dest, blendv_epi8(ans, d, unused_bytes));
+    }
+    zero_upper();
+    blend_rgba_on_rgb_scalar(dest, src, num_pixels - p);
+}
+
+#undef pixels_per_vec
+#undef float_t
+#undef set1_ps
+#undef add_ps
+#undef sub_ps
+#undef mul_ps
+#undef div_ps
+#undef cvtepi32_ps
+#undef cvttps_epi32
+#undef cmpeq_epi32
+#undef shift_left_by_bits32
+#undef shuffle_lanes_epi8
+#undef lane_bytes
+#undef load_rgb
+#undef store_rgb
+#undef rgba_channel
+#undef rgb_channel
+#undef channel
+#endif
+// }}}
+
 #define check_chunk() if (n > -1) { \
     const uint8_t *ans = haystack + n; \
     zero_upper(); \
@@ -390,6 +660,17 @@ FUNC(find_either_of_two_bytes)(const uint8_t *haystack, const size_t sz, const u
 #undef get_test_from_chunk
 }
 
+const uint8_t*
+FUNC(find_end_of_csi_params)(const uint8_t *haystack, const size_t sz) {
+    if (!sz) return NULL;
+    // CSI parameter bytes are the contiguous range 0-9:; so after subtracting '0' any byte
+    // greater than 11 (with wraparound) is not a parameter byte
+    const integer_t zero_char = set1_epi8('0'), max_param = set1_epi8(11), zero = create_zero_integer();
+#define get_test_from_chunk(chunk) (cmpeq_epi8(cmpeq_epi8(subtract_saturate_epu8(subtract_epi8(chunk, zero_char), max_param), zero), zero))
+    find_match(haystack, sz, get_test_from_chunk);
+#undef get_test_from_chunk
+}
+
 #undef check_chunk
 
 #define output_increment sizeof(integer_t)/sizeof(uint32_t)
@@ -403,6 +684,13 @@ FUNC(output_plain_ascii)(UTF8Decoder *d, integer_t vec, size_t src_sz) {
         store_unaligned((integer_t*)p, unpacked);
         vec = shift_right_by_bytes128(vec, output_increment);
     }
+#elif KITTY_SIMD_LEVEL == 512
+    uint32_t *p = d->output.storage + d->output.pos;
+    const uint32_t *limit = p + src_sz;
+#define chunk(which) if (p < limit) { \
+    store_unaligned((integer_t*)p, simde_mm512_cvtepu8_epi32(simde_mm512_extracti32x4_epi32(vec, which))); p += output_increment; }
+    chunk(0); chunk(1); chunk(2); chunk(3);
+#undef chunk
 #else
     const uint32_t *p = d->output.storage + d->output.pos, *limit = p + src_sz;
     simde__m128i x = simde_mm256_extracti128_si256(vec, 0);
@@ -441,6 +729,16 @@ FUNC(output_unicode)(UTF8Decoder *d, integer_t output1, integer_t output2, integ
         output2 = shift_right_by_bytes128(output2, output_increment);
         output3 = shift_right_by_bytes128(output3, output_increment);
     }
+#elif KITTY_SIMD_LEVEL == 512
+    uint32_t *p = d->output.storage + d->output.pos;
+    const uint32_t *limit = p + num_codepoints;
+#define unpack(which, vec, shift) simde_mm512_slli_epi32(simde_mm512_cvtepu8_epi32(simde_mm512_extracti32x4_epi32(vec, which)), shift)
+#define chunk(which) if (p < limit) { \
+    store_unaligned((integer_t*)p, or_si(or_si(unpack(which, output1, 0), unpack(which, output2, 8)), unpack(which, output3, 16))); \
+    p += output_increment; }
+    chunk(0); chunk(1); chunk(2); chunk(3);
+#undef chunk
+#undef unpack
 #else
     uint32_t *p = d->output.storage + d->output.pos;
     const uint32_t *limit = p + num_codepoints;
@@ -568,7 +866,7 @@ FUNC(utf8_decode_to_esc)(UTF8Decoder *d, const uint8_t *src_data, size_t src_len
         bool check_for_trailing_bytes = !sentinel_found;
 
         debug_register(vec);
-        int32_t ascii_mask;
+        movemask_t ascii_mask;
 
 #define abort_with_invalid_utf8() { \
     scalar_decode_all(d, start_of_current_chunk, chunk_src_sz + num_of_trailing_bytes); \
@@ -691,8 +989,11 @@ start_classification:
         shifts = add_epi8(shifts, shift_right_by_two_bytes(shifts));
         shifts = add_epi8(shifts, shift_right_by_four_bytes(shifts));
         shifts = add_epi8(shifts, shift_right_by_eight_bytes(shifts));
-#if KITTY_SIMD_LEVEL == 256
+#if KITTY_SIMD_LEVEL >= 256
         shifts = add_epi8(shifts, shift_right_by_sixteen_bytes(shifts));
+#endif
+#if KITTY_SIMD_LEVEL == 512
+        shifts = add_epi8(shifts, shift_right_by_thirty_two_bytes(shifts));
 #endif
         // zero the shifts for discarded continuation bytes
         shifts = and_si(shifts, cmplt_epi8(counts, two));
@@ -707,9 +1008,12 @@ start_classification:
         shifts = move(shifts, two_bytes, 2);
         shifts = move(shifts, four_bytes, 3);
         shifts = move(shifts, eight_bytes, 4);
-#if KITTY_SIMD_LEVEL == 256
+#if KITTY_SIMD_LEVEL >= 256
         shifts = move(shifts, sixteen_bytes, 5);
 #endif
+#if KITTY_SIMD_LEVEL == 512
+        shifts = move(shifts, thirty_two_bytes, 6);
+#endif
 #undef move
         // convert the shifts into a suitable mask for shuffle by adding the byte number to each byte
         shifts = add_epi8(shifts, numbered);
@@ -778,11 +1082,13 @@ start_classification:
 #undef shift_right_by_four_bytes
 #undef shift_right_by_eight_bytes
 #undef shift_right_by_sixteen_bytes
+#undef shift_right_by_thirty_two_bytes
 #undef shift_left_by_one_byte
 #undef shift_left_by_two_bytes
 #undef shift_left_by_four_bytes
 #undef shift_left_by_eight_bytes
 #undef shift_left_by_sixteen_bytes
+#undef shift_left_by_thirty_two_bytes
 #undef shift_left_by_bits16
 #undef shift_right_by_bits32
 #undef shift_right_by_bytes128
@@ -800,5 +1106,6 @@ start_classification:
 #undef sum_bytes
 #undef is_zero
 #undef zero_upper
+#undef movemask_t
 #undef print_register_as_bytes
 #endif // KITTY_NO_SIMD
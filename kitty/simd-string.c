@@ -8,7 +8,7 @@
 #include "data-types.h"
 #include "charsets.h"
 #include "simd-string.h"
-static bool has_sse4_2 = false, has_avx2 = false;
+static bool has_sse4_2 = false, has_avx2 = false, has_avx512 = false;
 
 // xor_data64 {{{
 static void xor_data64_scalar(const uint8_t key[64], uint8_t* data, const size_t data_sz) { for (size_t i = 0; i < data_sz; i++) data[i] ^= key[i & 63]; }
@@ -16,6 +16,36 @@ static void (*xor_data64_impl)(const uint8_t key[64], uint8_t* data, const size_
 void xor_data64(const uint8_t key[64], uint8_t* data, const size_t data_sz) { xor_data64_impl(key, data, data_sz); }
 // }}}
 
+// alpha blending {{{
+// The vector implementations perform exactly the same float operations in
+// the same order, so they produce the same output as these.
+void
+alpha_blend_rgba_scalar(uint8_t *dest, const uint8_t *src, const size_t num_pixels) {
+    for (size_t p = 0; p < num_pixels; p++, dest += 4, src += 4) {
+        if (!src[3]) continue;
+        const float dest_a = (float)dest[3] / 255.f, src_a = (float)src[3] / 255.f;
+        const float alpha = src_a + dest_a * (1.f - src_a);
+        dest[3] = (uint8_t)(255 * alpha);
+        if (!dest[3]) { dest[0] = 0; dest[1] = 0; dest[2] = 0; continue; }
+        for (unsigned i = 0; i < 3; i++) dest[i] = (uint8_t)((src[i] * src_a + dest[i] * dest_a * (1.f - src_a))/alpha);
+    }
+}
+
+void
+blend_rgba_on_rgb_scalar(uint8_t *dest, const uint8_t *src, const size_t num_pixels) {
+    for (size_t p = 0; p < num_pixels; p++, dest += 3, src += 4) {
+        const float alpha = (float)src[3] / 255.f;
+        const float alpha_op = 1.f - alpha;
+        for (unsigned i = 0; i < 3; i++) dest[i] = (uint8_t)(src[i] * alpha + dest[i] * alpha_op);
+    }
+}
+
+static void (*alpha_blend_rgba_impl)(uint8_t *dest, const uint8_t *src, const size_t num_pixels) = alpha_blend_rgba_scalar;
+static void (*blend_rgba_on_rgb_impl)(uint8_t *dest, const uint8_t *src, const size_t num_pixels) = blend_rgba_on_rgb_scalar;
+void alpha_blend_rgba(uint8_t *dest, const uint8_t *src, const size_t num_pixels) { alpha_blend_rgba_impl(dest, src, num_pixels); }
+void blend_rgba_on_rgb(uint8_t *dest, const uint8_t *src, const size_t num_pixels) { blend_rgba_on_rgb_impl(dest, src, num_pixels); }
+// }}}
+
 // find_either_of_two_bytes {{{
 static const uint8_t*
 find_either_of_two_bytes_scalar(const uint8_t *haystack, const size_t sz, const uint8_t x, const uint8_t y) {
@@ -33,6 +63,23 @@ find_either_of_two_bytes(const uint8_t *haystack, const size_t sz, const uint8_t
 }
 // }}}
 
+// find_end_of_csi_params {{{
+static const uint8_t*
+find_end_of_csi_params_scalar(const uint8_t *haystack, const size_t sz) {
+    for (const uint8_t *limit = haystack + sz; haystack < limit; haystack++) {
+        if (*haystack < '0' || *haystack > ';') return haystack;
+    }
+    return NULL;
+}
+
+static const uint8_t* (*find_end_of_csi_params_impl)(const uint8_t*, const size_t) = find_end_of_csi_params_scalar;
+
+const uint8_t*
+find_end_of_csi_params(const uint8_t *haystack, const size_t sz) {
+    return find_end_of_csi_params_impl(haystack, sz);
+}
+// }}}
+
 // UTF-8 {{{
 
 bool
@@ -93,6 +140,8 @@ test_utf8_decode_to_sentinel(PyObject *self UNUSED, PyObject *args) {
             func = utf8_decode_to_esc_128; break;
         case 3:
             func = utf8_decode_to_esc_256; break;
+        case 4:
+            func = utf8_decode_to_esc_512; break;
     }
     RAII_PyObject(ans, PyUnicode_FromString(""));
     ssize_t p = 0;
@@ -124,6 +173,8 @@ test_find_either_of_two_bytes(PyObject *self UNUSED, PyObject *args) {
             func = find_either_of_two_bytes_128; break;
         case 3:
             func = find_either_of_two_bytes_256; break;
+        case 4:
+            func = find_either_of_two_bytes_512; break;
         case 0: break;
         default:
             PyErr_SetString(PyExc_ValueError, "Unknown which_function");
@@ -144,6 +195,41 @@ test_find_either_of_two_bytes(PyObject *self UNUSED, PyObject *args) {
     return PyLong_FromUnsignedLongLong(n);
 }
 
+static PyObject*
+test_find_end_of_csi_params(PyObject *self UNUSED, PyObject *args) {
+    RAII_PY_BUFFER(buf);
+    int which_function = 0, align_offset = 0;
+    const uint8_t*(*func)(const uint8_t*, const size_t sz) = find_end_of_csi_params;
+    if (!PyArg_ParseTuple(args, "s*|ii", &buf, &which_function, &align_offset)) return NULL;
+    switch (which_function) {
+        case 1:
+            func = find_end_of_csi_params_scalar; break;
+        case 2:
+            func = find_end_of_csi_params_128; break;
+        case 3:
+            func = find_end_of_csi_params_256; break;
+        case 4:
+            func = find_end_of_csi_params_512; break;
+        case 0: break;
+        default:
+            PyErr_SetString(PyExc_ValueError, "Unknown which_function");
+            return NULL;
+    }
+    uint8_t *abuf;
+    if (posix_memalign((void**)&abuf, 64, 256 + buf.len) != 0) {
+        return PyErr_NoMemory();
+    }
+    uint8_t *p = abuf;
+    memset(p, '<', 64 + align_offset); p += 64 + align_offset;
+    memcpy(p, buf.buf, buf.len);
+    memset(p + buf.len, '>', 64);
+    const uint8_t *ans = func(p, buf.len);
+    free(abuf);
+    if (ans == NULL) return PyLong_FromLong(-1);
+    unsigned long long n = ans - p;
+    return PyLong_FromUnsignedLongLong(n);
+}
+
 static PyObject*
 test_xor64(PyObject *self UNUSED, PyObject *args) {
     RAII_PY_BUFFER(buf);
@@ -158,6 +244,8 @@ test_xor64(PyObject *self UNUSED, PyObject *args) {
             func = xor_data64_128; break;
         case 3:
             func = xor_data64_256; break;
+        case 4:
+            func = xor_data64_512; break;
         case 0: break;
         default:
             PyErr_SetString(PyExc_ValueError, "Unknown which_function");
@@ -180,13 +268,47 @@ test_xor64(PyObject *self UNUSED, PyObject *args) {
     return ans;
 }
 
+static PyObject*
+test_alpha_blend(PyObject *self UNUSED, PyObject *args) {
+    RAII_PY_BUFFER(dest);
+    RAII_PY_BUFFER(src);
+    int which_function = 0, dest_is_rgb = 0;
+    if (!PyArg_ParseTuple(args, "y*y*|ip", &dest, &src, &which_function, &dest_is_rgb)) return NULL;
+    void (*func)(uint8_t *dest, const uint8_t *src, const size_t num_pixels) = dest_is_rgb ? blend_rgba_on_rgb : alpha_blend_rgba;
+    switch (which_function) {
+        case 1:
+            func = dest_is_rgb ? blend_rgba_on_rgb_scalar : alpha_blend_rgba_scalar; break;
+        case 2:
+            func = dest_is_rgb ? blend_rgba_on_rgb_128 : alpha_blend_rgba_128; break;
+        case 3: case 4:
+            func = dest_is_rgb ? blend_rgba_on_rgb_256 : alpha_blend_rgba_256; break;
+        case 0: break;
+        default:
+            PyErr_SetString(PyExc_ValueError, "Unknown which_function");
+            return NULL;
+    }
+    const size_t dest_px_sz = dest_is_rgb ? 3 : 4, num_pixels = src.len / 4;
+    if (src.len % 4 || (size_t)dest.len != num_pixels * dest_px_sz) { PyErr_SetString(PyExc_ValueError, "Mismatched buffer sizes"); return NULL; }
+    if (!num_pixels) return PyBytes_FromStringAndSize(NULL, 0);
+    // Use exactly sized copies so that reads and writes past the end of the data are caught by ASAN
+    uint8_t *d = malloc(dest.len), *s = malloc(src.len);
+    if (!d || !s) { free(d); free(s); return PyErr_NoMemory(); }
+    memcpy(d, dest.buf, dest.len); memcpy(s, src.buf, src.len);
+    func(d, s, num_pixels);
+    PyObject *ans = PyBytes_FromStringAndSize((const char*)d, dest.len);
+    free(d); free(s);
+    return ans;
+}
+
 
 // }}}
 
 static PyMethodDef module_methods[] = {
     METHODB(test_utf8_decode_to_sentinel, METH_VARARGS),
     METHODB(test_find_either_of_two_bytes, METH_VARARGS),
+    METHODB(test_find_end_of_csi_params, METH_VARARGS),
     METHODB(test_xor64, METH_VARARGS),
+    METHODB(test_alpha_blend, METH_VARARGS),
     {NULL, NULL, 0, NULL}        /* Sentinel */
 };
 
@@ -196,6 +318,8 @@ init_simd(void *x) {
     if (PyModule_AddFunctions(module, module_methods) != 0) return false;
 #define A(x, val) { Py_INCREF(Py_##val); if (0 != PyModule_AddObject(module, #x, Py_##val)) return false; }
 #define do_check() { has_sse4_2 = __builtin_cpu_supports("sse4.2") != 0; has_avx2 = __builtin_cpu_supports("avx2") != 0; }
+    // The 512 bit code needs VBMI for full width byte shuffles
+#define do_check_avx512() { has_avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vbmi"); }
 
 #ifdef __APPLE__
 #ifdef __arm64__
@@ -203,7 +327,7 @@ init_simd(void *x) {
     // ARM has only 128 bit registers but using the avx2 code is still slightly faster
     has_sse4_2 = true; has_avx2 = true;
 #else
-    do_check();
+    do_check(); do_check_avx512();
     // On GitHub actions there are some weird macOS machines which report avx2 not available but sse4.2 is available and then
     // SIGILL when using basic sse instructions
     if (!has_avx2 && has_sse4_2) {
@@ -219,28 +343,51 @@ init_simd(void *x) {
     has_sse4_2 = true; has_avx2 = true;
 #elif !defined(KITTY_NO_SIMD)
     do_check();
+#if defined(__x86_64__) || defined(__i386__)
+    do_check_avx512();
+#endif
 #endif
 #endif
     const char *simd_env = getenv("KITTY_SIMD");
     if (simd_env) {
         has_sse4_2 = strcmp(simd_env, "128") == 0;
         has_avx2 = strcmp(simd_env, "256") == 0;
+        has_avx512 = has_avx512 && strcmp(simd_env, "512") == 0;
     }
 
 #undef do_check
+#undef do_check_avx512
+    if (has_avx512) {
+        A(has_avx512, True);
+        find_either_of_two_bytes_impl = find_either_of_two_bytes_512;
+        find_end_of_csi_params_impl = find_end_of_csi_params_512;
+        utf8_decode_to_esc_impl = utf8_decode_to_esc_512;
+        xor_data64_impl = xor_data64_512;
+        // The blending kernels are float bound, the 256 bit ones are as fast
+        alpha_blend_rgba_impl = alpha_blend_rgba_256;
+        blend_rgba_on_rgb_impl = blend_rgba_on_rgb_256;
+    } else {
+        A(has_avx512, False);
+    }
     if (has_avx2) {
         A(has_avx2, True);
-        find_either_of_two_bytes_impl = find_either_of_two_bytes_256;
-        utf8_decode_to_esc_impl = utf8_decode_to_esc_256;
-        xor_data64_impl = xor_data64_256;
+        if (find_either_of_two_bytes_impl == find_either_of_two_bytes_scalar) find_either_of_two_bytes_impl = find_either_of_two_bytes_256;
+        if (find_end_of_csi_params_impl == find_end_of_csi_params_scalar) find_end_of_csi_params_impl = find_end_of_csi_params_256;
+        if (utf8_decode_to_esc_impl == utf8_decode_to_esc_scalar) utf8_decode_to_esc_impl = utf8_decode_to_esc_256;
+        if (xor_data64_impl == xor_data64_scalar) xor_data64_impl = xor_data64_256;
+        if (alpha_blend_rgba_impl == alpha_blend_rgba_scalar) alpha_blend_rgba_impl = alpha_blend_rgba_256;
+        if (blend_rgba_on_rgb_impl == blend_rgba_on_rgb_scalar) blend_rgba_on_rgb_impl = blend_rgba_on_rgb_256;
     } else {
         A(has_avx2, False);
     }
     if (has_sse4_2) {
         A(has_sse4_2, True);
         if (find_either_of_two_bytes_impl == find_either_of_two_bytes_scalar) find_either_of_two_bytes_impl = find_either_of_two_bytes_128;
+        if (find_end_of_csi_params_impl == find_end_of_csi_params_scalar) find_end_of_csi_params_impl = find_end_of_csi_params_128;
         if (utf8_decode_to_esc_impl == utf8_decode_to_esc_scalar) utf8_decode_to_esc_impl = utf8_decode_to_esc_128;
         if (xor_data64_impl == xor_data64_scalar) xor_data64_impl = xor_data64_128;
+        if (alpha_blend_rgba_impl == alpha_blend_rgba_scalar) alpha_blend_rgba_impl = alpha_blend_rgba_128;
+        if (blend_rgba_on_rgb_impl == blend_rgba_on_rgb_scalar) blend_rgba_on_rgb_impl = blend_rgba_on_rgb_128;
     } else {
         A(has_sse4_2, False);
     }
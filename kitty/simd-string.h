@@ -45,14 +45,33 @@ bool init_simd(void* module);
 // Returns pointer to first position in haystack that contains either of the
 // two chars or NULL if not found.
 const uint8_t* find_either_of_two_bytes(const uint8_t *haystack, const size_t sz, const uint8_t a, const uint8_t b);
+// Return a pointer to the first byte that is not one of 0-9:; or NULL if no such byte exists
+const uint8_t* find_end_of_csi_params(const uint8_t *haystack, const size_t sz);
 
 // XOR data with the 64 byte key
 void xor_data64(const uint8_t key[64], uint8_t* data, const size_t data_sz);
 
+// Blend num_pixels RGBA pixels from src onto the RGBA pixels in dest
+void alpha_blend_rgba(uint8_t *dest, const uint8_t *src, const size_t num_pixels);
+// Blend num_pixels RGBA pixels from src onto the opaque RGB pixels in dest
+void blend_rgba_on_rgb(uint8_t *dest, const uint8_t *src, const size_t num_pixels);
+
 // SIMD implementations, internal use
 bool utf8_decode_to_esc_128(UTF8Decoder *d, const uint8_t *src, size_t src_sz);
 bool utf8_decode_to_esc_256(UTF8Decoder *d, const uint8_t *src, size_t src_sz);
+bool utf8_decode_to_esc_512(UTF8Decoder *d, const uint8_t *src, size_t src_sz);
 const uint8_t* find_either_of_two_bytes_128(const uint8_t *haystack, const size_t sz, const uint8_t a, const uint8_t b);
 const uint8_t* find_either_of_two_bytes_256(const uint8_t *haystack, const size_t sz, const uint8_t a, const uint8_t b);
+const uint8_t* find_either_of_two_bytes_512(const uint8_t *haystack, const size_t sz, const uint8_t a, const uint8_t b);
+const uint8_t* find_end_of_csi_params_128(const uint8_t *haystack, const size_t sz);
+const uint8_t* find_end_of_csi_params_256(const uint8_t *haystack, const size_t sz);
+const uint8_t* find_end_of_csi_params_512(const uint8_t *haystack, const size_t sz);
 void xor_data64_128(const uint8_t key[64], uint8_t* data, const size_t data_sz);
 void xor_data64_256(const uint8_t key[64], uint8_t* data, const size_t data_sz);
+void xor_data64_512(const uint8_t key[64], uint8_t* data, const size_t data_sz);
+void alpha_blend_rgba_scalar(uint8_t *dest, const uint8_t *src, const size_t num_pixels);
+void alpha_blend_rgba_128(uint8_t *dest, const uint8_t *src, const size_t num_pixels);
+void alpha_blend_rgba_256(uint8_t *dest, const uint8_t *src, const size_t num_pixels);
+void blend_rgba_on_rgb_scalar(uint8_t *dest, const uint8_t *src, const size_t num_pixels);
+void blend_rgba_on_rgb_128(uint8_t *dest, const uint8_t *src, const size_t num_pixels);
+void blend_rgba_on_rgb_256(uint8_t *dest, const uint8_t *src, const size_t num_pixels);
@@ -570,7 +570,7 @@ def kitty_options_spec() -> str:
     'edge': 'top', 'layer': 'bottom', 'override': '', 'cls': f'{appname}-panel',
     'focus_policy': 'not-allowed', 'exclusive_zone': '-1', 'override_exclusive_zone': 'no',
     'single_instance': 'no', 'instance_group': '', 'toggle_visibility': 'no',
-    'start_as_hidden': 'no', 'detach': 'no', 'detached_log': '',
+    'start_as_hidden': 'no', 'keep_alive': 'no', 'detach': 'no', 'detached_log': '',
 }
 
 def build_panel_cli_spec(defaults: dict[str, str]) -> str:
@@ -753,6 +753,14 @@ def build_panel_cli_spec(defaults: dict[str, str]) -> str:
 Start in hidden mode, useful with :option:`--toggle-visibility`.
 
 
+--keep-alive
+type=bool-set
+default={keep_alive}
+When the program running in the panel exits, hide the panel and start the program again in it,
+instead of closing the panel. Combined with :option:`--toggle-visibility` this keeps a fully
+initialized panel ready, so that it is shown instantly when toggled.
+
+
 --detach
 type=bool-set
 default={detach}
@@ -7,6 +7,8 @@
 
 #include "cleanup.h"
 #include "options/to-c-generated.h"
+#include "safe-wrappers.h"
+#include "threading.h"
 #include <math.h>
 #include <sys/mman.h>
 
@@ -208,6 +210,191 @@ free_bgimage(BackgroundImage **bgimage, bool release_texture) {
     bgimage = NULL;
 }
 
+// Loading background images {{{
+// Decoding a large background image can take hundreds of milliseconds,
+// freezing every window, so PNG images that are not already in the render
+// cache are decoded in a worker thread. The image is uploaded to the GPU and
+// shown once decoding finishes, see finish_background_image_load(). Images
+// loaded from files are stored in the render cache, see kitty/render_cache.py,
+// so that loading them again, for instance at startup, just maps the decoded
+// data into memory.
+
+#define BGIMAGE_ASYNC_MIN_SIZE (256u * 1024u)
+
+typedef struct BackgroundImageLoad {
+    pthread_t thread;
+    bool thread_started, ok, done;
+    char *path, *cache_path;
+    uint8_t *png_data; size_t png_data_sz;
+    BackgroundImage *bgimage;
+    BackgroundImageLayout layout;
+    // when set the image is given to all OS windows that have no background image once loaded
+    bool configured, for_new_os_windows;
+    id_type *os_window_ids; size_t num_os_window_ids;
+} BackgroundImageLoad;
+
+static BackgroundImageLoad *pending_bgimage_load = NULL;
+static uint32_t bgimage_id_counter = 0;
+static const uint8_t png_signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+static bool
+is_png_file(const char *path) {
+    uint8_t buf[sizeof(png_signature)];
+    FILE *f = safe_fopen(path, "rb");
+    if (!f) return false;
+    const bool ans = fread(buf, 1, sizeof(buf), f) == sizeof(buf) && memcmp(buf, png_signature, sizeof(png_signature)) == 0;
+    fclose(f);
+    return ans;
+}
+
+// Returns true if the image was loaded. Otherwise, if cache_path is set, the
+// image is a PNG that is not in the render cache and should be decoded into
+// cache_path in a worker thread.
+static bool
+load_bgimage_from_path(const char *path, BackgroundImage *bgimage, char **cache_path) {
+    *cache_path = NULL;
+    RAII_PyObject(module, PyImport_ImportModule("kitty.render_cache"));
+    RAII_PyObject(irc, module ? PyObject_GetAttrString(module, "default_image_render_cache") : NULL);
+    RAII_PyObject(ret, irc ? PyObject_CallMethod(irc, "lookup", "s", path) : NULL);
+    if (!ret || !PyUnicode_Check(ret)) PyErr_Clear();
+    else if (PyUnicode_GET_LENGTH(ret) && is_png_file(path)) {
+        *cache_path = strdup(PyUnicode_AsUTF8(ret));
+        if (*cache_path) return false;
+    }
+    return image_path_to_bitmap(path, &bgimage->bitmap, &bgimage->width, &bgimage->height, &bgimage->mmap_size);
+}
+
+static void
+store_in_render_cache(const char *path, const BackgroundImage *bgimage) {
+    // uses the same format as the output of kitten __convert_image__ RGBA
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE *f = safe_fopen(tmp, "wb");
+    if (!f) return;
+    uint8_t header[8];
+    for (unsigned i = 0; i < 4; i++) {
+        header[i] = (bgimage->width >> (8 * i)) & 0xff; header[4 + i] = (bgimage->height >> (8 * i)) & 0xff;
+    }
+    const size_t sz = (size_t)4 * bgimage->width * bgimage->height;
+    bool ok = fwrite(header, 1, sizeof(header), f) == sizeof(header) && fwrite(bgimage->bitmap, 1, sz, f) == sz;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) unlink(tmp);
+}
+
+static void*
+background_image_load_thread(void *x) {
+    BackgroundImageLoad *l = x;
+    set_thread_name("KittyBgImage");
+    BackgroundImage *b = l->bgimage;
+    size_t sz;
+    if (l->png_data) l->ok = png_from_data(l->png_data, l->png_data_sz, l->path, &b->bitmap, &b->width, &b->height, &sz);
+    else l->ok = png_path_to_bitmap(l->path, &b->bitmap, &b->width, &b->height, &sz);
+    if (l->ok && l->cache_path) store_in_render_cache(l->cache_path, b);
+    __atomic_store_n(&l->done, true, __ATOMIC_RELEASE);
+    if (l->thread_started) wakeup_main_loop();
+    return NULL;
+}
+
+static void
+set_os_window_bgimage(OSWindow *os_window, BackgroundImage *bgimage) {
+    make_os_window_context_current(os_window);
+    free_bgimage(&os_window->bgimage, true);
+    os_window->bgimage = bgimage;
+    os_window->render_calls = 0;
+    if (bgimage) bgimage->refcnt++;
+}
+
+static void
+apply_background_image(BackgroundImage *bgimage, bool configured, const id_type *os_window_ids, size_t num_os_window_ids, bool for_new_os_windows) {
+    if (configured) {
+        free_bgimage(&global_state.bgimage, true);
+        global_state.bgimage = bgimage;
+        if (bgimage) bgimage->refcnt++;
+    }
+    if (for_new_os_windows) {
+        for (size_t o = 0; o < global_state.num_os_windows; o++) {
+            OSWindow *os_window = global_state.os_windows + o;
+            if (!os_window->bgimage) set_os_window_bgimage(os_window, bgimage);
+        }
+    }
+    for (size_t i = 0; i < num_os_window_ids; i++) {
+        WITH_OS_WINDOW(os_window_ids[i])
+            set_os_window_bgimage(os_window, bgimage);
+        END_WITH_OS_WINDOW
+    }
+}
+
+static void
+prune_render_cache(void) {
+    RAII_PyObject(module, PyImport_ImportModule("kitty.render_cache"));
+    RAII_PyObject(irc, module ? PyObject_GetAttrString(module, "default_image_render_cache") : NULL);
+    RAII_PyObject(ret, irc ? PyObject_CallMethod(irc, "prune", NULL) : NULL);
+    if (!ret) PyErr_Print();
+}
+
+static void
+free_bgimage_load(BackgroundImageLoad *l) {
+    free_bgimage(&l->bgimage, true);
+    free(l->path); free(l->cache_path); free(l->png_data); free(l->os_window_ids);
+    free(l);
+}
+
+bool
+finish_background_image_load(bool wait) {
+    BackgroundImageLoad *l = pending_bgimage_load;
+    if (!l || (!wait && !__atomic_load_n(&l->done, __ATOMIC_ACQUIRE))) return false;
+    pending_bgimage_load = NULL;
+    if (l->thread_started) pthread_join(l->thread, NULL);
+    if (l->ok) {
+        if (global_state.num_os_windows) make_os_window_context_current(global_state.os_windows);
+        send_bgimage_to_gpu(l->layout, l->bgimage);
+        apply_background_image(l->bgimage, l->configured, l->os_window_ids, l->num_os_window_ids, l->for_new_os_windows);
+        if (l->cache_path) prune_render_cache();
+    } else log_error("Failed to load background image from: %s", l->path);
+    free_bgimage_load(l);
+    return true;
+}
+
+static BackgroundImageLoad*
+new_bgimage_load(BackgroundImage *bgimage, const char *path, char *cache_path, BackgroundImageLayout layout) {
+    BackgroundImageLoad *l = calloc(1, sizeof(BackgroundImageLoad));
+    if (!l || !(l->path = strdup(path))) { free(l); free(cache_path); return NULL; }
+    l->cache_path = cache_path; l->layout = layout;
+    l->bgimage = bgimage; bgimage->refcnt++;
+    return l;
+}
+
+static void
+start_bgimage_load(BackgroundImageLoad *l) {
+    // loads are finished in the order they were started
+    finish_background_image_load(true);
+    pending_bgimage_load = l;
+    l->thread_started = true;
+    if (pthread_create(&l->thread, NULL, background_image_load_thread, l) != 0) {
+        l->thread_started = false;
+        background_image_load_thread(l);
+        finish_background_image_load(true);
+    }
+}
+
+static void
+load_configured_background_image(void) {
+    BackgroundImage *bgimage = calloc(1, sizeof(BackgroundImage));
+    if (!bgimage) fatal("Out of memory allocating the global bg image object");
+    global_state.bgimage = bgimage;
+    bgimage->refcnt++;
+    char *cache_path;
+    if (load_bgimage_from_path(OPT(background_image), bgimage, &cache_path)) send_bgimage_to_gpu(OPT(background_image_layout), bgimage);
+    else if (cache_path) {
+        BackgroundImageLoad *l = new_bgimage_load(bgimage, OPT(background_image), cache_path, OPT(background_image_layout));
+        if (l) {
+            l->for_new_os_windows = true;
+            start_bgimage_load(l);
+        }
+    }
+}
+// }}}
+
 OSWindow*
 add_os_window(void) {
     WITH_OS_WINDOW_REFS
@@ -221,15 +408,9 @@ add_os_window(void) {
 
     bool wants_bg = OPT(background_image) && OPT(background_image)[0] != 0;
     if (wants_bg) {
-        if (!global_state.bgimage) {
-            global_state.bgimage = calloc(1, sizeof(BackgroundImage));
-            if (!global_state.bgimage) fatal("Out of memory allocating the global bg image object");
-            global_state.bgimage->refcnt++;
-            if (image_path_to_bitmap(OPT(background_image), &global_state.bgimage->bitmap, &global_state.bgimage->width, &global_state.bgimage->height, &global_state.bgimage->mmap_size)) {
-                send_bgimage_to_gpu(OPT(background_image_layout), global_state.bgimage);
-            }
-        }
-        if (global_state.bgimage->texture_id) {
+        // while the configured image is being loaded it is given to new OS windows when done
+        if (!global_state.bgimage) load_configured_background_image();
+        if (global_state.bgimage && global_state.bgimage->texture_id) {
             ans->bgimage = global_state.bgimage;
             ans->bgimage->refcnt++;
         }
@@ -261,6 +442,11 @@ static void
 release_gpu_resources_for_window(Window *w) {
     if (w->render_data.vao_idx > -1) remove_vao(w->render_data.vao_idx);
     w->render_data.vao_idx = -1;
+    if (w->layer_cache.texture_id) free_texture(&w->layer_cache.texture_id);
+    if (w->layer_cache.framebuffer_id) free_framebuffer(&w->layer_cache.framebuffer_id);
+    w->layer_cache.is_valid = false;
+    if (w->title_bar_data.texture_id) free_texture(&w->title_bar_data.texture_id);
+    if (w->url_target_bar_data.texture_id) free_texture(&w->url_target_bar_data.texture_id);
 }
 
 static bool
@@ -350,6 +536,7 @@ static void
 destroy_window(Window *w) {
     free(w->pending_clicks.clicks); zero_at_ptr(&w->pending_clicks);
     free(w->buffered_keys.key_data); zero_at_ptr(&w->buffered_keys);
+    free(w->broadcast.targets); free(w->broadcast.excluded_keys); zero_at_ptr(&w->broadcast);
     Py_CLEAR(w->render_data.screen); Py_CLEAR(w->title);
     Py_CLEAR(w->title_bar_data.last_drawn_title_object_id);
     free(w->title_bar_data.buf); w->title_bar_data.buf = NULL;
@@ -488,6 +675,7 @@ destroy_os_window_item(OSWindow *w) {
     Py_CLEAR(w->window_title); Py_CLEAR(w->tab_bar_render_data.screen);
     remove_vao(w->tab_bar_render_data.vao_idx);
     free(w->tabs); w->tabs = NULL;
+    free(w->input_latency.samples); zero_at_ptr(&w->input_latency);
     free_bgimage(&w->bgimage, true);
     zero_at_ptr(&w->bgimage);
     if (w->indirect_output.texture_id) free_texture(&w->indirect_output.texture_id);
@@ -571,20 +759,23 @@ pyset_borders_rects(PyObject *self UNUSED, PyObject *args) {
     if (!PyArg_ParseTuple(args, "KKO!", &os_window_id, &tab_id, &PyList_Type, &rects)) return NULL;
     WITH_TAB(os_window_id, tab_id)
         BorderRects *br = &tab->border_rects;
-        br->is_dirty = true;
-        br->num_border_rects = PyList_GET_SIZE(rects);
+        // Only mark the rects dirty when they actually change as that causes
+        // a re-upload and a full redraw of the OS window
+        const unsigned num = PyList_GET_SIZE(rects);
+        bool changed = num != br->num_border_rects;
+        br->num_border_rects = num;
         ensure_space_for(br, rect_buf, BorderRect, br->num_border_rects + 1, capacity, 32, false);
         for (unsigned i = 0; i < br->num_border_rects; i++) {
             PyObject *pr = PyList_GET_ITEM(rects, i);
             unsigned long left, top, right, bottom, color;
-            if (!PyArg_ParseTuple(pr, "kkkkk", &left, &top, &right, &bottom, &color)) return NULL;
+            if (!PyArg_ParseTuple(pr, "kkkkk", &left, &top, &right, &bottom, &color)) { br->is_dirty = true; return NULL; }
+            BorderRect q = {.left=gl_pos_x(left, osw->viewport_width), .top=gl_pos_y(top, osw->viewport_height), .color=color};
+            q.right = q.left + gl_size(right - left, osw->viewport_width);
+            q.bottom = q.top - gl_size(bottom - top, osw->viewport_height);
             BorderRect *r = br->rect_buf + i;
-            r->left = gl_pos_x(left, osw->viewport_width);
-            r->top = gl_pos_y(top, osw->viewport_height);
-            r->right = r->left + gl_size(right - left, osw->viewport_width);
-            r->bottom = r->top - gl_size(bottom - top, osw->viewport_height);
-            r->color = color;
+            if (changed || memcmp(r, &q, sizeof(q)) != 0) { *r = q; changed = true; }
         }
+        if (changed) br->is_dirty = true;
     END_WITH_TAB
     Py_RETURN_NONE;
 }
@@ -764,6 +955,20 @@ PYWRAP1(handle_for_window_id) {
 }
 
 
+PYWRAP1(os_window_memory_usage) {
+    id_type os_window_id;
+    PA("K", &os_window_id);
+    WITH_OS_WINDOW(os_window_id)
+        // the font group is shared by all OS windows with the same font size and DPI
+        FONTS_DATA_HANDLE fg = os_window->fonts_data;
+        return Py_BuildValue("{sK sn sn}", "font_group", (unsigned long long)(uintptr_t)fg,
+            "sprite_textures", (Py_ssize_t)(fg ? sprite_textures_size(fg) : 0),
+            "font_caches", (Py_ssize_t)(fg ? font_group_cache_memory_usage(fg) : 0));
+    END_WITH_OS_WINDOW
+    PyErr_SetString(PyExc_ValueError, "No such window");
+    return NULL;
+}
+
 PYWRAP0(get_options) {
     if (!global_state.options_object) {
         PyErr_SetString(PyExc_RuntimeError, "Must call set_options() before using get_options()");
@@ -866,6 +1071,23 @@ end:
 }
 
 
+PYWRAP1(input_latency_samples) {
+    id_type os_window_id;
+    PA("K", &os_window_id);
+    WITH_OS_WINDOW(os_window_id)
+        RAII_PyObject(ans, PyTuple_New(os_window->input_latency.count));
+        if (!ans) return NULL;
+        for (unsigned i = 0; i < os_window->input_latency.count; i++) {
+            const InputLatencySample *s = os_window->input_latency.samples + i;
+            PyObject *t = Py_BuildValue("dddd", monotonic_t_to_s_double(s->sent), monotonic_t_to_s_double(s->parsed), monotonic_t_to_s_double(s->rendered), monotonic_t_to_s_double(s->swapped));
+            if (!t) return NULL;
+            PyTuple_SET_ITEM(ans, i, t);
+        }
+        return Py_NewRef(ans);
+    END_WITH_OS_WINDOW
+    return PyTuple_New(0);
+}
+
 PYWRAP1(os_window_has_background_image) {
     id_type os_window_id;
     PA("K", &os_window_id);
@@ -999,6 +1221,29 @@ PYWRAP1(set_window_render_data) {
 #undef B
 }
 
+PYWRAP1(set_windows_render_data) {
+    // Apply the render data and padding of many windows in a tab in one call,
+    // each entry is (window_id, screen, left, top, right, bottom, pad_left, pad_top, pad_right, pad_bottom)
+    id_type os_window_id, tab_id;
+    PyObject *entries;
+    PA("KKO!", &os_window_id, &tab_id, &PyList_Type, &entries);
+    WITH_TAB(os_window_id, tab_id)
+        for (Py_ssize_t i = 0; i < PyList_GET_SIZE(entries); i++) {
+            id_type window_id; Screen *screen; WindowGeometry g = {0}; unsigned pl, pt, pr, pb;
+            if (!PyArg_ParseTuple(PyList_GET_ITEM(entries, i), "KOIIIIIIII", &window_id, &screen, &g.left, &g.top, &g.right, &g.bottom, &pl, &pt, &pr, &pb)) return NULL;
+            for (size_t w = 0; w < tab->num_windows; w++) {
+                Window *window = tab->windows + w;
+                if (window->id == window_id) {
+                    init_window_render_data(&window->render_data, g, screen);
+                    window->padding.left = pl; window->padding.top = pt; window->padding.right = pr; window->padding.bottom = pb;
+                    break;
+                }
+            }
+        }
+    END_WITH_TAB
+    Py_RETURN_NONE;
+}
+
 PYWRAP1(update_window_visibility) {
     id_type os_window_id, tab_id, window_id;
     int visible;
@@ -1225,45 +1470,51 @@ pyset_background_image(PyObject *self UNUSED, PyObject *args, PyObject *kw) {
     if (!PyArg_ParseTupleAndKeywords(args, kw, "zO!|pOy#OOO", kwds, &path, &PyTuple_Type, &os_window_ids, &configured, &layout_name, &png_data, &png_data_size, &pylinear, &pytint, &pytint_gaps)) return NULL;
     size_t size;
     BackgroundImageLayout layout = PyUnicode_Check(layout_name) ? bglayout(layout_name) : OPT(background_image_layout);
+    const size_t num_os_window_ids = PyTuple_GET_SIZE(os_window_ids);
+    RAII_ALLOC(id_type, ids, malloc(sizeof(id_type) * (num_os_window_ids + 1)));
+    if (!ids) return PyErr_NoMemory();
+    for (size_t i = 0; i < num_os_window_ids; i++) ids[i] = PyLong_AsUnsignedLongLong(PyTuple_GET_ITEM(os_window_ids, i));
+    // changes must be applied in order
+    finish_background_image_load(true);
     BackgroundImage *bgimage = NULL;
+    BackgroundImageLoad *load = NULL;
     if (path) {
         bgimage = calloc(1, sizeof(BackgroundImage));
         if (!bgimage) return PyErr_NoMemory();
         bool ok;
         if (png_data && png_data_size) {
-            ok = png_from_data(png_data, png_data_size, path, &bgimage->bitmap, &bgimage->width, &bgimage->height, &size);
+            if ((size_t)png_data_size >= BGIMAGE_ASYNC_MIN_SIZE && memcmp(png_data, png_signature, sizeof(png_signature)) == 0 && (load = new_bgimage_load(bgimage, path, NULL, layout))) {
+                if ((load->png_data = malloc(png_data_size))) {
+                    memcpy(load->png_data, png_data, png_data_size); load->png_data_sz = png_data_size;
+                } else { free_bgimage_load(load); bgimage = NULL; return PyErr_NoMemory(); }
+                ok = true;
+            } else ok = png_from_data(png_data, png_data_size, path, &bgimage->bitmap, &bgimage->width, &bgimage->height, &size);
         } else {
-            ok = image_path_to_bitmap(path, &bgimage->bitmap, &bgimage->width, &bgimage->height, &bgimage->mmap_size);
+            char *cache_path;
+            ok = load_bgimage_from_path(path, bgimage, &cache_path);
+            if (!ok && cache_path && (load = new_bgimage_load(bgimage, path, cache_path, layout))) ok = true;
         }
         if (!ok) {
             PyErr_Format(PyExc_ValueError, "Failed to load image from: %s", path);
             free(bgimage);
             return NULL;
         }
-        static uint32_t bgimage_id_counter = 0;
         bgimage->id = ++bgimage_id_counter;
-        send_bgimage_to_gpu(layout, bgimage);
+        if (!load) send_bgimage_to_gpu(layout, bgimage);
         bgimage->refcnt++;
     }
     if (configured) {
-        free_bgimage(&global_state.bgimage, true);
-        global_state.bgimage = bgimage;
-        if (bgimage) bgimage->refcnt++;
         OPT(background_image_layout) = layout;
         if (pylinear && pylinear != Py_None) convert_from_python_background_image_linear(pylinear, &global_state.opts);
         if (pytint && pytint != Py_None) convert_from_python_background_tint(pytint, &global_state.opts);
         if (pytint_gaps && pytint_gaps != Py_None) convert_from_python_background_tint_gaps(pytint_gaps, &global_state.opts);
     }
-    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(os_window_ids); i++) {
-        id_type os_window_id = PyLong_AsUnsignedLongLong(PyTuple_GET_ITEM(os_window_ids, i));
-        WITH_OS_WINDOW(os_window_id)
-            make_os_window_context_current(os_window);
-            free_bgimage(&os_window->bgimage, true);
-            os_window->bgimage = bgimage;
-            os_window->render_calls = 0;
-            if (bgimage) bgimage->refcnt++;
-        END_WITH_OS_WINDOW
-    }
+    if (load) {
+        // the image is applied once it has been decoded
+        load->configured = configured;
+        load->os_window_ids = ids; ids = NULL; load->num_os_window_ids = num_os_window_ids;
+        start_bgimage_load(load);
+    } else apply_background_image(bgimage, configured, ids, num_os_window_ids, false);
     if (bgimage) free_bgimage(&bgimage, true);
     Py_RETURN_NONE;
 }
@@ -1481,6 +1732,7 @@ static PyMethodDef module_methods[] = {
     MW(get_window_logo_settings_if_not_default, METH_VARARGS),
     MW(set_ignore_os_keyboard_processing, METH_O),
     MW(handle_for_window_id, METH_VARARGS),
+    MW(os_window_memory_usage, METH_VARARGS),
     MW(update_ime_position_for_window, METH_VARARGS),
     MW(pt_to_px, METH_VARARGS),
     MW(add_tab, METH_O),
@@ -1499,10 +1751,12 @@ static PyMethodDef module_methods[] = {
     MW(set_borders_rects, METH_VARARGS),
     MW(set_tab_bar_render_data, METH_VARARGS),
     MW(set_window_render_data, METH_VARARGS),
+    MW(set_windows_render_data, METH_VARARGS),
     MW(set_window_padding, METH_VARARGS),
     MW(viewport_for_window, METH_VARARGS),
     MW(cell_size_for_window, METH_VARARGS),
     MW(os_window_has_background_image, METH_VARARGS),
+    MW(input_latency_samples, METH_VARARGS),
     MW(mark_os_window_for_close, METH_VARARGS),
     MW(set_application_quit_request, METH_VARARGS),
     MW(current_application_quit_request, METH_NOARGS),
@@ -57,12 +57,14 @@ typedef struct Options {
     color_type cursor_trail_color;
     float cursor_trail_start_threshold;
     unsigned int url_style;
-    unsigned int scrollback_pager_history_size;
+    unsigned int scrollback_pager_history_size, scrollback_disk_cache_size;
+    bool scrollback_disk_cache_policy;
     bool scrollback_fill_enlarged_window;
     char_type *select_by_word_characters;
     char_type *select_by_word_characters_forward;
     color_type url_color, background, foreground, active_border_color, inactive_border_color, bell_border_color, tab_bar_background, tab_bar_margin_color;
     monotonic_t repaint_delay, input_delay;
+    bool adaptive_input_delay;
     bool focus_follows_mouse;
     unsigned int hide_window_decorations;
     bool macos_hide_from_tasks, macos_quit_when_last_window_closed, macos_window_resizable, macos_traditional_fullscreen;
@@ -84,7 +86,7 @@ typedef struct Options {
     bool dynamic_background_opacity;
     float inactive_text_alpha;
     Edge tab_bar_edge;
-    unsigned long tab_bar_min_tabs;
+    unsigned long tab_bar_min_tabs, parse_threads, sprite_memory_limit, image_texture_memory_limit;
     DisableLigature disable_ligatures;
     bool force_ltr;
     bool resize_in_steps;
@@ -93,6 +95,7 @@ typedef struct Options {
     bool window_alert_on_bell;
     bool debug_keyboard;
     bool allow_hyperlinks;
+    unsigned int command_output_capture_size;
     struct { monotonic_t on_end, on_pause; } resize_debounce_time;
     MouseShape pointer_shape_when_grabbed;
     MouseShape default_pointer_shape;
@@ -185,6 +188,7 @@ typedef struct PendingClick {
 typedef struct WindowBarData {
     unsigned width, height;
     uint8_t *buf;
+    uint32_t texture_id, fg, bg;
     PyObject *last_drawn_title_object_id;
     hyperlink_id_type hyperlink_id_for_title_object;
     bool needs_render;
@@ -204,6 +208,13 @@ typedef struct Window {
     monotonic_t last_drag_scroll_at;
     uint32_t last_special_key_pressed;
     WindowBarData title_bar_data, url_target_bar_data;
+    // The last rendered output of the window, used to avoid re-rendering
+    // windows that have not changed when rendering in layers
+    struct {
+        uint32_t texture_id, framebuffer_id;
+        unsigned width, height;
+        bool is_valid, needs_render;
+    } layer_cache;
     id_type redirect_keys_to_overlay;
     struct {
         bool enabled;
@@ -214,6 +225,13 @@ typedef struct Window {
         PendingClick *clicks;
         size_t num, capacity;
     } pending_clicks;
+    // Windows that key events in this window are also sent to, used by the
+    // broadcast kitten, see set_broadcast_targets()
+    struct {
+        id_type *targets;
+        uint64_t *excluded_keys;
+        size_t num_targets, num_excluded_keys;
+    } broadcast;
 } Window;
 
 typedef struct BorderRect {
@@ -276,6 +294,24 @@ typedef struct BackgroundImageRenderSettings {
     bool linear; uint32_t bgcolor; float opacity;
 } BackgroundImageRenderSettings;
 
+#define MAX_DAMAGE_RECTS 16
+#define INPUT_LATENCY_SAMPLES 512u
+// key presses whose echo is not displayed within this time are not measured
+#define INPUT_LATENCY_TIMEOUT s_double_to_monotonic_t(1.0)
+
+// The stages of the time from a key press being received to its echo being
+// presented, relative to when the key press was received
+typedef struct {
+    monotonic_t sent, parsed, rendered, swapped;
+} InputLatencySample;
+
+// The stages of processing input and rendering frames whose timings are kept
+// in a ring buffer of recent events, see record_frame_timing()
+typedef enum {
+    FRAME_STAGE_PARSE, FRAME_STAGE_FRAME, FRAME_STAGE_CELL_DATA, FRAME_STAGE_GRAPHICS, FRAME_STAGE_SPRITE_UPLOAD,
+    FRAME_STAGE_DRAW, FRAME_STAGE_SWAP, NUM_FRAME_STAGES
+} FrameStage;
+
 typedef struct OSWindow {
     void *handle;
     id_type id;
@@ -323,6 +359,21 @@ typedef struct OSWindow {
     id_type last_focused_counter;
     CloseRequest close_request;
     bool is_layer_shell, hide_on_focus_loss;
+    // running average of the time taken to render a frame, excluding the swap
+    monotonic_t render_cost;
+    struct {
+        // ring buffer of the most recent keystroke to photon latency samples
+        InputLatencySample *samples;
+        unsigned count, pos;
+    } input_latency;
+    struct {
+        // The regions of the framebuffer changed by the frame being rendered
+        // as x, y, width, height with the origin at the top left. When full
+        // is set the whole framebuffer is damaged.
+        int rects[4 * MAX_DAMAGE_RECTS];
+        unsigned num_rects;
+        bool full;
+    } damage;
 } OSWindow;
 
 static inline float
@@ -381,6 +432,7 @@ void get_os_window_pos(OSWindow *os_window, int *x, int *y);
 void set_os_window_pos(OSWindow *os_window, int x, int y);
 void get_os_window_content_scale(OSWindow *os_window, double *xdpi, double *ydpi, float *xscale, float *yscale);
 void update_os_window_references(void);
+bool finish_background_image_load(bool wait);
 void mark_os_window_for_close(OSWindow* w, CloseRequest cr);
 void update_os_window_viewport(OSWindow *window, bool notify_boss);
 bool should_os_window_be_rendered(OSWindow* w);
@@ -403,22 +455,32 @@ ssize_t create_cell_vao(void);
 ssize_t create_graphics_vao(void);
 ssize_t create_border_vao(void);
 bool send_cell_data_to_gpu(ssize_t, Screen *, OSWindow *);
+void record_frame_timing(FrameStage stage, id_type os_window_id, monotonic_t start, monotonic_t end);
 void draw_cells(const WindowRenderData*, OSWindow *, bool, bool, bool, Window*);
+bool tab_bar_is_shown(const OSWindow *os_window);
 bool update_cursor_trail(CursorTrail *ct, Window *w, monotonic_t now, OSWindow *os_window);
 void set_gpu_viewport(unsigned w, unsigned h);
 void free_texture(uint32_t*);
 void free_framebuffer(uint32_t*);
 void send_image_to_gpu(uint32_t*, const void*, int32_t, int32_t, bool, bool, bool, RepeatStrategy);
-void send_sprite_to_gpu(FONTS_DATA_HANDLE fg, sprite_index, pixel*, sprite_index);
+bool send_image_to_atlas(ImageAtlasSlot*, const void*, int32_t, int32_t, bool, bool);
+void free_atlas_slot(ImageAtlasSlot*);
+void generate_mipmaps(uint32_t);
+void send_sprite_to_gpu(FONTS_DATA_HANDLE fg, sprite_index, pixel*, sprite_index, bool, sprite_index);
+size_t sprite_textures_size(FONTS_DATA_HANDLE fg);
 void blank_canvas(float, color_type, bool);
 void blank_os_window(OSWindow *);
 void set_os_window_chrome(OSWindow *w);
 FONTS_DATA_HANDLE load_fonts_data(double, double, double);
+size_t font_group_cache_memory_usage(FONTS_DATA_HANDLE data);
 void send_prerendered_sprites_for_window(OSWindow *w);
+monotonic_t recycle_sprites_if_needed(void);
+bool systemd_process_pending_replies(void);
 #ifdef __APPLE__
 #include "cocoa_window.h"
 #endif
 void request_frame_render(OSWindow *w);
+monotonic_t time_to_start_rendering(OSWindow *w, monotonic_t now);
 void request_tick_callback(void);
 typedef void (* timer_callback_fun)(id_type, void*);
 typedef void (* tick_callback_fun)(void*);
@@ -25,7 +25,9 @@ typedef struct sd_bus sd_bus;
 static struct {
     void *lib;
     sd_bus *user_bus;
-    bool initialized, functions_loaded, ok;
+    char *user_slice;
+    bool initialized, functions_loaded, ok, user_slice_looked_up;
+    unsigned num_pending_replies;
 } systemd = {0};
 
 typedef struct {
@@ -35,17 +37,21 @@ typedef struct {
     int64_t filler;  // just in case systemd ever increases the size of this struct
 } sd_bus_error;
 typedef struct sd_bus_message sd_bus_message;
+typedef struct sd_bus_slot sd_bus_slot;
+typedef int (*sd_bus_message_handler_t)(sd_bus_message *m, void *userdata, sd_bus_error *ret_error);
 
 FUNC(sd_bus_default_user, int, sd_bus**);
 FUNC(sd_bus_message_unref, sd_bus_message*, sd_bus_message*);
-FUNC(sd_bus_error_free, void, sd_bus_error*);
 FUNC(sd_bus_unref, sd_bus*, sd_bus*);
 FUNC(sd_bus_message_new_method_call, int, sd_bus *, sd_bus_message **m, const char *destination, const char *path, const char *interface, const char *member);
 FUNC(sd_bus_message_append, int, sd_bus_message *m, const char *types, ...);
 FUNC(sd_bus_message_open_container, int, sd_bus_message *m, char type, const char *contents);
 FUNC(sd_bus_message_close_container, int, sd_bus_message *m);
 FUNC(sd_pid_get_user_slice, int, pid_t pid, char **slice);
-FUNC(sd_bus_call, int, sd_bus *bus, sd_bus_message *m, uint64_t usec, sd_bus_error *ret_error, sd_bus_message **reply);
+FUNC(sd_bus_call_async, int, sd_bus *bus, sd_bus_slot **slot, sd_bus_message *m, sd_bus_message_handler_t callback, void *userdata, uint64_t usec);
+FUNC(sd_bus_process, int, sd_bus *bus, sd_bus_message **r);
+FUNC(sd_bus_flush, int, sd_bus *bus);
+FUNC(sd_bus_message_get_error, const sd_bus_error*, sd_bus_message *m);
 
 static void
 ensure_initialized(void) {
@@ -73,14 +79,16 @@ ensure_initialized(void) {
     }
     LOAD_FUNC(sd_bus_default_user);
     LOAD_FUNC(sd_bus_message_unref);
-    LOAD_FUNC(sd_bus_error_free);
     LOAD_FUNC(sd_bus_unref);
     LOAD_FUNC(sd_bus_message_new_method_call);
     LOAD_FUNC(sd_bus_message_append);
     LOAD_FUNC(sd_bus_message_open_container);
     LOAD_FUNC(sd_bus_message_close_container);
     LOAD_FUNC(sd_pid_get_user_slice);
-    LOAD_FUNC(sd_bus_call);
+    LOAD_FUNC(sd_bus_call_async);
+    LOAD_FUNC(sd_bus_process);
+    LOAD_FUNC(sd_bus_flush);
+    LOAD_FUNC(sd_bus_message_get_error);
     systemd.functions_loaded = true;
 
     int ret = sd_bus_default_user(&systemd.user_bus);
@@ -88,8 +96,6 @@ ensure_initialized(void) {
     systemd.ok = true;
 }
 
-static inline void err_cleanup(sd_bus_error *p) { sd_bus_error_free(p); }
-#define RAII_bus_error(name) __attribute__((cleanup(err_cleanup))) sd_bus_error name = {0};
 static inline void msg_cleanup(sd_bus_message **p) { sd_bus_message_unref(*p); }
 #define RAII_message(name) __attribute__((cleanup(msg_cleanup))) sd_bus_message *name = NULL;
 
@@ -107,20 +113,30 @@ set_systemd_error(int r, const char *msg) {
     return false;
 }
 
-static bool
-set_reply_error(const char* func_name, int r, const sd_bus_error *err) {
-    RAII_PyObject(m, PyUnicode_FromFormat("Failed to call %s: %s: %s", func_name, err->name, err->message));
-    if (m) {
-        RAII_PyObject(e, Py_BuildValue("(iO)", -r, m));
-        if (e) PyErr_SetObject(PyExc_OSError, e);
-    }
-    return false;
+static int
+on_start_transient_unit_reply(sd_bus_message *m, void *userdata, sd_bus_error *ret_error UNUSED) {
+    if (systemd.num_pending_replies) systemd.num_pending_replies--;
+    const sd_bus_error *err = sd_bus_message_get_error(m);
+    if (err) log_error("Could not move child process: %ld into a systemd scope: %s: %s", (long)(intptr_t)userdata, err->name, err->message);
+    return 0;
+}
+
+bool
+systemd_process_pending_replies(void) {
+    // Called from the main loop, returns true if some replies have still not
+    // arrived, in which case it should be called again shortly
+    if (!systemd.num_pending_replies || !systemd.user_bus) return false;
+    while (sd_bus_process(systemd.user_bus, NULL) > 0);
+    return systemd.num_pending_replies > 0;
 }
 
 static bool
 move_pid_into_new_scope(pid_t pid, const char* scope_name, const char *description) {
-    pid_t parent_pid = getpid();
-    RAII_bus_error(err); RAII_message(m); RAII_message(reply);
+    // The reply is not waited for as that would block the launch of every
+    // child on a round trip to systemd, errors are reported when the replies
+    // are processed from the main loop, see systemd_process_pending_replies().
+    systemd_process_pending_replies();
+    RAII_message(m);
     int r;
 #define checked_call(func, ...) if ((r = func(__VA_ARGS__)) < 0) { return set_systemd_error(r, #func); }
     checked_call(sd_bus_message_new_method_call, systemd.user_bus, &m, SYSTEMD_DESTINATION, SYSTEMD_PATH, SYSTEMD_INTERFACE, "StartTransientUnit");
@@ -130,9 +146,12 @@ move_pid_into_new_scope(pid_t pid, const char* scope_name, const char *descripti
     if (description && description[0]) {
         checked_call(sd_bus_message_append, m, "(sv)", "Description", "s", description);
     }
-    RAII_ALLOC(char, slice, NULL);
-    if (sd_pid_get_user_slice(parent_pid, &slice) >= 0) {
-        checked_call(sd_bus_message_append, m, "(sv)", "Slice", "s", slice);
+    if (!systemd.user_slice_looked_up) {
+        systemd.user_slice_looked_up = true;
+        if (sd_pid_get_user_slice(getpid(), &systemd.user_slice) < 0) systemd.user_slice = NULL;
+    }
+    if (systemd.user_slice) {
+        checked_call(sd_bus_message_append, m, "(sv)", "Slice", "s", systemd.user_slice);
     } else {
         // Fallback
         checked_call(sd_bus_message_append, m, "(sv)", "Slice", "s", "kitty.slice");
@@ -166,7 +185,11 @@ move_pid_into_new_scope(pid_t pid, const char* scope_name, const char *descripti
                                                      //
     checked_call(sd_bus_message_append, m, "a(sa(sv))", 0);  // No auxiliary units
                                                              //
-    if ((r=sd_bus_call(systemd.user_bus, m, 0 /* timeout default */, &err, &reply)) < 0) return set_reply_error("StartTransientUnit", r, &err);
+    checked_call(sd_bus_call_async, systemd.user_bus, NULL, m, on_start_transient_unit_reply, (void*)(intptr_t)pid, 0 /* timeout default */);
+    systemd.num_pending_replies++;
+    // sd_bus_call_async() only queues the message, send it now rather than
+    // whenever the bus is next processed
+    checked_call(sd_bus_flush, systemd.user_bus);
 
     return true;
 #undef checked_call
@@ -174,7 +197,8 @@ move_pid_into_new_scope(pid_t pid, const char* scope_name, const char *descripti
 
 static void
 finalize(void) {
-    if (systemd.user_bus) sd_bus_unref(systemd.user_bus);
+    if (systemd.user_bus) { sd_bus_flush(systemd.user_bus); sd_bus_unref(systemd.user_bus); }
+    free(systemd.user_slice);
     if (systemd.lib) dlclose(systemd.lib);
     memset(&systemd, 0, sizeof(systemd));
 }
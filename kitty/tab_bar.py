@@ -190,6 +190,14 @@ def draw_attributed_string(title: str, screen: Screen) -> None:
         screen.draw(title)
 
 
+@lru_cache(maxsize=16)
+def template_uses_live_state(template: str) -> bool:
+    # Templates that access tab or custom can produce different output for
+    # the same TabBarData, so their output cannot be cached
+    c = compile_template(template)
+    return c is not None and not {'tab', 'custom'}.isdisjoint(c.co_names)
+
+
 @lru_cache(maxsize=16)
 def template_has_field(template: str, field: str) -> bool:
     q = StringFormatter()
@@ -562,6 +570,8 @@ def __init__(self, os_window_id: int):
         self.blank_rects: tuple[Border, ...] = ()
         self.tab_extents: Sequence[TabExtent] = ()
         self.laid_out_once = False
+        self.last_update_key: Any = None
+        self.ideal_tab_length_cache: dict[Any, int] = {}
         self.apply_options()
 
     def apply_options(self) -> None:
@@ -611,6 +621,9 @@ def apply_options(self) -> None:
             self.draw_func = load_custom_draw_tab()
         else:
             self.draw_func = draw_tab_with_fade
+        self.output_is_cacheable = ts != 'custom' and not any(
+            template_uses_live_state(x) for x in (opts.tab_title_template, opts.active_tab_title_template) if x)
+        self.invalidate_cached_output()
         if opts.tab_bar_align == 'center':
             self.align: Callable[[], None] = partial(self.align_with_factor, 2)
         elif opts.tab_bar_align == 'right':
@@ -618,8 +631,13 @@ def apply_options(self) -> None:
         else:
             self.align = lambda: None
 
+    def invalidate_cached_output(self) -> None:
+        self.last_update_key = None
+        self.ideal_tab_length_cache = {}
+
     def patch_colors(self, spec: dict[str, int | None]) -> None:
         opts = get_options()
+        self.invalidate_cached_output()
         atf = spec.get('active_tab_foreground')
         if isinstance(atf, int):
             self.active_fg = (atf << 8) | 2
@@ -701,6 +719,7 @@ def layout(self) -> None:
         s.resize(1, ncells)
         s.reset_mode(DECAWM)
         self.laid_out_once = True
+        self.invalidate_cached_output()
         margin = (viewport_width - ncells * cell_width) // 2 + self.margin_width
         self.window_geometry = g = WindowGeometry(
             margin, tab_bar.top, viewport_width - margin, tab_bar.bottom, s.columns, s.lines)
@@ -711,6 +730,13 @@ def update(self, data: Sequence[TabBarData]) -> None:
         if not self.laid_out_once:
             return
         s = self.screen
+        if self.output_is_cacheable:
+            # The built-in styles draw the same thing for the same data, so
+            # there is nothing to do when nothing has changed since the last update
+            key = tuple(data), s.columns, get_boss().mappings.current_keyboard_mode_name
+            if key == self.last_update_key:
+                return
+            self.last_update_key = key
         last_tab = data[-1] if data else None
         ed = ExtraData()
 
@@ -739,15 +765,24 @@ def draw_tab(i: int, tab: TabBarData, cell_ranges: list[TabExtent], max_tab_leng
         active_idx = 0
         extra = 0
         ed.for_layout = True
+        # The length of a tab drawn for layout depends only on its data and
+        # that of its neighbors, so only tabs that changed need to be drawn
+        old_length_cache, length_cache = self.ideal_tab_length_cache, {}
         for i, t in enumerate(data):
-            s.cursor.x = 0
-            draw_tab(i, t, [], unconstrained_tab_length)
-            ideal_tab_lengths[i] = tl = max(1, s.cursor.x)
+            ck = (t, data[i - 1] if i > 0 else None, data[i + 1] if i + 1 < len(data) else None, i, t is last_tab)
+            tl = old_length_cache.get(ck, 0) if self.output_is_cacheable else 0
+            if not tl:
+                s.cursor.x = 0
+                draw_tab(i, t, [], unconstrained_tab_length)
+                tl = max(1, s.cursor.x)
+            length_cache[ck] = ideal_tab_lengths[i] = tl
             if t.is_active:
                 active_idx = i
             if tl < default_max_tab_length:
                 max_tab_lengths[i] = tl
                 extra += default_max_tab_length - tl
+        if self.output_is_cacheable:
+            self.ideal_tab_length_cache = length_cache
         if extra > 0:
             if ideal_tab_lengths[active_idx] > max_tab_lengths[active_idx]:
                 d = min(extra, ideal_tab_lengths[active_idx] - max_tab_lengths[active_idx])
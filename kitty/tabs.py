@@ -55,7 +55,7 @@
 from .types import ac
 from .typing_compat import EdgeLiteral, SessionTab, SessionType, TypedDict
 from .utils import cmdline_for_hold, log_error, platform_window_id, resolved_shell, shlex_split, which
-from .window import CwdRequest, Watchers, Window, WindowCreationSpec, WindowDict, global_watchers
+from .window import CwdRequest, Watchers, Window, WindowCreationSpec, WindowDict, batched_render_data, global_watchers
 from .window_list import WindowList
 
 
@@ -83,7 +83,7 @@ class TabDict(TypedDict):
 
 class SpecialWindowInstance(NamedTuple):
     cmd: list[str] | None
-    stdin: bytes | None
+    stdin: bytes | int | None
     override_title: str | None
     cwd_from: CwdRequest | None
     cwd: str | None
@@ -96,7 +96,7 @@ class SpecialWindowInstance(NamedTuple):
 
 def SpecialWindow(
     cmd: list[str] | None,
-    stdin: bytes | None = None,
+    stdin: bytes | int | None = None,
     override_title: str | None = None,
     cwd_from: CwdRequest | None = None,
     cwd: str | None = None,
@@ -260,7 +260,8 @@ def _startup(self, session_tab: SessionTab) -> None:
                 spec.opts.add_to_session = self.created_in_session_name
                 launched_window = launch(
                     boss, spec.opts, spec.args, target_tab=target_tab, force_target_tab=True,
-                    startup_command_via_shell_integration=window.run_command_at_shell_startup)
+                    startup_command_via_shell_integration=window.run_command_at_shell_startup,
+                    restore_scrollback_from=window.restore_scrollback_from)
                 if launched_window is not None:
                     launched_window.serialized_id = window.serialized_id
             if window.resize_spec is not None:
@@ -305,6 +306,10 @@ def make_relative(cwd: str) -> str:
                 cwd = os.path.relpath(cwd, session_base_dir)
             return cwd
         cwds = {w.id: make_relative(w.cwd_for_serialization) for g in groups for w in g}
+        scrollback_dir = ''
+        if session_path and ser_opts.save_scrollback:
+            from .session import scrollback_dir_for_session
+            scrollback_dir = scrollback_dir_for_session(session_path)
         from collections import Counter
         most_common_cwd, _ = Counter(cwds.values()).most_common(1)[0]
         for i, g in enumerate(groups):
@@ -313,7 +318,8 @@ def make_relative(cwd: str) -> str:
                 if matched_windows is not None and window not in matched_windows:
                     continue
                 cwd = cwds[window.id]
-                lc = window.as_launch_command(ser_opts, '' if cwd == most_common_cwd else cwd, is_overlay=bool(gw))
+                lc = window.as_launch_command(
+                    ser_opts, '' if cwd == most_common_cwd else cwd, is_overlay=bool(gw), scrollback_dir=scrollback_dir)
                 if lc:
                     gw.append(shlex.join(lc))
             if gw:
@@ -389,7 +395,8 @@ def on_bell(self, window: Window) -> None:
     def relayout(self) -> None:
         if self.allow_relayouts:
             if self.windows:
-                self.current_layout(self.windows)
+                with batched_render_data(self.os_window_id, self.id):
+                    self.current_layout(self.windows)
             self.relayout_borders()
 
     def relayout_borders(self) -> None:
@@ -532,7 +539,7 @@ def launch_child(
         self,
         use_shell: bool = False,
         cmd: list[str] | None = None,
-        stdin: bytes | None = None,
+        stdin: bytes | int | None = None,
         cwd_from: CwdRequest | None = None,
         cwd: str | None = None,
         env: dict[str, str] | None = None,
@@ -614,7 +621,7 @@ def new_window(
         self,
         use_shell: bool = True,
         cmd: list[str] | None = None,
-        stdin: bytes | None = None,
+        stdin: bytes | int | None = None,
         override_title: str | None = None,
         cwd_from: CwdRequest | None = None,
         cwd: str | None = None,
@@ -635,6 +642,7 @@ def new_window(
         next_to: Window | None = None,
         hold_after_ssh: bool = False,
         startup_command_via_shell_integration: Sequence[str] | str = (),
+        restore_scrollback_from: str = '',
     ) -> Window:
         cs = WindowCreationSpec(
             use_shell=use_shell, cmd=cmd, has_stdin=bool(stdin), override_title=override_title, cwd_from=cwd_from,
@@ -657,6 +665,9 @@ def new_window(
             allow_remote_control=allow_remote_control, remote_control_passwords=remote_control_passwords
         )
         window.creation_spec = cs
+        if restore_scrollback_from:
+            # Must be done before adding the child as only one thread can feed the screen
+            window.restore_scrollback(restore_scrollback_from)
         # Must add child before laying out so that resize_pty succeeds
         get_boss().add_child(window)
         self._add_window(window, location=location, overlay_for=overlay_for, overlay_behind=overlay_behind, bias=bias, next_to=next_to)
@@ -26,11 +26,23 @@ static bool cmpr_chars(Chars a, Chars b);
 #define MA_ARENA_NUM_BLOCKS 128u
 #include "arena.h"
 
+// Direct mapped cache of base + one combining char clusters, which are by far
+// the most common multi-codepoint cells, so that drawing them does not need to
+// hash and probe the map. Indices are stored plus one so zero means empty.
+#define PAIR_CACHE_SIZE 256u
+typedef struct PairCacheEntry { char_type base, mark, idx_plus_one; } PairCacheEntry;
+
 typedef struct TextCache {
     struct { Chars *items; size_t capacity; char_type count; } array;
     chars_map map;
     unsigned refcnt;
     CharsMonotonicArena arena;
+    struct {
+        // one bit per entry that existed when the compaction was started
+        uint64_t *marks;
+        char_type num_at_start, live_after_last;
+    } compaction;
+    PairCacheEntry pairs[PAIR_CACHE_SIZE];
 } TextCache;
 static uint64_t hash_chars(Chars k) { return vt_hash_bytes(k.chars, sizeof(k.chars[0]) * k.count); }
 static bool cmpr_chars(Chars a, Chars b) { return a.count == b.count && memcmp(a.chars, b.chars, sizeof(a.chars[0]) * a.count) == 0; }
@@ -55,6 +67,7 @@ free_text_cache(TextCache *self) {
     vt_cleanup(&self->map);
     Chars_free_all(&self->arena);
     free(self->array.items);
+    free(self->compaction.marks);
     free(self);
 }
 
@@ -140,10 +153,103 @@ copy_and_insert(TextCache *self, const Chars key) {
     return ans;
 }
 
-char_type
-tc_get_or_insert_chars(TextCache *self, const ListOfChars *chars) {
-    Chars key = {.count=chars->count, .chars=chars->chars};
+static char_type
+get_or_insert_chars(TextCache *self, const Chars key) {
     chars_map_itr i = vt_get(&self->map, key);
     if (vt_is_end(i)) return copy_and_insert(self, key);
     return i.data->val;
 }
+
+char_type
+tc_get_or_insert_chars(TextCache *self, const ListOfChars *chars) {
+    Chars key = {.count=chars->count, .chars=chars->chars};
+    if (key.count != 2) return get_or_insert_chars(self, key);
+    const char_type base = key.chars[0], mark = key.chars[1];
+    PairCacheEntry *e = self->pairs + (((base * 0x9E3779B1u) ^ (mark * 0x85EBCA6Bu)) >> 24) % PAIR_CACHE_SIZE;
+    if (e->idx_plus_one && e->base == base && e->mark == mark) return e->idx_plus_one - 1;
+    const char_type ans = get_or_insert_chars(self, key);
+    e->base = base; e->mark = mark; e->idx_plus_one = ans + 1;
+    return ans;
+}
+
+// Compaction {{{
+// Entries are never removed when cells are overwritten, so the cache is
+// periodically compacted. The owner marks all indices that are still
+// referenced from its cells, then tc_compact() rebuilds the cache with only
+// those entries and returns a map from old to new indices that the owner must
+// apply to its cells. Entries added after the compaction was started are always
+// kept.
+
+#define TC_MIN_ENTRIES_FOR_COMPACTION 16384u
+
+size_t
+tc_memory_usage(TextCache *self) {
+    size_t ans = self->array.capacity * sizeof(self->array.items[0]);
+    ans += vt_bucket_count(&self->map) * (sizeof(Chars) + sizeof(char_type) + sizeof(uint16_t));
+    for (size_t i = 0; i < self->arena.count; i++) ans += self->arena.blocks[i].capacity;
+    return ans;
+}
+
+bool
+tc_needs_compaction(const TextCache *self) {
+    return self->array.count >= MAX(TC_MIN_ENTRIES_FOR_COMPACTION, 2u * self->compaction.live_after_last);
+}
+
+bool
+tc_compaction_in_progress(const TextCache *self) { return self->compaction.marks != NULL; }
+
+bool
+tc_begin_compaction(TextCache *self) {
+    free(self->compaction.marks);
+    self->compaction.num_at_start = self->array.count;
+    self->compaction.marks = calloc(self->array.count / 64 + 1, sizeof(self->compaction.marks[0]));
+    return self->compaction.marks != NULL;
+}
+
+void
+tc_abort_compaction(TextCache *self) {
+    free(self->compaction.marks); self->compaction.marks = NULL;
+}
+
+void
+tc_mark_index(TextCache *self, char_type idx) {
+    if (idx < self->compaction.num_at_start) self->compaction.marks[idx / 64] |= 1ull << (idx % 64);
+}
+
+static bool
+is_live(const TextCache *self, char_type idx) {
+    return idx >= self->compaction.num_at_start || self->compaction.marks[idx / 64] & (1ull << (idx % 64));
+}
+
+char_type*
+tc_compact(TextCache *self, char_type *num_removed) {
+    *num_removed = 0;
+    if (!self->compaction.marks) return NULL;
+    const size_t capacity = MAX(256u, self->array.count);
+    char_type *remap = malloc(capacity * sizeof(remap[0]));
+    Chars *items = malloc(capacity * sizeof(items[0]));
+    if (!remap || !items) { free(remap); free(items); tc_abort_compaction(self); return NULL; }
+    CharsMonotonicArena arena = {0};
+    chars_map map; vt_init(&map);
+    char_type count = 0;
+    for (char_type i = 0; i < self->array.count; i++) {
+        if (!is_live(self, i)) { remap[i] = 0; continue; }
+        const Chars *src = self->array.items + i;
+        char_type *copy = Chars_get(&arena, src->count * sizeof(src->chars[0]));
+        if (!copy) fatal("Out of memory");
+        memcpy(copy, src->chars, src->count * sizeof(src->chars[0]));
+        items[count].chars = copy; items[count].count = src->count;
+        if (vt_is_end(vt_insert(&map, items[count], count))) fatal("Out of memory");
+        remap[i] = count++;
+    }
+    *num_removed = self->array.count - count;
+    vt_cleanup(&self->map); self->map = map;
+    Chars_free_all(&self->arena); self->arena = arena;
+    free(self->array.items);
+    self->array.items = items; self->array.count = count; self->array.capacity = capacity;
+    self->compaction.live_after_last = count;
+    zero_at_ptr_count(self->pairs, PAIR_CACHE_SIZE);
+    tc_abort_compaction(self);
+    return remap;
+}
+// }}}
@@ -55,3 +55,10 @@ char_type tc_first_char_at_index(const TextCache *self, char_type idx);
 char_type tc_last_char_at_index(const TextCache *self, char_type idx);
 bool tc_chars_at_index_without_alloc(const TextCache *self, char_type idx, ListOfChars *ans);
 unsigned tc_num_codepoints(const TextCache *self, char_type idx);
+bool tc_needs_compaction(const TextCache *self);
+bool tc_compaction_in_progress(const TextCache *self);
+bool tc_begin_compaction(TextCache *self);
+void tc_abort_compaction(TextCache *self);
+void tc_mark_index(TextCache *self, char_type idx);
+char_type* tc_compact(TextCache *self, char_type *num_removed);
+size_t tc_memory_usage(TextCache *self);
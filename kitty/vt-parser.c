@@ -13,13 +13,24 @@
 #include "control-codes.h"
 #include "state.h"
 #include "simd-string.h"
-#include <stdalign.h>
+#include <stdatomic.h>
 
-#define BUF_SZ (1024u*1024u)
+// The buffer starts out small and grows under sustained throughput, being
+// shrunk back once the window has been idle for BUF_SHRINK_AFTER
+#define MIN_BUF_SZ (64u*1024u)
+#define MAX_BUF_SZ (4u*1024u*1024u)
+#define BUF_SHRINK_AFTER s_double_to_monotonic_t(10)
 // The extra bytes are so loads of large integers such as for AVX 512 dont read past the end of the buffer
 #define BUF_EXTRA (512u/8u)
-#define MAX_ESCAPE_CODE_LENGTH (BUF_SZ / 4u)
+#define MAX_ESCAPE_CODE_LENGTH (256u*1024u)
 #define MAX_CSI_PARAMS 256u
+// Data read from the child is handed to the parser via a single producer, single
+// consumer ring buffer. Its size is a power of two, it is doubled when the
+// parser finds it full, so that bulk output is not throttled to what fits in
+// the smallest ring between two parse passes, and shrunk back along with the
+// parse buffer.
+#define MIN_RING_SZ MIN_BUF_SZ
+#define MAX_RING_SZ (MAX_BUF_SZ / 2u)
 
 
 // Macros {{{
@@ -209,7 +220,11 @@ typedef struct ParsedCSI {
 } ParsedCSI;
 
 typedef struct PS {
-    alignas(BUF_EXTRA) uint8_t buf[BUF_SZ + BUF_EXTRA];
+    uint8_t *buf;
+    size_t buf_sz, high_water_mark;
+    // allocated size of buf, for reading from other threads
+    _Atomic(size_t) buf_allocated;
+    monotonic_t last_input_at;
     UTF8Decoder utf8_decoder;
 
     id_type window_id;
@@ -220,12 +235,34 @@ typedef struct PS {
     // these are temporary variables set only for duration of a parse call
     PyObject *dump_callback;
     Screen *screen;
-    monotonic_t now, new_input_at;
-    pthread_mutex_t lock;
+    monotonic_t now;
 
-    // The buffer
+    // The buffer, owned by the parsing thread
     struct { size_t consumed, pos, sz; } read;
-    struct { size_t offset, sz, pending; } write;
+    bool partial_command_dispatched;
+
+    // Throughput measurement for adaptive_input_delay, owned by the parsing thread
+    struct {
+        monotonic_t interval_start;
+        size_t bytes;
+        InputRegime regime;
+    } throughput;
+    _Atomic(monotonic_t) key_sent_at;
+
+    // The ring buffer shared with the I/O thread. head and tail only ever
+    // increase, the producer owns head and the consumer owns tail. They are
+    // kept on separate cache lines to avoid false sharing. buf and sz are
+    // changed only by the producer, when the ring is empty, and are read by
+    // the consumer only after it acquires a head past its tail.
+    struct {
+        _Alignas(BUF_EXTRA) _Atomic(size_t) head;
+        _Atomic(uint8_t*) buf;
+        _Atomic(size_t) sz;
+        size_t write_sz;
+        _Atomic(monotonic_t) new_input_at;
+        _Alignas(BUF_EXTRA) _Atomic(size_t) tail;
+        _Atomic(size_t) wanted_sz;
+    } ring;
 } PS;
 
 static void
@@ -245,17 +282,20 @@ dispatch_single_byte_control(PS *self, uint32_t ch) {
 }
 
 static void
-consume_normal(PS *self) {
+consume_normal_upto(PS *self, size_t limit) {
     do {
-        const bool sentinel_found = utf8_decode_to_esc(&self->utf8_decoder, self->buf + self->read.pos, self->read.sz - self->read.pos);
+        const bool sentinel_found = utf8_decode_to_esc(&self->utf8_decoder, self->buf + self->read.pos, limit - self->read.pos);
         self->read.pos += self->utf8_decoder.num_consumed;
         if (self->utf8_decoder.output.pos) {
             REPORT_DRAW(self->utf8_decoder.output.storage, self->utf8_decoder.output.pos);
             screen_draw_text(self->screen, self->utf8_decoder.output.storage, self->utf8_decoder.output.pos);
         }
         if (sentinel_found) { SET_STATE(ESC); break; }
-    } while (self->read.pos < self->read.sz);
+    } while (self->read.pos < limit);
 }
+
+static void
+consume_normal(PS *self) { consume_normal_upto(self, self->read.sz); }
 // }}}
 
 // Esc mode {{{
@@ -411,6 +451,8 @@ continue_osc_52(PS *self) {
 }
 
 
+static bool continue_graphics_command(PS *self);
+
 static bool
 accumulate_st_terminated_esc_code(PS *self, void(dispatch)(PS*, uint8_t*, size_t, bool)) {
     size_t pos;
@@ -436,6 +478,7 @@ accumulate_st_terminated_esc_code(PS *self, void(dispatch)(PS*, uint8_t*, size_t
             continue_osc_52(self);
             return accumulate_st_terminated_esc_code(self, dispatch);
         }
+        if (self->vte_state == VTE_APC && continue_graphics_command(self)) return accumulate_st_terminated_esc_code(self, dispatch);
         REPORT_ERROR("%s escape code too long (%zu bytes), ignoring it", vte_state_name(self->vte_state), pos);
         return true;
     }
@@ -669,6 +712,47 @@ parse_kitty_dcs(PS *self, uint8_t *buf, size_t bufsz) {
 #undef inc
 }
 
+static void dispatch_apc(PS *self, uint8_t *buf, size_t bufsz, bool is_extended);
+static void dispatch_dcs(PS *self, uint8_t *buf, size_t bufsz, bool is_extended);
+
+// Programs that think they are running inside tmux wrap escape codes as
+// DCS tmux; <code with every ESC doubled> ST. These reach us unchanged when the
+// program is not actually behind tmux, for example over ssh from inside a tmux
+// session. The doubled ESC before the inner ST means the DCS was terminated
+// at the inner ST, so buf ends with a single ESC and the outer ST is still
+// pending in the read buffer. The wrapped code is unescaped in place and
+// dispatched directly, graphics payloads contain no ESC so they are never copied.
+static bool
+handle_tmux_passthrough(PS *self, uint8_t *buf, size_t bufsz) {
+    if (!startswith(buf, bufsz, "tmux;", literal_strlen("tmux;"))) return false;
+    uint8_t *p = buf + literal_strlen("tmux;"), *end = buf + bufsz;
+    if (end - p < 4 || p[0] != ESC || p[1] != ESC || (p[2] != '_' && p[2] != 'P') || end[-1] != ESC) return false;
+    const uint8_t type = p[2];
+    p += 3; end--;
+    uint8_t *esc = memchr(p, ESC, end - p);
+    if (esc) {
+        uint8_t *dest = esc, *src = esc;
+        while (src < end) {
+            *dest++ = *src++;
+            if (src < end && *src == ESC) src++;
+            uint8_t *next = memchr(src, ESC, end - src);
+            const size_t run = (next ? next : end) - src;
+            memmove(dest, src, run);
+            dest += run; src += run;
+        }
+        end = dest;
+    }
+    *end = 0;
+    const size_t sz = end - p;
+    if (type == '_') dispatch_apc(self, p, sz, false);
+    else {
+        if (startswith(p, sz, "tmux;", literal_strlen("tmux;"))) return false;
+        dispatch_dcs(self, p, sz, false);
+    }
+    if (self->read.pos + 1 < self->read.sz && self->buf[self->read.pos] == ESC && self->buf[self->read.pos + 1] == ESC_ST) self->read.pos += 2;
+    return true;
+}
+
 static void
 dispatch_dcs(PS *self, uint8_t *buf, size_t bufsz, bool is_extended UNUSED) {
     if (bufsz < 2) return;
@@ -707,6 +791,9 @@ dispatch_dcs(PS *self, uint8_t *buf, size_t bufsz, bool is_extended UNUSED) {
         case '@':
             if (!parse_kitty_dcs(self, buf + 1, bufsz-1)) REPORT_UKNOWN_ESCAPE_CODE("DCS", buf);
             break;
+        case 't':
+            if (!handle_tmux_passthrough(self, buf, bufsz)) REPORT_UKNOWN_ESCAPE_CODE("DCS", buf);
+            break;
         default:
             REPORT_UKNOWN_ESCAPE_CODE("DCS", buf);
             break;
@@ -888,8 +975,45 @@ csi_parse_loop(PS *self, ParsedCSI *csi, const uint8_t *buf, size_t *pos, const
 #undef COMMIT_PARAM
 }
 
+static bool
+csi_parse_fast(ParsedCSI *csi, const uint8_t *buf, size_t *pos, const size_t sz) {
+    // Fast path for the common case of a CSI consisting only of numeric
+    // parameters followed by a trailer, such as SGR and CUP. It is used only
+    // when the complete escape code is already in the buffer, everything else
+    // is left to csi_parse_loop()
+    const uint8_t *p = buf + *pos, *end = find_end_of_csi_params(p, sz - *pos);
+    if (!end || end - p >= (ptrdiff_t)MAX_CSI_PARAMS || *p == ':') return false;
+    switch (*end) {
+        case CSI_TRAILER: break;
+        default: return false;
+    }
+    unsigned num_digits = 0, accumulator = 0;
+    if (*p == ';') { csi->params[csi->num_params++] = 0; p++; }
+    for (; p < end; p++) {
+        const uint8_t ch = *p;
+        if (ch <= '9') {
+            // numbers that do not fit in an int are left to the slow path
+            if (UNLIKELY(++num_digits > 9)) { csi->num_params = 0; return false; }
+            accumulator = accumulator * 10 + (ch - '0');
+        } else {
+            // an empty parameter before ; means zero, before : it is ignored
+            if (num_digits || ch == ';') {
+                csi->params[csi->num_params++] = accumulator;
+                num_digits = 0; accumulator = 0;
+            }
+            csi->is_sub_param[csi->num_params] = ch == ':';
+        }
+    }
+    if (num_digits) csi->params[csi->num_params++] = accumulator;
+    csi->is_valid = true;
+    csi->trailer = *end;
+    *pos = end - buf + 1;
+    return true;
+}
+
 static bool
 consume_csi(PS *self) {
+    if (self->csi.state == CSI_START && csi_parse_fast(&self->csi, self->buf, &self->read.pos, self->read.sz)) return true;
     return csi_parse_loop(self, &self->csi, self->buf, &self->read.pos, self->read.sz, self->read.consumed);
 }
 
@@ -1404,7 +1528,7 @@ dispatch_apc(PS *self, uint8_t *buf, size_t bufsz, bool is_extended UNUSED) {
     if (bufsz < 2) return;
     switch(buf[0]) {
         case 'G':
-            parse_graphics_code(self, buf, bufsz);
+            parse_graphics_code(self, buf, bufsz, false);
             break;
         default:
             REPORT_ERROR("Unrecognized APC code: 0x%x", buf[0]);
@@ -1412,6 +1536,45 @@ dispatch_apc(PS *self, uint8_t *buf, size_t bufsz, bool is_extended UNUSED) {
     }
 }
 
+// Graphics commands too long to buffer are delivered as a chunked
+// transmission: everything received so far is dispatched as a chunk that has
+// more data following, and the unconsumed tail of the payload is prefixed
+// with a header so that it becomes the next chunk. The payload is decoded in
+// place as before, so nothing is buffered beyond one chunk.
+static bool
+continue_graphics_command(PS *self) {
+    uint8_t *buf = self->buf + self->read.consumed, *end = self->buf + self->read.pos;
+    if (*buf != 'G') return false;
+    uint8_t *payload = memchr(buf, ';', MIN((size_t)(end - buf), 1024u));
+    if (!payload) return false;
+    // the final chunk must carry the more flag of the original command
+    bool more = false;
+    for (const uint8_t *p = buf + 1; p + 2 < payload; p++) {
+        if ((p == buf + 1 || p[-1] == ',') && p[0] == 'm' && p[1] == '=') {
+            more = false;
+            for (const uint8_t *v = p + 2; v < payload && '0' <= *v && *v <= '9'; v++) if (*v != '0') more = true;
+        }
+    }
+    payload++;
+    if (end[-1] == ESC) end--;  // start of the ST
+    // base64 is decoded in groups of four
+    uint8_t *chunk_end = payload + ((end - payload) & ~3);
+    const char *header = more ? "Gm=1;" : "G;";
+    const size_t header_sz = strlen(header);
+    if ((size_t)(chunk_end - payload) < 4 * header_sz) return false;
+    const uint8_t before = *chunk_end;
+    *chunk_end = 0;
+    self->partial_command_dispatched = false;
+    parse_graphics_code(self, buf, chunk_end - buf, true);
+    *chunk_end = before;
+    if (!self->partial_command_dispatched) return false;
+    // the decoded payload occupies at most the first three quarters of the
+    // chunk so the header never overwrites anything in use
+    self->read.consumed = chunk_end - header_sz - self->buf;
+    memcpy(self->buf + self->read.consumed, header, header_sz);
+    return true;
+}
+
 // }}}
 
 // PM mode {{{
@@ -1486,44 +1649,213 @@ consume_input(PS *self, PyObject *dump_callback UNUSED, id_type window_id UNUSED
 #undef consume
 }
 
+#ifndef DUMP_COMMANDS
+static bool
+is_main_thread_safe_csi(const ParsedCSI *csi) {
+    // CSI codes whose handlers only modify the screen and never call into
+    // Python, write to the child or touch the windowing system
+    if (csi->primary || csi->secondary) return false;
+    switch (csi->trailer) {
+        case ICH: case REP: case CUU: case CUD: case VPR: case CUF: case HPR:
+        case CUB: case CNL: case CPL: case CHA: case HPA: case VPA: case CUP:
+        case HVP: case EL: case IL: case DL: case DCH: case ECH: case SGR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool
+consume_input_off_main_thread(PS *self) {
+    // Consume only input that is safe to handle on a worker thread, returns
+    // false when input that must be handled on the main thread is reached.
+    // Since read.consumed always points to the start of the current escape
+    // code, an escape code can be given up on by rewinding to it.
+    switch (self->vte_state) {
+        case VTE_NORMAL: {
+            size_t limit = self->read.sz;
+            const uint8_t *q = find_either_of_two_bytes(self->buf + self->read.pos, limit - self->read.pos, ESC, BEL);
+            if (q && *q == BEL) {
+                limit = q - self->buf;
+                if (limit == self->read.pos) return false;
+            }
+            consume_normal_upto(self, limit); self->read.consumed = self->read.pos;
+        } return true;
+        case VTE_ESC:
+            if (self->read.pos != self->read.consumed || self->buf[self->read.pos] != ESC_CSI) return false;
+            if (consume_esc(self)) { self->read.consumed = self->read.pos; }
+            return true;
+        case VTE_CSI:
+            if (consume_csi(self)) {
+                if (self->csi.is_valid && !is_main_thread_safe_csi(&self->csi)) {
+                    self->read.pos = self->read.consumed; reset_csi(&self->csi);
+                    return false;
+                }
+                self->read.consumed = self->read.pos; if (self->csi.is_valid) dispatch_csi(self); SET_STATE(NORMAL);
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+#endif
+
 // }}}
 
 // API {{{
 
-#define with_lock pthread_mutex_lock(&self->lock);
-#define end_with_lock pthread_mutex_unlock(&self->lock);
+static uint8_t*
+alloc_buffer(size_t sz) {
+    uint8_t *ans;
+    if (posix_memalign((void**)&ans, BUF_EXTRA, sz + BUF_EXTRA) != 0) return NULL;
+    memset(ans + sz, 0, BUF_EXTRA);
+    return ans;
+}
+
+static void
+resize_buffer(PS *self, size_t sz) {
+    uint8_t *buf = alloc_buffer(sz);
+    if (!buf) return;
+    memcpy(buf, self->buf, self->read.sz);
+    free(self->buf); self->buf = buf; self->buf_sz = sz;
+    atomic_store_explicit(&self->buf_allocated, sz + BUF_EXTRA, memory_order_relaxed);
+}
+
+static void
+adapt_buffer_size(PS *self, monotonic_t now) {
+    if (!self->buf) return;  // released, see vt_parser_release_buffer()
+    if (self->read.sz > self->high_water_mark) self->high_water_mark = self->read.sz;
+    if (self->read.sz + self->buf_sz / 8u >= self->buf_sz) {
+        // nearly full either because of sustained throughput or a large escape code
+        if (self->buf_sz < MAX_BUF_SZ) resize_buffer(self, MIN(MAX_BUF_SZ, 2u * self->buf_sz));
+    } else if (self->buf_sz > MIN_BUF_SZ && self->read.sz <= MIN_BUF_SZ / 2u && now - self->last_input_at >= BUF_SHRINK_AFTER) {
+        resize_buffer(self, MIN_BUF_SZ);
+        atomic_store_explicit(&self->ring.wanted_sz, MIN_RING_SZ, memory_order_relaxed);
+    }
+}
+
+static void
+ensure_buffer(PS *self) {
+    if (LIKELY(self->buf) || atomic_load_explicit(&self->ring.head, memory_order_acquire) == atomic_load_explicit(&self->ring.tail, memory_order_relaxed)) return;
+    if (!(self->buf = alloc_buffer(MIN_BUF_SZ))) fatal("Out of memory allocating VT parser buffer");
+    self->buf_sz = MIN_BUF_SZ;
+    atomic_store_explicit(&self->buf_allocated, MIN_BUF_SZ + BUF_EXTRA, memory_order_relaxed);
+}
+
+static bool
+drain_ring(PS *self) {
+    // Move as much data as fits from the ring buffer into the parse buffer,
+    // returns true if the ring was full, i.e. the producer may be waiting for space
+    const size_t tail = atomic_load_explicit(&self->ring.tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&self->ring.head, memory_order_acquire);
+    const size_t available = head - tail, n = MIN(available, self->buf_sz - self->read.sz);
+    if (!n) return false;
+    const uint8_t *rbuf = atomic_load_explicit(&self->ring.buf, memory_order_relaxed);
+    const size_t rsz = atomic_load_explicit(&self->ring.sz, memory_order_relaxed);
+    const size_t offset = tail & (rsz - 1), first = MIN(n, rsz - offset);
+    memcpy(self->buf + self->read.sz, rbuf + offset, first);
+    if (first < n) memcpy(self->buf + self->read.sz + first, rbuf, n - first);
+    self->read.sz += n;
+    atomic_store_explicit(&self->ring.tail, tail + n, memory_order_release);
+    if (available < rsz) return false;
+    // the producer is being throttled by the size of the ring
+    if (rsz < MAX_RING_SZ) atomic_store_explicit(&self->ring.wanted_sz, 2u * rsz, memory_order_relaxed);
+    return true;
+}
+
+// Adaptive input delay {{{
+// The bytes parsed in every THROUGHPUT_INTERVAL are counted, sustained high
+// throughput is treated as bulk output, for which parsing is deferred for
+// longer so that the screen is drawn less often. A small amount of input
+// arriving shortly after a key was sent to the child is treated as the echo
+// of that key and is parsed and drawn immediately.
+#define THROUGHPUT_INTERVAL ms_to_monotonic_t(100ll)
+#define BULK_BYTES_PER_INTERVAL (512u * 1024u)
+#define BULK_INPUT_DELAY ms_to_monotonic_t(25ll)
+#define KEY_ECHO_WINDOW ms_to_monotonic_t(50ll)
+#define MAX_KEY_ECHO_SIZE 4096u
+
+static void
+update_throughput(PS *self, size_t parsed, monotonic_t now) {
+    self->throughput.bytes += parsed;
+    if (now - self->throughput.interval_start >= THROUGHPUT_INTERVAL) {
+        // A gap of more than an interval with no input is not sustained throughput
+        const bool sustained = now - self->throughput.interval_start < 2 * THROUGHPUT_INTERVAL;
+        self->throughput.regime = sustained && self->throughput.bytes >= BULK_BYTES_PER_INTERVAL ? INPUT_REGIME_BULK : INPUT_REGIME_NORMAL;
+        self->throughput.interval_start = now;
+        self->throughput.bytes = 0;
+    } else if (self->throughput.bytes >= BULK_BYTES_PER_INTERVAL) self->throughput.regime = INPUT_REGIME_BULK;
+}
+
+static monotonic_t
+effective_input_delay(PS *self, monotonic_t new_input_at) {
+    if (!OPT(adaptive_input_delay)) return OPT(input_delay);
+    if (self->throughput.regime == INPUT_REGIME_BULK) return MAX(OPT(input_delay), BULK_INPUT_DELAY);
+    const monotonic_t key_sent_at = atomic_load_explicit(&self->key_sent_at, memory_order_relaxed);
+    if (key_sent_at && new_input_at >= key_sent_at && new_input_at - key_sent_at <= KEY_ECHO_WINDOW && self->read.sz - self->read.pos <= MAX_KEY_ECHO_SIZE) {
+        self->throughput.regime = INPUT_REGIME_INTERACTIVE;
+        return 0;
+    }
+    if (self->throughput.regime == INPUT_REGIME_INTERACTIVE) self->throughput.regime = INPUT_REGIME_NORMAL;
+    return OPT(input_delay);
+}
+
+#ifndef DUMP_COMMANDS
+void
+vt_parser_note_key_sent(Parser *p) {
+    PS *self = (PS*)p->state;
+    atomic_store_explicit(&self->key_sent_at, monotonic(), memory_order_relaxed);
+}
+#endif
+// }}}
 
 static void
 run_worker(void *p, ParseData *pd, bool flush) {
     Screen *screen = (Screen*)p;
     PS *self = (PS*)screen->vt_parser->state;
     screen->parsing_at = pd->now;
-    with_lock {
-        self->read.sz += self->write.pending; self->write.pending = 0;
-        pd->has_pending_input = self->read.pos < self->read.sz;
-        if (pd->has_pending_input) {
-            pd->time_since_new_input = pd->now - self->new_input_at;
-            if (flush || pd->time_since_new_input >= OPT(input_delay) || self->read.sz + 16 * 1024 > BUF_SZ) {
-                pd->input_read = true;
-                self->dump_callback = pd->dump_callback; self->now = pd->now;
-                self->screen = screen;
-                self->read.consumed = 0;
-                do {
-                    end_with_lock; {
-                        consume_input(self, pd->dump_callback, screen->window_id);
-                    } with_lock;
-                    self->read.sz += self->write.pending; self->write.pending = 0;
-                } while (self->read.pos < self->read.sz);
-                self->new_input_at = 0;
-                if (self->read.consumed) {
-                    pd->write_space_created = self->read.sz >= BUF_SZ;
-                    self->read.pos -= MIN(self->read.pos, self->read.consumed);
-                    self->read.sz -= MIN(self->read.sz, self->read.consumed);
-                    if (self->read.sz) memmove(self->buf, self->buf + self->read.consumed, self->read.sz);
-                }
+    ensure_buffer(self);
+    bool write_space_created = drain_ring(self);
+    adapt_buffer_size(self, pd->now);
+    write_space_created |= drain_ring(self);
+    pd->has_pending_input = self->read.pos < self->read.sz;
+    if (pd->has_pending_input) {
+        self->last_input_at = pd->now;
+        const monotonic_t new_input_at = atomic_load_explicit(&self->ring.new_input_at, memory_order_relaxed);
+        pd->time_since_new_input = pd->now - new_input_at;
+        pd->input_delay = effective_input_delay(self, new_input_at);
+        if (flush || pd->time_since_new_input >= pd->input_delay || self->read.sz + 16 * 1024 > self->buf_sz) {
+            pd->input_read = true;
+            self->dump_callback = pd->dump_callback; self->now = pd->now;
+            self->screen = screen;
+            self->read.consumed = 0;
+            atomic_store_explicit(&self->ring.new_input_at, 0, memory_order_relaxed);
+            const monotonic_t stop_at = pd->time_slice ? monotonic() + pd->time_slice : 0;
+            do {
+                bool stopped = false;
+#ifndef DUMP_COMMANDS
+                if (pd->off_main_thread) stopped = !consume_input_off_main_thread(self);
+                else
+#endif
+                consume_input(self, pd->dump_callback, screen->window_id);
+                write_space_created |= drain_ring(self);
+                if (stopped) { pd->needs_main_thread = true; break; }
+                // the ring is refilled while parsing, a window being flooded with output must not
+                // keep the thread to itself, leaving input in the ring makes the I/O thread stop
+                // reading from its pty until there is space again
+                if (stop_at && monotonic() >= stop_at) break;
+            } while (self->read.pos < self->read.sz);
+            if (OPT(adaptive_input_delay)) update_throughput(self, self->read.consumed, pd->now);
+            if (self->read.consumed) {
+                self->read.pos -= MIN(self->read.pos, self->read.consumed);
+                self->read.sz -= MIN(self->read.sz, self->read.consumed);
+                if (self->read.sz) memmove(self->buf, self->buf + self->read.consumed, self->read.sz);
+                write_space_created |= drain_ring(self);
             }
         }
-    } end_with_lock;
+    }
+    pd->write_space_created = write_space_created;
+    pd->regime = self->throughput.regime;
 }
 
 #ifndef DUMP_COMMANDS
@@ -1531,38 +1863,73 @@ run_worker(void *p, ParseData *pd, bool flush) {
 uint8_t*
 vt_parser_create_write_buffer(Parser *p, size_t *sz) {
     PS *self = (PS*)p->state;
-    uint8_t *ans;
-    with_lock {
-        if (self->write.sz) fatal("vt_parser_create_write_buffer() called with an already existing write buffer");
-        self->write.offset = self->read.sz + self->write.pending;
-        *sz = BUF_SZ - self->write.offset;
-        self->write.sz = *sz;
-        ans = self->buf + self->write.offset;
-    } end_with_lock;
-    return ans;
+    if (self->ring.write_sz) fatal("vt_parser_create_write_buffer() called with an already existing write buffer");
+    const size_t head = atomic_load_explicit(&self->ring.head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&self->ring.tail, memory_order_acquire);
+    uint8_t *rbuf = atomic_load_explicit(&self->ring.buf, memory_order_relaxed);
+    size_t rsz = atomic_load_explicit(&self->ring.sz, memory_order_relaxed);
+    const size_t wanted_sz = atomic_load_explicit(&self->ring.wanted_sz, memory_order_relaxed);
+    if (head == tail && wanted_sz != rsz) {
+        // The consumer has copied everything out of the ring and does not
+        // touch it again until head is advanced, so it can be replaced
+        uint8_t *nbuf = malloc(wanted_sz);
+        if (nbuf) {
+            free(rbuf); rbuf = nbuf; rsz = wanted_sz;
+            atomic_store_explicit(&self->ring.buf, rbuf, memory_order_relaxed);
+            atomic_store_explicit(&self->ring.sz, rsz, memory_order_relaxed);
+        }
+    }
+    const size_t offset = head & (rsz - 1);
+    *sz = MIN(rsz - (head - tail), rsz - offset);
+    self->ring.write_sz = *sz;
+    return rbuf + offset;
 }
 
 void
 vt_parser_commit_write(Parser *p, size_t sz) {
     PS *self = (PS*)p->state;
-    with_lock {
-        size_t off = self->read.sz + self->write.pending;
-        if (self->new_input_at == 0) self->new_input_at = monotonic();
-        if (self->write.offset > off) memmove(self->buf + off, self->buf + self->write.offset, sz);
-        self->write.pending += sz;
-        self->write.sz = 0;
-    } end_with_lock;
+    if (sz) {
+        const size_t head = atomic_load_explicit(&self->ring.head, memory_order_relaxed);
+        atomic_store_explicit(&self->ring.head, head + sz, memory_order_release);
+        monotonic_t expected = 0;
+        atomic_compare_exchange_strong_explicit(&self->ring.new_input_at, &expected, monotonic(), memory_order_relaxed, memory_order_relaxed);
+    }
+    self->ring.write_sz = 0;
 }
 
 bool
 vt_parser_has_space_for_input(const Parser *p) {
     PS *self = (PS*)p->state;
-    bool ans;
-    with_lock {
-        ans = self->read.sz + self->write.pending < BUF_SZ;
-    } end_with_lock;
+    const size_t head = atomic_load_explicit(&self->ring.head, memory_order_relaxed);
+    return head - atomic_load_explicit(&self->ring.tail, memory_order_acquire) < atomic_load_explicit(&self->ring.sz, memory_order_relaxed);
+}
+
+size_t
+vt_parser_release_buffer(Parser *p) {
+    // Frees the parse buffer of an idle window, it is allocated again when
+    // input arrives. Returns the number of bytes freed.
+    PS *self = (PS*)p->state;
+    if (!self->buf || self->read.sz) return 0;
+    const size_t ans = self->buf_sz + BUF_EXTRA;
+    free(self->buf); self->buf = NULL; self->buf_sz = 0;
+    atomic_store_explicit(&self->buf_allocated, 0, memory_order_relaxed);
+    atomic_store_explicit(&self->ring.wanted_sz, MIN_RING_SZ, memory_order_relaxed);
     return ans;
 }
+
+size_t
+vt_parser_memory_usage(const Parser *p) {
+    // The parse buffer and ring can be resized by the parse and I/O threads
+    // meanwhile, so only their atomically published sizes are read here
+    PS *self = (PS*)p->state;
+    return sizeof(PS) + atomic_load_explicit(&self->buf_allocated, memory_order_relaxed) + atomic_load_explicit(&self->ring.sz, memory_order_relaxed);
+}
+
+bool
+vt_parser_has_pending_input(const Parser *p) {
+    PS *self = (PS*)p->state;
+    return self->read.pos < self->read.sz || atomic_load_explicit(&self->ring.head, memory_order_acquire) != atomic_load_explicit(&self->ring.tail, memory_order_relaxed);
+}
 #endif
 
 // }}}
@@ -1590,7 +1957,7 @@ free_vt_parser(Parser* self) {
     if (self->state) {
         PS *s = (PS*)self->state;
         utf8_decoder_free(&s->utf8_decoder);
-        pthread_mutex_destroy(&s->lock);
+        free(s->buf); free(atomic_load_explicit(&s->ring.buf, memory_order_relaxed));
         free(self->state); self->state = NULL;
     }
     Py_TYPE(self)->tp_free((PyObject*)self);
@@ -1616,8 +1983,41 @@ current_state(Parser *self, PyObject *closure UNUSED) {
     return PyUnicode_FromString(vte_state_name(state->vte_state));
 }
 
+static PyObject*
+buffer_size(Parser *p, PyObject *closure UNUSED) {
+    PS *self = (PS*)p->state;
+    return PyLong_FromSize_t(self->buf_sz);
+}
+
+static PyObject*
+buffer_high_water_mark(Parser *p, PyObject *closure UNUSED) {
+    PS *self = (PS*)p->state;
+    return PyLong_FromSize_t(self->high_water_mark);
+}
+
+static PyObject*
+ring_size(Parser *p, PyObject *closure UNUSED) {
+    PS *self = (PS*)p->state;
+    return PyLong_FromSize_t(atomic_load_explicit(&self->ring.sz, memory_order_relaxed));
+}
+
+static PyObject*
+input_regime(Parser *p, PyObject *closure UNUSED) {
+    PS *self = (PS*)p->state;
+    switch (self->throughput.regime) {
+        case INPUT_REGIME_BULK: return PyUnicode_FromString("bulk");
+        case INPUT_REGIME_INTERACTIVE: return PyUnicode_FromString("interactive");
+        case INPUT_REGIME_NORMAL: break;
+    }
+    return PyUnicode_FromString("normal");
+}
+
 static PyGetSetDef getsetters[] = {
     {"vte_state", (getter)current_state, NULL, "The VTE parser state", NULL},
+    {"buffer_size", (getter)buffer_size, NULL, "The current size of the input buffer", NULL},
+    {"buffer_high_water_mark", (getter)buffer_high_water_mark, NULL, "The largest amount of unparsed input seen in the input buffer", NULL},
+    {"ring_size", (getter)ring_size, NULL, "The current size of the ring buffer used to hand input to the parser", NULL},
+    {"input_regime", (getter)input_regime, NULL, "How input is currently being scheduled for parsing when adaptive_input_delay is enabled", NULL},
     {NULL}  /* Sentinel */
 };
 
@@ -1650,14 +2050,16 @@ alloc_vt_parser(id_type window_id) {
         }
         memset(self->state, 0, sizeof(PS));
         PS *state = (PS*)self->state;
-        if ((intptr_t)state->buf % BUF_EXTRA != 0) {
-            Py_CLEAR(self); PyErr_SetString(PyExc_TypeError, "PS->buf is not aligned");
-            return NULL;
-        }
-        if ((ret = pthread_mutex_init(&state->lock, NULL)) != 0) {
-            Py_CLEAR(self); PyErr_Format(PyExc_RuntimeError, "Failed to create Parser lock mutex: %s", strerror(ret));
+        uint8_t *ring_buf = NULL;
+        if (!(state->buf = alloc_buffer(MIN_BUF_SZ)) || !(ring_buf = malloc(MIN_RING_SZ))) {
+            Py_CLEAR(self); PyErr_NoMemory();
             return NULL;
         }
+        state->buf_sz = MIN_BUF_SZ;
+        atomic_init(&state->buf_allocated, MIN_BUF_SZ + BUF_EXTRA);
+        atomic_init(&state->ring.buf, ring_buf); atomic_init(&state->ring.sz, MIN_RING_SZ); atomic_init(&state->ring.wanted_sz, MIN_RING_SZ);
+        atomic_init(&state->ring.head, 0); atomic_init(&state->ring.tail, 0);
+        atomic_init(&state->ring.new_input_at, 0); atomic_init(&state->key_sent_at, 0);
         state->window_id = window_id;
         utf8_decoder_reset(&state->utf8_decoder);
         reset_csi(&state->csi);
@@ -1667,7 +2069,8 @@ alloc_vt_parser(id_type window_id) {
 
 #undef EXTRA_INIT
 #define EXTRA_INIT \
-    if (0 != PyModule_AddIntConstant(module, "VT_PARSER_BUFFER_SIZE", BUF_SZ)) return 0; \
+    if (0 != PyModule_AddIntConstant(module, "VT_PARSER_BUFFER_SIZE", MIN_BUF_SZ)) return 0; \
+    if (0 != PyModule_AddIntConstant(module, "VT_PARSER_MAX_BUFFER_SIZE", MAX_BUF_SZ)) return 0; \
     if (0 != PyModule_AddIntConstant(module, "VT_PARSER_MAX_ESCAPE_CODE_SIZE", MAX_ESCAPE_CODE_LENGTH)) return 0; \
     if (!init_simd(module)) return 0; \
 
@@ -16,12 +16,22 @@ typedef struct Parser {
     PARSER_STATE_HANDLE *state;
 } Parser;
 
+typedef enum { INPUT_REGIME_NORMAL, INPUT_REGIME_BULK, INPUT_REGIME_INTERACTIVE } InputRegime;
+
 typedef struct ParseData {
     PyObject *dump_callback;
     monotonic_t now;
-
-    bool input_read, write_space_created, has_pending_input;
-    monotonic_t time_since_new_input;
+    // When set, only input that can be handled without calling into Python
+    // or the windowing system is parsed and needs_main_thread is set if
+    // parsing stopped before all ready input was consumed.
+    bool off_main_thread;
+    // When non-zero, parsing stops once roughly this much time has been spent
+    // even if more input is ready, the rest is parsed on the next loop iteration
+    monotonic_t time_slice;
+
+    bool input_read, write_space_created, has_pending_input, needs_main_thread;
+    monotonic_t time_since_new_input, input_delay;
+    InputRegime regime;
 } ParseData;
 
 // The must only be called on the main thread
@@ -30,9 +40,15 @@ void free_vt_parser(Parser*);
 void reset_vt_parser(Parser*);
 
 
-// The following are thread safe, using an internal lock
+// The following are lock free. The first three must only be called by a
+// single producer thread, the rest by a single consumer (parsing) thread at a time.
 uint8_t* vt_parser_create_write_buffer(Parser*, size_t*);
 void vt_parser_commit_write(Parser*, size_t);
 bool vt_parser_has_space_for_input(const Parser*);
+bool vt_parser_has_pending_input(const Parser*);
+size_t vt_parser_release_buffer(Parser*);
+// Can be called from any thread
+void vt_parser_note_key_sent(Parser*);
+size_t vt_parser_memory_usage(const Parser*);
 void parse_worker(void *p, ParseData *data, bool flush);
 void parse_worker_dump(void *p, ParseData *data, bool flush);
@@ -101,13 +101,34 @@ wcswidth_step(WCSState *state, const char_type ch) {
     return ans;
 }
 
+static bool
+is_printable_ascii(char_type ch) { return ' ' <= ch && ch < 0x7f; }
+
+size_t
+wcswidth_chars(WCSState *state, const char_type *chars, size_t num) {
+    // Runs of printable ASCII characters, by far the most common case, all
+    // have width one and cannot combine with the preceding character when it
+    // is not part of a grapheme cluster, so they are handled in bulk
+    size_t ans = 0;
+    for (size_t i = 0; i < num; i++) {
+        if (state->parser_state == NORMAL && state->seg.grapheme_break <= GBP_None && is_printable_ascii(chars[i])) {
+            size_t n = 1;
+            while (i + n < num && is_printable_ascii(chars[i + n])) n++;
+            ans += n; i += n - 1;
+            state->prev_ch = chars[i]; state->prev_width = 1; state->can_combine = true;
+            state->seg = (GraphemeSegmentationResult){.grapheme_break=GBP_None};
+        } else ans += wcswidth_step(state, chars[i]);
+    }
+    return ans;
+}
+
 size_t
 wcswidth_string(const char_type *s) {
     WCSState state;
     initialize_wcs_state(&state);
-    size_t ans = 0;
-    while (*s) ans += wcswidth_step(&state, *(s++));
-    return ans;
+    size_t len = 0;
+    while (s[len]) len++;
+    return wcswidth_chars(&state, s, len);
 }
 
 PyObject *
@@ -116,8 +137,14 @@ wcswidth_std(PyObject UNUSED *self, PyObject *str) {
     int kind = PyUnicode_KIND(str);
     void *data = PyUnicode_DATA(str);
     Py_ssize_t len = PyUnicode_GET_LENGTH(str), i;
+    if (PyUnicode_IS_ASCII(str)) {
+        const uint8_t *p = data;
+        for (i = 0; i < len && is_printable_ascii(p[i]); i++);
+        if (i == len) return PyLong_FromSsize_t(len);
+    }
     WCSState state;
     initialize_wcs_state(&state);
+    if (kind == PyUnicode_4BYTE_KIND) return PyLong_FromSize_t(wcswidth_chars(&state, data, len));
     size_t ans = 0;
     for (i = 0; i < len; i++) {
         char_type ch = PyUnicode_READ(kind, data, i);
@@ -23,3 +23,4 @@ void initialize_wcs_state(WCSState *state);
 int wcswidth_step(WCSState *state, const char_type ch);
 PyObject * wcswidth_std(PyObject UNUSED *self, PyObject *str);
 size_t wcswidth_string(const char_type *s);
+size_t wcswidth_chars(WCSState *state, const char_type *chars, size_t num);
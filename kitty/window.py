@@ -84,6 +84,7 @@
     set_window_logo,
     set_window_padding,
     set_window_render_data,
+    set_windows_render_data,
     update_ime_position_for_window,
     update_pointer_shape,
     update_window_title,
@@ -94,7 +95,6 @@
 from .options.types import Options
 from .progress import Progress
 from .rgb import to_color
-from .terminfo import get_capabilities
 from .types import MouseEvent, OverlayType, WindowGeometry, ac, run_once
 from .typing_compat import BossType, ChildType, EdgeLiteral, TabType, TypedDict
 from .utils import (
@@ -109,7 +109,6 @@
     resolve_custom_file,
     resolved_shell,
     sanitize_control_codes,
-    sanitize_for_bracketed_paste,
     sanitize_title,
     sanitize_url_for_display_to_user,
     shlex_split,
@@ -124,6 +123,7 @@
     from .fast_data_types import MousePosition
     from .file_transmission import FileTransmission
     from .notifications import OnlyWhen
+    from .options.utils import KeyboardMode
 
 
 class CwdRequestType(Enum):
@@ -249,6 +249,10 @@ class WindowDict(TypedDict):
     at_prompt: bool
     created_at: int
     in_alternate_screen: bool
+    input_buffer_size: int
+    input_buffer_high_water_mark: int
+    input_regime: str
+    idle_memory_released: int
 
 
 class PipeData(TypedDict):
@@ -267,6 +271,21 @@ class ClipboardPending(NamedTuple):
     truncated: bool = False
 
 
+class CapturedCommandOutput(NamedTuple):
+    cmdline: str
+    exit_status: int
+    # nanoseconds since the epoch
+    finished_at: int
+    # zlib compressed UTF-8 text
+    data: bytes
+    size: int
+    truncated: bool
+
+    def as_text(self) -> str:
+        import zlib
+        return zlib.decompress(self.data).decode('utf-8', 'replace')
+
+
 class DynamicColor(IntEnum):
     default_fg, default_bg, cursor_color, highlight_fg, highlight_bg = range(1, 6)
 
@@ -440,6 +459,21 @@ def as_text(
 
 
 
+def scrollback_export_fd() -> int:
+    # An anonymous file for the scrollback pager to read from, -1 if one
+    # cannot be created
+    try:
+        if hasattr(os, 'memfd_create'):
+            return os.memfd_create('kitty-scrollback', os.MFD_CLOEXEC)
+        import tempfile
+        fd, path = tempfile.mkstemp(prefix='kitty-scrollback-')
+        os.unlink(path)
+        return fd
+    except OSError as err:
+        log_error(f'Failed to create a file for the scrollback with error: {err}')
+    return -1
+
+
 @run_once
 def load_paste_filter() -> Callable[[str], str]:
     import runpy
@@ -646,6 +680,43 @@ def set_extra(self, extra: str) -> None:
 global_watchers = GlobalWatchers()
 
 
+class RenderDataBatch:
+    '''
+    Collects the render data of windows whose geometry changes during a
+    relayout and sends it to the C state in a single call at the end.
+    '''
+
+    def __init__(self) -> None:
+        self.key: tuple[int, int] | None = None
+        self.entries: list[tuple[int, Screen, int, int, int, int, int, int, int, int]] = []
+
+    @contextmanager
+    def __call__(self, os_window_id: int, tab_id: int) -> Iterator[None]:
+        if self.key is not None:  # nested relayout
+            yield
+            return
+        self.key = os_window_id, tab_id
+        try:
+            yield
+        finally:
+            self.key = None
+            if self.entries:
+                entries, self.entries = self.entries, []
+                set_windows_render_data(os_window_id, tab_id, entries)
+
+    def add(self, w: 'Window', g: WindowGeometry, padding: tuple[int, int, int, int]) -> bool:
+        if self.key != (w.os_window_id, w.tab_id):
+            return False
+        self.entries.append((w.id, w.screen, g.left, g.top, g.right, g.bottom, *padding))
+        return True
+
+
+batched_render_data = RenderDataBatch()
+
+
+browse_scrollback_mode_name = '__browse_scrollback__'
+
+
 class Window:
 
     window_custom_type: str = ''
@@ -706,6 +777,10 @@ def __init__(
         self.actions_on_focus_change: list[Callable[['Window', bool], None]] = []
         self.actions_on_removal: list[Callable[['Window'], None]] = []
         self.current_marker_spec: tuple[str, str | tuple[tuple[int, str], ...]] | None = None
+        self.scrollback_search_pattern = ''
+        self.scrollback_search_matches: list[tuple[int, int, int, int]] = []
+        self.scrollback_search_idx = -1
+        self.browse_scrollback_mode: Optional['KeyboardMode'] = None
         self.kitten_result_processors: list[Callable[['Window', Any], None]] = []
         self.child_is_launched = False
         self.last_reported_pty_size = (-1, -1, -1, -1)
@@ -715,6 +790,7 @@ def __init__(
         self.default_title = os.path.basename(child.argv[0] or appname)
         self.child_title = self.default_title
         self.title_stack: Deque[str] = deque(maxlen=10)
+        self.captured_command_outputs: Deque[CapturedCommandOutput] = deque()
         self.user_vars: dict[str, str] = {}
         self.id: int = add_window(tab.os_window_id, tab.id, self.title)
         self.clipboard_request_manager = ClipboardRequestManager(self.id)
@@ -728,6 +804,7 @@ def __init__(
         self.tabref: Callable[[], TabType | None] = weakref.ref(tab)
         self.destroyed = False
         self.geometry: WindowGeometry = WindowGeometry(0, 0, 0, 0, 0, 0)
+        self.last_applied_geometry: tuple[int, int, WindowGeometry, tuple[int, int, int, int]] | None = None
         self.needs_layout = True
         self.is_visible_in_layout: bool = True
         self.child = child
@@ -738,6 +815,7 @@ def __init__(
             self.screen.copy_colors_from(copy_colors_from.screen)
         self.remote_control_passwords = remote_control_passwords
         self.allow_remote_control = allow_remote_control
+        self.report_event('window_created', {'tab_id': self.tab_id, 'os_window_id': self.os_window_id})
 
     def remote_control_allowed(self, pcmd: dict[str, Any], extra_data: dict[str, Any]) -> bool:
         if not self.allow_remote_control:
@@ -940,9 +1018,22 @@ def refresh(self, reload_all_gpu_data: bool = False) -> None:
         wakeup_io_loop()
         wakeup_main_loop()
 
+    def refresh_colors(self) -> None:
+        # Changing the color profile marks it dirty, which is enough for the
+        # window to be redrawn with the new color table, without re-uploading
+        # its cell data
+        wakeup_main_loop()
+
     def set_geometry(self, new_geometry: WindowGeometry) -> None:
         if self.destroyed:
             return
+        padding = self.effective_padding('left'), self.effective_padding('top'), self.effective_padding('right'), self.effective_padding('bottom')
+        applied = self.os_window_id, self.tab_id, new_geometry, padding
+        if applied == self.last_applied_geometry and not self.needs_layout and (
+                new_geometry.xnum, new_geometry.ynum) == (self.screen.columns, self.screen.lines):
+            # relayouts re-apply the geometry of every window, avoid redrawing
+            # windows that have not actually changed
+            return
         if self.needs_layout or new_geometry.xnum != self.screen.columns or new_geometry.ynum != self.screen.lines:
             self.screen.resize(max(0, new_geometry.ynum), max(0, new_geometry.xnum))
             self.needs_layout = False
@@ -970,8 +1061,10 @@ def set_geometry(self, new_geometry: WindowGeometry) -> None:
             mark_os_window_dirty(self.os_window_id)
 
         self.geometry = g = new_geometry
-        set_window_render_data(self.os_window_id, self.tab_id, self.id, self.screen, *g[:4])
-        self.update_effective_padding()
+        self.last_applied_geometry = applied
+        if update_ime_position or not batched_render_data.add(self, g, padding):
+            set_window_render_data(self.os_window_id, self.tab_id, self.id, self.screen, *g[:4])
+            set_window_padding(self.os_window_id, self.tab_id, self.id, *padding)
         if update_ime_position:
             update_ime_position_for_window(self.id, True)
 
@@ -1070,6 +1163,7 @@ def set_title(self, title: str | None) -> None:
             title = sanitize_title(title)
         self.override_title = title or None
         self.call_watchers(self.watchers.on_title_change, {'title': self.title, 'from_child': False})
+        self.report_event('title_changed', {'title': self.title})
         self.title_updated()
 
     @ac(
@@ -1115,6 +1209,7 @@ def set_user_var(self, key: str, val: str | bytes | None) -> None:
             self.call_watchers(self.watchers.on_set_user_var, {'key': key, 'value': val})
         else:
             self.call_watchers(self.watchers.on_set_user_var, {'key': key, 'value': None})
+        self.report_event('user_var_changed', {'key': key, 'value': val})
 
     # screen callbacks {{{
 
@@ -1249,6 +1344,7 @@ def focus_changed(self, focused: bool) -> None:
             return
         self.is_focused = focused
         call_watchers(weakref.ref(self), 'on_focus_change', {'focused': focused})
+        self.report_event('focus_changed', {'focused': focused})
         for c in self.actions_on_focus_change:
             try:
                 c(self, focused)
@@ -1279,6 +1375,7 @@ def title_changed(self, new_title: memoryview | None, is_base64: bool = False) -
         self.child_title = process_title_from_child(new_title or memoryview(b''), is_base64, self.default_title)
         self.call_watchers(self.watchers.on_title_change, {'title': self.child_title, 'from_child': True})
         if self.override_title is None:
+            self.report_event('title_changed', {'title': self.child_title})
             self.title_updated()
 
     def icon_changed(self, new_icon: memoryview) -> None:
@@ -1425,7 +1522,7 @@ def parse_color_set(raw: str) -> Generator[tuple[int, int | None], None, None]:
                     changed = True
                     cp.set_color(c, val)
             if changed:
-                self.refresh()
+                self.refresh_colors()
         elif code == 104:
             if not value.strip():
                 cp.reset_color_table()
@@ -1437,9 +1534,10 @@ def parse_color_set(raw: str) -> Generator[tuple[int, int | None], None, None]:
                         continue
                     if 0 <= y <= 255:
                         cp.reset_color(y)
-            self.refresh()
+            self.refresh_colors()
 
     def request_capabilities(self, q: str) -> None:
+        from .terminfo import get_capabilities
         for result in get_capabilities(q, get_options(), self.id, self.os_window_id):
             self.screen.send_escape_code_to_child(ESC_DCS, result)
 
@@ -1577,6 +1675,8 @@ def manipulate_title_stack(self, pop: bool, title: str, icon: Any) -> None:
                 if self.title_stack:
                     self.child_title = self.title_stack.pop()
                     self.call_watchers(self.watchers.on_title_change, {'title': self.child_title, 'from_child': True})
+                    if self.override_title is None:
+                        self.report_event('title_changed', {'title': self.child_title})
                     self.title_updated()
             else:
                 if self.child_title:
@@ -1592,9 +1692,12 @@ def handle_cmd_end(self, exit_status: str = '') -> None:
         end_time = monotonic()
         last_cmd_output_duration = end_time - self.last_cmd_output_start_time
         self.last_cmd_output_start_time = 0.
+        self.store_captured_command_output()
 
         self.call_watchers(self.watchers.on_cmd_startstop, {
             "is_start": False, "time": end_time, 'cmdline': self.last_cmd_cmdline, 'exit_status': self.last_cmd_exit_status})
+        self.report_event('command_finished', {
+            'cmdline': self.last_cmd_cmdline, 'exit_status': self.last_cmd_exit_status, 'cwd': self.cwd_of_child_for_events})
 
         opts = get_options()
         when, duration, action, notify_cmdline, _ = opts.notify_on_cmd_finish
@@ -1624,6 +1727,18 @@ def handle_cmd_end(self, exit_status: str = '') -> None:
             else:
                 raise ValueError(f'Unknown action in option `notify_on_cmd_finish`: {action}')
 
+    def store_captured_command_output(self) -> None:
+        c = self.screen.take_captured_command_output()
+        if c is None:
+            return
+        data, size, truncated = c
+        q = self.captured_command_outputs
+        q.append(CapturedCommandOutput(self.last_cmd_cmdline, self.last_cmd_exit_status, time_ns(), data, size, truncated))
+        limit = get_options().command_output_capture_size * 1024 * 1024
+        total = sum(len(x.data) for x in q)
+        while len(q) > 1 and total > limit:
+            total -= len(q.popleft().data)
+
     def cmd_output_marking(self, is_start: bool | None, cmdline: str = '') -> None:
         if is_start:
             start_time = monotonic()
@@ -1631,8 +1746,16 @@ def cmd_output_marking(self, is_start: bool | None, cmdline: str = '') -> None:
             cmdline = decode_cmdline(cmdline) if cmdline else ''
             self.last_cmd_cmdline = cmdline
             self.call_watchers(self.watchers.on_cmd_startstop, {"is_start": True, "time": start_time, 'cmdline': cmdline, 'exit_status': 0})
+            self.report_event('command_started', {'cmdline': cmdline, 'cwd': self.cwd_of_child_for_events})
         else:
+            if is_start is False:
+                self.update_predictive_echo()
             self.handle_cmd_end(cmdline)
+
+    def update_predictive_echo(self) -> None:
+        # called when a prompt is drawn, the shell may be remote only from now on
+        pe = get_options().predictive_echo
+        self.screen.predictive_echo = pe == 'always' or (pe == 'remote' and self.child_is_remote)
     # }}}
 
     # mouse actions {{{
@@ -1713,12 +1836,20 @@ def mouse_show_command_output(self) -> None:
             self.show_cmd_output(CommandOutput.last_visited, 'Clicked command output')
     # }}}
 
-    def text_for_selection(self, as_ansi: bool = False) -> str:
+    @property
+    def strip_trailing_spaces_from_selection(self) -> bool:
         sts = get_options().strip_trailing_spaces
-        strip_trailing_spaces = sts == 'always' or (sts == 'smart' and not self.screen.is_rectangle_select())
-        lines = self.screen.text_for_selection(as_ansi, strip_trailing_spaces)
+        return sts == 'always' or (sts == 'smart' and not self.screen.is_rectangle_select())
+
+    def text_for_selection(self, as_ansi: bool = False) -> str:
+        lines = self.screen.text_for_selection(as_ansi, self.strip_trailing_spaces_from_selection)
         return ''.join(lines)
 
+    def utf8_for_selection(self) -> bytes:
+        # Builds the encoded text in a single buffer in C, much cheaper than
+        # text_for_selection() for huge selections destined for the clipboard
+        return self.screen.utf8_for_selection(self.strip_trailing_spaces_from_selection)
+
     def has_selection(self) -> bool:
         return self.screen.has_selection()
 
@@ -1731,8 +1862,17 @@ def call_watchers(self, which: Iterable[Watcher], data: dict[str, Any]) -> None:
                 import traceback
                 traceback.print_exc()
 
+    def report_event(self, event: str, data: dict[str, Any]) -> None:
+        get_boss().report_event_to_subscribers(event, self.id, data)
+
+    @property
+    def cwd_of_child_for_events(self) -> str:
+        # as reported by the shell, looking up the cwd of the child process is too slow to do for every command
+        return path_from_osc7_url(self.screen.last_reported_cwd) if self.screen.last_reported_cwd else ''
+
     def destroy(self) -> None:
         self.call_watchers(self.watchers.on_close, {})
+        self.report_event('window_closed', {})
         self.destroyed = True
         self.clipboard_request_manager.close()
         del self.kitten_result_processors
@@ -1893,12 +2033,8 @@ def paste_text(self, text: str | bytes) -> None:
         if text and not self.destroyed:
             if isinstance(text, str):
                 text = text.encode('utf-8')
-            if self.screen.in_bracketed_paste_mode:
-                text = sanitize_for_bracketed_paste(text)
-            else:
-                # Workaround for broken editors like nano that cannot handle
-                # newlines in pasted text see https://github.com/kovidgoyal/kitty/issues/994
-                text = text.replace(b'\r\n', b'\n').replace(b'\n', b'\r')
+            # sanitizes the text for bracketed paste or converts newlines to
+            # carriage returns, in a single pass without copying it in Python
             self.screen.paste(text)
 
     def clear_screen(self, reset: bool = False, scrollback: bool = False) -> None:
@@ -1933,6 +2069,10 @@ def as_dict(self, is_focused: bool = False, is_self: bool = False, is_active: bo
             'user_vars': self.user_vars,
             'created_at': self.created_at,
             'in_alternate_screen': self.screen.is_using_alternate_linebuf(),
+            'input_buffer_size': self.screen.vt_parser.buffer_size,
+            'input_buffer_high_water_mark': self.screen.vt_parser.buffer_high_water_mark,
+            'input_regime': self.screen.vt_parser.input_regime,
+            'idle_memory_released': self.screen.idle_memory_released,
         }
 
     def serialize_state(self) -> dict[str, Any]:
@@ -1969,7 +2109,7 @@ def cwd_for_serialization(self) -> str:
             cwd = path_from_osc7_url(self.screen.last_reported_cwd) or cwd
         return cwd
 
-    def as_launch_command(self, ser_opts: SaveAsSessionOptions, cwd: str, is_overlay: bool = False) -> list[str]:
+    def as_launch_command(self, ser_opts: SaveAsSessionOptions, cwd: str, is_overlay: bool = False, scrollback_dir: str = '') -> list[str]:
         ' Return a launch command that can be used to serialize this window. Empty list indicates not serializable. '
         if self.actions_on_close or self.actions_on_focus_change or self.actions_on_removal:
             # such windows are typically UI kittens. The actions are not
@@ -2057,18 +2197,51 @@ def make_exe_absolute(cmd: list[str], pid: int) -> None:
                         if fcmd:
                             make_exe_absolute(fcmd, pid)
                             unserialize_data['cmd_at_shell_startup'] = fcmd
+        if scrollback_dir and (path := self.save_scrollback(scrollback_dir)):
+            unserialize_data['scrollback'] = path
         ans.insert(1, unserialize_launch_flag + json.dumps(unserialize_data))
         ans.extend(cmd)
         return ans
+
+    def save_scrollback(self, dest_dir: str) -> str:
+        path = os.path.join(dest_dir, f'{self.id}.ansi')
+        try:
+            os.makedirs(dest_dir, exist_ok=True)
+            with open(path, 'wb') as f:
+                self.screen.export_scrollback(f.fileno())
+        except OSError as err:
+            log_error(f'Failed to save the scrollback of window {self.id} to {path} with error: {err}')
+            return ''
+        return path
+
+    def restore_scrollback(self, path: str) -> None:
+        try:
+            with open(path, 'rb') as f:
+                self.screen.import_scrollback(f.fileno())
+        except OSError as err:
+            log_error(f'Failed to restore the scrollback from {path} with error: {err}')
     # }}}
 
     # actions {{{
 
     @ac('cp', 'Show scrollback in a pager like less')
     def show_scrollback(self) -> None:
+        cursor_on_screen = self.screen.scrolled_by < self.screen.lines - self.screen.cursor.y
+        fd = scrollback_export_fd()
+        if fd > -1:
+            # write the scrollback directly to a file that becomes the stdin of the pager
+            try:
+                lines = self.screen.export_scrollback(fd)
+                os.lseek(fd, 0, os.SEEK_SET)
+            except OSError as err:
+                log_error(f'Failed to export the scrollback to a file with error: {err}')
+                os.close(fd)
+            else:
+                input_line_number = lines - (self.screen.lines - 1) - self.screen.scrolled_by
+                get_boss().display_scrollback(self, fd, input_line_number, report_cursor=cursor_on_screen)
+                return
         text = self.as_text(as_ansi=True, add_history=True, add_wrap_markers=True)
         data = self.pipe_data(text, has_wrap_markers=True)
-        cursor_on_screen = self.screen.scrolled_by < self.screen.lines - self.screen.cursor.y
         get_boss().display_scrollback(self, data['text'], data['input_line_number'], report_cursor=cursor_on_screen)
 
     def show_cmd_output(self, which: CommandOutput, title: str = 'Command output', as_ansi: bool = True, add_wrap_markers: bool = True) -> None:
@@ -2115,7 +2288,7 @@ def paste(self, text: str) -> None:
 
     @ac('cp', 'Copy the selected text from the active window to the clipboard')
     def copy_to_clipboard(self) -> None:
-        text = self.text_for_selection()
+        text = self.utf8_for_selection()
         if text:
             set_clipboard_string(text)
 
@@ -2135,7 +2308,7 @@ def encoded_key(self, key_event: KeyEvent) -> bytes:
 
     @ac('cp', 'Copy the selected text from the active window to the clipboard, if no selection, send SIGINT (aka :kbd:`ctrl+c`)')
     def copy_or_interrupt(self) -> None:
-        text = self.text_for_selection()
+        text = self.utf8_for_selection()
         if text:
             set_clipboard_string(text)
         else:
@@ -2145,7 +2318,7 @@ def copy_or_interrupt(self) -> None:
     @ac('cp', 'Copy the selected text from the active window to the clipboard, if no selection,'
         ' pass the key through to the application running in the terminal.')
     def copy_or_noop(self) -> bool:
-        text = self.text_for_selection()
+        text = self.utf8_for_selection()
         if text:
             set_clipboard_string(text)
             return False
@@ -2254,6 +2427,93 @@ def scroll_prompt_to_bottom(self) -> bool | None:
             return None
         return True
 
+    @ac('sc', '''
+        Browse the scrollback in place, using pager like keys
+
+        Unlike :ac:`show_scrollback` the scrollback is not exported to an external pager,
+        so this is instant even for very large scrollbacks. Use :kbd:`j`, :kbd:`k`,
+        the arrow keys, :kbd:`Space`, :kbd:`b`, the page keys, :kbd:`g` and :kbd:`G` to scroll,
+        :kbd:`/` to search, :kbd:`n` and :kbd:`N` to go to the previous and next match and
+        :kbd:`q` or :kbd:`Esc` to quit.
+        ''')
+    def browse_scrollback(self) -> None:
+        if not self.screen.is_main_linebuf():
+            return
+        from .fast_data_types import (
+            GLFW_FKEY_DOWN, GLFW_FKEY_END, GLFW_FKEY_ESCAPE, GLFW_FKEY_HOME, GLFW_FKEY_PAGE_DOWN, GLFW_FKEY_PAGE_UP, GLFW_FKEY_UP, GLFW_MOD_SHIFT,
+        )
+        from .options.utils import KeyboardMode, KeyDefinition
+        from .types import SingleKey
+        km = KeyboardMode(browse_scrollback_mode_name)
+        km.on_unknown = 'ignore'
+        km.on_action = 'keep'
+        for action, keys in {
+            'scroll_line_down': (ord('j'), GLFW_FKEY_DOWN, ord('e')),
+            'scroll_line_up': (ord('k'), GLFW_FKEY_UP, ord('y')),
+            'scroll_page_down': (ord(' '), GLFW_FKEY_PAGE_DOWN, ord('f')),
+            'scroll_page_up': (ord('b'), GLFW_FKEY_PAGE_UP),
+            'scroll_home': (ord('g'), GLFW_FKEY_HOME),
+            'scroll_end': (GLFW_FKEY_END,),
+            'browse_scrollback_search': (ord('/'),),
+            'browse_scrollback_previous_match': (ord('n'),),
+            'browse_scrollback_end': (ord('q'), GLFW_FKEY_ESCAPE),
+        }.items():
+            for key in keys:
+                km.keymap[SingleKey(key=key)].append(KeyDefinition(definition=action))
+        km.keymap[SingleKey(mods=GLFW_MOD_SHIFT, key=ord('g'))].append(KeyDefinition(definition='scroll_end'))
+        km.keymap[SingleKey(mods=GLFW_MOD_SHIFT, key=ord('n'))].append(KeyDefinition(definition='browse_scrollback_next_match'))
+        boss = get_boss()
+        boss.mappings.pop_keyboard_mode_if_is(browse_scrollback_mode_name)
+        boss.mappings._push_keyboard_mode(km)
+        self.browse_scrollback_mode = km
+
+    def browse_scrollback_end(self) -> None:
+        get_boss().mappings.pop_keyboard_mode_if_is(browse_scrollback_mode_name)
+        self.screen.clear_selection()
+        self.scrollback_search_matches, self.scrollback_search_idx = [], -1
+        self.scroll_end()
+
+    def browse_scrollback_search(self) -> None:
+        boss = get_boss()
+        # the prompt needs the keyboard so leave the mode until it is done
+        boss.mappings.pop_keyboard_mode_if_is(browse_scrollback_mode_name)
+
+        def on_pattern(pattern: str) -> None:
+            if self.destroyed:
+                return
+            if self.browse_scrollback_mode is not None:
+                boss.mappings._push_keyboard_mode(self.browse_scrollback_mode)
+            if pattern:
+                self.scrollback_search_pattern = pattern
+                self.scrollback_search_matches = self.screen.search(pattern)
+                # start at the last match above the bottom of the view, searching backwards like ? in less
+                bottom = self.screen.lines - 1 - self.screen.scrolled_by
+                self.scrollback_search_idx = sum(1 for m in self.scrollback_search_matches if m[0] <= bottom)
+                self.browse_scrollback_previous_match()
+        boss.get_line(
+            _('Search the scrollback for:'), on_pattern, window=self, prompt='/', initial_value=self.scrollback_search_pattern)
+
+    def browse_scrollback_previous_match(self) -> None:
+        self.show_scrollback_match(self.scrollback_search_idx - 1)
+
+    def browse_scrollback_next_match(self) -> None:
+        self.show_scrollback_match(self.scrollback_search_idx + 1)
+
+    def show_scrollback_match(self, idx: int) -> None:
+        matches = self.scrollback_search_matches
+        if not matches or idx < 0 or idx >= len(matches):
+            get_boss().ring_bell_if_allowed(self.os_window_id)
+            return
+        self.scrollback_search_idx = idx
+        first_y, first_x, last_y, last_x = matches[idx]
+        s = self.screen
+        # show the match in the middle of the screen
+        scrolled_by = max(0, min(s.historybuf.count, s.lines // 2 - first_y))
+        if scrolled_by != s.scrolled_by:
+            s.scroll(abs(scrolled_by - s.scrolled_by), scrolled_by > s.scrolled_by)
+        s.start_selection(first_x, first_y + s.scrolled_by)
+        s.update_selection(last_x, min(s.lines - 1, last_y + s.scrolled_by), False, True)
+
     @ac('mk', 'Toggle the current marker on/off')
     def toggle_marker(self, ftype: str, spec: str | tuple[tuple[int, str], ...], flags: int) -> None:
         from .marks import marker_from_spec
@@ -120,6 +120,24 @@ def test_launcher_ensures_stdio(self):
 '''])
         self.assertEqual(cp.returncode, 0)
 
+    def test_startup_imports(self):
+        # Modules that are only needed after startup must not be imported by
+        # kitty.main, keep this list in sync when deferring more imports
+        import subprocess
+
+        from kitty.constants import kitty_exe
+        deferred = (
+            'kitty.notifications', 'kitty.file_transmission', 'kitty.remote_control', 'kitty.rc.base',
+            'kitty.terminfo', 'kitty.key_encoding', 'kittens.runner', 'kittens.tui.handler',
+        )
+        cp = subprocess.run([kitty_exe(), '+runpy', f'''\
+import sys
+import kitty.main
+print(' '.join(m for m in {deferred!r} if m in sys.modules))
+'''], stdout=subprocess.PIPE)
+        self.assertEqual(cp.returncode, 0)
+        self.assertEqual(cp.stdout.decode().strip(), '', 'Modules imported at startup that should be deferred')
+
 
 def main() -> None:
     tests = unittest.defaultTestLoader.loadTestsFromTestCase(TestBuild)
@@ -61,3 +61,39 @@ def corrupt_data(data):
         d = AES256GCMDecrypt(bob_secret, e.iv, e.tag)
         d.add_data_to_be_authenticated_but_not_decrypted(auth_data)
         self.assertRaises(CryptoError, d.add_data_to_be_decrypted, corrupt_data(ciphertext), True)
+
+    def test_rc_session_encryption(self):
+        if is_rlimit_memlock_too_low():
+            self.skipTest('RLIMIT_MEMLOCK is too low')
+        import base64
+        import json
+        from time import time_ns
+
+        from kitty.fast_data_types import AES256GCMEncrypt, EllipticCurveKey
+        import kitty.remote_control as rc
+        from kitty.remote_control import parse_cmd, session_secrets
+        server, client = EllipticCurveKey(), EllipticCurveKey()
+        secret = client.derive_secret(server.public)
+
+        def encrypt(timestamp, cmd='ls'):
+            e = AES256GCMEncrypt(secret)
+            ciphertext = e.add_data_to_be_encrypted(json.dumps({'version': [0, 1], 'cmd': cmd, 'timestamp': timestamp}).encode(), True)
+            return memoryview(json.dumps({
+                'version': [0, 1], 'iv': base64.b85encode(e.iv).decode(), 'tag': base64.b85encode(e.tag).decode(),
+                'pubkey': base64.b85encode(client.public).decode(), 'encrypted': base64.b85encode(ciphertext).decode(),
+            }).encode())
+
+        orig_log_error, rc.log_error = rc.log_error, lambda *a: None
+        try:
+            ts = time_ns()
+            first = encrypt(ts)
+            self.ae(parse_cmd(first, server)['cmd'], 'ls')
+            self.assertIn(server.public + client.public, session_secrets.entries)
+            self.ae(parse_cmd(encrypt(ts + 1, 'send-text'), server)['cmd'], 'send-text')
+            # replays within a session are rejected
+            self.ae(parse_cmd(first, server), {})
+            # as are commands too far from the current time
+            self.ae(parse_cmd(encrypt(ts - 10 * 60 * 10**9), server), {})
+        finally:
+            rc.log_error = orig_log_error
+            session_secrets.entries.clear()
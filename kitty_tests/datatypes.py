@@ -400,6 +400,10 @@ def w(x):
         self.ae(wcswidth('\U0001F1E6\U0001F1E8a'), 3)
         self.ae(wcswidth('\U0001F1E6\U0001F1E8\U0001F1E6'), 4)
         self.ae(wcswidth('a\u00adb'), 2)
+        self.ae(wcswidth('abc'), 3)
+        self.ae(wcswidth('ab\u0301c'), 3)
+        self.ae(wcswidth('ab\u2716\ufe0fcd'), 6)
+        self.ae(wcswidth('ab\U0001f337c\u0301d\x1b[31mef'), 8)
         # Regional indicator symbols (unicode flags) are defined as having
         # Emoji_Presentation so must have width 2 but combined must have
         # width 2 not 4
@@ -559,6 +563,73 @@ def test_historybuf(self):
         for i in range(3000):
             self.ae(str(hb.line(i)).rstrip(), str(3000 - 1 - i))
 
+        # segments that are not in use are stored compressed
+        hb = HistoryBuf(12 * 2048, 20)
+        wide_lb = filled_line_buf(5, 20)
+        for i in range(hb.ynum + 100):
+            line = wide_lb.line(1)
+            line.set_text(str(i).ljust(20), 0, 20, c)
+            hb.push(line)
+        self.assertGreater(hb.compressed_segments, 0)
+        for i in range(0, hb.ynum, 7):
+            self.ae(str(hb.line(i)).rstrip(), str(hb.ynum + 100 - 1 - i))
+            self.ae(hb.line(i).cursor_from(0).fg, c.fg)
+        hb2 = hb.rewrap(hb.xnum)
+        for i in range(0, hb.ynum, 7):
+            self.ae(str(hb2.line(i)), str(hb.line(i)))
+
+        # compressed segments can be stored on disk
+        hb = HistoryBuf(12 * 2048, 20, 0, 64 * 1024 * 1024)
+        for i in range(hb.ynum + 100):
+            line = wide_lb.line(1)
+            line.set_text(str(i).ljust(20), 0, 20, c)
+            hb.push(line)
+        self.assertGreater(hb.spilled_segments, 0)
+        hb2 = hb.rewrap(hb.xnum)
+        for i in range(0, hb.ynum, 7):
+            self.ae(str(hb.line(i)).rstrip(), str(hb.ynum + 100 - 1 - i))
+            self.ae(str(hb2.line(i)), str(hb.line(i)))
+
+        # large amounts of history are rewrapped in parallel, with the same
+        # result as rewrapping serially
+        def assert_same_history(a, b):
+            self.ae(a.count, b.count)
+            for i in range(a.count):
+                self.ae(a.line(i), b.line(i))
+                self.ae(a.is_continued(i), b.is_continued(i))
+        for num_lines in (9000 + 37, 12 * 1024 + 555):
+            hb = HistoryBuf(num_lines, 20)
+            for i in range(num_lines):
+                line = wide_lb.line(1)
+                t = str(i) * (1 + i % 7)
+                line.set_text(t[:20], 0, min(20, len(t)), c)
+                # some logical lines cross the boundaries of the chunks the history is split into
+                line.set_wrapped_flag(i % 3 == 0 or i % 1024 > 1000 or i % 1024 < 30)
+                hb.push(line)
+            for width in (7, 13, 33):
+                hb2 = hb.rewrap(width)
+                assert_same_history(hb2, hb.rewrap(width, True))
+                assert_same_history(hb2.rewrap(hb.xnum), hb2.rewrap(hb.xnum, True))
+        # varied text is stored as literal runs in compressed and spilled
+        # segments, which are read differently when rewrapping in parallel
+        import random
+        rnd = random.Random(1234)
+        alphabet = 'abcdefghijklmnopqrstuvwxyz0123456789 .-_/'
+        blank_lb = LineBuf(1, 30)
+        for spill_limit in (0, 64 * 1024 * 1024):
+            hb = HistoryBuf(5 * 2048 + 301, 30, 0, spill_limit)
+            for i in range(hb.ynum):
+                blank_lb.clear_line(0)
+                line = blank_lb.line(0)
+                t = ''.join(rnd.choice(alphabet) for _ in range(rnd.randint(0, 30)))
+                if t:
+                    line.set_text(t, 0, len(t), c if i % 2 else C())
+                line.set_wrapped_flag(rnd.random() < 0.4)
+                hb.push(line)
+            self.assertGreater(hb.spilled_segments if spill_limit else hb.compressed_segments, 0)
+            for width in (11, 29, 47):
+                assert_same_history(hb.rewrap(width), hb.rewrap(width, True))
+
         # rewrap
         def as_ansi(hb):
             lines = []
@@ -302,6 +302,63 @@ def test_file_get(self):
             received = b''.join(x['data'] for x in ft.test_responses)
             self.ae(received.decode('utf-8'), src)
 
+    def test_file_put_local(self):
+        base = os.path.join(self.tdir, 'local')
+        os.mkdir(base)
+        src = os.path.join(base, 'src.bin')
+        data = os.urandom(1024 * 1024 + 13)
+        with open(src, 'wb') as f:
+            f.write(data)
+        os.utime(src, (1234.5, 1234.5))
+        dest = os.path.join(base, 'a', 'dest.bin')
+
+        def start(ttype='local'):
+            ft = FileTransmission()
+            ft.handle_serialized_command(serialized_cmd(action='send', ttype=ttype))
+            return ft, ft.test_responses[-1]
+
+        # without the token the data is transmitted normally
+        ft, r = start('simple')
+        self.assertNotIn('ttype', r)
+        self.assertNotIn('name', r)
+        ft, r = start()
+        self.ae(r['ttype'], 'local')
+        token_path = r['name']
+        self.ae(stat.S_IMODE(os.stat(token_path).st_mode), 0o600)
+        ft.handle_serialized_command(serialized_cmd(action='file', file_id='f', name=dest, ttype='local', bypass='wrong', data=src))
+        self.ae(ft.test_responses[-1]['status'], 'STARTED')
+        self.assertNotIn('ttype', ft.test_responses[-1])
+        self.assertFalse(os.path.exists(dest))
+
+        # with the token the file is copied directly
+        with open(token_path) as f:
+            token = f.read()
+        ft.handle_serialized_command(serialized_cmd(
+            action='file', file_id='l', name=dest, ttype='local', bypass=token, data=src, mtime=1234567, permissions=0o751))
+        self.ae(ft.test_responses[-1]['status'], 'OK')
+        self.ae(ft.test_responses[-1]['size'], len(data))
+        self.assertIn('STARTED', {r.get('status') for r in ft.test_responses if r.get('ttype') == 'local'})
+        with open(dest, 'rb') as f:
+            self.ae(data, f.read())
+        st = os.stat(dest)
+        self.ae(st.st_mtime_ns, 1234567)
+        self.ae(stat.S_IMODE(st.st_mode), 0o751)
+        # copying a file onto itself leaves it alone
+        ft.handle_serialized_command(serialized_cmd(action='file', file_id='s', name=src, ttype='local', bypass=token, data=src))
+        self.ae(ft.test_responses[-1]['status'], 'OK')
+        with open(src, 'rb') as f:
+            self.ae(data, f.read())
+        # a missing source falls back to transmitting the data
+        ft.handle_serialized_command(serialized_cmd(
+            action='file', file_id='m', name=dest + '2', ttype='local', bypass=token, data=src + 'missing'))
+        self.ae(ft.test_responses[-1]['status'], 'STARTED')
+        self.assertNotIn('ttype', ft.test_responses[-1])
+        ft.handle_serialized_command(serialized_cmd(action='end_data', file_id='m', data='abcd'))
+        with open(dest + '2') as f:
+            self.ae('abcd', f.read())
+        ft.handle_serialized_command(serialized_cmd(action='finish'))
+        self.assertFalse(os.path.exists(token_path))
+
     def test_parse_ftc(self):
         def t(raw, *expected):
             a = []
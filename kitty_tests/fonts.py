@@ -16,6 +16,7 @@
     ParsedFontFeature,
     get_fallback_font,
     set_allow_use_of_box_fonts,
+    set_box_drawing_cache,
     sprite_idx_to_pos,
     sprite_map_set_layout,
     sprite_map_set_limits,
@@ -304,6 +305,27 @@ def test_box_drawing(self):
         test_render_line(line)
         self.assertEqual(len(self.sprites) - prerendered, len(box_chars))
 
+    def test_box_drawing_cache(self):
+        cdir = os.path.join(self.tdir, 'box-drawing')
+        os.mkdir(cdir)
+        self.addCleanup(set_box_drawing_cache, None, False)
+        header_sz, record_sz = 64, 4 + self.cell_width * self.cell_height
+
+        def num_of_records():
+            files = os.listdir(cdir)
+            self.ae(len(files), 1)
+            return (os.path.getsize(os.path.join(cdir, files[0])) - header_sz) / record_sz
+
+        set_box_drawing_cache(cdir, False)
+        s = self.create_screen(cols=4, lines=1, scrollback=0)
+        s.draw('\u2500\u256d\u2500')
+        test_render_line(s.line(0))
+        self.ae(num_of_records(), 2)
+        set_box_drawing_cache(cdir, True)
+        s.draw('\u2502')
+        test_render_line(s.line(0))
+        self.assertGreater(num_of_records(), 500)
+
     def test_scaled_box_drawing(self):
         self.scaled_drawing_test()
 
@@ -388,6 +410,21 @@ def groups(text, font=None):
         self.ae(groups('i\u0332\u0308', font='LiberationMono-Regular.ttf'), [(1, 2)])
         self.ae(groups('u\u0332 u\u0332\u0301', font='LiberationMono-Regular.ttf'), [(1, 2), (1, 1), (1, 2)])
 
+    def test_shaping_cache(self):
+        s = self.create_screen(cols=12, lines=3, scrollback=0)
+
+        def sprites(y, text):
+            s.cursor.x, s.cursor.y = 0, y
+            s.draw(text)
+            line = s.line(y)
+            test_render_line(line)
+            return tuple(line.sprite_at(x) for x in range(s.columns))
+
+        first = sprites(0, 'a===b!=c')
+        self.ae(sprites(1, 'a===b!=c'), first)
+        self.assertNotEqual(sprites(2, 'a=b!=c'), first)
+        self.ae(sprites(0, 'a===b!=c'), first)
+
     def test_emoji_presentation(self):
         s = self.create_screen()
         s.draw('\u2716\u2716\ufe0f')
@@ -414,6 +451,21 @@ def test_emoji_presentation(self):
         self.ae((s.cursor.x, s.cursor.y), (2, 4))
         self.ae(str(s.line(s.cursor.y)), '\u2716\ufe0f')
 
+    @unittest.skipIf(is_macos, 'Only fontconfig caches fallback descriptors')
+    def test_fallback_descriptor_cache(self):
+        from kitty.fast_data_types import get_fallback_descriptor_cache, set_fallback_descriptor_cache
+        set_fallback_descriptor_cache({})
+        try:
+            get_fallback_font('\u0625', False, False)
+        except ValueError:
+            self.skipTest('No fallback font for Arabic installed')
+        cache = get_fallback_descriptor_cache()
+        self.ae(tuple(cache), ('r\u0625',))
+        get_fallback_font('\u0625', True, False)
+        self.ae(set(get_fallback_descriptor_cache()), {'r\u0625', 'B\u0625'})
+        set_fallback_descriptor_cache(cache)
+        self.ae(get_fallback_descriptor_cache(), cache)
+
     @unittest.skipUnless(is_macos, 'Only macOS has a Last Resort font')
     def test_fallback_font_not_last_resort(self):
         # Ensure that the LastResort font is not reported as a fallback font on
@@ -11,7 +11,7 @@
 from dataclasses import dataclass
 from io import BytesIO
 
-from kitty.fast_data_types import base64_decode, base64_encode, has_avx2, has_sse4_2, load_png_data, shm_unlink, shm_write, test_xor64
+from kitty.fast_data_types import base64_decode, base64_encode, has_avx2, has_avx512, has_sse4_2, load_png_data, shm_unlink, shm_write, test_alpha_blend, test_xor64
 
 from . import BaseTest, parse_bytes
 
@@ -191,6 +191,8 @@ def test_xor_data(self):
             sizes.append(2)
         if has_avx2:
             sizes.append(3)
+        if has_avx512:
+            sizes.append(4)
         sizes.append(0)
 
         def t(key, data, align_offset=0):
@@ -207,6 +209,33 @@ def t(key, data, align_offset=0):
                     data = base + base_data[:extra]
                     t(key, data, align_offset)
 
+    def test_alpha_blend(self):
+        sizes = []
+        if has_sse4_2:
+            sizes.append(2)
+        if has_avx2:
+            sizes.append(3)
+        sizes.append(0)
+        rnd = random.Random(1)
+
+        def t(num_pixels, dest_is_rgb):
+            src = bytearray(rnd.randbytes(4 * num_pixels))
+            dest = bytearray(rnd.randbytes((3 if dest_is_rgb else 4) * num_pixels))
+            # exercise the fully transparent and fully opaque special cases
+            for i in range(3, len(src), 4):
+                src[i] = rnd.choice((0, 255, src[i], src[i]))
+            if not dest_is_rgb:
+                for i in range(3, len(dest), 4):
+                    dest[i] = rnd.choice((0, dest[i]))
+            expected = test_alpha_blend(bytes(dest), bytes(src), 1, dest_is_rgb)
+            for which_function in sizes:
+                actual = test_alpha_blend(bytes(dest), bytes(src), which_function, dest_is_rgb)
+                self.ae(expected, actual, f'{which_function=} {num_pixels=} {dest_is_rgb=}')
+
+        for num_pixels in range(40):
+            t(num_pixels, False)
+            t(num_pixels, True)
+
     def test_disk_cache(self):
         s = self.create_screen()
         dc = s.grman.disk_cache
@@ -294,6 +323,11 @@ def reset(small_hole_threshold=0, defrag_factor=2):
         check_data()
         add('trigger defrag', 'XXX')
         dc.wait_for_write()
+        # defragmentation happens incrementally in the background
+        st = time.monotonic()
+        while dc.size_on_disk() >= before and time.monotonic() - st < 2:
+            time.sleep(0.001)
+            check_data()
         self.assertLess(dc.size_on_disk(), before)
         check_data()
         dc.clear()
@@ -321,6 +355,33 @@ def clear_predicate(key):
 
         dc.remove_from_ram(clear_predicate)
         self.assertEqual(dc.num_cached_in_ram(), 0)
+        self.assertEqual(dc.ram_size, 0)
+
+        # the RAM tier is bounded, least recently used entries are dropped first
+        dc.ram_limit = 4 * 16
+        for frame in range(32):
+            dc.get(key_as_bytes(f'1:{frame}'), True)
+        self.assertEqual(dc.num_cached_in_ram(), 4)
+        self.assertEqual(dc.ram_size, 4 * 16)
+        dc.get(key_as_bytes('1:28'))
+        dc.get(key_as_bytes('1:0'), True)
+        dc.remove_from_ram(lambda key: key in (b'1:28', b'1:0'))
+        self.assertEqual(dc.num_cached_in_ram(), 2)
+        self.assertEqual(dc.ram_size, 2 * 16)
+
+        # prefetching reads entries into RAM in the background
+        dc.remove_from_ram(clear_predicate)
+        dc.ram_limit = 64 * 1024 * 1024
+        for frame in range(8):
+            dc.prefetch(key_as_bytes(f'1:{frame}'))
+        st = time.monotonic()
+        while dc.num_cached_in_ram() < 8 and time.monotonic() - st < 2:
+            time.sleep(0.001)
+        self.assertEqual(dc.num_cached_in_ram(), 8)
+        for frame in range(8):
+            self.ae(dc.get(key_as_bytes(f'1:{frame}')), f'{frame:02d}'.encode() * 8)
+        remove('1:0')
+        self.assertEqual(dc.ram_size, 7 * 16)
 
         reset(small_hole_threshold=512, defrag_factor=20)
         self.assertIsNone(add(1, '1' * 1024))
@@ -358,6 +419,24 @@ def clear_predicate(key):
         remove(3)
         self.assertEqual(dc.holes(), {(1, 9)})
 
+        # test compression
+        reset()
+        compressible, incompressible = b'abcd' * 4096, random.randbytes(8192)
+        self.assertIsNone(add(1, compressible))
+        self.assertIsNone(add(2, incompressible))
+        self.assertEqual(dc.total_size, len(compressible) + len(incompressible))
+        self.assertTrue(dc.wait_for_write())
+        check_data()
+        self.assertLess(dc.total_size, len(compressible) // 4 + len(incompressible))
+        self.assertEqual(dc.total_size, dc.size_on_disk())
+        remove(1)
+        self.assertEqual(dc.total_size, len(incompressible))
+        dc.compress = False
+        self.assertIsNone(add(3, compressible))
+        self.assertTrue(dc.wait_for_write())
+        check_data()
+        self.assertEqual(dc.total_size, len(compressible) + len(incompressible))
+
     def test_suppressing_gr_command_responses(self):
         s, g, pl, sl = load_helpers(self)
         self.ae(pl('abcd', s=10, v=10, q=1), 'ENODATA:Insufficient image data: 4 < 400')
@@ -447,6 +526,15 @@ def test_load_images(self):
         img = g.image_for_client_id(1)
         self.ae(img['data'], random_data)
 
+        # Test commands too long to buffer, delivered as chunks by the parser
+        large_data = byte_block(4 * 512 * 384)
+        sl(large_data, s=512, v=384, expecting_data=large_data)
+        b = len(large_data) // 2
+        self.assertIsNone(pl(large_data[:b], s=512, v=384, m=1))
+        self.ae(pl(large_data[b:], m=0), 'OK')
+        img = g.image_for_client_id(1)
+        self.ae(img['data'], large_data)
+
         # Test loading from file
         def load_temp(prefix='tty-graphics-protocol-'):
             f = tempfile.NamedTemporaryFile(prefix=prefix)
@@ -475,6 +563,14 @@ def load_temp(prefix='tty-graphics-protocol-'):
         s.reset()
         self.assertEqual(g.disk_cache.total_size, 0)
 
+        # Test ephemeral images are not stored in the disk cache
+        shm_write(name, random_data)
+        self.ae(pl(name, s=1024, v=8, t='s', E=1), 'OK')
+        self.assertIsNone(g.image_for_client_id(1)['data'])
+        self.assertEqual(g.disk_cache.total_size, 0)
+        self.assertTrue(pl('abcd', a='f', s=1, v=1).startswith('ENODATA'))
+        s.reset()
+
     @unittest.skipIf(Image is None, 'PIL not available, skipping PNG tests')
     def test_load_png(self):
         s, g, pl, sl = load_helpers(self)
@@ -516,6 +612,34 @@ def test_load_png_simple(self):
         # test error handling for loading bad png data
         self.assertRaisesRegex(ValueError, '[EBADPNG]', load_png_data, b'dsfsdfsfsfd')
 
+    def test_background_decode_response_order(self):
+        import struct
+
+        def chunk(kind, data):
+            return struct.pack('>I', len(data)) + kind + data + struct.pack('>I', zlib.crc32(kind + data))
+
+        # a PNG large enough to be decoded in a worker thread
+        w = h = 300
+        raw = b''.join(b'\0' + os.urandom(w * 4) for y in range(h))
+        png_data = b'\x89PNG\r\n\x1a\n' + chunk(b'IHDR', struct.pack('>IIBBBBB', w, h, 8, 6, 0, 0, 0)) + chunk(
+            b'IDAT', zlib.compress(raw, 1)) + chunk(b'IEND', b'')
+        s = self.create_screen()
+        s.grman.background_decodes_without_window = True
+        payload = base64_encode(png_data).decode('ascii')
+        chunks = [payload[i:i+4096] for i in range(0, len(payload), 4096)]
+        cmds = []
+        for i, c in enumerate(chunks):
+            m = int(i < len(chunks) - 1)
+            cmds.append(f'\033_Ga=t,i=1,f=100,m={m};{c}\033\\' if i == 0 else f'\033_Gm={m};{c}\033\\')
+        cmds.append('\033_Ga=t,i=2,f=24,s=1,v=1;' + base64_encode(b'abc').decode('ascii') + '\033\\')
+        s.callbacks.clear()
+        parse_bytes(s, ''.join(cmds).encode('ascii'))
+        # the response to the second image waits for the first to be decoded
+        self.ae(s.callbacks.wtcbuf, b'')
+        self.assertTrue(s.test_finish_background_image_decodes())
+        self.ae(s.callbacks.wtcbuf, b'\033_Gi=1;OK\033\\\033_Gi=2;OK\033\\')
+        self.ae(s.grman.image_count, 2)
+
     def test_gr_operations_with_numbers(self):
         s = self.create_screen()
         g = s.grman
@@ -690,6 +814,10 @@ def p(x, y=0):
         self.ae(put_ref(s, id=2, placement_id=4, parent_id=2, parent_placement_id=3, offset_from_parent_x=-1), (2, ('OK', 'i=2,p=4')))
         pos[(2,3)] = p(pos[(2,2)]['x']-1, pos[(2,2)]['y'])
         self.ae(positions(), pos)
+        # Check that moving a parent moves the already resolved descendants
+        self.ae(put_ref(s, id=2, placement_id=3, parent_id=2, offset_from_parent_y=1), (2, ('OK', 'i=2,p=3')))
+        pos[(2,2)], pos[(2,3)] = p(2, 1), p(1, 1)
+        self.ae(positions(), pos)
         # Check that creating a cycle is prevented
         self.ae(put_ref(s, id=2, placement_id=3, parent_id=2, parent_placement_id=4), (2, ('ECYCLE', 'i=2,p=3')))
         self.ae(positions(), pos)
@@ -889,6 +1017,34 @@ def test_unicode_placeholders_multiple_placements(self):
         self.ae(refs[1]['src_rect'], {'left': 0.0, 'top': 0.0, 'right': 1.0, 'bottom': 1.0})
         self.ae(refs[2]['src_rect'], {'left': 0.0, 'top': 0.0, 'right': 1.0, 'bottom': 0.5})
 
+    def test_unicode_placeholders_in_history(self):
+        # Cell images for placeholders in history lines must follow changes
+        # to their virtual placement made after the lines were scanned
+        cw, ch = 10, 20
+        s, dx, dy, put_image, put_ref, layers, rect_eq = put_helpers(self, cw, ch)
+        put_image(s, 20, 20, num_cols=4, num_lines=2, unicode_placeholder=1, id=42, placement_id=7)
+        s.apply_sgr("38;5;42")
+        s.draw("\U0010EEEE\u0305\u0305\U0010EEEE\u0305\u030D")
+        s.cursor.x, s.cursor.y = 0, s.lines - 1
+        s.index()
+        self.ae(s.historybuf.count, 1)
+        s.scroll(1, True)
+        self.ae(s.scrolled_by, 1)
+
+        def src_rects():
+            s.update_only_line_graphics_data()
+            return [r['src_rect'] for r in layers(s, scrolled_by=s.scrolled_by)]
+
+        self.ae(src_rects(), [{'left': 0.0, 'top': 0.0, 'right': 0.5, 'bottom': 0.5}])
+        # nothing changed so the history line is not scanned again
+        self.ae(src_rects(), [{'left': 0.0, 'top': 0.0, 'right': 0.5, 'bottom': 0.5}])
+        # the two cells now cover the whole image
+        self.ae(put_ref(s, id=42, placement_id=7, num_cols=2, num_lines=1, unicode_placeholder=1), (42, ('OK', 'i=42,p=7')))
+        self.ae(src_rects(), [{'left': 0.0, 'top': 0.0, 'right': 1.0, 'bottom': 1.0}])
+        # and none of the image when the placement is deleted
+        send_command(s, 'a=d,d=i,i=42,p=7')
+        self.ae(src_rects(), [])
+
     def test_unicode_placeholders_scroll(self):
         # Here we test scrolling of a region. We'll draw an image spanning 8
         # rows and then scroll only the middle part of this image. Each
@@ -987,6 +1143,13 @@ def test_gr_scroll(self):
         s.index()
         self.ae(s.grman.image_count, 0)
 
+        # Images that cannot be referenced are removed by scrolling
+        s.reset()
+        put_image(s, cw, ch, no_id=True, a='t')
+        self.ae(s.grman.image_count, 1)
+        s.index()
+        self.ae(s.grman.image_count, 0)
+
         # Now test with margins
         s.reset()
         # Test images outside page area untouched
@@ -1327,3 +1490,24 @@ def test_cached_rgba_conversion(self):
                 self.ae((width, height), (w, h))
                 f.seek(8)
                 self.ae(rgba_data, f.read())
+            self.ae(irc.lookup(remaining_srcs[-1]), '')
+            self.ae(irc.lookup(srcs[0]), outputs[0])
+            self.assertFalse(os.path.exists(outputs[0]))
+
+    def test_generated_parsers_match_generator(self):
+        import re
+        import runpy
+        base = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        gen = os.path.join(base, 'gen', 'apc_parsers.py')
+        if not os.path.exists(gen):
+            self.skipTest('The code generators are not available')
+        m = runpy.run_path(gen)
+
+        def normalize(text):
+            # ignore everything clang-format changes
+            text = re.sub(r'//[^\n]*', '', text).replace('#pragma once', '')
+            return re.sub(r'\s+', '', re.sub(r'\\\n', '', text)).replace('""', '')
+
+        for func, header in (('graphics_parser', 'parse-graphics-command.h'), ('multicell_parser', 'parse-multicell-command.h')):
+            with open(os.path.join(base, 'kitty', header)) as f:
+                self.ae(normalize(m[func]()), normalize(f.read()), f'kitty/{header} was edited by hand, regenerate it with gen/apc_parsers.py')
@@ -565,6 +565,9 @@ def combine(self, action_definition: str) -> bool:
             def set_ignore_os_keyboard_processing(self, on: bool) -> None:
                 self.ignore_os_keyboard_processing = on
 
+            def set_shortcut_filter(self, keys) -> None:
+                self.shortcut_filter = keys
+
             def set_cocoa_global_shortcuts(self, opts):
                 return {}
 
@@ -649,6 +652,21 @@ def __call__(self, *keys: str):
         self.ae(tm('x'), [True])
         af(tm.keyboard_mode_stack)
 
+        # the native shortcut filter is only used in the root mode
+        tm = TM('map --new-mode mw --on-unknown end kitty_mod+f7', 'map --mode mw left neighboring_window left', 'map ctrl+a>b new_window')
+        self.assertIn(parse_shortcut('ctrl+shift+f7'), tm.shortcut_filter)
+        self.assertIn(parse_shortcut('ctrl+a'), tm.shortcut_filter)
+        self.assertNotIn(parse_shortcut('left'), tm.shortcut_filter)
+        tm('ctrl+shift+f7')
+        self.assertIsNone(tm.shortcut_filter)
+        tm('x')
+        self.assertIn(parse_shortcut('ctrl+shift+f7'), tm.shortcut_filter)
+        tm('ctrl+a')
+        self.assertIsNone(tm.shortcut_filter)
+        tm('b')
+        self.ae(tm.actions, ['new_window'])
+        self.assertIn(parse_shortcut('ctrl+a'), tm.shortcut_filter)
+
         # modal mapping with --on-action=end must restore OS keyboard processing
         tm = TM('map --new-mode mw --on-action end m', 'map --mode mw a new_window')
         self.ae(tm('m', 'a'), [True, True])
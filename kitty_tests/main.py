@@ -314,8 +314,8 @@ def env_for_python_tests(report_env: bool = False) -> Iterator[None]:
     if report_env:
         print('Using PATH in test environment:', path)
         print('Python:', python_for_type_check())
-        from kitty.fast_data_types import has_avx2, has_sse4_2
-        print(f'Intrinsics: {has_avx2=} {has_sse4_2=}')
+        from kitty.fast_data_types import has_avx2, has_avx512, has_sse4_2
+        print(f'Intrinsics: {has_avx512=} {has_avx2=} {has_sse4_2=}')
     # we need fonts installed in the user home directory as well, so initialize
     # fontconfig before nuking $HOME and friends
     from kitty.fonts.common import all_fonts_map
@@ -10,8 +10,10 @@
     base64_decode,
     base64_encode,
     has_avx2,
+    has_avx512,
     has_sse4_2,
     test_find_either_of_two_bytes,
+    test_find_end_of_csi_params,
     test_utf8_decode_to_sentinel,
 )
 
@@ -142,11 +144,27 @@ def test_parser_threading(self):
         left = self.write_bytes(s, self.create_write_buffer(s), b'c' * sz)
         self.assertTrue(len(left), 3 * sz - VT_PARSER_BUFFER_SIZE)
         self.assertFalse(self.create_write_buffer(s))
+        self.ae(s.vt_parser.ring_size, VT_PARSER_BUFFER_SIZE)
         s.test_parse_written_data()
         b = self.create_write_buffer(s)
         self.assertTrue(b)
+        # the ring was found full so it grows once it has been emptied
+        self.assertGreater(s.vt_parser.ring_size, VT_PARSER_BUFFER_SIZE)
         self.write_bytes(s, b, b'')
 
+        # test buffer growth
+        s = self.create_screen()
+        self.ae(s.vt_parser.buffer_size, VT_PARSER_BUFFER_SIZE)
+        parse_bytes(s, b'a' * (4 * VT_PARSER_BUFFER_SIZE))
+        self.assertGreater(s.vt_parser.buffer_size, VT_PARSER_BUFFER_SIZE)
+        self.assertGreaterEqual(s.vt_parser.buffer_high_water_mark, VT_PARSER_BUFFER_SIZE)
+
+        # test adaptive input delay
+        self.ae(s.vt_parser.input_regime, 'normal')
+        s = self.create_screen(options={'adaptive_input_delay': True})
+        parse_bytes(s, b'a' * (16 * VT_PARSER_BUFFER_SIZE))
+        self.ae(s.vt_parser.input_regime, 'bulk')
+
     def test_base64(self):
         for src, expected in {
             'bGlnaHQgdw==': 'light w',
@@ -203,7 +221,7 @@ def test_utf8_parsing(self):
 
     def test_utf8_simd_decode(self):
         def unsupported(which):
-            return (which == 2 and not has_sse4_2) or (which == 3 and not has_avx2)
+            return (which == 2 and not has_sse4_2) or (which == 3 and not has_avx2) or (which == 4 and not has_avx512)
 
         def reset_state():
             test_utf8_decode_to_sentinel(b'', -1)
@@ -237,9 +255,10 @@ def parse_parts(which):
             return actual
 
         def double_test(x):
-            for which in (2, 3):
+            for which in (2, 3, 4):
                 t(x, which=which)
             t(x*2, which=3)
+            t(x*4, which=4)
             reset_state()
 
         # incomplete trailer at end of vector
@@ -253,7 +272,7 @@ def double_test(x):
         x('abc\x1bd1234efgh5678')
         x('abcd1234efgh5678ijklABCDmnopEFGH')
 
-        for which in (2, 3):
+        for which in (2, 3, 4):
             x = partial(t, which=which)
             x('abcdef', 'ghijk')
             x('2:α3', ':≤4:😸|')
@@ -275,7 +294,7 @@ def test_expected(src, expected, which=2):
             expected = 'filler' + expected
             self.ae(expected, actual, f'Failed for: {src!r} with {which=}')
 
-        for which in (1, 2, 3):
+        for which in (1, 2, 3, 4):
             pb = partial(test_expected, which=which)
             pb('ニチ', 'ニチ')
             pb('\x84\x85', '\x84\x85')
@@ -307,6 +326,8 @@ def test_find_either_of_two_bytes(self):
             sizes.append(2)
         if has_avx2:
             sizes.append(3)
+        if has_avx512:
+            sizes.append(4)
         sizes.append(0)
 
         def test(buf, a, b, align_offset=0):
@@ -338,6 +359,27 @@ def tests(buf, a, b):
         tests("bba", 'a', '<')
         tests("baa", '>', 'a')
 
+    def test_find_end_of_csi_params(self):
+        sizes = []
+        if has_sse4_2:
+            sizes.append(2)
+        if has_avx2:
+            sizes.append(3)
+        if has_avx512:
+            sizes.append(4)
+        sizes.append(0)
+
+        def test(buf, align_offset=0):
+            expected = test_find_end_of_csi_params(buf, 1, 0)
+            for sz in sizes:
+                actual = test_find_end_of_csi_params(buf, sz, align_offset)
+                self.ae(expected, actual, f'Failed for: {buf!r} at {sz=} and {align_offset=}')
+
+        for q in ('', 'm', '1', '38;2;1;2;3m', '38:2::1:2:3m', '/0', '<9', ';;;', '12345678901234567890;' * 5):
+            for prefix in ('', '1;' * 8, '2:' * 16, '0' * 40):
+                for align_offset in range(32):
+                    test(prefix + q, align_offset)
+
     def test_esc_codes(self):
         s = self.create_screen()
         pb = partial(self.parse_bytes_dump, s)
@@ -508,6 +550,12 @@ def test_osc_codes(self):
         pb('\033]99;moo=foo;test it\x07', ('desktop_notify', 99, 'moo=foo;test it'))
         self.ae(c.notifications, [(9, ''), (9, 'test it with a nice long string'), (99, 'moo=foo;test it')])
         c.clear()
+        # bursts are rate limited with repeats dropped, the first
+        # notification is only queued if one was delivered very recently
+        parse_bytes(s, b'\x07' * 5 + b'\033]99;x\x07' * 3 + b'\033]99;y\x07')
+        self.ae(c.bell_count, 2)
+        self.assertIn(c.notifications, ([(99, 'x'), (99, 'y')], [(99, 'x'), (99, 'x'), (99, 'y')]))
+        c.clear()
         pb('\033]8;;\x07', ('set_active_hyperlink', None, None))
         pb('\033]8moo\x07', ('Ignoring malformed OSC 8 code',))
         pb('\033]8;moo\x07', ('Ignoring malformed OSC 8 code',))
@@ -583,7 +631,7 @@ def c(**k):
                 k.setdefault(f, b'\0')
             for f in ('format more id data_sz data_offset width height x_offset y_offset data_height data_width cursor_movement'
                       ' num_cells num_lines cell_x_offset cell_y_offset z_index placement_id image_number quiet unicode_placement'
-                      ' parent_id parent_placement_id offset_from_parent_x offset_from_parent_y'
+                      ' parent_id parent_placement_id offset_from_parent_x offset_from_parent_y ephemeral'
             ).split():
                 k.setdefault(f, 0)
             p = k.pop('payload', '')
@@ -603,6 +651,9 @@ def e(cmd, err):
         t('i=3,p=4', id=3, placement_id=4)
         e('i=%d' % (uint32_max + 1), 'Malformed GraphicsCommand control block, number is too large')
         pb('\033_Gi=12\033\\', c(id=12))
+        pb('\033Ptmux;\033\033_Gi=12\033\033\\\033\\', c(id=12))
+        pb('\033Ptmux;\033\033P=1s\033\033\\\033\\', ('screen_start_pending_mode',))
+        pb('\033Ptmux;\033\033P=2s\033\033\\\033\\', ('screen_stop_pending_mode',))
         t('a=t,t=d,s=100,z=-9', payload='X', action='t', transmission_type='d', data_width=100, z_index=-9)
         t('a=t,t=d,s=100,z=9', payload='payload', action='t', transmission_type='d', data_width=100, z_index=9)
         t('a=t,t=d,s=100,z=9,q=2', action='t', transmission_type='d', data_width=100, z_index=9, quiet=2)
@@ -0,0 +1,55 @@
+#!/usr/bin/env python
+# License: GPLv3 Copyright: 2025, Kovid Goyal <kovid at kovidgoyal.net>
+
+
+import json
+from types import SimpleNamespace
+
+from . import BaseTest
+
+
+class TestRemoteControl(BaseTest):
+
+    def test_event_subscriptions(self):
+        import kitty.boss as b
+        from kitty.rc.base import PayloadGetter, RemoteControlErrorWithoutTraceback
+        from kitty.rc.subscribe import subscribe
+        boss = SimpleNamespace(event_subscriptions={}, peer_data_map={})
+
+        def sub(peer_id, *events):
+            return subscribe.response_from_kitty(boss, None, PayloadGetter(subscribe, {'peer_id': peer_id, 'events': list(events)}))
+
+        self.ae(sub(3, 'title_changed'), {'event': 'subscribed'})
+        self.ae(sub(5), {'event': 'subscribed'})
+        self.ae(boss.event_subscriptions, {3: frozenset({'title_changed'}), 5: frozenset()})
+        self.assertRaises(RemoteControlErrorWithoutTraceback, sub, 0)
+        self.assertRaises(RemoteControlErrorWithoutTraceback, sub, 7, 'title_changed', 'no_such_event')
+        self.assertNotIn(7, boss.event_subscriptions)
+
+        sent = []
+        orig, b.send_data_to_peer = b.send_data_to_peer, lambda peer_id, data: sent.append((peer_id, data))
+
+        def report(event, window_id, **data):
+            sent.clear()
+            b.Boss.report_event_to_subscribers(boss, event, window_id, data)
+            ans = {}
+            for peer_id, msg in sent:
+                # every event is a complete remote control response on its own
+                self.assertTrue(msg.startswith(b'\x1bP@kitty-cmd'), msg)
+                self.assertTrue(msg.endswith(b'\x1b\\'), msg)
+                ans[peer_id] = json.loads(msg[len(b'\x1bP@kitty-cmd'):-len(b'\x1b\\')])
+            return ans
+
+        try:
+            expected = {'ok': True, 'data': {'event': 'title_changed', 'window_id': 2, 'title': 'abc'}}
+            self.ae(report('title_changed', 2, title='abc'), {3: expected, 5: expected})
+            self.ae(report('focus_changed', 2, focused=True), {5: {'ok': True, 'data': {'event': 'focus_changed', 'window_id': 2, 'focused': True}}})
+            # subscriptions end when the peer disconnects
+            self.assertFalse(b.Boss.peer_message_received(boss, b'peer_death', 5, False))
+            self.ae(report('focus_changed', 2, focused=False), {})
+            self.ae(set(report('title_changed', 4, title='x')), {3})
+            b.Boss.peer_message_received(boss, b'peer_death', 3, False)
+            self.ae(boss.event_subscriptions, {})
+            self.ae(report('title_changed', 4, title='y'), {})
+        finally:
+            b.send_data_to_peer = orig
@@ -1,11 +1,14 @@
 #!/usr/bin/env python
 # License: GPL v3 Copyright: 2016, Kovid Goyal <kovid at kovidgoyal.net>
 
+import re
+import tempfile
+
 from kitty.config import defaults
-from kitty.fast_data_types import DECAWM, DECCOLM, DECOM, IRM, VT_PARSER_BUFFER_SIZE, Color, ColorProfile, Cursor
-from kitty.marks import marker_from_function, marker_from_regex
+from kitty.fast_data_types import DECAWM, DECCOLM, DECOM, IRM, SCROLL_FULL, VT_PARSER_BUFFER_SIZE, VT_PARSER_MAX_ESCAPE_CODE_SIZE, Color, ColorProfile, Cursor, TextMarker
+from kitty.marks import marker_from_function, marker_from_multiple_regex, marker_from_regex
 from kitty.rgb import color_names
-from kitty.window import pagerhist
+from kitty.window import as_text, pagerhist
 
 from . import BaseTest, draw_multicell, parse_bytes
 
@@ -50,6 +53,13 @@ def test_draw_fast(self):
         s.draw('ab')
         self.ae(str(s.line(4)), 'ab123')
         self.ae((s.cursor.x, s.cursor.y), (2, 4))
+        # a run of ASCII uses the cursor attributes and is followed by combining chars
+        s.reset()
+        parse_bytes(s, b'\x1b[1m')
+        s.draw('abc\u0306d')
+        self.ae(str(s.line(0)), 'abc\u0306d')
+        self.assertTrue(all(s.line(0).cursor_from(x).bold for x in range(4)))
+        self.ae((s.cursor.x, s.cursor.y), (4, 0))
 
     def test_draw_char(self):
         # Test in line-wrap, non-insert mode
@@ -406,6 +416,71 @@ def ac():
         parse_bytes(s, b'\x1b[?2048h')  # ]
         self.ae(c.num_of_resize_events, 2)
 
+    def test_deferred_history_rewrap(self):
+        from kitty.window import as_text
+        s = self.create_screen(cols=10, lines=5, scrollback=40000)
+        for i in range(12000):
+            s.draw(f'{i:05d}' * (1 + i % 3)), s.carriage_return(), s.linefeed()
+        expected = as_text(s, add_history=True)
+        s.resize(5, 7)
+        # only the newest lines of the history are rewrapped immediately
+        self.assertLess(s.historybuf.count, 12000)
+        s.draw('x'), s.carriage_return(), s.linefeed()
+        expected += 'x\n'
+        s.resize(6, 13)
+        self.assertLess(s.historybuf.count, 12000)
+        self.ae(expected, as_text(s, add_history=True))
+        self.assertGreater(s.historybuf.count, 12000)
+        s.resize(5, 10)
+        h = s.historybuf.count
+        s.scroll(SCROLL_FULL, True)
+        self.ae(s.scrolled_by, s.historybuf.count)
+        self.assertGreater(s.historybuf.count, h)
+
+        # when the lines added while the rewrap is pending fill the history,
+        # the rewrapped lines go to the pager history before them
+        s = self.create_screen(cols=10, lines=5, scrollback=10000, options={'scrollback_pager_history_size': 1 << 20})
+        n = 0
+
+        def add(count):
+            nonlocal n
+            for i in range(count):
+                s.draw(f'{n:05d}'), s.carriage_return(), s.linefeed()
+                n += 1
+
+        add(10000)
+        s.resize(5, 8)
+        self.assertLess(s.historybuf.count, 10000)
+        add(10000)
+        numbers = [int(x) for x in (pagerhist(s) + as_text(s, add_history=True)).split()]
+        self.ae(numbers, list(range(n)))
+
+    def test_search(self):
+        s = self.create_screen(cols=10, lines=5, scrollback=10000)
+        for i in range(5000):
+            s.draw(f'line {i}'), s.carriage_return(), s.linefeed()
+        hc = s.historybuf.count
+        self.ae(s.search('line 1234'), [(1234 - hc, 0, 1234 - hc, 8)])
+        self.ae(s.search('line 4999'), [(3, 0, 3, 8)])
+        self.ae(s.search('no such text'), [])
+        self.ae(len(s.search('line 12')), 111)
+        self.ae(len(s.search(r'^line 12[0-9]{2}$', True)), 100)
+        with self.assertRaises(ValueError):
+            s.search('(', True)
+        # lines added after the index was built and matches spanning wrapped lines
+        s.draw('x' * 8 + 'needle'), s.carriage_return(), s.linefeed()
+        for i in range(5):
+            s.draw('zebra'), s.carriage_return(), s.linefeed()
+        hc = s.historybuf.count
+        self.ae(s.search('line 1234'), [(1234 - hc, 0, 1234 - hc, 8)])
+        (y1, x1, y2, x2), = s.search('needle')
+        self.ae((x1, y2 - y1, x2), (8, 1, 3))
+        self.ae(s.search('eedl', True), [(y1, 9, y2, 2)])
+        self.ae(len(s.search('zebra')), 5)
+        s.draw('ab😸cd')
+        (y1, x1, y2, x2), = s.search('😸c')
+        self.ae((x1, x2), (2, 4))
+
     def test_da1(self):
         s = self.create_screen()
         parse_bytes(s, b'\x1b[c\x1b[0c')  # ]]
@@ -711,6 +786,8 @@ def ts(*args):
         s.update_selection(3, 4)
         self.ae(s.text_for_selection(), ('ab   ', '     ', 'cd'))
         self.ae(s.text_for_selection(False, True), ('ab', '\n', 'cd'))
+        self.ae(s.utf8_for_selection(), b'ab        cd')
+        self.ae(s.utf8_for_selection(True), b'ab\ncd')
         s.reset()
         s.draw('a')
         s.select_graphic_rendition(32)
@@ -729,6 +806,19 @@ def ts(*args):
         s.update_selection(4, 4)
         self.ae(''.join(s.text_for_selection()), 'a\n\nb')
         self.ae(''.join(s.text_for_selection(True)), 'a\n\nb')
+        s.reset()
+        s.draw('\u25b6a\U0001f600'), s.carriage_return(), s.linefeed(), s.draw('x' * 500)
+        s.start_selection(0, 0)
+        s.update_selection(4, 4)
+        self.ae(s.utf8_for_selection(), ''.join(s.text_for_selection()).encode('utf-8'))
+        cells = s.chars_in_range(-1, 1)
+        self.ae(cells.shape, (2, s.columns))
+        self.ae(cells.tolist(), [[ord('x')] * s.columns] * 2)
+        s.reset()
+        s.draw('a\U0001f600')
+        self.ae(s.chars_in_range(0, 2).tolist()[0][:2], [ord('a'), 0x1f600])
+        self.ae(s.chars_in_range(0, 2).tolist()[1], [0] * s.columns)
+        self.ae(s.chars_in_range(3, 1).tolist(), [])
 
     def test_soft_hyphen(self):
         s = self.create_screen()
@@ -861,6 +951,17 @@ def test_wrapping_serialization(self):
         s.draw('7')
         self.ae(as_text(s, add_history=True), '1\n2\n3\n4\n5\n6\n7')
 
+        # text larger than the chunks passed to the callback
+        s = self.create_screen(cols=100, lines=5, scrollback=2000)
+        expected = []
+        for i in range(1500):
+            line = f'{i:04d}' * 25
+            expected.append(line)
+            s.draw(line), s.carriage_return(), s.linefeed()
+        self.ae(as_text(s, add_history=True), '\n'.join(expected) + '\n')
+        hist, on_screen = ''.join(f'\x1b[m{x}\n' for x in expected[:-4]), ''.join(f'\x1b[m{x}\n' for x in expected[-4:])
+        self.ae(as_text(s, add_history=True, as_ansi=True), hist + '\x1b[m' + on_screen)
+
         s = self.create_screen(cols=2, lines=2, scrollback=2, options={'scrollback_pager_history_size': 128})
         s.draw('aabb')
         s.cursor.y = 0
@@ -876,6 +977,36 @@ def test_wrapping_serialization(self):
         s.draw('a😀')
         self.ae(as_text(s), 'a😀')
 
+    def test_export_scrollback(self):
+        s = self.create_screen(cols=10, lines=4, scrollback=20, options={'scrollback_pager_history_size': 4096})
+        parse_bytes(s, b'\x1b[31mred\x1b[m text that \x1b]8;;http://x.com\x1b\\wraps\x1b]8;;\x1b\\ around\r\n')
+        parse_bytes(s, b'\r\n'.join(b'line %d' % i for i in range(40)))
+
+        def test():
+            expected = as_text(s, as_ansi=True, add_history=True, add_wrap_markers=True).replace('\r\n', '\n').replace('\r', '\n')
+            with tempfile.TemporaryFile() as f:
+                self.ae(s.export_scrollback(f.fileno()), expected.count('\n'))
+                f.seek(0)
+                self.ae(f.read().decode(), expected)
+
+        self.assertTrue(s.historybuf.pagerhist_as_text())
+        test()
+        s.resize(4, 7)
+        test()
+        s.toggle_alt_screen()
+        s.draw('alt')
+        test()
+        s.toggle_alt_screen()
+
+        r = self.create_screen(cols=s.columns, lines=s.lines, scrollback=100)
+        with tempfile.TemporaryFile() as f:
+            s.export_scrollback(f.fileno())
+            sz = f.tell()
+            f.seek(0)
+            self.ae(r.import_scrollback(f.fileno()), sz)
+        expected = as_text(s, add_history=True).rstrip('\n')
+        self.assertTrue(as_text(r, add_history=True).rstrip('\n').endswith(expected))
+
     def test_pagerhist(self):
         hsz = 8
         s = self.create_screen(cols=2, lines=2, scrollback=2, options={'scrollback_pager_history_size': hsz})
@@ -924,6 +1055,30 @@ def test():
         w('e')
         self.ae(contents(), 'abcde')
 
+        # resizing back to the width the pager history is wrapped at needs no rewrap
+        s = self.create_screen(cols=4, lines=2, scrollback=2, options={'scrollback_pager_history_size': 2048})
+        for i in range(6):
+            s.draw(f'{i}' * 4), s.carriage_return(), s.linefeed()
+        before = contents()
+        self.assertIn('\x1b[m0000\r\n', before)
+        s.resize(2, 6), s.resize(2, 4)
+        self.ae(contents(), before)
+
+        # large histories are stored compressed, so more text than the size limit fits
+        hsz = 3 * 1024 * 1024
+        s = self.create_screen(options={'scrollback_pager_history_size': hsz})
+        q = []
+        for i in range(200):
+            x = ''.join(f'\x1b[mline {i} {j} 😼\r\n' for j in range(1000))
+            q.append(x)
+            w(x)
+        expected = ''.join(q)
+        self.assertGreater(len(expected.encode()), hsz)
+        self.ae(contents(), expected)
+        self.assertLess(s.memory_usage()['pagerhist'], hsz)
+        s.historybuf.pagerhist_rewrap(10)
+        self.ae(contents().replace('\r', ''), expected.replace('\r', ''))
+
     def test_user_marking(self):
 
         def cells(*a, y=0, mark=3):
@@ -984,6 +1139,13 @@ def mark_x(text):
         s.draw('x')
         s.set_marker(marker_from_function(mark_x))
         self.ae(s.marked_cells(), [(2, 0, 1), (4, 0, 2)])
+        s = self.create_screen()
+        s.draw('aXbxAB')
+        m = marker_from_multiple_regex(((1, 'x'), (2, 'ab')), flags=re.UNICODE | re.IGNORECASE)
+        self.assertIsInstance(m, TextMarker)
+        s.set_marker(m)
+        self.ae(s.marked_cells(), [(1, 0, 1), (3, 0, 1), (4, 0, 2), (5, 0, 2)])
+        self.assertNotIsInstance(marker_from_regex('a|b', 3), TextMarker)
 
     def test_hyperlinks(self):
         s = self.create_screen()
@@ -1043,6 +1205,26 @@ def set_link(url=None, id=None):
         s.draw('a')
         self.ae({('i'*256 + ':' + 'u' * (2045 - 256), 1)}, s.hyperlinks_as_set())
 
+        # hyperlinks in compressed scrollback are remapped in place
+        s = self.create_screen(cols=10, lines=2, scrollback=100)
+        set_link('url-x')
+        s.draw('x')
+        set_link()
+        parse_bytes(s, b'\r\x1b[2K')
+        set_link('url-a')
+        s.draw('a')
+        set_link('url-b')
+        s.draw('b')
+        set_link()
+        for i in range(20):
+            s.index(); s.carriage_return()
+        s.release_idle_memory()
+        self.ae(s.historybuf.compressed_segments, 1)
+        s.garbage_collect_hyperlink_pool()
+        self.ae(s.historybuf.compressed_segments, 1)
+        self.ae({(':url-a', 1), (':url-b', 2)}, s.hyperlinks_as_set())
+        self.ae(s.historybuf.line(18).hyperlink_ids(), (1, 2) + (0,) * 8)
+
         s = self.create_screen()
         set_link('1'), s.draw('1')
         set_link('2'), s.draw('2')
@@ -1083,6 +1265,65 @@ def set_link(url=None, id=None):
         self.ae('2', s.hyperlink_at(1, 3))
         self.ae(s.current_url_text(), 'Z Z')
 
+    def test_text_cache_compaction(self):
+        s = self.create_screen()
+        s.draw('a\u0300b\u0301')
+        for i in range(s.lines):
+            s.linefeed(), s.carriage_return()
+        s.draw('c\u0302d\u0303\u0304')
+        s.cursor.x = 0
+        s.draw('X')
+        # c+U+0302 and the intermediate d+U+0303 are no longer used
+        self.ae(s.compact_text_cache(), 2)
+        self.ae(str(s.historybuf.line(0)), 'a\u0300b\u0301')
+        self.ae(str(s.line(s.cursor.y)), 'Xd\u0303\u0304')
+        self.ae(s.compact_text_cache(), 0)
+        s.cursor.x = 2
+        s.draw('a\u0300')
+        self.ae(s.compact_text_cache(), 0)
+        s.clear_scrollback()
+        self.ae(s.compact_text_cache(), 1)
+        s.draw('b\u0301')
+        self.ae(str(s.line(s.cursor.y)), 'Xd\u0303\u0304a\u0300b\u0301')
+
+    def test_memory_usage(self):
+        s = self.create_screen(cols=10, lines=2, scrollback=100)
+        m = s.memory_usage()
+        self.assertGreater(m['linebufs'], 2 * 2 * 10)
+        self.assertGreater(m['parser'], 0)
+        self.ae(m['history_cells'], 0)
+        for i in range(20):
+            s.draw(str(i))
+            s.index(); s.carriage_return()
+        self.assertGreater(s.memory_usage()['history_cells'], 0)
+        s.release_idle_memory()
+        m = s.memory_usage()
+        self.ae(m['history_cells'], 0)
+        self.assertGreater(m['history_compressed'], 0)
+
+    def test_release_idle_memory(self):
+        s = self.create_screen(cols=10, lines=2, scrollback=100)
+        for i in range(20):
+            s.draw(str(i))
+            s.index(); s.carriage_return()
+        self.assertGreater(s.release_idle_memory(), 0)
+        self.ae(s.vt_parser.buffer_size, 0)
+        self.ae(s.historybuf.compressed_segments, 1)
+        self.ae(str(s.historybuf.line(0)), '18')
+        self.ae(str(s.historybuf.line(18)), '0')
+        parse_bytes(s, b'\x1b[Hab')
+        self.ae(s.vt_parser.buffer_size, VT_PARSER_BUFFER_SIZE)
+        self.ae(str(s.line(0)), 'ab')
+
+        # segments copied by a resize that does not need rewrapping stay subject to compression
+        s = self.create_screen(cols=10, lines=2, scrollback=10000)
+        parse_bytes(s, b''.join(b'%d\r\n' % i for i in range(6500)))
+        s.resize(2, 10)
+        self.assertGreater(s.memory_usage()['history_cells'], 0)
+        s.release_idle_memory()
+        self.ae(s.memory_usage()['history_cells'], 0)
+        self.ae(str(s.historybuf.line(0)), '6498')
+
     def test_bottom_margin(self):
         s = self.create_screen(cols=80, lines=6, scrollback=4)
         s.set_margins(0, 5)
@@ -1116,6 +1357,30 @@ def test_top_and_bottom_margin(self):
         self.ae(str(s.linebuf), '0\n5\n6\n7\n\n')
         self.ae(str(s.historybuf), '')
 
+    def test_scroll_up(self):
+        s = self.create_screen(cols=10, lines=4, scrollback=10)
+        parse_bytes(s, b'0\r\n1\r\n2\r\n3\x1b[2S')
+        self.ae(str(s.linebuf), '2\n3\n\n')
+        self.ae(str(s.historybuf), '1\n0')
+        self.ae((s.cursor.x, s.cursor.y), (1, 3))
+        parse_bytes(s, b'\x1b[6S')
+        self.ae(str(s.linebuf), '\n\n\n')
+        self.ae(str(s.historybuf), '\n\n\n\n3\n2\n1\n0')
+        s.toggle_alt_screen()
+        parse_bytes(s, b'\x1b[Ha\r\nb\x1b[S')
+        self.ae(str(s.linebuf), 'b\n\n\n')
+        self.ae(str(s.historybuf), '\n\n\n\n3\n2\n1\n0')
+
+        # scrolling a region
+        s = self.create_screen(cols=10, lines=6, scrollback=10)
+        parse_bytes(s, b'0\r\n1\r\n2\r\n3\r\n4\r\n5\x1b[2;5r\x1b[2S')
+        self.ae(str(s.linebuf), '0\n3\n4\n\n\n5')
+        self.ae(str(s.historybuf), '')
+        parse_bytes(s, b'\x1b[3T')
+        self.ae(str(s.linebuf), '0\n\n\n\n3\n5')
+        parse_bytes(s, b'\x1b[9S')
+        self.ae(str(s.linebuf), '0\n\n\n\n\n5')
+
     def test_osc_52(self):
         s = self.create_screen()
         c = s.callbacks
@@ -1136,7 +1401,13 @@ def t(q, *expected):
                 del t.ex
 
         t('XYZ', ('p;XYZ', False))
-        t('a' * VT_PARSER_BUFFER_SIZE, ('p;' + 'a' * (VT_PARSER_BUFFER_SIZE - 8), True), (';' + 'a' * 8, False))
+        t('a' * VT_PARSER_BUFFER_SIZE, ('p;' + 'a' * VT_PARSER_BUFFER_SIZE, False))
+        c.clear()
+        payload = 'a' * (2 * VT_PARSER_MAX_ESCAPE_CODE_SIZE)
+        send(payload)
+        self.assertGreater(len(c.cc_buf), 1)
+        self.ae([x[1] for x in c.cc_buf], [True] * (len(c.cc_buf) - 1) + [False])
+        self.ae(''.join(x[0].partition(';')[2] for x in c.cc_buf), payload)
         t('', ('p;', False))
         t('!', ('p;!', False))
 
@@ -1215,6 +1486,28 @@ def ac(idx, count):
     def test_detect_url(self):
         detect_url(self)
         detect_url(self, scale=2)
+        # detection results are cached till the screen contents change
+        s = self.create_screen(cols=30)
+        s.draw('http://moo.com')
+        s.reset_dirty()
+        for i in range(2):
+            s.detect_url(3, 0)
+            self.ae('http://moo.com', ''.join(s.text_for_marked_url()))
+        s.reset()
+        s.draw('nour://x.com')
+        s.reset_dirty()
+        s.detect_url(3, 0)
+        self.ae('', ''.join(s.text_for_marked_url()))
+        s.cursor.x = 0
+        s.draw('http')
+        s.detect_url(3, 0)
+        self.ae('http://x.com', ''.join(s.text_for_marked_url()))
+        s.reset()
+        parse_bytes(s, b'no URL here\r\nhttp://moo.com')
+        s.reset_dirty()
+        for y, expected in ((0, ''), (1, 'http://moo.com'), (0, ''), (1, 'http://moo.com')):
+            s.detect_url(5, y)
+            self.ae(expected, ''.join(s.text_for_marked_url()))
 
     def test_prompt_marking(self):
         # ]]]]]]]]]]]]]]]]}}}}}}}}}}}}}}}}))))))))))))))))))))))
@@ -1520,6 +1813,66 @@ def lvco():
         s.erase_last_command()
         self.ae(at().rstrip(), '  a  b\npartial')
 
+        # jumping to prompts only looks at line attributes, which are never compressed
+        s = self.create_screen(cols=5, lines=5, scrollback=5000)
+        draw_prompt('p1'), draw_output(3000), draw_prompt('p2'), draw_output(10)
+        s.release_idle_memory()
+        compressed = s.historybuf.compressed_segments
+        self.assertGreater(compressed, 0)
+        self.assertTrue(s.scroll_to_prompt(-2))
+        self.assertGreater(s.scrolled_by, 3000)
+        self.ae(s.historybuf.compressed_segments, compressed)
+
+        # the output of commands is captured independently of the scrollback
+        import os
+        import zlib
+        s = self.create_screen(cols=5, lines=5, scrollback=5, options={'command_output_capture_size': 1})
+        parse_bytes(s, b'\033]133;A\007$ x\r\n\033]133;C\007')
+        parse_bytes(s, ''.join(f'{i}\tl\r\n' for i in range(1000)).encode())
+        s.toggle_alt_screen(), s.draw('alt'), s.toggle_alt_screen()
+        self.assertIsNone(s.take_captured_command_output())
+        parse_bytes(s, b'\033]133;D;0\007')
+        data, sz, truncated = s.take_captured_command_output()
+        expected = ''.join(f'{i}\tl\n' for i in range(1000))
+        self.ae(zlib.decompress(data).decode(), expected)
+        self.ae((sz, truncated), (len(expected), False))
+        self.assertIsNone(s.take_captured_command_output())
+        parse_bytes(s, b'\033]133;C\007')
+        parse_bytes(s, os.urandom(2 * 1024 * 1024).hex().encode())
+        parse_bytes(s, b'\033]133;A\007')
+        data, sz, truncated = s.take_captured_command_output()
+        self.assertTrue(truncated)
+        self.assertLess(len(data), 1100 * 1024)
+        self.assertTrue(zlib.decompress(data))
+
+    def test_predictive_echo(self):
+        s = self.create_screen(cols=20, lines=3)
+        s.predict_echo('ls')
+        self.ae(s.predicted_echo(), '')  # not enabled
+        s.predictive_echo = True
+        s.predict_echo('ls')
+        self.ae(s.predicted_echo(), '')  # not at a prompt
+        parse_bytes(s, b'\033]133;A\007$ ')
+        s.predict_echo('l'), s.predict_echo('s -l')
+        self.ae(s.predicted_echo(), 'ls -l')
+        self.ae(str(s.line(0)), '$ ')  # predictions are not part of the screen contents
+        parse_bytes(s, b'ls')
+        self.ae(s.predicted_echo(), ' -l')
+        parse_bytes(s, b' -x')
+        self.ae(s.predicted_echo(), '')
+        s.predict_echo('a')
+        parse_bytes(s, b'\x1b[Dq')
+        self.ae(s.predicted_echo(), '')  # echo at a different position
+        s.predict_echo('é')
+        self.ae(s.predicted_echo(), '')
+        s.predict_echo('x' * 30)
+        self.ae(len(s.predicted_echo()), 20 - s.cursor.x - 1)  # predictions never wrap
+        parse_bytes(s, b'\033]133;C\007')
+        s.resize(3, 30)
+        self.ae(s.predicted_echo(), '')
+        s.predict_echo('a')
+        self.ae(s.predicted_echo(), '')  # in command output
+
     def test_pointer_shapes(self):
         from kitty.window import set_pointer_shape
         s = self.create_screen()
@@ -1590,6 +1943,26 @@ def q(send, expected=None):
         q({'transparent_background_color2': '#ffffff@-1'})
         q({'transparent_background_color2': '?'}, {'transparent_background_color2': (Color(255, 255, 255), 255)})
 
+    def test_paste(self):
+        s = self.create_screen()
+        c = s.callbacks
+
+        def p(text, expected):
+            c.clear()
+            s.paste(text)
+            self.ae(c.wtcbuf, expected)
+
+        p(b'a\nb\r\nc\r\rd\n\n', b'a\rb\rc\r\rd\r\r')
+        p(b'abc', b'abc')
+        c.clear()
+        s.paste_bytes(b'a\nb')
+        self.ae(c.wtcbuf, b'a\nb')
+        parse_bytes(s, b'\x1b[?2004h')
+        p(b'a\nb', b'\x1b[200~a\nb\x1b[201~')
+        p(b'\x1b[201~a\x9b201~b', b'\x1b[200~ab\x1b[201~')
+        p(b'\x1b[201\x1b[201~~a\x1b[20\x9b201~1~b\x1b[201', b'\x1b[200~ab\x1b[201\x1b[201~')
+        p(b'\x1b[A', b'\x1b[200~\x1b[A\x1b[201~')
+
     def test_multi_cursors(self):
         s = self.create_screen()
         c = s.callbacks
@@ -762,15 +762,16 @@ def base64_defines(isa: ISA) -> List[str]:
     if isa == ISA.ARM64:
         defs['HAVE_NEON64'] = 1
     elif isa == ISA.AMD64:
+        defs['HAVE_AVX512'] = 1
         defs['HAVE_AVX2'] = 1
         defs['HAVE_AVX'] = 1
         defs['HAVE_SSE42'] = 1
         defs['HAVE_SSE41'] = 1
-        defs['HAVE_SSE3'] = 1
+        defs['HAVE_SSSE3'] = 1
     elif isa == ISA.X86:
         defs['HAVE_SSE42'] = 1
         defs['HAVE_SSE41'] = 1
-        defs['HAVE_SSE3'] = 1
+        defs['HAVE_SSSE3'] = 1
     return [f'{k}={v}' for k, v in defs.items()]
 
 
@@ -796,12 +797,17 @@ def get_source_specific_defines(env: Env, src: str) -> Tuple[str, List[str], Opt
 def get_source_specific_cflags(env: Env, src: str) -> List[str]:
     ans = list(env.cflags)
     # SIMD specific flags
-    if src in ('kitty/simd-string-128.c', 'kitty/simd-string-256.c'):
+    if src in ('kitty/simd-string-128.c', 'kitty/simd-string-256.c', 'kitty/simd-string-512.c'):
         # simde recommends these are used for best performance
         ans.extend(('-fopenmp-simd', '-DSIMDE_ENABLE_OPENMP'))
         if env.binary_arch.isa in (ISA.AMD64, ISA.X86):
-            ans.append('-msse4.2' if '128' in src else '-mavx2')
-            if '256' in src:
+            if '128' in src:
+                ans.append('-msse4.2')
+            elif '256' in src:
+                ans.append('-mavx2')
+            else:
+                ans.extend(('-mavx512f', '-mavx512bw', '-mavx512vbmi'))
+            if '128' not in src:
                 # We have manual vzeroupper so prevent compiler from emitting it causing duplicates
                 if env.compiler_type is CompilerType.clang:
                     ans.append('-mllvm')
@@ -811,8 +817,8 @@ def get_source_specific_cflags(env: Env, src: str) -> List[str]:
     elif src.startswith('3rdparty/base64/lib/arch/'):
         if env.binary_arch.isa in (ISA.AMD64, ISA.X86):
             q = src.split(os.path.sep)
-            if 'sse3' in q:
-                ans.append('-msse3')
+            if 'ssse3' in q:
+                ans.append('-mssse3')
             elif 'sse41' in q:
                 ans.append('-msse4.1')
             elif 'sse42' in q:
@@ -821,6 +827,8 @@ def get_source_specific_cflags(env: Env, src: str) -> List[str]:
                 ans.append('-mavx')
             elif 'avx2' in q:
                 ans.append('-mavx2')
+            elif 'avx512' in q:
+                ans.extend(('-mavx512vl', '-mavx512vbmi'))
     return ans
 
 
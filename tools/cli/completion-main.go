@@ -7,6 +7,7 @@ import (
 	"fmt"
 	"io"
 	"os"
+	"path/filepath"
 	"strings"
 )
 
@@ -43,6 +44,30 @@ func RegisterExeForCompletion(x func(root *Command)) {
 	registered_exes = append(registered_exes, x)
 }
 
+var argv_being_completed []string
+
+// ExeBeingCompleted returns the name of the executable whose command line is
+// being completed, or the empty string if there are several command lines.
+// Registration functions use it to avoid building command trees that cannot
+// be needed.
+func ExeBeingCompleted() string {
+	if len(argv_being_completed) > 0 {
+		return filepath.Base(argv_being_completed[0])
+	}
+	return ""
+}
+
+// ArgvBeingCompletedFor returns the command line being completed, if it is for
+// exe and its first word after exe is complete, so that only the command tree
+// for that sub command need be built. Otherwise it returns an argv that
+// requires the full tree.
+func ArgvBeingCompletedFor(exe string) []string {
+	if len(argv_being_completed) > 2 && ExeBeingCompleted() == exe {
+		return argv_being_completed
+	}
+	return []string{exe}
+}
+
 func GenerateCompletions(args []string) error {
 	output_type := "json"
 	if len(args) > 0 {
@@ -88,6 +113,9 @@ func GenerateCompletions(args []string) error {
 	if err != nil {
 		return err
 	}
+	if len(all_argv) == 1 {
+		argv_being_completed = all_argv[0]
+	}
 	var root = NewRootCommand()
 	for _, re := range registered_exes {
 		re(root)
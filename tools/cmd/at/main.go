@@ -141,6 +141,10 @@ func simple_serializer(rc *utils.RemoteControlCmd) (ans []byte, err error) {
 
 type serializer_func func(rc *utils.RemoteControlCmd) ([]byte, error)
 
+// Encryption sessions, reused by all commands sent to the same kitty from this
+// process, such as by kitten @ shell and commands that stream data
+var encryption_sessions = map[string]*crypto.Session{}
+
 func create_serializer(password password, encoded_pubkey string, io_data *rc_io_data) (err error) {
 	io_data.serializer = simple_serializer
 	if password.is_set {
@@ -148,8 +152,14 @@ func create_serializer(password password, encoded_pubkey string, io_data *rc_io_
 		if err != nil {
 			return err
 		}
+		session_key := encryption_version + ":" + string(pubkey)
+		session := encryption_sessions[session_key]
+		if session == nil {
+			session = crypto.NewSession(pubkey, encryption_version)
+			encryption_sessions[session_key] = session
+		}
 		io_data.serializer = func(rc *utils.RemoteControlCmd) (ans []byte, err error) {
-			ec, err := crypto.Encrypt_cmd(rc, global_options.password.val, pubkey, encryption_version)
+			ec, err := session.Encrypt_cmd(rc, global_options.password.val)
 			if err != nil {
 				return
 			}
@@ -196,6 +206,7 @@ type rc_io_data struct {
 	on_key_event               func(lp *loop.Loop, ke *loop.KeyEvent) error
 	string_response_is_err     bool
 	handle_response            func(data []byte) error
+	handle_streamed_response   func(serialized_response []byte) error
 	timeout                    time.Duration
 	multiple_payload_generator func(io_data *rc_io_data) (bool, error)
 
@@ -235,7 +246,7 @@ func get_response(do_io func(io_data *rc_io_data) ([]byte, error), io_data *rc_i
 		return nil, err
 	}
 	if len(serialized_response) == 0 {
-		if io_data.rc.NoResponse {
+		if io_data.rc.NoResponse || io_data.handle_streamed_response != nil {
 			res := Response{Ok: true}
 			ans = &res
 			return
@@ -229,6 +229,7 @@ func shell_main(cmd *cli.Command, args []string) (int, error) {
 	rl = readline.New(nil, readline.RlInit{Prompt: prompt, Completer: combined_completer, HistoryPath: filepath.Join(utils.CacheDir(), "shell.history.json")})
 	defer func() {
 		rl.Shutdown()
+		close_shell_conn()
 	}()
 	for {
 		rc, err := shell_loop(rl, true)
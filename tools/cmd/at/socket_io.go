@@ -63,7 +63,7 @@ func (r *response_reader) read_response_from_conn(conn *net.Conn, timeout time.D
 		buf := r.storage[:]
 		for keep_going {
 			var n int
-			(*conn).SetDeadline(time.Now().Add(timeout))
+			(*conn).SetDeadline(utils.IfElse(timeout > 0, time.Now().Add(timeout), time.Time{}))
 			n, err = (*conn).Read(buf)
 			if err != nil {
 				keep_going = false
@@ -157,11 +157,23 @@ func simple_socket_io(conn *net.Conn, io_data *rc_io_data) (serialized_response
 	if io_data.rc.NoResponse {
 		return
 	}
+	if io_data.handle_streamed_response != nil {
+		for {
+			if serialized_response, err = r.read_response_from_conn(conn, 0); err != nil || serialized_response == nil {
+				if errors.Is(err, io.EOF) {
+					err = nil
+				}
+				return nil, err
+			}
+			if err = io_data.handle_streamed_response(serialized_response); err != nil {
+				return
+			}
+		}
+	}
 	return r.read_response_from_conn(conn, io_data.timeout)
 }
 
-func do_socket_io(io_data *rc_io_data) (serialized_response []byte, err error) {
-	var conn net.Conn
+func dial_socket() (conn net.Conn, err error) {
 	if global_options.to_network == "fd" {
 		fd, _ := strconv.Atoi(global_options.to_address)
 		if err != nil {
@@ -169,10 +181,10 @@ func do_socket_io(io_data *rc_io_data) (serialized_response []byte, err error) {
 		}
 		f := os.NewFile(uintptr(fd), "fd:"+global_options.to_address)
 		conn, err = net.FileConn(f)
+		f.Close()
 		if err != nil {
 			return nil, fmt.Errorf("Failed to open a socket for the remote control file descriptor: %d with error: %w", fd, err)
 		}
-		defer f.Close()
 	} else {
 		network := utils.IfElse(global_options.to_network == "ip", "tcp", global_options.to_network)
 		conn, err = net.Dial(network, global_options.to_address)
@@ -181,6 +193,52 @@ func do_socket_io(io_data *rc_io_data) (serialized_response []byte, err error) {
 			return
 		}
 	}
+	return
+}
+
+// The kitty shell runs many commands one after the other, kitty processes
+// every command sent on a connection in order, so the shell keeps its
+// connection open between commands instead of connecting for each one.
+var shell_conn struct {
+	conn             net.Conn
+	network, address string
+}
+
+func close_shell_conn() {
+	if shell_conn.conn != nil {
+		shell_conn.conn.Close()
+		shell_conn.conn = nil
+	}
+}
+
+func do_shell_socket_io(io_data *rc_io_data) (serialized_response []byte, err error) {
+	if shell_conn.conn != nil && (shell_conn.network != global_options.to_network || shell_conn.address != global_options.to_address) {
+		close_shell_conn()
+	}
+	if shell_conn.conn == nil {
+		if shell_conn.conn, err = dial_socket(); err != nil {
+			shell_conn.conn = nil
+			return
+		}
+		shell_conn.network, shell_conn.address = global_options.to_network, global_options.to_address
+	}
+	serialized_response, err = simple_socket_io(&shell_conn.conn, io_data)
+	if err != nil || io_data.rc.Async != "" || io_data.rc.Stream || io_data.handle_streamed_response != nil {
+		// a late response to an async or streaming command must not be
+		// mistaken for the response to the next command
+		close_shell_conn()
+	}
+	return
+}
+
+func do_socket_io(io_data *rc_io_data) (serialized_response []byte, err error) {
+	if running_shell {
+		return do_shell_socket_io(io_data)
+	}
+	conn, err := dial_socket()
+	if err != nil {
+		return
+	}
 	defer conn.Close()
 	return simple_socket_io(&conn, io_data)
 }
@@ -0,0 +1,31 @@
+// License: GPLv3 Copyright: 2025, Kovid Goyal, <kovid at kovidgoyal.net>
+
+package at
+
+import (
+	"encoding/json"
+	"fmt"
+	"os"
+)
+
+var _ = fmt.Print
+
+func subscribe_setup(io_data *rc_io_data, args []string, payload *subscribe_json_type) error {
+	payload.Events = escape_list_of_strings(args)
+	io_data.handle_streamed_response = func(serialized_response []byte) error {
+		var response struct {
+			Ok    bool            `json:"ok"`
+			Data  json.RawMessage `json:"data,omitempty"`
+			Error string          `json:"error,omitempty"`
+		}
+		if err := json.Unmarshal(serialized_response, &response); err != nil {
+			return fmt.Errorf("Invalid response received from kitty, unmarshalling error: %w", err)
+		}
+		if !response.Ok {
+			return fmt.Errorf("%s", response.Error)
+		}
+		_, err := fmt.Fprintln(os.Stdout, string(response.Data))
+		return err
+	}
+	return nil
+}
@@ -4,9 +4,13 @@ package benchmark
 
 import (
 	"bytes"
+	"encoding/json"
 	"errors"
 	"fmt"
 	"math/rand/v2"
+	"os"
+	"os/exec"
+	"path/filepath"
 	"slices"
 	"strings"
 	"time"
@@ -26,6 +30,8 @@ type Options struct {
 	Repetitions    int
 	WithScrollback bool
 	Render         bool
+	FrameTimings   bool
+	Replay         []string
 }
 
 const reset = "\x1b]\x1b\\\x1bc"
@@ -48,6 +54,79 @@ const misc_unicode = `
 
 var opts Options
 
+type trace_event struct {
+	Name string  `json:"name"`
+	Ph   string  `json:"ph"`
+	Ts   float64 `json:"ts"`
+	Dur  float64 `json:"dur"`
+}
+
+// Get the timings of recently rendered frames from kitty, see the
+// frame-timings remote control command
+func fetch_frame_timings() (ans []trace_event, err error) {
+	exe, err := os.Executable()
+	if err != nil {
+		return nil, err
+	}
+	out, err := exec.Command(exe, "@", "frame-timings").Output()
+	if err != nil {
+		return nil, fmt.Errorf("Failed to get frame timings from kitty, is remote control enabled? Error: %w", err)
+	}
+	var trace struct {
+		TraceEvents []trace_event `json:"traceEvents"`
+	}
+	if err = json.Unmarshal(out, &trace); err != nil {
+		return nil, err
+	}
+	for _, e := range trace.TraceEvents {
+		if e.Ph == "X" {
+			ans = append(ans, e)
+		}
+	}
+	return
+}
+
+type frame_stats struct {
+	num_frames      int
+	p99             time.Duration
+	stage_durations map[string]time.Duration
+	stage_order     []string
+}
+
+func us(x float64) time.Duration { return time.Duration(x * float64(time.Microsecond)) }
+
+// Summarize the frame timings recorded after the timestamp since, which is in
+// kitty's clock
+func summarize_frame_timings(events []trace_event, since float64) *frame_stats {
+	ans := frame_stats{stage_durations: make(map[string]time.Duration)}
+	var frames []time.Duration
+	for _, e := range events {
+		if e.Ts <= since {
+			continue
+		}
+		if e.Name == "frame" {
+			frames = append(frames, us(e.Dur))
+		}
+		if _, found := ans.stage_durations[e.Name]; !found {
+			ans.stage_order = append(ans.stage_order, e.Name)
+		}
+		ans.stage_durations[e.Name] += us(e.Dur)
+	}
+	ans.num_frames = len(frames)
+	if len(frames) > 0 {
+		slices.Sort(frames)
+		ans.p99 = frames[min(len(frames)-1, len(frames)*99/100)]
+	}
+	return &ans
+}
+
+func latest_timestamp(events []trace_event) (ans float64) {
+	for _, e := range events {
+		ans = max(ans, e.Ts+e.Dur)
+	}
+	return
+}
+
 func benchmark_data(description string, data string, opts Options) (duration time.Duration, sent_data_size int, reps int, err error) {
 	term, err := tty.OpenControllingTerm(tty.SetRaw)
 	if err != nil {
@@ -128,26 +207,43 @@ type result struct {
 	data_sz     int
 	duration    time.Duration
 	repetitions int
+	frames      *frame_stats
 }
 
-func simple_ascii() (r result, err error) {
-	const desc = "Only ASCII chars"
-	data := random_string_of_bytes(1024*2048+13, ascii_printable+control_chars)
+func run_benchmark(desc, data string) (r result, err error) {
+	since := 0.
+	if opts.FrameTimings {
+		events, err := fetch_frame_timings()
+		if err != nil {
+			return result{}, err
+		}
+		since = latest_timestamp(events)
+	}
 	duration, data_sz, reps, err := benchmark_data(desc, data, opts)
 	if err != nil {
 		return result{}, err
 	}
-	return result{desc, data_sz, duration, reps}, nil
+	r = result{desc, data_sz, duration, reps, nil}
+	if opts.FrameTimings {
+		events, err := fetch_frame_timings()
+		if err != nil {
+			return result{}, err
+		}
+		r.frames = summarize_frame_timings(events, since)
+	}
+	return r, nil
+}
+
+func simple_ascii() (r result, err error) {
+	const desc = "Only ASCII chars"
+	data := random_string_of_bytes(1024*2048+13, ascii_printable+control_chars)
+	return run_benchmark(desc, data)
 }
 
 func unicode() (r result, err error) {
 	const desc = "Unicode chars"
 	data := strings.Repeat(chinese_lorem_ipsum+misc_unicode+control_chars, 1024)
-	duration, data_sz, reps, err := benchmark_data(desc, data, opts)
-	if err != nil {
-		return result{}, err
-	}
-	return result{desc, data_sz, duration, reps}, nil
+	return run_benchmark(desc, data)
 }
 
 func ascii_with_csi() (r result, err error) {
@@ -176,11 +272,24 @@ func ascii_with_csi() (r result, err error) {
 	}
 	out = append(out, "\x1b[m"...)
 	const desc = "CSI codes with few chars"
-	duration, data_sz, reps, err := benchmark_data(desc, utils.UnsafeBytesToString(out), opts)
-	if err != nil {
-		return result{}, err
+	return run_benchmark(desc, utils.UnsafeBytesToString(out))
+}
+
+// Full screen apps that clear and repaint the whole screen for every frame
+func clear_and_repaint() (r result, err error) {
+	const num_frames, num_lines = 256, 64
+	line := random_string_of_bytes(40, ascii_printable)
+	b := strings.Builder{}
+	for f := range num_frames {
+		b.WriteString("\x1b[H\x1b[2J")
+		for y := range num_lines {
+			// colored background and erase to end of line as TUIs do for panes
+			fmt.Fprintf(&b, "\x1b[%d;1H\x1b[48;5;%dm%s\x1b[K\x1b[m", y+1, (f+y)%256, line)
+		}
+		b.WriteString("\x1b[H\x1b[J\x1b[10X\x1b[2K")
 	}
-	return result{desc, data_sz, duration, reps}, nil
+	const desc = "Clear and repaint"
+	return run_benchmark(desc, b.String())
 }
 
 func images() (r result, err error) {
@@ -201,11 +310,42 @@ func images() (r result, err error) {
 	_ = g.WriteWithPayloadTo(&b, nil)
 	data := b.String()
 	const desc = "Images"
-	duration, data_sz, reps, err := benchmark_data(desc, data, opts)
-	if err != nil {
-		return result{}, err
+	return run_benchmark(desc, data)
+}
+
+func animation_frames() (r result, err error) {
+	g := graphics.GraphicsCommand{}
+	g.SetImageId(12346)
+	g.SetQuiet(graphics.GRT_quiet_silent)
+	g.SetAction(graphics.GRT_action_transmit)
+	g.SetFormat(graphics.GRT_format_rgba)
+	const dim = 1024
+	const num_frames = 8
+	g.SetDataWidth(dim)
+	g.SetDataHeight(dim)
+	g.DisableCompression = true // dont want to measure the speed of zlib
+	// semi-transparent pixels so that every frame has to be alpha blended onto its base frame
+	pixels := make([]byte, 4*dim*dim)
+	for i := 3; i < len(pixels); i += 4 {
+		pixels[i] = 0x80
+	}
+	b := strings.Builder{}
+	b.Grow(8 * dim * dim * num_frames)
+	_ = g.WriteWithPayloadTo(&b, pixels)
+	g.SetAction(graphics.GRT_action_frame)
+	for i := 1; i < num_frames; i++ {
+		g.SetBaseFrame(uint64(i))
+		_ = g.WriteWithPayloadTo(&b, pixels)
 	}
-	return result{desc, data_sz, duration, reps}, nil
+	g = graphics.GraphicsCommand{}
+	g.SetImageId(12346)
+	g.SetQuiet(graphics.GRT_quiet_silent)
+	g.SetAction(graphics.GRT_action_delete)
+	g.SetDelete(graphics.GRT_free_by_id)
+	_ = g.WriteWithPayloadTo(&b, nil)
+	data := b.String()
+	const desc = "Animation frames"
+	return run_benchmark(desc, data)
 }
 
 func long_escape_codes() (r result, err error) {
@@ -213,11 +353,19 @@ func long_escape_codes() (r result, err error) {
 	// OSC 6 is document reporting or XTerm special color which kitty ignores after parsing
 	data = strings.Repeat("\x1b]6;"+data+"\x07", 1024)
 	const desc = "Long escape codes"
-	duration, data_sz, reps, err := benchmark_data(desc, data, opts)
+	return run_benchmark(desc, data)
+}
+
+// Replay output recorded from a real session with kitty --dump-bytes
+func replay(path string) (r result, err error) {
+	data, err := os.ReadFile(path)
 	if err != nil {
 		return result{}, err
 	}
-	return result{desc, data_sz, duration, reps}, nil
+	if len(data) == 0 {
+		return result{}, fmt.Errorf("The recorded output in %s is empty", path)
+	}
+	return run_benchmark("Replay of "+filepath.Base(path), utils.UnsafeBytesToString(data))
 }
 
 var divs = []time.Duration{
@@ -240,16 +388,23 @@ func present_result(r result, col_width int) {
 	rate /= 1024. * 1024.
 	f := fmt.Sprintf("%%-%ds", col_width)
 	fmt.Printf("  "+f+" : %-10v @ \x1b[32m%-7.1f\x1b[m MB/s\n", r.desc, round(r.duration, 2), rate)
+	if r.frames != nil {
+		fps := float64(r.frames.num_frames) / r.duration.Seconds()
+		fmt.Printf("  "+f+"   %d frames @ \x1b[32m%.1f\x1b[m fps, p99 frame time: %v\n", "", r.frames.num_frames, fps, round(r.frames.p99, 2))
+		for _, stage := range r.frames.stage_order {
+			fmt.Printf("  "+f+"     %-13s: %v\n", "", stage, round(r.frames.stage_durations[stage], 2))
+		}
+	}
 }
 
 func all_benchamrks() []string {
 	return []string{
-		"ascii", "unicode", "csi", "images", "long_escape_codes",
+		"ascii", "unicode", "csi", "clear", "images", "frames", "long_escape_codes",
 	}
 }
 
 func main(args []string) (err error) {
-	if len(args) == 0 {
+	if len(args) == 0 && len(opts.Replay) == 0 {
 		args = all_benchamrks()
 	}
 	var results []result
@@ -283,6 +438,13 @@ func main(args []string) (err error) {
 		results = append(results, r)
 	}
 
+	if slices.Index(args, "clear") >= 0 {
+		if r, err = clear_and_repaint(); err != nil {
+			return err
+		}
+		results = append(results, r)
+	}
+
 	if slices.Index(args, "long_escape_codes") >= 0 {
 		if r, err = long_escape_codes(); err != nil {
 			return err
@@ -297,6 +459,20 @@ func main(args []string) (err error) {
 		results = append(results, r)
 	}
 
+	if slices.Index(args, "frames") >= 0 {
+		if r, err = animation_frames(); err != nil {
+			return err
+		}
+		results = append(results, r)
+	}
+
+	for _, path := range opts.Replay {
+		if r, err = replay(path); err != nil {
+			return err
+		}
+		results = append(results, r)
+	}
+
 	fmt.Print(reset)
 	fmt.Println(
 		"These results measure the time it takes the terminal to fully parse all the data sent to it.")
@@ -329,6 +505,9 @@ func EntryPoint(root *cli.Command) {
 				return 1, err
 			}
 			opts.Repetitions = max(1, opts.Repetitions)
+			if opts.FrameTimings {
+				opts.Render = true
+			}
 			if err = main(args); err != nil {
 				ret = 1
 			}
@@ -351,5 +530,15 @@ func EntryPoint(root *cli.Command) {
 		Type: "bool-set",
 		Help: "Allow rendering of the data sent during tests. Note that modern terminals render asynchronously, so timings do not generally reflect render performance.",
 	})
+	sc.Add(cli.OptionSpec{
+		Name: "--frame-timings",
+		Type: "bool-set",
+		Help: "Enable rendering and report the number of frames rendered per second, the 99th percentile frame time and the total time spent in each stage of rendering for every benchmark. The timings are obtained from kitty with the frame-timings remote control command, so remote control must be enabled.",
+	})
+	sc.Add(cli.OptionSpec{
+		Name: "--replay",
+		Type: "list",
+		Help: "Path to a file containing the output of a real session, as recorded with :option:`kitty --dump-bytes`, to send to the terminal as fast as possible, instead of the synthetic benchmarks. Can be specified multiple times. The synthetic benchmarks are still run if they are specified on the command line.",
+	})
 
 }
@@ -45,7 +45,10 @@ func KittenMain(args ...string) {
 		return 1, fmt.Errorf(":yellow:`%s` is not a known kitten. Use --help to get a list of known kittens.", args[0])
 	}
 
-	tool.KittyToolEntryPoints(root)
+	// completion builds its own command tree for the command line being completed
+	if argv := utils.IfElse(len(args) > 0, args, os.Args); len(argv) < 2 || argv[1] != "__complete__" {
+		tool.KittyToolEntryPoints(root, args...)
+	}
 	completion.EntryPoint(root)
 
 	root.SubCommandIsOptional = true
@@ -4,6 +4,8 @@ package tool
 
 import (
 	"fmt"
+	"os"
+	"strings"
 
 	"github.com/kovidgoyal/kitty/kittens/ask"
 	"github.com/kovidgoyal/kitty/kittens/choose_files"
@@ -39,127 +41,164 @@ import (
 
 var _ = fmt.Print
 
-func KittyToolEntryPoints(root *cli.Command) {
-	root.Add(cli.OptionSpec{
-		Name: "--version", Type: "bool-set", Help: "The current kitten version."})
-	tui.PrepareRootCmd(root)
-	// @
-	at.EntryPoint(root)
-	// update-self
-	update_self.EntryPoint(root)
-	// edit-in-kitty
-	edit_in_kitty.EntryPoint(root)
-	// clipboard
-	clipboard.EntryPoint(root)
-	// icat
-	icat.EntryPoint(root)
-	// ssh
-	ssh.EntryPoint(root)
-	// transfer
-	transfer.EntryPoint(root)
-	// panel
-	panel.EntryPoint(root)
-	// quick_access_terminal
-	quick_access_terminal.EntryPoint(root)
-	// unicode_input
-	unicode_input.EntryPoint(root)
-	// show_key
-	show_key.EntryPoint(root)
-	// desktop_ui
-	desktop_ui.EntryPoint(root)
-	// mouse_demo
-	root.AddSubCommand(&cli.Command{
-		Name:             "mouse-demo",
-		ShortDescription: "Demo the mouse handling kitty implements for terminal programs",
-		OnlyArgsAllowed:  true,
-		Run: func(cmd *cli.Command, args []string) (rc int, err error) {
-			return mouse_demo.Run(args)
-		},
-	})
-	// hyperlinked_grep
-	hyperlinked_grep.EntryPoint(root)
-	// ask
-	ask.EntryPoint(root)
-	// hints
-	hints.EntryPoint(root)
-	// diff
-	diff.EntryPoint(root)
-	// notify
-	notify.EntryPoint(root)
-	// themes
-	themes.EntryPoint(root)
-	themes.ParseEntryPoint(root)
-	// run-shell
-	run_shell.EntryPoint(root)
-	// show_error
-	show_error.EntryPoint(root)
-	// choose-fonts
-	choose_fonts.EntryPoint(root)
-	// choose-files
-	choose_files.EntryPoint(root)
-	// query-terminal
-	query_terminal.EntryPoint(root)
-	// __pytest__
-	pytest.EntryPoint(root)
-	// __hold_till_enter__
-	root.AddSubCommand(&cli.Command{
-		Name:            "__hold_till_enter__",
-		Hidden:          true,
-		OnlyArgsAllowed: true,
-		Run: func(cmd *cli.Command, args []string) (rc int, err error) {
-			tui.ExecAndHoldTillEnter(args)
-			return
-		},
-	})
-	// __shebang__
-	root.AddSubCommand(&cli.Command{
-		Name:            "__shebang__",
-		Hidden:          true,
-		OnlyArgsAllowed: true,
-		Run: func(cmd *cli.Command, args []string) (rc int, err error) {
-			return run_shebang(args)
-		},
-	})
-	// __confirm_and_run_exe__
-	root.AddSubCommand(&cli.Command{
-		Name:            "__confirm_and_run_exe__",
-		Hidden:          true,
-		OnlyArgsAllowed: true,
-		Run: func(cmd *cli.Command, args []string) (rc int, err error) {
-			return confirm_and_run_exe(args)
-		},
-	})
+type entry_point struct {
+	names    []string
+	register func(*cli.Command)
+}
 
-	// __convert_image__
-	images.ConvertEntryPoint(root)
-	// __atexit__
-	atexit.EntryPoint(root)
-	// __width_test__
-	cli.WcswidthKittenEntryPoint(root)
-	// __generate_man_pages__
-	root.AddSubCommand(&cli.Command{
-		Name:            "__generate_man_pages__",
-		Hidden:          true,
-		OnlyArgsAllowed: true,
-		Run: func(cmd *cli.Command, args []string) (rc int, err error) {
-			q := root
-			if len(args) > 0 {
-				for _, scname := range args {
-					sc := q.FindSubCommand(scname)
-					if sc == nil {
-						return 1, fmt.Errorf("No sub command named: %s found", scname)
-					}
-					if err = sc.GenerateManPages(1, true); err != nil {
-						return 1, err
+// provides returns true if name is one of the sub commands this entry point
+// registers. Kittens with underscores in their names are registered under both
+// the underscore and the hyphenated forms, so compare them normalized.
+func (self entry_point) provides(name string) bool {
+	name = strings.ReplaceAll(name, "-", "_")
+	for _, q := range self.names {
+		if q == name || (q == "@" && strings.HasPrefix(name, "@")) {
+			return true
+		}
+	}
+	return false
+}
+
+func simple(f func(*cli.Command) *cli.Command) func(*cli.Command) {
+	return func(root *cli.Command) { f(root) }
+}
+
+func all_entry_points() []entry_point {
+	return []entry_point{
+		{[]string{"@"}, simple(at.EntryPoint)},
+		{[]string{"update_self"}, simple(update_self.EntryPoint)},
+		{[]string{"edit_in_kitty"}, simple(edit_in_kitty.EntryPoint)},
+		{[]string{"clipboard"}, clipboard.EntryPoint},
+		{[]string{"icat"}, icat.EntryPoint},
+		{[]string{"ssh"}, ssh.EntryPoint},
+		{[]string{"transfer"}, transfer.EntryPoint},
+		{[]string{"panel"}, panel.EntryPoint},
+		{[]string{"quick_access_terminal"}, quick_access_terminal.EntryPoint},
+		{[]string{"unicode_input"}, unicode_input.EntryPoint},
+		{[]string{"show_key"}, show_key.EntryPoint},
+		{[]string{"desktop_ui"}, desktop_ui.EntryPoint},
+		{[]string{"mouse_demo"}, func(root *cli.Command) {
+			root.AddSubCommand(&cli.Command{
+				Name:             "mouse-demo",
+				ShortDescription: "Demo the mouse handling kitty implements for terminal programs",
+				OnlyArgsAllowed:  true,
+				Run: func(cmd *cli.Command, args []string) (rc int, err error) {
+					return mouse_demo.Run(args)
+				},
+			})
+		}},
+		{[]string{"hyperlinked_grep"}, hyperlinked_grep.EntryPoint},
+		{[]string{"ask"}, ask.EntryPoint},
+		{[]string{"hints"}, hints.EntryPoint},
+		{[]string{"diff"}, diff.EntryPoint},
+		{[]string{"notify"}, notify.EntryPoint},
+		{[]string{"themes"}, themes.EntryPoint},
+		{[]string{"__parse_theme_metadata__"}, themes.ParseEntryPoint},
+		{[]string{"run_shell"}, simple(run_shell.EntryPoint)},
+		{[]string{"__show_error__"}, simple(show_error.EntryPoint)},
+		{[]string{"choose_fonts"}, choose_fonts.EntryPoint},
+		{[]string{"choose_files"}, choose_files.EntryPoint},
+		{[]string{"query_terminal"}, query_terminal.EntryPoint},
+		{[]string{"__pytest__"}, pytest.EntryPoint},
+		{[]string{"__hold_till_enter__"}, func(root *cli.Command) {
+			root.AddSubCommand(&cli.Command{
+				Name:            "__hold_till_enter__",
+				Hidden:          true,
+				OnlyArgsAllowed: true,
+				Run: func(cmd *cli.Command, args []string) (rc int, err error) {
+					tui.ExecAndHoldTillEnter(args)
+					return
+				},
+			})
+		}},
+		{[]string{"__shebang__"}, func(root *cli.Command) {
+			root.AddSubCommand(&cli.Command{
+				Name:            "__shebang__",
+				Hidden:          true,
+				OnlyArgsAllowed: true,
+				Run: func(cmd *cli.Command, args []string) (rc int, err error) {
+					return run_shebang(args)
+				},
+			})
+		}},
+		{[]string{"__confirm_and_run_exe__"}, func(root *cli.Command) {
+			root.AddSubCommand(&cli.Command{
+				Name:            "__confirm_and_run_exe__",
+				Hidden:          true,
+				OnlyArgsAllowed: true,
+				Run: func(cmd *cli.Command, args []string) (rc int, err error) {
+					return confirm_and_run_exe(args)
+				},
+			})
+		}},
+		{[]string{"__convert_image__"}, images.ConvertEntryPoint},
+		{[]string{"__atexit__"}, atexit.EntryPoint},
+		{[]string{"__width_test__"}, cli.WcswidthKittenEntryPoint},
+		// __generate_man_pages__ walks the full command tree, so it has no
+		// names and is only registered along with everything else
+		{nil, func(root *cli.Command) {
+			root.AddSubCommand(&cli.Command{
+				Name:            "__generate_man_pages__",
+				Hidden:          true,
+				OnlyArgsAllowed: true,
+				Run: func(cmd *cli.Command, args []string) (rc int, err error) {
+					q := root
+					if len(args) > 0 {
+						for _, scname := range args {
+							sc := q.FindSubCommand(scname)
+							if sc == nil {
+								return 1, fmt.Errorf("No sub command named: %s found", scname)
+							}
+							if err = sc.GenerateManPages(1, true); err != nil {
+								return 1, err
+							}
+						}
+					} else {
+						if err = q.GenerateManPages(1, false); err != nil {
+							rc = 1
+						}
 					}
-				}
-			} else {
-				if err = q.GenerateManPages(1, false); err != nil {
-					rc = 1
-				}
+					return
+				},
+			})
+		}},
+		{[]string{"__benchmark__"}, benchmark.EntryPoint},
+	}
+}
+
+// register_entry_points builds the command tree needed to run argv. When argv
+// names a specific kitten, only that kitten's command tree is built, as
+// building the full tree, with every option of every kitten and remote
+// control command, dominates the startup time of short lived invocations such
+// as kitten @ ls. Help for the root command, completion, man page generation
+// and prefix matched kitten names all need the full tree.
+func register_entry_points(root *cli.Command, argv []string) {
+	eps := all_entry_points()
+	if len(argv) > 1 && !strings.HasPrefix(argv[1], "-") {
+		name := argv[1]
+		found := false
+		for _, ep := range eps {
+			if ep.provides(name) {
+				ep.register(root)
+				found = true
 			}
+		}
+		if found && root.FindSubCommand(name) != nil {
 			return
-		},
-	})
-	benchmark.EntryPoint(root)
+		}
+		root.SubCommandGroups = nil
+	}
+	for _, ep := range eps {
+		ep.register(root)
+	}
+}
+
+func KittyToolEntryPoints(root *cli.Command, argv ...string) {
+	root.Add(cli.OptionSpec{
+		Name: "--version", Type: "bool-set", Help: "The current kitten version."})
+	tui.PrepareRootCmd(root)
+	if len(argv) == 0 {
+		argv = os.Args
+	}
+	register_entry_points(root, argv)
 }
@@ -0,0 +1,56 @@
+// License: GPLv3 Copyright: 2025, Kovid Goyal, <kovid at kovidgoyal.net>
+
+package tool
+
+import (
+	"fmt"
+	"testing"
+
+	"github.com/kovidgoyal/kitty/tools/cli"
+)
+
+var _ = fmt.Print
+
+func TestEntryPointNames(t *testing.T) {
+	for _, ep := range all_entry_points() {
+		root := cli.NewRootCommand()
+		ep.register(root)
+		for _, g := range root.SubCommandGroups {
+			for _, sc := range g.SubCommands {
+				if ep.names != nil && !ep.provides(sc.Name) {
+					t.Fatalf("The entry point for %v registers the sub command %#v that it does not declare", ep.names, sc.Name)
+				}
+			}
+		}
+	}
+	for _, argv := range [][]string{{"kitten", "@", "ls"}, {"kitten", "@ls"}, {"kitten", "icat", "--help"}, {"kitten", "quick-access-terminal"}} {
+		root := cli.NewRootCommand()
+		register_entry_points(root, argv)
+		if root.FindSubCommand(argv[1]) == nil {
+			t.Fatalf("No sub command found for: %v", argv)
+		}
+		if root.FindSubCommand("diff") != nil {
+			t.Fatalf("The full command tree was built for: %v", argv)
+		}
+	}
+	root := cli.NewRootCommand()
+	register_entry_points(root, []string{"kitten", "--help"})
+	if root.FindSubCommand("diff") == nil || root.FindSubCommand("__generate_man_pages__") == nil {
+		t.Fatalf("The full command tree was not built for kitten --help")
+	}
+}
+
+func benchmark_startup(b *testing.B, argv ...string) {
+	argv = append([]string{"kitten"}, argv...)
+	for i := 0; i < b.N; i++ {
+		root := cli.NewRootCommand()
+		KittyToolEntryPoints(root, argv...)
+		if _, err := root.ParseArgs(argv); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkStartupAtLs(b *testing.B)     { benchmark_startup(b, "@", "ls") }
+func BenchmarkStartupIcatHelp(b *testing.B) { benchmark_startup(b, "icat", "--help") }
+func BenchmarkStartupFullTree(b *testing.B) { benchmark_startup(b, "--help") }
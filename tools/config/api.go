@@ -46,6 +46,7 @@ type ConfigParser struct {
 	bad_lines     []ConfigLine
 	seen_includes map[string]bool
 	override_env  []string
+	recorder      *config_cache_recorder
 }
 
 type Scanner interface {
@@ -143,6 +144,12 @@ func (self *ConfigParser) parse(scanner Scanner, name, base_path_for_includes st
 	add_bad_line := func(err error) {
 		self.bad_lines = append(self.bad_lines, ConfigLine{Src_file: name, Line: line, Line_number: lnum, Err: err})
 	}
+	add_invalid_line := func(err error) {
+		add_bad_line(err)
+		if self.recorder != nil {
+			self.recorder.entry.Events = append(self.recorder.entry.Events, parse_event{Src_file: name, Line: line, Line_number: lnum, Err: err.Error()})
+		}
+	}
 
 	for {
 		if next_line != "" {
@@ -186,7 +193,7 @@ func (self *ConfigParser) parse(scanner Scanner, name, base_path_for_includes st
 		}
 		m := key_pat().FindStringSubmatch(line)
 		if len(m) < 3 {
-			add_bad_line(fmt.Errorf("Invalid config line: %#v", line))
+			add_invalid_line(fmt.Errorf("Invalid config line: %#v", line))
 			continue
 		}
 		key, val := m[1], m[2]
@@ -199,30 +206,44 @@ func (self *ConfigParser) parse(scanner Scanner, name, base_path_for_includes st
 		}
 		switch key {
 		default:
+			if self.recorder != nil {
+				self.recorder.entry.Events = append(self.recorder.entry.Events, parse_event{Key: key, Val: val, Src_file: name, Line: line, Line_number: lnum})
+			}
 			if err := self.LineHandler(key, val); err != nil {
 				add_bad_line(err)
 			}
 		case "include", "globinclude", "envinclude", "geninclude":
 			var includes []string
+			if self.recorder != nil && (key == "geninclude" || key == "envinclude" || strings.Contains(val, "$")) {
+				// the result depends on more than the contents of files
+				self.recorder.uncacheable = true
+			}
 			val = ExpandVars(val)
 			switch key {
 			case "include":
 				if aval, err := make_absolute(val); err == nil {
 					includes = []string{aval}
 				} else {
-					add_bad_line(err)
+					add_invalid_line(err)
 				}
 			case "globinclude":
 				aval, err := make_absolute(val)
 				if err == nil {
+					if self.recorder != nil {
+						if dir := filepath.Dir(aval); strings.ContainsAny(dir, "*?[") {
+							self.recorder.uncacheable = true
+						} else {
+							self.recorder.add_source(dir)
+						}
+					}
 					matches, err := filepath.Glob(aval)
 					if err == nil {
 						includes = matches
 					} else {
-						add_bad_line(err)
+						add_invalid_line(err)
 					}
 				} else {
-					add_bad_line(err)
+					add_invalid_line(err)
 				}
 			case "geninclude":
 				if aval, err := make_absolute(val); err == nil {
@@ -231,10 +252,10 @@ func (self *ConfigParser) parse(scanner Scanner, name, base_path_for_includes st
 							return err
 						}
 					} else {
-						add_bad_line(err)
+						add_invalid_line(err)
 					}
 				} else {
-					add_bad_line(err)
+					add_invalid_line(err)
 				}
 			case "envinclude":
 				env := utils.IfElse(self.override_env == nil, os.Environ(), self.override_env)
@@ -251,12 +272,15 @@ func (self *ConfigParser) parse(scanner Scanner, name, base_path_for_includes st
 			}
 			if len(includes) > 0 {
 				for _, incpath := range includes {
+					if self.recorder != nil {
+						self.recorder.add_source(incpath)
+					}
 					if raw, err := os.ReadFile(incpath); err == nil {
 						if err := recurse(bytes.NewReader(raw), incpath, filepath.Dir(incpath)); err != nil {
 							return err
 						}
 					} else if !errors.Is(err, fs.ErrNotExist) {
-						add_bad_line(err)
+						add_invalid_line(err)
 					}
 				}
 			}
@@ -271,16 +295,31 @@ func (self *ConfigParser) ParseFiles(paths ...string) error {
 		if err == nil {
 			path = apath
 		}
+		use_cache := self.can_use_cache()
+		if use_cache {
+			if entry := load_cached_config(path); entry != nil {
+				self.replay(entry)
+				continue
+			}
+			self.recorder = &config_cache_recorder{}
+			self.recorder.add_source(path)
+		}
 		raw, err := os.ReadFile(path)
 		if err != nil {
+			self.recorder = nil
 			return err
 		}
 		scanner := utils.NewLineScanner(utils.UnsafeBytesToString(raw))
 		self.seen_includes = make(map[string]bool)
 		err = self.parse(scanner, path, filepath.Dir(path), 0)
+		recorder := self.recorder
+		self.recorder = nil
 		if err != nil {
 			return err
 		}
+		if recorder != nil {
+			recorder.save(path)
+		}
 		if self.SourceHandler != nil {
 			self.SourceHandler(utils.UnsafeBytesToString(raw), path)
 		}
@@ -80,3 +80,50 @@ geninclude g.py
 		t.Fatalf("Unexpected bad lines:\n%s", diff)
 	}
 }
+
+func TestConfigCache(t *testing.T) {
+	tdir := t.TempDir()
+	orig := config_cache_dir
+	config_cache_dir = func() string { return filepath.Join(tdir, "cache") }
+	defer func() { config_cache_dir = orig }()
+	w := func(path string, data string) {
+		if err := os.WriteFile(filepath.Join(tdir, path), []byte(data), 0o600); err != nil {
+			t.Fatal(err)
+		}
+	}
+	w("a.conf", "a one\ninclude b.conf\nbadline\nerror x\nglobinclude g*.conf")
+	w("b.conf", "b two")
+	parse := func(expected ...string) {
+		var parsed_lines []string
+		p := ConfigParser{LineHandler: func(key, val string) error {
+			if key == "error" {
+				return fmt.Errorf("%s", val)
+			}
+			parsed_lines = append(parsed_lines, key+" "+val)
+			return nil
+		}}
+		if err := p.ParseFiles(filepath.Join(tdir, "a.conf")); err != nil {
+			t.Fatal(err)
+		}
+		if diff := cmp.Diff(expected, parsed_lines); diff != "" {
+			t.Fatalf("Unexpected parsed config values:\n%s", diff)
+		}
+		bad_lines := []string{}
+		for _, bl := range p.BadLines() {
+			bad_lines = append(bad_lines, fmt.Sprintf("%s: %d", filepath.Base(bl.Src_file), bl.Line_number))
+		}
+		if diff := cmp.Diff([]string{"a.conf: 3", "a.conf: 4"}, bad_lines); diff != "" {
+			t.Fatalf("Unexpected bad lines:\n%s", diff)
+		}
+	}
+	parse("a one", "b two")
+	if _, err := os.Stat(config_cache_path(filepath.Join(tdir, "a.conf"))); err != nil {
+		t.Fatalf("Config parse results were not cached: %s", err)
+	}
+	parse("a one", "b two")
+	w("b.conf", "b changed")
+	parse("a one", "b changed")
+	w("g1.conf", "g one")
+	parse("a one", "b changed", "g one")
+	parse("a one", "b changed", "g one")
+}
@@ -0,0 +1,127 @@
+// License: GPLv3 Copyright: 2025, Kovid Goyal, <kovid at kovidgoyal.net>
+
+package config
+
+import (
+	"bytes"
+	"crypto/sha256"
+	"encoding/hex"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io/fs"
+	"os"
+	"path/filepath"
+
+	"github.com/kovidgoyal/kitty/tools/utils"
+)
+
+var _ = fmt.Print
+
+// The results of parsing a config file, along with all the files it includes,
+// are cached so that kittens, which all read their config files and often
+// kitty.conf at startup, do not have to parse them again when nothing has
+// changed. The cache stores the sequence of key/value pairs and bad lines the
+// parse produced, which is replayed through LineHandler, so it is independent
+// of what any particular kitten does with the values.
+
+var config_cache_dir = func() string { return filepath.Join(utils.CacheDir(), "config-cache") }
+
+type source_stamp struct {
+	Path   string `json:"path"`
+	Exists bool   `json:"exists"`
+	Mtime  int64  `json:"mtime"`
+	Size   int64  `json:"size"`
+}
+
+func new_source_stamp(path string) (ans source_stamp, err error) {
+	ans.Path = path
+	s, err := os.Stat(path)
+	if err != nil {
+		if errors.Is(err, fs.ErrNotExist) {
+			err = nil
+		}
+		return
+	}
+	ans.Exists, ans.Mtime, ans.Size = true, s.ModTime().UnixNano(), s.Size()
+	return
+}
+
+type parse_event struct {
+	Key         string `json:"key,omitempty"`
+	Val         string `json:"val,omitempty"`
+	Src_file    string `json:"src,omitempty"`
+	Line        string `json:"line,omitempty"`
+	Line_number int    `json:"num,omitempty"`
+	// Set for lines that failed to parse, as opposed to lines rejected by LineHandler
+	Err string `json:"err,omitempty"`
+}
+
+type config_cache_entry struct {
+	Sources []source_stamp `json:"sources"`
+	Events  []parse_event  `json:"events"`
+}
+
+type config_cache_recorder struct {
+	entry       config_cache_entry
+	uncacheable bool
+}
+
+func (self *config_cache_recorder) add_source(path string) {
+	if s, err := new_source_stamp(path); err == nil {
+		self.entry.Sources = append(self.entry.Sources, s)
+	} else {
+		self.uncacheable = true
+	}
+}
+
+func config_cache_path(path string) string {
+	h := sha256.Sum256(utils.UnsafeStringToBytes(path))
+	return filepath.Join(config_cache_dir(), hex.EncodeToString(h[:16])+".json")
+}
+
+func (self *ConfigParser) can_use_cache() bool {
+	// these handlers need the raw text which is not cached and override_env
+	// is used only in tests
+	return self.CommentsHandler == nil && self.SourceHandler == nil && self.override_env == nil
+}
+
+func load_cached_config(path string) *config_cache_entry {
+	raw, err := os.ReadFile(config_cache_path(path))
+	if err != nil {
+		return nil
+	}
+	var ans config_cache_entry
+	if err = json.Unmarshal(raw, &ans); err != nil || len(ans.Sources) == 0 || ans.Sources[0].Path != path {
+		return nil
+	}
+	for _, s := range ans.Sources {
+		if q, err := new_source_stamp(s.Path); err != nil || q != s {
+			return nil
+		}
+	}
+	return &ans
+}
+
+func (self *config_cache_recorder) save(path string) {
+	if self.uncacheable {
+		return
+	}
+	raw, err := json.Marshal(&self.entry)
+	if err != nil {
+		return
+	}
+	if err = os.MkdirAll(config_cache_dir(), 0o755); err == nil {
+		_ = utils.AtomicUpdateFile(config_cache_path(path), bytes.NewReader(raw), 0o600)
+	}
+}
+
+func (self *ConfigParser) replay(entry *config_cache_entry) {
+	for _, ev := range entry.Events {
+		if ev.Err != "" {
+			self.bad_lines = append(self.bad_lines, ConfigLine{Src_file: ev.Src_file, Line: ev.Line, Line_number: ev.Line_number, Err: errors.New(ev.Err)})
+		} else if err := self.LineHandler(ev.Key, ev.Val); err != nil {
+			self.bad_lines = append(self.bad_lines, ConfigLine{Src_file: ev.Src_file, Line: ev.Line, Line_number: ev.Line_number, Err: err})
+		}
+	}
+}
@@ -12,6 +12,7 @@ import (
 	"fmt"
 	"strconv"
 	"strings"
+	"sync"
 	"time"
 
 	"github.com/kovidgoyal/kitty/tools/utils"
@@ -54,12 +55,8 @@ func b85_decode(data string) (decoded []byte, err error) {
 	return
 }
 
-func encrypt(plaintext []byte, alice_public_key []byte, encryption_protocol string) (iv []byte, tag []byte, ciphertext []byte, bob_public_key []byte, err error) {
-	bob_private_key, bob_public_key, err := KeyPair(encryption_protocol)
-	if err != nil {
-		return
-	}
-	shared_secret_raw, err := curve25519_derive_shared_secret(bob_private_key, alice_public_key)
+func new_aead(private_key []byte, other_public_key []byte) (aead cipher.AEAD, err error) {
+	shared_secret_raw, err := curve25519_derive_shared_secret(private_key, other_public_key)
 	if err != nil {
 		return
 	}
@@ -69,10 +66,10 @@ func encrypt(plaintext []byte, alice_public_key []byte, encryption_protocol stri
 	if err != nil {
 		return
 	}
-	aesgcm, err := cipher.NewGCM(block)
-	if err != nil {
-		return
-	}
+	return cipher.NewGCM(block)
+}
+
+func seal(aesgcm cipher.AEAD, plaintext []byte) (iv []byte, tag []byte, ciphertext []byte, err error) {
 	iv = make([]byte, aesgcm.NonceSize())
 	_, err = rand.Read(iv)
 	if err != nil {
@@ -84,6 +81,19 @@ func encrypt(plaintext []byte, alice_public_key []byte, encryption_protocol stri
 	return
 }
 
+func encrypt(plaintext []byte, alice_public_key []byte, encryption_protocol string) (iv []byte, tag []byte, ciphertext []byte, bob_public_key []byte, err error) {
+	bob_private_key, bob_public_key, err := KeyPair(encryption_protocol)
+	if err != nil {
+		return
+	}
+	aesgcm, err := new_aead(bob_private_key, alice_public_key)
+	if err != nil {
+		return
+	}
+	iv, tag, ciphertext, err = seal(aesgcm, plaintext)
+	return
+}
+
 func KeyPair(encryption_protocol string) (private_key []byte, public_key []byte, err error) {
 	switch encryption_protocol {
 	case "1":
@@ -130,6 +140,69 @@ func Encrypt_cmd(cmd *utils.RemoteControlCmd, password string, other_pubkey []by
 	return
 }
 
+// SessionLifetime is how long a Session reuses its ephemeral key pair
+const SessionLifetime = time.Minute
+
+// A Session encrypts a sequence of remote control commands sent to one kitty
+// instance. Rather than generating a fresh key pair and deriving a fresh shared
+// secret for every command, as Encrypt_cmd does, it reuses them for
+// SessionLifetime, after which a new key pair is generated. kitty caches the
+// secrets it derives for such keys and requires the timestamps of commands
+// encrypted with them to be strictly increasing, which Session guarantees.
+type Session struct {
+	other_pubkey        []byte
+	encryption_protocol string
+
+	mutex          sync.Mutex
+	encoded_pubkey string
+	aead           cipher.AEAD
+	created_at     time.Time
+	last_timestamp int64
+}
+
+func NewSession(other_pubkey []byte, encryption_protocol string) *Session {
+	return &Session{other_pubkey: other_pubkey, encryption_protocol: encryption_protocol}
+}
+
+func (self *Session) ensure_key(now time.Time) (err error) {
+	if self.aead != nil && now.Sub(self.created_at) < SessionLifetime {
+		return
+	}
+	private_key, public_key, err := KeyPair(self.encryption_protocol)
+	if err != nil {
+		return
+	}
+	if self.aead, err = new_aead(private_key, self.other_pubkey); err != nil {
+		return
+	}
+	self.encoded_pubkey = b85_encode(public_key)
+	self.created_at = now
+	return
+}
+
+func (self *Session) Encrypt_cmd(cmd *utils.RemoteControlCmd, password string) (encrypted_cmd utils.EncryptedRemoteControlCmd, err error) {
+	self.mutex.Lock()
+	defer self.mutex.Unlock()
+	now := time.Now()
+	if err = self.ensure_key(now); err != nil {
+		return
+	}
+	cmd.Password = password
+	cmd.Timestamp = max(now.UnixNano(), self.last_timestamp+1)
+	self.last_timestamp = cmd.Timestamp
+	plaintext, err := json.Marshal(cmd)
+	if err != nil {
+		return
+	}
+	iv, tag, ciphertext, err := seal(self.aead, plaintext)
+	encrypted_cmd = utils.EncryptedRemoteControlCmd{
+		Version: cmd.Version, IV: b85_encode(iv), Tag: b85_encode(tag), Pubkey: self.encoded_pubkey, Encrypted: b85_encode(ciphertext)}
+	if self.encryption_protocol != "1" {
+		encrypted_cmd.EncProto = self.encryption_protocol
+	}
+	return
+}
+
 func Encrypt_data(data []byte, other_pubkey []byte, encryption_protocol string) (ans []byte, err error) {
 	d := make([]byte, 0, uint64(len(data))+32)
 	d = fmt.Appendf(d, "%s:", strconv.FormatInt(time.Now().UnixNano(), 10))
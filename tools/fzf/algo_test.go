@@ -188,3 +188,16 @@ func TestFZFAlgo(t *testing.T) {
 	}
 	simple(strings.Join(items, "\n"), "2", expected...)
 }
+
+func TestFZFLongItems(t *testing.T) {
+	// the score matrix for these is larger than the initial slab size
+	m := NewFuzzyMatcher(PATH_SCHEME)
+	items := []string{strings.Repeat("ab/", 1000), "short", strings.Repeat("xyz", 2000) + "ab"}
+	r, err := m.Score(items, "abababab")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if r[0].Score == 0 || r[1].Score != 0 || r[2].Score != 0 {
+		t.Fatalf("Unexpected scores: %v", r)
+	}
+}
@@ -281,7 +281,7 @@ func (s *slab) reset() {
 }
 
 func (s *slab) alloc16(sz int) []int16 {
-	if sz+s.i16_used < len(s.i16) {
+	if sz+s.i16_used > len(s.i16) {
 		s.i16 = make([]int16, max(slab_initial_size, 2*(s.i16_used+sz)))
 		s.i16_used = 0
 	}
@@ -291,7 +291,7 @@ func (s *slab) alloc16(sz int) []int16 {
 }
 
 func (s *slab) alloc32(sz int) []int32 {
-	if sz+s.i32_used < len(s.i32) {
+	if sz+s.i32_used > len(s.i32) {
 		s.i32 = make([]int32, max(slab_initial_size, 2*(s.i32_used+sz)))
 		s.i32_used = 0
 	}
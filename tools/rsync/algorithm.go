@@ -15,8 +15,11 @@ import (
 	"fmt"
 	"hash"
 	"io"
+	"math/bits"
+	"runtime"
 	"slices"
 	"strconv"
+	"sync"
 
 	"github.com/zeebo/xxh3"
 )
@@ -235,39 +238,97 @@ func (r *rsync) BlockHashCount(targetLength int64) (count int64) {
 	return
 }
 
+// Blocks are read in batches that are split into stripes hashed in parallel.
+// The batch size starts small, so that small targets do not allocate much, and
+// doubles up to max_signature_batch_blocks per worker.
+const min_signature_blocks_per_worker = 16
+const max_signature_batch_blocks = 64
+
 type signature_iterator struct {
-	hasher hash.Hash64
-	buffer []byte
-	src    io.Reader
-	rc     rolling_checksum
-	index  uint64
+	hashers       []hash.Hash64
+	block_size    int
+	batch_blocks  int
+	buffer        []byte
+	src           io.Reader
+	src_exhausted bool
+	index         uint64
+	hashes        []BlockHash
+	pos           int
 }
 
-// ans is valid iff err == nil
-func (self *signature_iterator) next() (ans BlockHash, err error) {
-	n, err := io.ReadAtLeast(self.src, self.buffer, cap(self.buffer))
+func (self *signature_iterator) hash_blocks(data []byte, hashes []BlockHash, first_index uint64, hasher hash.Hash64) {
+	var rc rolling_checksum
+	for i := range hashes {
+		b := data[i*self.block_size : min((i+1)*self.block_size, len(data))]
+		hasher.Reset()
+		hasher.Write(b)
+		hashes[i] = BlockHash{Index: first_index + uint64(i), WeakHash: rc.full(b), StrongHash: hasher.Sum64()}
+	}
+}
+
+func (self *signature_iterator) fill() (err error) {
+	if sz := self.batch_blocks * self.block_size; len(self.buffer) < sz {
+		self.buffer = make([]byte, sz)
+	}
+	n, err := io.ReadAtLeast(self.src, self.buffer, len(self.buffer))
 	switch err {
 	case io.ErrUnexpectedEOF, io.EOF, nil:
 		err = nil
 	default:
 		return
 	}
-	if n == 0 {
-		return ans, io.EOF
+	self.src_exhausted = n < len(self.buffer)
+	data := self.buffer[:n]
+	num_blocks := (n + self.block_size - 1) / self.block_size
+	self.hashes = slices.Grow(self.hashes[:0], num_blocks)[:num_blocks]
+	self.pos = 0
+	num_workers := max(1, min(len(self.hashers), num_blocks/min_signature_blocks_per_worker))
+	if num_workers < 2 {
+		self.hash_blocks(data, self.hashes, self.index, self.hashers[0])
+	} else {
+		per_worker := (num_blocks + num_workers - 1) / num_workers
+		var wg sync.WaitGroup
+		for w, start := 0, 0; start < num_blocks; w, start = w+1, start+per_worker {
+			end := min(start+per_worker, num_blocks)
+			wg.Add(1)
+			go func(w, start, end int) {
+				defer wg.Done()
+				self.hash_blocks(data[start*self.block_size:], self.hashes[start:end], self.index+uint64(start), self.hashers[w])
+			}(w, start, end)
+		}
+		wg.Wait()
 	}
-	b := self.buffer[:n]
-	self.hasher.Reset()
-	self.hasher.Write(b)
-	ans = BlockHash{Index: self.index, WeakHash: self.rc.full(b), StrongHash: self.hasher.Sum64()}
-	self.index++
+	self.index += uint64(num_blocks)
+	self.batch_blocks = min(2*self.batch_blocks, max_signature_batch_blocks*len(self.hashers))
 	return
+}
 
+// ans is valid iff err == nil
+func (self *signature_iterator) next() (ans BlockHash, err error) {
+	if self.pos >= len(self.hashes) {
+		if self.src_exhausted {
+			return ans, io.EOF
+		}
+		if err = self.fill(); err != nil {
+			return
+		}
+		if len(self.hashes) == 0 {
+			return ans, io.EOF
+		}
+	}
+	ans = self.hashes[self.pos]
+	self.pos++
+	return
 }
 
 // Calculate the signature of target.
 func (r *rsync) CreateSignatureIterator(target io.Reader) func() (BlockHash, error) {
+	hashers := make([]hash.Hash64, max(1, runtime.GOMAXPROCS(0)))
+	for i := range hashers {
+		hashers[i] = r.hasher_constructor()
+	}
 	return (&signature_iterator{
-		hasher: r.hasher_constructor(), buffer: make([]byte, r.BlockSize), src: target,
+		hashers: hashers, block_size: r.BlockSize, batch_blocks: min_signature_blocks_per_worker, src: target,
 	}).next
 }
 
@@ -364,6 +425,7 @@ type diff struct {
 	op_write_buf [32]byte
 	// A single β hash may correlate with many unique hashes.
 	hash_lookup map[uint32][]BlockHash
+	weak_hashes weak_hash_filter
 	source      io.Reader
 	hasher      hash.Hash64
 	checksummer hash.Hash
@@ -529,6 +591,57 @@ func (self *diff) finish_up() (err error) {
 	return
 }
 
+// A bitset of the weak hashes in the signature, used to skip the map lookup
+// for most window positions in data that does not match any block
+type weak_hash_filter struct {
+	bits  []uint64
+	shift uint
+}
+
+func new_weak_hash_filter(signature []BlockHash) (ans weak_hash_filter) {
+	num_bits := 64
+	for num_bits < 16*len(signature) && num_bits < 1<<26 {
+		num_bits *= 2
+	}
+	ans.bits = make([]uint64, num_bits/64)
+	ans.shift = uint(32 - bits.TrailingZeros(uint(num_bits)))
+	for _, h := range signature {
+		i := ans.index(h.WeakHash)
+		ans.bits[i/64] |= 1 << (i % 64)
+	}
+	return
+}
+
+func (self weak_hash_filter) index(weak_hash uint32) uint32 {
+	// a multiplicative hash, as the low bits of the rolling checksum are not well distributed
+	return (weak_hash * 0x9e3779b1) >> self.shift
+}
+
+func (self weak_hash_filter) may_contain(weak_hash uint32) bool {
+	i := self.index(weak_hash)
+	return self.bits[i/64]&(1<<(i%64)) != 0
+}
+
+func (self *diff) match_window() (found bool, err error) {
+	if !self.weak_hashes.may_contain(self.rc.val) {
+		return
+	}
+	var block_index uint64
+	if hh, ok := self.hash_lookup[self.rc.val]; ok {
+		block_index, found = find_hash(hh, self.hash(self.buffer[self.window.pos:self.window.pos+self.window.sz]))
+	}
+	if found {
+		if err = self.send_data(); err != nil {
+			return
+		}
+		self.enqueue(Operation{Type: OpBlock, BlockIndex: block_index})
+		self.window.pos += self.window.sz
+		self.data.pos = self.window.pos
+		self.window.sz = 0
+	}
+	return
+}
+
 // See https://rsync.samba.org/tech_report/node4.html for the design of this algorithm
 func (self *diff) read_next() (err error) {
 	if self.window.sz > 0 {
@@ -538,34 +651,27 @@ func (self *diff) read_next() (err error) {
 			}
 			return self.finish_up()
 		}
-		self.window.pos++
-		self.data.sz++
-		self.rc.add_one_byte(self.buffer[self.window.pos], self.buffer[self.window.pos+self.window.sz-1])
-	} else {
-		if ok, err := self.ensure_idx_valid(self.window.pos + self.block_size - 1); !ok {
-			if err != nil {
+		// roll the window over all the bytes that have already been read
+		for self.window.pos+self.window.sz < len(self.buffer) {
+			self.window.pos++
+			self.data.sz++
+			self.rc.add_one_byte(self.buffer[self.window.pos], self.buffer[self.window.pos+self.window.sz-1])
+			if found, err := self.match_window(); found || err != nil {
 				return err
 			}
-			return self.finish_up()
 		}
-		self.window.sz = self.block_size
-		self.rc.full(self.buffer[self.window.pos : self.window.pos+self.window.sz])
+		return nil
 	}
-	found_hash := false
-	var block_index uint64
-	if hh, ok := self.hash_lookup[self.rc.val]; ok {
-		block_index, found_hash = find_hash(hh, self.hash(self.buffer[self.window.pos:self.window.pos+self.window.sz]))
-	}
-	if found_hash {
-		if err = self.send_data(); err != nil {
-			return
+	if ok, err := self.ensure_idx_valid(self.window.pos + self.block_size - 1); !ok {
+		if err != nil {
+			return err
 		}
-		self.enqueue(Operation{Type: OpBlock, BlockIndex: block_index})
-		self.window.pos += self.window.sz
-		self.data.pos = self.window.pos
-		self.window.sz = 0
+		return self.finish_up()
 	}
-	return nil
+	self.window.sz = self.block_size
+	self.rc.full(self.buffer[self.window.pos : self.window.pos+self.window.sz])
+	_, err = self.match_window()
+	return
 }
 
 type OperationWriter struct {
@@ -617,6 +723,7 @@ func (r *rsync) CreateDiff(source io.Reader, signature []BlockHash, output io.Wr
 		hash_lookup: make(map[uint32][]BlockHash, len(signature)),
 		source:      source, hasher: r.hasher_constructor(),
 		checksummer: r.checksummer_constructor(), output: output,
+		weak_hashes: new_weak_hash_filter(signature),
 	}
 	for _, h := range signature {
 		key := h.WeakHash
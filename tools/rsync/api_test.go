@@ -194,3 +194,37 @@ func TestRsyncHashers(t *testing.T) {
 		t.Fatalf("%s", diff)
 	}
 }
+
+func TestRsyncSignatureBatches(t *testing.T) {
+	p := NewPatcher(0)
+	p.rsync.BlockSize = 13
+	for _, sz := range []int{0, 1, 13, 13 * 16, 13*16 + 5, 13*1000 + 7} {
+		data := make([]byte, sz)
+		for i := range data {
+			data[i] = byte(i * 7 % 251)
+		}
+		var expected []BlockHash
+		var rc rolling_checksum
+		h := p.rsync.hasher_constructor()
+		for i := 0; i*13 < sz; i++ {
+			b := data[i*13 : min(sz, (i+1)*13)]
+			h.Reset()
+			h.Write(b)
+			expected = append(expected, BlockHash{Index: uint64(i), WeakHash: rc.full(b), StrongHash: h.Sum64()})
+		}
+		var actual []BlockHash
+		it := p.rsync.CreateSignatureIterator(bytes.NewReader(data))
+		for {
+			s, err := it()
+			if err == io.EOF {
+				break
+			} else if err != nil {
+				t.Fatal(err)
+			}
+			actual = append(actual, s)
+		}
+		if diff := cmp.Diff(expected, actual); diff != "" {
+			t.Fatalf("Signature of %d bytes differs:\n%s", sz, diff)
+		}
+	}
+}
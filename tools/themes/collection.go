@@ -539,6 +539,7 @@ type Theme struct {
 
 	code                        string
 	settings                    map[string]string
+	escape_codes                string
 	zip_reader                  *zip.File
 	is_user_defined             bool
 	path_for_user_defined_theme string
@@ -621,7 +622,8 @@ func (self *Theme) SaveInConf(config_dir, reload_in, config_file_name string) (e
 }
 
 func (self *Theme) Settings() (map[string]string, error) {
-	if self.zip_reader != nil {
+	// parsed at most once, even if Code() has already consumed zip_reader
+	if self.settings == nil && !self.is_user_defined {
 		code, err := self.load_code()
 		if err != nil {
 			return nil, err
@@ -641,12 +643,17 @@ func (self *Theme) Settings() (map[string]string, error) {
 	return self.settings, nil
 }
 
+// The escape codes are re-sent every time the selected theme changes, so
+// cache them rather than re-generating them from the settings each time
 func (self *Theme) AsEscapeCodes() (string, error) {
-	settings, err := self.Settings()
-	if err != nil {
-		return "", err
+	if self.escape_codes == "" {
+		settings, err := self.Settings()
+		if err != nil {
+			return "", err
+		}
+		self.escape_codes = ColorSettingsAsEscapeCodes(settings)
 	}
-	return ColorSettingsAsEscapeCodes(settings), nil
+	return self.escape_codes, nil
 }
 
 func ColorSettingsAsEscapeCodes(settings map[string]string) string {
@@ -923,8 +930,48 @@ func GetThemeNames(cache_age time.Duration) (ans []string, err error) {
 	return
 }
 
-func CompleteThemes(completions *cli.Completions, word string, arg_num int) {
+// theme_names_cache_key changes whenever the set of themes that
+// GetThemeNames() would return could have changed
+func theme_names_cache_key() string {
+	var key strings.Builder
+	add := func(path string) {
+		if s, err := os.Stat(path); err == nil {
+			fmt.Fprintf(&key, "%s:%d:%d ", filepath.Base(path), s.ModTime().UnixNano(), s.Size())
+		}
+	}
+	add(filepath.Join(utils.CacheDir(), "kitty-themes.zip"))
+	user_themes := filepath.Join(utils.ConfigDir(), "themes")
+	add(user_themes)
+	if entries, err := os.ReadDir(user_themes); err == nil {
+		for _, e := range entries {
+			if !e.IsDir() && strings.HasSuffix(e.Name(), ".conf") {
+				add(filepath.Join(user_themes, e.Name()))
+			}
+		}
+	}
+	return key.String()
+}
+
+// cached_theme_names is used for completion, where parsing every theme in the
+// themes zip file on every key press is too slow. The names are cached in a
+// file along with a key that is invalidated when any theme source changes.
+func cached_theme_names() ([]string, error) {
+	cache_path := filepath.Join(utils.CacheDir(), "kitty-theme-names.txt")
+	key := theme_names_cache_key()
+	if data, err := os.ReadFile(cache_path); err == nil {
+		if k, names, found := strings.Cut(utils.UnsafeBytesToString(data), "\n"); found && k == key {
+			return strings.Split(names, "\n"), nil
+		}
+	}
 	names, err := GetThemeNames(-1)
+	if err == nil {
+		_ = utils.AtomicUpdateFile(cache_path, strings.NewReader(key+"\n"+strings.Join(names, "\n")), 0o644)
+	}
+	return names, err
+}
+
+func CompleteThemes(completions *cli.Completions, word string, arg_num int) {
+	names, err := cached_theme_names()
 	if err == nil {
 		mg := completions.AddMatchGroup("Themes")
 		for _, theme_name := range names {
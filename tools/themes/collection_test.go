@@ -79,7 +79,7 @@ func TestThemeCollections(t *testing.T) {
 		t.Fatal(err)
 	}
 	fw, _ = zw.Create("x/themes/Alabaster_Dark.conf")
-	if _, err := fw.Write([]byte("alabaster")); err != nil {
+	if _, err := fw.Write([]byte("alabaster\nbackground #000000")); err != nil {
 		t.Fatal(err)
 	}
 	zw.Close()
@@ -156,10 +156,13 @@ func TestThemeCollections(t *testing.T) {
 		}
 		t.Fatal("failed to load code for empty theme")
 	}
-	if code, err := coll.ThemeByName("Alabaster Dark").load_code(); code != "alabaster" {
+	if code, err := coll.ThemeByName("Alabaster Dark").load_code(); code != "alabaster\nbackground #000000" {
 		if err != nil {
 			t.Fatal(err)
 		}
 		t.Fatal("failed to load code for alabaster theme")
 	}
+	if settings, err := coll.ThemeByName("Alabaster Dark").Settings(); err != nil || settings["background"] != "#000000" {
+		t.Fatalf("failed to parse settings after loading code for alabaster theme: %#v %v", settings, err)
+	}
 }
@@ -5,7 +5,6 @@ package graphics
 import (
 	"bytes"
 	"compress/zlib"
-	"encoding/base64"
 	"fmt"
 	"io"
 	"strconv"
@@ -272,7 +271,7 @@ func (self *GraphicsCommand) WriteWithPayloadTo(o io.StringWriter, payload []byt
 		return self.serialize_to(o, "")
 	}
 	if len(payload) <= compression_threshold {
-		return self.serialize_to(o, base64.RawStdEncoding.EncodeToString(payload))
+		return self.serialize_to(o, utils.Base64EncodeRawToString(payload))
 	}
 	gc := *self
 	if !self.DisableCompression && self.Format() != GRT_format_png {
@@ -283,7 +282,7 @@ func (self *GraphicsCommand) WriteWithPayloadTo(o io.StringWriter, payload []byt
 		}
 	}
 	const chunk_size = 128 * 1024
-	data := base64.RawStdEncoding.EncodeToString(payload)
+	data := utils.Base64EncodeRawToString(payload)
 	for len(data) > 0 && err == nil {
 		chunk := data
 		if len(data) > chunk_size {
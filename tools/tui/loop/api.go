@@ -3,7 +3,6 @@
 package loop
 
 import (
-	"encoding/base64"
 	"encoding/hex"
 	"fmt"
 	"os"
@@ -315,7 +314,7 @@ func (self *Loop) DebugPrintln(args ...any) {
 		for i := 0; i < len(msg); i += limit {
 			end := min(i+limit, len(msg))
 			self.QueueWriteString("\x1bP@kitty-print|")
-			self.QueueWriteString(base64.StdEncoding.EncodeToString([]byte(msg[i:end])))
+			self.QueueWriteString(utils.Base64EncodeToString(utils.UnsafeStringToBytes(msg[i:end])))
 			self.QueueWriteString("\x1b\\")
 		}
 	}
@@ -509,7 +508,7 @@ func (self *Loop) SetDefaultColor(which DefaultColor, val style.RGBA) {
 
 func (self *Loop) copy_text_to(text, dest string) {
 	self.QueueWriteString("\x1b]52;" + dest + ";")
-	self.QueueWriteString(base64.StdEncoding.EncodeToString(utils.UnsafeStringToBytes(text)))
+	self.QueueWriteString(utils.Base64EncodeToString(utils.UnsafeStringToBytes(text)))
 	self.QueueWriteString("\x1b\\")
 }
 
@@ -140,6 +140,20 @@ func (self *Loop) add_write_to_pending_queue(data write_msg) {
 	}
 }
 
+func (self write_msg) size() int {
+	if self.bytes == nil {
+		return len(self.str)
+	}
+	return len(self.bytes)
+}
+
+func (self write_msg) append_to(buf []byte) []byte {
+	if self.bytes == nil {
+		return append(buf, self.str...)
+	}
+	return append(buf, self.bytes...)
+}
+
 func (self write_msg) is_empty() bool {
 	if self.bytes == nil {
 		return self.str == ""
@@ -210,18 +224,52 @@ func write_to_tty(
 		}
 	}
 
-	for {
-		data, more := <-job_channel
-		if !more {
-			keep_going = false
+	// A redraw is typically made up of hundreds of small writes, so coalesce
+	// the ones that are already queued into a single write to the tty. This
+	// greatly reduces the number of syscalls and, when running over SSH, of
+	// packets sent per redraw.
+	const max_coalesced_size = 64 * 1024
+	coalesced := make([]byte, 0, max_coalesced_size)
+	ids := make([]IdType, 0, 64)
+	var carried *write_msg
+	job_channel_open := true
+	for job_channel_open {
+		var data write_msg
+		if carried != nil {
+			data, carried = *carried, nil
+		} else if data, job_channel_open = <-job_channel; !job_channel_open {
 			break
 		}
+		ids = append(ids[:0], data.id)
+		if data.size() < max_coalesced_size {
+			coalesced = data.append_to(coalesced[:0])
+		drain:
+			for {
+				select {
+				case m, more := <-job_channel:
+					if !more {
+						job_channel_open = false
+						break drain
+					}
+					if len(coalesced)+m.size() > max_coalesced_size {
+						carried = &m
+						break drain
+					}
+					coalesced = m.append_to(coalesced)
+					ids = append(ids, m.id)
+				default:
+					break drain
+				}
+			}
+			data = write_msg{bytes: coalesced}
+		}
 		write_data(data)
-		if keep_going {
-			write_done_channel <- data.id
-		} else {
+		if !keep_going {
 			break
 		}
+		for _, id := range ids {
+			write_done_channel <- id
+		}
 	}
 }
 
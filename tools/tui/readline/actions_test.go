@@ -4,13 +4,17 @@ package readline
 
 import (
 	"container/list"
+	"encoding/json"
 	"fmt"
 	"github.com/kovidgoyal/kitty/tools/cli"
 	"github.com/kovidgoyal/kitty/tools/tui/loop"
 	"github.com/kovidgoyal/kitty/tools/utils/shlex"
+	"os"
+	"path/filepath"
 	"strconv"
 	"strings"
 	"testing"
+	"time"
 
 	"github.com/google/go-cmp/cmp"
 )
@@ -517,6 +521,83 @@ func TestHistory(t *testing.T) {
 	ah("a", "")
 }
 
+func TestHistoryFile(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "history")
+	ts := time.Now().Add(-time.Hour)
+	legacy, _ := json.Marshal([]HistoryItem{{Cmd: "ls one", Timestamp: ts}, {Cmd: "ls two", Timestamp: ts.Add(time.Second)}})
+	if err := os.WriteFile(path, legacy, 0o600); err != nil {
+		t.Fatal(err)
+	}
+	cmds := func(h *History) (ans []string) {
+		for _, x := range h.items {
+			ans = append(ans, x.Cmd)
+		}
+		return
+	}
+	h := NewHistory(path, 4)
+	if diff := cmp.Diff([]string{"ls one", "ls two"}, cmds(h)); diff != "" {
+		t.Fatalf("Failed to read legacy history file:\n%s", diff)
+	}
+	h.AddItem("cat three", 0)
+	h.Write()
+	// legacy files are converted to the log format
+	data, _ := os.ReadFile(path)
+	if n := strings.Count(string(data), "\n"); n != 3 {
+		t.Fatalf("History file not in log format:\n%s", data)
+	}
+	h.AddItem("ls one", 0)
+	h.Shutdown()
+	data, _ = os.ReadFile(path)
+	if n := strings.Count(string(data), "\n"); n != 4 {
+		t.Fatalf("History item was not appended:\n%s", data)
+	}
+	h = NewHistory(path, 4)
+	if diff := cmp.Diff([]string{"ls two", "cat three", "ls one"}, cmds(h)); diff != "" {
+		t.Fatalf("Failed to read history log:\n%s", diff)
+	}
+	for i := range 8 {
+		h.AddItem(fmt.Sprintf("echo %d", i), 0)
+	}
+	h.Shutdown()
+	// compacted once there are too many records
+	data, _ = os.ReadFile(path)
+	if n := strings.Count(string(data), "\n"); n != 4 {
+		t.Fatalf("History file was not compacted:\n%s", data)
+	}
+
+	h = NewHistory("", 100)
+	for _, x := range []string{"ls a", "cat abc", "ls abcd", "lsx", "echo bcd"} {
+		h.AddItem(x, 0)
+	}
+	pm := func(prefix string, expected ...string) {
+		var actual []string
+		for _, i := range h.prefix_matches(prefix) {
+			actual = append(actual, h.items[i].Cmd)
+		}
+		if diff := cmp.Diff(expected, actual); diff != "" {
+			t.Fatalf("Unexpected prefix matches for %#v:\n%s", prefix, diff)
+		}
+	}
+	pm("ls", "ls a", "ls abcd", "lsx")
+	pm("ls ", "ls a", "ls abcd")
+	pm("x")
+	sm := func(token string, expected ...string) {
+		var actual []string
+		candidates, _ := h.substring_candidates(token)
+		for _, i := range candidates {
+			actual = append(actual, h.items[i].Cmd)
+		}
+		if diff := cmp.Diff(expected, actual); diff != "" {
+			t.Fatalf("Unexpected substring candidates for %#v:\n%s", token, diff)
+		}
+	}
+	sm("bcd", "ls abcd", "echo bcd")
+	sm("abc", "cat abc", "ls abcd")
+	sm("zzz")
+	h.AddItem("zzz", 0)
+	sm("zzz", "zzz")
+}
+
 func TestReadlineCompletion(t *testing.T) {
 	completer := func(before_cursor, after_cursor string) (ans *cli.Completions) {
 		root := cli.NewRootCommand()
@@ -184,7 +184,7 @@ func (self *Readline) Shutdown() {
 }
 
 func (self *Readline) AddHistoryItem(hi HistoryItem) {
-	self.history.merge_items(hi)
+	self.history.add_new_items(hi)
 }
 
 func (self *Readline) ResetText() {
@@ -3,6 +3,7 @@
 package readline
 
 import (
+	"bytes"
 	"encoding/json"
 	"fmt"
 	"io"
@@ -42,12 +43,19 @@ type HistorySearch struct {
 	original_input_state InputState
 }
 
+// The history file is a log of JSON encoded items, one per line, to which
+// new items are appended. It is compacted, by rewriting it with only the
+// current items, once it has grown to contain too many stale or duplicate
+// records. Files containing a single JSON array of items, as written by
+// older versions, are read and converted on the next write.
 type History struct {
 	file_path string
 	file      *os.File
 	max_items int
 	items     []HistoryItem
 	cmd_map   map[string]int
+	pending   []HistoryItem
+	idx       *history_index
 }
 
 func map_from_items(items []HistoryItem) map[string]int {
@@ -73,10 +81,17 @@ func (self *History) add_item(x HistoryItem) bool {
 }
 
 func (self *History) merge_items(items ...HistoryItem) {
+	if len(items) > 0 {
+		self.invalidate_index()
+	}
 	if len(self.items) == 0 {
-		self.items = items
-		self.cmd_map = map_from_items(self.items)
-		return
+		self.cmd_map = map_from_items(items)
+		if len(self.cmd_map) == len(items) && len(items) <= self.max_items {
+			self.items = items
+			return
+		}
+		// the history log contains duplicate or excess records
+		self.cmd_map = make(map[string]int, len(self.cmd_map))
 	}
 	if len(items) == 0 {
 		return
@@ -99,6 +114,36 @@ func (self *History) merge_items(items ...HistoryItem) {
 	self.cmd_map = map_from_items(self.items)
 }
 
+func decode_history(data []byte) (items []HistoryItem, num_records int, is_legacy bool) {
+	data = bytes.TrimLeft(data, " \t\r\n")
+	if len(data) > 0 && data[0] == '[' {
+		if json.Unmarshal(data, &items) != nil {
+			return nil, 0, true
+		}
+		return items, len(items), true
+	}
+	for len(data) > 0 {
+		line, rest, _ := bytes.Cut(data, []byte{'\n'})
+		data = rest
+		var item HistoryItem
+		if len(line) > 0 && json.Unmarshal(line, &item) == nil {
+			// a partially written last line is ignored
+			items = append(items, item)
+			num_records++
+		}
+	}
+	return
+}
+
+func encode_history(items []HistoryItem) []byte {
+	var buf bytes.Buffer
+	enc := json.NewEncoder(&buf)
+	for _, item := range items {
+		enc.Encode(item)
+	}
+	return buf.Bytes()
+}
+
 func (self *History) Write() {
 	if self.file == nil {
 		return
@@ -110,18 +155,21 @@ func (self *History) Write() {
 	if err != nil {
 		return
 	}
-	var items []HistoryItem
-	err = json.Unmarshal(data, &items)
-	if err != nil {
-		self.merge_items(items...)
-	}
-	ndata, err := json.MarshalIndent(self.items, "", "  ")
-	if err != nil {
-		return
+	items, num_records, is_legacy := decode_history(data)
+	self.merge_items(items...)
+	if is_legacy || num_records+len(self.pending) > 2*self.max_items {
+		ndata := encode_history(self.items)
+		self.file.Truncate(int64(len(ndata)))
+		self.file.Seek(0, 0)
+		self.file.Write(ndata)
+	} else if len(self.pending) > 0 {
+		self.file.Seek(0, io.SeekEnd)
+		if len(data) > 0 && data[len(data)-1] != '\n' {
+			self.file.Write([]byte{'\n'})
+		}
+		self.file.Write(encode_history(self.pending))
 	}
-	self.file.Truncate(int64(len(ndata)))
-	self.file.Seek(0, 0)
-	self.file.Write(ndata)
+	self.pending = self.pending[:0]
 }
 
 func (self *History) Read() {
@@ -135,15 +183,18 @@ func (self *History) Read() {
 	if err != nil {
 		return
 	}
-	var items []HistoryItem
-	err = json.Unmarshal(data, &items)
-	if err == nil {
-		self.merge_items(items...)
-	}
+	items, _, _ := decode_history(data)
+	self.merge_items(items...)
+}
+
+// add_new_items adds items that are not yet in the history file
+func (self *History) add_new_items(items ...HistoryItem) {
+	self.merge_items(items...)
+	self.pending = append(self.pending, items...)
 }
 
 func (self *History) AddItem(cmd string, duration time.Duration) {
-	self.merge_items(HistoryItem{Cmd: cmd, Duration: duration, Timestamp: time.Now()})
+	self.add_new_items(HistoryItem{Cmd: cmd, Duration: duration, Timestamp: time.Now()})
 }
 
 func (self *History) Shutdown() {
@@ -175,10 +226,8 @@ func (self *History) find_prefix_matches(prefix, current_command string, input_s
 		ans.items = ans.items[:len(self.items)]
 		copy(ans.items, self.items)
 	} else {
-		for _, x := range self.items {
-			if strings.HasPrefix(x.Cmd, prefix) {
-				ans.items = append(ans.items, x)
-			}
+		for _, i := range self.prefix_matches(prefix) {
+			ans.items = append(ans.items, self.items[i])
 		}
 	}
 	ans.items = append(ans.items, HistoryItem{Cmd: current_command})
@@ -332,11 +381,23 @@ func (self *Readline) add_text_to_history_search(text string) {
 	if len(self.history_search.tokens) == 0 {
 		self.history_search.items = []*HistoryItem{}
 	} else {
-		items := make([]*HistoryItem, len(self.history.items))
-		for i := range self.history.items {
-			items[i] = &self.history.items[i]
-		}
+		var items []*HistoryItem
 		for _, token := range self.history_search.tokens {
+			if items == nil {
+				if candidates, narrowed := self.history.substring_candidates(token); narrowed {
+					items = make([]*HistoryItem, 0, len(candidates))
+					for _, i := range candidates {
+						if item := &self.history.items[i]; strings.Contains(item.Cmd, token) {
+							items = append(items, item)
+						}
+					}
+					continue
+				}
+				items = make([]*HistoryItem, len(self.history.items))
+				for i := range self.history.items {
+					items[i] = &self.history.items[i]
+				}
+			}
 			matches := make([]*HistoryItem, 0, len(items))
 			for _, item := range items {
 				if strings.Contains(item.Cmd, token) {
@@ -409,19 +470,18 @@ func (self *Readline) history_completer(before_cursor, after_cursor string) (ans
 		}
 		seen := utils.NewSet[string](16)
 		mg := ans.AddMatchGroup("History")
-		for _, x := range self.history.items {
-			if strings.HasPrefix(x.Cmd, before_cursor) {
-				words, _ := shlex.SplitForCompletion(x.Cmd)
-				if idx < len(words) {
-					word := words[idx]
-					desc := ""
-					if !seen.Has(word) {
-						if word != x.Cmd {
-							desc = x.Cmd
-						}
-						mg.AddMatch(word, desc)
-						seen.Add(word)
+		for _, i := range self.history.prefix_matches(before_cursor) {
+			x := self.history.items[i]
+			words, _ := shlex.SplitForCompletion(x.Cmd)
+			if idx < len(words) {
+				word := words[idx]
+				desc := ""
+				if !seen.Has(word) {
+					if word != x.Cmd {
+						desc = x.Cmd
 					}
+					mg.AddMatch(word, desc)
+					seen.Add(word)
 				}
 			}
 		}
@@ -0,0 +1,115 @@
+// License: GPLv3 Copyright: 2025, Kovid Goyal, <kovid at kovidgoyal.net>
+
+package readline
+
+import (
+	"fmt"
+	"slices"
+	"sort"
+	"strings"
+)
+
+var _ = fmt.Print
+
+// history_index speeds up prefix and substring searches over large histories.
+// Prefix matches use the item indices sorted by command, substring matches
+// use posting lists of the item indices containing every trigram. Both are
+// built lazily on first use and discarded whenever the history items change.
+type history_index struct {
+	by_cmd   []int32
+	trigrams map[[3]byte][]int32
+}
+
+func (self *History) index() *history_index {
+	if self.idx == nil {
+		self.idx = &history_index{}
+	}
+	return self.idx
+}
+
+func (self *History) invalidate_index() { self.idx = nil }
+
+// prefix_matches returns the indices, in history order, of all items whose
+// commands start with prefix
+func (self *History) prefix_matches(prefix string) []int32 {
+	idx := self.index()
+	if idx.by_cmd == nil {
+		idx.by_cmd = make([]int32, len(self.items))
+		for i := range idx.by_cmd {
+			idx.by_cmd[i] = int32(i)
+		}
+		slices.SortFunc(idx.by_cmd, func(a, b int32) int { return strings.Compare(self.items[a].Cmd, self.items[b].Cmd) })
+	}
+	start := sort.Search(len(idx.by_cmd), func(i int) bool { return self.items[idx.by_cmd[i]].Cmd >= prefix })
+	end := start
+	for end < len(idx.by_cmd) && strings.HasPrefix(self.items[idx.by_cmd[end]].Cmd, prefix) {
+		end++
+	}
+	ans := slices.Clone(idx.by_cmd[start:end])
+	slices.Sort(ans)
+	return ans
+}
+
+func for_each_trigram(text string, f func([3]byte)) {
+	for i := 0; i+3 <= len(text); i++ {
+		f([3]byte{text[i], text[i+1], text[i+2]})
+	}
+}
+
+func intersect_sorted(a, b []int32) []int32 {
+	ans := make([]int32, 0, min(len(a), len(b)))
+	for len(a) > 0 && len(b) > 0 {
+		switch {
+		case a[0] < b[0]:
+			a = a[1:]
+		case a[0] > b[0]:
+			b = b[1:]
+		default:
+			ans = append(ans, a[0])
+			a, b = a[1:], b[1:]
+		}
+	}
+	return ans
+}
+
+// substring_candidates returns the indices, in history order, of the items
+// that could contain token, or nil if the index cannot narrow them down, as
+// for tokens shorter than a trigram
+func (self *History) substring_candidates(token string) (ans []int32, narrowed bool) {
+	if len(token) < 3 {
+		return nil, false
+	}
+	idx := self.index()
+	if idx.trigrams == nil {
+		idx.trigrams = make(map[[3]byte][]int32, 4096)
+		for i, x := range self.items {
+			for_each_trigram(x.Cmd, func(t [3]byte) {
+				p := idx.trigrams[t]
+				if len(p) == 0 || p[len(p)-1] != int32(i) {
+					idx.trigrams[t] = append(p, int32(i))
+				}
+			})
+		}
+	}
+	var lists [][]int32
+	missing := false
+	for_each_trigram(token, func(t [3]byte) {
+		if p, found := idx.trigrams[t]; found {
+			lists = append(lists, p)
+		} else {
+			missing = true
+		}
+	})
+	if missing {
+		return []int32{}, true
+	}
+	slices.SortFunc(lists, func(a, b []int32) int { return len(a) - len(b) })
+	ans = lists[0]
+	for _, p := range lists[1:] {
+		if len(ans) == 0 {
+			break
+		}
+		ans = intersect_sorted(ans, p)
+	}
+	return ans, true
+}
@@ -54,16 +54,29 @@ func (self *Color) Set(val any) (err error) {
 }
 
 func (self Color) AsCSI(base int) string {
+	return string(self.AppendCSI(make([]byte, 0, 16), base))
+}
+
+// Append the SGR parameters for this color to dst without allocating
+func (self Color) AppendCSI(dst []byte, base int) []byte {
 	if self.Is_numbered && base < 50 {
 		if self.Red < 8 {
-			return strconv.Itoa(base + int(self.Red))
+			return strconv.AppendInt(dst, int64(base+int(self.Red)), 10)
 		}
 		if self.Red < 16 {
-			return strconv.Itoa(base + 52 + int(self.Red))
+			return strconv.AppendInt(dst, int64(base+52+int(self.Red)), 10)
 		}
-		return fmt.Sprintf("%d:5:%d", base+8, self.Red)
+		dst = strconv.AppendInt(dst, int64(base+8), 10)
+		dst = append(dst, ":5:"...)
+		return strconv.AppendUint(dst, uint64(self.Red), 10)
 	}
-	return fmt.Sprintf("%d:2:%d:%d:%d", base+8, self.Red, self.Green, self.Blue)
+	dst = strconv.AppendInt(dst, int64(base+8), 10)
+	dst = append(dst, ":2:"...)
+	dst = strconv.AppendUint(dst, uint64(self.Red), 10)
+	dst = append(dst, ':')
+	dst = strconv.AppendUint(dst, uint64(self.Green), 10)
+	dst = append(dst, ':')
+	return strconv.AppendUint(dst, uint64(self.Blue), 10)
 }
 
 func (self *Color) FromNumber(n uint8) {
@@ -123,42 +136,62 @@ func (self *UnderlineStyleVal) AsCSI() string {
 	if !self.Is_set {
 		return ""
 	}
-	return fmt.Sprintf("4:%d;", self.Val)
+	return fmt.Sprintf("4:%d", self.Val)
 }
 
 func (self *ColorVal) AsCSI(base int) string {
 	if !self.Is_set {
 		return ""
 	}
+	return string(self.AppendCSI(make([]byte, 0, 16), base))
+}
+
+func (self *ColorVal) AppendCSI(dst []byte, base int) []byte {
+	if !self.Is_set {
+		return dst
+	}
 	if self.Is_default {
-		return strconv.Itoa(base + 9)
+		return strconv.AppendInt(dst, int64(base+9), 10)
 	}
-	return self.Val.AsCSI(base)
+	return self.Val.AppendCSI(dst, base)
 }
 
 func (self *SGR) AsCSI() string {
-	ans := make([]byte, 0, 16)
-	w := func(x string) {
-		if x != "" {
-			ans = append(ans, x...)
-			ans = append(ans, ';')
+	return utils.UnsafeBytesToString(self.AppendCSI(make([]byte, 0, 16)))
+}
+
+// Append the parameters and final byte of the CSI sequence for this SGR to
+// dst without allocating. Nothing is appended if no attribute is set.
+func (self *SGR) AppendCSI(dst []byte) []byte {
+	start := len(dst)
+	b := func(v BoolVal, set, reset string) {
+		if v.Is_set {
+			dst = append(dst, utils.IfElse(v.Val, set, reset)...)
+			dst = append(dst, ';')
 		}
 	}
-	w(self.Bold.AsCSI("1", "221"))
-	w(self.Dim.AsCSI("2", "222"))
-	w(self.Italic.AsCSI("3", "23"))
-	w(self.Reverse.AsCSI("7", "27"))
-	w(self.Strikethrough.AsCSI("9", "29"))
-	w(self.Underline_style.AsCSI())
-	w(self.Foreground.AsCSI(30))
-	w(self.Background.AsCSI(40))
-	w(self.Underline_color.AsCSI(50))
-
-	if len(ans) > 0 {
-		ans = ans[:len(ans)-1]
-		ans = append(ans, 'm')
+	c := func(v *ColorVal, base int) {
+		if v.Is_set {
+			dst = append(v.AppendCSI(dst, base), ';')
+		}
 	}
-	return utils.UnsafeBytesToString(ans)
+	b(self.Bold, "1", "221")
+	b(self.Dim, "2", "222")
+	b(self.Italic, "3", "23")
+	b(self.Reverse, "7", "27")
+	b(self.Strikethrough, "9", "29")
+	if self.Underline_style.Is_set {
+		dst = append(dst, "4:"...)
+		dst = strconv.AppendUint(dst, uint64(self.Underline_style.Val), 10)
+		dst = append(dst, ';')
+	}
+	c(&self.Foreground, 30)
+	c(&self.Background, 40)
+	c(&self.Underline_color, 50)
+	if len(dst) > start {
+		dst[len(dst)-1] = 'm'
+	}
+	return dst
 }
 
 func (self *SGR) IsEmpty() bool {
@@ -233,12 +266,15 @@ func SGRFromCSI(csi string) (ans SGR) {
 	if csi == "" {
 		csi = "0"
 	}
-	parts := strings.Split(csi, ";")
-	nums := make([]int, 0, 8)
-	for _, part := range parts {
-		subparts := strings.Split(part, ":")
+	var nums_buf [8]int
+	nums := nums_buf[:0]
+	for more := true; more; {
+		var part string
+		part, csi, more = strings.Cut(csi, ";")
 		nums = nums[:0]
-		for _, b := range subparts {
+		for more_subparts := true; more_subparts; {
+			var b string
+			b, part, more_subparts = strings.Cut(part, ":")
 			q, err := strconv.Atoi(b)
 			if err == nil {
 				nums = append(nums, q)
@@ -436,7 +472,7 @@ func (self *Span) SetClosingStrikethrough(val bool) *Span {
 }
 func (self *Span) SetClosingUnderlineStyle(val UnderlineStyle) *Span {
 	self.closing_sgr.Underline_style.Is_set = true
-	self.opening_sgr.Underline_style.Val = val
+	self.closing_sgr.Underline_style.Val = val
 	return self
 }
 
@@ -460,11 +496,16 @@ func InsertFormatting(text string, spans ...*Span) string {
 			ans = append(ans, csi...)
 		}
 	}
+	write_sgr := func(sgr SGR) {
+		if !sgr.IsEmpty() {
+			ans = sgr.AppendCSI(append(ans, 0x1b, '['))
+		}
+	}
 	open_span := func() {
 		in_span = spans[0]
 		spans = spans[1:]
 		if in_span.Size > 0 {
-			write_csi(in_span.opening_sgr.AsCSI())
+			write_sgr(in_span.opening_sgr)
 		} else {
 			in_span = nil
 		}
@@ -472,8 +513,8 @@ func InsertFormatting(text string, spans ...*Span) string {
 	}
 
 	close_span := func() {
-		write_csi(in_span.closing_sgr.AsCSI())
-		write_csi(overall_sgr_state.AsCSI())
+		write_sgr(in_span.closing_sgr)
+		write_sgr(overall_sgr_state)
 		in_span = nil
 	}
 
@@ -510,8 +551,7 @@ func InsertFormatting(text string, spans ...*Span) string {
 				write_csi(csi)
 			} else {
 				sgr.ApplyMask(in_span.opening_sgr)
-				csi := sgr.AsCSI()
-				write_csi(csi)
+				write_sgr(sgr)
 			}
 			return nil
 		},
@@ -7,6 +7,8 @@ import (
 	"testing"
 
 	"github.com/google/go-cmp/cmp"
+
+	"github.com/kovidgoyal/kitty/tools/utils/style"
 )
 
 var _ = fmt.Print
@@ -33,4 +35,33 @@ func TestInsertFormatting(t *testing.T) {
 		"A\x1b[37mB\x1b[1mC\x1b[221mDE\x1b[39m\x1b[221m",
 		NewSpan(1, 11).SetForeground(7).SetClosingForeground(nil),
 	)
+	test(
+		"abcd",
+		"a\x1b[1;4:3;31;58:2:1:2:3mbc\x1b[221;4:0;39;59md",
+		NewSpan(1, 2).SetBold(true).SetUnderlineStyle(Curly_underline).SetForeground(1).SetUnderlineColor(style.RGBA{Red: 1, Green: 2, Blue: 3}).
+			SetClosingBold(false).SetClosingUnderlineStyle(No_underline).SetClosingForeground(nil).SetClosingUnderlineColor(nil),
+	)
+}
+
+func BenchmarkInsertFormatting(b *testing.B) {
+	// A full page of already styled text with highlighted spans on every line
+	lines := make([]string, 0, 50)
+	size := 0
+	for i := 0; i < 50; i++ {
+		lines = append(lines, fmt.Sprintf("\x1b[1;3%dm%04d\x1b[22;39m \x1b[4:3;58:2:1:2:3mabcdefghijklmnopqrstuvwxyz\x1b[4:0;59m some plain text that fills up the rest of the line %d", i%8, i, i))
+		size += len(lines[i])
+	}
+	spans := []*Span{
+		NewSpan(6, 10).SetForeground("#ff0000").SetBackground(3).SetUnderlineStyle(Curly_underline).SetClosingForeground(nil).SetClosingBackground(nil).SetClosingUnderlineStyle(No_underline),
+		NewSpan(30, 5).SetBold(true).SetReverse(true).SetClosingBold(false).SetClosingReverse(false),
+		NewSpan(50, 20).SetForeground(200).SetClosingForeground(nil),
+	}
+	b.SetBytes(int64(size))
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		for _, line := range lines {
+			InsertFormatting(line, spans...)
+		}
+	}
 }
@@ -3,100 +3,82 @@
 package unicode_names
 
 import (
-	"bytes"
 	_ "embed"
 	"encoding/binary"
 	"fmt"
+	"sort"
 	"strings"
 	"sync"
 	"time"
 
 	"github.com/kovidgoyal/kitty/tools/utils"
-	"github.com/kovidgoyal/kitty/tools/utils/images"
 )
 
 type mark_set = *utils.Set[uint16]
 
+// The data is queried in place, see generate_unicode_names() in
+// gen/go_code.py for its layout
+//
 //go:embed data_generated.bin
 var unicode_name_data string
 var _ = fmt.Print
-var names map[rune]string
-var marks []rune
-var word_map map[string][]uint16
 
-func add_word(codepoint uint16, word []byte) {
-	if codepoint <= 32 || codepoint == 127 || (128 <= codepoint && codepoint <= 159) || len(word) < 2 {
-		return
-	}
-	w := utils.UnsafeBytesToString(word)
-	word_map[w] = append(word_map[w], codepoint)
+type table struct {
+	num                int
+	offsets, blob_base int
 }
 
-func add_words(codepoint uint16, raw []byte) {
-	for len(raw) > 0 {
-		idx := bytes.IndexByte(raw, ' ')
-		if idx < 0 {
-			add_word(codepoint, raw)
-			break
-		}
-		if idx > 0 {
-			add_word(codepoint, raw[:idx])
-		}
-		raw = raw[idx+1:]
-	}
+var codepoints_base int
+var names, words, marks table
+
+func u32(offset int) int {
+	return int(binary.LittleEndian.Uint32(utils.UnsafeStringToBytes(unicode_name_data[offset : offset+4])))
 }
 
-func parse_record(record []byte, mark uint16) {
-	codepoint := rune(binary.LittleEndian.Uint32(record))
-	record = record[4:]
-	marks[mark] = codepoint
-	namelen := binary.LittleEndian.Uint16(record)
-	record = record[2:]
-	name := utils.UnsafeBytesToString(record[:namelen])
-	names[codepoint] = name
-	add_words(mark, record[:namelen])
-	if len(record) > int(namelen) {
-		add_words(mark, record[namelen:])
-	}
+func (t *table) init(num, base int) (end int) {
+	t.num, t.offsets, t.blob_base = num, base, base+4*(num+1)
+	return t.blob_base + u32(t.offsets+4*num)
+}
+
+func (t *table) at(i int) string {
+	return unicode_name_data[t.blob_base+u32(t.offsets+4*i) : t.blob_base+u32(t.offsets+4*(i+1))]
 }
 
 var parse_once sync.Once
 
 func parse_data() {
-	raw := utils.ReadCompressedEmbeddedData(unicode_name_data)
-	num_of_lines := binary.LittleEndian.Uint32(raw)
-	raw = raw[4:]
-	num_of_words := binary.LittleEndian.Uint32(raw)
-	raw = raw[4:]
-	names = make(map[rune]string, num_of_lines)
-	word_map = make(map[string][]uint16, num_of_words)
-	marks = make([]rune, num_of_lines)
-	var mark uint16
-	for len(raw) > 0 {
-		record_len := binary.LittleEndian.Uint16(raw)
-		raw = raw[2:]
-		parse_record(raw[:record_len], mark)
-		mark += 1
-		raw = raw[record_len:]
-	}
+	num_of_names, num_of_words := u32(0), u32(4)
+	codepoints_base = 8
+	end := names.init(num_of_names, codepoints_base+4*num_of_names)
+	end = words.init(num_of_words, end)
+	marks.init(num_of_words, end)
 }
 
+// Only reads the table headers, the data itself is never copied or parsed
 func Initialize() {
 	parse_once.Do(parse_data)
 }
 
+func codepoint_at(mark int) rune { return rune(u32(codepoints_base + 4*mark)) }
+
 func NameForCodePoint(cp rune) string {
 	Initialize()
-	return names[cp]
+	if i := sort.Search(names.num, func(i int) bool { return codepoint_at(i) >= cp }); i < names.num && codepoint_at(i) == cp {
+		return names.at(i)
+	}
+	return ""
 }
 
 func find_matching_codepoints(prefix string) (ans mark_set) {
-	for q, marks := range word_map {
-		if strings.HasPrefix(q, prefix) {
-			if ans == nil {
-				ans = utils.NewSet[uint16](len(marks) * 2)
-			}
-			ans.AddItems(marks...)
+	// words are sorted so all words with the prefix are in a contiguous range
+	first := sort.Search(words.num, func(i int) bool { return words.at(i) >= prefix })
+	for i := first; i < words.num && strings.HasPrefix(words.at(i), prefix); i++ {
+		m := marks.at(i)
+		if ans == nil {
+			ans = utils.NewSet[uint16](len(m))
+		}
+		for ; len(m) > 1; m = m[2:] {
+			ans.Add(binary.LittleEndian.Uint16(utils.UnsafeStringToBytes(m[:2])))
 		}
 	}
 	return ans
@@ -104,21 +86,16 @@ func find_matching_codepoints(prefix string) (ans mark_set) {
 
 func marks_for_query(query string) (ans mark_set) {
 	Initialize()
-	prefixes := strings.Split(strings.ToLower(query), " ")
-	results := make(chan mark_set, len(prefixes))
-	ctx := images.Context{}
-	ctx.Parallel(0, len(prefixes), func(nums <-chan int) {
-		for i := range nums {
-			results <- find_matching_codepoints(prefixes[i])
-		}
-	})
-	close(results)
-	for x := range results {
+	for _, prefix := range strings.Split(strings.ToLower(query), " ") {
+		x := find_matching_codepoints(prefix)
 		if ans == nil {
 			ans = x
 		} else {
 			ans = ans.Intersect(x)
 		}
+		if ans == nil || ans.Len() == 0 {
+			break
+		}
 	}
 	if ans == nil {
 		ans = utils.NewSet[uint16](0)
@@ -131,7 +108,7 @@ func CodePointsForQuery(query string) (ans []rune) {
 	ans = make([]rune, x.Len())
 	i := 0
 	for m := range x.Iterable() {
-		ans[i] = marks[m]
+		ans[i] = codepoint_at(int(m))
 		i += 1
 	}
 	return
@@ -139,9 +116,6 @@ func CodePointsForQuery(query string) (ans []rune) {
 
 func Develop() {
 	start := time.Now()
-	Initialize()
-	fmt.Println("Parsing unicode name data took:", time.Since(start))
-	start = time.Now()
 	num := CodePointsForQuery("arr")
 	fmt.Println("Querying arr took:", time.Since(start), "and found:", len(num))
 	start = time.Now()
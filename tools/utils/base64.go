@@ -0,0 +1,66 @@
+// License: GPLv3 Copyright: 2025, Kovid Goyal, <kovid at kovidgoyal.net>
+
+package utils
+
+import (
+	"encoding/base64"
+	"encoding/binary"
+	"fmt"
+)
+
+var _ = fmt.Print
+
+// Encoding of escape code payloads such as images and clipboard contents.
+// Every lookup in pairs produces two output characters from 12 bits of
+// input, so 6 bytes of input become 8 bytes of output with four lookups and
+// a single store. This is much faster than the three byte at a time
+// encoding in the standard library. Output is identical to that of
+// base64.StdEncoding and base64.RawStdEncoding.
+
+const base64_alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+
+var base64_pairs = func() (ans [4096]uint16) {
+	for i := range ans {
+		ans[i] = uint16(base64_alphabet[i>>6]) | uint16(base64_alphabet[i&63])<<8
+	}
+	return
+}()
+
+func base64_encode(dst, src []byte, enc *base64.Encoding) {
+	si, di := 0, 0
+	// 8 bytes are loaded at a time but only the first 6 are used
+	for ; si+8 <= len(src); si, di = si+6, di+8 {
+		v := binary.BigEndian.Uint64(src[si:])
+		binary.LittleEndian.PutUint64(dst[di:di+8],
+			uint64(base64_pairs[(v>>52)&0xfff])|uint64(base64_pairs[(v>>40)&0xfff])<<16|
+				uint64(base64_pairs[(v>>28)&0xfff])<<32|uint64(base64_pairs[(v>>16)&0xfff])<<48)
+	}
+	// si is a multiple of 3 so the rest, including padding, can be encoded independently
+	enc.Encode(dst[di:], src[si:])
+}
+
+// Encode src into dst, which must be at least
+// base64.RawStdEncoding.EncodedLen(len(src)) bytes long, without padding
+func Base64EncodeRaw(dst, src []byte) {
+	base64_encode(dst, src, base64.RawStdEncoding)
+}
+
+// Encode src into dst, which must be at least
+// base64.StdEncoding.EncodedLen(len(src)) bytes long, with padding
+func Base64Encode(dst, src []byte) {
+	base64_encode(dst, src, base64.StdEncoding)
+}
+
+// Same as base64.RawStdEncoding.EncodeToString() but faster
+func Base64EncodeRawToString(src []byte) string {
+	ans := make([]byte, base64.RawStdEncoding.EncodedLen(len(src)))
+	Base64EncodeRaw(ans, src)
+	return UnsafeBytesToString(ans)
+}
+
+// Same as base64.StdEncoding.EncodeToString() but faster
+func Base64EncodeToString(src []byte) string {
+	ans := make([]byte, base64.StdEncoding.EncodedLen(len(src)))
+	Base64Encode(ans, src)
+	return UnsafeBytesToString(ans)
+}
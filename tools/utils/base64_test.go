@@ -0,0 +1,47 @@
+// License: GPLv3 Copyright: 2025, Kovid Goyal, <kovid at kovidgoyal.net>
+
+package utils
+
+import (
+	"crypto/rand"
+	"encoding/base64"
+	"fmt"
+	"testing"
+
+	"github.com/google/go-cmp/cmp"
+)
+
+var _ = fmt.Print
+
+func TestBase64Encode(t *testing.T) {
+	data := make([]byte, 4096)
+	_, _ = rand.Read(data)
+	for sz := 0; sz < 64; sz++ {
+		for _, src := range [][]byte{data[:sz], data[1 : sz+1], data[:len(data)-sz]} {
+			if diff := cmp.Diff(base64.StdEncoding.EncodeToString(src), Base64EncodeToString(src)); diff != "" {
+				t.Fatalf("Padded encoding of %d bytes failed:\n%s", len(src), diff)
+			}
+			if diff := cmp.Diff(base64.RawStdEncoding.EncodeToString(src), Base64EncodeRawToString(src)); diff != "" {
+				t.Fatalf("Raw encoding of %d bytes failed:\n%s", len(src), diff)
+			}
+		}
+	}
+}
+
+func BenchmarkBase64Encode(b *testing.B) {
+	src := make([]byte, 1024*1024)
+	_, _ = rand.Read(src)
+	dst := make([]byte, base64.RawStdEncoding.EncodedLen(len(src)))
+	b.Run("stdlib", func(b *testing.B) {
+		b.SetBytes(int64(len(src)))
+		for i := 0; i < b.N; i++ {
+			base64.RawStdEncoding.Encode(dst, src)
+		}
+	})
+	b.Run("pairs", func(b *testing.B) {
+		b.SetBytes(int64(len(src)))
+		for i := 0; i < b.N; i++ {
+			Base64EncodeRaw(dst, src)
+		}
+	})
+}
@@ -23,8 +23,9 @@ func NewLRUCache[K comparable, V any](max_size int) *LRUCache[K, V] {
 }
 
 func (self *LRUCache[K, V]) Clear() {
-	self.lock.RLock()
+	self.lock.Lock()
 	clear(self.data)
+	self.lru.Init()
 	self.lock.Unlock()
 }
 
@@ -36,10 +37,11 @@ func (self *LRUCache[K, V]) Get(key K) (ans V, found bool) {
 }
 
 func (self *LRUCache[K, V]) Set(key K, val V) {
-	self.lock.RLock()
+	// called from multiple goroutines, for example when highlighting in
+	// parallel, so this needs the write lock
+	self.lock.Lock()
 	self.data[key] = val
-	self.lock.RUnlock()
-	return
+	self.lock.Unlock()
 }
 
 func (self *LRUCache[K, V]) GetOrCreate(key K, create func(key K) (V, error)) (V, error) {
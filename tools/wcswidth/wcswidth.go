@@ -118,7 +118,21 @@ func (self *WCWidthIterator) CurrentWidth() int {
 	return self.current_width
 }
 
+func is_printable_ascii(text string) bool {
+	for i := 0; i < len(text); i++ {
+		if text[i] < ' ' || text[i] > '~' {
+			return false
+		}
+	}
+	return true
+}
+
 func Stringwidth(text string) int {
+	// Printable ASCII text, by far the most common case, always has one cell
+	// per byte
+	if is_printable_ascii(text) {
+		return len(text)
+	}
 	w := CreateWCWidthIterator()
 	return w.Parse(utils.UnsafeStringToBytes(text))
 }